@@ -0,0 +1,29 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Timing for the benchmark executables: the fastest of a few runs, after one untimed warm-up run
+namespace bench {
+    template <typename F>
+    double measureSeconds(size_t runs, const F& f) {
+        f();
+        double best = 1e30;
+        for (size_t i = 0; i < runs; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // Keeps the optimizer from dropping work whose result is not used otherwise
+    template <typename T>
+    void keep(T value) {
+        static volatile T sink;
+        sink = value;
+        // Reading it back marks it as used for -Wunused-but-set-variable
+        (void)sink;
+    }
+}
@@ -0,0 +1,82 @@
+#include "../lab-5/SoftwareRenderer/BrdfBatch.h"
+
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+// Shading points per second of the BRDF kernels at every supported level, against the per-point shader port
+int main() {
+    const size_t count = 1 << 20;
+    std::mt19937 random(1);
+    std::normal_distribution<float> gaussian;
+    std::vector<float> values[9];
+    for (std::vector<float>& v : values) {
+        v.resize(count);
+    }
+    std::vector<XMFLOAT3> normals(count), lights(count), cameras(count);
+    for (size_t i = 0; i < count; ++i) {
+        XMFLOAT3* targets[3] = { &normals[i], &lights[i], &cameras[i] };
+        for (size_t k = 0; k < 3; ++k) {
+            XMStoreFloat3(targets[k], XMVector3Normalize(XMVectorSet(gaussian(random), gaussian(random), gaussian(random), 0.0f)));
+            values[3 * k][i] = targets[k]->x;
+            values[3 * k + 1][i] = targets[k]->y;
+            values[3 * k + 2][i] = targets[k]->z;
+        }
+    }
+    BrdfBatch batch;
+    batch._count = count;
+    for (size_t c = 0; c < 3; ++c) {
+        batch._normal[c] = values[c].data();
+        batch._light_dir[c] = values[3 + c].data();
+        batch._camera_dir[c] = values[6 + c].data();
+    }
+    SurfacePropsCB sprops;
+    sprops._base_color = XMFLOAT4(0.9f, 0.6f, 0.2f, 1.0f);
+    sprops._roughness = 0.4f;
+    sprops._metalness = 0.5f;
+
+    std::vector<float> out_values[3];
+    float* out[3];
+    for (size_t c = 0; c < 3; ++c) {
+        out_values[c].resize(count);
+        out[c] = out_values[c].data();
+    }
+
+    const double port_seconds = bench::measureSeconds(3, [&]() {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count; ++i) {
+            sum += XMVectorGetX(brdf(XMLoadFloat3(&normals[i]), XMLoadFloat3(&lights[i]), XMLoadFloat3(&cameras[i]), sprops));
+        }
+        bench::keep(sum);
+    });
+    std::printf("%-16s %10s %10s %8s\n", "brdf", "ms", "Msamples/s", "speedup");
+    std::printf("%-16s %10.2f %10.1f %8.2f\n", "shader port", port_seconds * 1e3, count / port_seconds * 1e-6, 1.0);
+
+    const SimdLevel levels[] = { SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel level : levels) {
+        if (!isSimdLevelSupported(level)) {
+            std::printf("%-16s not supported\n", getSimdLevelName(level));
+            continue;
+        }
+        const double seconds = bench::measureSeconds(5, [&]() {
+            batchBrdf(batch, sprops, out, level);
+        });
+        std::printf("%-16s %10.2f %10.1f %8.2f\n", getSimdLevelName(level), seconds * 1e3, count / seconds * 1e-6, port_seconds / seconds);
+    }
+
+    std::printf("\n%-16s %10s %10s\n", "ndf", "ms", "Msamples/s");
+    for (SimdLevel level : levels) {
+        if (isSimdLevelSupported(level)) {
+            const double seconds = bench::measureSeconds(5, [&]() {
+                batchNdf(batch, sprops, out[0], level);
+            });
+            std::printf("%-16s %10.2f %10.1f\n", getSimdLevelName(level), seconds * 1e3, count / seconds * 1e-6);
+        }
+    }
+    return 0;
+}
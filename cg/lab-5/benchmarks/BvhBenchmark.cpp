@@ -0,0 +1,108 @@
+#include "../lab-5/Scene/Bvh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+// Build, refit and query times of the binary and the 4-wide tree, queries against testing every box
+int main() {
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(1.0f, 1.5f, 0.5f, 80.0f);
+    const FrustumPlanes planes = makeFrustumPlanes(XMMatrixLookAtLH(XMVectorSet(0.0f, 10.0f, -120.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
+        XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * projection);
+    const size_t ray_count = 10000;
+
+    std::printf("%8s %6s %9s %9s %9s %9s %9s %9s %9s\n", "objects", "tree", "build ms", "refit ms", "SAH", "frustum", "brute", "sphere", "ray");
+    for (size_t count : { (size_t)10000, (size_t)100000, (size_t)1000000 }) {
+        // Spheres in a slab whose side grows with the count, so the density stays the same
+        const float side = 2.0f * std::sqrt((float)count);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> position(-side, side);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+        BoundingSpheres spheres;
+        spheres.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            spheres.set(i, XMFLOAT3(position(random), 0.1f * position(random), position(random)), size(random));
+        }
+        std::vector<Aabb> bounds;
+        getSphereBounds(spheres, bounds);
+        // Every object moves a little, like one animated frame
+        std::vector<Aabb> moved = bounds;
+        for (size_t i = 0; i < count; ++i) {
+            const float dx = i % 2 ? 0.25f : -0.25f;
+            moved[i]._min.x += dx;
+            moved[i]._max.x += dx;
+        }
+
+        std::vector<XMFLOAT3> origins(ray_count), dirs(ray_count);
+        for (size_t r = 0; r < ray_count; ++r) {
+            origins[r] = XMFLOAT3(position(random), position(random), position(random));
+            XMStoreFloat3(&dirs[r], XMVector3Normalize(XMVectorSet(position(random), position(random), position(random), 0.0f)));
+        }
+
+        std::vector<uint32_t> objects;
+        const double brute_seconds = bench::measureSeconds(3, [&] {
+            objects.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+                if (isAabbVisible(planes, bounds[i])) {
+                    objects.push_back(i);
+                }
+            }
+            bench::keep(objects.size());
+        });
+
+        for (bool wide : { false, true }) {
+            BvhOptions options;
+            options._wide = wide;
+            Bvh bvh(options);
+            const double build_seconds = bench::measureSeconds(3, [&] {
+                bvh.build(bounds);
+            });
+            // Alternates between the two sets of boxes, so every run refits real motion
+            bool odd = false;
+            const double refit_seconds = bench::measureSeconds(5, [&] {
+                odd = !odd;
+                bench::keep(bvh.refit(odd ? moved : bounds));
+            });
+            bvh.build(bounds);
+            const double frustum_seconds = bench::measureSeconds(5, [&] {
+                bvh.queryFrustum(planes, objects);
+                bench::keep(objects.size());
+            });
+            const double sphere_seconds = bench::measureSeconds(5, [&] {
+                size_t found = 0;
+                for (size_t q = 0; q < 1000; ++q) {
+                    bvh.querySphere(origins[q], 5.0f, objects);
+                    found += objects.size();
+                }
+                bench::keep(found);
+            });
+            // Closest sphere hit, like picking
+            const double ray_seconds = bench::measureSeconds(3, [&] {
+                float sum = 0.0f;
+                for (size_t r = 0; r < ray_count; ++r) {
+                    sum += bvh.intersectRay(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), 1e30f, [&](uint32_t i, float t_max) {
+                        const float ox = origins[r].x - spheres._x[i];
+                        const float oy = origins[r].y - spheres._y[i];
+                        const float oz = origins[r].z - spheres._z[i];
+                        const float b = ox * dirs[r].x + oy * dirs[r].y + oz * dirs[r].z;
+                        const float h = b * b - (ox * ox + oy * oy + oz * oz - spheres._radius[i] * spheres._radius[i]);
+                        const float t = h < 0.0f ? -1.0f : -b - std::sqrt(h);
+                        return t >= 0.0f && t <= t_max ? t : -1.0f;
+                    })._t;
+                }
+                bench::keep(sum);
+            });
+            std::printf("%8zu %6s %9.2f %9.2f %9.1f %9.3f %9.3f %9.3f %9.2f\n", count, wide ? "4-wide" : "binary", build_seconds * 1e3, refit_seconds * 1e3,
+                bvh.getSahCost(), frustum_seconds * 1e3, brute_seconds * 1e3, sphere_seconds * 1e3, ray_seconds / ray_count * 1e6);
+        }
+    }
+    std::printf("frustum and brute in ms per query, sphere of radius 5 and ray in us per query\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "../lab-5/DrawQueue.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+
+// Key encoding, id lookup and sorting of a frame of draws, and how many state changes the order saves
+int main() {
+    std::printf("%8s %10s %10s %10s %10s %14s %14s\n", "draws", "ids ms", "encode ms", "radix ms", "std ms", "changes before", "changes after");
+    for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000, (size_t)1000000 }) {
+        // 32 shader pairs, 500 materials and 200 resource sets as pointers, every tenth draw blended
+        std::mt19937 random(1);
+        std::uniform_int_distribution<uintptr_t> shader(0, 31);
+        std::uniform_int_distribution<uintptr_t> material(0, 499);
+        std::uniform_int_distribution<uintptr_t> resources(0, 199);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        struct Draw {
+            uintptr_t _shaders[2];
+            uintptr_t _material;
+            uintptr_t _resources[3];
+            float _depth;
+        };
+        std::vector<Draw> draws(count);
+        for (Draw& draw : draws) {
+            const uintptr_t s = shader(random);
+            const uintptr_t r = resources(random);
+            draw = { { 0x10000 + s * 64, 0x20000 + s * 64 }, 0x30000 + material(random) * 64, { 0x40000 + r * 64, 0x50000 + r * 64, 0x60000 }, depth(random) };
+        }
+
+        DrawStateIds shader_ids(DRAW_KEY_SHADER_BITS);
+        DrawStateIds material_ids(DRAW_KEY_MATERIAL_BITS);
+        DrawStateIds resource_ids(DRAW_KEY_RESOURCE_BITS);
+        std::vector<DrawKeyFields> fields(count);
+        // After the warm-up every state is known, like in every frame after the first
+        const double id_seconds = bench::measureSeconds(5, [&] {
+            for (size_t i = 0; i < count; ++i) {
+                fields[i]._pass = i % 10 == 0 ? 1 : 0;
+                fields[i]._shader = shader_ids.getId(draws[i]._shaders, 2);
+                fields[i]._material = material_ids.getId(&draws[i]._material, 1);
+                fields[i]._resources = resource_ids.getId(draws[i]._resources, 3);
+                fields[i]._depth = draws[i]._depth;
+            }
+        });
+
+        std::vector<DrawPacket> packets(count);
+        const double encode_seconds = bench::measureSeconds(5, [&] {
+            for (size_t i = 0; i < count; ++i) {
+                packets[i] = { fields[i]._pass ? makeBlendedDrawKey(fields[i]) : makeOpaqueDrawKey(fields[i]), (uint32_t)i };
+            }
+        });
+
+        const std::vector<DrawPacket> unsorted = packets;
+        std::vector<DrawPacket> scratch;
+        const double radix_seconds = bench::measureSeconds(5, [&] {
+            packets = unsorted;
+            radixSortDrawPackets(packets, scratch);
+        });
+        std::vector<DrawPacket> reference;
+        const double std_seconds = bench::measureSeconds(5, [&] {
+            reference = unsorted;
+            std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& a, const DrawPacket& b) {
+                return a._key < b._key;
+            });
+        });
+
+        auto stateChanges = [&](const std::vector<DrawPacket>& order) {
+            size_t changes = 0;
+            for (size_t i = 1; i < order.size(); ++i) {
+                const DrawKeyFields& a = fields[order[i - 1]._draw];
+                const DrawKeyFields& b = fields[order[i]._draw];
+                changes += (a._shader != b._shader) + (a._material != b._material) + (a._resources != b._resources);
+            }
+            return changes;
+        };
+        // Copying the unsorted packets is part of both sorts
+        std::printf("%8zu %10.3f %10.3f %10.3f %10.3f %14zu %14zu\n", count, id_seconds * 1e3, encode_seconds * 1e3, radix_seconds * 1e3, std_seconds * 1e3,
+            stateChanges(unsorted), stateChanges(packets));
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../lab-5/Scene/FrustumCulling.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+// Spheres per second of every supported kernel on one thread and of the parallel cull, against one
+// isSphereVisible call per sphere
+int main() {
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const FrustumPlanes planes = makeFrustumPlanes(view * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 100.0f));
+
+    // About a quarter of the spheres is visible, so the compaction is neither all nor nothing
+    const size_t count = 1 << 20;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> size(0.1f, 1.0f);
+    BoundingSpheres spheres;
+    spheres.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        spheres.set(i, XMFLOAT3(position(random), position(random), position(random) + 50.0f), size(random));
+    }
+    std::vector<uint32_t> visible(count);
+
+    size_t visible_count = 0;
+    const double reference_seconds = bench::measureSeconds(3, [&] {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i) {
+            n += isSphereVisible(planes, XMFLOAT3(spheres._x[i], spheres._y[i], spheres._z[i]), spheres._radius[i]);
+        }
+        visible_count = n;
+    });
+    std::printf("%zu spheres, %zu visible\n", count, visible_count);
+    std::printf("%-24s %10s %10s %8s\n", "cull", "ms", "Mspheres/s", "speedup");
+    std::printf("%-24s %10.3f %10.1f %8.2f\n", "isSphereVisible", reference_seconds * 1e3, count / reference_seconds * 1e-6, 1.0);
+
+    const SimdLevel levels[] = { SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512 };
+    for (SimdLevel level : levels) {
+        if (!software::isSimdLevelSupported(level)) {
+            std::printf("%-24s not supported here\n", software::getSimdLevelName(level));
+            continue;
+        }
+        const double seconds = bench::measureSeconds(5, [&] {
+            bench::keep(cullSpheres(planes, spheres, 0, count, visible.data(), level));
+        });
+        std::printf("%-24s %10.3f %10.1f %8.2f\n", software::getSimdLevelName(level), seconds * 1e3, count / seconds * 1e-6, reference_seconds / seconds);
+    }
+    const double parallel_seconds = bench::measureSeconds(5, [&] {
+        cullSpheresParallel(planes, spheres, visible);
+        bench::keep(visible.size());
+    });
+    std::printf("%-24s %10.3f %10.1f %8.2f\n", "parallel, best level", parallel_seconds * 1e3, count / parallel_seconds * 1e-6, reference_seconds / parallel_seconds);
+    return 0;
+}
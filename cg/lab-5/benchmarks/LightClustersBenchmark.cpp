@@ -0,0 +1,66 @@
+#include "../lab-5/Scene/LightClusters.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+// Light assignment of a 16x9x24 grid against testing every froxel box with every light
+int main() {
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.1f, 100.0f);
+    ClusterGridSettings settings;
+    settings._projection_x = XMVectorGetX(projection.r[0]);
+    settings._projection_y = XMVectorGetY(projection.r[1]);
+    LightClusters clusters;
+    clusters.setGrid(settings);
+    const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -19.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    std::printf("threads %u, %zu clusters\n", std::thread::hardware_concurrency(), clusters.getClusterCount());
+
+    std::printf("%8s %10s %10s %10s %10s\n", "lights", "assign ms", "brute ms", "indices", "max");
+    for (size_t count : { (size_t)1000, (size_t)10000, (size_t)100000 }) {
+        // Small lights in a 40x20x40 room seen from one wall
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> x(-20.0f, 20.0f);
+        std::uniform_real_distribution<float> y(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> range(0.5f, 2.5f);
+        std::vector<ClusterLight> lights(count);
+        for (ClusterLight& light : lights) {
+            light._position = XMFLOAT3(x(random), y(random), x(random));
+            light._range = range(random);
+        }
+
+        const double assign_seconds = bench::measureSeconds(10, [&] {
+            clusters.assign(view, lights);
+        });
+
+        // Too slow to be worth waiting for past 10k lights
+        double brute_seconds = 0.0;
+        if (count <= 10000) {
+            std::vector<XMFLOAT3> centers(count);
+            brute_seconds = bench::measureSeconds(1, [&] {
+                for (size_t i = 0; i < count; ++i) {
+                    XMStoreFloat3(&centers[i], XMVector3TransformCoord(XMLoadFloat3(&lights[i]._position), view));
+                }
+                size_t pairs = 0;
+                for (size_t cluster = 0; cluster < clusters.getClusterCount(); ++cluster) {
+                    for (size_t i = 0; i < count; ++i) {
+                        pairs += overlapsAabb(clusters.getClusterBounds(cluster), centers[i], lights[i]._range);
+                    }
+                }
+                bench::keep(pairs);
+            });
+        }
+        char brute[16] = "-";
+        if (brute_seconds > 0.0) {
+            std::snprintf(brute, sizeof(brute), "%.2f", brute_seconds * 1e3);
+        }
+        std::printf("%8zu %10.3f %10s %10zu %10zu\n", count, assign_seconds * 1e3, brute, clusters.getLightIndices().size(), clusters.getMaxClusterLights());
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "../lab-5/MaterialGrid.h"
+
+#include <cstdio>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+int main() {
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    const geometry::LodChain chain = geometry::makeSphereLodChain(1.0f, 128, 256, 5, true, true);
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+    // From 100 to a million spheres
+    for (uint32_t side : { 10u, 32u, 100u, 316u, 1000u }) {
+        MaterialGridSettings settings;
+        settings._columns = side;
+        settings._rows = side;
+        MaterialGrid grid;
+        const double build = bench::measureSeconds(5, [&] {
+            // A new spacing rebuilds the whole layout
+            settings._spacing = settings._spacing == 2.5f ? 2.0f : 2.5f;
+            bench::keep(grid.update(settings));
+        });
+        const size_t count = grid.getInstanceCount();
+
+        std::vector<MaterialInstance> packed(count);
+        const double pack = bench::measureSeconds(5, [&] {
+            grid.pack(packed.data());
+            bench::keep(packed.back()._roughness);
+        });
+
+        // The camera looks at the grid from the middle of one edge, so the levels spread over the grid
+        std::vector<uint32_t> instances(count);
+        std::iota(instances.begin(), instances.end(), 0u);
+        const XMVECTOR camera = XMVectorSet(0.0f, -0.5f * side * settings._spacing, -10.0f, 1.0f);
+        LodInstanceGroups groups;
+        const double group = bench::measureSeconds(5, [&] {
+            groupInstancesByLod(grid.getBounds(), instances, chain.getView(), camera, projection, 0.1f, 1080.0f, 1.0f, groups);
+            bench::keep(groups._instances.back());
+        });
+
+        std::printf("%8zu instances  update %8.3f ms %7.1f M/s  pack %8.3f ms %7.1f M/s  LOD groups %8.3f ms %7.1f M/s  levels", count, build * 1e3,
+            count / build * 1e-6, pack * 1e3, count / pack * 1e-6, group * 1e3, count / group * 1e-6);
+        for (size_t level = 0; level < chain.getLevelCount(); ++level) {
+            std::printf(" %u", groups._offsets[level + 1] - groups._offsets[level]);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "../lab-5/Geometry/MeshCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    struct SphereSource {
+        float _radius;
+        uint32_t _n_theta;
+        uint32_t _n_phi;
+        uint32_t _level_count;
+    };
+
+    // What creating the GPU buffers costs on the CPU: the driver copies the initial data once
+    void upload(const LodChainView& view, std::vector<uint8_t>& staging) {
+        const size_t vertex_bytes = view._vertex_count * sizeof(SimpleVertex);
+        const size_t index_bytes = view._index_count * sizeof(unsigned);
+        staging.resize(vertex_bytes + index_bytes);
+        std::memcpy(staging.data(), view._vertices, vertex_bytes);
+        std::memcpy(staging.data() + vertex_bytes, view._indices, index_bytes);
+        bench::keep(staging[staging.size() / 2]);
+    }
+
+    // A cache miss builds the chain, writes the cache and uploads from the chain. A hit maps the file, checks every
+    // index and uploads from the mapped pages. The file is in the OS page cache after the first run, so the hit
+    // times leave out the disk
+    void run(const SphereSource& source, const std::filesystem::path& path) {
+        const uint64_t source_hash = hashMeshSource(&source, sizeof(source));
+        std::vector<uint8_t> staging;
+        LodChain chain;
+        const double build_seconds = bench::measureSeconds(3, [&] {
+            chain = makeSphereLodChain(source._radius, source._n_theta, source._n_phi, source._level_count, true, true);
+        });
+        const double write_seconds = bench::measureSeconds(3, [&] {
+            writeMeshCache(path, chain, source_hash);
+        });
+        const double miss_upload_seconds = bench::measureSeconds(5, [&] {
+            upload(chain.getView(), staging);
+        });
+
+        MeshCacheFile cache;
+        const double open_seconds = bench::measureSeconds(20, [&] {
+            cache.open(path, source_hash, false);
+            bench::keep(cache.getView()._vertex_count);
+            cache.close();
+        });
+        const double hit_seconds = bench::measureSeconds(20, [&] {
+            cache.open(path, source_hash, true);
+            upload(cache.getView(), staging);
+            cache.close();
+        });
+
+        const double megabytes = std::filesystem::file_size(path) / (1024.0 * 1024.0);
+        std::printf("sphere %ux%u, %u levels, %.2f MB\n", source._n_theta, source._n_phi, source._level_count, megabytes);
+        std::printf("  miss: build %9.3f ms, write %7.3f ms, upload %7.3f ms, total %9.3f ms\n", build_seconds * 1e3, write_seconds * 1e3,
+            miss_upload_seconds * 1e3, (build_seconds + write_seconds + miss_upload_seconds) * 1e3);
+        std::printf("  hit:  open %7.3f ms, open + index check + upload %7.3f ms (%.0f MB/s), %.0fx faster\n", open_seconds * 1e3, hit_seconds * 1e3,
+            megabytes / hit_seconds, (build_seconds + miss_upload_seconds) / hit_seconds);
+    }
+}
+
+int main() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "lab5-benchmark.meshcache";
+    // The renderer's sphere, then one a hundred times larger
+    run({ 1.0f, 60, 60, 5 }, path);
+    run({ 1.0f, 600, 600, 5 }, path);
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "../lab-5/Geometry/MeshOptimizer.h"
+#include "../lab-5/Icosphere.h"
+#include "../lab-5/ParametricSurface.h"
+#include "../lab-5/SoftwareRenderer/Rasterizer.h"
+#include "../lab-5/Sphere.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+using namespace rendering::software;
+
+namespace {
+    struct Mesh {
+        std::string _name;
+        std::vector<SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+    };
+
+    Mesh makeTorus(size_t n_major, size_t n_minor) {
+        Mesh mesh;
+        mesh._name = "torus " + std::to_string(n_major) + "x" + std::to_string(n_minor);
+        mesh._vertices.resize(torusVertexCount(n_major, n_minor));
+        mesh._indices.resize(torusIndexCount(n_major, n_minor));
+        generateTorus(1.0f, 0.4f, n_major, n_minor, mesh._vertices.data(), mesh._indices.data());
+        return mesh;
+    }
+
+    // Shaded over covered pixels, averaged over views from around the mesh
+    float measureOverdraw(const Mesh& mesh) {
+        const size_t size = 256;
+        const size_t views = 8;
+        FrameBuffer target(size, size);
+        size_t shaded = 0;
+        size_t covered = 0;
+        for (size_t view = 0; view < views; ++view) {
+            const float angle = XM_2PI * view / views;
+            const XMMATRIX view_projection = XMMatrixLookAtLH(XMVectorSet(2.5f * std::cos(angle), 0.3f, 2.5f * std::sin(angle), 1.0f), XMVectorZero(),
+                XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.0f, 0.1f, 10.0f);
+            target.clear(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f), 1.0f);
+            Rasterizer rasterizer(target);
+            rasterizer.drawIndexed(mesh._vertices, mesh._indices, 0,
+                [&](const SimpleVertex& v) {
+                    RasterVertex out;
+                    XMStoreFloat4(&out._position, XMVector3Transform(XMLoadFloat3(&v._pos), view_projection));
+                    return out;
+                },
+                [](const float*) { return XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f); });
+            shaded += rasterizer.getStats()._pixels;
+            for (float depth : target._depth) {
+                covered += depth < 1.0f;
+            }
+        }
+        return (float)shaded / covered;
+    }
+
+    void run(const Mesh& mesh) {
+        const size_t vertex_count = mesh._vertices.size();
+        const size_t triangle_count = mesh._indices.size() / 3;
+
+        Mesh cache_order = mesh;
+        const double cache_seconds = bench::measureSeconds(3, [&] {
+            cache_order._indices = mesh._indices;
+            optimizeVertexCache(cache_order._indices, vertex_count);
+        });
+        Mesh overdraw_order = cache_order;
+        const double overdraw_seconds = bench::measureSeconds(3, [&] {
+            overdraw_order._indices = cache_order._indices;
+            optimizeOverdraw(overdraw_order._indices, overdraw_order._vertices);
+        });
+        Mesh fetch_order = overdraw_order;
+        const double fetch_seconds = bench::measureSeconds(3, [&] {
+            fetch_order = overdraw_order;
+            optimizeVertexFetch(fetch_order._vertices, fetch_order._indices);
+        });
+
+        std::printf("%s, %zu triangles\n", mesh._name.c_str(), triangle_count);
+        std::printf("  %-10s %7s %7s %9s %9s %10s\n", "order", "ACMR", "ATVR", "overfetch", "overdraw", "Mtri/s");
+        const Mesh* orders[] = { &mesh, &cache_order, &overdraw_order, &fetch_order };
+        const char* names[] = { "input", "cache", "overdraw", "fetch" };
+        const double seconds[] = { 0.0, cache_seconds, overdraw_seconds, fetch_seconds };
+        for (size_t i = 0; i < 4; ++i) {
+            const VertexCacheStats cache = analyzeVertexCache(orders[i]->_indices, orders[i]->_vertices.size());
+            const VertexFetchStats fetch = analyzeVertexFetch(orders[i]->_indices, orders[i]->_vertices.size(), sizeof(SimpleVertex));
+            std::printf("  %-10s %7.3f %7.3f %9.3f %9.3f", names[i], cache._acmr, cache._atvr, fetch._overfetch, measureOverdraw(*orders[i]));
+            if (seconds[i] > 0.0) {
+                std::printf(" %10.2f", triangle_count / seconds[i] * 1e-6);
+            }
+            std::printf("\n");
+        }
+    }
+}
+
+int main() {
+    const Sphere sphere(1.0f, 200, 398, true, true);
+    run({ "uv sphere 200x398", sphere.getVertices(), sphere.getIndices() });
+    const Icosphere icosphere(1.0f, 6, true);
+    run({ "icosphere 6", icosphere.getVertices(), icosphere.getIndices() });
+    // Self occluding, the only one where draw order changes overdraw
+    run(makeTorus(64, 24));
+    run(makeTorus(512, 192));
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "../lab-5/Geometry/MeshSimplifier.h"
+#include "../lab-5/Icosphere.h"
+#include "../lab-5/ParametricSurface.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    struct Mesh {
+        std::string _name;
+        std::vector<SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+    };
+
+    Mesh makeTorus(size_t n_major, size_t n_minor) {
+        Mesh mesh;
+        mesh._name = "torus " + std::to_string(n_major) + "x" + std::to_string(n_minor);
+        mesh._vertices.resize(torusVertexCount(n_major, n_minor));
+        mesh._indices.resize(torusIndexCount(n_major, n_minor));
+        generateTorus(1.0f, 0.3f, n_major, n_minor, mesh._vertices.data(), mesh._indices.data());
+        return mesh;
+    }
+
+    // Input triangles per second, serial and on chunk_count slabs
+    void run(const Mesh& mesh) {
+        const size_t triangle_count = mesh._indices.size() / 3;
+        std::printf("%s, %zu triangles\n", mesh._name.c_str(), triangle_count);
+        std::printf("  %-6s %-10s %10s %10s %10s\n", "ratio", "mode", "triangles", "error", "Mtri/s");
+        const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+        for (float ratio : { 0.5f, 0.1f, 0.01f }) {
+            SimplifyOptions options;
+            options._target_index_count = (size_t)(mesh._indices.size() * ratio) / 3 * 3;
+            for (size_t chunk_count : { (size_t)0, 4 * thread_count }) {
+                std::vector<unsigned> indices;
+                float error = 0.0f;
+                const double seconds = bench::measureSeconds(2, [&] {
+                    indices = mesh._indices;
+                    error = chunk_count == 0 ? simplifyMesh(mesh._vertices, indices, options) : simplifyMeshParallel(mesh._vertices, indices, options, chunk_count);
+                });
+                const std::string mode = chunk_count == 0 ? "serial" : std::to_string(chunk_count) + " slabs";
+                std::printf("  %-6.2f %-10s %10zu %10.5f %10.2f\n", ratio, mode.c_str(), indices.size() / 3, error, triangle_count / seconds * 1e-6);
+            }
+        }
+    }
+}
+
+int main() {
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    run(makeTorus(256, 128));
+    run(makeTorus(1024, 512));
+    const Icosphere icosphere(1.0f, 7, true);
+    run({ "icosphere 7", icosphere.getVertices(), icosphere.getIndices() });
+    return 0;
+}
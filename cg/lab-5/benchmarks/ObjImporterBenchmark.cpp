@@ -0,0 +1,81 @@
+#include "../lab-5/Geometry/ObjImporter.h"
+#include "../lab-5/Icosphere.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    // Six decimals like most exporters, separate position and normal indices
+    std::string writeObj(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices) {
+        std::string text;
+        char line[128];
+        for (const SimpleVertex& vertex : vertices) {
+            text.append(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", vertex._pos.x, vertex._pos.y, vertex._pos.z));
+        }
+        for (const SimpleVertex& vertex : vertices) {
+            text.append(line, std::snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", vertex._nor.x, vertex._nor.y, vertex._nor.z));
+        }
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const unsigned a = indices[i] + 1;
+            const unsigned b = indices[i + 1] + 1;
+            const unsigned c = indices[i + 2] + 1;
+            text.append(line, std::snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n", a, a, b, b, c, c));
+        }
+        return text;
+    }
+
+    void run(const char* name, const std::string& text, const ObjImportOptions& options) {
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        ObjImportReport report;
+        const double seconds = bench::measureSeconds(3, [&] {
+            report = parseObj(text.data(), text.size(), vertices, indices, options);
+        });
+        std::printf("  %-24s %-6s %8zu vertices %8.3f s %8.1f MB/s\n", name, getObjStatusName(report._status), vertices.size(), seconds,
+            text.size() / seconds * 1e-6);
+    }
+}
+
+int main() {
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    for (size_t subdivisions : { (size_t)6, (size_t)8 }) {
+        const Icosphere icosphere(1.0f, subdivisions, true);
+        const std::string text = writeObj(icosphere.getVertices(), icosphere.getIndices());
+        std::printf("icosphere %zu, %zu triangles, %.1f MB\n", subdivisions, icosphere.getIndices().size() / 3, text.size() * 1e-6);
+
+        ObjImportOptions options;
+        options._optimize = false;
+        run("parse", text, options);
+        options._chunk_size = 64 << 10;
+        run("parse, 64 KB chunks", text, options);
+        options._chunk_size = ObjImportOptions()._chunk_size;
+        options._weld = true;
+        run("parse + weld", text, options);
+        options._weld = false;
+        options._optimize = true;
+        run("parse + optimize", text, options);
+
+        // From a mapped file, the file is in the OS page cache after the warm-up run
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "lab5-benchmark.obj";
+        std::ofstream(path, std::ios::binary).write(text.data(), (std::streamsize)text.size());
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        options._optimize = false;
+        const double seconds = bench::measureSeconds(3, [&] {
+            importObj(path, vertices, indices, options);
+        });
+        std::printf("  %-24s %-6s %8zu vertices %8.3f s %8.1f MB/s\n", "import mapped file", "ok", vertices.size(), seconds, text.size() / seconds * 1e-6);
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "../lab-5/Scene/OcclusionCulling.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+namespace {
+    struct Occluder {
+        const std::vector<XMFLOAT3>* _positions;
+        const std::vector<unsigned>* _indices;
+        XMMATRIX _world;
+    };
+
+    const std::vector<XMFLOAT3> QUAD = { XMFLOAT3(-1.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 1.0f, 0.0f) };
+    const std::vector<unsigned> QUAD_INDICES = { 0, 1, 2, 0, 2, 3 };
+    const std::vector<XMFLOAT3> CUBE = {
+        XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, -1.0f),
+        XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f),
+    };
+    const std::vector<unsigned> CUBE_INDICES = {
+        0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3,
+    };
+
+    // The scenes of OcclusionCullingTest: three walls, and with near_box a small box that crosses the near plane
+    std::vector<Occluder> makeOccluders(bool near_box) {
+        std::vector<Occluder> occluders = {
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(6.0f, 4.0f, 1.0f) * XMMatrixTranslation(-5.0f, 0.0f, 10.0f) },
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(4.0f, 6.0f, 1.0f) * XMMatrixRotationY(0.4f) * XMMatrixTranslation(6.0f, 1.0f, 14.0f) },
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(20.0f, 2.0f, 1.0f) * XMMatrixTranslation(0.0f, -6.0f, 20.0f) },
+        };
+        if (near_box) {
+            occluders.push_back({ &CUBE, &CUBE_INDICES, XMMatrixScaling(0.2f, 0.2f, 0.225f) * XMMatrixTranslation(0.3f, -0.1f, 0.275f) });
+        }
+        return occluders;
+    }
+
+    std::vector<Aabb> makeBoxes(size_t count, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Aabb> boxes(count);
+        for (Aabb& box : boxes) {
+            const XMFLOAT3 center(unit(random) * 80.0f - 40.0f, unit(random) * 40.0f - 20.0f, unit(random) * 100.0f + 2.0f);
+            const float size = 0.1f + unit(random) * 1.5f;
+            box._min = XMFLOAT3(center.x - size, center.y - size, center.z - size);
+            box._max = XMFLOAT3(center.x + size, center.y + size, center.z + size);
+        }
+        return boxes;
+    }
+}
+
+// The stages of a frame of occlusion culling, split like the calls the renderer makes, at the default buffer
+// size and at twice it
+int main() {
+    std::printf("threads %u\n", std::thread::hardware_concurrency());
+    const XMMATRIX view_projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.1f, 200.0f);
+    const std::vector<Aabb> boxes = makeBoxes(10000, 7);
+
+    std::printf("%-9s %9s %10s %12s %12s %10s %10s %10s %10s\n", "scene", "buffer", "begin us", "occluder us", "hierarchy us", "test us",
+        "ns/box", "frame us", "occluded");
+    for (bool near_box : { false, true }) {
+        const std::vector<Occluder> occluders = makeOccluders(near_box);
+        const size_t sizes[][2] = { { 256, 128 }, { 512, 256 } };
+        for (const size_t* size : sizes) {
+            OcclusionBuffer buffer(size[0], size[1]);
+            const double begin_seconds = bench::measureSeconds(50, [&] {
+                buffer.begin(view_projection);
+            });
+            const double occluder_seconds = bench::measureSeconds(50, [&] {
+                buffer.begin(view_projection);
+                for (const Occluder& occluder : occluders) {
+                    buffer.renderOccluder(*occluder._positions, *occluder._indices, occluder._world);
+                }
+            }) - begin_seconds;
+            const double hierarchy_seconds = bench::measureSeconds(50, [&] {
+                buffer.buildHierarchy();
+            });
+
+            size_t occluded = 0;
+            const double test_seconds = bench::measureSeconds(20, [&] {
+                size_t n = 0;
+                for (const Aabb& box : boxes) {
+                    n += buffer.testAabb(box) == OcclusionResult::OCCLUDED;
+                }
+                occluded = n;
+            });
+
+            const double frame_seconds = bench::measureSeconds(20, [&] {
+                buffer.begin(view_projection);
+                for (const Occluder& occluder : occluders) {
+                    buffer.renderOccluder(*occluder._positions, *occluder._indices, occluder._world);
+                }
+                buffer.buildHierarchy();
+                size_t n = 0;
+                for (const Aabb& box : boxes) {
+                    n += buffer.testAabb(box) == OcclusionResult::OCCLUDED;
+                }
+                bench::keep(n);
+            });
+            std::printf("%-9s %4zux%-4zu %10.2f %12.2f %12.2f %10.1f %10.1f %10.1f %10zu\n", near_box ? "near box" : "walls", size[0], size[1],
+                begin_seconds * 1e6, occluder_seconds * 1e6, hierarchy_seconds * 1e6, test_seconds * 1e6, test_seconds / boxes.size() * 1e9,
+                frame_seconds * 1e6, occluded);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "../lab-5/ParametricSurface.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    // How Sphere generated before the tables: sinf and cosf per vertex, angles accumulated, push_back without reserve
+    void generateUvSpherePerVertex(float radius, size_t n_theta, size_t n_phi, std::vector<SimpleVertex>& out) {
+        out.clear();
+        out.push_back({ XMFLOAT3(0.0f, radius, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) });
+        const float d_theta = XM_PI / (n_theta - 1);
+        const float d_phi = XM_2PI / n_phi;
+        float theta = d_theta;
+        for (size_t i = 0; i + 2 < n_theta; ++i, theta += d_theta) {
+            float phi = 0.0f;
+            for (size_t j = 0; j < n_phi; ++j, phi += d_phi) {
+                const XMFLOAT3 normal(sinf(theta) * sinf(phi), cosf(theta), -sinf(theta) * cosf(phi));
+                out.push_back({ XMFLOAT3(radius * normal.x, radius * normal.y, radius * normal.z), normal });
+            }
+        }
+        out.push_back({ XMFLOAT3(0.0f, -radius, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) });
+    }
+
+    // The tables and the ring layout with every column written one by one, as the SSE tail does
+    void generateUvSphereScalar(float radius, size_t n_theta, size_t n_phi, SimpleVertex* out) {
+        const TrigTable theta = makeTrigTable(n_theta - 2, XM_PI / (n_theta - 1), XM_PI / (n_theta - 1));
+        const TrigTable phi = makeTrigTable(n_phi, XM_2PI / n_phi);
+        out[0] = { XMFLOAT3(0.0f, radius, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) };
+        for (size_t i = 0; i + 2 < n_theta; ++i) {
+            const float rho = radius * theta._sin[i];
+            const float y = radius * theta._cos[i];
+            SimpleVertex* ring = out + 1 + i * n_phi;
+            for (size_t j = 0; j < n_phi; ++j) {
+                ring[j]._pos = XMFLOAT3(rho * phi._sin[j], y, -rho * phi._cos[j]);
+                ring[j]._nor = XMFLOAT3(theta._sin[i] * phi._sin[j], theta._cos[i], -theta._sin[i] * phi._cos[j]);
+            }
+        }
+        out[1 + (n_theta - 2) * n_phi] = { XMFLOAT3(0.0f, -radius, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) };
+    }
+
+    void report(const char* name, size_t vertex_count, double seconds) {
+        std::printf("  %-28s %9zu vertices %9.3f ms %8.1f Mvert/s\n", name, vertex_count, seconds * 1e3, vertex_count / seconds * 1e-6);
+    }
+}
+
+int main() {
+    for (size_t n : { (size_t)100, (size_t)1000 }) {
+        std::printf("%zux%zu\n", n, n);
+        const size_t runs = n < 1000 ? 50 : 5;
+
+        std::vector<SimpleVertex> vertices(uvSphereVertexCount(n, n));
+        report("uv sphere, per vertex sinf", vertices.size(), bench::measureSeconds(runs, [&] {
+            generateUvSpherePerVertex(1.0f, n, n, vertices);
+            bench::keep(vertices.back()._pos.y);
+        }));
+        vertices.resize(uvSphereVertexCount(n, n));
+        report("uv sphere, tables, scalar", vertices.size(), bench::measureSeconds(runs, [&] {
+            generateUvSphereScalar(1.0f, n, n, vertices.data());
+            bench::keep(vertices[vertices.size() / 2]._pos.x);
+        }));
+        report("uv sphere, tables, SSE", vertices.size(), bench::measureSeconds(runs, [&] {
+            generateUvSphere(1.0f, n, n, vertices.data());
+            bench::keep(vertices[vertices.size() / 2]._pos.x);
+        }));
+
+        vertices.resize(torusVertexCount(n, n));
+        std::vector<unsigned> indices(torusIndexCount(n, n));
+        report("torus with indices", vertices.size(), bench::measureSeconds(runs, [&] {
+            generateTorus(1.0f, 0.4f, n, n, vertices.data(), indices.data());
+            bench::keep(indices.back());
+        }));
+        vertices.resize(capsuleVertexCount(n / 2, n));
+        indices.resize(capsuleIndexCount(n / 2, n));
+        report("capsule with indices", vertices.size(), bench::measureSeconds(runs, [&] {
+            generateCapsule(0.5f, 1.0f, n / 2, n, vertices.data(), indices.data());
+            bench::keep(indices.back());
+        }));
+    }
+    return 0;
+}
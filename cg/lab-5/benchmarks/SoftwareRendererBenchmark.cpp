@@ -0,0 +1,56 @@
+#include "../lab-5/SoftwareRenderer/SoftwareRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+// Whole frames of the CPU port of the PBR path: the sphere, the sky and the tone mapping, split like FrameStats
+int main() {
+    // A sky gradient with a sun, baked with the sizes Renderer::initScene uses. Fewer bake samples only change the
+    // content of the maps, not the cost of sampling them
+    Texture2D equirect(512, 256);
+    for (size_t y = 0; y < equirect.getHeight(); ++y) {
+        for (size_t x = 0; x < equirect.getWidth(); ++x) {
+            const float u = (x + 0.5f) / equirect.getWidth();
+            const float v = (y + 0.5f) / equirect.getHeight();
+            const float sky = 0.2f + 0.8f * std::max(0.0f, 1.0f - 2.0f * v);
+            const float sun = 20.0f * std::exp(-2000.0f * ((u - 0.3f) * (u - 0.3f) + (v - 0.2f) * (v - 0.2f)));
+            equirect.at(x, y) = XMFLOAT4(0.6f * sky + sun, 0.7f * sky + sun, sky + sun, 1.0f);
+        }
+    }
+    const auto bake_start = std::chrono::steady_clock::now();
+    EnvironmentBakeDesc bake_desc;
+    bake_desc._prefiltered_samples = 64;
+    bake_desc._preintegrated_samples = 64;
+    const EnvironmentMaps maps = bakeEnvironment(equirect, bake_desc);
+    std::printf("threads %u, bake %.2f s\n", std::thread::hardware_concurrency(),
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - bake_start).count());
+
+    std::printf("%11s %10s %10s %10s %10s %10s %10s\n", "size", "frame ms", "raster ms", "tone ms", "fps", "triangles", "Mpixels/s");
+    const size_t sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+    for (const size_t* size : sizes) {
+        SoftwareRenderer renderer(size[0], size[1], maps);
+        // Close enough that the sphere fills a good part of the frame
+        SceneState scene;
+        scene._camera = Camera(XMVectorSet(0.0f, 0.6f, -1.8f, 0.0f), XMVectorSet(0.0f, -0.3f, 1.0f, 0.0f));
+        FrameStats fastest;
+        fastest._total_ms = 1e30f;
+        const double frame_seconds = bench::measureSeconds(10, [&] {
+            const FrameStats stats = renderer.render(scene);
+            if (stats._total_ms < fastest._total_ms) {
+                fastest = stats;
+            }
+        });
+        std::printf("%5zux%-5zu %10.2f %10.2f %10.2f %10.1f %10zu %10.1f\n", size[0], size[1], frame_seconds * 1e3, fastest._raster_ms,
+            fastest._tone_mapping_ms, 1.0 / frame_seconds, fastest._raster._triangles, fastest._raster._pixels / frame_seconds * 1e-6);
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include "../lab-5/CubeSphere.h"
+#include "../lab-5/Icosphere.h"
+#include "../lab-5/Sphere.h"
+#include "../lab-5/SphereTessellation.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+
+namespace {
+    template <typename F>
+    void report(const char* name, float max_error, const F& build) {
+        size_t triangles = 0;
+        size_t vertices = 0;
+        float error = 0.0f;
+        const double seconds = bench::measureSeconds(3, [&] {
+            const auto sphere = build(max_error);
+            triangles = sphere.getIndices().size() / 3;
+            vertices = sphere.getVertices().size();
+            error = sphereChordError(sphere.getVertices(), sphere.getIndices(), 1.0f);
+        });
+        std::printf("%8g %-12s %10zu %10zu %12.3g %10.2f\n", max_error, name, triangles, vertices, error, seconds * 1e3);
+    }
+}
+
+// Triangle counts of the three unit sphere tessellations when fromMaxError picks the resolution for the same
+// chord error. Build time includes the search and measuring the error of the result
+int main() {
+    std::printf("%8s %-12s %10s %10s %12s %10s\n", "limit", "mesh", "triangles", "vertices", "chord error", "build ms");
+    for (float max_error : { 1e-2f, 1e-3f, 1e-4f }) {
+        report("uv sphere", max_error, [](float e) { return Sphere::fromMaxError(1.0f, e, true, true); });
+        report("icosphere", max_error, [](float e) { return Icosphere::fromMaxError(1.0f, e, true); });
+        report("cube sphere", max_error, [](float e) { return CubeSphere::fromMaxError(1.0f, e, true); });
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include "../lab-5/Scene/TransformHierarchy.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace DirectX;
+using namespace rendering::scene;
+
+namespace {
+    Transform randomTransform(std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+        Transform transform;
+        transform._translation = XMFLOAT3(position(random), position(random), position(random));
+        XMStoreFloat4(&transform._rotation, XMVector4Normalize(XMVectorSet(position(random), position(random), position(random), position(random))));
+        transform._scale = XMFLOAT3(scale(random), scale(random), scale(random));
+        return transform;
+    }
+
+    XMMATRIX localMatrix(const Transform& t) {
+        return XMMatrixScaling(t._scale.x, t._scale.y, t._scale.z) * XMMatrixRotationQuaternion(XMLoadFloat4(&t._rotation))
+            * XMMatrixTranslation(t._translation.x, t._translation.y, t._translation.z);
+    }
+}
+
+// Batched updates of a 1M node scene against one XMMATRIX per node in handle order, which is what the
+// hierarchy replaced
+int main() {
+    const size_t count = 1000000;
+    std::printf("threads %u\n", std::thread::hardware_concurrency());
+
+    // 1000 roots, then every node below the node at an eighth of its handle, 5 depths in all
+    std::mt19937 random(1);
+    std::vector<TransformHandle> parents(count);
+    std::vector<Transform> locals(count);
+    TransformHierarchy hierarchy;
+    for (size_t i = 0; i < count; ++i) {
+        parents[i] = i < 1000 ? NO_TRANSFORM : (TransformHandle)(i / 8);
+        locals[i] = randomTransform(random);
+        hierarchy.add(locals[i], parents[i]);
+    }
+    hierarchy.update();
+    std::printf("%zu nodes in %zu depths\n", hierarchy.size(), hierarchy.getDepthCount());
+    std::printf("%-34s %10s %10s\n", "update", "nodes", "ms");
+
+    // Changing every root recomputes every node
+    size_t updated = 0;
+    const double full_seconds = bench::measureSeconds(5, [&] {
+        for (TransformHandle node = 0; node < 1000; ++node) {
+            hierarchy.setLocal(node, locals[node]);
+        }
+        updated = hierarchy.update();
+    });
+    std::printf("%-34s %10zu %10.2f\n", "all roots changed", updated, full_seconds * 1e3);
+
+    // One root in a hundred, the animated part of a scene
+    const double some_seconds = bench::measureSeconds(5, [&] {
+        for (TransformHandle node = 0; node < 1000; node += 100) {
+            hierarchy.setLocal(node, locals[node]);
+        }
+        updated = hierarchy.update();
+    });
+    std::printf("%-34s %10zu %10.2f\n", "10 roots changed", updated, some_seconds * 1e3);
+
+    const double leaf_seconds = bench::measureSeconds(5, [&] {
+        for (size_t i = 0; i < 1000; ++i) {
+            const TransformHandle node = (TransformHandle)(count - 1 - i * 97);
+            hierarchy.setLocal(node, locals[node]);
+        }
+        updated = hierarchy.update();
+    });
+    std::printf("%-34s %10zu %10.2f\n", "1000 leaves changed", updated, leaf_seconds * 1e3);
+
+    const double clean_seconds = bench::measureSeconds(5, [&] {
+        updated = hierarchy.update();
+    });
+    std::printf("%-34s %10zu %10.3f\n", "nothing changed", updated, clean_seconds * 1e3);
+
+    // Parents come before their children in handle order, so one pass gives every world matrix. No normal matrices
+    std::vector<XMMATRIX> worlds(count);
+    const double naive_seconds = bench::measureSeconds(5, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            const XMMATRIX local = localMatrix(locals[i]);
+            worlds[i] = parents[i] == NO_TRANSFORM ? local : local * worlds[parents[i]];
+        }
+        bench::keep(XMVectorGetX(worlds[count - 1].r[3]));
+    });
+    std::printf("%-34s %10zu %10.2f\n", "XMMATRIX per node, world only", count, naive_seconds * 1e3);
+    return 0;
+}
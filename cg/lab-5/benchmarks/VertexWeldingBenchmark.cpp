@@ -0,0 +1,64 @@
+#include "../lab-5/Geometry/VertexWelding.h"
+#include "../lab-5/Icosphere.h"
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    // Every corner its own vertex, moved well inside the weld epsilon and without a normal
+    void makeSoup(const Icosphere& icosphere, std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> offset(-1e-6f, 1e-6f);
+        vertices.clear();
+        indices.clear();
+        for (unsigned index : icosphere.getIndices()) {
+            SimpleVertex vertex = icosphere.getVertices()[index];
+            vertex._pos.x += offset(random);
+            vertex._pos.y += offset(random);
+            vertex._pos.z += offset(random);
+            vertex._nor = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+            indices.push_back((unsigned)vertices.size());
+            vertices.push_back(vertex);
+        }
+    }
+
+    void run(const char* name, const Icosphere& icosphere, const WeldOptions& options) {
+        std::vector<SimpleVertex> soup_vertices;
+        std::vector<unsigned> soup_indices;
+        makeSoup(icosphere, soup_vertices, soup_indices);
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        WeldReport report;
+        // The copy back to the soup is part of every run, it is small next to the weld
+        const double seconds = bench::measureSeconds(3, [&] {
+            vertices = soup_vertices;
+            indices = soup_indices;
+            report = weldVertices(vertices, indices, options);
+        });
+        std::printf("  %-20s %8zu -> %8zu vertices %8.3f s %8.2f Mvert/s\n", name, report._vertices_before, report._vertices_after, seconds,
+            report._vertices_before / seconds * 1e-6);
+    }
+}
+
+int main() {
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    // About one and four million corners
+    for (size_t subdivisions : { (size_t)7, (size_t)8 }) {
+        const Icosphere icosphere(1.0f, subdivisions, true);
+        std::printf("icosphere %zu soup, %zu triangles\n", subdivisions, icosphere.getIndices().size() / 3);
+        WeldOptions options;
+        run("weld + normals", icosphere, options);
+        options._crease_angle = 180.0f;
+        run("weld, no crease", icosphere, options);
+        options._recompute_normals = false;
+        run("weld only", icosphere, options);
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// The SAL annotations DirectXMath uses, they only matter to the MSVC code analysis
+
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_reads_(s)
+#define _In_reads_opt_(s)
+#define _In_reads_bytes_(s)
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_updates_(s)
+#define _Inout_updates_bytes_(s)
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(s)
+#define _Out_writes_opt_(s)
+#define _Out_writes_all_(s)
+#define _Out_writes_bytes_(s)
+#define _Outptr_
+#define _Outptr_opt_
+#define _Ret_maybenull_
+#define _Success_(expr)
+#define _When_(expr, annotation)
+#define _Analysis_assume_(expr)
+#define _Use_decl_annotations_
+#define _Check_return_
+#define _Printf_format_string_
@@ -0,0 +1,125 @@
+#include "BatchJob.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace batch {
+    namespace {
+        DirectX::XMFLOAT3 parseVector(const JsonValue& json) {
+            const auto& items = json.asArray();
+            if (items.size() != 3) {
+                throw std::runtime_error("3-component vector expected");
+            }
+            return DirectX::XMFLOAT3((float)items[0].asNumber(), (float)items[1].asNumber(), (float)items[2].asNumber());
+        }
+
+        DirectX::XMFLOAT3 parseVector(const std::string& text) {
+            DirectX::XMFLOAT3 v;
+            char comma1 = 0, comma2 = 0;
+            std::istringstream stream(text);
+            if (!(stream >> v.x >> comma1 >> v.y >> comma2 >> v.z) || comma1 != ',' || comma2 != ',') {
+                throw std::runtime_error("expected x,y,z instead of " + text);
+            }
+            return v;
+        }
+
+        Backend parseBackend(const std::string& name) {
+            if (name == "raster") {
+                return Backend::RASTER;
+            }
+            if (name == "path") {
+                return Backend::PATH_TRACER;
+            }
+            throw std::runtime_error("unknown backend " + name + " (raster or path)");
+        }
+    }
+
+    std::vector<RenderJob> parseJobs(const JsonValue& json) {
+        const JsonValue& list = json.isObject() ? json["jobs"] : json;
+        RenderJob defaults;
+        if (json.isObject() && json.has("defaults")) {
+            defaults = parseJob(json["defaults"]);
+        }
+
+        std::vector<RenderJob> jobs;
+        for (const JsonValue& item : list.asArray()) {
+            jobs.push_back(parseJob(item, defaults));
+        }
+        return jobs;
+    }
+
+    RenderJob parseJob(const JsonValue& json, const RenderJob& defaults) {
+        RenderJob job = defaults;
+        job._name = json.get("name", job._name);
+        job._environment = json.get("environment", job._environment);
+        job._output = json.get("output", job._name);
+        if (json.has("backend")) {
+            job._backend = parseBackend(json["backend"].asString());
+        }
+
+        job._width = (size_t)json.get("width", (double)job._width);
+        job._height = (size_t)json.get("height", (double)job._height);
+        job._frames = (size_t)json.get("frames", (double)job._frames);
+        job._samples = (unsigned)json.get("samples", (double)job._samples);
+
+        if (json.has("camera")) {
+            const JsonValue& camera = json["camera"];
+            if (camera.has("position")) {
+                job._camera_pos = parseVector(camera["position"]);
+            }
+            if (camera.has("direction")) {
+                job._camera_dir = parseVector(camera["direction"]);
+            }
+            job._orbit = (float)camera.get("orbit", job._orbit);
+        }
+
+        if (json.has("material")) {
+            const JsonValue& material = json["material"];
+            if (material.has("color")) {
+                job._color = parseVector(material["color"]);
+            }
+            job._roughness = (float)material.get("roughness", job._roughness);
+            job._metalness = (float)material.get("metalness", job._metalness);
+        }
+
+        job._exposure = (float)json.get("exposure", job._exposure);
+        return job;
+    }
+
+    bool applyOption(RenderJob& job, const std::string& key, const std::string& value) {
+        if (key == "name") {
+            job._name = value;
+        } else if (key == "environment") {
+            job._environment = value;
+        } else if (key == "output") {
+            job._output = value;
+        } else if (key == "backend") {
+            job._backend = parseBackend(value);
+        } else if (key == "width") {
+            job._width = std::stoul(value);
+        } else if (key == "height") {
+            job._height = std::stoul(value);
+        } else if (key == "frames") {
+            job._frames = std::stoul(value);
+        } else if (key == "samples") {
+            job._samples = (unsigned)std::stoul(value);
+        } else if (key == "camera-pos") {
+            job._camera_pos = parseVector(value);
+        } else if (key == "camera-dir") {
+            job._camera_dir = parseVector(value);
+        } else if (key == "orbit") {
+            job._orbit = std::stof(value);
+        } else if (key == "color") {
+            job._color = parseVector(value);
+        } else if (key == "roughness") {
+            job._roughness = std::stof(value);
+        } else if (key == "metalness") {
+            job._metalness = std::stof(value);
+        } else if (key == "exposure") {
+            job._exposure = std::stof(value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+}
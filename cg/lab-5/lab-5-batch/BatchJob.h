@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <string>
+#include <vector>
+
+#include "Json.h"
+
+namespace batch {
+    enum class Backend {
+        RASTER,
+        PATH_TRACER,
+    };
+
+    // One lab-5 scene to render. Unset fields keep the defaults of Renderer::initScene.
+    // F0 is not a separate input: as in the shader it is lerp(0.04, color, metalness).
+    struct RenderJob {
+        std::string _name = "frame";
+        std::string _environment = "kloppenheim_01_1k.hdr";
+        std::string _output = "frame";
+        Backend _backend = Backend::RASTER;
+
+        size_t _width = 640;
+        size_t _height = 480;
+        size_t _frames = 1;
+        unsigned _samples = 64;
+
+        DirectX::XMFLOAT3 _camera_pos = { 0.0f, 1.5f, -3.0f };
+        DirectX::XMFLOAT3 _camera_dir = { 0.0f, 0.0f, 1.0f };
+        // Rotation of the camera around the y axis between consecutive frames, degrees
+        float _orbit = 0.0f;
+
+        DirectX::XMFLOAT3 _color = { 0.2f, 0.0f, 0.0f };
+        float _roughness = 0.3f;
+        float _metalness = 0.2f;
+        float _exposure = 10.0f;
+    };
+
+    // Accepts either an array of jobs or an object with a "jobs" array
+    std::vector<RenderJob> parseJobs(const JsonValue& json);
+    RenderJob parseJob(const JsonValue& json, const RenderJob& defaults = RenderJob());
+
+    // Overrides fields of job from --key value pairs; returns false on an unknown option
+    bool applyOption(RenderJob& job, const std::string& key, const std::string& value);
+}
@@ -0,0 +1,125 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace batch {
+    namespace {
+        const size_t MAX_STORED_BLOCK = 65535;
+
+        uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+            static uint32_t s_table[256];
+            static bool s_table_ready = false;
+            if (!s_table_ready) {
+                for (uint32_t n = 0; n < 256; ++n) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k) {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    s_table[n] = c;
+                }
+                s_table_ready = true;
+            }
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i) {
+                crc = s_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+            out.push_back((uint8_t)(value >> 24));
+            out.push_back((uint8_t)(value >> 16));
+            out.push_back((uint8_t)(value >> 8));
+            out.push_back((uint8_t)value);
+        }
+
+        void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+            std::vector<uint8_t> chunk;
+            appendBigEndian(chunk, (uint32_t)data.size());
+            chunk.insert(chunk.end(), type, type + 4);
+            chunk.insert(chunk.end(), data.begin(), data.end());
+            appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+            file.write((const char*)chunk.data(), chunk.size());
+        }
+
+        // zlib stream made of stored blocks
+        std::vector<uint8_t> storeZlib(const std::vector<uint8_t>& data) {
+            std::vector<uint8_t> out = { 0x78, 0x01 };
+            size_t offset = 0;
+            do {
+                size_t length = std::min(MAX_STORED_BLOCK, data.size() - offset);
+                bool last = offset + length == data.size();
+                out.push_back(last ? 1 : 0);
+                out.push_back((uint8_t)length);
+                out.push_back((uint8_t)(length >> 8));
+                out.push_back((uint8_t)~length);
+                out.push_back((uint8_t)(~length >> 8));
+                out.insert(out.end(), data.begin() + offset, data.begin() + offset + length);
+                offset += length;
+            } while (offset < data.size());
+
+            uint32_t a = 1, b = 0;
+            for (uint8_t byte : data) {
+                a = (a + byte) % 65521;
+                b = (b + a) % 65521;
+            }
+            appendBigEndian(out, (b << 16) | a);
+            return out;
+        }
+    }
+
+    bool writePng(const std::string& path, size_t width, size_t height, const std::vector<uint8_t>& rgba) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write((const char*)signature, sizeof(signature));
+
+        std::vector<uint8_t> header;
+        appendBigEndian(header, (uint32_t)width);
+        appendBigEndian(header, (uint32_t)height);
+        header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bits, RGBA, deflate, no filter, no interlace
+        writeChunk(file, "IHDR", header);
+
+        std::vector<uint8_t> scanlines;
+        scanlines.reserve((width * 4 + 1) * height);
+        for (size_t y = 0; y < height; ++y) {
+            scanlines.push_back(0);
+            scanlines.insert(scanlines.end(), rgba.begin() + y * width * 4, rgba.begin() + (y + 1) * width * 4);
+        }
+        writeChunk(file, "IDAT", storeZlib(scanlines));
+        writeChunk(file, "IEND", {});
+        return (bool)file;
+    }
+
+    bool writeHdr(const std::string& path, size_t width, size_t height, const std::vector<DirectX::XMFLOAT4>& rgb) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        file << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " << height << " +X " << width << "\n";
+
+        std::vector<uint8_t> rgbe(width * height * 4);
+        for (size_t i = 0; i < width * height; ++i) {
+            const DirectX::XMFLOAT4& c = rgb[i];
+            float r = std::max(c.x, 0.0f), g = std::max(c.y, 0.0f), b = std::max(c.z, 0.0f);
+            float v = std::max(r, std::max(g, b));
+            uint8_t* out = &rgbe[4 * i];
+            if (v < 1e-32f) {
+                out[0] = out[1] = out[2] = out[3] = 0;
+                continue;
+            }
+            int exponent;
+            float scale = frexpf(v, &exponent) * 256.0f / v;
+            out[0] = (uint8_t)(r * scale);
+            out[1] = (uint8_t)(g * scale);
+            out[2] = (uint8_t)(b * scale);
+            out[3] = (uint8_t)(exponent + 128);
+        }
+        file.write((const char*)rgbe.data(), rgbe.size());
+        return (bool)file;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace batch {
+    // 8-bit RGBA PNG. The image data goes into stored (uncompressed) deflate blocks,
+    // which keeps the writer dependency-free at the cost of file size.
+    bool writePng(const std::string& path, size_t width, size_t height, const std::vector<uint8_t>& rgba);
+
+    // Radiance RGBE with flat (not run-length encoded) scanlines, readable by stb_image
+    bool writeHdr(const std::string& path, size_t width, size_t height, const std::vector<DirectX::XMFLOAT4>& rgb);
+}
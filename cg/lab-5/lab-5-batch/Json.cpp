@@ -0,0 +1,231 @@
+#include "Json.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace batch {
+    class JsonParser {
+    public:
+        JsonParser(const std::string& text)
+            : _text(text) {}
+
+        JsonValue parseDocument() {
+            JsonValue value = parseValue();
+            skipWhitespace();
+            if (_pos != _text.size()) {
+                fail("trailing characters");
+            }
+            return value;
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::runtime_error("JSON: " + what + " at offset " + std::to_string(_pos));
+        }
+
+        void skipWhitespace() {
+            while (_pos < _text.size() && isspace((unsigned char)_text[_pos])) {
+                ++_pos;
+            }
+        }
+
+        char peek() {
+            skipWhitespace();
+            if (_pos >= _text.size()) {
+                fail("unexpected end");
+            }
+            return _text[_pos];
+        }
+
+        void expect(char c) {
+            if (peek() != c) {
+                fail(std::string("expected '") + c + "'");
+            }
+            ++_pos;
+        }
+
+        bool consume(const char* word) {
+            size_t length = strlen(word);
+            if (_text.compare(_pos, length, word) == 0) {
+                _pos += length;
+                return true;
+            }
+            return false;
+        }
+
+        JsonValue parseValue() {
+            JsonValue value;
+            char c = peek();
+            if (c == '{') {
+                value._type = JsonValue::Type::OBJECT;
+                ++_pos;
+                if (peek() != '}') {
+                    do {
+                        std::string key = parseString();
+                        expect(':');
+                        value._object[key] = parseValue();
+                    } while (peek() == ',' && ++_pos);
+                }
+                expect('}');
+            } else if (c == '[') {
+                value._type = JsonValue::Type::ARRAY;
+                ++_pos;
+                if (peek() != ']') {
+                    do {
+                        value._array.push_back(parseValue());
+                    } while (peek() == ',' && ++_pos);
+                }
+                expect(']');
+            } else if (c == '"') {
+                value._type = JsonValue::Type::STRING;
+                value._string = parseString();
+            } else if (consume("true")) {
+                value._type = JsonValue::Type::BOOLEAN;
+                value._boolean = true;
+            } else if (consume("false")) {
+                value._type = JsonValue::Type::BOOLEAN;
+            } else if (consume("null")) {
+                value._type = JsonValue::Type::NUL;
+            } else {
+                const char* begin = _text.c_str() + _pos;
+                char* end = nullptr;
+                value._number = strtod(begin, &end);
+                if (end == begin) {
+                    fail("unexpected character");
+                }
+                value._type = JsonValue::Type::NUMBER;
+                _pos += end - begin;
+            }
+            return value;
+        }
+
+        std::string parseString() {
+            expect('"');
+            std::string result;
+            while (_pos < _text.size() && _text[_pos] != '"') {
+                char c = _text[_pos++];
+                if (c == '\\') {
+                    if (_pos >= _text.size()) {
+                        fail("unterminated escape");
+                    }
+                    char e = _text[_pos++];
+                    switch (e) {
+                    case 'n': result += '\n'; break;
+                    case 't': result += '\t'; break;
+                    case 'r': result += '\r'; break;
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'u': {
+                        if (_pos + 4 > _text.size()) {
+                            fail("bad unicode escape");
+                        }
+                        unsigned code = (unsigned)strtoul(_text.substr(_pos, 4).c_str(), nullptr, 16);
+                        _pos += 4;
+                        // Basic multilingual plane only, encoded as UTF-8
+                        if (code < 0x80) {
+                            result += (char)code;
+                        } else if (code < 0x800) {
+                            result += (char)(0xC0 | (code >> 6));
+                            result += (char)(0x80 | (code & 0x3F));
+                        } else {
+                            result += (char)(0xE0 | (code >> 12));
+                            result += (char)(0x80 | ((code >> 6) & 0x3F));
+                            result += (char)(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                    default: result += e; break;
+                    }
+                } else {
+                    result += c;
+                }
+            }
+            if (_pos >= _text.size()) {
+                fail("unterminated string");
+            }
+            ++_pos;
+            return result;
+        }
+
+        const std::string& _text;
+        size_t _pos = 0;
+    };
+
+    JsonValue JsonValue::parse(const std::string& text) {
+        return JsonParser(text).parseDocument();
+    }
+
+    JsonValue JsonValue::parseFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return parse(stream.str());
+    }
+
+    JsonValue::Type JsonValue::getType() const {
+        return _type;
+    }
+
+    bool JsonValue::isObject() const {
+        return _type == Type::OBJECT;
+    }
+
+    bool JsonValue::isArray() const {
+        return _type == Type::ARRAY;
+    }
+
+    bool JsonValue::asBool() const {
+        if (_type != Type::BOOLEAN) {
+            throw std::runtime_error("JSON: boolean expected");
+        }
+        return _boolean;
+    }
+
+    double JsonValue::asNumber() const {
+        if (_type != Type::NUMBER) {
+            throw std::runtime_error("JSON: number expected");
+        }
+        return _number;
+    }
+
+    const std::string& JsonValue::asString() const {
+        if (_type != Type::STRING) {
+            throw std::runtime_error("JSON: string expected");
+        }
+        return _string;
+    }
+
+    const std::vector<JsonValue>& JsonValue::asArray() const {
+        if (_type != Type::ARRAY) {
+            throw std::runtime_error("JSON: array expected");
+        }
+        return _array;
+    }
+
+    bool JsonValue::has(const std::string& key) const {
+        return _type == Type::OBJECT && _object.count(key) > 0;
+    }
+
+    const JsonValue& JsonValue::operator[](const std::string& key) const {
+        auto it = _object.find(key);
+        if (_type != Type::OBJECT || it == _object.end()) {
+            throw std::runtime_error("JSON: missing key \"" + key + "\"");
+        }
+        return it->second;
+    }
+
+    double JsonValue::get(const std::string& key, double fallback) const {
+        return has(key) ? (*this)[key].asNumber() : fallback;
+    }
+
+    std::string JsonValue::get(const std::string& key, const std::string& fallback) const {
+        return has(key) ? (*this)[key].asString() : fallback;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace batch {
+    // Just enough JSON for job lists: parse errors and type mismatches throw std::runtime_error
+    class JsonValue {
+    public:
+        enum class Type {
+            NUL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            ARRAY,
+            OBJECT,
+        };
+
+        static JsonValue parse(const std::string& text);
+        static JsonValue parseFile(const std::string& path);
+
+        Type getType() const;
+        bool isObject() const;
+        bool isArray() const;
+
+        bool asBool() const;
+        double asNumber() const;
+        const std::string& asString() const;
+        const std::vector<JsonValue>& asArray() const;
+
+        bool has(const std::string& key) const;
+        const JsonValue& operator[](const std::string& key) const;
+
+        // Member lookups with a fallback for absent keys
+        double get(const std::string& key, double fallback) const;
+        std::string get(const std::string& key, const std::string& fallback) const;
+
+    private:
+        friend class JsonParser;
+
+        Type _type = Type::NUL;
+        bool _boolean = false;
+        double _number = 0.0;
+        std::string _string;
+        std::vector<JsonValue> _array;
+        std::map<std::string, JsonValue> _object;
+    };
+}
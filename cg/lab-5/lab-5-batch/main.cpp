@@ -0,0 +1,217 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "../lab-5/STBImage/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "../lab-5/SoftwareRenderer/Environment.h"
+#include "../lab-5/SoftwareRenderer/ParallelFor.h"
+#include "../lab-5/SoftwareRenderer/PathTracer.h"
+#include "../lab-5/SoftwareRenderer/SoftwareRenderer.h"
+#include "../lab-5/SoftwareRenderer/TileScheduler.h"
+
+#include "BatchJob.h"
+#include "ImageWriter.h"
+
+using namespace DirectX;
+using namespace rendering::software;
+
+namespace {
+    struct LoadedEnvironment {
+        Texture2D _equirect;
+        EnvironmentMaps _maps;
+    };
+
+    void printUsage() {
+        printf("usage: lab-5-batch [--jobs file.json] [--threads N] [--bake-samples N] [--option value ...]\n"
+               "options (override every job): --name --environment --output --backend raster|path --width --height\n"
+               "  --frames --samples --camera-pos x,y,z --camera-dir x,y,z --orbit degrees --color r,g,b\n"
+               "  --roughness --metalness --exposure\n"
+               "--threads: threads of all jobs together, every hardware thread by default\n");
+    }
+
+    Texture2D loadEquirect(const std::string& path) {
+        int x, y, channels_in_file;
+        float* data = stbi_loadf(path.c_str(), &x, &y, &channels_in_file, STBI_rgb_alpha);
+        if (!data) {
+            throw std::runtime_error("cannot load environment " + path);
+        }
+        Texture2D equirect(x, y);
+        for (int j = 0; j < y; ++j) {
+            for (int i = 0; i < x; ++i) {
+                const float* texel = data + 4 * ((size_t)j * x + i);
+                equirect.at(i, j) = XMFLOAT4(texel[0], texel[1], texel[2], texel[3]);
+            }
+        }
+        stbi_image_free(data);
+        return equirect;
+    }
+
+    SceneState makeScene(const batch::RenderJob& job, size_t frame) {
+        XMMATRIX orbit = XMMatrixRotationY(XMConvertToRadians(job._orbit * frame));
+        XMVECTOR pos = XMVector3Transform(XMLoadFloat3(&job._camera_pos), orbit);
+        XMVECTOR dir = XMVector3TransformNormal(XMLoadFloat3(&job._camera_dir), orbit);
+
+        SceneState scene;
+        scene._camera = rendering::Camera(XMVectorSetW(pos, 0.0f), dir);
+        scene._sphere_color_rgb[0] = job._color.x;
+        scene._sphere_color_rgb[1] = job._color.y;
+        scene._sphere_color_rgb[2] = job._color.z;
+        scene._roughness = job._roughness;
+        scene._metalness = job._metalness;
+        scene._exposure_scale = job._exposure;
+        return scene;
+    }
+
+    std::string framePath(const batch::RenderJob& job, size_t frame, const char* extension) {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "_%04zu.%s", frame, extension);
+        return job._output + suffix;
+    }
+
+    // Renders every frame of a job and prints one CSV line per frame
+    bool runJob(const batch::RenderJob& job, const LoadedEnvironment& environment, std::mutex& output_mutex) {
+        std::unique_ptr<SoftwareRenderer> renderer;
+        std::unique_ptr<PathTracer> path_tracer;
+        if (job._backend == batch::Backend::RASTER) {
+            renderer = std::make_unique<SoftwareRenderer>(job._width, job._height, environment._maps);
+        } else {
+            PathTracerDesc desc;
+            desc._samples_per_pass = std::min(job._samples, desc._samples_per_pass);
+            path_tracer = std::make_unique<PathTracer>(job._width, job._height, environment._equirect, desc);
+        }
+
+        std::filesystem::path parent = std::filesystem::path(job._output).parent_path();
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent);
+        }
+
+        bool ok = true;
+        std::vector<uint8_t> ldr;
+        for (size_t frame = 0; frame < job._frames; ++frame) {
+            SceneState scene = makeScene(job, frame);
+            auto start = std::chrono::high_resolution_clock::now();
+            const FrameBuffer* hdr;
+            FrameStats stats;
+            if (renderer) {
+                stats = renderer->render(scene);
+                hdr = &renderer->getHDR();
+                ldr = renderer->getLDR();
+            } else {
+                path_tracer->reset(scene);
+                while (path_tracer->getSamplesPerPixel() < job._samples) {
+                    path_tracer->accumulate();
+                }
+                hdr = &path_tracer->getImage();
+                auto tone_mapping_start = std::chrono::high_resolution_clock::now();
+                toneMap(*hdr, scene._exposure_scale, ldr);
+                stats._tone_mapping_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - tone_mapping_start).count();
+                stats._total_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                stats._raster_ms = stats._total_ms - stats._tone_mapping_ms;
+            }
+
+            auto write_start = std::chrono::high_resolution_clock::now();
+            bool written = batch::writePng(framePath(job, frame, "png"), job._width, job._height, ldr) &&
+                batch::writeHdr(framePath(job, frame, "hdr"), job._width, job._height, hdr->_color);
+            float write_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - write_start).count();
+            ok = ok && written;
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            printf("%s,%zu,%s,%.3f,%.3f,%.3f,%.3f,%zu,%zu%s\n", job._name.c_str(), frame, job._backend == batch::Backend::RASTER ? "raster" : "path",
+                stats._total_ms, stats._raster_ms, stats._tone_mapping_ms, write_ms, stats._raster._triangles, stats._raster._pixels, written ? "" : ",write failed");
+            fflush(stdout);
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char** argv) {
+    try {
+        std::string jobs_path;
+        size_t threads = 0;
+        unsigned bake_samples = 0;
+        std::vector<std::pair<std::string, std::string>> overrides;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return 0;
+            }
+            if (arg.compare(0, 2, "--") != 0 || i + 1 >= argc) {
+                printUsage();
+                return 1;
+            }
+            std::string key = arg.substr(2);
+            std::string value = argv[++i];
+            if (key == "jobs") {
+                jobs_path = value;
+            } else if (key == "threads") {
+                threads = std::stoul(value);
+            } else if (key == "bake-samples") {
+                bake_samples = (unsigned)std::stoul(value);
+            } else {
+                overrides.emplace_back(key, value);
+            }
+        }
+
+        std::vector<batch::RenderJob> jobs = jobs_path.empty() ? std::vector<batch::RenderJob>(1) : batch::parseJobs(batch::JsonValue::parseFile(jobs_path));
+        for (auto& job : jobs) {
+            for (const auto& option : overrides) {
+                if (!batch::applyOption(job, option.first, option.second)) {
+                    fprintf(stderr, "unknown option --%s\n", option.first.c_str());
+                    printUsage();
+                    return 1;
+                }
+            }
+        }
+
+        // Each environment is loaded and baked once and then shared read-only by the jobs
+        EnvironmentBakeDesc bake_desc;
+        if (bake_samples > 0) {
+            bake_desc._prefiltered_samples = bake_samples;
+            bake_desc._preintegrated_samples = bake_samples;
+        }
+        std::map<std::string, std::unique_ptr<LoadedEnvironment>> environments;
+        for (const auto& job : jobs) {
+            auto& environment = environments[job._environment];
+            if (!environment) {
+                environment = std::make_unique<LoadedEnvironment>();
+                environment->_equirect = loadEquirect(job._environment);
+            }
+            if (job._backend == batch::Backend::RASTER && environment->_maps._sky.getSize() == 0) {
+                auto start = std::chrono::high_resolution_clock::now();
+                environment->_maps = bakeEnvironment(environment->_equirect, bake_desc);
+                fprintf(stderr, "baked %s in %.1f s\n", job._environment.c_str(), std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count());
+            }
+        }
+
+        printf("job,frame,backend,total_ms,render_ms,tone_mapping_ms,write_ms,triangles,pixels\n");
+        std::mutex output_mutex;
+        std::vector<char> results(jobs.size(), 0);
+        // Both backends are multithreaded, so the jobs that run side by side split the threads between them
+        const size_t total_threads = threads > 0 ? threads : getThreadBudget();
+        const size_t job_workers = std::max<size_t>(1, std::min(total_threads, jobs.size()));
+        TileScheduler scheduler(job_workers);
+        scheduler.run(jobs.size(), [&](size_t index, size_t worker) {
+            setThreadBudget(total_threads / job_workers + (worker < total_threads % job_workers ? 1 : 0));
+            try {
+                results[index] = runJob(jobs[index], *environments.at(jobs[index]._environment), output_mutex);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(output_mutex);
+                fprintf(stderr, "%s: %s\n", jobs[index]._name.c_str(), e.what());
+            }
+        });
+
+        return std::all_of(results.begin(), results.end(), [](char ok) { return ok != 0; }) ? 0 : 1;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -16,6 +16,10 @@ namespace rendering {
         return _pos;
     }
 
+    XMVECTOR Camera::getDirection() const {
+        return _dir;
+    }
+
     void Camera::move(const XMVECTOR& dv) {
         _pos += dv;
     }
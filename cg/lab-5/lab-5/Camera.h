@@ -11,6 +11,8 @@ namespace rendering {
 
         DirectX::XMMATRIX getViewMatrix() const;
         DirectX::XMVECTOR getPosition() const;
+        // Normalized view direction
+        DirectX::XMVECTOR getDirection() const;
 
         void move(const DirectX::XMVECTOR& dv = { 0.0f, 0.0f, 0.0f });
         void moveNormal(float dn);
@@ -14,24 +14,51 @@ namespace rendering {
         DirectX::XMFLOAT4 _camera_pos;
     };
 
-    __declspec(align(16))
-    struct SurfacePropsCB {
+    struct alignas(16) SurfacePropsCB {
         DirectX::XMFLOAT4 _base_color;
         float _roughness;
         float _metalness;
     };
 
-    __declspec(align(16))
-    struct LightsCB {
+    struct alignas(16) LightsCB {
         DirectX::XMFLOAT4 _light_pos[N_LIGHTS];
         DirectX::XMFLOAT4 _light_color[N_LIGHTS];
         DirectX::XMFLOAT4 _light_attenuation[N_LIGHTS];
         float _light_intensity[3 * N_LIGHTS];
     };
 
-    __declspec(align(16))
-    struct AdaptationCB {
+    // One light of the clustered light buffer, see ClusteredLight in shaders.hlsl
+    struct ClusteredLight {
+        // w: range, the light is faded out towards it
+        DirectX::XMFLOAT4 _position;
+        // Color times intensity
+        DirectX::XMFLOAT4 _radiance;
+        // Constant and quadratic attenuation
+        DirectX::XMFLOAT4 _attenuation;
+    };
+
+    struct alignas(16) ClusterGridCB {
+        // _11 and _22 of the projection, tiles along x and y
+        DirectX::XMFLOAT4 _projection_tiles;
+        // Near z, slices over log(far z / near z), slices
+        DirectX::XMFLOAT4 _depth_slices;
+    };
+
+    struct alignas(16) AdaptationCB {
         float _exposure_scale;
         float _adapted_log_luminance;
+        DirectX::XMFLOAT2 _uv_scale;
+    };
+
+    struct alignas(16) TemporalResolveCB {
+        DirectX::XMMATRIX _inv_view_projection;
+        DirectX::XMMATRIX _prev_view_projection;
+        DirectX::XMFLOAT2 _jitter_uv;
+        float _current_weight;
+    };
+
+    struct alignas(16) MeshDecodeCB {
+        DirectX::XMFLOAT4 _position_scale;
+        DirectX::XMFLOAT4 _position_offset;
     };
 }
@@ -0,0 +1,104 @@
+#include "CubeSphere.h"
+
+#include <cmath>
+#include <unordered_map>
+
+#include "SphereTessellation.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace {
+        struct Face {
+            int _normal[3];
+            int _u[3];
+            int _v[3];
+        };
+
+        const Face FACES[6] = {
+            { { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+            { { -1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+            { { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+            { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+            { { 0, 0, 1 }, { -1, 0, 0 }, { 0, 1, 0 } },
+            { { 0, 0, -1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+        };
+    }
+
+    CubeSphere::CubeSphere(float radius, size_t resolution, bool outer_normals)
+        : _resolution(resolution) {
+        const int n = (int)resolution;
+        const int side = 2 * n + 1;
+
+        // Grid points on the cube edges belong to two or three faces. They are keyed by their
+        // position on the [-n, n]^3 lattice, so every face reuses the same vertex
+        std::unordered_map<int64_t, unsigned> lattice;
+        auto vertex = [&](const Face& face, int i, int j) {
+            int a = 2 * i - n;
+            int b = 2 * j - n;
+            int p[3];
+            for (int k = 0; k < 3; ++k) {
+                p[k] = face._normal[k] * n + face._u[k] * a + face._v[k] * b;
+            }
+            int64_t key = ((int64_t)(p[0] + n) * side + (p[1] + n)) * side + (p[2] + n);
+            auto it = lattice.find(key);
+            if (it != lattice.end()) {
+                return it->second;
+            }
+
+            float tu = tanf(XM_PIDIV4 * a / n);
+            float tv = tanf(XM_PIDIV4 * b / n);
+            XMVECTOR dir = XMVectorSet(
+                face._normal[0] + face._u[0] * tu + face._v[0] * tv,
+                face._normal[1] + face._u[1] * tu + face._v[1] * tv,
+                face._normal[2] + face._u[2] * tu + face._v[2] * tv, 0.0f);
+            XMVECTOR normal = XMVector3Normalize(dir);
+            SimpleVertex v;
+            XMStoreFloat3(&v._pos, normal * radius);
+            XMStoreFloat3(&v._nor, normal);
+            _vertices.push_back(v);
+            unsigned index = (unsigned)_vertices.size() - 1;
+            lattice.emplace(key, index);
+            return index;
+        };
+
+        _indices.reserve(36 * resolution * resolution);
+        for (const Face& face : FACES) {
+            for (int j = 0; j < n; ++j) {
+                for (int i = 0; i < n; ++i) {
+                    unsigned v00 = vertex(face, i, j);
+                    unsigned v10 = vertex(face, i + 1, j);
+                    unsigned v01 = vertex(face, i, j + 1);
+                    unsigned v11 = vertex(face, i + 1, j + 1);
+                    // Split along the diagonal that points at the face center, so the four quadrants mirror each other
+                    if ((2 * i + 1 - n) * (2 * j + 1 - n) > 0) {
+                        _indices.insert(_indices.end(), { v00, v10, v01, v10, v11, v01 });
+                    } else {
+                        _indices.insert(_indices.end(), { v00, v10, v11, v00, v11, v01 });
+                    }
+                }
+            }
+        }
+        orientSphereTriangles(_vertices, _indices, outer_normals);
+    }
+
+    CubeSphere CubeSphere::fromMaxError(float radius, float max_error, bool outer_normals) {
+        size_t resolution = findResolution(1, MAX_RESOLUTION, max_error, [&](size_t resolution) {
+            CubeSphere sphere(radius, resolution, outer_normals);
+            return sphereChordError(sphere._vertices, sphere._indices, radius);
+        });
+        return CubeSphere(radius, resolution, outer_normals);
+    }
+
+    const std::vector<SimpleVertex>& CubeSphere::getVertices() const {
+        return _vertices;
+    }
+
+    const std::vector<unsigned>& CubeSphere::getIndices() const {
+        return _indices;
+    }
+
+    size_t CubeSphere::getResolution() const {
+        return _resolution;
+    }
+}
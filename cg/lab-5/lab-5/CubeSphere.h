@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "SimpleVertex.h"
+
+namespace rendering {
+    // Cube with an n x n grid on every face, projected onto the sphere. The grid is spaced by equal
+    // angles (tan warp) rather than equal distances, which keeps cells near the face corners from shrinking
+    class CubeSphere {
+    public:
+        static const size_t MAX_RESOLUTION = 1024;
+
+        CubeSphere(float radius, size_t resolution, bool outer_normals);
+
+        // Lowest resolution with sphereChordError <= max_error
+        static CubeSphere fromMaxError(float radius, float max_error, bool outer_normals);
+
+        const std::vector<SimpleVertex>& getVertices() const;
+        const std::vector<unsigned>& getIndices() const;
+        size_t getResolution() const;
+
+    private:
+        std::vector<SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+        size_t _resolution;
+    };
+}
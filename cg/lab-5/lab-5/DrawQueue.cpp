@@ -0,0 +1,193 @@
+#include "DrawQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace rendering {
+    namespace {
+        const size_t RADIX_BITS = 8;
+        const size_t RADIX_SIZE = 1 << RADIX_BITS;
+        const size_t KEY_DIGITS = 64 / RADIX_BITS;
+        // Below this the histograms cost more than they save
+        const size_t INSERTION_SORT_SIZE = 32;
+        const uint32_t MIN_STATE_SLOT_BITS = 6;
+
+        uint64_t field(uint32_t value, uint32_t bits, uint32_t shift) {
+            const uint32_t max_value = (1u << bits) - 1;
+            assert(value <= max_value);
+            return (uint64_t)std::min(value, max_value) << shift;
+        }
+
+        // Handles are pointers to aligned objects and share their low bits, so slots are taken from the high
+        // bits of a multiplicative hash. Every word has its own multiplier, the products do not wait on each other
+        uint64_t hashState(const std::array<uintptr_t, DrawStateIds::MAX_STATE_SIZE + 1>& state) {
+            static const uint64_t MULTIPLIERS[] = {
+                0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull, 0xff51afd7ed558ccdull,
+            };
+            static_assert(sizeof(MULTIPLIERS) / sizeof(MULTIPLIERS[0]) == DrawStateIds::MAX_STATE_SIZE + 1, "a multiplier per word");
+            uint64_t hash = 0;
+            for (size_t i = 0; i < state.size(); ++i) {
+                hash += (uint64_t)state[i] * MULTIPLIERS[i];
+            }
+            return (hash ^ (hash >> 32)) * 0x9e3779b97f4a7c15ull;
+        }
+
+        // std::array compares with a memcmp call, which costs more than the rest of a lookup
+        bool isSameState(const std::array<uintptr_t, DrawStateIds::MAX_STATE_SIZE + 1>& a, const std::array<uintptr_t, DrawStateIds::MAX_STATE_SIZE + 1>& b) {
+            uintptr_t difference = 0;
+            for (size_t i = 0; i < a.size(); ++i) {
+                difference |= a[i] ^ b[i];
+            }
+            return difference == 0;
+        }
+
+        void insertionSort(std::vector<DrawPacket>& packets) {
+            for (size_t i = 1; i < packets.size(); ++i) {
+                const DrawPacket packet = packets[i];
+                size_t j = i;
+                for (; j > 0 && packets[j - 1]._key > packet._key; --j) {
+                    packets[j] = packets[j - 1];
+                }
+                packets[j] = packet;
+            }
+        }
+    }
+
+    uint32_t quantizeDrawDepth(float depth) {
+        const float max_depth = (float)((1u << DRAW_KEY_DEPTH_BITS) - 1);
+        // Also maps NaN to 0
+        const float clamped = depth > 0.0f ? std::min(depth, 1.0f) : 0.0f;
+        // 1 * max_depth + 0.5 rounds up to 2^24 in float
+        return (uint32_t)std::min(clamped * max_depth + 0.5f, max_depth);
+    }
+
+    uint64_t makeOpaqueDrawKey(const DrawKeyFields& fields) {
+        return field(fields._pass, DRAW_KEY_PASS_BITS, 60) | field(fields._shader, DRAW_KEY_SHADER_BITS, 50)
+            | field(fields._material, DRAW_KEY_MATERIAL_BITS, 36) | field(fields._resources, DRAW_KEY_RESOURCE_BITS, 24)
+            | quantizeDrawDepth(fields._depth);
+    }
+
+    uint64_t makeBlendedDrawKey(const DrawKeyFields& fields) {
+        const uint32_t inverted_depth = ((1u << DRAW_KEY_DEPTH_BITS) - 1) - quantizeDrawDepth(fields._depth);
+        return field(fields._pass, DRAW_KEY_PASS_BITS, 60) | field(inverted_depth, DRAW_KEY_DEPTH_BITS, 36)
+            | field(fields._shader, DRAW_KEY_SHADER_BITS, 26) | field(fields._material, DRAW_KEY_MATERIAL_BITS, 12)
+            | field(fields._resources, DRAW_KEY_RESOURCE_BITS, 0);
+    }
+
+    uint32_t getDrawKeyPass(uint64_t key) {
+        return (uint32_t)(key >> 60);
+    }
+
+    DrawStateIds::DrawStateIds(uint32_t bits)
+        : _max_id((1u << bits) - 1), _slots((size_t)1 << MIN_STATE_SLOT_BITS, 0), _slot_shift(64 - MIN_STATE_SLOT_BITS) {
+        assert(bits > 0 && bits < 32);
+    }
+
+    uint32_t DrawStateIds::getId(const uintptr_t* state, size_t size) {
+        assert(size <= MAX_STATE_SIZE);
+        // Word by word for the same reason as isSameState, a copy of a variable size becomes a memcpy call
+        State key;
+        key[0] = size;
+        for (size_t i = 0; i < MAX_STATE_SIZE; ++i) {
+            key[i + 1] = i < size ? state[i] : 0;
+        }
+        const size_t slot = findSlot(key);
+        if (_slots[slot] != 0) {
+            return std::min(_slots[slot] - 1, _max_id);
+        }
+        assert(_states.size() <= _max_id);
+        const uint32_t id = (uint32_t)std::min(_states.size(), (size_t)_max_id);
+        _states.push_back(key);
+        _slots[slot] = (uint32_t)_states.size();
+        if (2 * _states.size() > _slots.size()) {
+            grow();
+        }
+        return id;
+    }
+
+    size_t DrawStateIds::getCount() const {
+        return _states.size();
+    }
+
+    void DrawStateIds::clear() {
+        _states.clear();
+        std::fill(_slots.begin(), _slots.end(), 0);
+    }
+
+    // The slot holding state, or the empty slot where it belongs
+    size_t DrawStateIds::findSlot(const State& state) const {
+        const size_t mask = _slots.size() - 1;
+        for (size_t slot = (size_t)(hashState(state) >> _slot_shift);; slot = (slot + 1) & mask) {
+            const uint32_t entry = _slots[slot];
+            if (entry == 0 || isSameState(_states[entry - 1], state)) {
+                return slot;
+            }
+        }
+    }
+
+    void DrawStateIds::grow() {
+        _slots.assign(2 * _slots.size(), 0);
+        --_slot_shift;
+        for (size_t i = 0; i < _states.size(); ++i) {
+            _slots[findSlot(_states[i])] = (uint32_t)(i + 1);
+        }
+    }
+
+    // All histograms come from one read of the keys, then every byte that varies scatters once
+    void radixSortDrawPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+        const size_t count = packets.size();
+        scratch.resize(count);
+        if (count <= INSERTION_SORT_SIZE) {
+            insertionSort(packets);
+            return;
+        }
+
+        size_t histograms[KEY_DIGITS][RADIX_SIZE];
+        memset(histograms, 0, sizeof(histograms));
+        for (const DrawPacket& packet : packets) {
+            for (size_t digit = 0; digit < KEY_DIGITS; ++digit) {
+                ++histograms[digit][(packet._key >> (digit * RADIX_BITS)) & (RADIX_SIZE - 1)];
+            }
+        }
+
+        DrawPacket* p_src = packets.data();
+        DrawPacket* p_dst = scratch.data();
+        for (size_t digit = 0; digit < KEY_DIGITS; ++digit) {
+            size_t* histogram = histograms[digit];
+            const size_t shift = digit * RADIX_BITS;
+            if (histogram[(p_src[0]._key >> shift) & (RADIX_SIZE - 1)] == count) {
+                continue;
+            }
+            size_t offset = 0;
+            for (size_t bucket = 0; bucket < RADIX_SIZE; ++bucket) {
+                const size_t bucket_count = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucket_count;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                p_dst[histogram[(p_src[i]._key >> shift) & (RADIX_SIZE - 1)]++] = p_src[i];
+            }
+            std::swap(p_src, p_dst);
+        }
+        if (p_src != packets.data()) {
+            packets.swap(scratch);
+        }
+    }
+
+    void DrawQueue::clear() {
+        _packets.clear();
+    }
+
+    void DrawQueue::push(uint64_t key, uint32_t draw) {
+        _packets.push_back({ key, draw });
+    }
+
+    void DrawQueue::sort() {
+        radixSortDrawPackets(_packets, _scratch);
+    }
+
+    const std::vector<DrawPacket>& DrawQueue::getPackets() const {
+        return _packets;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rendering {
+    // Fields of a 64 bit draw sort key, most significant first:
+    //   opaque:  pass 4 | shader 10 | material 14 | resources 12 | depth 24, front to back
+    //   blended: pass 4 | depth 24, back to front | shader 10 | material 14 | resources 12
+    // Sorted keys draw pass by pass. Within an opaque pass draws with the same shaders, then the same material
+    // and resources follow each other, blended passes keep the order blending needs. A value too large for its
+    // field asserts and is clamped to the largest one, so it can never spill into the field above
+    struct DrawKeyFields {
+        uint32_t _pass = 0;
+        uint32_t _shader = 0;
+        uint32_t _material = 0;
+        uint32_t _resources = 0;
+        // View depth over the far plane distance, clamped to [0, 1]
+        float _depth = 0.0f;
+    };
+
+    const uint32_t DRAW_KEY_PASS_BITS = 4;
+    const uint32_t DRAW_KEY_SHADER_BITS = 10;
+    const uint32_t DRAW_KEY_MATERIAL_BITS = 14;
+    const uint32_t DRAW_KEY_RESOURCE_BITS = 12;
+    const uint32_t DRAW_KEY_DEPTH_BITS = 24;
+
+    uint32_t quantizeDrawDepth(float depth);
+    uint64_t makeOpaqueDrawKey(const DrawKeyFields& fields);
+    uint64_t makeBlendedDrawKey(const DrawKeyFields& fields);
+    uint32_t getDrawKeyPass(uint64_t key);
+
+    // Small ids for the state a draw binds, e.g. a shader pair or a set of resource views, handed out in the
+    // order the states are first seen and kept until clear, so the same state sorts the same way every frame.
+    // Once bits cannot hold another id, new states assert and share the largest id
+    class DrawStateIds {
+    public:
+        static const size_t MAX_STATE_SIZE = 4;
+
+        explicit DrawStateIds(uint32_t bits);
+
+        // state holds up to MAX_STATE_SIZE handles, pointers cast to uintptr_t
+        uint32_t getId(const uintptr_t* state, size_t size);
+        size_t getCount() const;
+        void clear();
+
+    private:
+        // The size first, so a state is never equal to a longer one that ends in zeros
+        using State = std::array<uintptr_t, MAX_STATE_SIZE + 1>;
+
+        size_t findSlot(const State& state) const;
+        void grow();
+
+        uint32_t _max_id;
+        // In the order they were first seen, the n-th state has id min(n, _max_id)
+        std::vector<State> _states;
+        // Open addressing with linear probing, at most half full. Index into _states plus one, zero when empty
+        std::vector<uint32_t> _slots;
+        uint32_t _slot_shift;
+    };
+
+    struct DrawPacket {
+        uint64_t _key;
+        // Index of the draw in the caller's own list
+        uint32_t _draw;
+    };
+
+    // Stable LSD radix sort on the key, one byte per pass. Bytes that are the same in every key are skipped,
+    // so unused fields cost nothing. scratch ends up with packets.size() elements of no particular value
+    void radixSortDrawPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+    // Packets of one frame, sorted before submission
+    class DrawQueue {
+    public:
+        void clear();
+        void push(uint64_t key, uint32_t draw);
+        void sort();
+
+        const std::vector<DrawPacket>& getPackets() const;
+
+    private:
+        std::vector<DrawPacket> _packets;
+        std::vector<DrawPacket> _scratch;
+    };
+}
@@ -0,0 +1,261 @@
+#include "GeometryRegistry.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "MeshOptimizer.h"
+#include "../ParametricSurface.h"
+#include "../Sphere.h"
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            // The cube map face and full screen passes read positions only
+            const SimpleVertex CUBE_FACE_VERTICES[6][4] = {
+                { { { 0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { 0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } } },
+                { { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { -0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } } },
+                { { { -0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { 0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } } },
+                { { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { 0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } } },
+                { { { -0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { 0.5f, 0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, -0.5f, 0.5f }, { 0.0f, 0.0f, 0.0f } } },
+                { { { 0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { 0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } },
+                    { { -0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } }, { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } } }
+            };
+
+            const SimpleVertex QUAD_VERTICES[4] = {
+                { { 0.0f, 0.0f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                { { 0.0f, 1.0f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                { { 1.0f, 1.0f, 0.5f }, { 0.0f, 0.0f, 0.0f } },
+                { { 1.0f, 0.0f, 0.5f }, { 0.0f, 0.0f, 0.0f } }
+            };
+
+            const unsigned QUAD_INDICES[6] = {
+                0, 1, 2,
+                2, 3, 0
+            };
+        }
+
+        bool MeshKey::operator==(const MeshKey& other) const {
+            return _kind == other._kind && _radius == other._radius && _length == other._length && _n_theta == other._n_theta && _n_phi == other._n_phi
+                && _level_count == other._level_count && _flags == other._flags;
+        }
+
+        size_t MeshKeyHash::operator()(const MeshKey& key) const {
+            uint32_t radius_bits;
+            uint32_t length_bits;
+            memcpy(&radius_bits, &key._radius, sizeof(radius_bits));
+            memcpy(&length_bits, &key._length, sizeof(length_bits));
+            const uint32_t fields[] = { (uint32_t)key._kind, radius_bits, length_bits, key._n_theta, key._n_phi, key._level_count, key._flags };
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (uint32_t field : fields) {
+                hash = (hash ^ field) * 0x100000001b3ull;
+            }
+            return (size_t)hash;
+        }
+
+        MeshKey sphereKey(float radius, size_t n_theta, size_t n_phi, bool outer_normals, bool correct_orientation) {
+            MeshKey key;
+            key._kind = MeshKind::SPHERE;
+            key._radius = radius;
+            key._n_theta = (uint32_t)n_theta;
+            key._n_phi = (uint32_t)n_phi;
+            key._flags = (outer_normals ? (uint32_t)MESH_OUTER_NORMALS : 0u) | (correct_orientation ? (uint32_t)MESH_CORRECT_ORIENTATION : 0u);
+            return key;
+        }
+
+        const GeometryRegistry::Segment& GeometryRegistry::allocate(const MeshKey& key, size_t vertex_count, size_t index_count,
+            const SimpleVertex* external_vertices, const unsigned* external_indices) {
+            Segment segment;
+            segment._handle._first_index = (uint32_t)_index_count;
+            segment._handle._index_count = (uint32_t)index_count;
+            segment._handle._base_vertex = (int32_t)_vertex_count;
+            segment._handle._vertex_count = (uint32_t)vertex_count;
+            segment._external_vertices = external_vertices;
+            segment._external_indices = external_indices;
+            if (!external_vertices) {
+                segment._stored_vertex = _vertices.size();
+                segment._stored_index = _indices.size();
+                _vertices.resize(_vertices.size() + vertex_count);
+                _indices.resize(_indices.size() + index_count);
+            }
+            _vertex_count += vertex_count;
+            _index_count += index_count;
+            _meshes.emplace(key, segment._handle);
+            _segments.push_back(segment);
+            _dirty = true;
+            return _segments.back();
+        }
+
+        const GeometryRegistry::Segment& GeometryRegistry::findSegment(const MeshHandle& handle) const {
+            // Few meshes, and only looked up while loading
+            auto found = std::find_if(_segments.begin(), _segments.end(), [&](const Segment& segment) {
+                return segment._handle._first_index == handle._first_index && segment._handle._base_vertex == handle._base_vertex
+                    && segment._handle._index_count == handle._index_count && segment._handle._vertex_count == handle._vertex_count;
+            });
+            assert(found != _segments.end());
+            return *found;
+        }
+
+        const SimpleVertex* GeometryRegistry::getVertices(const Segment& segment) const {
+            return segment._external_vertices ? segment._external_vertices : _vertices.data() + segment._stored_vertex;
+        }
+
+        const unsigned* GeometryRegistry::getIndices(const Segment& segment) const {
+            return segment._external_indices ? segment._external_indices : _indices.data() + segment._stored_index;
+        }
+
+        MeshHandle GeometryRegistry::add(const MeshKey& key, const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count) {
+            return getOrGenerate(key, vertex_count, index_count, [&](SimpleVertex* vertex_out, unsigned* index_out) {
+                std::copy(vertices, vertices + vertex_count, vertex_out);
+                std::copy(indices, indices + index_count, index_out);
+            });
+        }
+
+        MeshHandle GeometryRegistry::addExternal(const MeshKey& key, const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count) {
+            assert(vertices && indices);
+            auto found = _meshes.find(key);
+            if (found != _meshes.end()) {
+                ++_hits;
+                return found->second;
+            }
+            return allocate(key, vertex_count, index_count, vertices, indices)._handle;
+        }
+
+        MeshHandle GeometryRegistry::getSphere(float radius, size_t n_theta, size_t n_phi, bool outer_normals, bool correct_orientation) {
+            return getOrBuild(sphereKey(radius, n_theta, n_phi, outer_normals, correct_orientation), [&](std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+                Sphere sphere(radius, n_theta, n_phi, outer_normals, correct_orientation);
+                vertices = sphere.getVertices();
+                indices = sphere.getIndices();
+                optimizeMesh(vertices, indices);
+            });
+        }
+
+        MeshHandle GeometryRegistry::getCubeFaces() {
+            MeshKey key;
+            key._kind = MeshKind::CUBE_FACES;
+            return getOrBuild(key, [](std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+                for (size_t face = 0; face < 6; ++face) {
+                    for (unsigned index : QUAD_INDICES) {
+                        indices.push_back((unsigned)vertices.size() + index);
+                    }
+                    vertices.insert(vertices.end(), CUBE_FACE_VERTICES[face], CUBE_FACE_VERTICES[face] + 4);
+                }
+            });
+        }
+
+        MeshHandle GeometryRegistry::getQuad() {
+            MeshKey key;
+            key._kind = MeshKind::QUAD;
+            return getOrBuild(key, [](std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+                vertices.assign(QUAD_VERTICES, QUAD_VERTICES + 4);
+                indices.assign(QUAD_INDICES, QUAD_INDICES + 6);
+            });
+        }
+
+        MeshHandle GeometryRegistry::getTorus(float major_radius, float minor_radius, size_t n_major, size_t n_minor) {
+            MeshKey key;
+            key._kind = MeshKind::TORUS;
+            key._radius = major_radius;
+            key._length = minor_radius;
+            key._n_theta = (uint32_t)n_minor;
+            key._n_phi = (uint32_t)n_major;
+            return getOrGenerate(key, torusVertexCount(n_major, n_minor), torusIndexCount(n_major, n_minor), [&](SimpleVertex* vertices, unsigned* indices) {
+                generateTorus(major_radius, minor_radius, n_major, n_minor, vertices, indices);
+            });
+        }
+
+        MeshHandle GeometryRegistry::getCapsule(float radius, float half_height, size_t n_cap, size_t n_phi) {
+            MeshKey key;
+            key._kind = MeshKind::CAPSULE;
+            key._radius = radius;
+            key._length = half_height;
+            key._n_theta = (uint32_t)n_cap;
+            key._n_phi = (uint32_t)n_phi;
+            return getOrGenerate(key, capsuleVertexCount(n_cap, n_phi), capsuleIndexCount(n_cap, n_phi), [&](SimpleVertex* vertices, unsigned* indices) {
+                generateCapsule(radius, half_height, n_cap, n_phi, vertices, indices);
+            });
+        }
+
+        bool GeometryRegistry::upload(GeometryDevice& device) {
+            if (!_dirty) {
+                return false;
+            }
+            release(device);
+            _vertex_buffer = device.createBuffer(GeometryBufferType::VERTEX, sizeof(SimpleVertex) * _vertex_count);
+            _index_buffer = device.createBuffer(GeometryBufferType::INDEX, sizeof(unsigned) * _index_count);
+            // Runs of stored meshes go up in one write, external ones straight from where they live
+            for (size_t i = 0; i < _segments.size();) {
+                const Segment& first = _segments[i];
+                size_t vertex_count = first._handle._vertex_count;
+                size_t index_count = first._handle._index_count;
+                for (++i; !first._external_vertices && i < _segments.size() && !_segments[i]._external_vertices; ++i) {
+                    vertex_count += _segments[i]._handle._vertex_count;
+                    index_count += _segments[i]._handle._index_count;
+                }
+                if (vertex_count > 0) {
+                    device.writeBuffer(_vertex_buffer, sizeof(SimpleVertex) * first._handle._base_vertex, sizeof(SimpleVertex) * vertex_count, getVertices(first));
+                }
+                if (index_count > 0) {
+                    device.writeBuffer(_index_buffer, sizeof(unsigned) * first._handle._first_index, sizeof(unsigned) * index_count, getIndices(first));
+                }
+            }
+            _dirty = false;
+            return true;
+        }
+
+        void GeometryRegistry::release(GeometryDevice& device) {
+            if (_vertex_buffer) {
+                device.releaseBuffer(_vertex_buffer);
+            }
+            if (_index_buffer) {
+                device.releaseBuffer(_index_buffer);
+            }
+            _vertex_buffer = nullptr;
+            _index_buffer = nullptr;
+            _dirty = !_meshes.empty();
+        }
+
+        void* GeometryRegistry::getVertexBuffer() const {
+            assert(!_dirty);
+            return _vertex_buffer;
+        }
+
+        void* GeometryRegistry::getIndexBuffer() const {
+            assert(!_dirty);
+            return _index_buffer;
+        }
+
+        const SimpleVertex* GeometryRegistry::getVertices(const MeshHandle& handle) const {
+            return getVertices(findSegment(handle));
+        }
+
+        const unsigned* GeometryRegistry::getIndices(const MeshHandle& handle) const {
+            return getIndices(findSegment(handle));
+        }
+
+        size_t GeometryRegistry::getVertexCount() const {
+            return _vertex_count;
+        }
+
+        size_t GeometryRegistry::getIndexCount() const {
+            return _index_count;
+        }
+
+        size_t GeometryRegistry::getStoredByteSize() const {
+            return sizeof(SimpleVertex) * _vertices.size() + sizeof(unsigned) * _indices.size();
+        }
+
+        size_t GeometryRegistry::getMeshCount() const {
+            return _meshes.size();
+        }
+
+        size_t GeometryRegistry::getHitCount() const {
+            return _hits;
+        }
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        enum class MeshKind : uint32_t {
+            SPHERE,
+            SPHERE_LOD_CHAIN,
+            // The six faces of a cube around the origin, four vertices and six indices each
+            CUBE_FACES,
+            // Unit square in the xy plane, for full screen bakes
+            QUAD,
+            TORUS,
+            CAPSULE,
+        };
+
+        enum MeshKeyFlags : uint32_t {
+            MESH_OUTER_NORMALS = 1 << 0,
+            MESH_CORRECT_ORIENTATION = 1 << 1,
+        };
+
+        // Everything the output of a generator depends on, unused fields stay zero
+        struct MeshKey {
+            MeshKind _kind = MeshKind::SPHERE;
+            float _radius = 0.0f;
+            // Torus tube radius, capsule half height
+            float _length = 0.0f;
+            uint32_t _n_theta = 0;
+            uint32_t _n_phi = 0;
+            uint32_t _level_count = 0;
+            uint32_t _flags = 0;
+
+            bool operator==(const MeshKey& other) const;
+        };
+
+        struct MeshKeyHash {
+            size_t operator()(const MeshKey& key) const;
+        };
+
+        MeshKey sphereKey(float radius, size_t n_theta, size_t n_phi, bool outer_normals, bool correct_orientation);
+
+        // Where a mesh lives in the arena. Indices are local to the mesh, so a draw is
+        // DrawIndexed(_index_count, _first_index, _base_vertex)
+        struct MeshHandle {
+            uint32_t _first_index = 0;
+            uint32_t _index_count = 0;
+            int32_t _base_vertex = 0;
+            uint32_t _vertex_count = 0;
+        };
+
+        enum class GeometryBufferType {
+            VERTEX,
+            INDEX,
+        };
+
+        // What the registry needs from the GPU. Buffers are opaque, Renderer creates ID3D11Buffers
+        class GeometryDevice {
+        public:
+            virtual ~GeometryDevice() = default;
+            // Buffer of byte_size bytes, its contents come from writeBuffer
+            virtual void* createBuffer(GeometryBufferType type, size_t byte_size) = 0;
+            // The ranges written by one upload do not overlap and cover the whole buffer
+            virtual void writeBuffer(void* buffer, size_t byte_offset, size_t byte_size, const void* data) = 0;
+            virtual void releaseBuffer(void* buffer) = 0;
+        };
+
+        // Builds every mesh once per key and packs all static geometry into one vertex and one index arena.
+        // Meshes are only appended, so handles stay valid when the arena grows and is uploaded again.
+        // A mesh is either stored in the registry or, from addExternal, read from memory the caller owns
+        class GeometryRegistry {
+        public:
+            GeometryRegistry() = default;
+            GeometryRegistry(const GeometryRegistry&) = delete;
+            GeometryRegistry& operator=(const GeometryRegistry&) = delete;
+
+            // build(vertices, indices) only runs when the key is not registered yet
+            template <typename F>
+            MeshHandle getOrBuild(const MeshKey& key, const F& build) {
+                auto found = _meshes.find(key);
+                if (found != _meshes.end()) {
+                    ++_hits;
+                    return found->second;
+                }
+                std::vector<SimpleVertex> vertices;
+                std::vector<unsigned> indices;
+                build(vertices, indices);
+                return add(key, vertices.data(), vertices.size(), indices.data(), indices.size());
+            }
+
+            // Generators that know their sizes up front write straight into the arena, generate(vertices, indices)
+            // gets vertex_count and index_count elements and only runs when the key is not registered yet
+            template <typename F>
+            MeshHandle getOrGenerate(const MeshKey& key, size_t vertex_count, size_t index_count, const F& generate) {
+                auto found = _meshes.find(key);
+                if (found != _meshes.end()) {
+                    ++_hits;
+                    return found->second;
+                }
+                const Segment& segment = allocate(key, vertex_count, index_count, nullptr, nullptr);
+                generate(_vertices.data() + segment._stored_vertex, _indices.data() + segment._stored_index);
+                return segment._handle;
+            }
+
+            // Returns the registered mesh if there is one, the data is not even looked at then
+            MeshHandle add(const MeshKey& key, const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count);
+            // Like add without the copy, for meshes that already sit in memory such as a mapped cache file.
+            // Every upload reads the data again, so it has to stay valid until release
+            MeshHandle addExternal(const MeshKey& key, const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count);
+
+            // Cache optimized
+            MeshHandle getSphere(float radius, size_t n_theta, size_t n_phi, bool outer_normals, bool correct_orientation);
+            MeshHandle getCubeFaces();
+            MeshHandle getQuad();
+            MeshHandle getTorus(float major_radius, float minor_radius, size_t n_major, size_t n_minor);
+            MeshHandle getCapsule(float radius, float half_height, size_t n_cap, size_t n_phi);
+
+            // Creates the arena buffers again if anything was added since the last upload
+            bool upload(GeometryDevice& device);
+            void release(GeometryDevice& device);
+
+            void* getVertexBuffer() const;
+            void* getIndexBuffer() const;
+
+            // Contents of a registered mesh, wherever it is stored
+            const SimpleVertex* getVertices(const MeshHandle& handle) const;
+            const unsigned* getIndices(const MeshHandle& handle) const;
+            // Arena sizes in elements
+            size_t getVertexCount() const;
+            size_t getIndexCount() const;
+            // Bytes the registry holds itself, external meshes are not counted
+            size_t getStoredByteSize() const;
+            size_t getMeshCount() const;
+            // Requests answered by an already registered mesh
+            size_t getHitCount() const;
+
+        private:
+            struct Segment {
+                MeshHandle _handle;
+                // Null for stored meshes, they start at _stored_vertex and _stored_index of _vertices and _indices
+                const SimpleVertex* _external_vertices = nullptr;
+                const unsigned* _external_indices = nullptr;
+                size_t _stored_vertex = 0;
+                size_t _stored_index = 0;
+            };
+
+            const Segment& allocate(const MeshKey& key, size_t vertex_count, size_t index_count, const SimpleVertex* external_vertices,
+                const unsigned* external_indices);
+            const Segment& findSegment(const MeshHandle& handle) const;
+            const SimpleVertex* getVertices(const Segment& segment) const;
+            const unsigned* getIndices(const Segment& segment) const;
+
+            std::unordered_map<MeshKey, MeshHandle, MeshKeyHash> _meshes;
+            // In arena order
+            std::vector<Segment> _segments;
+            size_t _vertex_count = 0;
+            size_t _index_count = 0;
+            std::vector<SimpleVertex> _vertices;
+            std::vector<unsigned> _indices;
+            size_t _hits = 0;
+
+            bool _dirty = false;
+            void* _vertex_buffer = nullptr;
+            void* _index_buffer = nullptr;
+        };
+    }
+}
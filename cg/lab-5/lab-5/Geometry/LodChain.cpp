@@ -0,0 +1,146 @@
+#include "LodChain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "../Sphere.h"
+#include "../SphereTessellation.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        LodChain LodChain::fromData(const LodLevel* levels, size_t level_count, const SimpleVertex* vertices, size_t vertex_count,
+            const unsigned* indices, size_t index_count, float bounding_radius) {
+            LodChain chain;
+            chain._levels.assign(levels, levels + level_count);
+            chain._vertices.assign(vertices, vertices + vertex_count);
+            chain._indices.assign(indices, indices + index_count);
+            chain._bounding_radius = bounding_radius;
+            return chain;
+        }
+
+        void LodChain::addLevel(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, float error) {
+            assert(_levels.empty() || error >= _levels.back()._error);
+
+            LodLevel level;
+            level._first_index = (uint32_t)_indices.size();
+            level._index_count = (uint32_t)indices.size();
+            level._error = error;
+            _levels.push_back(level);
+
+            const unsigned base_vertex = (unsigned)_vertices.size();
+            for (unsigned index : indices) {
+                _indices.push_back(base_vertex + index);
+            }
+            for (const SimpleVertex& vertex : vertices) {
+                _bounding_radius = std::max(_bounding_radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertex._pos))));
+                _vertices.push_back(vertex);
+            }
+        }
+
+        size_t LodChain::getLevelCount() const {
+            return _levels.size();
+        }
+
+        const LodLevel& LodChain::getLevel(size_t level) const {
+            return _levels[level];
+        }
+
+        const std::vector<SimpleVertex>& LodChain::getVertices() const {
+            return _vertices;
+        }
+
+        const std::vector<unsigned>& LodChain::getIndices() const {
+            return _indices;
+        }
+
+        float LodChain::getBoundingRadius() const {
+            return _bounding_radius;
+        }
+
+        LodChainView LodChain::getView() const {
+            LodChainView view;
+            view._levels = _levels.data();
+            view._level_count = _levels.size();
+            view._vertices = _vertices.data();
+            view._vertex_count = _vertices.size();
+            view._indices = _indices.data();
+            view._index_count = _indices.size();
+            view._bounding_radius = _bounding_radius;
+            return view;
+        }
+
+        LodChain makeSphereLodChain(float radius, size_t n_theta, size_t n_phi, size_t level_count, bool outer_normals, bool correct_orientation) {
+            LodChain chain;
+            for (size_t i = 0; i < level_count; ++i) {
+                Sphere sphere(radius, n_theta, n_phi, outer_normals, correct_orientation);
+                std::vector<SimpleVertex> vertices = sphere.getVertices();
+                std::vector<unsigned> indices = sphere.getIndices();
+                optimizeMesh(vertices, indices);
+                chain.addLevel(vertices, indices, sphereChordError(vertices, indices, radius));
+
+                // Three rings and three segments are the least that still encloses a volume
+                if (n_theta <= 3 && n_phi <= 3) {
+                    break;
+                }
+                n_theta = std::max<size_t>(n_theta / 2, 3);
+                n_phi = std::max<size_t>(n_phi / 2, 3);
+            }
+            return chain;
+        }
+
+        LodChain makeSimplifiedLodChain(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, size_t level_count, float level_ratio) {
+            LodChain chain;
+            std::vector<SimpleVertex> level_vertices = vertices;
+            std::vector<unsigned> level_indices = indices;
+            optimizeMesh(level_vertices, level_indices);
+            chain.addLevel(level_vertices, level_indices, 0.0f);
+
+            size_t index_count = indices.size();
+            float error = 0.0f;
+            for (size_t i = 1; i < level_count; ++i) {
+                SimplifyOptions options;
+                options._target_index_count = (size_t)(index_count * level_ratio) / 3 * 3;
+                level_indices = indices;
+                error = std::max(error, simplifyMesh(vertices, level_indices, options));
+                if (level_indices.size() >= index_count) {
+                    break;
+                }
+                index_count = level_indices.size();
+
+                level_vertices = vertices;
+                optimizeMesh(level_vertices, level_indices);
+                chain.addLevel(level_vertices, level_indices, error);
+            }
+            return chain;
+        }
+
+        // The projection maps a view space height h at depth d to h * m[1][1] / d in NDC, which spans 2 on screen
+        float projectedError(float error, float distance, const XMMATRIX& projection, float viewport_height) {
+            float y_scale = XMVectorGetY(projection.r[1]);
+            return error * y_scale * viewport_height * 0.5f / distance;
+        }
+
+        float lodDistance(FXMVECTOR camera_pos, FXMVECTOR center, float bounding_radius, float near_z) {
+            float distance = XMVectorGetX(XMVector3Length(camera_pos - center)) - bounding_radius;
+            return std::max(distance, near_z);
+        }
+
+        size_t selectLodLevel(const LodChainView& chain, float distance, float scale, const XMMATRIX& projection, float viewport_height, float threshold) {
+            for (size_t level = chain._level_count; level > 1; --level) {
+                if (projectedError(chain._levels[level - 1]._error * scale, distance, projection, viewport_height) <= threshold) {
+                    return level - 1;
+                }
+            }
+            return 0;
+        }
+
+        size_t selectLodLevel(const LodChain& chain, float distance, float scale, const XMMATRIX& projection, float viewport_height, float threshold) {
+            return selectLodLevel(chain.getView(), distance, scale, projection, viewport_height, threshold);
+        }
+    }
+}
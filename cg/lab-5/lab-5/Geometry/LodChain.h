@@ -0,0 +1,75 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        struct LodLevel {
+            uint32_t _first_index = 0;
+            uint32_t _index_count = 0;
+            // Object space distance between this level and the exact surface
+            float _error = 0.0f;
+        };
+
+        // Levels and buffers of a chain that lives elsewhere, in a LodChain or a mapped cache file
+        struct LodChainView {
+            const LodLevel* _levels = nullptr;
+            size_t _level_count = 0;
+            const SimpleVertex* _vertices = nullptr;
+            size_t _vertex_count = 0;
+            const unsigned* _indices = nullptr;
+            size_t _index_count = 0;
+            float _bounding_radius = 0.0f;
+        };
+
+        // All levels of a mesh packed into one vertex and one index buffer, finest first. Indices
+        // already point into the shared vertex array, so a level switch only changes the draw arguments
+        class LodChain {
+        public:
+            // Takes over levels that already index into the vertex array, as stored by writeMeshCache
+            static LodChain fromData(const LodLevel* levels, size_t level_count, const SimpleVertex* vertices, size_t vertex_count,
+                const unsigned* indices, size_t index_count, float bounding_radius);
+
+            // Levels have to be added from the finest to the coarsest one
+            void addLevel(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, float error);
+
+            size_t getLevelCount() const;
+            const LodLevel& getLevel(size_t level) const;
+            const std::vector<SimpleVertex>& getVertices() const;
+            const std::vector<unsigned>& getIndices() const;
+            // Around the object space origin, covers every level
+            float getBoundingRadius() const;
+            // Valid until the chain changes
+            LodChainView getView() const;
+
+        private:
+            std::vector<LodLevel> _levels;
+            std::vector<SimpleVertex> _vertices;
+            std::vector<unsigned> _indices;
+            float _bounding_radius = 0.0f;
+        };
+
+        // Halves n_theta and n_phi for every next level. Levels are cache optimized and their error is the sphere chord error
+        LodChain makeSphereLodChain(float radius, size_t n_theta, size_t n_phi, size_t level_count, bool outer_normals, bool correct_orientation);
+
+        // Every level keeps about level_ratio of the triangles of the previous one. Levels are simplified from the
+        // input mesh, so their errors are measured against it. The chain ends early once simplification gets stuck
+        LodChain makeSimplifiedLodChain(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, size_t level_count, float level_ratio = 0.5f);
+
+        // Pixels covered by an error seen from distance through a perspective projection
+        float projectedError(float error, float distance, const DirectX::XMMATRIX& projection, float viewport_height);
+
+        // Distance from the camera to the closest point of the bounding sphere, never below near_z
+        float lodDistance(DirectX::FXMVECTOR camera_pos, DirectX::FXMVECTOR center, float bounding_radius, float near_z);
+
+        // Coarsest level whose projected error stays within threshold pixels, the finest one if none does.
+        // scale converts object space errors to world space
+        size_t selectLodLevel(const LodChainView& chain, float distance, float scale, const DirectX::XMMATRIX& projection, float viewport_height, float threshold);
+        size_t selectLodLevel(const LodChain& chain, float distance, float scale, const DirectX::XMMATRIX& projection, float viewport_height, float threshold);
+    }
+}
@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rendering {
+    namespace geometry {
+        MappedFile::~MappedFile() {
+            close();
+        }
+
+        bool MappedFile::open(const std::filesystem::path& path) {
+            close();
+#ifdef _WIN32
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            _file = file;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+                close();
+                return false;
+            }
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                close();
+                return false;
+            }
+            _mapping = mapping;
+            _data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            _size = (size_t)size.QuadPart;
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // The mapping keeps the file alive on its own
+            ::close(fd);
+            if (data != MAP_FAILED) {
+                _data = (const uint8_t*)data;
+                _size = (size_t)info.st_size;
+            }
+#endif
+            if (!_data) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void MappedFile::close() {
+#ifdef _WIN32
+            if (_data) {
+                UnmapViewOfFile(_data);
+            }
+            if (_mapping) {
+                CloseHandle(_mapping);
+            }
+            if (_file) {
+                CloseHandle(_file);
+            }
+#else
+            if (_data) {
+                munmap((void*)_data, _size);
+            }
+#endif
+            _data = nullptr;
+            _size = 0;
+            _file = nullptr;
+            _mapping = nullptr;
+        }
+
+        const uint8_t* MappedFile::getData() const {
+            return _data;
+        }
+
+        size_t MappedFile::getSize() const {
+            return _size;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace rendering {
+    namespace geometry {
+        // Read-only view of a whole file. Pages are only read when touched, so opening a
+        // multi-gigabyte file costs nothing until it is parsed
+        class MappedFile {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            ~MappedFile();
+
+            // Fails for missing and empty files
+            bool open(const std::filesystem::path& path);
+            void close();
+
+            const uint8_t* getData() const;
+            size_t getSize() const;
+
+        private:
+            const uint8_t* _data = nullptr;
+            size_t _size = 0;
+            void* _file = nullptr;
+            void* _mapping = nullptr;
+        };
+    }
+}
@@ -0,0 +1,231 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const uint32_t MAGIC = 0x4348534d; // "MSHC"
+            const uint32_t VERSION = 1;
+            const uint32_t NATIVE_BYTE_ORDER = 0x01020304;
+            const uint32_t SWAPPED_BYTE_ORDER = 0x04030201;
+            const uint64_t BLOB_ALIGNMENT = 16;
+
+            static_assert(sizeof(LodLevel) == 12, "the LOD table is stored as LodLevel");
+            static_assert(sizeof(SimpleVertex) == 24, "the vertex blob is stored as SimpleVertex");
+
+            uint64_t alignBlob(uint64_t offset) {
+                return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+            }
+
+            bool fitsInFile(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size) {
+                return offset <= file_size && count <= (file_size - offset) / element_size;
+            }
+
+            void writePadding(std::ofstream& file, uint64_t& offset, uint64_t target) {
+                const char zeros[BLOB_ALIGNMENT] = {};
+                file.write(zeros, (std::streamsize)(target - offset));
+                offset = target;
+            }
+        }
+
+        const char* getMeshCacheStatusName(MeshCacheStatus status) {
+            switch (status) {
+            case MeshCacheStatus::OK:
+                return "ok";
+            case MeshCacheStatus::MISSING:
+                return "missing";
+            case MeshCacheStatus::TRUNCATED:
+                return "truncated";
+            case MeshCacheStatus::BAD_MAGIC:
+                return "not a mesh cache";
+            case MeshCacheStatus::BAD_VERSION:
+                return "unsupported version";
+            case MeshCacheStatus::FOREIGN_BYTE_ORDER:
+                return "written on a machine with a different byte order";
+            case MeshCacheStatus::BAD_VERTEX_FORMAT:
+                return "unsupported vertex format";
+            case MeshCacheStatus::STALE:
+                return "built from a different source";
+            case MeshCacheStatus::CORRUPT:
+                return "corrupt";
+            }
+            return "unknown";
+        }
+
+        uint64_t hashMeshSource(const void* data, size_t size, uint64_t hash) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        bool writeMeshCache(const std::filesystem::path& path, const LodChain& chain, uint64_t source_hash) {
+            const std::vector<SimpleVertex>& vertices = chain.getVertices();
+            const std::vector<unsigned>& indices = chain.getIndices();
+
+            MeshCacheHeader header = {};
+            header._magic = MAGIC;
+            header._version = VERSION;
+            header._byte_order = NATIVE_BYTE_ORDER;
+            header._vertex_format = MeshVertexFormat::POSITION_NORMAL;
+            header._vertex_stride = sizeof(SimpleVertex);
+            header._index_size = sizeof(unsigned);
+            header._level_count = (uint32_t)chain.getLevelCount();
+            header._bounding_radius = chain.getBoundingRadius();
+            header._source_hash = source_hash;
+            header._vertex_count = vertices.size();
+            header._index_count = indices.size();
+
+            XMVECTOR min = XMVectorReplicate(vertices.empty() ? 0.0f : FLT_MAX);
+            XMVECTOR max = XMVectorReplicate(vertices.empty() ? 0.0f : -FLT_MAX);
+            for (const SimpleVertex& vertex : vertices) {
+                min = XMVectorMin(min, XMLoadFloat3(&vertex._pos));
+                max = XMVectorMax(max, XMLoadFloat3(&vertex._pos));
+            }
+            XMStoreFloat3((XMFLOAT3*)header._bounds_min, min);
+            XMStoreFloat3((XMFLOAT3*)header._bounds_max, max);
+
+            header._levels_offset = sizeof(MeshCacheHeader);
+            header._vertices_offset = alignBlob(header._levels_offset + header._level_count * sizeof(LodLevel));
+            header._indices_offset = alignBlob(header._vertices_offset + header._vertex_count * sizeof(SimpleVertex));
+            header._file_size = header._indices_offset + header._index_count * sizeof(unsigned);
+
+            std::filesystem::path temporary = path;
+            temporary += ".tmp";
+            {
+                std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+                if (!file) {
+                    return false;
+                }
+                uint64_t offset = 0;
+                file.write((const char*)&header, sizeof(header));
+                offset += sizeof(header);
+                for (size_t i = 0; i < chain.getLevelCount(); ++i) {
+                    file.write((const char*)&chain.getLevel(i), sizeof(LodLevel));
+                    offset += sizeof(LodLevel);
+                }
+                writePadding(file, offset, header._vertices_offset);
+                file.write((const char*)vertices.data(), (std::streamsize)(vertices.size() * sizeof(SimpleVertex)));
+                offset += vertices.size() * sizeof(SimpleVertex);
+                writePadding(file, offset, header._indices_offset);
+                file.write((const char*)indices.data(), (std::streamsize)(indices.size() * sizeof(unsigned)));
+                if (!file.good()) {
+                    return false;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temporary, path, error);
+            return !error;
+        }
+
+        MeshCacheStatus MeshCacheFile::open(const std::filesystem::path& path, uint64_t source_hash, bool validate_indices) {
+            close();
+            if (!_file.open(path)) {
+                std::error_code error;
+                return std::filesystem::exists(path, error) ? MeshCacheStatus::TRUNCATED : MeshCacheStatus::MISSING;
+            }
+            _data = _file.getData();
+            _size = _file.getSize();
+
+            MeshCacheStatus status = validate(source_hash, validate_indices);
+            if (status != MeshCacheStatus::OK) {
+                close();
+            }
+            return status;
+        }
+
+        void MeshCacheFile::close() {
+            _file.close();
+            _data = nullptr;
+            _size = 0;
+        }
+
+        MeshCacheStatus MeshCacheFile::validate(uint64_t source_hash, bool validate_indices) const {
+            if (_size < sizeof(MeshCacheHeader)) {
+                return MeshCacheStatus::TRUNCATED;
+            }
+            const MeshCacheHeader& header = getHeader();
+            if (header._magic != MAGIC) {
+                return header._magic == 0x4d534843 ? MeshCacheStatus::FOREIGN_BYTE_ORDER : MeshCacheStatus::BAD_MAGIC;
+            }
+            if (header._byte_order != NATIVE_BYTE_ORDER) {
+                return header._byte_order == SWAPPED_BYTE_ORDER ? MeshCacheStatus::FOREIGN_BYTE_ORDER : MeshCacheStatus::CORRUPT;
+            }
+            if (header._version != VERSION) {
+                return MeshCacheStatus::BAD_VERSION;
+            }
+            if (header._vertex_format != MeshVertexFormat::POSITION_NORMAL || header._vertex_stride != sizeof(SimpleVertex) || header._index_size != sizeof(unsigned)) {
+                return MeshCacheStatus::BAD_VERTEX_FORMAT;
+            }
+            if (header._source_hash != source_hash) {
+                return MeshCacheStatus::STALE;
+            }
+            if (header._file_size != _size) {
+                return header._file_size > _size ? MeshCacheStatus::TRUNCATED : MeshCacheStatus::CORRUPT;
+            }
+            if (header._levels_offset < sizeof(MeshCacheHeader) || header._levels_offset % alignof(LodLevel) != 0
+                || header._vertices_offset % BLOB_ALIGNMENT != 0 || header._indices_offset % BLOB_ALIGNMENT != 0
+                || !fitsInFile(header._levels_offset, header._level_count, sizeof(LodLevel), _size)
+                || !fitsInFile(header._vertices_offset, header._vertex_count, sizeof(SimpleVertex), _size)
+                || !fitsInFile(header._indices_offset, header._index_count, sizeof(unsigned), _size)
+                || header._index_count % 3 != 0) {
+                return MeshCacheStatus::CORRUPT;
+            }
+
+            const LodLevel* levels = getLevels();
+            for (uint32_t i = 0; i < header._level_count; ++i) {
+                if (levels[i]._index_count % 3 != 0 || levels[i]._first_index > header._index_count
+                    || levels[i]._index_count > header._index_count - levels[i]._first_index) {
+                    return MeshCacheStatus::CORRUPT;
+                }
+            }
+
+            if (validate_indices) {
+                const unsigned* indices = getIndices();
+                for (uint64_t i = 0; i < header._index_count; ++i) {
+                    if (indices[i] >= header._vertex_count) {
+                        return MeshCacheStatus::CORRUPT;
+                    }
+                }
+            }
+            return MeshCacheStatus::OK;
+        }
+
+        const MeshCacheHeader& MeshCacheFile::getHeader() const {
+            return *(const MeshCacheHeader*)_data;
+        }
+
+        const LodLevel* MeshCacheFile::getLevels() const {
+            return (const LodLevel*)(_data + getHeader()._levels_offset);
+        }
+
+        const SimpleVertex* MeshCacheFile::getVertices() const {
+            return (const SimpleVertex*)(_data + getHeader()._vertices_offset);
+        }
+
+        const unsigned* MeshCacheFile::getIndices() const {
+            return (const unsigned*)(_data + getHeader()._indices_offset);
+        }
+
+        LodChainView MeshCacheFile::getView() const {
+            const MeshCacheHeader& header = getHeader();
+            LodChainView view;
+            view._levels = getLevels();
+            view._level_count = header._level_count;
+            view._vertices = getVertices();
+            view._vertex_count = (size_t)header._vertex_count;
+            view._indices = getIndices();
+            view._index_count = (size_t)header._index_count;
+            view._bounding_radius = header._bounding_radius;
+            return view;
+        }
+    }
+}
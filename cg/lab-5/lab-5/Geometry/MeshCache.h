@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "LodChain.h"
+#include "MappedFile.h"
+
+namespace rendering {
+    namespace geometry {
+        enum class MeshVertexFormat : uint32_t {
+            // SimpleVertex: float3 position, float3 normal
+            POSITION_NORMAL = 0,
+        };
+
+        // Native byte order of the machine that wrote it, _byte_order tells. The LOD table follows the header, the vertex
+        // and index blobs start on 16 byte boundaries, so all three can be used in place from a mapped file
+        struct MeshCacheHeader {
+            uint32_t _magic;
+            uint32_t _version;
+            uint32_t _byte_order;
+            MeshVertexFormat _vertex_format;
+            uint32_t _vertex_stride;
+            uint32_t _index_size;
+            uint32_t _level_count;
+            float _bounding_radius;
+            float _bounds_min[3];
+            float _bounds_max[3];
+            // Identifies the generator and parameters the mesh was built from, a different one means a stale cache
+            uint64_t _source_hash;
+            uint64_t _vertex_count;
+            uint64_t _index_count;
+            uint64_t _levels_offset;
+            uint64_t _vertices_offset;
+            uint64_t _indices_offset;
+            uint64_t _file_size;
+        };
+
+        enum class MeshCacheStatus {
+            OK,
+            MISSING,
+            TRUNCATED,
+            BAD_MAGIC,
+            BAD_VERSION,
+            FOREIGN_BYTE_ORDER,
+            BAD_VERTEX_FORMAT,
+            STALE,
+            CORRUPT,
+        };
+
+        const char* getMeshCacheStatusName(MeshCacheStatus status);
+
+        // FNV-1a, for building source hashes out of generator parameters
+        uint64_t hashMeshSource(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+        // Writes to a temporary file first and renames it, so a crash never leaves a torn cache behind
+        bool writeMeshCache(const std::filesystem::path& path, const LodChain& chain, uint64_t source_hash);
+
+        // Read-only mapping of a cache file. Everything is checked against the file size before any pointer is
+        // handed out, the indices themselves only when asked to, since that touches every page of the blob
+        class MeshCacheFile {
+        public:
+            MeshCacheStatus open(const std::filesystem::path& path, uint64_t source_hash, bool validate_indices = false);
+            void close();
+
+            const MeshCacheHeader& getHeader() const;
+            const LodLevel* getLevels() const;
+            const SimpleVertex* getVertices() const;
+            const unsigned* getIndices() const;
+
+            // Points into the mapping, valid until the file is closed
+            LodChainView getView() const;
+
+        private:
+            MeshCacheStatus validate(uint64_t source_hash, bool validate_indices) const;
+
+            MappedFile _file;
+            const uint8_t* _data = nullptr;
+            size_t _size = 0;
+        };
+    }
+}
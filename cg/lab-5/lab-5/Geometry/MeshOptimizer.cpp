@@ -0,0 +1,343 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const size_t FETCH_LINE_SIZE = 64;
+            const size_t FETCH_CACHE_LINES = 64;
+
+            // A vertex is in the FIFO cache while fewer than cache_size misses happened since it was loaded
+            class FifoCache {
+            public:
+                FifoCache(size_t vertex_count, size_t cache_size)
+                    : _timestamps(vertex_count, 0), _cache_size(cache_size), _time(cache_size + 1) {}
+
+                bool access(unsigned v) {
+                    if (_time - _timestamps[v] <= _cache_size) {
+                        return true;
+                    }
+                    _timestamps[v] = _time++;
+                    return false;
+                }
+
+                void reset() {
+                    _time += _cache_size + 1;
+                }
+
+            private:
+                std::vector<size_t> _timestamps;
+                size_t _cache_size;
+                size_t _time;
+            };
+
+            unsigned countMisses(FifoCache& cache, const unsigned* triangle) {
+                return !cache.access(triangle[0]) + !cache.access(triangle[1]) + !cache.access(triangle[2]);
+            }
+
+            // Misses of triangles [begin, end) starting from an empty cache
+            unsigned countRangeMisses(FifoCache& cache, const std::vector<unsigned>& indices, size_t begin, size_t end) {
+                cache.reset();
+                unsigned misses = 0;
+                for (size_t t = begin; t < end; ++t) {
+                    misses += countMisses(cache, &indices[3 * t]);
+                }
+                return misses;
+            }
+
+            // Triangles around every vertex, as offsets into one array
+            struct Adjacency {
+                std::vector<unsigned> _offsets;
+                std::vector<unsigned> _triangles;
+            };
+
+            Adjacency buildAdjacency(const std::vector<unsigned>& indices, size_t vertex_count) {
+                Adjacency adjacency;
+                adjacency._offsets.assign(vertex_count + 1, 0);
+                for (unsigned v : indices) {
+                    ++adjacency._offsets[v + 1];
+                }
+                std::partial_sum(adjacency._offsets.begin(), adjacency._offsets.end(), adjacency._offsets.begin());
+
+                std::vector<unsigned> fill(adjacency._offsets.begin(), adjacency._offsets.end() - 1);
+                adjacency._triangles.resize(indices.size());
+                for (size_t i = 0; i < indices.size(); ++i) {
+                    adjacency._triangles[fill[indices[i]]++] = (unsigned)(i / 3);
+                }
+                return adjacency;
+            }
+
+            std::vector<size_t> findHardBoundaries(const std::vector<unsigned>& indices, size_t vertex_count, size_t cache_size) {
+                std::vector<size_t> boundaries;
+                FifoCache cache(vertex_count, cache_size);
+                for (size_t t = 0; t < indices.size() / 3; ++t) {
+                    // Tipsify only misses all three vertices when it jumps to a new fan
+                    if (countMisses(cache, &indices[3 * t]) == 3) {
+                        boundaries.push_back(t);
+                    }
+                }
+                return boundaries;
+            }
+
+            std::vector<size_t> findSoftBoundaries(const std::vector<unsigned>& indices, size_t vertex_count, const std::vector<size_t>& hard_boundaries,
+                float threshold, size_t cache_size) {
+                const size_t triangle_count = indices.size() / 3;
+                std::vector<size_t> boundaries;
+                FifoCache cache(vertex_count, cache_size);
+
+                for (size_t c = 0; c < hard_boundaries.size(); ++c) {
+                    size_t start = hard_boundaries[c];
+                    size_t end = c + 1 < hard_boundaries.size() ? hard_boundaries[c + 1] : triangle_count;
+
+                    unsigned cluster_misses = countRangeMisses(cache, indices, start, end);
+                    float cluster_threshold = threshold * cluster_misses / (end - start);
+
+                    boundaries.push_back(start);
+                    cache.reset();
+                    unsigned misses = 0;
+                    size_t triangles = 0;
+                    for (size_t t = start; t < end; ++t) {
+                        misses += countMisses(cache, &indices[3 * t]);
+                        ++triangles;
+                        if ((float)misses / triangles <= cluster_threshold && t + 1 < end) {
+                            boundaries.push_back(t + 1);
+                            cache.reset();
+                            misses = 0;
+                            triangles = 0;
+                        }
+                    }
+                    // The last split is only known to be good up to where it was made, the rest of the
+                    // cluster joins the clusters before it until the cache stays within the threshold
+                    while (boundaries.back() != start &&
+                        countRangeMisses(cache, indices, boundaries.back(), end) > cluster_threshold * (end - boundaries.back())) {
+                        boundaries.pop_back();
+                    }
+                }
+                return boundaries;
+            }
+        }
+
+        VertexCacheStats analyzeVertexCache(const std::vector<unsigned>& indices, size_t vertex_count, size_t cache_size) {
+            VertexCacheStats stats;
+            FifoCache cache(vertex_count, cache_size);
+            std::vector<bool> used(vertex_count, false);
+            size_t used_count = 0;
+            for (unsigned v : indices) {
+                stats._transformed += !cache.access(v);
+                if (!used[v]) {
+                    used[v] = true;
+                    ++used_count;
+                }
+            }
+            if (!indices.empty()) {
+                stats._acmr = (float)stats._transformed / (indices.size() / 3);
+                stats._atvr = (float)stats._transformed / used_count;
+            }
+            return stats;
+        }
+
+        VertexFetchStats analyzeVertexFetch(const std::vector<unsigned>& indices, size_t vertex_count, size_t vertex_size) {
+            VertexFetchStats stats;
+            const size_t line_count = (vertex_count * vertex_size + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE;
+            FifoCache cache(line_count, FETCH_CACHE_LINES);
+            for (unsigned v : indices) {
+                size_t first_line = v * vertex_size / FETCH_LINE_SIZE;
+                size_t last_line = (v * vertex_size + vertex_size - 1) / FETCH_LINE_SIZE;
+                for (size_t line = first_line; line <= last_line; ++line) {
+                    if (!cache.access((unsigned)line)) {
+                        stats._bytes_fetched += FETCH_LINE_SIZE;
+                    }
+                }
+            }
+            if (vertex_count > 0) {
+                stats._overfetch = (float)stats._bytes_fetched / (vertex_count * vertex_size);
+            }
+            return stats;
+        }
+
+        void optimizeVertexCache(std::vector<unsigned>& indices, size_t vertex_count, size_t cache_size) {
+            assert(indices.size() % 3 == 0);
+            const size_t triangle_count = indices.size() / 3;
+            if (triangle_count == 0) {
+                return;
+            }
+
+            Adjacency adjacency = buildAdjacency(indices, vertex_count);
+            std::vector<unsigned> live(vertex_count);
+            for (size_t v = 0; v < vertex_count; ++v) {
+                live[v] = adjacency._offsets[v + 1] - adjacency._offsets[v];
+            }
+
+            std::vector<size_t> timestamps(vertex_count, 0);
+            std::vector<bool> emitted(triangle_count, false);
+            std::vector<unsigned> dead_end;
+            std::vector<unsigned> candidates;
+            std::vector<unsigned> result;
+            result.reserve(indices.size());
+
+            size_t time = cache_size + 1;
+            unsigned cursor = 0;
+            int fanning = (int)indices[0];
+
+            while (fanning >= 0) {
+                candidates.clear();
+                for (unsigned a = adjacency._offsets[fanning]; a < adjacency._offsets[fanning + 1]; ++a) {
+                    unsigned t = adjacency._triangles[a];
+                    if (emitted[t]) {
+                        continue;
+                    }
+                    emitted[t] = true;
+                    for (size_t k = 0; k < 3; ++k) {
+                        unsigned v = indices[3 * t + k];
+                        result.push_back(v);
+                        dead_end.push_back(v);
+                        candidates.push_back(v);
+                        --live[v];
+                        if (time - timestamps[v] > cache_size) {
+                            timestamps[v] = time++;
+                        }
+                    }
+                }
+
+                // Prefer the oldest candidate whose remaining triangles still fit before it leaves the cache
+                int next = -1;
+                int best_priority = -1;
+                for (unsigned v : candidates) {
+                    if (live[v] == 0) {
+                        continue;
+                    }
+                    int priority = 0;
+                    if (time - timestamps[v] + 2 * live[v] <= cache_size) {
+                        priority = (int)(time - timestamps[v]);
+                    }
+                    if (priority > best_priority) {
+                        best_priority = priority;
+                        next = (int)v;
+                    }
+                }
+
+                // Dead end: go back through recently used vertices, then scan in input order
+                while (next < 0 && !dead_end.empty()) {
+                    unsigned v = dead_end.back();
+                    dead_end.pop_back();
+                    if (live[v] > 0) {
+                        next = (int)v;
+                    }
+                }
+                while (next < 0 && cursor < vertex_count) {
+                    if (live[cursor] > 0) {
+                        next = (int)cursor;
+                    }
+                    ++cursor;
+                }
+                fanning = next;
+            }
+
+            assert(result.size() == indices.size());
+            indices.swap(result);
+        }
+
+        void optimizeOverdraw(std::vector<unsigned>& indices, const std::vector<SimpleVertex>& vertices, float threshold, size_t cache_size) {
+            const size_t triangle_count = indices.size() / 3;
+            if (triangle_count == 0) {
+                return;
+            }
+
+            std::vector<size_t> hard_boundaries = findHardBoundaries(indices, vertices.size(), cache_size);
+            std::vector<size_t> clusters = findSoftBoundaries(indices, vertices.size(), hard_boundaries, threshold, cache_size);
+
+            XMVECTOR mesh_centroid = XMVectorZero();
+            for (unsigned v : indices) {
+                mesh_centroid += XMLoadFloat3(&vertices[v]._pos);
+            }
+            mesh_centroid /= (float)indices.size();
+
+            // Clusters facing away from the mesh center are the ones that occlude the rest
+            std::vector<float> sort_keys(clusters.size());
+            for (size_t c = 0; c < clusters.size(); ++c) {
+                size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+                XMVECTOR centroid = XMVectorZero();
+                XMVECTOR normal = XMVectorZero();
+                float area = 0.0f;
+                for (size_t t = clusters[c]; t < end; ++t) {
+                    XMVECTOR p0 = XMLoadFloat3(&vertices[indices[3 * t + 0]]._pos);
+                    XMVECTOR p1 = XMLoadFloat3(&vertices[indices[3 * t + 1]]._pos);
+                    XMVECTOR p2 = XMLoadFloat3(&vertices[indices[3 * t + 2]]._pos);
+                    // Points out of the front (clockwise) side of the triangle
+                    XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+                    float a = XMVectorGetX(XMVector3Length(n));
+                    centroid += (p0 + p1 + p2) * (a / 3.0f);
+                    normal += n;
+                    area += a;
+                }
+                centroid = area > 0.0f ? centroid / area : XMVectorZero();
+                normal = XMVector3Normalize(normal);
+                sort_keys[c] = XMVectorGetX(XMVector3Dot(centroid - mesh_centroid, normal));
+            }
+
+            std::vector<size_t> order(clusters.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+            std::vector<unsigned> result;
+            result.reserve(indices.size());
+            for (size_t c : order) {
+                size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+                result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+            }
+            indices.swap(result);
+        }
+
+        std::vector<unsigned> optimizeVertexFetchRemap(const std::vector<unsigned>& indices, size_t vertex_count) {
+            std::vector<unsigned> remap(vertex_count, ~0u);
+            unsigned next = 0;
+            for (unsigned v : indices) {
+                if (remap[v] == ~0u) {
+                    remap[v] = next++;
+                }
+            }
+            return remap;
+        }
+
+        void optimizeVertexFetch(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+            std::vector<unsigned> remap = optimizeVertexFetchRemap(indices, vertices.size());
+            size_t used = 0;
+            std::vector<SimpleVertex> result(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                if (remap[v] != ~0u) {
+                    result[remap[v]] = vertices[v];
+                    ++used;
+                }
+            }
+            result.resize(used);
+            for (unsigned& v : indices) {
+                v = remap[v];
+            }
+            vertices.swap(result);
+        }
+
+        MeshOptimizationReport optimizeMesh(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+            MeshOptimizationReport report;
+            report._cache_before = analyzeVertexCache(indices, vertices.size());
+            report._fetch_before = analyzeVertexFetch(indices, vertices.size(), sizeof(SimpleVertex));
+
+            // Small meshes fit into the cache in any order, there the scan order can beat Tipsify
+            std::vector<unsigned> optimized = indices;
+            optimizeVertexCache(optimized, vertices.size());
+            optimizeOverdraw(optimized, vertices);
+            if (analyzeVertexCache(optimized, vertices.size())._acmr < report._cache_before._acmr) {
+                indices.swap(optimized);
+            }
+            optimizeVertexFetch(vertices, indices);
+
+            report._cache_after = analyzeVertexCache(indices, vertices.size());
+            report._fetch_after = analyzeVertexFetch(indices, vertices.size(), sizeof(SimpleVertex));
+            return report;
+        }
+    }
+}
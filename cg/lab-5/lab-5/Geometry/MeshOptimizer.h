@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        // Post-transform cache size assumed by the optimizer and the analyzer. Tipsify is not
+        // sensitive to the exact value, 16 is close to what D3D11 class hardware reuses
+        const size_t VERTEX_CACHE_SIZE = 16;
+
+        struct VertexCacheStats {
+            size_t _transformed = 0;
+            // Average cache miss ratio: transformed vertices per triangle, 0.5 is the best a grid can get
+            float _acmr = 0.0f;
+            // Average transform to vertex ratio, 1 means every vertex is transformed exactly once
+            float _atvr = 0.0f;
+        };
+
+        struct VertexFetchStats {
+            size_t _bytes_fetched = 0;
+            // Fetched bytes over the vertex buffer size
+            float _overfetch = 0.0f;
+        };
+
+        struct MeshOptimizationReport {
+            VertexCacheStats _cache_before;
+            VertexCacheStats _cache_after;
+            VertexFetchStats _fetch_before;
+            VertexFetchStats _fetch_after;
+        };
+
+        // FIFO simulation of the post-transform cache
+        VertexCacheStats analyzeVertexCache(const std::vector<unsigned>& indices, size_t vertex_count, size_t cache_size = VERTEX_CACHE_SIZE);
+        // Simulates a small cache of 64 byte lines in front of the vertex buffer
+        VertexFetchStats analyzeVertexFetch(const std::vector<unsigned>& indices, size_t vertex_count, size_t vertex_size);
+
+        // Tipsify (Sander et al. 2007): fans around the most recently used vertex that still has
+        // triangles left, so the output keeps reusing the cache and only jumps on dead ends
+        void optimizeVertexCache(std::vector<unsigned>& indices, size_t vertex_count, size_t cache_size = VERTEX_CACHE_SIZE);
+
+        // Reorders clusters of the cache-optimized index buffer so that outward facing clusters are
+        // drawn first and hide the ones behind them. A cluster may only split where ACMR stays
+        // within threshold of the cluster's own ACMR
+        void optimizeOverdraw(std::vector<unsigned>& indices, const std::vector<SimpleVertex>& vertices, float threshold = 1.05f, size_t cache_size = VERTEX_CACHE_SIZE);
+
+        // Vertex order of first use, unused vertices are dropped. Returns remap[old] = new, or ~0u for unused
+        std::vector<unsigned> optimizeVertexFetchRemap(const std::vector<unsigned>& indices, size_t vertex_count);
+        void optimizeVertexFetch(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices);
+
+        // All three passes in the order they have to run in
+        MeshOptimizationReport optimizeMesh(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices);
+    }
+}
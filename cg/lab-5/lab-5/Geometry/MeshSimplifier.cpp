@@ -0,0 +1,550 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            // Planes hold a border in place this much stronger than the faces around it
+            const double BORDER_WEIGHT = 10.0;
+            // Collapses may not turn a surviving triangle by more than ~75 degrees. Nearly flipped slivers are
+            // not caught by a plain sign test in float
+            const float MIN_NORMAL_COS = 0.25f;
+            // Parallel slabs leave collapses that move the surface by more than this fraction of the mesh size to
+            // the serial pass. With their seams locked, slabs that run out of cheap collapses tear themselves up
+            const float CHUNK_MAX_RELATIVE_ERROR = 0.01f;
+
+            // Sum of squared distances to planes: error(p) = p^T A p + 2 b^T p + c. Every face plane has weight 1,
+            // so the square root bounds the distance to each plane the vertex has absorbed
+            struct Quadric {
+                double _a00 = 0.0, _a01 = 0.0, _a02 = 0.0, _a11 = 0.0, _a12 = 0.0, _a22 = 0.0;
+                double _b0 = 0.0, _b1 = 0.0, _b2 = 0.0;
+                double _c = 0.0;
+
+                Quadric& operator+=(const Quadric& other) {
+                    _a00 += other._a00; _a01 += other._a01; _a02 += other._a02;
+                    _a11 += other._a11; _a12 += other._a12; _a22 += other._a22;
+                    _b0 += other._b0; _b1 += other._b1; _b2 += other._b2;
+                    _c += other._c;
+                    return *this;
+                }
+            };
+
+            // Plane n.p + d = 0 with a unit normal
+            Quadric planeQuadric(const XMFLOAT3& n, float d, double weight) {
+                Quadric q;
+                q._a00 = weight * n.x * n.x; q._a01 = weight * n.x * n.y; q._a02 = weight * n.x * n.z;
+                q._a11 = weight * n.y * n.y; q._a12 = weight * n.y * n.z; q._a22 = weight * n.z * n.z;
+                q._b0 = weight * n.x * d; q._b1 = weight * n.y * d; q._b2 = weight * n.z * d;
+                q._c = weight * d * d;
+                return q;
+            }
+
+            double evaluate(const Quadric& q, const XMFLOAT3& p) {
+                double x = p.x, y = p.y, z = p.z;
+                double error = q._a00 * x * x + q._a11 * y * y + q._a22 * z * z
+                    + 2.0 * (q._a01 * x * y + q._a02 * x * z + q._a12 * y * z)
+                    + 2.0 * (q._b0 * x + q._b1 * y + q._b2 * z) + q._c;
+                return std::max(error, 0.0);
+            }
+
+            // Binary heap of vertices keyed by the cost of their cheapest collapse. A vertex whose
+            // neighbourhood changed moves in place, so the heap never holds stale entries
+            class CollapseHeap {
+            public:
+                explicit CollapseHeap(size_t vertex_count)
+                    : _positions(vertex_count, NOT_IN_HEAP), _costs(vertex_count, FLT_MAX) {}
+
+                bool empty() const {
+                    return _heap.empty();
+                }
+
+                unsigned top() const {
+                    return _heap.front();
+                }
+
+                float topCost() const {
+                    return _costs[_heap.front()];
+                }
+
+                bool contains(unsigned v) const {
+                    return _positions[v] != NOT_IN_HEAP;
+                }
+
+                float getCost(unsigned v) const {
+                    return _costs[v];
+                }
+
+                void update(unsigned v, float cost) {
+                    if (_positions[v] == NOT_IN_HEAP) {
+                        _positions[v] = (unsigned)_heap.size();
+                        _heap.push_back(v);
+                    }
+                    _costs[v] = cost;
+                    siftDown(siftUp(_positions[v]));
+                }
+
+                void remove(unsigned v) {
+                    unsigned position = _positions[v];
+                    if (position == NOT_IN_HEAP) {
+                        return;
+                    }
+                    _positions[v] = NOT_IN_HEAP;
+                    unsigned last = _heap.back();
+                    _heap.pop_back();
+                    if (last != v) {
+                        place(last, position);
+                        siftDown(siftUp(position));
+                    }
+                }
+
+            private:
+                static const unsigned NOT_IN_HEAP = ~0u;
+
+                void place(unsigned v, size_t position) {
+                    _heap[position] = v;
+                    _positions[v] = (unsigned)position;
+                }
+
+                size_t siftUp(size_t position) {
+                    unsigned v = _heap[position];
+                    while (position > 0) {
+                        size_t parent = (position - 1) / 2;
+                        if (_costs[_heap[parent]] <= _costs[v]) {
+                            break;
+                        }
+                        place(_heap[parent], position);
+                        position = parent;
+                    }
+                    place(v, position);
+                    return position;
+                }
+
+                void siftDown(size_t position) {
+                    unsigned v = _heap[position];
+                    for (;;) {
+                        size_t child = 2 * position + 1;
+                        if (child >= _heap.size()) {
+                            break;
+                        }
+                        if (child + 1 < _heap.size() && _costs[_heap[child + 1]] < _costs[_heap[child]]) {
+                            ++child;
+                        }
+                        if (_costs[v] <= _costs[_heap[child]]) {
+                            break;
+                        }
+                        place(_heap[child], position);
+                        position = child;
+                    }
+                    place(v, position);
+                }
+
+                std::vector<unsigned> _heap;
+                std::vector<unsigned> _positions;
+                std::vector<float> _costs;
+            };
+
+            class Simplifier {
+            public:
+                Simplifier(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, const SimplifyOptions& options,
+                    const std::vector<uint8_t>& locked)
+                    : _vertices(vertices), _indices(indices), _options(options),
+                      _triangle_alive(indices.size() / 3, 1), _vertex_triangles(vertices.size()),
+                      _quadrics(vertices.size()), _targets(vertices.size(), 0), _locked(vertices.size(), 0), _heap(vertices.size()) {
+                    for (size_t t = 0; t < _triangle_alive.size(); ++t) {
+                        for (size_t k = 0; k < 3; ++k) {
+                            _vertex_triangles[_indices[3 * t + k]].push_back((unsigned)t);
+                        }
+                    }
+                    for (size_t v = 0; v < locked.size(); ++v) {
+                        _locked[v] = locked[v];
+                    }
+                    lockSeams();
+                    computeQuadrics();
+                }
+
+                float run() {
+                    for (unsigned v = 0; v < (unsigned)_vertices.size(); ++v) {
+                        updateVertex(v);
+                    }
+
+                    size_t index_count = _indices.size();
+                    const double max_cost = (double)_options._target_error * _options._target_error;
+                    double max_performed = 0.0;
+                    while (index_count > _options._target_index_count && !_heap.empty()) {
+                        unsigned from = _heap.top();
+                        float cost = _heap.topCost();
+                        if (cost > max_cost) {
+                            break;
+                        }
+                        _heap.remove(from);
+                        // A rejected vertex comes back once a collapse next to it changes its neighbourhood
+                        if (!canCollapse(from, _targets[from])) {
+                            continue;
+                        }
+                        index_count -= 3 * performCollapse(from, _targets[from]);
+                        max_performed = std::max(max_performed, (double)cost);
+                    }
+                    return (float)sqrt(max_performed);
+                }
+
+                void write(std::vector<unsigned>& indices) const {
+                    indices.clear();
+                    for (size_t t = 0; t < _triangle_alive.size(); ++t) {
+                        if (_triangle_alive[t]) {
+                            indices.insert(indices.end(), &_indices[3 * t], &_indices[3 * t] + 3);
+                        }
+                    }
+                }
+
+            private:
+                // Normals may differ across a seam, positions may not, so seam vertices have to stay where they are.
+                // Vertices no triangle uses do not make a seam, the buffer may be shared with other meshes
+                void lockSeams() {
+                    auto less = [&](unsigned a, unsigned b) { return memcmp(&_vertices[a]._pos, &_vertices[b]._pos, sizeof(XMFLOAT3)) < 0; };
+                    std::vector<unsigned> order;
+                    for (unsigned v = 0; v < (unsigned)_vertices.size(); ++v) {
+                        if (!_vertex_triangles[v].empty()) {
+                            order.push_back(v);
+                        }
+                    }
+                    std::sort(order.begin(), order.end(), less);
+                    for (size_t i = 1; i < order.size(); ++i) {
+                        if (!less(order[i - 1], order[i])) {
+                            _locked[order[i - 1]] = 1;
+                            _locked[order[i]] = 1;
+                        }
+                    }
+                }
+
+                XMVECTOR triangleNormal(size_t t) const {
+                    XMVECTOR p0 = XMLoadFloat3(&_vertices[_indices[3 * t]]._pos);
+                    XMVECTOR p1 = XMLoadFloat3(&_vertices[_indices[3 * t + 1]]._pos);
+                    XMVECTOR p2 = XMLoadFloat3(&_vertices[_indices[3 * t + 2]]._pos);
+                    return XMVector3Cross(p1 - p0, p2 - p0);
+                }
+
+                // Triangles around a that also use b
+                size_t countSharedTriangles(unsigned a, unsigned b) const {
+                    size_t count = 0;
+                    for (unsigned t : _vertex_triangles[a]) {
+                        if (_triangle_alive[t] && (_indices[3 * t] == b || _indices[3 * t + 1] == b || _indices[3 * t + 2] == b)) {
+                            ++count;
+                        }
+                    }
+                    return count;
+                }
+
+                void computeQuadrics() {
+                    for (size_t t = 0; t < _triangle_alive.size(); ++t) {
+                        XMVECTOR normal = triangleNormal(t);
+                        float double_area = XMVectorGetX(XMVector3Length(normal));
+                        if (double_area == 0.0f) {
+                            continue;
+                        }
+                        normal /= double_area;
+                        XMFLOAT3 n;
+                        XMStoreFloat3(&n, normal);
+                        float d = -XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&_vertices[_indices[3 * t]]._pos)));
+                        Quadric q = planeQuadric(n, d, 1.0);
+
+                        for (size_t k = 0; k < 3; ++k) {
+                            unsigned a = _indices[3 * t + k];
+                            unsigned b = _indices[3 * t + (k + 1) % 3];
+                            _quadrics[a] += q;
+
+                            // Edges with any other number of triangles than two are borders or non-manifold
+                            if (countSharedTriangles(a, b) == 2) {
+                                continue;
+                            }
+                            if (_options._lock_border) {
+                                _locked[a] = 1;
+                                _locked[b] = 1;
+                                continue;
+                            }
+                            XMVECTOR pa = XMLoadFloat3(&_vertices[a]._pos);
+                            XMVECTOR edge = XMLoadFloat3(&_vertices[b]._pos) - pa;
+                            XMVECTOR border_normal = XMVector3Normalize(XMVector3Cross(edge, normal));
+                            XMFLOAT3 bn;
+                            XMStoreFloat3(&bn, border_normal);
+                            float border_d = -XMVectorGetX(XMVector3Dot(border_normal, pa));
+                            Quadric border = planeQuadric(bn, border_d, BORDER_WEIGHT);
+                            _quadrics[a] += border;
+                            _quadrics[b] += border;
+                        }
+                    }
+                }
+
+                float cost(unsigned from, unsigned to) const {
+                    Quadric q = _quadrics[from];
+                    q += _quadrics[to];
+                    double error = evaluate(q, _vertices[to]._pos);
+                    if (_options._normal_weight > 0.0f) {
+                        XMVECTOR difference = XMLoadFloat3(&_vertices[from]._nor) - XMLoadFloat3(&_vertices[to]._nor);
+                        double attribute = _options._normal_weight * XMVectorGetX(XMVector3Length(difference));
+                        error += attribute * attribute;
+                    }
+                    return (float)error;
+                }
+
+                void collectNeighbours(unsigned v, std::vector<unsigned>& neighbours) const {
+                    neighbours.clear();
+                    for (unsigned t : _vertex_triangles[v]) {
+                        if (_triangle_alive[t]) {
+                            for (size_t k = 0; k < 3; ++k) {
+                                if (_indices[3 * t + k] != v) {
+                                    neighbours.push_back(_indices[3 * t + k]);
+                                }
+                            }
+                        }
+                    }
+                    std::sort(neighbours.begin(), neighbours.end());
+                    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+                }
+
+                // Finds the cheapest neighbour to collapse onto
+                void updateVertex(unsigned v) {
+                    if (_locked[v] || _vertex_triangles[v].empty()) {
+                        _heap.remove(v);
+                        return;
+                    }
+                    collectNeighbours(v, _update_neighbours);
+                    float best_cost = FLT_MAX;
+                    for (unsigned neighbour : _update_neighbours) {
+                        float neighbour_cost = cost(v, neighbour);
+                        if (neighbour_cost < best_cost) {
+                            best_cost = neighbour_cost;
+                            _targets[v] = neighbour;
+                        }
+                    }
+                    if (best_cost == FLT_MAX) {
+                        _heap.remove(v);
+                    } else {
+                        _heap.update(v, best_cost);
+                    }
+                }
+
+                bool canCollapse(unsigned from, unsigned to) {
+                    // Link condition: the only common neighbours are the ones across the shared triangles,
+                    // anything else would pinch the surface into a non-manifold edge
+                    collectNeighbours(from, _from_neighbours);
+                    collectNeighbours(to, _to_neighbours);
+                    size_t common = 0;
+                    for (auto i = _from_neighbours.begin(), j = _to_neighbours.begin(); i != _from_neighbours.end() && j != _to_neighbours.end();) {
+                        if (*i < *j) {
+                            ++i;
+                        } else if (*j < *i) {
+                            ++j;
+                        } else {
+                            ++common, ++i, ++j;
+                        }
+                    }
+                    if (common != countSharedTriangles(from, to)) {
+                        return false;
+                    }
+
+                    // No triangle that survives the collapse may flip or degenerate
+                    XMVECTOR target = XMLoadFloat3(&_vertices[to]._pos);
+                    for (unsigned t : _vertex_triangles[from]) {
+                        if (!_triangle_alive[t]) {
+                            continue;
+                        }
+                        const unsigned* triangle = &_indices[3 * t];
+                        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                            continue;
+                        }
+                        XMVECTOR p[3];
+                        for (size_t k = 0; k < 3; ++k) {
+                            p[k] = triangle[k] == from ? target : XMLoadFloat3(&_vertices[triangle[k]]._pos);
+                        }
+                        XMVECTOR before = XMVector3Normalize(triangleNormal(t));
+                        XMVECTOR after = XMVector3Normalize(XMVector3Cross(p[1] - p[0], p[2] - p[0]));
+                        if (!(XMVectorGetX(XMVector3Dot(before, after)) >= MIN_NORMAL_COS)) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+                // Returns the number of removed triangles
+                size_t performCollapse(unsigned from, unsigned to) {
+                    size_t removed = 0;
+                    for (unsigned t : _vertex_triangles[from]) {
+                        if (!_triangle_alive[t]) {
+                            continue;
+                        }
+                        unsigned* triangle = &_indices[3 * t];
+                        if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                            _triangle_alive[t] = 0;
+                            ++removed;
+                            continue;
+                        }
+                        for (size_t k = 0; k < 3; ++k) {
+                            if (triangle[k] == from) {
+                                triangle[k] = to;
+                            }
+                        }
+                        _vertex_triangles[to].push_back(t);
+                    }
+                    _vertex_triangles[from].clear();
+                    _vertex_triangles[from].shrink_to_fit();
+
+                    std::vector<unsigned>& triangles = _vertex_triangles[to];
+                    triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [&](unsigned t) { return !_triangle_alive[t]; }), triangles.end());
+
+                    _quadrics[to] += _quadrics[from];
+
+                    updateVertex(to);
+                    collectNeighbours(to, _to_neighbours);
+                    for (unsigned neighbour : _to_neighbours) {
+                        // Only collapses onto the merged vertex changed, the rest of what the neighbour knew still holds
+                        if (_targets[neighbour] == from || _targets[neighbour] == to || !_heap.contains(neighbour)) {
+                            updateVertex(neighbour);
+                        } else if (!_locked[neighbour]) {
+                            float neighbour_cost = cost(neighbour, to);
+                            if (neighbour_cost < _heap.getCost(neighbour)) {
+                                _targets[neighbour] = to;
+                                _heap.update(neighbour, neighbour_cost);
+                            }
+                        }
+                    }
+                    return removed;
+                }
+
+                const std::vector<SimpleVertex>& _vertices;
+                std::vector<unsigned> _indices;
+                const SimplifyOptions& _options;
+
+                std::vector<uint8_t> _triangle_alive;
+                std::vector<std::vector<unsigned>> _vertex_triangles;
+                std::vector<Quadric> _quadrics;
+                std::vector<unsigned> _targets;
+                std::vector<uint8_t> _locked;
+
+                CollapseHeap _heap;
+                std::vector<unsigned> _from_neighbours;
+                std::vector<unsigned> _to_neighbours;
+                std::vector<unsigned> _update_neighbours;
+            };
+
+            float simplify(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const SimplifyOptions& options, const std::vector<uint8_t>& locked) {
+                if (indices.size() <= options._target_index_count) {
+                    return 0.0f;
+                }
+                Simplifier simplifier(vertices, indices, options, locked);
+                float error = simplifier.run();
+                simplifier.write(indices);
+                return error;
+            }
+        }
+
+        float simplifyMesh(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const SimplifyOptions& options) {
+            return simplify(vertices, indices, options, {});
+        }
+
+        float simplifyMeshParallel(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const SimplifyOptions& options, size_t chunk_count) {
+            const size_t triangle_count = indices.size() / 3;
+            chunk_count = std::max<size_t>(std::min(chunk_count, triangle_count), 1);
+            if (chunk_count == 1) {
+                return simplifyMesh(vertices, indices, options);
+            }
+
+            XMVECTOR min = XMVectorReplicate(FLT_MAX);
+            XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+            for (const SimpleVertex& vertex : vertices) {
+                min = XMVectorMin(min, XMLoadFloat3(&vertex._pos));
+                max = XMVectorMax(max, XMLoadFloat3(&vertex._pos));
+            }
+            XMFLOAT3 extent;
+            XMStoreFloat3(&extent, max - min);
+            const float chunk_max_error = CHUNK_MAX_RELATIVE_ERROR * XMVectorGetX(XMVector3Length(max - min));
+            const size_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+            // Slabs of equal triangle count, ordered by the centroid along the longest axis
+            std::vector<float> keys(triangle_count);
+            for (size_t t = 0; t < triangle_count; ++t) {
+                keys[t] = 0.0f;
+                for (size_t k = 0; k < 3; ++k) {
+                    keys[t] += (&vertices[indices[3 * t + k]]._pos.x)[axis];
+                }
+            }
+            std::vector<unsigned> order(triangle_count);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return keys[a] < keys[b]; });
+
+            std::vector<unsigned> chunk_of_triangle(triangle_count);
+            for (size_t i = 0; i < triangle_count; ++i) {
+                chunk_of_triangle[order[i]] = (unsigned)(i * chunk_count / triangle_count);
+            }
+
+            const unsigned NO_CHUNK = ~0u;
+            std::vector<unsigned> vertex_chunk(vertices.size(), NO_CHUNK);
+            std::vector<uint8_t> shared(vertices.size(), 0);
+            for (size_t i = 0; i < indices.size(); ++i) {
+                unsigned chunk = chunk_of_triangle[i / 3];
+                unsigned& owner = vertex_chunk[indices[i]];
+                if (owner == NO_CHUNK) {
+                    owner = chunk;
+                } else if (owner != chunk) {
+                    shared[indices[i]] = 1;
+                }
+            }
+
+            std::vector<std::vector<unsigned>> chunk_indices(chunk_count);
+            std::vector<float> chunk_errors(chunk_count, 0.0f);
+            software::parallelFor(chunk_count, [&](size_t chunk) {
+                std::vector<unsigned> global_indices;
+                for (size_t i = chunk * triangle_count / chunk_count; i < (chunk + 1) * triangle_count / chunk_count; ++i) {
+                    global_indices.insert(global_indices.end(), &indices[3 * order[i]], &indices[3 * order[i]] + 3);
+                }
+
+                std::unordered_map<unsigned, unsigned> local_of_global;
+                std::vector<unsigned> global_of_local;
+                std::vector<SimpleVertex> local_vertices;
+                std::vector<uint8_t> local_locked;
+                std::vector<unsigned> local_indices(global_indices.size());
+                for (size_t i = 0; i < global_indices.size(); ++i) {
+                    auto result = local_of_global.emplace(global_indices[i], (unsigned)global_of_local.size());
+                    if (result.second) {
+                        global_of_local.push_back(global_indices[i]);
+                        local_vertices.push_back(vertices[global_indices[i]]);
+                        local_locked.push_back(shared[global_indices[i]]);
+                    }
+                    local_indices[i] = result.first->second;
+                }
+
+                SimplifyOptions chunk_options = options;
+                chunk_options._target_index_count = (size_t)((double)options._target_index_count * global_indices.size() / indices.size()) / 3 * 3;
+                chunk_options._target_error = std::min(options._target_error, chunk_max_error);
+                chunk_errors[chunk] = simplify(local_vertices, local_indices, chunk_options, local_locked);
+
+                for (unsigned& index : local_indices) {
+                    index = global_of_local[index];
+                }
+                chunk_indices[chunk].swap(local_indices);
+            });
+
+            indices.clear();
+            for (const std::vector<unsigned>& chunk : chunk_indices) {
+                indices.insert(indices.end(), chunk.begin(), chunk.end());
+            }
+            // The final pass measures against the reduced mesh, the errors of both passes add up at worst
+            float chunk_error = *std::max_element(chunk_errors.begin(), chunk_errors.end());
+            SimplifyOptions final_options = options;
+            final_options._target_error = options._target_error - chunk_error;
+            if (final_options._target_error < 0.0f) {
+                return chunk_error;
+            }
+            return chunk_error + simplifyMesh(vertices, indices, final_options);
+        }
+    }
+}
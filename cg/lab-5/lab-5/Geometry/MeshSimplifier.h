@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cfloat>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        struct SimplifyOptions {
+            // Stops once the mesh has at most this many indices
+            size_t _target_index_count = 0;
+            // Stops before a collapse would move the surface further than this, in object space units
+            float _target_error = FLT_MAX;
+            // Object space distance that a unit difference between the normals of a collapsed edge counts as
+            float _normal_weight = 0.0f;
+            // Border vertices never move. Without the lock, borders are held in place by planes perpendicular to them
+            bool _lock_border = true;
+        };
+
+        // Garland-Heckbert edge collapse (Garland, Heckbert 1997), cheapest collapse first. Vertices only collapse
+        // onto each other, so the result still indexes the input vertices and optimizeVertexFetch drops the unused
+        // ones. Vertices that share a position with another vertex (normal seams) are kept in place.
+        // Returns the largest error of a performed collapse
+        float simplifyMesh(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const SimplifyOptions& options);
+
+        // Splits the mesh into chunk_count slabs along its longest axis and simplifies them on all hardware threads.
+        // Vertices used by more than one slab are locked, so the seams stay watertight. The slabs only do the cheap
+        // collapses, a serial pass over what is left reaches the target
+        float simplifyMeshParallel(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const SimplifyOptions& options, size_t chunk_count);
+    }
+}
@@ -0,0 +1,237 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const unsigned NOT_IN_MESHLET = ~0u;
+
+            XMVECTOR triangleNormal(const SimpleVertex* vertices, const unsigned* triangle) {
+                XMVECTOR p0 = XMLoadFloat3(&vertices[triangle[0]]._pos);
+                XMVECTOR p1 = XMLoadFloat3(&vertices[triangle[1]]._pos);
+                XMVECTOR p2 = XMLoadFloat3(&vertices[triangle[2]]._pos);
+                return XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+            }
+
+            void computeBounds(Meshlet& meshlet, const MeshletMesh& mesh, const SimpleVertex* vertices, const std::vector<XMFLOAT3>& normals,
+                const std::vector<unsigned>& triangles) {
+                XMVECTOR min = XMVectorReplicate(FLT_MAX);
+                XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+                for (uint32_t i = 0; i < meshlet._vertex_count; ++i) {
+                    XMVECTOR pos = XMLoadFloat3(&vertices[mesh._vertices[meshlet._vertex_offset + i]]._pos);
+                    min = XMVectorMin(min, pos);
+                    max = XMVectorMax(max, pos);
+                }
+                XMVECTOR center = (min + max) * 0.5f;
+                float radius = 0.0f;
+                for (uint32_t i = 0; i < meshlet._vertex_count; ++i) {
+                    XMVECTOR pos = XMLoadFloat3(&vertices[mesh._vertices[meshlet._vertex_offset + i]]._pos);
+                    radius = std::max(radius, XMVectorGetX(XMVector3Length(pos - center)));
+                }
+                XMStoreFloat3(&meshlet._center, center);
+                meshlet._radius = radius;
+
+                XMVECTOR axis = XMVectorZero();
+                for (unsigned t : triangles) {
+                    axis += XMLoadFloat3(&normals[t]);
+                }
+                if (XMVectorGetX(XMVector3LengthSq(axis)) == 0.0f) {
+                    return;
+                }
+                axis = XMVector3Normalize(axis);
+                float min_dot = 1.0f;
+                for (unsigned t : triangles) {
+                    XMVECTOR normal = XMLoadFloat3(&normals[t]);
+                    // Degenerate triangles have no normal and are never rasterized
+                    if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f) {
+                        min_dot = std::min(min_dot, XMVectorGetX(XMVector3Dot(normal, axis)));
+                    }
+                }
+                XMStoreFloat3(&meshlet._cone_axis, axis);
+                meshlet._cone_cutoff = min_dot <= 0.0f ? 1.0f : sqrtf(1.0f - min_dot * min_dot);
+            }
+        }
+
+        MeshletMesh buildMeshlets(const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count,
+            size_t max_vertices, size_t max_triangles) {
+            assert(max_vertices >= 3 && max_vertices <= 256 && max_triangles >= 1);
+            const size_t triangle_count = index_count / 3;
+
+            std::vector<unsigned> offsets(vertex_count + 1, 0);
+            for (size_t i = 0; i < index_count; ++i) {
+                ++offsets[indices[i] + 1];
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            std::vector<unsigned> vertex_triangles(index_count);
+            {
+                std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < index_count; ++i) {
+                    vertex_triangles[fill[indices[i]]++] = (unsigned)(i / 3);
+                }
+            }
+
+            std::vector<XMFLOAT3> normals(triangle_count);
+            for (size_t t = 0; t < triangle_count; ++t) {
+                XMStoreFloat3(&normals[t], triangleNormal(vertices, &indices[3 * t]));
+            }
+
+            MeshletMesh mesh;
+            std::vector<uint8_t> emitted(triangle_count, 0);
+            std::vector<unsigned> local_index(vertex_count, NOT_IN_MESHLET);
+            std::vector<unsigned> candidates;
+            std::vector<unsigned> meshlet_triangles;
+            size_t scan = 0;
+            size_t emitted_count = 0;
+
+            while (emitted_count < triangle_count) {
+                Meshlet meshlet;
+                meshlet._vertex_offset = (uint32_t)mesh._vertices.size();
+                meshlet._triangle_offset = (uint32_t)mesh._triangles.size();
+                meshlet_triangles.clear();
+                XMVECTOR normal_sum = XMVectorZero();
+
+                // The last triangle the previous meshlet could not take seeds the next one, so neighbouring meshlets
+                // stay adjacent. Only the seed is kept, the rest of the old frontier would just be scanned again and again
+                while (!candidates.empty() && emitted[candidates.back()]) {
+                    candidates.pop_back();
+                }
+                if (candidates.empty()) {
+                    while (emitted[scan]) {
+                        ++scan;
+                    }
+                    candidates.push_back((unsigned)scan);
+                }
+                candidates.erase(candidates.begin(), candidates.end() - 1);
+
+                for (;;) {
+                    size_t best = candidates.size();
+                    unsigned best_new = 4;
+                    float best_dot = -FLT_MAX;
+                    XMVECTOR average = XMVector3Normalize(normal_sum);
+                    for (size_t i = 0; i < candidates.size(); ++i) {
+                        unsigned t = candidates[i];
+                        if (emitted[t]) {
+                            continue;
+                        }
+                        unsigned new_vertices = 0;
+                        for (size_t k = 0; k < 3; ++k) {
+                            new_vertices += local_index[indices[3 * t + k]] == NOT_IN_MESHLET;
+                        }
+                        if (meshlet._vertex_count + new_vertices > max_vertices) {
+                            continue;
+                        }
+                        float dot = XMVectorGetX(XMVector3Dot(average, XMLoadFloat3(&normals[t])));
+                        if (new_vertices < best_new || (new_vertices == best_new && dot > best_dot)) {
+                            best = i;
+                            best_new = new_vertices;
+                            best_dot = dot;
+                        }
+                    }
+                    if (best == candidates.size()) {
+                        break;
+                    }
+
+                    unsigned t = candidates[best];
+                    emitted[t] = 1;
+                    ++emitted_count;
+                    meshlet_triangles.push_back(t);
+                    normal_sum += XMLoadFloat3(&normals[t]);
+                    for (size_t k = 0; k < 3; ++k) {
+                        unsigned v = indices[3 * t + k];
+                        if (local_index[v] == NOT_IN_MESHLET) {
+                            local_index[v] = meshlet._vertex_count++;
+                            mesh._vertices.push_back(v);
+                            for (unsigned i = offsets[v]; i < offsets[v + 1]; ++i) {
+                                if (!emitted[vertex_triangles[i]]) {
+                                    candidates.push_back(vertex_triangles[i]);
+                                }
+                            }
+                        }
+                        mesh._triangles.push_back((uint8_t)local_index[v]);
+                    }
+                    if (++meshlet._triangle_count == max_triangles) {
+                        break;
+                    }
+                }
+
+                for (uint32_t i = 0; i < meshlet._vertex_count; ++i) {
+                    local_index[mesh._vertices[meshlet._vertex_offset + i]] = NOT_IN_MESHLET;
+                }
+                computeBounds(meshlet, mesh, vertices, normals, meshlet_triangles);
+                mesh._meshlets.push_back(meshlet);
+            }
+            return mesh;
+        }
+
+        MeshletMesh buildMeshlets(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, size_t max_vertices, size_t max_triangles) {
+            return buildMeshlets(vertices.data(), vertices.size(), indices.data(), indices.size(), max_vertices, max_triangles);
+        }
+
+        // Gribb-Hartmann: with row vectors the clip coordinates are dot products with the matrix columns,
+        // and D3D clips z to [0, w]
+        void extractFrustumPlanes(FXMMATRIX view_projection, XMVECTOR planes[6]) {
+            XMMATRIX columns = XMMatrixTranspose(view_projection);
+            planes[0] = columns.r[3] + columns.r[0];
+            planes[1] = columns.r[3] - columns.r[0];
+            planes[2] = columns.r[3] + columns.r[1];
+            planes[3] = columns.r[3] - columns.r[1];
+            planes[4] = columns.r[2];
+            planes[5] = columns.r[3] - columns.r[2];
+            for (size_t i = 0; i < 6; ++i) {
+                planes[i] = XMPlaneNormalize(planes[i]);
+            }
+        }
+
+        bool isMeshletVisible(const Meshlet& meshlet, FXMMATRIX world, const XMVECTOR planes[6], FXMVECTOR camera_pos) {
+            XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&meshlet._center), world);
+            float radius = meshlet._radius * XMVectorGetX(XMVector3Length(world.r[0]));
+            for (size_t i = 0; i < 6; ++i) {
+                if (XMVectorGetX(XMPlaneDotCoord(planes[i], center)) < -radius) {
+                    return false;
+                }
+            }
+
+            // Every triangle faces away once the whole bounding sphere is behind the plane through the camera
+            // that the widest normal of the cone lies in
+            if (meshlet._cone_cutoff < 1.0f) {
+                XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&meshlet._cone_axis), world));
+                XMVECTOR view = center - camera_pos;
+                float distance = XMVectorGetX(XMVector3Length(view));
+                if (XMVectorGetX(XMVector3Dot(view, axis)) >= meshlet._cone_cutoff * distance + radius) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        MeshletCullStats cullMeshlets(const MeshletMesh& mesh, FXMMATRIX world, CXMMATRIX view_projection, FXMVECTOR camera_pos, std::vector<unsigned>& indices) {
+            XMVECTOR planes[6];
+            extractFrustumPlanes(view_projection, planes);
+
+            MeshletCullStats stats;
+            stats._meshlets = mesh._meshlets.size();
+            indices.clear();
+            for (const Meshlet& meshlet : mesh._meshlets) {
+                stats._triangles += meshlet._triangle_count;
+                if (!isMeshletVisible(meshlet, world, planes, camera_pos)) {
+                    continue;
+                }
+                ++stats._visible_meshlets;
+                stats._visible_triangles += meshlet._triangle_count;
+                const unsigned* meshlet_vertices = &mesh._vertices[meshlet._vertex_offset];
+                const uint8_t* triangles = &mesh._triangles[meshlet._triangle_offset];
+                for (uint32_t i = 0; i < 3 * meshlet._triangle_count; ++i) {
+                    indices.push_back(meshlet_vertices[triangles[i]]);
+                }
+            }
+            return stats;
+        }
+    }
+}
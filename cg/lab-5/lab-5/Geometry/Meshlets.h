@@ -0,0 +1,62 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        // Limits of the mesh shader pipeline. 124 rather than 128 triangles keeps the local index block of a
+        // full meshlet a multiple of 4 bytes
+        const size_t MESHLET_MAX_VERTICES = 64;
+        const size_t MESHLET_MAX_TRIANGLES = 124;
+
+        struct Meshlet {
+            uint32_t _vertex_offset = 0;
+            uint32_t _triangle_offset = 0;
+            uint32_t _vertex_count = 0;
+            uint32_t _triangle_count = 0;
+
+            DirectX::XMFLOAT3 _center = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+            float _radius = 0.0f;
+            // Every triangle normal is within the cone around the axis. The cutoff is the sine of its half angle,
+            // 1 when the cone is too wide to ever face away from the camera
+            DirectX::XMFLOAT3 _cone_axis = DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f);
+            float _cone_cutoff = 1.0f;
+        };
+
+        // Meshlet vertices are indices into the source vertex buffer, meshlet triangles index the meshlet vertices
+        struct MeshletMesh {
+            std::vector<Meshlet> _meshlets;
+            std::vector<unsigned> _vertices;
+            std::vector<uint8_t> _triangles;
+        };
+
+        struct MeshletCullStats {
+            size_t _meshlets = 0;
+            size_t _visible_meshlets = 0;
+            size_t _triangles = 0;
+            size_t _visible_triangles = 0;
+        };
+
+        // Grows every meshlet from a seed triangle over its neighbours, preferring triangles that add the fewest new
+        // vertices and then the ones closest to the meshlet's average normal, so the cones stay narrow
+        MeshletMesh buildMeshlets(const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count,
+            size_t max_vertices = MESHLET_MAX_VERTICES, size_t max_triangles = MESHLET_MAX_TRIANGLES);
+        MeshletMesh buildMeshlets(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices,
+            size_t max_vertices = MESHLET_MAX_VERTICES, size_t max_triangles = MESHLET_MAX_TRIANGLES);
+
+        // Six normalized planes of a view projection matrix, inside is dot(plane, p) >= 0
+        void extractFrustumPlanes(DirectX::FXMMATRIX view_projection, DirectX::XMVECTOR planes[6]);
+
+        bool isMeshletVisible(const Meshlet& meshlet, DirectX::FXMMATRIX world, const DirectX::XMVECTOR planes[6], DirectX::FXMVECTOR camera_pos);
+
+        // Writes the source indices of the meshlets that are inside the frustum and not facing away from the camera.
+        // world may scale uniformly
+        MeshletCullStats cullMeshlets(const MeshletMesh& mesh, DirectX::FXMMATRIX world, DirectX::CXMMATRIX view_projection, DirectX::FXMVECTOR camera_pos,
+            std::vector<unsigned>& indices);
+    }
+}
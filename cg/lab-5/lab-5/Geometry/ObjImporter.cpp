@@ -0,0 +1,525 @@
+#include "ObjImporter.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "VertexWelding.h"
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const uint32_t NO_NORMAL = ~0u;
+            const uint32_t NO_VERTEX = ~0u;
+            const int64_t NOT_RELATIVE = INT64_MAX;
+            const size_t SHARD_BITS = 6;
+            const size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+            // Faces with more corners than this are broken, not polygons
+            const size_t MAX_FACE_CORNERS = 4096;
+
+            const double POW10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+            };
+
+            struct Corner {
+                uint32_t _pos;
+                uint32_t _nor;
+            };
+
+            // Negative OBJ indices count back from the last element read so far, which is only
+            // known once the chunks before are counted
+            struct RelativeIndex {
+                size_t _corner;
+                bool _normal;
+                int64_t _local;
+            };
+
+            struct FaceCorner {
+                Corner _corner;
+                int64_t _relative_pos;
+                int64_t _relative_nor;
+            };
+
+            struct ObjChunk {
+                const char* _begin = nullptr;
+                const char* _end = nullptr;
+                std::vector<XMFLOAT3> _positions;
+                std::vector<XMFLOAT3> _normals;
+                std::vector<Corner> _corners;
+                std::vector<RelativeIndex> _relative;
+                size_t _lines = 0;
+                ObjStatus _status = ObjStatus::OK;
+                size_t _position_base = 0;
+                size_t _normal_base = 0;
+                size_t _corner_base = 0;
+                size_t _shard_offsets[SHARD_COUNT] = {};
+            };
+
+            bool isSpace(char c) {
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            bool isDigit(char c) {
+                return c >= '0' && c <= '9';
+            }
+
+            bool isTokenEnd(const char* p, const char* end) {
+                return p == end || isSpace(*p) || *p == '\n' || *p == '#';
+            }
+
+            void skipSpaces(const char*& p, const char* end) {
+                while (p < end && isSpace(*p)) {
+                    ++p;
+                }
+            }
+
+            // Clinger's fast path: up to 19 significant digits and a power of ten that is exact in a
+            // double. Anything else goes to strtod, which needs a terminated copy of the token
+            bool parseFloat(const char*& p, const char* end, float& value) {
+                skipSpaces(p, end);
+                const char* start = p;
+                bool negative = false;
+                if (p < end && (*p == '-' || *p == '+')) {
+                    negative = *p == '-';
+                    ++p;
+                }
+
+                uint64_t mantissa = 0;
+                int digits = 0;
+                int exponent = 0;
+                bool any = false;
+                bool exact = true;
+                for (; p < end && isDigit(*p); ++p) {
+                    any = true;
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + (*p - '0');
+                        digits += mantissa != 0;
+                    } else {
+                        exact &= *p == '0';
+                        ++exponent;
+                    }
+                }
+                if (p < end && *p == '.') {
+                    for (++p; p < end && isDigit(*p); ++p) {
+                        any = true;
+                        if (digits < 19) {
+                            mantissa = mantissa * 10 + (*p - '0');
+                            digits += mantissa != 0;
+                            --exponent;
+                        } else {
+                            exact &= *p == '0';
+                        }
+                    }
+                }
+                if (!any) {
+                    return false;
+                }
+                if (p < end && (*p == 'e' || *p == 'E')) {
+                    ++p;
+                    bool negative_exponent = false;
+                    if (p < end && (*p == '-' || *p == '+')) {
+                        negative_exponent = *p == '-';
+                        ++p;
+                    }
+                    if (p == end || !isDigit(*p)) {
+                        return false;
+                    }
+                    int written = 0;
+                    for (; p < end && isDigit(*p); ++p) {
+                        written = std::min(written * 10 + (*p - '0'), 100000);
+                    }
+                    exponent += negative_exponent ? -written : written;
+                }
+                if (!isTokenEnd(p, end)) {
+                    return false;
+                }
+
+                if (exact && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+                    double result = (double)mantissa;
+                    result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+                    value = (float)(negative ? -result : result);
+                    return true;
+                }
+                char buffer[128];
+                size_t length = std::min<size_t>(p - start, sizeof(buffer) - 1);
+                memcpy(buffer, start, length);
+                buffer[length] = '\0';
+                value = (float)strtod(buffer, nullptr);
+                return true;
+            }
+
+            bool parseIndex(const char*& p, const char* end, int64_t& index) {
+                bool negative = false;
+                if (p < end && *p == '-') {
+                    negative = true;
+                    ++p;
+                }
+                if (p == end || !isDigit(*p)) {
+                    return false;
+                }
+                int64_t value = 0;
+                for (; p < end && isDigit(*p); ++p) {
+                    value = value * 10 + (*p - '0');
+                    if (value > UINT32_MAX) {
+                        return false;
+                    }
+                }
+                index = negative ? -value : value;
+                return true;
+            }
+
+            // 1-based indices become global ones right away, negative ones stay relative to the chunk start
+            void resolveIndex(int64_t index, size_t local_count, uint32_t& global, int64_t& relative) {
+                if (index > 0) {
+                    global = (uint32_t)(index - 1);
+                    relative = NOT_RELATIVE;
+                } else {
+                    global = 0;
+                    relative = (int64_t)local_count + index;
+                }
+            }
+
+            ObjStatus parseFace(const char*& p, const char* end, ObjChunk& chunk, std::vector<FaceCorner>& face) {
+                face.clear();
+                for (;;) {
+                    skipSpaces(p, end);
+                    if (isTokenEnd(p, end)) {
+                        break;
+                    }
+                    int64_t pos = 0;
+                    int64_t nor = 0;
+                    if (!parseIndex(p, end, pos)) {
+                        return ObjStatus::PARSE_ERROR;
+                    }
+                    if (p < end && *p == '/') {
+                        ++p;
+                        int64_t texcoord = 0;
+                        if (p < end && *p != '/' && !parseIndex(p, end, texcoord)) {
+                            return ObjStatus::PARSE_ERROR;
+                        }
+                        if (p < end && *p == '/') {
+                            ++p;
+                            if (!parseIndex(p, end, nor)) {
+                                return ObjStatus::PARSE_ERROR;
+                            }
+                        }
+                    }
+                    if (!isTokenEnd(p, end) || face.size() == MAX_FACE_CORNERS) {
+                        return ObjStatus::PARSE_ERROR;
+                    }
+
+                    // Index 0 does not exist in OBJ, for normals it means there is none
+                    if (pos == 0) {
+                        return ObjStatus::BAD_INDEX;
+                    }
+                    FaceCorner corner = { { 0, NO_NORMAL }, NOT_RELATIVE, NOT_RELATIVE };
+                    resolveIndex(pos, chunk._positions.size(), corner._corner._pos, corner._relative_pos);
+                    if (nor != 0) {
+                        resolveIndex(nor, chunk._normals.size(), corner._corner._nor, corner._relative_nor);
+                    }
+                    face.push_back(corner);
+                }
+                if (face.size() < 3) {
+                    return ObjStatus::PARSE_ERROR;
+                }
+
+                auto emit = [&](const FaceCorner& corner) {
+                    if (corner._relative_pos != NOT_RELATIVE) {
+                        chunk._relative.push_back({ chunk._corners.size(), false, corner._relative_pos });
+                    }
+                    if (corner._relative_nor != NOT_RELATIVE) {
+                        chunk._relative.push_back({ chunk._corners.size(), true, corner._relative_nor });
+                    }
+                    chunk._corners.push_back(corner._corner);
+                };
+                for (size_t i = 2; i < face.size(); ++i) {
+                    emit(face[0]);
+                    emit(face[i - 1]);
+                    emit(face[i]);
+                }
+                return ObjStatus::OK;
+            }
+
+            void parseChunk(ObjChunk& chunk) {
+                std::vector<FaceCorner> face;
+                const char* p = chunk._begin;
+                const char* end = chunk._end;
+                while (p < end) {
+                    skipSpaces(p, end);
+                    ObjStatus status = ObjStatus::OK;
+                    if (end - p >= 2 && p[0] == 'v' && isSpace(p[1])) {
+                        ++p;
+                        XMFLOAT3 pos;
+                        if (parseFloat(p, end, pos.x) && parseFloat(p, end, pos.y) && parseFloat(p, end, pos.z)) {
+                            chunk._positions.push_back(pos);
+                        } else {
+                            status = ObjStatus::PARSE_ERROR;
+                        }
+                    } else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+                        p += 2;
+                        XMFLOAT3 nor;
+                        if (parseFloat(p, end, nor.x) && parseFloat(p, end, nor.y) && parseFloat(p, end, nor.z)) {
+                            chunk._normals.push_back(nor);
+                        } else {
+                            status = ObjStatus::PARSE_ERROR;
+                        }
+                    } else if (end - p >= 2 && p[0] == 'f' && isSpace(p[1])) {
+                        ++p;
+                        status = parseFace(p, end, chunk, face);
+                    }
+                    if (status != ObjStatus::OK) {
+                        chunk._status = status;
+                        return;
+                    }
+
+                    // Vertex weights and colors, texture coordinates, groups, materials and comments are skipped
+                    const char* line_end = (const char*)memchr(p, '\n', end - p);
+                    p = line_end ? line_end + 1 : end;
+                    ++chunk._lines;
+                }
+            }
+
+            uint64_t hashCorner(Corner corner) {
+                return ((uint64_t)corner._pos << 32 | corner._nor) * 0x9e3779b97f4a7c15ull;
+            }
+
+            size_t getShard(uint64_t hash) {
+                return (size_t)(hash >> (64 - SHARD_BITS));
+            }
+        }
+
+        ObjImportReport parseObj(const char* data, size_t size, std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices,
+            const ObjImportOptions& options) {
+            ObjImportReport report;
+            report._bytes = size;
+            vertices.clear();
+            indices.clear();
+
+            std::vector<ObjChunk> chunks;
+            const char* end = data + size;
+            for (const char* p = data; p < end;) {
+                const char* chunk_end = (size_t)(end - p) > options._chunk_size ? p + options._chunk_size : end;
+                const char* line_end = (const char*)memchr(chunk_end, '\n', end - chunk_end);
+                chunks.emplace_back();
+                chunks.back()._begin = p;
+                chunks.back()._end = line_end ? line_end + 1 : end;
+                p = chunks.back()._end;
+            }
+
+            software::parallelFor(chunks.size(), [&](size_t i) {
+                parseChunk(chunks[i]);
+            });
+
+            size_t lines = 0;
+            size_t corner_count = 0;
+            for (ObjChunk& chunk : chunks) {
+                if (chunk._status != ObjStatus::OK) {
+                    report._status = chunk._status;
+                    report._error_line = lines + chunk._lines + 1;
+                    return report;
+                }
+                lines += chunk._lines;
+                chunk._position_base = report._positions;
+                chunk._normal_base = report._normals;
+                chunk._corner_base = corner_count;
+                report._positions += chunk._positions.size();
+                report._normals += chunk._normals.size();
+                corner_count += chunk._corners.size();
+            }
+            report._triangles = corner_count / 3;
+            if (report._positions >= NO_NORMAL || report._normals >= NO_NORMAL || corner_count >= UINT32_MAX) {
+                report._status = ObjStatus::TOO_LARGE;
+                return report;
+            }
+
+            std::vector<XMFLOAT3> positions(report._positions);
+            std::vector<XMFLOAT3> normals(report._normals);
+            std::vector<uint8_t> index_errors(chunks.size(), 0);
+            std::vector<uint32_t> shard_counts(chunks.size() * SHARD_COUNT, 0);
+            software::parallelFor(chunks.size(), [&](size_t i) {
+                ObjChunk& chunk = chunks[i];
+                std::copy(chunk._positions.begin(), chunk._positions.end(), positions.begin() + chunk._position_base);
+                std::copy(chunk._normals.begin(), chunk._normals.end(), normals.begin() + chunk._normal_base);
+
+                for (const RelativeIndex& relative : chunk._relative) {
+                    int64_t global = relative._local + (int64_t)(relative._normal ? chunk._normal_base : chunk._position_base);
+                    if (global < 0) {
+                        index_errors[i] = 1;
+                        return;
+                    }
+                    (relative._normal ? chunk._corners[relative._corner]._nor : chunk._corners[relative._corner]._pos) = (uint32_t)global;
+                }
+                for (const Corner& corner : chunk._corners) {
+                    if (corner._pos >= report._positions || (corner._nor != NO_NORMAL && corner._nor >= report._normals)) {
+                        index_errors[i] = 1;
+                        return;
+                    }
+                    ++shard_counts[i * SHARD_COUNT + getShard(hashCorner(corner))];
+                }
+            });
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                if (index_errors[i]) {
+                    // Indices are only checked once every chunk is counted, the line is not known any more
+                    report._status = ObjStatus::BAD_INDEX;
+                    return report;
+                }
+            }
+
+            // Corners are split into shards by hash and every shard is deduplicated by one thread, in
+            // file order, so the result does not depend on the thread count
+            std::vector<size_t> shard_begin(SHARD_COUNT + 1, 0);
+            for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+                size_t offset = shard_begin[shard];
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    chunks[i]._shard_offsets[shard] = offset;
+                    offset += shard_counts[i * SHARD_COUNT + shard];
+                }
+                shard_begin[shard + 1] = offset;
+            }
+            std::vector<uint32_t> shard_corners(corner_count);
+            software::parallelFor(chunks.size(), [&](size_t i) {
+                ObjChunk& chunk = chunks[i];
+                for (size_t c = 0; c < chunk._corners.size(); ++c) {
+                    shard_corners[chunk._shard_offsets[getShard(hashCorner(chunk._corners[c]))]++] = (uint32_t)(chunk._corner_base + c);
+                }
+            });
+
+            std::vector<Corner> corners(corner_count);
+            software::parallelFor(chunks.size(), [&](size_t i) {
+                std::copy(chunks[i]._corners.begin(), chunks[i]._corners.end(), corners.begin() + chunks[i]._corner_base);
+                std::vector<Corner>().swap(chunks[i]._corners);
+            });
+
+            indices.resize(corner_count);
+            std::vector<std::vector<Corner>> shard_vertices(SHARD_COUNT);
+            software::parallelFor(SHARD_COUNT, [&](size_t shard) {
+                size_t count = shard_begin[shard + 1] - shard_begin[shard];
+                size_t table_size = 16;
+                while (table_size < 2 * count) {
+                    table_size *= 2;
+                }
+                std::vector<uint32_t> table(table_size, NO_VERTEX);
+                std::vector<Corner>& unique = shard_vertices[shard];
+                for (size_t i = shard_begin[shard]; i < shard_begin[shard + 1]; ++i) {
+                    Corner corner = corners[shard_corners[i]];
+                    uint64_t hash = hashCorner(corner);
+                    size_t slot = (size_t)(hash ^ (hash >> 29)) & (table_size - 1);
+                    while (table[slot] != NO_VERTEX) {
+                        const Corner& other = unique[table[slot]];
+                        if (other._pos == corner._pos && other._nor == corner._nor) {
+                            break;
+                        }
+                        slot = (slot + 1) & (table_size - 1);
+                    }
+                    if (table[slot] == NO_VERTEX) {
+                        table[slot] = (uint32_t)unique.size();
+                        unique.push_back(corner);
+                    }
+                    indices[shard_corners[i]] = table[slot];
+                }
+            });
+
+            std::vector<size_t> vertex_base(SHARD_COUNT + 1, 0);
+            for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+                vertex_base[shard + 1] = vertex_base[shard] + shard_vertices[shard].size();
+            }
+            if (vertex_base[SHARD_COUNT] >= NO_VERTEX) {
+                report._status = ObjStatus::TOO_LARGE;
+                indices.clear();
+                return report;
+            }
+
+            std::vector<XMFLOAT3> generated;
+            for (const std::vector<Corner>& unique : shard_vertices) {
+                for (const Corner& corner : unique) {
+                    report._generated_normals |= corner._nor == NO_NORMAL;
+                }
+            }
+            if (report._generated_normals) {
+                generated.assign(positions.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+                for (size_t t = 0; t < corner_count; t += 3) {
+                    XMVECTOR p0 = XMLoadFloat3(&positions[corners[t]._pos]);
+                    XMVECTOR p1 = XMLoadFloat3(&positions[corners[t + 1]._pos]);
+                    XMVECTOR p2 = XMLoadFloat3(&positions[corners[t + 2]._pos]);
+                    // Twice the area long, so bigger faces weigh more
+                    XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+                    for (size_t k = 0; k < 3; ++k) {
+                        XMFLOAT3& sum = generated[corners[t + k]._pos];
+                        XMStoreFloat3(&sum, XMLoadFloat3(&sum) + normal);
+                    }
+                }
+            }
+
+            vertices.resize(vertex_base[SHARD_COUNT]);
+            software::parallelFor(SHARD_COUNT, [&](size_t shard) {
+                const std::vector<Corner>& unique = shard_vertices[shard];
+                for (size_t i = 0; i < unique.size(); ++i) {
+                    SimpleVertex& vertex = vertices[vertex_base[shard] + i];
+                    vertex._pos = positions[unique[i]._pos];
+                    if (unique[i]._nor == NO_NORMAL) {
+                        XMStoreFloat3(&vertex._nor, XMVector3Normalize(XMLoadFloat3(&generated[unique[i]._pos])));
+                    } else {
+                        vertex._nor = normals[unique[i]._nor];
+                    }
+                }
+                for (size_t i = shard_begin[shard]; i < shard_begin[shard + 1]; ++i) {
+                    indices[shard_corners[i]] += (unsigned)vertex_base[shard];
+                }
+            });
+
+            if (options._weld) {
+                weldVertices(vertices, indices, options._weld_options);
+            }
+            if (options._optimize) {
+                optimizeMesh(vertices, indices);
+            }
+            return report;
+        }
+
+        ObjImportReport importObj(const std::filesystem::path& path, std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices,
+            const ObjImportOptions& options) {
+            MappedFile file;
+            if (!file.open(path)) {
+                vertices.clear();
+                indices.clear();
+                ObjImportReport report;
+                std::error_code error;
+                if (!std::filesystem::exists(path, error)) {
+                    report._status = ObjStatus::MISSING;
+                } else if (std::filesystem::is_regular_file(path, error) && std::filesystem::file_size(path, error) == 0) {
+                    // An empty file is a valid, empty mesh, it just cannot be mapped
+                    report._status = ObjStatus::OK;
+                } else {
+                    report._status = ObjStatus::UNREADABLE;
+                }
+                return report;
+            }
+            return parseObj((const char*)file.getData(), file.getSize(), vertices, indices, options);
+        }
+
+        const char* getObjStatusName(ObjStatus status) {
+            switch (status) {
+            case ObjStatus::OK:
+                return "ok";
+            case ObjStatus::MISSING:
+                return "missing";
+            case ObjStatus::UNREADABLE:
+                return "cannot be read";
+            case ObjStatus::PARSE_ERROR:
+                return "parse error";
+            case ObjStatus::BAD_INDEX:
+                return "index out of range";
+            case ObjStatus::TOO_LARGE:
+                return "too large for 32-bit indices";
+            }
+            return "unknown";
+        }
+    }
+}
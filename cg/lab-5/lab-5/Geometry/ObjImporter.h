@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+#include "VertexWelding.h"
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        enum class ObjStatus {
+            OK,
+            MISSING,
+            // Exists but cannot be opened or mapped: a directory, a device, no read permission
+            UNREADABLE,
+            PARSE_ERROR,
+            // A face refers to a position or normal that does not exist
+            BAD_INDEX,
+            // More unique vertices or face corners than 32-bit indices can address
+            TOO_LARGE,
+        };
+
+        struct ObjImportOptions {
+            // Bytes per parsing task, chunks are extended to the next line end
+            size_t _chunk_size = 1 << 20;
+            // Merges positions the exporter duplicated, STL conversions and per-face exports are full of them
+            bool _weld = false;
+            WeldOptions _weld_options;
+            // Runs optimizeMesh on the result. Tipsify is linear, but still costs about as much as the parsing
+            bool _optimize = true;
+        };
+
+        struct ObjImportReport {
+            ObjStatus _status = ObjStatus::OK;
+            // 1-based line of the first error
+            size_t _error_line = 0;
+            size_t _bytes = 0;
+            size_t _positions = 0;
+            size_t _normals = 0;
+            size_t _triangles = 0;
+            // Corners without a normal got the area weighted average of the faces around their position
+            bool _generated_normals = false;
+        };
+
+        // Positions, normals and faces (polygons are fanned) are read, everything else is skipped. Faces keep
+        // their winding and coordinates are taken as they are, OBJ handedness is up to the caller.
+        // Corners with the same position and normal index become one vertex, indices are 32-bit and
+        // encodeMesh narrows them to 16 bits when the vertex count allows
+        ObjImportReport parseObj(const char* data, size_t size, std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices,
+            const ObjImportOptions& options = ObjImportOptions());
+
+        // Maps the file and parses it in place
+        ObjImportReport importObj(const std::filesystem::path& path, std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices,
+            const ObjImportOptions& options = ObjImportOptions());
+
+        const char* getObjStatusName(ObjStatus status);
+    }
+}
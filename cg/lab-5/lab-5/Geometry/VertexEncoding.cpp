@@ -0,0 +1,174 @@
+#include "VertexEncoding.h"
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const float SNORM16_MAX = 32767.0f;
+            const uint16_t SNORM16_ONE = 32767;
+            const uint16_t HALF_ONE = 0x3c00;
+
+            int16_t encodeSnorm16(float value) {
+                return (int16_t)roundf(std::clamp(value, -1.0f, 1.0f) * SNORM16_MAX);
+            }
+
+            // -32768 and -32767 both map to -1, as the input assembler does
+            float decodeSnorm16(int16_t value) {
+                return std::max(value / SNORM16_MAX, -1.0f);
+            }
+
+            float signNotZero(float value) {
+                return value >= 0.0f ? 1.0f : -1.0f;
+            }
+        }
+
+        size_t CompactMesh::getIndexCount() const {
+            return _index_format == IndexFormat::UINT16 ? _indices16.size() : _indices32.size();
+        }
+
+        const void* CompactMesh::getIndexData() const {
+            return _index_format == IndexFormat::UINT16 ? (const void*)_indices16.data() : (const void*)_indices32.data();
+        }
+
+        size_t CompactMesh::getIndexSize() const {
+            return _index_format == IndexFormat::UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        }
+
+        // Projects onto the |x| + |y| + |z| = 1 octahedron and folds the lower half over the upper one
+        XMFLOAT2 octahedralEncode(const XMFLOAT3& normal) {
+            float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+            if (l1 == 0.0f) {
+                return XMFLOAT2(0.0f, 0.0f);
+            }
+            float x = normal.x / l1;
+            float y = normal.y / l1;
+            if (normal.z < 0.0f) {
+                float folded_x = (1.0f - fabsf(y)) * signNotZero(x);
+                float folded_y = (1.0f - fabsf(x)) * signNotZero(y);
+                x = folded_x;
+                y = folded_y;
+            }
+            return XMFLOAT2(x, y);
+        }
+
+        XMFLOAT3 octahedralDecode(const XMFLOAT2& encoded) {
+            XMFLOAT3 n(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+            float t = std::max(-n.z, 0.0f);
+            n.x += n.x >= 0.0f ? -t : t;
+            n.y += n.y >= 0.0f ? -t : t;
+            XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+            return n;
+        }
+
+        CompactMesh encodeMesh(const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count, PositionEncoding position_encoding) {
+            CompactMesh mesh;
+            mesh._position_encoding = position_encoding;
+
+            if (position_encoding == PositionEncoding::SNORM16 && vertex_count > 0) {
+                XMVECTOR min = XMVectorReplicate(FLT_MAX);
+                XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+                for (size_t i = 0; i < vertex_count; ++i) {
+                    XMVECTOR pos = XMLoadFloat3(&vertices[i]._pos);
+                    min = XMVectorMin(min, pos);
+                    max = XMVectorMax(max, pos);
+                }
+                // Flat axes still need a non-zero scale to divide by
+                XMVECTOR scale = XMVectorMax((max - min) * 0.5f, XMVectorReplicate(FLT_MIN));
+                XMStoreFloat3(&mesh._position_scale, scale);
+                XMStoreFloat3(&mesh._position_offset, (max + min) * 0.5f);
+            }
+
+            XMVECTOR offset = XMLoadFloat3(&mesh._position_offset);
+            XMVECTOR inv_scale = XMVectorReciprocal(XMLoadFloat3(&mesh._position_scale));
+            mesh._vertices.resize(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                CompactVertex& compact = mesh._vertices[i];
+                if (position_encoding == PositionEncoding::HALF) {
+                    compact._pos[0] = PackedVector::XMConvertFloatToHalf(vertices[i]._pos.x);
+                    compact._pos[1] = PackedVector::XMConvertFloatToHalf(vertices[i]._pos.y);
+                    compact._pos[2] = PackedVector::XMConvertFloatToHalf(vertices[i]._pos.z);
+                    compact._pos[3] = HALF_ONE;
+                } else {
+                    XMFLOAT3 normalized;
+                    XMStoreFloat3(&normalized, (XMLoadFloat3(&vertices[i]._pos) - offset) * inv_scale);
+                    compact._pos[0] = (uint16_t)encodeSnorm16(normalized.x);
+                    compact._pos[1] = (uint16_t)encodeSnorm16(normalized.y);
+                    compact._pos[2] = (uint16_t)encodeSnorm16(normalized.z);
+                    compact._pos[3] = SNORM16_ONE;
+                }
+
+                XMFLOAT2 octahedral = octahedralEncode(vertices[i]._nor);
+                compact._nor[0] = encodeSnorm16(octahedral.x);
+                compact._nor[1] = encodeSnorm16(octahedral.y);
+            }
+
+            if (vertex_count <= UINT16_MAX + 1) {
+                mesh._index_format = IndexFormat::UINT16;
+                mesh._indices16.assign(indices, indices + index_count);
+            } else {
+                mesh._index_format = IndexFormat::UINT32;
+                mesh._indices32.assign(indices, indices + index_count);
+            }
+            return mesh;
+        }
+
+        CompactMesh encodeMesh(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, PositionEncoding position_encoding) {
+            return encodeMesh(vertices.data(), vertices.size(), indices.data(), indices.size(), position_encoding);
+        }
+
+        std::vector<SimpleVertex> decodeVertices(const CompactMesh& mesh) {
+            std::vector<SimpleVertex> vertices(mesh._vertices.size());
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                const CompactVertex& compact = mesh._vertices[i];
+                XMFLOAT3 quantized;
+                if (mesh._position_encoding == PositionEncoding::HALF) {
+                    quantized = XMFLOAT3(PackedVector::XMConvertHalfToFloat(compact._pos[0]),
+                        PackedVector::XMConvertHalfToFloat(compact._pos[1]), PackedVector::XMConvertHalfToFloat(compact._pos[2]));
+                } else {
+                    quantized = XMFLOAT3(decodeSnorm16((int16_t)compact._pos[0]), decodeSnorm16((int16_t)compact._pos[1]), decodeSnorm16((int16_t)compact._pos[2]));
+                }
+                XMVECTOR pos = XMLoadFloat3(&quantized) * XMLoadFloat3(&mesh._position_scale) + XMLoadFloat3(&mesh._position_offset);
+                XMStoreFloat3(&vertices[i]._pos, pos);
+                vertices[i]._nor = octahedralDecode(XMFLOAT2(decodeSnorm16(compact._nor[0]), decodeSnorm16(compact._nor[1])));
+            }
+            return vertices;
+        }
+
+        std::vector<unsigned> decodeIndices(const CompactMesh& mesh) {
+            if (mesh._index_format == IndexFormat::UINT16) {
+                return std::vector<unsigned>(mesh._indices16.begin(), mesh._indices16.end());
+            }
+            return std::vector<unsigned>(mesh._indices32.begin(), mesh._indices32.end());
+        }
+
+        EncodingReport measureEncoding(const SimpleVertex* vertices, size_t vertex_count, size_t index_count, const CompactMesh& mesh) {
+            EncodingReport report;
+            report._bytes_before = vertex_count * sizeof(SimpleVertex) + index_count * sizeof(unsigned);
+            report._bytes_after = mesh._vertices.size() * sizeof(CompactVertex) + mesh.getIndexCount() * mesh.getIndexSize();
+
+            std::vector<SimpleVertex> decoded = decodeVertices(mesh);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                XMVECTOR error = XMVector3Length(XMLoadFloat3(&decoded[i]._pos) - XMLoadFloat3(&vertices[i]._pos));
+                report._max_position_error = std::max(report._max_position_error, XMVectorGetX(error));
+
+                // acos loses everything below ~0.02 degrees in float, the atan2 form does not
+                XMVECTOR a = XMLoadFloat3(&decoded[i]._nor);
+                XMVECTOR b = XMVector3Normalize(XMLoadFloat3(&vertices[i]._nor));
+                float angle = atan2f(XMVectorGetX(XMVector3Length(XMVector3Cross(a, b))), XMVectorGetX(XMVector3Dot(a, b)));
+                report._max_normal_error = std::max(report._max_normal_error, XMConvertToDegrees(angle));
+            }
+            return report;
+        }
+
+        EncodingReport measureEncoding(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, const CompactMesh& mesh) {
+            return measureEncoding(vertices.data(), vertices.size(), indices.size(), mesh);
+        }
+    }
+}
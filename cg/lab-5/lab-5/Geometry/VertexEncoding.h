@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        enum class PositionEncoding {
+            // R16G16B16A16_FLOAT, stored as is
+            HALF,
+            // R16G16B16A16_SNORM over the mesh bounding box
+            SNORM16,
+        };
+
+        enum class IndexFormat {
+            UINT16,
+            UINT32,
+        };
+
+        // 12 bytes instead of the 24 of SimpleVertex. There is no 3 component 16 bit format,
+        // so the position is padded to 4; w holds 1 and is ignored by the decode
+        struct CompactVertex {
+            uint16_t _pos[4];
+            int16_t _nor[2];
+        };
+
+        // The shader decode is position = quantized * scale + offset, normal = octahedralDecode(quantized)
+        struct CompactMesh {
+            PositionEncoding _position_encoding = PositionEncoding::SNORM16;
+            DirectX::XMFLOAT3 _position_scale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+            DirectX::XMFLOAT3 _position_offset = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+            std::vector<CompactVertex> _vertices;
+
+            IndexFormat _index_format = IndexFormat::UINT32;
+            std::vector<uint16_t> _indices16;
+            std::vector<uint32_t> _indices32;
+
+            size_t getIndexCount() const;
+            const void* getIndexData() const;
+            size_t getIndexSize() const;
+        };
+
+        struct EncodingReport {
+            size_t _bytes_before = 0;
+            size_t _bytes_after = 0;
+            float _max_position_error = 0.0f;
+            // Degrees
+            float _max_normal_error = 0.0f;
+        };
+
+        DirectX::XMFLOAT2 octahedralEncode(const DirectX::XMFLOAT3& normal);
+        DirectX::XMFLOAT3 octahedralDecode(const DirectX::XMFLOAT2& encoded);
+
+        // 16 bit indices are picked whenever every vertex is addressable with them
+        CompactMesh encodeMesh(const SimpleVertex* vertices, size_t vertex_count, const unsigned* indices, size_t index_count,
+            PositionEncoding position_encoding = PositionEncoding::SNORM16);
+        CompactMesh encodeMesh(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, PositionEncoding position_encoding = PositionEncoding::SNORM16);
+
+        // Same math as the vsMainCompact decode
+        std::vector<SimpleVertex> decodeVertices(const CompactMesh& mesh);
+        std::vector<unsigned> decodeIndices(const CompactMesh& mesh);
+
+        EncodingReport measureEncoding(const SimpleVertex* vertices, size_t vertex_count, size_t index_count, const CompactMesh& mesh);
+        EncodingReport measureEncoding(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, const CompactMesh& mesh);
+    }
+}
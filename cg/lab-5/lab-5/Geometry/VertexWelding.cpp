@@ -0,0 +1,198 @@
+#include "VertexWelding.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace geometry {
+        namespace {
+            const unsigned NO_POSITION = ~0u;
+            const size_t POSITION_BLOCK_SIZE = 4096;
+
+            int64_t cellOf(float coordinate, float inv_cell) {
+                return (int64_t)floorf(coordinate * inv_cell);
+            }
+
+            size_t hashCell(int64_t x, int64_t y, int64_t z) {
+                uint64_t hash = (uint64_t)x * 0x9e3779b97f4a7c15ull ^ (uint64_t)y * 0xc2b2ae3d27d4eb4full ^ (uint64_t)z * 0x165667b19e3779f9ull;
+                return (size_t)(hash ^ (hash >> 32));
+            }
+
+            // Buckets are chained through next, a hash collision only costs a distance test
+            std::vector<unsigned> weldPositions(const std::vector<SimpleVertex>& vertices, float epsilon, std::vector<XMFLOAT3>& positions) {
+                std::vector<unsigned> position_of(vertices.size());
+                size_t table_size = 16;
+                while (table_size < 2 * vertices.size()) {
+                    table_size *= 2;
+                }
+                std::vector<unsigned> heads(table_size, NO_POSITION);
+                std::vector<unsigned> next;
+                const float inv_cell = 1.0f / epsilon;
+                const float epsilon_sq = epsilon * epsilon;
+
+                for (size_t i = 0; i < vertices.size(); ++i) {
+                    const XMFLOAT3& pos = vertices[i]._pos;
+                    int64_t x = cellOf(pos.x, inv_cell);
+                    int64_t y = cellOf(pos.y, inv_cell);
+                    int64_t z = cellOf(pos.z, inv_cell);
+
+                    unsigned found = NO_POSITION;
+                    for (int64_t dz = -1; dz <= 1 && found == NO_POSITION; ++dz) {
+                        for (int64_t dy = -1; dy <= 1 && found == NO_POSITION; ++dy) {
+                            for (int64_t dx = -1; dx <= 1 && found == NO_POSITION; ++dx) {
+                                for (unsigned p = heads[hashCell(x + dx, y + dy, z + dz) & (table_size - 1)]; p != NO_POSITION; p = next[p]) {
+                                    float ex = positions[p].x - pos.x;
+                                    float ey = positions[p].y - pos.y;
+                                    float ez = positions[p].z - pos.z;
+                                    if (ex * ex + ey * ey + ez * ez <= epsilon_sq) {
+                                        found = p;
+                                        break;
+                                    }
+                                }
+                            }
+                        }
+                    }
+
+                    if (found == NO_POSITION) {
+                        found = (unsigned)positions.size();
+                        positions.push_back(pos);
+                        size_t bucket = hashCell(x, y, z) & (table_size - 1);
+                        next.push_back(heads[bucket]);
+                        heads[bucket] = found;
+                    }
+                    position_of[i] = found;
+                }
+                return position_of;
+            }
+
+            float cornerAngle(FXMVECTOR corner, FXMVECTOR a, FXMVECTOR b) {
+                XMVECTOR u = a - corner;
+                XMVECTOR v = b - corner;
+                return atan2f(XMVectorGetX(XMVector3Length(XMVector3Cross(u, v))), XMVectorGetX(XMVector3Dot(u, v)));
+            }
+        }
+
+        WeldReport weldVertices(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const WeldOptions& options) {
+            assert(options._epsilon > 0.0f);
+            WeldReport report;
+            report._vertices_before = vertices.size();
+
+            std::vector<XMFLOAT3> positions;
+            std::vector<unsigned> position_of = weldPositions(vertices, options._epsilon, positions);
+            report._positions = positions.size();
+
+            // Corners keep the vertex they came from, so the original normals are still there to merge
+            std::vector<unsigned> corners;
+            corners.reserve(indices.size());
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                unsigned a = position_of[indices[t]];
+                unsigned b = position_of[indices[t + 1]];
+                unsigned c = position_of[indices[t + 2]];
+                if (a == b || b == c || c == a) {
+                    ++report._degenerate_triangles;
+                    continue;
+                }
+                corners.insert(corners.end(), &indices[t], &indices[t] + 3);
+            }
+            const size_t triangle_count = corners.size() / 3;
+
+            // What a corner is grouped by and what it adds to its group: the unit face normal and the weighted
+            // face normal, or the original normal for both
+            std::vector<XMFLOAT3> corner_keys(corners.size());
+            std::vector<XMFLOAT3> corner_weights(corners.size());
+            software::parallelFor((triangle_count + POSITION_BLOCK_SIZE - 1) / POSITION_BLOCK_SIZE, [&](size_t block) {
+                for (size_t t = block * POSITION_BLOCK_SIZE; t < std::min(triangle_count, (block + 1) * POSITION_BLOCK_SIZE); ++t) {
+                    if (!options._recompute_normals) {
+                        for (size_t k = 0; k < 3; ++k) {
+                            XMStoreFloat3(&corner_keys[3 * t + k], XMVector3Normalize(XMLoadFloat3(&vertices[corners[3 * t + k]]._nor)));
+                            corner_weights[3 * t + k] = corner_keys[3 * t + k];
+                        }
+                        continue;
+                    }
+                    XMVECTOR p[3];
+                    for (size_t k = 0; k < 3; ++k) {
+                        p[k] = XMLoadFloat3(&positions[position_of[corners[3 * t + k]]]);
+                    }
+                    // Twice the area long
+                    XMVECTOR normal = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+                    XMVECTOR unit = XMVector3Normalize(normal);
+                    for (size_t k = 0; k < 3; ++k) {
+                        XMStoreFloat3(&corner_keys[3 * t + k], unit);
+                        XMStoreFloat3(&corner_weights[3 * t + k], normal * cornerAngle(p[k], p[(k + 1) % 3], p[(k + 2) % 3]));
+                    }
+                }
+            });
+
+            std::vector<unsigned> offsets(positions.size() + 1, 0);
+            for (unsigned v : corners) {
+                ++offsets[position_of[v] + 1];
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            std::vector<unsigned> position_corners(corners.size());
+            {
+                std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < corners.size(); ++i) {
+                    position_corners[fill[position_of[corners[i]]]++] = (unsigned)i;
+                }
+            }
+
+            // Every corner joins the first group around its position whose seed normal is within the crease angle.
+            // Groups are counted first, so the second pass can write the vertices of every position in parallel
+            const float min_cos = cosf(XMConvertToRadians(options._crease_angle));
+            const size_t block_count = (positions.size() + POSITION_BLOCK_SIZE - 1) / POSITION_BLOCK_SIZE;
+            std::vector<unsigned> corner_group(corners.size());
+            std::vector<unsigned> vertex_offsets(positions.size() + 1, 0);
+            software::parallelFor(block_count, [&](size_t block) {
+                std::vector<unsigned> seeds;
+                for (size_t p = block * POSITION_BLOCK_SIZE; p < std::min(positions.size(), (block + 1) * POSITION_BLOCK_SIZE); ++p) {
+                    seeds.clear();
+                    for (unsigned i = offsets[p]; i < offsets[p + 1]; ++i) {
+                        unsigned c = position_corners[i];
+                        XMVECTOR key = XMLoadFloat3(&corner_keys[c]);
+                        unsigned group = 0;
+                        while (group < seeds.size() && XMVectorGetX(XMVector3Dot(key, XMLoadFloat3(&corner_keys[seeds[group]]))) < min_cos) {
+                            ++group;
+                        }
+                        if (group == seeds.size()) {
+                            seeds.push_back(c);
+                        }
+                        corner_group[c] = group;
+                    }
+                    vertex_offsets[p + 1] = (unsigned)seeds.size();
+                }
+            });
+            std::partial_sum(vertex_offsets.begin(), vertex_offsets.end(), vertex_offsets.begin());
+
+            std::vector<SimpleVertex> welded(vertex_offsets.back());
+            indices.resize(corners.size());
+            software::parallelFor(block_count, [&](size_t block) {
+                for (size_t p = block * POSITION_BLOCK_SIZE; p < std::min(positions.size(), (block + 1) * POSITION_BLOCK_SIZE); ++p) {
+                    for (unsigned v = vertex_offsets[p]; v < vertex_offsets[p + 1]; ++v) {
+                        welded[v]._pos = positions[p];
+                        welded[v]._nor = XMFLOAT3(0.0f, 0.0f, 0.0f);
+                    }
+                    for (unsigned i = offsets[p]; i < offsets[p + 1]; ++i) {
+                        unsigned c = position_corners[i];
+                        unsigned v = vertex_offsets[p] + corner_group[c];
+                        XMStoreFloat3(&welded[v]._nor, XMLoadFloat3(&welded[v]._nor) + XMLoadFloat3(&corner_weights[c]));
+                        indices[c] = v;
+                    }
+                    for (unsigned v = vertex_offsets[p]; v < vertex_offsets[p + 1]; ++v) {
+                        XMStoreFloat3(&welded[v]._nor, XMVector3Normalize(XMLoadFloat3(&welded[v]._nor)));
+                    }
+                }
+            });
+
+            vertices.swap(welded);
+            report._vertices_after = vertices.size();
+            return report;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace geometry {
+        struct WeldOptions {
+            // Object space distance below which two positions are the same one
+            float _epsilon = 1e-5f;
+            // Corners whose normals differ by more than this, in degrees, keep separate vertices
+            float _crease_angle = 60.0f;
+            // Rebuilds normals from the faces instead of merging the ones the mesh came with
+            bool _recompute_normals = true;
+        };
+
+        struct WeldReport {
+            size_t _vertices_before = 0;
+            size_t _vertices_after = 0;
+            size_t _positions = 0;
+            // Triangles that lost an edge to the weld and were dropped
+            size_t _degenerate_triangles = 0;
+        };
+
+        // Merges positions through a spatial hash with cells of epsilon, so a lookup only needs the 27 cells
+        // around a position. Every welded position then gets one vertex per group of corners whose normals are
+        // within the crease angle of each other. Recomputed normals weigh every face by its area and by the angle
+        // of its corner, so neither long thin triangles nor fans of small ones tilt the result.
+        // The first occurrence of a position wins, the result does not depend on the thread count
+        WeldReport weldVertices(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, const WeldOptions& options = WeldOptions());
+    }
+}
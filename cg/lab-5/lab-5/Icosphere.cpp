@@ -0,0 +1,98 @@
+#include "Icosphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "SphereTessellation.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace {
+        unsigned addVertex(std::vector<SimpleVertex>& vertices, FXMVECTOR dir, float radius) {
+            XMVECTOR normal = XMVector3Normalize(dir);
+            SimpleVertex vertex;
+            XMStoreFloat3(&vertex._pos, normal * radius);
+            XMStoreFloat3(&vertex._nor, normal);
+            vertices.push_back(vertex);
+            return (unsigned)vertices.size() - 1;
+        }
+
+        void subdivide(std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, float radius) {
+            // Neighbouring triangles share edge midpoints, so the mesh stays watertight
+            std::unordered_map<uint64_t, unsigned> midpoints;
+            auto midpoint = [&](unsigned a, unsigned b) {
+                uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+                auto it = midpoints.find(key);
+                if (it != midpoints.end()) {
+                    return it->second;
+                }
+                XMVECTOR dir = XMLoadFloat3(&vertices[a]._nor) + XMLoadFloat3(&vertices[b]._nor);
+                unsigned index = addVertex(vertices, dir, radius);
+                midpoints.emplace(key, index);
+                return index;
+            };
+
+            std::vector<unsigned> result;
+            result.reserve(indices.size() * 4);
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                unsigned a = indices[i];
+                unsigned b = indices[i + 1];
+                unsigned c = indices[i + 2];
+                unsigned ab = midpoint(a, b);
+                unsigned bc = midpoint(b, c);
+                unsigned ca = midpoint(c, a);
+                const unsigned triangles[] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+                result.insert(result.end(), std::begin(triangles), std::end(triangles));
+            }
+            indices.swap(result);
+        }
+    }
+
+    Icosphere::Icosphere(float radius, size_t subdivisions, bool outer_normals)
+        : _subdivisions(subdivisions) {
+        const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+        const float corners[12][3] = {
+            { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+            { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+            { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+        };
+        for (const auto& corner : corners) {
+            addVertex(_vertices, XMVectorSet(corner[0], corner[1], corner[2], 0.0f), radius);
+        }
+        _indices = {
+            0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+            1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+            3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+            4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+        };
+
+        for (size_t i = 0; i < subdivisions; ++i) {
+            subdivide(_vertices, _indices, radius);
+        }
+        orientSphereTriangles(_vertices, _indices, outer_normals);
+    }
+
+    Icosphere Icosphere::fromMaxError(float radius, float max_error, bool outer_normals) {
+        // Each level quarters the error, so stepping one level at a time is cheap
+        Icosphere sphere(radius, 0, outer_normals);
+        while (sphere._subdivisions < MAX_SUBDIVISIONS && sphereChordError(sphere._vertices, sphere._indices, radius) > max_error) {
+            subdivide(sphere._vertices, sphere._indices, radius);
+            ++sphere._subdivisions;
+        }
+        return sphere;
+    }
+
+    const std::vector<SimpleVertex>& Icosphere::getVertices() const {
+        return _vertices;
+    }
+
+    const std::vector<unsigned>& Icosphere::getIndices() const {
+        return _indices;
+    }
+
+    size_t Icosphere::getSubdivisions() const {
+        return _subdivisions;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "SimpleVertex.h"
+
+namespace rendering {
+    // Subdivided icosahedron: every level splits each triangle into four and pushes the new vertices
+    // onto the sphere, so triangles stay close to equilateral everywhere and there are no poles
+    class Icosphere {
+    public:
+        static const size_t MAX_SUBDIVISIONS = 10;
+
+        Icosphere(float radius, size_t subdivisions, bool outer_normals);
+
+        // Fewest subdivisions with sphereChordError <= max_error
+        static Icosphere fromMaxError(float radius, float max_error, bool outer_normals);
+
+        const std::vector<SimpleVertex>& getVertices() const;
+        const std::vector<unsigned>& getIndices() const;
+        size_t getSubdivisions() const;
+
+    private:
+        std::vector<SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+        size_t _subdivisions;
+    };
+}
@@ -0,0 +1,330 @@
+#include "InputJournal.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Keys.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace {
+        const float CAMERA_STEP = 0.1f;
+        const float MOUSE_SENSE = 5e-3f;
+        // Type, frame delta and two one byte mouse deltas or a key code and repeat flag
+        const size_t MIN_EVENT_BYTES = 4;
+
+        void writeVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+            while (value >= 0x80) {
+                bytes.push_back((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            bytes.push_back((uint8_t)value);
+        }
+
+        // Zigzag keeps small negative mouse deltas in one byte
+        void writeSigned(std::vector<uint8_t>& bytes, int32_t value) {
+            writeVarint(bytes, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+        }
+
+        void writeU32(std::vector<uint8_t>& bytes, uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                bytes.push_back((uint8_t)(value >> (8 * i)));
+            }
+        }
+
+        void writeFloat(std::vector<uint8_t>& bytes, float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            writeU32(bytes, bits);
+        }
+
+        class Reader {
+        public:
+            Reader(const std::vector<uint8_t>& bytes) : _bytes(bytes) {}
+
+            bool readByte(uint8_t& value) {
+                if (_pos >= _bytes.size()) {
+                    return false;
+                }
+                value = _bytes[_pos++];
+                return true;
+            }
+
+            bool readVarint(uint32_t& value) {
+                value = 0;
+                for (int shift = 0; shift < 35; shift += 7) {
+                    uint8_t byte;
+                    if (!readByte(byte)) {
+                        return false;
+                    }
+                    value |= (uint32_t)(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool readSigned(int32_t& value) {
+                uint32_t zigzag;
+                if (!readVarint(zigzag)) {
+                    return false;
+                }
+                value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+                return true;
+            }
+
+            bool readU32(uint32_t& value) {
+                value = 0;
+                for (int i = 0; i < 4; ++i) {
+                    uint8_t byte;
+                    if (!readByte(byte)) {
+                        return false;
+                    }
+                    value |= (uint32_t)byte << (8 * i);
+                }
+                return true;
+            }
+
+            bool readFloat(float& value) {
+                uint32_t bits;
+                if (!readU32(bits)) {
+                    return false;
+                }
+                memcpy(&value, &bits, sizeof(value));
+                return true;
+            }
+
+            bool isEnd() const {
+                return _pos == _bytes.size();
+            }
+
+            size_t getRemaining() const {
+                return _bytes.size() - _pos;
+            }
+
+        private:
+            const std::vector<uint8_t>& _bytes;
+            size_t _pos = 0;
+        };
+    }
+
+    InputEvent keyEvent(uint32_t key, bool repeated) {
+        InputEvent event;
+        event._type = InputEventType::KEY;
+        event._code = key;
+        event._x = repeated;
+        return event;
+    }
+
+    InputEvent mouseEvent(int32_t dx, int32_t dy) {
+        InputEvent event;
+        event._type = InputEventType::MOUSE;
+        event._x = dx;
+        event._y = dy;
+        return event;
+    }
+
+    InputEvent resizeEvent(uint32_t width, uint32_t height) {
+        InputEvent event;
+        event._type = InputEventType::RESIZE;
+        event._x = (int32_t)width;
+        event._y = (int32_t)height;
+        return event;
+    }
+
+    InputEvent parameterEvent(InputParameter parameter, float value) {
+        InputEvent event;
+        event._type = InputEventType::PARAMETER;
+        event._code = (uint32_t)parameter;
+        event._value = value;
+        return event;
+    }
+
+    bool applyCameraInput(const InputEvent& event, Camera& camera, const WorldBorders& borders) {
+        if (event._type == InputEventType::MOUSE) {
+            camera.rotateHorisontal(event._x * MOUSE_SENSE);
+            camera.rotateVertical(event._y * MOUSE_SENSE);
+            return true;
+        }
+        if (event._type != InputEventType::KEY) {
+            return false;
+        }
+
+        switch ((Keys)event._code) {
+        case Keys::W_KEY:
+            camera.moveNormal(CAMERA_STEP);
+            break;
+        case Keys::S_KEY:
+            camera.moveNormal(-CAMERA_STEP);
+            break;
+        case Keys::A_KEY:
+            camera.moveTangent(CAMERA_STEP);
+            break;
+        case Keys::D_KEY:
+            camera.moveTangent(-CAMERA_STEP);
+            break;
+        default:
+            return false;
+        }
+        camera.positionClip(borders);
+        return true;
+    }
+
+    InputJournal::InputJournal(float timestep)
+        : _timestep(timestep) {}
+
+    void InputJournal::record(InputEvent event) {
+        event._frame = _frame;
+        _events.push_back(event);
+    }
+
+    void InputJournal::nextFrame() {
+        ++_frame;
+    }
+
+    bool InputJournal::save(const std::filesystem::path& path) const {
+        std::vector<uint8_t> bytes;
+        encode(bytes);
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)bytes.data(), bytes.size());
+        return file.good();
+    }
+
+    bool InputJournal::load(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return decode(bytes);
+    }
+
+    void InputJournal::encode(std::vector<uint8_t>& bytes) const {
+        bytes.clear();
+        writeU32(bytes, _s_MAGIC);
+        writeU32(bytes, _s_VERSION);
+        writeFloat(bytes, _timestep);
+        writeU32(bytes, _frame);
+        writeU32(bytes, (uint32_t)_events.size());
+
+        uint32_t frame = 0;
+        for (const InputEvent& event : _events) {
+            bytes.push_back((uint8_t)event._type);
+            writeVarint(bytes, event._frame - frame);
+            frame = event._frame;
+
+            switch (event._type) {
+            case InputEventType::KEY:
+                writeVarint(bytes, event._code);
+                bytes.push_back((uint8_t)event._x);
+                break;
+            case InputEventType::MOUSE:
+                writeSigned(bytes, event._x);
+                writeSigned(bytes, event._y);
+                break;
+            case InputEventType::RESIZE:
+                writeVarint(bytes, (uint32_t)event._x);
+                writeVarint(bytes, (uint32_t)event._y);
+                break;
+            case InputEventType::PARAMETER:
+                bytes.push_back((uint8_t)event._code);
+                writeFloat(bytes, event._value);
+                break;
+            }
+        }
+    }
+
+    bool InputJournal::decode(const std::vector<uint8_t>& bytes) {
+        Reader reader(bytes);
+        uint32_t magic, version, frame_count, event_count;
+        float timestep;
+        if (!reader.readU32(magic) || magic != _s_MAGIC || !reader.readU32(version) || version != _s_VERSION) {
+            return false;
+        }
+        if (!reader.readFloat(timestep) || !reader.readU32(frame_count) || !reader.readU32(event_count)) {
+            return false;
+        }
+        // The count comes from the file, it must not reserve more events than the bytes left can hold
+        if (event_count > reader.getRemaining() / MIN_EVENT_BYTES) {
+            return false;
+        }
+
+        std::vector<InputEvent> events;
+        events.reserve(event_count);
+        uint32_t frame = 0;
+        for (uint32_t i = 0; i < event_count; ++i) {
+            InputEvent event;
+            uint8_t type, byte = 0;
+            uint32_t frame_delta, value = 0;
+            if (!reader.readByte(type) || !reader.readVarint(frame_delta)) {
+                return false;
+            }
+            frame += frame_delta;
+            event._frame = frame;
+            event._type = (InputEventType)type;
+
+            bool ok = false;
+            switch (event._type) {
+            case InputEventType::KEY:
+                ok = reader.readVarint(event._code) && reader.readByte(byte);
+                event._x = byte;
+                break;
+            case InputEventType::MOUSE:
+                ok = reader.readSigned(event._x) && reader.readSigned(event._y);
+                break;
+            case InputEventType::RESIZE:
+                ok = reader.readVarint(value);
+                event._x = (int32_t)value;
+                ok = ok && reader.readVarint(value);
+                event._y = (int32_t)value;
+                break;
+            case InputEventType::PARAMETER:
+                ok = reader.readByte(byte) && byte < INPUT_PARAMETER_COUNT && reader.readFloat(event._value);
+                event._code = byte;
+                break;
+            }
+            if (!ok) {
+                return false;
+            }
+            events.push_back(event);
+        }
+        if (!reader.isEnd()) {
+            return false;
+        }
+
+        _timestep = timestep;
+        _frame = frame_count;
+        _events = std::move(events);
+        return true;
+    }
+
+    const std::vector<InputEvent>& InputJournal::getEvents() const {
+        return _events;
+    }
+
+    uint32_t InputJournal::getFrameCount() const {
+        return _frame;
+    }
+
+    float InputJournal::getTimestep() const {
+        return _timestep;
+    }
+
+    InputReplay::InputReplay(InputJournal journal)
+        : _journal(std::move(journal)) {}
+
+    bool InputReplay::isFinished() const {
+        return _frame >= _journal.getFrameCount();
+    }
+
+    uint32_t InputReplay::getFrame() const {
+        return _frame;
+    }
+
+    float InputReplay::getTimestep() const {
+        return _journal.getTimestep();
+    }
+}
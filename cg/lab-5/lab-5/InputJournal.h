@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "Camera.h"
+#include "WorldBorders.h"
+
+namespace rendering {
+    enum class InputEventType : uint8_t {
+        KEY,
+        MOUSE,
+        RESIZE,
+        PARAMETER,
+    };
+
+    // UI state that changes what a frame costs. The values are stored in journals, so new ones go last
+    enum class InputParameter : uint8_t {
+        EXPOSURE_SCALE,
+        RENDER_MODE,
+        DYNAMIC_RESOLUTION,
+        FRAME_BUDGET,
+        RENDER_SCALE,
+        TEMPORAL_UPSAMPLING,
+        ROUGHNESS,
+        METALNESS,
+        COLOR_R,
+        COLOR_G,
+        COLOR_B,
+        COMPACT_VERTICES,
+        LOD_THRESHOLD,
+        MESHLET_CULLING,
+        MATERIAL_GRID,
+        MATERIAL_GRID_SIZE,
+        FRUSTUM_CULLING,
+        OCCLUSION_CULLING,
+        FILL_LIGHTS,
+        SHAPES,
+    };
+
+    // One past the last parameter, a larger code comes from a newer build or a corrupt journal
+    const uint32_t INPUT_PARAMETER_COUNT = (uint32_t)InputParameter::SHAPES + 1;
+
+    struct InputEvent {
+        uint32_t _frame = 0;
+        InputEventType _type = InputEventType::KEY;
+        // Key code or InputParameter
+        uint32_t _code = 0;
+        // Mouse delta, new size or key repeat flag in _x
+        int32_t _x = 0;
+        int32_t _y = 0;
+        float _value = 0.0f;
+    };
+
+    InputEvent keyEvent(uint32_t key, bool repeated);
+    InputEvent mouseEvent(int32_t dx, int32_t dy);
+    InputEvent resizeEvent(uint32_t width, uint32_t height);
+    InputEvent parameterEvent(InputParameter parameter, float value);
+
+    // WASD movement and mouse look, as Renderer::handleKey and handleMouse did.
+    // Returns false for events that do not move the camera
+    bool applyCameraInput(const InputEvent& event, Camera& camera, const WorldBorders& borders);
+
+    // Events stamped with the index of the frame they take effect in. The file is a small
+    // header followed by varint-packed events, so an hour of input stays a few hundred KB
+    class InputJournal {
+    public:
+        InputJournal(float timestep = 1.0f / 60.0f);
+
+        void record(InputEvent event);
+        void nextFrame();
+
+        bool save(const std::filesystem::path& path) const;
+        bool load(const std::filesystem::path& path);
+
+        void encode(std::vector<uint8_t>& bytes) const;
+        bool decode(const std::vector<uint8_t>& bytes);
+
+        const std::vector<InputEvent>& getEvents() const;
+        uint32_t getFrameCount() const;
+        float getTimestep() const;
+
+    private:
+        static const uint32_t _s_MAGIC = 0x4c4e4a49; // "IJNL"
+        static const uint32_t _s_VERSION = 1;
+
+        float _timestep;
+        uint32_t _frame = 0;
+        std::vector<InputEvent> _events;
+    };
+
+    // Feeds a journal back one frame at a time. Time advances by the journal timestep,
+    // not by the wall clock, so the same journal always reproduces the same frames
+    class InputReplay {
+    public:
+        InputReplay(InputJournal journal = InputJournal());
+
+        template <typename F>
+        void advance(const F& f) {
+            const std::vector<InputEvent>& events = _journal.getEvents();
+            while (_next_event < events.size() && events[_next_event]._frame <= _frame) {
+                f(events[_next_event++]);
+            }
+            ++_frame;
+        }
+
+        bool isFinished() const;
+        uint32_t getFrame() const;
+        float getTimestep() const;
+
+    private:
+        InputJournal _journal;
+        size_t _next_event = 0;
+        uint32_t _frame = 0;
+    };
+}
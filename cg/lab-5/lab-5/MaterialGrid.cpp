@@ -0,0 +1,146 @@
+#include "MaterialGrid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "SoftwareRenderer/ParallelFor.h"
+
+namespace rendering {
+    namespace {
+        const size_t LOD_BLOCK_SIZE = 16384;
+    }
+
+    bool MaterialGridSettings::operator==(const MaterialGridSettings& other) const {
+        return _columns == other._columns && _rows == other._rows && _spacing == other._spacing && _radius == other._radius
+            && _base_color.x == other._base_color.x && _base_color.y == other._base_color.y
+            && _base_color.z == other._base_color.z && _base_color.w == other._base_color.w;
+    }
+
+    bool MaterialGridSettings::operator!=(const MaterialGridSettings& other) const {
+        return !(*this == other);
+    }
+
+    bool MaterialGrid::update(const MaterialGridSettings& settings) {
+        if (_built && settings == _settings) {
+            return false;
+        }
+        const bool layout_changed = !_built || settings._columns != _settings._columns || settings._rows != _settings._rows
+            || settings._spacing != _settings._spacing;
+        _settings = settings;
+        _built = true;
+        const size_t count = (size_t)_settings._columns * _settings._rows;
+        std::fill_n(_bounds._radius.begin(), std::min(count, _bounds.size()), _settings._radius);
+        if (!layout_changed) {
+            return true;
+        }
+
+        const size_t columns = _settings._columns;
+        const size_t rows = _settings._rows;
+        _bounds.resize(count);
+        _roughness.resize(count);
+        _metalness.resize(count);
+
+        const float x0 = -0.5f * (columns - 1) * _settings._spacing;
+        const float y0 = -0.5f * (rows - 1) * _settings._spacing;
+        const float roughness_step = columns > 1 ? 1.0f / (columns - 1) : 0.0f;
+        const float metalness_step = rows > 1 ? 1.0f / (rows - 1) : 0.0f;
+        for (size_t row = 0; row < rows; ++row) {
+            float y = y0 + row * _settings._spacing;
+            float metalness = row * metalness_step;
+            for (size_t column = 0; column < columns; ++column) {
+                size_t i = row * columns + column;
+                _bounds.set(i, DirectX::XMFLOAT3(x0 + column * _settings._spacing, y, 0.0f), _settings._radius);
+                _roughness[i] = column * roughness_step;
+                _metalness[i] = metalness;
+            }
+        }
+        return true;
+    }
+
+    void MaterialGrid::pack(MaterialInstance* out) const {
+        const size_t count = getInstanceCount();
+        const float scale = _settings._radius;
+        const DirectX::XMFLOAT4 base_color = _settings._base_color;
+        software::parallelFor((count + _s_PACK_BLOCK_SIZE - 1) / _s_PACK_BLOCK_SIZE, [&](size_t block) {
+            const size_t end = std::min(count, (block + 1) * _s_PACK_BLOCK_SIZE);
+            for (size_t i = block * _s_PACK_BLOCK_SIZE; i < end; ++i) {
+                MaterialInstance& instance = out[i];
+                instance._world[0] = DirectX::XMFLOAT4(scale, 0.0f, 0.0f, _bounds._x[i]);
+                instance._world[1] = DirectX::XMFLOAT4(0.0f, scale, 0.0f, _bounds._y[i]);
+                instance._world[2] = DirectX::XMFLOAT4(0.0f, 0.0f, scale, _bounds._z[i]);
+                instance._base_color = base_color;
+                instance._roughness = _roughness[i];
+                instance._metalness = _metalness[i];
+                instance._padding[0] = 0.0f;
+                instance._padding[1] = 0.0f;
+            }
+        });
+    }
+
+    size_t MaterialGrid::getInstanceCount() const {
+        return _built ? (size_t)_settings._columns * _settings._rows : 0;
+    }
+
+    const MaterialGridSettings& MaterialGrid::getSettings() const {
+        return _settings;
+    }
+
+    const scene::BoundingSpheres& MaterialGrid::getBounds() const {
+        return _bounds;
+    }
+
+    float MaterialGrid::getRoughness(size_t instance) const {
+        return _roughness[instance];
+    }
+
+    float MaterialGrid::getMetalness(size_t instance) const {
+        return _metalness[instance];
+    }
+
+    void groupInstancesByLod(const scene::BoundingSpheres& bounds, const std::vector<uint32_t>& instances, const geometry::LodChainView& chain,
+        DirectX::FXMVECTOR camera_pos, const DirectX::XMMATRIX& projection, float near_z, float viewport_height, float threshold, LodInstanceGroups& groups) {
+        assert(chain._level_count > 0 && chain._level_count <= 256);
+        const size_t level_count = chain._level_count;
+        // Level l is good enough from this distance over the sphere radius on, see projectedError
+        std::vector<float> band(level_count, 0.0f);
+        for (size_t level = 1; level < level_count; ++level) {
+            band[level] = geometry::projectedError(chain._levels[level]._error, 1.0f, projection, viewport_height) / threshold;
+        }
+
+        DirectX::XMFLOAT3 camera;
+        DirectX::XMStoreFloat3(&camera, camera_pos);
+        const size_t count = instances.size();
+        groups._levels.resize(count);
+        software::parallelFor((count + LOD_BLOCK_SIZE - 1) / LOD_BLOCK_SIZE, [&](size_t block) {
+            const size_t end = std::min(count, (block + 1) * LOD_BLOCK_SIZE);
+            for (size_t i = block * LOD_BLOCK_SIZE; i < end; ++i) {
+                const uint32_t instance = instances[i];
+                const float dx = bounds._x[instance] - camera.x;
+                const float dy = bounds._y[instance] - camera.y;
+                const float dz = bounds._z[instance] - camera.z;
+                const float radius = bounds._radius[instance];
+                const float distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - radius * chain._bounding_radius, near_z);
+                size_t level = level_count - 1;
+                while (level > 0 && distance < band[level] * radius) {
+                    --level;
+                }
+                groups._levels[i] = (uint8_t)level;
+            }
+        });
+
+        // Counting sort, stable within a level
+        groups._offsets.assign(level_count + 1, 0);
+        for (uint8_t level : groups._levels) {
+            ++groups._offsets[level + 1];
+        }
+        for (size_t level = 0; level < level_count; ++level) {
+            groups._offsets[level + 1] += groups._offsets[level];
+        }
+        groups._instances.resize(count);
+        std::vector<uint32_t> next(groups._offsets.begin(), groups._offsets.end() - 1);
+        for (size_t i = 0; i < count; ++i) {
+            groups._instances[next[groups._levels[i]]++] = instances[i];
+        }
+    }
+}
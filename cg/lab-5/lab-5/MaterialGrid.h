@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "Geometry/LodChain.h"
+#include "Scene/FrustumCulling.h"
+
+namespace rendering {
+    // One sphere as vsMainInstanced reads it from the instance structured buffer, see MaterialInstance in shaders.hlsl
+    struct MaterialInstance {
+        // World x, y and z are the dot products of these with (pos, 1), an affine transform needs no fourth row
+        DirectX::XMFLOAT4 _world[3];
+        DirectX::XMFLOAT4 _base_color;
+        float _roughness;
+        float _metalness;
+        float _padding[2];
+    };
+
+    struct MaterialGridSettings {
+        uint32_t _columns = 10;
+        uint32_t _rows = 10;
+        float _spacing = 2.5f;
+        float _radius = 1.0f;
+        // Linear, shared by all spheres
+        DirectX::XMFLOAT4 _base_color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+
+        bool operator==(const MaterialGridSettings& other) const;
+        bool operator!=(const MaterialGridSettings& other) const;
+    };
+
+    // Roughness goes from 0 to 1 along the columns and metalness along the rows of a grid centered on the
+    // origin in the xy plane. What differs between spheres is kept as structure of arrays and only rebuilt
+    // when the settings change
+    class MaterialGrid {
+    public:
+        // Returns true if the instances changed and have to be packed again
+        bool update(const MaterialGridSettings& settings);
+
+        // Writes getInstanceCount() instances, e.g. into a mapped instance buffer
+        void pack(MaterialInstance* out) const;
+
+        size_t getInstanceCount() const;
+        const MaterialGridSettings& getSettings() const;
+        // Centers and radii of the spheres, in instance order
+        const scene::BoundingSpheres& getBounds() const;
+        float getRoughness(size_t instance) const;
+        float getMetalness(size_t instance) const;
+
+    private:
+        static const size_t _s_PACK_BLOCK_SIZE = 16384;
+
+        MaterialGridSettings _settings;
+        bool _built = false;
+
+        scene::BoundingSpheres _bounds;
+        std::vector<float> _roughness;
+        std::vector<float> _metalness;
+    };
+
+    // Instances grouped by the LOD level each one needs, finest first. Level l draws _instances[_offsets[l]] up to
+    // _instances[_offsets[l + 1]], in the order they were given
+    struct LodInstanceGroups {
+        std::vector<uint32_t> _instances;
+        std::vector<uint32_t> _offsets;
+        // Level of every input instance, kept to save the allocation
+        std::vector<uint8_t> _levels;
+    };
+
+    // Picks the level of every sphere like selectLodLevel with its own distance, the radius of a sphere scales the chain.
+    // The projected error of a level falls with the distance, so each level is a distance band measured once per call
+    void groupInstancesByLod(const scene::BoundingSpheres& bounds, const std::vector<uint32_t>& instances, const geometry::LodChainView& chain,
+        DirectX::FXMVECTOR camera_pos, const DirectX::XMMATRIX& projection, float near_z, float viewport_height, float threshold, LodInstanceGroups& groups);
+}
@@ -0,0 +1,174 @@
+#include "ParametricSurface.h"
+
+#include <xmmintrin.h>
+
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace {
+        void writeVertex(SimpleVertex& vertex, float s, float c, float rho, float neg_rho, float y, float n_rho, float neg_n_rho, float n_y) {
+            vertex._pos = XMFLOAT3(rho * s, y, neg_rho * c);
+            vertex._nor = XMFLOAT3(n_rho * s, n_y, neg_n_rho * c);
+        }
+
+        // Top pole, ring_count rings of n_phi vertices, bottom pole
+        void writePolarIndices(size_t ring_count, size_t n_phi, unsigned* out) {
+            const unsigned top = 0;
+            const unsigned bottom = (unsigned)(1 + ring_count * n_phi);
+            const unsigned last_ring = (unsigned)(1 + (ring_count - 1) * n_phi);
+            for (unsigned j = 0; j < n_phi; ++j) {
+                unsigned next = (unsigned)((j + 1) % n_phi);
+                *out++ = top;
+                *out++ = 1 + next;
+                *out++ = 1 + j;
+            }
+            for (unsigned i = 0; i + 1 < ring_count; ++i) {
+                unsigned ring = (unsigned)(1 + i * n_phi);
+                for (unsigned j = 0; j < n_phi; ++j) {
+                    unsigned next = (unsigned)((j + 1) % n_phi);
+                    *out++ = ring + j;
+                    *out++ = ring + next;
+                    *out++ = ring + (unsigned)n_phi + j;
+                    *out++ = ring + (unsigned)n_phi + j;
+                    *out++ = ring + next;
+                    *out++ = ring + (unsigned)n_phi + next;
+                }
+            }
+            for (unsigned j = 0; j < n_phi; ++j) {
+                unsigned next = (unsigned)((j + 1) % n_phi);
+                *out++ = bottom;
+                *out++ = last_ring + j;
+                *out++ = last_ring + next;
+            }
+        }
+    }
+
+    TrigTable makeTrigTable(size_t count, float step, float first) {
+        TrigTable table;
+        table._sin.resize(count);
+        table._cos.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            float angle = first + (float)i * step;
+            table._sin[i] = sinf(angle);
+            table._cos[i] = cosf(angle);
+        }
+        return table;
+    }
+
+    void writeRevolutionRing(const TrigTable& phi, float rho, float y, float n_rho, float n_y, SimpleVertex* out) {
+        static_assert(sizeof(SimpleVertex) == 6 * sizeof(float), "vertices are written as six floats");
+        const size_t count = phi._sin.size();
+        const float* sin_phi = phi._sin.data();
+        const float* cos_phi = phi._cos.data();
+
+        const __m128 rho4 = _mm_set1_ps(rho);
+        const __m128 neg_rho4 = _mm_set1_ps(-rho);
+        const __m128 n_rho4 = _mm_set1_ps(n_rho);
+        const __m128 neg_n_rho4 = _mm_set1_ps(-n_rho);
+        const __m128 y4 = _mm_set1_ps(y);
+        const __m128 n_y4 = _mm_set1_ps(n_y);
+
+        float* dst = (float*)out;
+        size_t j = 0;
+        for (; j + 4 <= count; j += 4, dst += 24) {
+            __m128 s = _mm_loadu_ps(sin_phi + j);
+            __m128 c = _mm_loadu_ps(cos_phi + j);
+            __m128 x = _mm_mul_ps(rho4, s);
+            __m128 z = _mm_mul_ps(neg_rho4, c);
+            __m128 nx = _mm_mul_ps(n_rho4, s);
+            __m128 nz = _mm_mul_ps(neg_n_rho4, c);
+
+            // Four (x, y, z, nx) rows and two (ny, nz) pairs per register, stitched into six rows of 24 floats
+            __m128 a0 = x, a1 = y4, a2 = z, a3 = nx;
+            _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+            __m128 low = _mm_unpacklo_ps(n_y4, nz);
+            __m128 high = _mm_unpackhi_ps(n_y4, nz);
+            _mm_storeu_ps(dst + 0, a0);
+            _mm_storeu_ps(dst + 4, _mm_movelh_ps(low, a1));
+            _mm_storeu_ps(dst + 8, _mm_shuffle_ps(a1, low, _MM_SHUFFLE(3, 2, 3, 2)));
+            _mm_storeu_ps(dst + 12, a2);
+            _mm_storeu_ps(dst + 16, _mm_movelh_ps(high, a3));
+            _mm_storeu_ps(dst + 20, _mm_shuffle_ps(a3, high, _MM_SHUFFLE(3, 2, 3, 2)));
+        }
+        for (; j < count; ++j) {
+            writeVertex(out[j], sin_phi[j], cos_phi[j], rho, -rho, y, n_rho, -n_rho, n_y);
+        }
+    }
+
+    size_t uvSphereVertexCount(size_t n_theta, size_t n_phi) {
+        return 2 + (n_theta - 2) * n_phi;
+    }
+
+    void generateUvSphere(float radius, size_t n_theta, size_t n_phi, SimpleVertex* out) {
+        assert(n_theta >= 3 && n_phi >= 3);
+        const TrigTable theta = makeTrigTable(n_theta - 2, XM_PI / (n_theta - 1), XM_PI / (n_theta - 1));
+        const TrigTable phi = makeTrigTable(n_phi, XM_2PI / n_phi);
+
+        out[0] = { XMFLOAT3(0.0f, radius, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) };
+        for (size_t i = 0; i + 2 < n_theta; ++i) {
+            writeRevolutionRing(phi, radius * theta._sin[i], radius * theta._cos[i], theta._sin[i], theta._cos[i], out + 1 + i * n_phi);
+        }
+        out[1 + (n_theta - 2) * n_phi] = { XMFLOAT3(0.0f, -radius, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) };
+    }
+
+    size_t torusVertexCount(size_t n_major, size_t n_minor) {
+        return n_major * n_minor;
+    }
+
+    size_t torusIndexCount(size_t n_major, size_t n_minor) {
+        return 6 * n_major * n_minor;
+    }
+
+    void generateTorus(float major_radius, float minor_radius, size_t n_major, size_t n_minor, SimpleVertex* out, unsigned* indices) {
+        assert(n_major >= 3 && n_minor >= 3);
+        const TrigTable tube = makeTrigTable(n_minor, XM_2PI / n_minor);
+        const TrigTable phi = makeTrigTable(n_major, XM_2PI / n_major);
+
+        // Ring i is the circle the tube angle i sweeps around y, starting at the outer equator and going up
+        for (size_t i = 0; i < n_minor; ++i) {
+            writeRevolutionRing(phi, major_radius + minor_radius * tube._cos[i], minor_radius * tube._sin[i], tube._cos[i], tube._sin[i], out + i * n_major);
+        }
+        for (unsigned i = 0; i < n_minor; ++i) {
+            unsigned ring = (unsigned)(i * n_major);
+            unsigned next_ring = (unsigned)(((i + 1) % n_minor) * n_major);
+            for (unsigned j = 0; j < n_major; ++j) {
+                unsigned next = (unsigned)((j + 1) % n_major);
+                *indices++ = ring + j;
+                *indices++ = next_ring + j;
+                *indices++ = ring + next;
+                *indices++ = ring + next;
+                *indices++ = next_ring + j;
+                *indices++ = next_ring + next;
+            }
+        }
+    }
+
+    size_t capsuleVertexCount(size_t n_cap, size_t n_phi) {
+        return 2 + 2 * n_cap * n_phi;
+    }
+
+    size_t capsuleIndexCount(size_t n_cap, size_t n_phi) {
+        return 6 * n_phi + 6 * n_phi * (2 * n_cap - 1);
+    }
+
+    void generateCapsule(float radius, float half_height, size_t n_cap, size_t n_phi, SimpleVertex* out, unsigned* indices) {
+        assert(n_cap >= 1 && n_phi >= 3);
+        // Rings 1..n_cap of the top cap end on the equator, the bottom cap starts on it
+        const TrigTable top = makeTrigTable(n_cap, XM_PIDIV2 / n_cap, XM_PIDIV2 / n_cap);
+        const TrigTable bottom = makeTrigTable(n_cap, XM_PIDIV2 / n_cap, XM_PIDIV2);
+        const TrigTable phi = makeTrigTable(n_phi, XM_2PI / n_phi);
+
+        out[0] = { XMFLOAT3(0.0f, radius + half_height, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) };
+        for (size_t i = 0; i < n_cap; ++i) {
+            writeRevolutionRing(phi, radius * top._sin[i], radius * top._cos[i] + half_height, top._sin[i], top._cos[i], out + 1 + i * n_phi);
+        }
+        for (size_t i = 0; i < n_cap; ++i) {
+            writeRevolutionRing(phi, radius * bottom._sin[i], radius * bottom._cos[i] - half_height, bottom._sin[i], bottom._cos[i], out + 1 + (n_cap + i) * n_phi);
+        }
+        out[1 + 2 * n_cap * n_phi] = { XMFLOAT3(0.0f, -radius - half_height, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f) };
+        writePolarIndices(2 * n_cap, n_phi, indices);
+    }
+}
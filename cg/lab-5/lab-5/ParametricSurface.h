@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "SimpleVertex.h"
+
+namespace rendering {
+    // sin and cos of first + i * step. Angles are multiplied out, not accumulated, so the
+    // last entry of a 1000 step table is as exact as the first one
+    struct TrigTable {
+        std::vector<float> _sin;
+        std::vector<float> _cos;
+    };
+
+    TrigTable makeTrigTable(size_t count, float step, float first = 0.0f);
+
+    // One ring of a surface of revolution around y, in the orientation Sphere uses:
+    // pos = (rho sin(phi), y, -rho cos(phi)), nor = (n_rho sin(phi), n_y, -n_rho cos(phi)).
+    // Writes phi._sin.size() vertices. SSE does four columns at a time and the rest goes through the
+    // same operations one by one, so the output is bitwise the same for every ring length
+    void writeRevolutionRing(const TrigTable& phi, float rho, float y, float n_rho, float n_y, SimpleVertex* out);
+
+    // The generators write into preallocated memory of the given size, a vector or the geometry arena.
+    // Index buffers are wound so that cross(p1 - p0, p2 - p0) points outwards.
+    // Output is interleaved SimpleVertex and not separate position and normal arrays: the arena and the input
+    // layout take SimpleVertex, so the ring kernel keeps x, z, nx and nz of four columns in registers and
+    // interleaves them on the store instead of writing arrays that would have to be packed again
+
+    // Layout of Sphere: top pole, n_theta - 2 rings of n_phi vertices, bottom pole
+    size_t uvSphereVertexCount(size_t n_theta, size_t n_phi);
+    void generateUvSphere(float radius, size_t n_theta, size_t n_phi, SimpleVertex* out);
+
+    // n_minor rings of n_major vertices around the y axis, the tube wraps around without a seam
+    size_t torusVertexCount(size_t n_major, size_t n_minor);
+    size_t torusIndexCount(size_t n_major, size_t n_minor);
+    void generateTorus(float major_radius, float minor_radius, size_t n_major, size_t n_minor, SimpleVertex* out, unsigned* indices);
+
+    // Cylinder of length 2 * half_height along y capped by hemispheres of n_cap rings each
+    size_t capsuleVertexCount(size_t n_cap, size_t n_phi);
+    size_t capsuleIndexCount(size_t n_cap, size_t n_phi);
+    void generateCapsule(float radius, float half_height, size_t n_cap, size_t n_phi, SimpleVertex* out, unsigned* indices);
+}
@@ -1,5 +1,8 @@
 #include "PointLight.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace rendering {
     float PointLight::getIntensity() {
         return _intensities[_current_index];
@@ -8,4 +11,8 @@ namespace rendering {
     void PointLight::changeIntensity() {
         _current_index = (_current_index + 1) % 3;
     }
+
+    float PointLight::getRange(float threshold) {
+        return std::sqrt(std::max(getIntensity() / threshold - _const_att, 0.0f) / _quadratic_att);
+    }
 }
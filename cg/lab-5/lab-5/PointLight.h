@@ -7,6 +7,8 @@ namespace rendering {
     public:
         float getIntensity();
         void changeIntensity();
+        // Distance where intensity / (_const_att + _quadratic_att * d^2) falls to threshold
+        float getRange(float threshold);
 
         DirectX::XMFLOAT4 _pos;
         DirectX::XMFLOAT4 _color;
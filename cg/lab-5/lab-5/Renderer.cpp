@@ -4,8 +4,15 @@
 #include <DirectXColors.h>
 #include <DirectXMath.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
 #include <string>
 
 #include "ImGui/imgui.h"
@@ -15,6 +22,13 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "STBImage/stb_image.h"
 
+#include "Geometry/GeometryRegistry.h"
+#include "Geometry/LodChain.h"
+#include "Geometry/MeshCache.h"
+#include "Geometry/MeshOptimizer.h"
+#include "Geometry/VertexEncoding.h"
+#include "SoftwareRenderer/ParallelFor.h"
+
 #include "Keys.h"
 #include "SimpleVertex.h"
 #include "Sphere.h"
@@ -22,10 +36,21 @@
 #define DEBUG_LAYER
 
 namespace {
-    ID3DBlob* compileShader(LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags) {
+    // Parameters the sphere LOD chain is generated from. The version has to go up whenever Sphere or the mesh optimizer changes their output
+    struct SphereLodSource {
+        uint32_t _version = 2;
+        float _radius = 1.0f;
+        uint32_t _n_theta = 60;
+        uint32_t _n_phi = 60;
+        uint32_t _level_count = 5;
+    };
+
+    const wchar_t* SPHERE_CACHE_PATH = L"sphere.meshcache";
+
+    ID3DBlob* compileShader(LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags, const D3D_SHADER_MACRO* p_defines = nullptr) {
         ID3DBlob* p_code = nullptr;
         ID3DBlob* p_error_msgs = nullptr;
-        HRESULT hr = D3DCompileFromFile(p_file_name, nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, p_entrypoint, p_target, flags, 0, &p_code, &p_error_msgs);
+        HRESULT hr = D3DCompileFromFile(p_file_name, p_defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, p_entrypoint, p_target, flags, 0, &p_code, &p_error_msgs);
         if (p_error_msgs) {
             OutputDebugStringA((LPCSTR)p_error_msgs->GetBufferPointer());
         }
@@ -33,22 +58,63 @@ namespace {
         return p_code;
     }
 
-    ID3D11VertexShader* createVertexShader(ID3D11Device* p_device, LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags) {
-        ID3DBlob* p_code = compileShader(p_file_name, p_entrypoint, p_target, flags);
+    ID3D11VertexShader* createVertexShader(ID3D11Device* p_device, LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags, const D3D_SHADER_MACRO* p_defines = nullptr) {
+        ID3DBlob* p_code = compileShader(p_file_name, p_entrypoint, p_target, flags, p_defines);
         ID3D11VertexShader* p_vertex_shader;
         HRESULT hr = p_device->CreateVertexShader(p_code->GetBufferPointer(), p_code->GetBufferSize(), nullptr, &p_vertex_shader);
         assert(SUCCEEDED(hr));
         return p_vertex_shader;
     }
 
-    ID3D11PixelShader* createPixelShader(ID3D11Device* p_device, LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags) {
-        ID3DBlob* p_code = compileShader(p_file_name, p_entrypoint, p_target, flags);
+    ID3D11PixelShader* createPixelShader(ID3D11Device* p_device, LPCWSTR p_file_name, LPCSTR p_entrypoint, LPCSTR p_target, UINT flags, const D3D_SHADER_MACRO* p_defines = nullptr) {
+        ID3DBlob* p_code = compileShader(p_file_name, p_entrypoint, p_target, flags, p_defines);
         ID3D11PixelShader* p_pixel_shader;
         HRESULT hr = p_device->CreatePixelShader(p_code->GetBufferPointer(), p_code->GetBufferSize(), nullptr, &p_pixel_shader);
         assert(SUCCEEDED(hr));
         return p_pixel_shader;
     }
 
+    void reportMeshOptimization(const char* name, const rendering::geometry::MeshOptimizationReport& report) {
+        char message[256];
+        sprintf_s(message, "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overfetch %.2f -> %.2f\n", name,
+            report._cache_before._acmr, report._cache_after._acmr, report._cache_before._atvr, report._cache_after._atvr,
+            report._fetch_before._overfetch, report._fetch_after._overfetch);
+        OutputDebugStringA(message);
+    }
+
+    DXGI_FORMAT getIndexFormat(const rendering::geometry::CompactMesh& mesh) {
+        return mesh._index_format == rendering::geometry::IndexFormat::UINT16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    }
+
+    MeshDecodeCB makeMeshDecodeCB(const rendering::geometry::CompactMesh& mesh) {
+        MeshDecodeCB decode_cbuffer;
+        decode_cbuffer._position_scale = DirectX::XMFLOAT4(mesh._position_scale.x, mesh._position_scale.y, mesh._position_scale.z, 0.0f);
+        decode_cbuffer._position_offset = DirectX::XMFLOAT4(mesh._position_offset.x, mesh._position_offset.y, mesh._position_offset.z, 0.0f);
+        return decode_cbuffer;
+    }
+
+    void reportLodChain(const char* name, const rendering::geometry::LodChainView& chain) {
+        for (size_t i = 0; i < chain._level_count; ++i) {
+            char message[256];
+            const rendering::geometry::LodLevel& level = chain._levels[i];
+            sprintf_s(message, "%s LOD %zu: %u triangles, error %.2e\n", name, i, level._index_count / 3, level._error);
+            OutputDebugStringA(message);
+        }
+    }
+
+    void reportMeshCache(const wchar_t* path, rendering::geometry::MeshCacheStatus status) {
+        char message[256];
+        sprintf_s(message, "%ls: %s, rebuilding\n", path, rendering::geometry::getMeshCacheStatusName(status));
+        OutputDebugStringA(message);
+    }
+
+    void reportEncoding(const char* name, const rendering::geometry::EncodingReport& report) {
+        char message[256];
+        sprintf_s(message, "%s: %zu -> %zu bytes, position error %.2e, normal error %.4f deg\n", name,
+            report._bytes_before, report._bytes_after, report._max_position_error, report._max_normal_error);
+        OutputDebugStringA(message);
+    }
+
     ID3D11Buffer* createBuffer(ID3D11Device* p_device, UINT byte_width, UINT bind_flags, const void* p_sys_mem) {
         D3D11_BUFFER_DESC buffer_desc = CD3D11_BUFFER_DESC(byte_width, bind_flags);
         D3D11_SUBRESOURCE_DATA initial_data = { 0 };
@@ -59,6 +125,59 @@ namespace {
         return p_buffer;
     }
 
+    // Dynamic structured buffer with room for count elements, recreated twice as large when it is too small
+    void reserveStructuredBuffer(ID3D11Device* p_device, UINT stride, UINT count, ID3D11Buffer** p_p_buffer, ID3D11ShaderResourceView** p_p_srv, UINT& capacity) {
+        if (*p_p_buffer && count <= capacity) {
+            return;
+        }
+        if (*p_p_buffer) {
+            (*p_p_buffer)->Release();
+            (*p_p_srv)->Release();
+        }
+        capacity = max(max(count, 2 * capacity), 1u);
+        CD3D11_BUFFER_DESC desc(stride * capacity, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE,
+            D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, stride);
+        HRESULT hr = p_device->CreateBuffer(&desc, nullptr, p_p_buffer);
+        assert(SUCCEEDED(hr));
+        CD3D11_SHADER_RESOURCE_VIEW_DESC srv_desc(*p_p_buffer, DXGI_FORMAT_UNKNOWN, 0, capacity);
+        hr = p_device->CreateShaderResourceView(*p_p_buffer, &srv_desc, p_p_srv);
+        assert(SUCCEEDED(hr));
+    }
+
+    void uploadBuffer(ID3D11DeviceContext* p_device_context, ID3D11Buffer* p_buffer, const void* p_data, size_t byte_size) {
+        if (byte_size == 0) {
+            return;
+        }
+        D3D11_MAPPED_SUBRESOURCE mapped_subresource;
+        HRESULT hr = p_device_context->Map(p_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+        assert(SUCCEEDED(hr));
+        memcpy(mapped_subresource.pData, p_data, byte_size);
+        p_device_context->Unmap(p_buffer, 0);
+    }
+
+    class D3D11GeometryDevice : public rendering::geometry::GeometryDevice {
+    public:
+        D3D11GeometryDevice(ID3D11Device* p_device, ID3D11DeviceContext* p_device_context) : _p_device(p_device), _p_device_context(p_device_context) {}
+
+        void* createBuffer(rendering::geometry::GeometryBufferType type, size_t byte_size) override {
+            return ::createBuffer(_p_device, (UINT)byte_size,
+                type == rendering::geometry::GeometryBufferType::VERTEX ? D3D11_BIND_VERTEX_BUFFER : D3D11_BIND_INDEX_BUFFER, nullptr);
+        }
+
+        void writeBuffer(void* buffer, size_t byte_offset, size_t byte_size, const void* data) override {
+            const D3D11_BOX box = { (UINT)byte_offset, 0, 0, (UINT)(byte_offset + byte_size), 1, 1 };
+            _p_device_context->UpdateSubresource((ID3D11Buffer*)buffer, 0, &box, data, 0, 0);
+        }
+
+        void releaseBuffer(void* buffer) override {
+            ((ID3D11Buffer*)buffer)->Release();
+        }
+
+    private:
+        ID3D11Device* _p_device;
+        ID3D11DeviceContext* _p_device_context;
+    };
+
     void renderTexture(ID3D11DeviceContext* p_device_context, ID3D11RenderTargetView** p_p_render_target_view, D3D11_VIEWPORT& viewport, ID3D11VertexShader* p_vertex_shader, ID3D11PixelShader* p_pixel_shader, ID3D11ShaderResourceView** p_p_shader_resource_view, ID3D11SamplerState** p_p_sampler_state, ID3D11Buffer** p_p_constant_buffer = nullptr, void* p_constant_buffer_data = nullptr) {
         p_device_context->ClearRenderTargetView(*p_p_render_target_view, DirectX::Colors::Black.f);
 
@@ -181,12 +300,23 @@ namespace rendering {
 
         _p_vertex_shader = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsMain", "vs_5_0", flags);
 
+        _p_vs_compact_blob = compileShader(L"../../lab-5/shaders.hlsl", "vsMainCompact", "vs_5_0", flags);
+        _p_vertex_shader_compact = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsMainCompact", "vs_5_0", flags);
+
         _p_pixel_shader_lambert = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psLambert", "ps_5_0", flags);
         _p_pixel_shader_pbr = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psPBR", "ps_5_0", flags);
         _p_pixel_shader_ndf = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psNDF", "ps_5_0", flags);
         _p_pixel_shader_geometry = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psGeometry", "ps_5_0", flags);
         _p_pixel_shader_fresnel = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psFresnel", "ps_5_0", flags);
 
+        const D3D_SHADER_MACRO instanced_defines[] = { { "INSTANCED", "1" }, { nullptr, nullptr } };
+        _p_vs_instanced_blob = compileShader(L"../../lab-5/shaders.hlsl", "vsMainInstanced", "vs_5_0", flags, instanced_defines);
+        _p_vertex_shader_instanced = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsMainInstanced", "vs_5_0", flags, instanced_defines);
+        _p_pixel_shader_pbr_instanced = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psPBR", "ps_5_0", flags, instanced_defines);
+        _p_pixel_shader_ndf_instanced = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psNDF", "ps_5_0", flags, instanced_defines);
+        _p_pixel_shader_geometry_instanced = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psGeometry", "ps_5_0", flags, instanced_defines);
+        _p_pixel_shader_fresnel_instanced = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psFresnel", "ps_5_0", flags, instanced_defines);
+
         _p_pixel_shader_cube_map = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psCubeMap", "ps_5_0", flags);
         _p_pixel_shader_irradiance_map = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psIrradianceMap", "ps_5_0", flags);
         _p_pixel_shader_prefiltered_color = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psPrefilteredColor", "ps_5_0", flags);
@@ -194,12 +324,15 @@ namespace rendering {
 
         _p_vertex_shader_copy = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsCopyMain", "vs_5_0", flags);
         _p_pixel_shader_copy = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psCopyMain", "ps_5_0", flags);
+        _p_pixel_shader_copy_scaled = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psCopyScaledMain", "ps_5_0", flags);
+        _p_pixel_shader_temporal_resolve = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psTemporalResolve", "ps_5_0", flags);
 
         _p_pixel_shader_log_luminance = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psLogLuminanceMain", "ps_5_0", flags);
 
         _p_pixel_shader_tone_mapping = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psToneMappingMain", "ps_5_0", flags);
 
         _p_skymap_vs = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsSkymap", "vs_5_0", flags);
+        _p_skymap_vs_compact = createVertexShader(_p_device, L"../../lab-5/shaders.hlsl", "vsSkymapCompact", "vs_5_0", flags);
         _p_skymap_ps = createPixelShader(_p_device, L"../../lab-5/shaders.hlsl", "psSkymap", "ps_5_0", flags);
     }
 
@@ -212,6 +345,25 @@ namespace rendering {
 
         HRESULT hr = _p_device->CreateInputLayout(input_element_desc, ARRAYSIZE(input_element_desc), _p_vs_blob->GetBufferPointer(), _p_vs_blob->GetBufferSize(), &_p_input_layout);
         assert(SUCCEEDED(hr));
+
+        // geometry::CompactVertex, both meshes are encoded with PositionEncoding::SNORM16
+        D3D11_INPUT_ELEMENT_DESC compact_element_desc[] = {
+          { "POS", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+          { "NOR", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        };
+
+        hr = _p_device->CreateInputLayout(compact_element_desc, ARRAYSIZE(compact_element_desc), _p_vs_compact_blob->GetBufferPointer(), _p_vs_compact_blob->GetBufferSize(), &_p_input_layout_compact);
+        assert(SUCCEEDED(hr));
+
+        // SimpleVertex in slot 0, the index of a visible MaterialInstance in slot 1
+        D3D11_INPUT_ELEMENT_DESC instanced_element_desc[] = {
+          { "POS", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+          { "NOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+          { "INSTANCE", 0, DXGI_FORMAT_R32_UINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        };
+
+        hr = _p_device->CreateInputLayout(instanced_element_desc, ARRAYSIZE(instanced_element_desc), _p_vs_instanced_blob->GetBufferPointer(), _p_vs_instanced_blob->GetBufferSize(), &_p_input_layout_instanced);
+        assert(SUCCEEDED(hr));
     }
 
     void Renderer::resizeResources(size_t width, size_t height) {
@@ -221,7 +373,8 @@ namespace rendering {
             _p_depth_stencil->Release();
         }
 
-        CD3D11_TEXTURE2D_DESC depth_desc(DXGI_FORMAT_D24_UNORM_S8_UINT, (UINT)width, (UINT)height, 1, 1, D3D11_BIND_DEPTH_STENCIL);
+        // Typeless, so that the temporal resolve can read the depth for reprojection
+        CD3D11_TEXTURE2D_DESC depth_desc(DXGI_FORMAT_R24G8_TYPELESS, (UINT)width, (UINT)height, 1, 1, D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
         HRESULT hr = _p_device->CreateTexture2D(&depth_desc, nullptr, &_p_depth_stencil);
         assert(SUCCEEDED(hr));
 
@@ -229,17 +382,31 @@ namespace rendering {
             _p_depth_stencil_view->Release();
         }
 
-        CD3D11_DEPTH_STENCIL_VIEW_DESC depth_stencil_view_desc(D3D11_DSV_DIMENSION_TEXTURE2D, depth_desc.Format);
+        CD3D11_DEPTH_STENCIL_VIEW_DESC depth_stencil_view_desc(D3D11_DSV_DIMENSION_TEXTURE2D, DXGI_FORMAT_D24_UNORM_S8_UINT);
         hr = _p_device->CreateDepthStencilView(_p_depth_stencil, &depth_stencil_view_desc, &_p_depth_stencil_view);
         assert(SUCCEEDED(hr));
 
+        if (_p_depth_shader_resource_view) {
+            _p_depth_shader_resource_view->Release();
+        }
+
+        CD3D11_SHADER_RESOURCE_VIEW_DESC depth_shader_resource_view_desc(D3D11_SRV_DIMENSION_TEXTURE2D, DXGI_FORMAT_R24_UNORM_X8_TYPELESS);
+        hr = _p_device->CreateShaderResourceView(_p_depth_stencil, &depth_shader_resource_view_desc, &_p_depth_shader_resource_view);
+        assert(SUCCEEDED(hr));
+
         // Setup projection
-        float near_z = 0.01f, far_z = 100.0f;
+        float near_z = _s_NEAR_Z, far_z = _s_FAR_Z;
         _projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, width / (FLOAT)height, near_z, far_z);
 
         _render_texture.SetDevice(_p_device);
         _render_texture.SizeResources(width, height);
 
+        for (auto& history_texture : _history_textures) {
+            history_texture.SetDevice(_p_device);
+            history_texture.SizeResources(width, height);
+        }
+        _history_valid = false;
+
         size_t n = (size_t)log2((double)min(width, height));
         _square_copy.SetDevice(_p_device);
         _square_copy.SizeResources(1i64 << n, 1i64 << n);
@@ -272,23 +439,9 @@ namespace rendering {
         _p_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         _p_device_context->IASetInputLayout(_p_input_layout);
 
-        SimpleVertex verts[6][4] = {
-            { { { 0.5f, -0.5f, 0.5f } }, { { 0.5f, 0.5f, 0.5f } }, { { 0.5f, 0.5f, -0.5f } }, { { 0.5f, -0.5f, -0.5f } } },
-            { { { -0.5f, -0.5f, -0.5f } }, { { -0.5f, 0.5f, -0.5f } }, { { -0.5f, 0.5f, 0.5f } }, { { -0.5f, -0.5f, 0.5f } } },
-            { { { -0.5f, 0.5f, 0.5f } }, { { -0.5f, 0.5f, -0.5f } }, { { 0.5f, 0.5f, -0.5f } }, { { 0.5f, 0.5f, 0.5f } } },
-            { { { -0.5f, -0.5f, -0.5f } }, { { -0.5f, -0.5f, 0.5f } }, { { 0.5f, -0.5f, 0.5f } }, { { 0.5f, -0.5f, -0.5f } } },
-            { { { -0.5f, -0.5f, 0.5f } }, { { -0.5f, 0.5f, 0.5f } }, { { 0.5f, 0.5f, 0.5f } }, { { 0.5f, -0.5f, 0.5f } } },
-            { { { 0.5f, -0.5f, -0.5f } }, { { 0.5f, 0.5f, -0.5f } }, { { -0.5f, 0.5f, -0.5f } }, { { -0.5f, -0.5f, -0.5f } } }
-        };
-
-        unsigned inds[6] = {
-            0, 1, 2,
-            2, 3, 0
-        };
-
-        auto p_index_buffer = createBuffer(_p_device, sizeof(unsigned) * 6, D3D11_BIND_INDEX_BUFFER, inds);
-        _p_device_context->IASetIndexBuffer(p_index_buffer, DXGI_FORMAT_R32_UINT, 0);
-        p_index_buffer->Release();
+        ID3D11Buffer* p_vertex_buffer = (ID3D11Buffer*)_geometry.getVertexBuffer();
+        _p_device_context->IASetVertexBuffers(0, 1, &p_vertex_buffer, &_vertex_stride, &_vertex_offset);
+        _p_device_context->IASetIndexBuffer((ID3D11Buffer*)_geometry.getIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
         DirectX::XMVECTOR dirs[6] = {
             { 1, 0, 0 },
@@ -333,17 +486,13 @@ namespace rendering {
             _p_device_context->PSSetConstantBuffers(1, 1, &_p_sprops_cbuffer);
 
             for (size_t i = 0; i < 6; ++i) {
-                auto p_vertex_buffer = createBuffer(_p_device, sizeof(SimpleVertex) * 4, D3D11_BIND_VERTEX_BUFFER, verts[i]);
-                _p_device_context->IASetVertexBuffers(0, 1, &p_vertex_buffer, &_vertex_stride, &_vertex_offset);
-                p_vertex_buffer->Release();
-
                 Camera camera({ 0.0f, 0.0f, 0.0f }, dirs[i], ups[i]);
                 geometry_cbuffer._view = DirectX::XMMatrixTranspose(camera.getViewMatrix());
                 _p_device_context->UpdateSubresource(_p_geometry_cbuffer, 0, nullptr, &geometry_cbuffer, 0, 0);
                 _p_device_context->VSSetConstantBuffers(0, 1, &_p_geometry_cbuffer);
 
                 _p_device_context->ClearRenderTargetView(p_rtv, DirectX::Colors::Black);
-                _p_device_context->DrawIndexed(6, 0, 0);
+                _p_device_context->DrawIndexed(6, _cube_faces_mesh._first_index + 6 * (UINT)i, _cube_faces_mesh._base_vertex);
                 _p_device_context->CopySubresourceRegion(p_sm_texture, (UINT)(i * mip_levels + mip_level), 0, 0, 0, rt.GetRenderTarget(), 0, nullptr);
             }
         }
@@ -373,21 +522,9 @@ namespace rendering {
         _p_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         _p_device_context->IASetInputLayout(_p_input_layout);
 
-        SimpleVertex verts[4] = {
-            { { 0.0f, 0.0f, 0.5f } },
-            { { 0.0f, 1.0f, 0.5f } },
-            { { 1.0f, 1.0f, 0.5f } },
-            { { 1.0f, 0.0f, 0.5f } }
-        };
-
-        unsigned inds[6] = {
-            0, 1, 2,
-            2, 3, 0
-        };
-
-        auto p_index_buffer = createBuffer(_p_device, sizeof(unsigned) * 6, D3D11_BIND_INDEX_BUFFER, inds);
-        _p_device_context->IASetIndexBuffer(p_index_buffer, DXGI_FORMAT_R32_UINT, 0);
-        p_index_buffer->Release();
+        ID3D11Buffer* p_vertex_buffer = (ID3D11Buffer*)_geometry.getVertexBuffer();
+        _p_device_context->IASetVertexBuffers(0, 1, &p_vertex_buffer, &_vertex_stride, &_vertex_offset);
+        _p_device_context->IASetIndexBuffer((ID3D11Buffer*)_geometry.getIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 
         _p_device_context->VSSetShader(_p_vertex_shader, nullptr, 0);
         _p_device_context->PSSetShader(_p_pixel_shader_preintegrated_brdf, nullptr, 0);
@@ -396,17 +533,13 @@ namespace rendering {
         geometry_cbuffer._world = DirectX::XMMatrixTranspose(DirectX::XMMatrixIdentity());
         geometry_cbuffer._projection = DirectX::XMMatrixTranspose(DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1, 0.01f, 1));
 
-        auto p_vertex_buffer = createBuffer(_p_device, sizeof(SimpleVertex) * 4, D3D11_BIND_VERTEX_BUFFER, verts);
-        _p_device_context->IASetVertexBuffers(0, 1, &p_vertex_buffer, &_vertex_stride, &_vertex_offset);
-        p_vertex_buffer->Release();
-
         Camera camera({ 0.5f, 0.5f, 0.0f });
         geometry_cbuffer._view = DirectX::XMMatrixTranspose(camera.getViewMatrix());
         _p_device_context->UpdateSubresource(_p_geometry_cbuffer, 0, nullptr, &geometry_cbuffer, 0, 0);
         _p_device_context->VSSetConstantBuffers(0, 1, &_p_geometry_cbuffer);
 
         _p_device_context->ClearRenderTargetView(p_rtv, DirectX::Colors::Black);
-        _p_device_context->DrawIndexed(6, 0, 0);
+        _p_device_context->DrawIndexed(_quad_mesh._index_count, _quad_mesh._first_index, _quad_mesh._base_vertex);
         _p_device_context->CopySubresourceRegion(p_sm_texture, 0, 0, 0, 0, rt.GetRenderTarget(), 0, nullptr);
 
         _p_device_context->PSSetShaderResources(0, _s_MAX_NUM_SHADER_RESOURCE_VIEWS, _null_shader_resource_views);
@@ -420,11 +553,43 @@ namespace rendering {
         _borders._min = { -20.0f, -10.0f, -20.0f };
         _borders._max = { 20.0f, 10.0f, 20.0f };
 
-        Sphere sphere(1.0f, 30, 30, true, true);
-        auto& vertices = sphere.getVertices();
-        auto& indices = sphere.getIndices();
+        _sphere_transform = _transforms.add(scene::Transform());
+        scene::Transform sky_local;
+        sky_local._scale = DirectX::XMFLOAT3(5.0f, 5.0f, 5.0f);
+        _sky_transform = _transforms.add(sky_local);
+        scene::Transform torus_local;
+        torus_local._translation = DirectX::XMFLOAT3(-2.5f, 0.0f, 0.0f);
+        DirectX::XMStoreFloat4(&torus_local._rotation, DirectX::XMQuaternionRotationAxis(DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), DirectX::XM_PI / 3.0f));
+        _torus_transform = _transforms.add(torus_local);
+        scene::Transform capsule_local;
+        capsule_local._translation = DirectX::XMFLOAT3(2.5f, 0.0f, 0.0f);
+        _capsule_transform = _transforms.add(capsule_local);
+
+        const SphereLodSource sphere_source;
+        const uint64_t sphere_source_hash = geometry::hashMeshSource(&sphere_source, sizeof(sphere_source));
+        geometry::MeshCacheStatus cache_status = _sphere_cache.open(SPHERE_CACHE_PATH, sphere_source_hash, true);
+        if (cache_status == geometry::MeshCacheStatus::OK) {
+            _sphere_lod = _sphere_cache.getView();
+        } else {
+            reportMeshCache(SPHERE_CACHE_PATH, cache_status);
+            _sphere_lod_chain = geometry::makeSphereLodChain(sphere_source._radius, sphere_source._n_theta, sphere_source._n_phi, sphere_source._level_count, true, true);
+            geometry::writeMeshCache(SPHERE_CACHE_PATH, _sphere_lod_chain, sphere_source_hash);
+            _sphere_lod = _sphere_lod_chain.getView();
+        }
+        reportLodChain("Sphere", _sphere_lod);
+        for (size_t i = 0; i < _sphere_lod._level_count; ++i) {
+            const geometry::LodLevel& level = _sphere_lod._levels[i];
+            _sphere_meshlets.push_back(geometry::buildMeshlets(_sphere_lod._vertices, _sphere_lod._vertex_count,
+                _sphere_lod._indices + level._first_index, level._index_count));
+        }
+
+        // Vertices on the unit sphere, so every triangle lies inside the spheres it stands for
+        const Sphere occluder(1.0f, _s_OCCLUDER_N_THETA, _s_OCCLUDER_N_PHI, true, true);
+        for (const SimpleVertex& vertex : occluder.getVertices()) {
+            _occluder_positions.push_back(vertex._pos);
+        }
+        _occluder_indices = occluder.getIndices();
 
-        _indices_number = (UINT)indices.size();
         _vertex_stride = sizeof(SimpleVertex);
         _vertex_offset = 0;
 
@@ -441,15 +606,34 @@ namespace rendering {
         _lights[0]._pos = { 0.0f, 3.0f, -2.0f, 0.0f };
         _lights[0]._color = (DirectX::XMFLOAT4)DirectX::Colors::White;
 
-        _p_vertex_buffer = createBuffer(_p_device, sizeof(SimpleVertex) * (UINT)vertices.size(), D3D11_BIND_VERTEX_BUFFER, vertices.data());
-
-        _p_index_buffer = createBuffer(_p_device, sizeof(unsigned) * _indices_number, D3D11_BIND_INDEX_BUFFER, indices.data());
+        geometry::MeshKey sphere_key;
+        sphere_key._kind = geometry::MeshKind::SPHERE_LOD_CHAIN;
+        sphere_key._radius = sphere_source._radius;
+        sphere_key._n_theta = sphere_source._n_theta;
+        sphere_key._n_phi = sphere_source._n_phi;
+        sphere_key._level_count = sphere_source._level_count;
+        sphere_key._flags = geometry::MESH_OUTER_NORMALS | geometry::MESH_CORRECT_ORIENTATION;
+        // The chain stays where it is, in the mapped cache or in _sphere_lod_chain, and is uploaded from there
+        _sphere_mesh = _geometry.addExternal(sphere_key, _sphere_lod._vertices, _sphere_lod._vertex_count, _sphere_lod._indices, _sphere_lod._index_count);
+        // Level 0 has the most triangles, so every culled index list fits
+        _p_culled_index_buffer = createBuffer(_p_device, sizeof(unsigned) * _sphere_lod._levels[0]._index_count, D3D11_BIND_INDEX_BUFFER, nullptr);
+
+        geometry::CompactMesh compact = geometry::encodeMesh(_sphere_lod._vertices, _sphere_lod._vertex_count, _sphere_lod._indices, _sphere_lod._index_count);
+        reportEncoding("Sphere", geometry::measureEncoding(_sphere_lod._vertices, _sphere_lod._vertex_count, _sphere_lod._index_count, compact));
+        _compact_vertex_stride = sizeof(geometry::CompactVertex);
+        _compact_index_format = getIndexFormat(compact);
+        _p_compact_vertex_buffer = createBuffer(_p_device, _compact_vertex_stride * (UINT)compact._vertices.size(), D3D11_BIND_VERTEX_BUFFER, compact._vertices.data());
+        _p_compact_index_buffer = createBuffer(_p_device, (UINT)(compact.getIndexSize() * compact.getIndexCount()), D3D11_BIND_INDEX_BUFFER, compact.getIndexData());
+        MeshDecodeCB decode_cbuffer = makeMeshDecodeCB(compact);
+        _p_decode_cbuffer = createBuffer(_p_device, sizeof(MeshDecodeCB), D3D11_BIND_CONSTANT_BUFFER, &decode_cbuffer);
 
 
         _p_geometry_cbuffer = createBuffer(_p_device, sizeof(GeometryOperatorsCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
         _p_sprops_cbuffer = createBuffer(_p_device, sizeof(SurfacePropsCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
         _p_lights_cbuffer = createBuffer(_p_device, sizeof(LightsCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
         _p_adaptation_cbuffer = createBuffer(_p_device, sizeof(AdaptationCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
+        _p_temporal_cbuffer = createBuffer(_p_device, sizeof(TemporalResolveCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
+        _p_cluster_cbuffer = createBuffer(_p_device, sizeof(ClusterGridCB), D3D11_BIND_CONSTANT_BUFFER, nullptr);
 
 
         D3D11_SAMPLER_DESC samp_desc;
@@ -491,14 +675,30 @@ namespace rendering {
         hr = _p_device->CreateTexture2D(&average_log_luminance_texture_desc, nullptr, &_average_log_luminance_texture);
         assert(SUCCEEDED(hr));
 
-        Sphere environment(1.0f, 10, 10, false, true);
-
-        auto& env_verts = environment.getVertices();
-        _p_sphere_vert_buffer = createBuffer(_p_device, sizeof(SimpleVertex) * (UINT)env_verts.size(), D3D11_BIND_VERTEX_BUFFER, env_verts.data());
-
-        auto& env_indices = environment.getIndices();
-        _env_indices_number = (UINT)env_indices.size();
-        _p_sphere_index_buffer = createBuffer(_p_device, sizeof(unsigned) * _env_indices_number, D3D11_BIND_INDEX_BUFFER, env_indices.data());
+        _env_mesh = _geometry.getOrBuild(geometry::sphereKey(1.0f, 10, 10, false, true), [](std::vector<SimpleVertex>& env_verts, std::vector<unsigned>& env_indices) {
+            Sphere environment(1.0f, 10, 10, false, true);
+            env_verts = environment.getVertices();
+            env_indices = environment.getIndices();
+            reportMeshOptimization("Environment sphere", geometry::optimizeMesh(env_verts, env_indices));
+        });
+        _cube_faces_mesh = _geometry.getCubeFaces();
+        _quad_mesh = _geometry.getQuad();
+        _torus_mesh = _geometry.getTorus(0.7f, 0.3f, 96, 48);
+        _capsule_mesh = _geometry.getCapsule(0.5f, 0.5f, 24, 64);
+        D3D11GeometryDevice geometry_device(_p_device, _p_device_context);
+        _geometry.upload(geometry_device);
+
+        const SimpleVertex* env_verts = _geometry.getVertices(_env_mesh);
+        const unsigned* env_indices = _geometry.getIndices(_env_mesh);
+        _env_indices_number = _env_mesh._index_count;
+
+        geometry::CompactMesh env_compact = geometry::encodeMesh(env_verts, _env_mesh._vertex_count, env_indices, _env_mesh._index_count);
+        reportEncoding("Environment sphere", geometry::measureEncoding(env_verts, _env_mesh._vertex_count, _env_mesh._index_count, env_compact));
+        _env_compact_index_format = getIndexFormat(env_compact);
+        _p_compact_sphere_vert_buffer = createBuffer(_p_device, _compact_vertex_stride * (UINT)env_compact._vertices.size(), D3D11_BIND_VERTEX_BUFFER, env_compact._vertices.data());
+        _p_compact_sphere_index_buffer = createBuffer(_p_device, (UINT)(env_compact.getIndexSize() * env_compact.getIndexCount()), D3D11_BIND_INDEX_BUFFER, env_compact.getIndexData());
+        MeshDecodeCB env_decode_cbuffer = makeMeshDecodeCB(env_compact);
+        _p_env_decode_cbuffer = createBuffer(_p_device, sizeof(MeshDecodeCB), D3D11_BIND_CONSTANT_BUFFER, &env_decode_cbuffer);
 
         int x, y, channels_in_file;
         float* data = stbi_loadf("../../lab-5/kloppenheim_01_1k.hdr", &x, &y, &channels_in_file, STBI_rgb_alpha);
@@ -532,24 +732,65 @@ namespace rendering {
     }
 
     void Renderer::render() {
+        if (_replaying) {
+            if (_input_replay.isFinished()) {
+                char message[128];
+                uint32_t frames = _input_replay.getFrame();
+                sprintf_s(message, "Replay: %u frames, %.3f ms per frame\n", frames, frames ? _replay_render_time * 1000.0f / frames : 0.0f);
+                OutputDebugStringA(message);
+
+                _replaying = false;
+                ImGui::GetIO().ConfigFlags &= ~ImGuiConfigFlags_NoMouse;
+                PostMessage(_hwnd, WM_CLOSE, 0, 0);
+                return;
+            }
+            _input_replay.advance([this](const InputEvent& event) { applyInput(event); });
+        }
+        if (_recording) {
+            _input_journal.nextFrame();
+        }
+
         auto start = std::chrono::high_resolution_clock::now();
 
         auto render_texture_render_target_view = _render_texture.GetRenderTargetView();
         auto render_target_view = _render_mode == RenderModes::PBR ? render_texture_render_target_view : _p_render_target_view;
 
+        // The render texture is allocated at window size, the scene only covers its top-left part
+        float render_scale = _render_mode == RenderModes::PBR ? _render_scale : 1.0f;
+        D3D11_VIEWPORT scene_viewport = _viewport;
+        scene_viewport.Width = max(1.0f, floorf(_viewport.Width * render_scale));
+        scene_viewport.Height = max(1.0f, floorf(_viewport.Height * render_scale));
+        DirectX::XMFLOAT2 uv_scale(scene_viewport.Width / _viewport.Width, scene_viewport.Height / _viewport.Height);
+
+        bool temporal_upsampling = _temporal_upsampling && _render_mode == RenderModes::PBR;
+        DirectX::XMMATRIX projection = _projection;
+        DirectX::XMFLOAT2 jitter_uv(0.0f, 0.0f);
+        if (temporal_upsampling) {
+            DirectX::XMFLOAT2 jitter = temporalJitter(_jitter_index++);
+            projection = jitterProjection(_projection, jitter, scene_viewport.Width, scene_viewport.Height);
+            jitter_uv = DirectX::XMFLOAT2(jitter.x / _viewport.Width, jitter.y / _viewport.Height);
+        } else {
+            _history_valid = false;
+        }
+
         ID3D11PixelShader* p_pixel_shader = nullptr;
+        ID3D11PixelShader* p_pixel_shader_instanced = nullptr;
         switch (_render_mode) {
         case RenderModes::PBR:
             p_pixel_shader = _p_pixel_shader_pbr;
+            p_pixel_shader_instanced = _p_pixel_shader_pbr_instanced;
             break;
         case RenderModes::NDF:
             p_pixel_shader = _p_pixel_shader_ndf;
+            p_pixel_shader_instanced = _p_pixel_shader_ndf_instanced;
             break;
         case RenderModes::GEOMETRY:
             p_pixel_shader = _p_pixel_shader_geometry;
+            p_pixel_shader_instanced = _p_pixel_shader_geometry_instanced;
             break;
         case RenderModes::FRESNEL:
             p_pixel_shader = _p_pixel_shader_fresnel;
+            p_pixel_shader_instanced = _p_pixel_shader_fresnel_instanced;
             break;
         }
 
@@ -560,15 +801,18 @@ namespace rendering {
             _p_device_context->ClearRenderTargetView(render_target_view, background_color.f);
             _p_device_context->ClearDepthStencilView(_p_depth_stencil_view, D3D11_CLEAR_DEPTH, 1.0f, 0);
 
-            _p_device_context->RSSetViewports(1, &_viewport);
+            _p_device_context->RSSetViewports(1, &scene_viewport);
 
             _p_device_context->OMSetRenderTargets(1, &render_target_view, _p_depth_stencil_view);
             _p_device_context->OMSetDepthStencilState(_p_ds_less_equal, 0);
 
             _p_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-            _p_device_context->IASetInputLayout(_p_input_layout);
-            _p_device_context->IASetVertexBuffers(0, 1, &_p_vertex_buffer, &_vertex_stride, &_vertex_offset);
-            _p_device_context->IASetIndexBuffer(_p_index_buffer, DXGI_FORMAT_R32_UINT, 0);
+            bindSceneGeometry(false);
+            // Every compact buffer holds a single mesh, the arena holds all of them
+            const UINT sphere_first_index = _compact_vertices ? 0 : _sphere_mesh._first_index;
+            const INT sphere_base_vertex = _compact_vertices ? 0 : _sphere_mesh._base_vertex;
+            const UINT env_first_index = _compact_vertices ? 0 : _env_mesh._first_index;
+            const INT env_base_vertex = _compact_vertices ? 0 : _env_mesh._base_vertex;
 
             _p_annotation->EndEvent();
 
@@ -578,11 +822,33 @@ namespace rendering {
             DirectX::XMStoreFloat4(&camera_pos, _camera.getPosition());
             _p_annotation->EndEvent();
 
+            scene::Transform sky_local = _transforms.getLocal(_sky_transform);
+            sky_local._translation = DirectX::XMFLOAT3(camera_pos.x, camera_pos.y, camera_pos.z);
+            _transforms.setLocal(_sky_transform, sky_local);
+            _transforms.update();
+            const DirectX::XMMATRIX sphere_world = _transforms.getWorld(_sphere_transform);
+
+            float lod_distance = geometry::lodDistance(_camera.getPosition(), sphere_world.r[3], _sphere_lod._bounding_radius, _s_NEAR_Z);
+            _sphere_lod_level = geometry::selectLodLevel(_sphere_lod, lod_distance, 1.0f, _projection, scene_viewport.Height, _lod_threshold);
+
+            // The grid picks a level per sphere and draws the full index range of each
+            const bool meshlet_culling = _meshlet_culling && !_material_grid_enabled;
+            if (meshlet_culling) {
+                _p_annotation->BeginEvent(L"Meshlet culling");
+                _meshlet_stats = geometry::cullMeshlets(_sphere_meshlets[_sphere_lod_level], sphere_world, _view * _projection, _camera.getPosition(), _culled_indices);
+                if (!_culled_indices.empty()) {
+                    D3D11_BOX box = { 0, 0, 0, (UINT)(sizeof(unsigned) * _culled_indices.size()), 1, 1 };
+                    _p_device_context->UpdateSubresource(_p_culled_index_buffer, 0, &box, _culled_indices.data(), 0, 0);
+                }
+                _p_device_context->IASetIndexBuffer(_p_culled_index_buffer, DXGI_FORMAT_R32_UINT, 0);
+                _p_annotation->EndEvent();
+            }
+
             GeometryOperatorsCB geometry_cbuffer;
-            geometry_cbuffer._world = DirectX::XMMatrixTranspose(_world);
-            geometry_cbuffer._world_normals = DirectX::XMMatrixInverse(nullptr, _world);
+            geometry_cbuffer._world = DirectX::XMMatrixTranspose(sphere_world);
+            geometry_cbuffer._world_normals = DirectX::XMMatrixTranspose(_transforms.getNormal(_sphere_transform));
             geometry_cbuffer._view = DirectX::XMMatrixTranspose(_view);
-            geometry_cbuffer._projection = DirectX::XMMatrixTranspose(_projection);
+            geometry_cbuffer._projection = DirectX::XMMatrixTranspose(projection);
             geometry_cbuffer._camera_pos = camera_pos;
           
             _p_device_context->UpdateSubresource(_p_geometry_cbuffer, 0, nullptr, &geometry_cbuffer, 0, 0);
@@ -606,57 +872,162 @@ namespace rendering {
             }
             _p_device_context->UpdateSubresource(_p_lights_cbuffer, 0, nullptr, &lights_cbuffer, 0, 0);
 
-            _p_device_context->VSSetShader(_p_vertex_shader, nullptr, 0);
+            _p_annotation->BeginEvent(L"Light clusters");
+            updateLightClusters();
+            _p_annotation->EndEvent();
+
+            // Shared by every scene draw
             _p_device_context->VSSetConstantBuffers(0, 1, &_p_geometry_cbuffer);
-            _p_device_context->PSSetShader(p_pixel_shader, nullptr, 0);
             _p_device_context->PSSetConstantBuffers(0, 1, &_p_geometry_cbuffer);
             _p_device_context->PSSetConstantBuffers(1, 1, &_p_sprops_cbuffer);
             _p_device_context->PSSetConstantBuffers(2, 1, &_p_lights_cbuffer);
             _p_device_context->PSSetConstantBuffers(3, 1, &_p_adaptation_cbuffer);
-
-            _p_device_context->PSSetShaderResources(0, 1, &_p_smrv_irradiance);
-            _p_device_context->PSSetShaderResources(1, 1, &_p_smrv_prefiltered);
-            _p_device_context->PSSetShaderResources(2, 1, &_p_smrv_preintegrated);
+            _p_device_context->PSSetConstantBuffers(6, 1, &_p_cluster_cbuffer);
+            ID3D11ShaderResourceView* cluster_resources[] = { _p_clustered_light_srv, _p_cluster_range_srv, _p_cluster_index_srv };
+            _p_device_context->PSSetShaderResources(3, 3, cluster_resources);
             _p_device_context->PSSetSamplers(0, 1, &_p_min_mag_mip_linear);
             _p_device_context->PSSetSamplers(1, 1, &_p_min_mag_linear_mip_point_border);
 
-            _p_annotation->BeginEvent(L"Draw");
-            _p_device_context->DrawIndexed(_indices_number, 0, 0);
-            _p_device_context->PSSetShaderResources(0, _s_MAX_NUM_SHADER_RESOURCE_VIEWS, _null_shader_resource_views);
-            _p_annotation->EndEvent();
-
-            _p_device_context->IASetVertexBuffers(0, 1, &_p_sphere_vert_buffer, &_vertex_stride, &_vertex_offset);
-            _p_device_context->IASetIndexBuffer(_p_sphere_index_buffer, DXGI_FORMAT_R32_UINT, 0);
-
-            auto scale = DirectX::XMMatrixScaling(5, 5, 5);
-            auto translation = DirectX::XMMatrixTranslation(camera_pos.x, camera_pos.y, camera_pos.z);
-            _sphere_world = scale * translation;
-
-            geometry_cbuffer._world = DirectX::XMMatrixTranspose(_sphere_world);
-
-            _p_device_context->UpdateSubresource(_p_geometry_cbuffer, 0, nullptr, &geometry_cbuffer, 0, 0);
-
-            _p_device_context->VSSetShader(_p_skymap_vs, nullptr, 0);
-            _p_device_context->VSSetConstantBuffers(0, 1, &_p_geometry_cbuffer);
-            _p_device_context->PSSetShader(_p_skymap_ps, nullptr, 0);
-
-            _p_device_context->PSSetShaderResources(0, 1, &_p_smrv_sky);
-            _p_device_context->PSSetSamplers(0, 1, &_p_min_mag_mip_linear);
+            _scene_draws.clear();
+            _draw_queue.clear();
+            SceneDraw object_draw = {};
+            object_draw._kind = _material_grid_enabled ? SceneDrawKind::MATERIAL_GRID : SceneDrawKind::SPHERE;
+            if (_material_grid_enabled) {
+                object_draw._p_vertex_shader = _p_vertex_shader_instanced;
+                object_draw._p_pixel_shader = p_pixel_shader_instanced;
+            } else {
+                object_draw._p_vertex_shader = _compact_vertices ? _p_vertex_shader_compact : _p_vertex_shader;
+                object_draw._p_pixel_shader = p_pixel_shader;
+            }
+            object_draw._p_resources[0] = _p_smrv_irradiance;
+            object_draw._p_resources[1] = _p_smrv_prefiltered;
+            object_draw._p_resources[2] = _p_smrv_preintegrated;
+            // The grid has a material per instance, the sphere and the shapes share the surface props
+            object_draw._p_material = _material_grid_enabled ? (const void*)_p_instance_srv : (const void*)_p_sprops_cbuffer;
+            DirectX::XMStoreFloat4x4(&object_draw._world, sphere_world);
+            DirectX::XMStoreFloat4x4(&object_draw._normal, _transforms.getNormal(_sphere_transform));
+            const float object_distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(sphere_world.r[3], _camera.getPosition())));
+            pushSceneDraw(object_draw, ScenePass::OBJECTS, object_distance / _s_FAR_Z);
+
+            if (_shapes_enabled && !_material_grid_enabled) {
+                struct Shape {
+                    scene::TransformHandle _transform;
+                    geometry::MeshHandle _mesh;
+                };
+                const Shape shapes[] = { { _torus_transform, _torus_mesh }, { _capsule_transform, _capsule_mesh } };
+                for (const Shape& shape : shapes) {
+                    SceneDraw shape_draw = object_draw;
+                    shape_draw._kind = SceneDrawKind::SHAPE;
+                    shape_draw._p_vertex_shader = _p_vertex_shader;
+                    shape_draw._p_pixel_shader = p_pixel_shader;
+                    shape_draw._mesh = shape._mesh;
+                    const DirectX::XMMATRIX shape_world = _transforms.getWorld(shape._transform);
+                    DirectX::XMStoreFloat4x4(&shape_draw._world, shape_world);
+                    DirectX::XMStoreFloat4x4(&shape_draw._normal, _transforms.getNormal(shape._transform));
+                    const float shape_distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(shape_world.r[3], _camera.getPosition())));
+                    pushSceneDraw(shape_draw, ScenePass::OBJECTS, shape_distance / _s_FAR_Z);
+                }
+            }
 
-            _p_device_context->DrawIndexed(_env_indices_number, 0, 0);
+            SceneDraw sky_draw = {};
+            sky_draw._kind = SceneDrawKind::SKY;
+            sky_draw._p_vertex_shader = _compact_vertices ? _p_skymap_vs_compact : _p_skymap_vs;
+            sky_draw._p_pixel_shader = _p_skymap_ps;
+            sky_draw._p_resources[0] = _p_smrv_sky;
+            DirectX::XMStoreFloat4x4(&sky_draw._world, _transforms.getWorld(_sky_transform));
+            DirectX::XMStoreFloat4x4(&sky_draw._normal, _transforms.getNormal(_sky_transform));
+            pushSceneDraw(sky_draw, ScenePass::SKY, 1.0f);
+            _draw_queue.sort();
+
+            // Each draw only binds what differs from the draw before it. The geometry cbuffer was filled with the sphere world
+            ID3D11VertexShader* p_bound_vertex_shader = nullptr;
+            ID3D11PixelShader* p_bound_pixel_shader = nullptr;
+            ID3D11ShaderResourceView* bound_resources[_s_SCENE_DRAW_RESOURCES] = {};
+            DirectX::XMFLOAT4X4 bound_world = object_draw._world;
+            enum class BoundGeometry { SCENE, SKY, ARENA, NONE };
+            BoundGeometry bound_geometry = BoundGeometry::SCENE;
+            _p_annotation->BeginEvent(L"Draw");
+            for (const DrawPacket& packet : _draw_queue.getPackets()) {
+                const SceneDraw& draw = _scene_draws[packet._draw];
+                if (memcmp(&draw._world, &bound_world, sizeof(bound_world)) != 0) {
+                    geometry_cbuffer._world = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&draw._world));
+                    geometry_cbuffer._world_normals = DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&draw._normal));
+                    _p_device_context->UpdateSubresource(_p_geometry_cbuffer, 0, nullptr, &geometry_cbuffer, 0, 0);
+                    bound_world = draw._world;
+                }
+                if (draw._p_vertex_shader != p_bound_vertex_shader) {
+                    _p_device_context->VSSetShader(draw._p_vertex_shader, nullptr, 0);
+                    p_bound_vertex_shader = draw._p_vertex_shader;
+                }
+                if (draw._p_pixel_shader != p_bound_pixel_shader) {
+                    _p_device_context->PSSetShader(draw._p_pixel_shader, nullptr, 0);
+                    p_bound_pixel_shader = draw._p_pixel_shader;
+                }
+                for (UINT slot = 0; slot < _s_SCENE_DRAW_RESOURCES; ++slot) {
+                    if (draw._p_resources[slot] != bound_resources[slot]) {
+                        _p_device_context->PSSetShaderResources(slot, 1, &draw._p_resources[slot]);
+                        bound_resources[slot] = draw._p_resources[slot];
+                    }
+                }
 
-            _p_device_context->PSSetShaderResources(0, _s_MAX_NUM_SHADER_RESOURCE_VIEWS, _null_shader_resource_views);
+                switch (draw._kind) {
+                case SceneDrawKind::SPHERE:
+                    if (bound_geometry != BoundGeometry::SCENE) {
+                        bindSceneGeometry(meshlet_culling);
+                        bound_geometry = BoundGeometry::SCENE;
+                    }
+                    if (meshlet_culling) {
+                        _p_device_context->DrawIndexed((UINT)_culled_indices.size(), 0, sphere_base_vertex);
+                    } else {
+                        const geometry::LodLevel& lod = _sphere_lod._levels[_sphere_lod_level];
+                        _p_device_context->DrawIndexed(lod._index_count, sphere_first_index + lod._first_index, sphere_base_vertex);
+                    }
+                    break;
+                case SceneDrawKind::MATERIAL_GRID:
+                    // Binds its own input layout and buffers
+                    renderMaterialGrid(_view * projection, scene_viewport.Height);
+                    bound_geometry = BoundGeometry::NONE;
+                    break;
+                case SceneDrawKind::SHAPE:
+                    if (bound_geometry != BoundGeometry::ARENA) {
+                        bindArenaGeometry();
+                        bound_geometry = BoundGeometry::ARENA;
+                    }
+                    _p_device_context->DrawIndexed(draw._mesh._index_count, draw._mesh._first_index, draw._mesh._base_vertex);
+                    break;
+                case SceneDrawKind::SKY:
+                    if (bound_geometry != BoundGeometry::SKY) {
+                        bindSkyGeometry();
+                        bound_geometry = BoundGeometry::SKY;
+                    }
+                    _p_device_context->DrawIndexed(_env_indices_number, env_first_index, env_base_vertex);
+                    break;
+                }
+            }
+            _p_device_context->PSSetShaderResources(0, _s_SCENE_DRAW_RESOURCES, _null_shader_resource_views);
+            _p_annotation->EndEvent();
         }
 
         if (_render_mode == RenderModes::PBR) {
+            auto render_texture_shader_resource_view = _render_texture.GetShaderResourceView();
+            if (temporal_upsampling) {
+                renderTemporalResolve(uv_scale, jitter_uv);
+                render_texture_shader_resource_view = _history_textures[_history_index].GetShaderResourceView();
+                uv_scale = DirectX::XMFLOAT2(1.0f, 1.0f);
+            }
+
+            AdaptationCB adaptation_cbuffer;
+            adaptation_cbuffer._exposure_scale = _exposure_scale;
+            adaptation_cbuffer._adapted_log_luminance = _adapted_log_luminance;
+            adaptation_cbuffer._uv_scale = uv_scale;
+
             {
-                auto render_texture_shader_resource_view = _render_texture.GetShaderResourceView();
                 auto square_copy_render_target_view = _square_copy.GetRenderTargetView();
 
                 size_t n = _log_luminance_textures.size() - 1;
                 D3D11_VIEWPORT vp = { 0, 0, FLOAT(1 << n), FLOAT(1 << n), 0, 1 };
 
-                renderTexture(_p_device_context, &square_copy_render_target_view, vp, _p_vertex_shader_copy, _p_pixel_shader_copy, &render_texture_shader_resource_view, &_p_min_mag_mip_linear);
+                renderTexture(_p_device_context, &square_copy_render_target_view, vp, _p_vertex_shader_copy, _p_pixel_shader_copy_scaled, &render_texture_shader_resource_view, &_p_min_mag_mip_linear, &_p_adaptation_cbuffer, &adaptation_cbuffer);
             }
 
             {
@@ -690,16 +1061,19 @@ namespace rendering {
                 _p_device_context->Unmap(_average_log_luminance_texture, 0);
 
                 auto end = std::chrono::high_resolution_clock::now();
-                float delta_t = std::chrono::duration<float>(end - start).count();
+                float delta_t = _replaying ? _input_replay.getTimestep() : std::chrono::duration<float>(end - start).count();
                 float s = 1;
                 _adapted_log_luminance += (average_log_luminance - _adapted_log_luminance) * (1 - expf(-delta_t / s));
 
-                AdaptationCB adaptation_cbuffer;
-                adaptation_cbuffer._exposure_scale = _exposure_scale;
-                adaptation_cbuffer._adapted_log_luminance = _adapted_log_luminance;
-
+                // A replay takes the recorded scale from the journal, the governor would follow the wall clock
+                if (_dynamic_resolution && !_replaying) {
+                    float render_scale = _resolution_governor.update(delta_t * 1000.0f);
+                    if (render_scale != _render_scale) {
+                        changeParameter(InputParameter::RENDER_SCALE, render_scale);
+                    }
+                }
 
-                auto render_texture_shader_resource_view = _render_texture.GetShaderResourceView();
+                adaptation_cbuffer._adapted_log_luminance = _adapted_log_luminance;
 
                 renderTexture(_p_device_context, &_p_render_target_view, _viewport, _p_vertex_shader_copy,
                     _p_pixel_shader_tone_mapping, &render_texture_shader_resource_view, &_p_min_mag_mip_linear, &_p_adaptation_cbuffer, &adaptation_cbuffer);
@@ -712,72 +1086,610 @@ namespace rendering {
             ImGui::NewFrame();
             ImGui::Begin("Scene parameters");
             ImGui::Text("Scene");
-            ImGui::SliderFloat("Exposure scale", &_exposure_scale, 0, 20);
-            ImGui::ListBox("Render mode", (int*)(&_render_mode), _render_modes, _s_RENDER_MODES_NUMBER);
+            if (ImGui::SliderFloat("Exposure scale", &_exposure_scale, 0, 20)) {
+                changeParameter(InputParameter::EXPOSURE_SCALE, _exposure_scale);
+            }
+            if (ImGui::ListBox("Render mode", (int*)(&_render_mode), _render_modes, _s_RENDER_MODES_NUMBER)) {
+                changeParameter(InputParameter::RENDER_MODE, (float)_render_mode);
+            }
+            if (ImGui::Checkbox("Dynamic resolution", &_dynamic_resolution)) {
+                changeParameter(InputParameter::DYNAMIC_RESOLUTION, _dynamic_resolution);
+            }
+            if (_dynamic_resolution) {
+                float budget = _resolution_governor.getBudget();
+                if (ImGui::SliderFloat("Frame budget, ms", &budget, 1, 50)) {
+                    changeParameter(InputParameter::FRAME_BUDGET, budget);
+                }
+                ImGui::Text("Render scale: %.2f (%.1f ms)", _render_scale, _resolution_governor.getFilteredFrameTime());
+            }
+            if (ImGui::Checkbox("Temporal upsampling", &_temporal_upsampling)) {
+                changeParameter(InputParameter::TEMPORAL_UPSAMPLING, _temporal_upsampling);
+            }
+            if (ImGui::Checkbox("Compact vertices", &_compact_vertices)) {
+                changeParameter(InputParameter::COMPACT_VERTICES, _compact_vertices);
+            }
+            if (ImGui::SliderFloat("LOD error, px", &_lod_threshold, 0.1f, 8.0f)) {
+                changeParameter(InputParameter::LOD_THRESHOLD, _lod_threshold);
+            }
+            ImGui::Text("Sphere LOD %zu (%u triangles)", _sphere_lod_level, _sphere_lod._levels[_sphere_lod_level]._index_count / 3);
+            if (ImGui::Checkbox("Meshlet culling", &_meshlet_culling)) {
+                changeParameter(InputParameter::MESHLET_CULLING, _meshlet_culling);
+            }
+            if (_meshlet_culling) {
+                ImGui::Text("Meshlets %zu/%zu, triangles %zu/%zu", _meshlet_stats._visible_meshlets, _meshlet_stats._meshlets,
+                    _meshlet_stats._visible_triangles, _meshlet_stats._triangles);
+            }
+            if (ImGui::Checkbox("Torus and capsule", &_shapes_enabled)) {
+                changeParameter(InputParameter::SHAPES, _shapes_enabled);
+            }
+            if (ImGui::Checkbox("Material grid", &_material_grid_enabled)) {
+                changeParameter(InputParameter::MATERIAL_GRID, _material_grid_enabled);
+            }
+            if (_material_grid_enabled) {
+                if (ImGui::SliderInt("Grid size", &_material_grid_size, 1, 1000, "%d", ImGuiSliderFlags_Logarithmic)) {
+                    changeParameter(InputParameter::MATERIAL_GRID_SIZE, (float)_material_grid_size);
+                }
+                ImGui::Text("%zu spheres, roughness along x, metalness along y", _material_grid.getInstanceCount());
+                if (ImGui::Checkbox("Frustum culling", &_frustum_culling)) {
+                    changeParameter(InputParameter::FRUSTUM_CULLING, _frustum_culling);
+                }
+                if (ImGui::Checkbox("Occlusion culling", &_occlusion_culling)) {
+                    changeParameter(InputParameter::OCCLUSION_CULLING, _occlusion_culling);
+                }
+                ImGui::Text("Visible spheres %zu", _visible_instances.size());
+                if (_occlusion_culling) {
+                    ImGui::Text("Occluded spheres %zu, %.2f ms", _occluded_instances, _occlusion_time);
+                }
+                if (_picked_instance != ~0u) {
+                    ImGui::Text("Sphere %u: roughness %.2f, metalness %.2f", _picked_instance,
+                        _material_grid.getRoughness(_picked_instance), _material_grid.getMetalness(_picked_instance));
+                }
+            }
+            if (ImGui::SliderInt("Fill lights", &_fill_light_count, 0, _s_MAX_FILL_LIGHTS, "%d", ImGuiSliderFlags_Logarithmic)) {
+                changeParameter(InputParameter::FILL_LIGHTS, (float)_fill_light_count);
+            }
+            if (_fill_light_count > 0) {
+                ImGui::Text("Cluster light indices %zu, at most %zu per cluster, %.2f ms", _light_clusters.getLightIndices().size(),
+                    _light_clusters.getMaxClusterLights(), _light_assignment_time);
+            }
             ImGui::Text("Object");
-            ImGui::SliderFloat("Roughness", &_roughness, 0, 1);
-            ImGui::SliderFloat("Metalness", &_metalness, 0, 1);
-            ImGui::ColorEdit3("Metal F0", _sphere_color_rgb);
+            if (ImGui::SliderFloat("Roughness", &_roughness, 0, 1)) {
+                changeParameter(InputParameter::ROUGHNESS, _roughness);
+            }
+            if (ImGui::SliderFloat("Metalness", &_metalness, 0, 1)) {
+                changeParameter(InputParameter::METALNESS, _metalness);
+            }
+            if (ImGui::ColorEdit3("Metal F0", _sphere_color_rgb)) {
+                changeParameter(InputParameter::COLOR_R, _sphere_color_rgb[0]);
+                changeParameter(InputParameter::COLOR_G, _sphere_color_rgb[1]);
+                changeParameter(InputParameter::COLOR_B, _sphere_color_rgb[2]);
+            }
+            if (_replaying) {
+                ImGui::Text("Replaying frame %u", _input_replay.getFrame());
+            }
             ImGui::End();
 
             ImGui::Render();
             ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
-            _p_swap_chain->Present(1, 0);
+            // Replays measure the frame cost, so they are not held back by vsync
+            _p_swap_chain->Present(_replaying ? 0 : 1, 0);
         }
+
+        if (_replaying) {
+            _replay_render_time += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    void Renderer::pushSceneDraw(const SceneDraw& draw, ScenePass pass, float depth) {
+        DrawKeyFields fields;
+        fields._pass = (uint32_t)pass;
+        const uintptr_t shaders[] = { (uintptr_t)draw._p_vertex_shader, (uintptr_t)draw._p_pixel_shader };
+        fields._shader = _shader_ids.getId(shaders, 2);
+        const uintptr_t material = (uintptr_t)draw._p_material;
+        fields._material = _material_ids.getId(&material, 1);
+        uintptr_t resources[_s_SCENE_DRAW_RESOURCES];
+        for (UINT slot = 0; slot < _s_SCENE_DRAW_RESOURCES; ++slot) {
+            resources[slot] = (uintptr_t)draw._p_resources[slot];
+        }
+        fields._resources = _resource_ids.getId(resources, _s_SCENE_DRAW_RESOURCES);
+        fields._depth = depth;
+        _draw_queue.push(makeOpaqueDrawKey(fields), (uint32_t)_scene_draws.size());
+        _scene_draws.push_back(draw);
+    }
+
+    void Renderer::bindSceneGeometry(bool meshlet_culling) {
+        if (_compact_vertices) {
+            _p_device_context->IASetInputLayout(_p_input_layout_compact);
+            _p_device_context->IASetVertexBuffers(0, 1, &_p_compact_vertex_buffer, &_compact_vertex_stride, &_vertex_offset);
+            _p_device_context->IASetIndexBuffer(_p_compact_index_buffer, _compact_index_format, 0);
+            _p_device_context->VSSetConstantBuffers(5, 1, &_p_decode_cbuffer);
+        } else {
+            bindArenaGeometry();
+        }
+        if (meshlet_culling) {
+            _p_device_context->IASetIndexBuffer(_p_culled_index_buffer, DXGI_FORMAT_R32_UINT, 0);
+        }
+    }
+
+    void Renderer::bindSkyGeometry() {
+        if (_compact_vertices) {
+            _p_device_context->IASetInputLayout(_p_input_layout_compact);
+            _p_device_context->IASetVertexBuffers(0, 1, &_p_compact_sphere_vert_buffer, &_compact_vertex_stride, &_vertex_offset);
+            _p_device_context->IASetIndexBuffer(_p_compact_sphere_index_buffer, _env_compact_index_format, 0);
+            _p_device_context->VSSetConstantBuffers(5, 1, &_p_env_decode_cbuffer);
+        } else {
+            bindArenaGeometry();
+        }
+    }
+
+    void Renderer::bindArenaGeometry() {
+        _p_device_context->IASetInputLayout(_p_input_layout);
+        ID3D11Buffer* p_vertex_buffer = (ID3D11Buffer*)_geometry.getVertexBuffer();
+        _p_device_context->IASetVertexBuffers(0, 1, &p_vertex_buffer, &_vertex_stride, &_vertex_offset);
+        _p_device_context->IASetIndexBuffer((ID3D11Buffer*)_geometry.getIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+    }
+
+    void Renderer::renderMaterialGrid(DirectX::FXMMATRIX view_projection, float viewport_height) {
+        MaterialGridSettings settings;
+        settings._columns = (uint32_t)_material_grid_size;
+        settings._rows = (uint32_t)_material_grid_size;
+        settings._base_color = _sphere_color_srgb;
+        bool changed = _material_grid.update(settings);
+
+        const UINT instance_count = (UINT)_material_grid.getInstanceCount();
+        if (instance_count > _instance_capacity) {
+            if (_p_instance_buffer) {
+                _p_instance_buffer->Release();
+                _p_instance_srv->Release();
+                _p_visible_instance_buffer->Release();
+            }
+            // Dynamic, so that a change is packed straight into the mapped buffer
+            CD3D11_BUFFER_DESC instance_desc((UINT)sizeof(MaterialInstance) * instance_count, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE,
+                D3D11_RESOURCE_MISC_BUFFER_STRUCTURED, (UINT)sizeof(MaterialInstance));
+            HRESULT hr = _p_device->CreateBuffer(&instance_desc, nullptr, &_p_instance_buffer);
+            assert(SUCCEEDED(hr));
+            CD3D11_SHADER_RESOURCE_VIEW_DESC instance_srv_desc(_p_instance_buffer, DXGI_FORMAT_UNKNOWN, 0, instance_count);
+            hr = _p_device->CreateShaderResourceView(_p_instance_buffer, &instance_srv_desc, &_p_instance_srv);
+            assert(SUCCEEDED(hr));
+
+            CD3D11_BUFFER_DESC visible_desc((UINT)sizeof(uint32_t) * instance_count, D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+            hr = _p_device->CreateBuffer(&visible_desc, nullptr, &_p_visible_instance_buffer);
+            assert(SUCCEEDED(hr));
+            _instance_capacity = instance_count;
+            changed = true;
+        }
+        if (changed) {
+            D3D11_MAPPED_SUBRESOURCE mapped_subresource;
+            HRESULT hr = _p_device_context->Map(_p_instance_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+            assert(SUCCEEDED(hr));
+            _material_grid.pack((MaterialInstance*)mapped_subresource.pData);
+            _p_device_context->Unmap(_p_instance_buffer, 0);
+
+            const bool same_spheres = _material_grid_boxes.size() == instance_count;
+            scene::getSphereBounds(_material_grid.getBounds(), _material_grid_boxes);
+            if (same_spheres) {
+                _material_grid_bvh.refit(_material_grid_boxes);
+            } else {
+                _material_grid_bvh.build(_material_grid_boxes);
+            }
+        }
+
+        const scene::BoundingSpheres& spheres = _material_grid.getBounds();
+        const DirectX::XMVECTOR ray_origin = _camera.getPosition();
+        const DirectX::XMVECTOR ray_dir = _camera.getDirection();
+        _picked_instance = _material_grid_bvh.intersectRay(ray_origin, ray_dir, FLT_MAX, [&](uint32_t instance, float t_max) {
+            const DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(ray_origin,
+                DirectX::XMVectorSet(spheres._x[instance], spheres._y[instance], spheres._z[instance], 0.0f));
+            const float b = DirectX::XMVectorGetX(DirectX::XMVector3Dot(offset, ray_dir));
+            const float h = b * b - DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(offset)) + spheres._radius[instance] * spheres._radius[instance];
+            if (h < 0.0f) {
+                return -1.0f;
+            }
+            const float t = -b - std::sqrt(h);
+            return t <= t_max ? t : -1.0f;
+        })._object;
+
+        // Without culling the list only changes with the grid
+        const bool culled = _frustum_culling || _occlusion_culling;
+        bool visible_changed = changed || culled || _visible_instances_culled;
+        if (_frustum_culling) {
+            _p_annotation->BeginEvent(L"Frustum culling");
+            scene::cullSpheresParallel(scene::makeFrustumPlanes(view_projection), _material_grid.getBounds(), _visible_instances);
+            _p_annotation->EndEvent();
+            visible_changed = true;
+        } else if (visible_changed) {
+            _visible_instances.resize(instance_count);
+            std::iota(_visible_instances.begin(), _visible_instances.end(), 0u);
+        }
+        if (_occlusion_culling) {
+            _p_annotation->BeginEvent(L"Occlusion culling");
+            cullOccludedInstances(view_projection);
+            _p_annotation->EndEvent();
+        }
+        _visible_instances_culled = culled;
+        if (_visible_instances.empty()) {
+            return;
+        }
+
+        _previous_lod_instances.swap(_visible_lod_groups._instances);
+        const std::vector<uint32_t> previous_offsets = _visible_lod_groups._offsets;
+        groupInstancesByLod(spheres, _visible_instances, _sphere_lod, _camera.getPosition(), _projection, _s_NEAR_Z, viewport_height, _lod_threshold,
+            _visible_lod_groups);
+        visible_changed |= _visible_lod_groups._offsets != previous_offsets || _visible_lod_groups._instances != _previous_lod_instances;
+        if (visible_changed) {
+            D3D11_MAPPED_SUBRESOURCE mapped_subresource;
+            HRESULT hr = _p_device_context->Map(_p_visible_instance_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource);
+            assert(SUCCEEDED(hr));
+            memcpy(mapped_subresource.pData, _visible_lod_groups._instances.data(), sizeof(uint32_t) * _visible_lod_groups._instances.size());
+            _p_device_context->Unmap(_p_visible_instance_buffer, 0);
+        }
+
+        ID3D11Buffer* p_vertex_buffers[] = { (ID3D11Buffer*)_geometry.getVertexBuffer(), _p_visible_instance_buffer };
+        const UINT strides[] = { _vertex_stride, (UINT)sizeof(uint32_t) };
+        const UINT offsets[] = { 0, 0 };
+        _p_device_context->IASetInputLayout(_p_input_layout_instanced);
+        _p_device_context->IASetVertexBuffers(0, 2, p_vertex_buffers, strides, offsets);
+        _p_device_context->IASetIndexBuffer((ID3D11Buffer*)_geometry.getIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+        _p_device_context->VSSetShaderResources(0, 1, &_p_instance_srv);
+
+        // The instance stream of level l starts at its group, StartInstanceLocation offsets into it
+        for (size_t level = 0; level < _sphere_lod._level_count; ++level) {
+            const UINT first_instance = _visible_lod_groups._offsets[level];
+            const UINT level_instances = _visible_lod_groups._offsets[level + 1] - first_instance;
+            if (level_instances > 0) {
+                const geometry::LodLevel& lod = _sphere_lod._levels[level];
+                _p_device_context->DrawIndexedInstanced(lod._index_count, level_instances, _sphere_mesh._first_index + lod._first_index, _sphere_mesh._base_vertex,
+                    first_instance);
+            }
+        }
+
+        ID3D11Buffer* p_null_buffer = nullptr;
+        const UINT zero = 0;
+        _p_device_context->IASetVertexBuffers(1, 1, &p_null_buffer, &zero, &zero);
+        _p_device_context->IASetInputLayout(_compact_vertices ? _p_input_layout_compact : _p_input_layout);
+        _p_device_context->VSSetShaderResources(0, 1, _null_shader_resource_views);
+    }
+
+    // The spheres closest to the camera are the occluders for all the others
+    void Renderer::cullOccludedInstances(DirectX::FXMMATRIX view_projection) {
+        auto start = std::chrono::high_resolution_clock::now();
+        const scene::BoundingSpheres& spheres = _material_grid.getBounds();
+        DirectX::XMFLOAT3 camera_pos;
+        DirectX::XMStoreFloat3(&camera_pos, _camera.getPosition());
+        auto distance = [&](uint32_t instance) {
+            const float dx = spheres._x[instance] - camera_pos.x;
+            const float dy = spheres._y[instance] - camera_pos.y;
+            const float dz = spheres._z[instance] - camera_pos.z;
+            return dx * dx + dy * dy + dz * dz;
+        };
+        _occluders = _visible_instances;
+        const size_t occluder_count = min(_s_OCCLUDER_COUNT, _occluders.size());
+        std::nth_element(_occluders.begin(), _occluders.begin() + occluder_count, _occluders.end(),
+            [&](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+
+        _occlusion_buffer.begin(view_projection);
+        for (size_t i = 0; i < occluder_count; ++i) {
+            const uint32_t instance = _occluders[i];
+            const float radius = spheres._radius[instance];
+            _occlusion_buffer.renderOccluder(_occluder_positions, _occluder_indices, DirectX::XMMatrixScaling(radius, radius, radius)
+                * DirectX::XMMatrixTranslation(spheres._x[instance], spheres._y[instance], spheres._z[instance]));
+        }
+        _occlusion_buffer.buildHierarchy();
+
+        _occlusion_results.resize(_visible_instances.size());
+        software::parallelFor((_visible_instances.size() + _s_OCCLUSION_TEST_BLOCK_SIZE - 1) / _s_OCCLUSION_TEST_BLOCK_SIZE, [&](size_t block) {
+            const size_t end = min((block + 1) * _s_OCCLUSION_TEST_BLOCK_SIZE, _visible_instances.size());
+            for (size_t i = block * _s_OCCLUSION_TEST_BLOCK_SIZE; i < end; ++i) {
+                _occlusion_results[i] = _occlusion_buffer.testAabb(_material_grid_boxes[_visible_instances[i]]) == scene::OcclusionResult::OCCLUDED;
+            }
+        });
+        size_t visible_count = 0;
+        for (size_t i = 0; i < _visible_instances.size(); ++i) {
+            if (!_occlusion_results[i]) {
+                _visible_instances[visible_count++] = _visible_instances[i];
+            }
+        }
+        _occluded_instances = _visible_instances.size() - visible_count;
+        _visible_instances.resize(visible_count);
+        _occlusion_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Fill lights are regenerated from a fixed seed when their count changes, the clusters are assigned every frame
+    void Renderer::updateLightClusters() {
+        auto start = std::chrono::high_resolution_clock::now();
+        const size_t fill_light_count = (size_t)_fill_light_count;
+        const bool lights_changed = _fill_lights.size() != fill_light_count;
+        if (lights_changed) {
+            std::mt19937 generator(1);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            _fill_lights.resize(fill_light_count);
+            _fill_light_bounds.resize(fill_light_count);
+            _clustered_lights.resize(fill_light_count);
+            const DirectX::XMVECTOR extent = DirectX::XMVectorSubtract(_borders._max, _borders._min);
+            for (size_t i = 0; i < fill_light_count; ++i) {
+                // Drawn up front, the evaluation order of arguments is unspecified
+                float random[6];
+                for (float& value : random) {
+                    value = unit(generator);
+                }
+                PointLight& light = _fill_lights[i];
+                DirectX::XMStoreFloat4(&light._pos, DirectX::XMVectorMultiplyAdd(DirectX::XMVectorSet(random[0], random[1], random[2], 0.0f), extent, _borders._min));
+                light._pos.w = 1.0f;
+                light._color = DirectX::XMFLOAT4(0.2f + 0.8f * random[3], 0.2f + 0.8f * random[4], 0.2f + 0.8f * random[5], 1.0f);
+                light._quadratic_att = _s_FILL_LIGHT_ATTENUATION;
+
+                const float range = light.getRange(_s_FILL_LIGHT_CUTOFF);
+                const float intensity = light.getIntensity();
+                _fill_light_bounds[i] = { DirectX::XMFLOAT3(light._pos.x, light._pos.y, light._pos.z), range };
+                ClusteredLight& clustered = _clustered_lights[i];
+                clustered._position = DirectX::XMFLOAT4(light._pos.x, light._pos.y, light._pos.z, range);
+                clustered._radiance = DirectX::XMFLOAT4(light._color.x * intensity, light._color.y * intensity, light._color.z * intensity, 1.0f);
+                clustered._attenuation = DirectX::XMFLOAT4(light._const_att, light._quadratic_att, 0.0f, 0.0f);
+            }
+            reserveStructuredBuffer(_p_device, (UINT)sizeof(ClusteredLight), (UINT)fill_light_count, &_p_clustered_light_buffer, &_p_clustered_light_srv, _clustered_light_capacity);
+            uploadBuffer(_p_device_context, _p_clustered_light_buffer, _clustered_lights.data(), sizeof(ClusteredLight) * fill_light_count);
+        }
+
+        // Unjittered, the shaders find the cluster of a pixel from its view position, not from the rasterized one
+        scene::ClusterGridSettings settings = _light_clusters.getSettings();
+        settings._near_z = _s_NEAR_Z;
+        settings._far_z = _s_FAR_Z;
+        settings._projection_x = DirectX::XMVectorGetX(_projection.r[0]);
+        settings._projection_y = DirectX::XMVectorGetY(_projection.r[1]);
+        const scene::ClusterGridSettings& current = _light_clusters.getSettings();
+        if (_light_clusters.getRanges().empty() || settings._projection_x != current._projection_x || settings._projection_y != current._projection_y) {
+            _light_clusters.setGrid(settings);
+        }
+        _light_clusters.assign(_view, _fill_light_bounds);
+
+        const std::vector<scene::ClusterRange>& ranges = _light_clusters.getRanges();
+        const std::vector<uint32_t>& indices = _light_clusters.getLightIndices();
+        reserveStructuredBuffer(_p_device, (UINT)sizeof(scene::ClusterRange), (UINT)ranges.size(), &_p_cluster_range_buffer, &_p_cluster_range_srv, _cluster_range_capacity);
+        reserveStructuredBuffer(_p_device, (UINT)sizeof(uint32_t), (UINT)indices.size(), &_p_cluster_index_buffer, &_p_cluster_index_srv, _cluster_index_capacity);
+        if (!_p_clustered_light_buffer) {
+            reserveStructuredBuffer(_p_device, (UINT)sizeof(ClusteredLight), 0, &_p_clustered_light_buffer, &_p_clustered_light_srv, _clustered_light_capacity);
+        }
+        uploadBuffer(_p_device_context, _p_cluster_range_buffer, ranges.data(), sizeof(scene::ClusterRange) * ranges.size());
+        uploadBuffer(_p_device_context, _p_cluster_index_buffer, indices.data(), sizeof(uint32_t) * indices.size());
+
+        ClusterGridCB cluster_cbuffer;
+        cluster_cbuffer._projection_tiles = DirectX::XMFLOAT4(settings._projection_x, settings._projection_y, (float)settings._tiles_x, (float)settings._tiles_y);
+        cluster_cbuffer._depth_slices = DirectX::XMFLOAT4(settings._near_z, settings._slices / std::log(settings._far_z / settings._near_z), (float)settings._slices, 0.0f);
+        _p_device_context->UpdateSubresource(_p_cluster_cbuffer, 0, nullptr, &cluster_cbuffer, 0, 0);
+        _light_assignment_time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void Renderer::renderTemporalResolve(const DirectX::XMFLOAT2& uv_scale, const DirectX::XMFLOAT2& jitter_uv) {
+        _p_annotation->BeginEvent(L"Temporal resolve");
+
+        DirectX::XMMATRIX view_projection = _view * _projection;
+
+        TemporalResolveCB temporal_cbuffer;
+        temporal_cbuffer._inv_view_projection = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, view_projection));
+        temporal_cbuffer._prev_view_projection = DirectX::XMMatrixTranspose(_history_valid ? _prev_view_projection : view_projection);
+        temporal_cbuffer._jitter_uv = jitter_uv;
+        temporal_cbuffer._current_weight = _history_valid ? 0.1f : 1.0f;
+        _p_device_context->UpdateSubresource(_p_temporal_cbuffer, 0, nullptr, &temporal_cbuffer, 0, 0);
+
+        AdaptationCB adaptation_cbuffer;
+        adaptation_cbuffer._exposure_scale = _exposure_scale;
+        adaptation_cbuffer._adapted_log_luminance = _adapted_log_luminance;
+        adaptation_cbuffer._uv_scale = uv_scale;
+        _p_device_context->UpdateSubresource(_p_adaptation_cbuffer, 0, nullptr, &adaptation_cbuffer, 0, 0);
+
+        size_t next_history_index = 1 - _history_index;
+        auto p_rtv = _history_textures[next_history_index].GetRenderTargetView();
+
+        _p_device_context->RSSetViewports(1, &_viewport);
+        _p_device_context->OMSetRenderTargets(1, &p_rtv, nullptr);
+
+        _p_device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        _p_device_context->IASetInputLayout(nullptr);
+
+        _p_device_context->VSSetShader(_p_vertex_shader_copy, nullptr, 0);
+        _p_device_context->PSSetShader(_p_pixel_shader_temporal_resolve, nullptr, 0);
+        _p_device_context->PSSetConstantBuffers(3, 1, &_p_adaptation_cbuffer);
+        _p_device_context->PSSetConstantBuffers(4, 1, &_p_temporal_cbuffer);
+
+        ID3D11ShaderResourceView* shader_resource_views[3] = {
+            _render_texture.GetShaderResourceView(),
+            _p_depth_shader_resource_view,
+            _history_textures[_history_index].GetShaderResourceView()
+        };
+        _p_device_context->PSSetShaderResources(0, 3, shader_resource_views);
+        _p_device_context->PSSetSamplers(1, 1, &_p_min_mag_linear_mip_point_border);
+
+        _p_device_context->Draw(4, 0);
+
+        _p_device_context->PSSetShaderResources(0, _s_MAX_NUM_SHADER_RESOURCE_VIEWS, _null_shader_resource_views);
+
+        _prev_view_projection = view_projection;
+        _history_index = next_history_index;
+        _history_valid = true;
+
+        _p_annotation->EndEvent();
     }
 
     void Renderer::handleKey(WPARAM wParam, LPARAM lParam) {
-        LPARAM mask_0_15 = 65535, mask_30 = 1 << 30;
-        LPARAM b0_15 = lParam & mask_0_15; // The number of times the keystroke is autorepeated as a result of the user holding down the key.
+        LPARAM mask_30 = 1 << 30;
         LPARAM b30 = (lParam & mask_30) != 0; // The value is 1 if the key is down before the message is sent, or it is zero if the key is up.
-        float step = 0.1f;
-        switch (wParam) {
-        case (WPARAM)Keys::W_KEY:
-            _camera.moveNormal(step);
-            _camera.positionClip(_borders);
+        handleInput(keyEvent((uint32_t)wParam, b30));
+    }
+
+    void Renderer::handleMouse(int dx, int dy) {
+        handleInput(mouseEvent(dx, dy));
+    }
+
+    void Renderer::resize(size_t width, size_t height) {
+        handleInput(resizeEvent((uint32_t)width, (uint32_t)height));
+    }
+
+    void Renderer::startRecording(const std::filesystem::path& path) {
+        _journal_path = path;
+        _recording = true;
+        recordParameters();
+    }
+
+    bool Renderer::startReplay(const std::filesystem::path& path) {
+        InputJournal journal;
+        if (!journal.load(path)) {
+            return false;
+        }
+        _input_replay = InputReplay(std::move(journal));
+        _replaying = true;
+        _replay_render_time = 0.0f;
+        // Only the journal drives the scene, the UI stays visible but does not take the mouse
+        ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_NoMouse;
+        return true;
+    }
+
+    void Renderer::handleInput(const InputEvent& event) {
+        if (_replaying) {
+            return;
+        }
+        if (_recording) {
+            _input_journal.record(event);
+        }
+        applyInput(event);
+    }
+
+    void Renderer::applyInput(const InputEvent& event) {
+        if (applyCameraInput(event, _camera, _borders)) {
+            return;
+        }
+
+        switch (event._type) {
+        case InputEventType::KEY:
+            // Autorepeat does not toggle the lights again
+            if (event._x) {
+                break;
+            }
+            switch ((Keys)event._code) {
+            case Keys::_1_KEY:
+                _lights[0].changeIntensity();
+                break;
+            case Keys::_2_KEY:
+                if (N_LIGHTS > 1)
+                    _lights[1].changeIntensity();
+                break;
+            case Keys::_3_KEY:
+                if (N_LIGHTS > 2)
+                    _lights[2].changeIntensity();
+                break;
+            default:
+                break;
+            }
             break;
-        case (WPARAM)Keys::S_KEY:
-            _camera.moveNormal(-step);
-            _camera.positionClip(_borders);
+        case InputEventType::RESIZE:
+            resizeBuffers(event._x, event._y);
             break;
-        case (WPARAM)Keys::A_KEY:
-            _camera.moveTangent(step);
-            _camera.positionClip(_borders);
+        case InputEventType::PARAMETER:
+            setParameter((InputParameter)event._code, event._value);
             break;
-        case (WPARAM)Keys::D_KEY:
-            _camera.moveTangent(-step);
-            _camera.positionClip(_borders);
+        default:
             break;
-        case (WPARAM)Keys::_1_KEY:
-            if (!b30) {
-                _lights[0].changeIntensity();
-            }
+        }
+    }
+
+    void Renderer::setParameter(InputParameter parameter, float value) {
+        switch (parameter) {
+        case InputParameter::EXPOSURE_SCALE:
+            _exposure_scale = value;
             break;
-        case (WPARAM)Keys::_2_KEY:
-            if (!b30) {
-                if(N_LIGHTS > 1)
-                    _lights[1].changeIntensity();
-            }
+        case InputParameter::RENDER_MODE:
+            _render_mode = (RenderModes)(int)value;
             break;
-        case (WPARAM)Keys::_3_KEY:
-            if (!b30) {
-                if (N_LIGHTS > 2)
-                    _lights[2].changeIntensity();
+        case InputParameter::DYNAMIC_RESOLUTION:
+            _dynamic_resolution = value != 0.0f;
+            if (!_dynamic_resolution) {
+                _resolution_governor.reset();
+                _render_scale = 1.0f;
             }
             break;
-        default:
+        case InputParameter::FRAME_BUDGET:
+            _resolution_governor.setBudget(value);
+            break;
+        case InputParameter::RENDER_SCALE:
+            _render_scale = value;
+            break;
+        case InputParameter::TEMPORAL_UPSAMPLING:
+            _temporal_upsampling = value != 0.0f;
+            break;
+        case InputParameter::ROUGHNESS:
+            _roughness = value;
+            break;
+        case InputParameter::METALNESS:
+            _metalness = value;
+            break;
+        case InputParameter::COLOR_R:
+        case InputParameter::COLOR_G:
+        case InputParameter::COLOR_B:
+            _sphere_color_rgb[(int)parameter - (int)InputParameter::COLOR_R] = value;
+            break;
+        case InputParameter::COMPACT_VERTICES:
+            _compact_vertices = value != 0.0f;
+            break;
+        case InputParameter::LOD_THRESHOLD:
+            _lod_threshold = value;
+            break;
+        case InputParameter::MESHLET_CULLING:
+            _meshlet_culling = value != 0.0f;
+            break;
+        case InputParameter::MATERIAL_GRID:
+            _material_grid_enabled = value != 0.0f;
+            break;
+        case InputParameter::MATERIAL_GRID_SIZE:
+            _material_grid_size = (int)value;
+            break;
+        case InputParameter::FRUSTUM_CULLING:
+            _frustum_culling = value != 0.0f;
+            break;
+        case InputParameter::OCCLUSION_CULLING:
+            _occlusion_culling = value != 0.0f;
+            break;
+        case InputParameter::FILL_LIGHTS:
+            _fill_light_count = (int)value;
+            break;
+        case InputParameter::SHAPES:
+            _shapes_enabled = value != 0.0f;
             break;
         }
     }
 
-    void Renderer::handleMouse(int dx, int dy) {
-        float mouse_sence = 5e-3f;
-        _camera.rotateHorisontal(dx * mouse_sence);
-        _camera.rotateVertical(dy * mouse_sence);
+    void Renderer::changeParameter(InputParameter parameter, float value) {
+        if (_recording) {
+            _input_journal.record(parameterEvent(parameter, value));
+        }
+        setParameter(parameter, value);
     }
 
-    void Renderer::resize(size_t width, size_t height) {
+    // The journal starts with the full UI state and window size, so a replay does not depend on the defaults in initScene
+    void Renderer::recordParameters() {
+        _input_journal.record(resizeEvent((uint32_t)_viewport.Width, (uint32_t)_viewport.Height));
+        changeParameter(InputParameter::EXPOSURE_SCALE, _exposure_scale);
+        changeParameter(InputParameter::RENDER_MODE, (float)_render_mode);
+        changeParameter(InputParameter::FRAME_BUDGET, _resolution_governor.getBudget());
+        changeParameter(InputParameter::DYNAMIC_RESOLUTION, _dynamic_resolution);
+        changeParameter(InputParameter::RENDER_SCALE, _render_scale);
+        changeParameter(InputParameter::TEMPORAL_UPSAMPLING, _temporal_upsampling);
+        changeParameter(InputParameter::ROUGHNESS, _roughness);
+        changeParameter(InputParameter::METALNESS, _metalness);
+        changeParameter(InputParameter::COLOR_R, _sphere_color_rgb[0]);
+        changeParameter(InputParameter::COLOR_G, _sphere_color_rgb[1]);
+        changeParameter(InputParameter::COLOR_B, _sphere_color_rgb[2]);
+        changeParameter(InputParameter::COMPACT_VERTICES, _compact_vertices);
+        changeParameter(InputParameter::LOD_THRESHOLD, _lod_threshold);
+        changeParameter(InputParameter::MESHLET_CULLING, _meshlet_culling);
+        changeParameter(InputParameter::MATERIAL_GRID, _material_grid_enabled);
+        changeParameter(InputParameter::MATERIAL_GRID_SIZE, (float)_material_grid_size);
+        changeParameter(InputParameter::FRUSTUM_CULLING, _frustum_culling);
+        changeParameter(InputParameter::OCCLUSION_CULLING, _occlusion_culling);
+        changeParameter(InputParameter::FILL_LIGHTS, (float)_fill_light_count);
+        changeParameter(InputParameter::SHAPES, _shapes_enabled);
+    }
+
+    void Renderer::resizeBuffers(size_t width, size_t height) {
         if (_p_swap_chain) {
             const size_t REASONABLE_DEFAULT_MIN_SIZE = 8;
             width = max(REASONABLE_DEFAULT_MIN_SIZE, width);
@@ -813,6 +1725,12 @@ namespace rendering {
     }
 
     Renderer::~Renderer() {
+        // The window is gone by now, so a failed save goes to the debugger output like the replay timings
+        if (_recording && !_input_journal.save(_journal_path)) {
+            const std::string message = "Input journal: cannot write " + _journal_path.string() + "\n";
+            OutputDebugStringA(message.c_str());
+        }
+
         ImGui_ImplDX11_Shutdown();
         ImGui_ImplWin32_Shutdown();
         ImGui::DestroyContext();
@@ -823,12 +1741,38 @@ namespace rendering {
         _p_sprops_cbuffer->Release();
         _p_lights_cbuffer->Release();
         _p_adaptation_cbuffer->Release();
-        _p_vertex_buffer->Release();
-        _p_index_buffer->Release();
-        _p_sphere_vert_buffer->Release();
-        _p_sphere_index_buffer->Release();
+        _p_temporal_cbuffer->Release();
+        _p_cluster_cbuffer->Release();
+        if (_p_clustered_light_buffer) {
+            _p_clustered_light_buffer->Release();
+            _p_clustered_light_srv->Release();
+        }
+        if (_p_cluster_range_buffer) {
+            _p_cluster_range_buffer->Release();
+            _p_cluster_range_srv->Release();
+            _p_cluster_index_buffer->Release();
+            _p_cluster_index_srv->Release();
+        }
+        D3D11GeometryDevice geometry_device(_p_device, _p_device_context);
+        _geometry.release(geometry_device);
+        _p_compact_vertex_buffer->Release();
+        _p_compact_index_buffer->Release();
+        _p_culled_index_buffer->Release();
+        if (_p_instance_buffer) {
+            _p_instance_buffer->Release();
+            _p_instance_srv->Release();
+            _p_visible_instance_buffer->Release();
+        }
+        _p_compact_sphere_vert_buffer->Release();
+        _p_compact_sphere_index_buffer->Release();
+        _p_decode_cbuffer->Release();
+        _p_env_decode_cbuffer->Release();
 
         _p_input_layout->Release();
+        _p_input_layout_compact->Release();
+        _p_vs_compact_blob->Release();
+        _p_input_layout_instanced->Release();
+        _p_vs_instanced_blob->Release();
 
         _p_min_mag_mip_linear->Release();
         _p_min_mag_linear_mip_point_border->Release();
@@ -841,26 +1785,36 @@ namespace rendering {
         _p_smrv_preintegrated->Release();
 
         _p_vertex_shader->Release();
+        _p_vertex_shader_compact->Release();
+        _p_vertex_shader_instanced->Release();
         _p_vertex_shader_copy->Release();
         _p_skymap_vs->Release();
+        _p_skymap_vs_compact->Release();
 
         _p_pixel_shader_lambert->Release();
         _p_pixel_shader_pbr->Release();
         _p_pixel_shader_ndf->Release();
         _p_pixel_shader_geometry->Release();
         _p_pixel_shader_fresnel->Release();
+        _p_pixel_shader_pbr_instanced->Release();
+        _p_pixel_shader_ndf_instanced->Release();
+        _p_pixel_shader_geometry_instanced->Release();
+        _p_pixel_shader_fresnel_instanced->Release();
 
         _p_pixel_shader_cube_map->Release();
         _p_pixel_shader_irradiance_map->Release();
         _p_pixel_shader_prefiltered_color->Release();
         _p_pixel_shader_preintegrated_brdf->Release();
         _p_pixel_shader_copy->Release();
+        _p_pixel_shader_copy_scaled->Release();
+        _p_pixel_shader_temporal_resolve->Release();
         _p_pixel_shader_log_luminance->Release();
         _p_pixel_shader_tone_mapping->Release();
         _p_skymap_ps->Release();
 
         _p_depth_stencil->Release();
         _p_depth_stencil_view->Release();
+        _p_depth_shader_resource_view->Release();
         _p_ds_less_equal->Release();
 
         _p_render_target_view->Release();
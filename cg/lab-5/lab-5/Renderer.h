@@ -3,14 +3,29 @@
 #include <d3d11.h>
 #include <d3d11_1.h>
 
+#include <filesystem>
 #include <vector>
 
 #include "RenderTexture/RenderTexture.h"
 
+#include "Geometry/GeometryRegistry.h"
+#include "Geometry/LodChain.h"
+#include "Geometry/MeshCache.h"
+#include "Geometry/Meshlets.h"
+
 #include "ConstantBuffer.h"
 #include "Camera.h"
+#include "DrawQueue.h"
+#include "InputJournal.h"
+#include "MaterialGrid.h"
+#include "Scene/Bvh.h"
+#include "Scene/LightClusters.h"
+#include "Scene/OcclusionCulling.h"
+#include "Scene/TransformHierarchy.h"
 #include "PointLight.h"
 #include "RenderModes.h"
+#include "ResolutionGovernor.h"
+#include "TemporalUpsampling.h"
 #include "WorldBorders.h"
 
 namespace rendering {
@@ -22,9 +37,46 @@ namespace rendering {
         void handleMouse(int dx, int dy);
         void resize(size_t width, size_t height);
 
+        // Either one has to be called before the first frame, the journal assumes the initial scene
+        void startRecording(const std::filesystem::path& path);
+        bool startReplay(const std::filesystem::path& path);
+
         ~Renderer();
 
     private:
+        // Scene draws are submitted in the order of their DrawQueue keys
+        enum class ScenePass {
+            OBJECTS,
+            // After the objects, so that depth testing rejects most of it
+            SKY
+        };
+
+        enum class SceneDrawKind {
+            SPHERE,
+            MATERIAL_GRID,
+            // A registry mesh, always drawn from the arena
+            SHAPE,
+            SKY
+        };
+
+        static const UINT _s_SCENE_DRAW_RESOURCES = 3;
+
+        // What a scene draw binds, its kind decides the geometry and the draw call
+        struct SceneDraw {
+            SceneDrawKind _kind;
+            ID3D11VertexShader* _p_vertex_shader;
+            ID3D11PixelShader* _p_pixel_shader;
+            // Pixel shader slots from 0, null ones are unbound
+            ID3D11ShaderResourceView* _p_resources[_s_SCENE_DRAW_RESOURCES];
+            // Where the surface reads its material from, null if it has none
+            const void* _p_material;
+            DirectX::XMFLOAT4X4 _world;
+            // Inverse transpose of _world, for normals
+            DirectX::XMFLOAT4X4 _normal;
+            // Only for SHAPE
+            geometry::MeshHandle _mesh;
+        };
+
         void initWindow(HINSTANCE h_instance, WNDPROC window_proc, int n_cmd_show);
         void initResources();
         void initDevice();
@@ -37,6 +89,22 @@ namespace rendering {
         void createPreintegratedBRDF(UINT size);
 
         void resizeResources(size_t width, size_t height);
+        void resizeBuffers(size_t width, size_t height);
+
+        void handleInput(const InputEvent& event);
+        void applyInput(const InputEvent& event);
+        void setParameter(InputParameter parameter, float value);
+        void changeParameter(InputParameter parameter, float value);
+        void recordParameters();
+
+        void pushSceneDraw(const SceneDraw& draw, ScenePass pass, float depth);
+        void bindSceneGeometry(bool meshlet_culling);
+        void bindSkyGeometry();
+        void bindArenaGeometry();
+        void renderMaterialGrid(DirectX::FXMMATRIX view_projection, float viewport_height);
+        void cullOccludedInstances(DirectX::FXMMATRIX view_projection);
+        void updateLightClusters();
+        void renderTemporalResolve(const DirectX::XMFLOAT2& uv_scale, const DirectX::XMFLOAT2& jitter_uv);
 
         HWND _hwnd;
 
@@ -47,17 +115,26 @@ namespace rendering {
 
         ID3D11Texture2D* _p_depth_stencil = nullptr;
         ID3D11DepthStencilView* _p_depth_stencil_view = nullptr;
+        ID3D11ShaderResourceView* _p_depth_shader_resource_view = nullptr;
         ID3D11DepthStencilState* _p_ds_less_equal = nullptr;
 
         ID3DBlob* _p_vs_blob = nullptr;
 
         ID3D11VertexShader* _p_vertex_shader = nullptr;
+        ID3DBlob* _p_vs_compact_blob = nullptr;
+        ID3D11VertexShader* _p_vertex_shader_compact = nullptr;
+        ID3DBlob* _p_vs_instanced_blob = nullptr;
+        ID3D11VertexShader* _p_vertex_shader_instanced = nullptr;
 
         ID3D11PixelShader* _p_pixel_shader_lambert = nullptr;
         ID3D11PixelShader* _p_pixel_shader_pbr = nullptr;
         ID3D11PixelShader* _p_pixel_shader_ndf = nullptr;
         ID3D11PixelShader* _p_pixel_shader_geometry = nullptr;
         ID3D11PixelShader* _p_pixel_shader_fresnel = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_pbr_instanced = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_ndf_instanced = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_geometry_instanced = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_fresnel_instanced = nullptr;
 
         ID3D11VertexShader* _p_vertex_shader_copy = nullptr;
         ID3D11PixelShader* _p_pixel_shader_cube_map = nullptr;
@@ -65,24 +142,40 @@ namespace rendering {
         ID3D11PixelShader* _p_pixel_shader_prefiltered_color = nullptr;
         ID3D11PixelShader* _p_pixel_shader_preintegrated_brdf = nullptr;
         ID3D11PixelShader* _p_pixel_shader_copy = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_copy_scaled = nullptr;
+        ID3D11PixelShader* _p_pixel_shader_temporal_resolve = nullptr;
         ID3D11PixelShader* _p_pixel_shader_log_luminance = nullptr;
         ID3D11PixelShader* _p_pixel_shader_tone_mapping = nullptr;
 
         ID3D11VertexShader* _p_skymap_vs = nullptr;
+        ID3D11VertexShader* _p_skymap_vs_compact = nullptr;
         ID3D11PixelShader* _p_skymap_ps = nullptr;
 
         ID3D11InputLayout* _p_input_layout = nullptr;
+        ID3D11InputLayout* _p_input_layout_compact = nullptr;
+        ID3D11InputLayout* _p_input_layout_instanced = nullptr;
 
         static const size_t _s_RENDER_MODES_NUMBER = 4;
         const char* _render_modes[_s_RENDER_MODES_NUMBER] = { "PBR", "NDF", "Geometry", "Fresnel" };
         RenderModes _render_mode = RenderModes::PBR;
 
 
-        DirectX::XMMATRIX _world = DirectX::XMMatrixIdentity();
         DirectX::XMMATRIX _view = DirectX::XMMatrixIdentity();
         DirectX::XMMATRIX _projection = DirectX::XMMatrixIdentity();
-        DirectX::XMMATRIX _translation = DirectX::XMMatrixIdentity();
-        DirectX::XMMATRIX _sphere_world = DirectX::XMMatrixIdentity();
+        // World matrices of the scene, the sky follows the camera
+        scene::TransformHierarchy _transforms;
+        scene::TransformHandle _sphere_transform = scene::NO_TRANSFORM;
+        scene::TransformHandle _sky_transform = scene::NO_TRANSFORM;
+        scene::TransformHandle _torus_transform = scene::NO_TRANSFORM;
+        scene::TransformHandle _capsule_transform = scene::NO_TRANSFORM;
+
+        // Rebuilt every frame, the queue sorts indices into _scene_draws
+        std::vector<SceneDraw> _scene_draws;
+        DrawQueue _draw_queue;
+        // Key fields of the scene draws, kept over frames so the same state always gets the same id
+        DrawStateIds _shader_ids = DrawStateIds(DRAW_KEY_SHADER_BITS);
+        DrawStateIds _material_ids = DrawStateIds(DRAW_KEY_MATERIAL_BITS);
+        DrawStateIds _resource_ids = DrawStateIds(DRAW_KEY_RESOURCE_BITS);
 
         WorldBorders _borders;
         Camera _camera;
@@ -96,19 +189,127 @@ namespace rendering {
 
         UINT _vertex_stride;
         UINT _vertex_offset;
-        UINT _indices_number;
+        static constexpr float _s_NEAR_Z = 0.01f;
+        static constexpr float _s_FAR_Z = 100.0f;
+
+        // All static SimpleVertex geometry in one vertex and one index buffer
+        geometry::GeometryRegistry _geometry;
+        geometry::MeshHandle _sphere_mesh;
+        geometry::MeshHandle _env_mesh;
+        geometry::MeshHandle _cube_faces_mesh;
+        geometry::MeshHandle _quad_mesh;
+        // A torus and a capsule on both sides of the sphere, generated straight into the arena
+        geometry::MeshHandle _torus_mesh;
+        geometry::MeshHandle _capsule_mesh;
+        bool _shapes_enabled = false;
+
+        // The chain is read from the mapped cache when it is valid and only built into _sphere_lod_chain when it is not.
+        // The cache stays mapped for as long as the view points into it, the registry uploads the chain from there
+        geometry::MeshCacheFile _sphere_cache;
+        geometry::LodChain _sphere_lod_chain;
+        geometry::LodChainView _sphere_lod;
+        size_t _sphere_lod_level = 0;
+        // Largest projected geometric error in pixels a LOD may have
+        float _lod_threshold = 1.0f;
+
+        // One meshlet set per sphere LOD. Culled meshlets are written into one index buffer every frame
+        std::vector<geometry::MeshletMesh> _sphere_meshlets;
+        bool _meshlet_culling = false;
+        std::vector<unsigned> _culled_indices;
+        geometry::MeshletCullStats _meshlet_stats;
+
+        // Roughness and metalness sweep of the sphere in one instanced draw. The instance buffers only grow,
+        // the instances are packed again when the grid changes and the visible ones are culled every frame
+        MaterialGrid _material_grid;
+        bool _material_grid_enabled = false;
+        int _material_grid_size = 10;
+        bool _frustum_culling = true;
+        bool _visible_instances_culled = false;
+        std::vector<uint32_t> _visible_instances;
+        // Visible spheres by LOD, one instanced draw per level. Rebuilt every frame because the camera decides them
+        LodInstanceGroups _visible_lod_groups;
+        std::vector<uint32_t> _previous_lod_instances;
+        // Over the sphere boxes, refit when only the radius changes. Finds the sphere under the screen center
+        scene::Bvh _material_grid_bvh;
+        std::vector<scene::Aabb> _material_grid_boxes;
+        uint32_t _picked_instance = ~0u;
+        // Removes the spheres hidden behind the closest ones from the visible list, after frustum culling
+        static const size_t _s_OCCLUDER_COUNT = 16;
+        static const size_t _s_OCCLUDER_N_THETA = 8;
+        static const size_t _s_OCCLUDER_N_PHI = 12;
+        static const size_t _s_OCCLUSION_TEST_BLOCK_SIZE = 4096;
+        bool _occlusion_culling = false;
+        scene::OcclusionBuffer _occlusion_buffer;
+        std::vector<DirectX::XMFLOAT3> _occluder_positions;
+        std::vector<unsigned> _occluder_indices;
+        std::vector<uint32_t> _occluders;
+        std::vector<uint8_t> _occlusion_results;
+        size_t _occluded_instances = 0;
+        float _occlusion_time = 0.0f;
+        ID3D11Buffer* _p_instance_buffer = nullptr;
+        ID3D11ShaderResourceView* _p_instance_srv = nullptr;
+        ID3D11Buffer* _p_visible_instance_buffer = nullptr;
+        UINT _instance_capacity = 0;
+        // Fill lights scattered over the scene on top of _lights, only shaded by the lights of their view space cluster
+        static const int _s_MAX_FILL_LIGHTS = 16384;
+        static constexpr float _s_FILL_LIGHT_ATTENUATION = 20.0f;
+        // Radiance below which a fill light is cut off, decides its range
+        static constexpr float _s_FILL_LIGHT_CUTOFF = 0.01f;
+        int _fill_light_count = 0;
+        std::vector<PointLight> _fill_lights;
+        std::vector<scene::ClusterLight> _fill_light_bounds;
+        std::vector<ClusteredLight> _clustered_lights;
+        scene::LightClusters _light_clusters;
+        float _light_assignment_time = 0.0f;
+        ID3D11Buffer* _p_cluster_cbuffer = nullptr;
+        ID3D11Buffer* _p_clustered_light_buffer = nullptr;
+        ID3D11ShaderResourceView* _p_clustered_light_srv = nullptr;
+        UINT _clustered_light_capacity = 0;
+        ID3D11Buffer* _p_cluster_range_buffer = nullptr;
+        ID3D11ShaderResourceView* _p_cluster_range_srv = nullptr;
+        UINT _cluster_range_capacity = 0;
+        ID3D11Buffer* _p_cluster_index_buffer = nullptr;
+        ID3D11ShaderResourceView* _p_cluster_index_srv = nullptr;
+        UINT _cluster_index_capacity = 0;
+
         UINT _env_indices_number;
 
+        bool _compact_vertices = true;
+        UINT _compact_vertex_stride;
+        DXGI_FORMAT _compact_index_format;
+        DXGI_FORMAT _env_compact_index_format;
+
         float _adapted_log_luminance = 0.0f;
 
-        ID3D11Buffer* _p_vertex_buffer = nullptr;
-        ID3D11Buffer* _p_index_buffer = nullptr;
-        ID3D11Buffer* _p_sphere_index_buffer = nullptr;
-        ID3D11Buffer* _p_sphere_vert_buffer = nullptr;
+        ResolutionGovernor _resolution_governor;
+        bool _dynamic_resolution = false;
+        float _render_scale = 1.0f;
+
+        bool _temporal_upsampling = false;
+        bool _history_valid = false;
+        unsigned _jitter_index = 0;
+        size_t _history_index = 0;
+        DirectX::XMMATRIX _prev_view_projection = DirectX::XMMatrixIdentity();
+
+        InputJournal _input_journal;
+        std::filesystem::path _journal_path;
+        bool _recording = false;
+        InputReplay _input_replay;
+        bool _replaying = false;
+        float _replay_render_time = 0.0f;
+
+        ID3D11Buffer* _p_compact_vertex_buffer = nullptr;
+        ID3D11Buffer* _p_compact_index_buffer = nullptr;
+        ID3D11Buffer* _p_culled_index_buffer = nullptr;
+        ID3D11Buffer* _p_compact_sphere_vert_buffer = nullptr;
+        ID3D11Buffer* _p_compact_sphere_index_buffer = nullptr;
+        ID3D11Buffer* _p_decode_cbuffer = nullptr;
+        ID3D11Buffer* _p_env_decode_cbuffer = nullptr;
         ID3D11Buffer* _p_geometry_cbuffer = nullptr;
         ID3D11Buffer* _p_sprops_cbuffer = nullptr;
         ID3D11Buffer* _p_lights_cbuffer = nullptr;
         ID3D11Buffer* _p_adaptation_cbuffer = nullptr;
+        ID3D11Buffer* _p_temporal_cbuffer = nullptr;
 
         ID3D11SamplerState* _p_min_mag_mip_linear = nullptr;
         ID3D11SamplerState* _p_min_mag_linear_mip_point_border = nullptr;
@@ -119,6 +320,7 @@ namespace rendering {
 
         DX::RenderTexture _render_texture;
         DX::RenderTexture _square_copy;
+        DX::RenderTexture _history_textures[2];
         std::vector<DX::RenderTexture> _log_luminance_textures;
 
         ID3D11Texture2D* _average_log_luminance_texture = nullptr;
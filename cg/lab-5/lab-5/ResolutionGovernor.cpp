@@ -0,0 +1,71 @@
+#include "ResolutionGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rendering {
+    ResolutionGovernor::ResolutionGovernor(float budget_ms, float min_scale, float max_scale)
+        : _budget_ms(budget_ms), _min_scale(min_scale), _max_scale(max_scale), _area(max_scale * max_scale), _scale(max_scale) {}
+
+    float ResolutionGovernor::update(float frame_time_ms) {
+        if (_has_samples) {
+            _filtered_ms += (frame_time_ms - _filtered_ms) * _s_SMOOTHING;
+        } else {
+            _filtered_ms = frame_time_ms;
+            _has_samples = true;
+        }
+
+        // Relative headroom: positive when we are under budget and can afford more pixels.
+        // The target sits one deadband below the budget so the settled frame time stays within it.
+        const float target_ms = _budget_ms * (1.0f - _s_DEADBAND);
+        // The deadband is cut out of the error rather than zeroed, otherwise the step from the band edge to zero
+        // hands the proportional term back as a kick in the other direction and the scale cycles around the edge.
+        const float raw_error = (target_ms - _filtered_ms) / _budget_ms;
+        const float error = copysignf(std::max(fabsf(raw_error) - _s_DEADBAND, 0.0f), raw_error);
+
+        const float min_area = _min_scale * _min_scale;
+        const float max_area = _max_scale * _max_scale;
+
+        // Velocity form: the area is adjusted incrementally, so the integral term acts on the error
+        // directly and there is no accumulated state to wind up while the scale is pinned at a limit.
+        float delta = _s_KP * (error - _previous_error) + _s_KI * error + _s_KD * (error - 2.0f * _previous_error + _pre_previous_error);
+        _pre_previous_error = _previous_error;
+        _previous_error = error;
+
+        _area = std::clamp(_area * (1.0f + delta), min_area, max_area);
+
+        // Quantize so that small corrections do not resize the viewport every frame. The scale only moves once the
+        // area has clearly left the current step, an area sitting on a rounding boundary would flip it every few frames.
+        const float area_scale = sqrtf(_area);
+        if (fabsf(area_scale - _scale) > _s_SCALE_HYSTERESIS * _s_SCALE_STEP) {
+            const float scale = roundf(area_scale / _s_SCALE_STEP) * _s_SCALE_STEP;
+            _scale = std::clamp(scale, _min_scale, _max_scale);
+        }
+        return _scale;
+    }
+
+    void ResolutionGovernor::reset() {
+        _filtered_ms = 0.0f;
+        _previous_error = 0.0f;
+        _pre_previous_error = 0.0f;
+        _area = _max_scale * _max_scale;
+        _scale = _max_scale;
+        _has_samples = false;
+    }
+
+    float ResolutionGovernor::getScale() const {
+        return _scale;
+    }
+
+    float ResolutionGovernor::getFilteredFrameTime() const {
+        return _filtered_ms;
+    }
+
+    float ResolutionGovernor::getBudget() const {
+        return _budget_ms;
+    }
+
+    void ResolutionGovernor::setBudget(float budget_ms) {
+        _budget_ms = std::max(budget_ms, 1.0f);
+    }
+}
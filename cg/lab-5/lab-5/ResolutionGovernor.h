@@ -0,0 +1,41 @@
+#pragma once
+
+namespace rendering {
+    // Picks the internal render scale from measured frame times. The controller
+    // works on the pixel area (scale squared), since the cost of the scene pass
+    // grows roughly linearly with the number of shaded pixels.
+    class ResolutionGovernor {
+    public:
+        ResolutionGovernor(float budget_ms = 16.0f, float min_scale = 0.5f, float max_scale = 1.0f);
+
+        float update(float frame_time_ms);
+        void reset();
+
+        float getScale() const;
+        float getFilteredFrameTime() const;
+
+        float getBudget() const;
+        void setBudget(float budget_ms);
+
+    private:
+        float _budget_ms;
+        float _min_scale;
+        float _max_scale;
+
+        static constexpr float _s_KP = 0.3f;
+        static constexpr float _s_KI = 0.04f;
+        static constexpr float _s_KD = 0.05f;
+        static constexpr float _s_SMOOTHING = 0.1f;
+        static constexpr float _s_DEADBAND = 0.05f;
+        static constexpr float _s_SCALE_STEP = 1.0f / 32.0f;
+        // Fraction of a step the area has to move past the current scale
+        static constexpr float _s_SCALE_HYSTERESIS = 0.75f;
+
+        float _filtered_ms = 0.0f;
+        float _previous_error = 0.0f;
+        float _pre_previous_error = 0.0f;
+        float _area = 1.0f;
+        float _scale = 1.0f;
+        bool _has_samples = false;
+    };
+}
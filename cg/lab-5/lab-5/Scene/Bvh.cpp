@@ -0,0 +1,674 @@
+#include "Bvh.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            // Set on stack entries whose box is inside the frustum, or that are a leaf slot of a 4-wide node
+            const uint32_t ENTRY_FLAG = 0x80000000u;
+
+            enum class Containment {
+                OUTSIDE,
+                INTERSECTING,
+                INSIDE
+            };
+
+            struct Bin {
+                Aabb _bounds;
+                size_t _count = 0;
+            };
+
+            float component(const XMFLOAT3& v, size_t axis) {
+                return (&v.x)[axis];
+            }
+
+            void grow(Aabb& box, const XMFLOAT3& min, const XMFLOAT3& max) {
+                box._min = XMFLOAT3(std::min(box._min.x, min.x), std::min(box._min.y, min.y), std::min(box._min.z, min.z));
+                box._max = XMFLOAT3(std::max(box._max.x, max.x), std::max(box._max.y, max.y), std::max(box._max.z, max.z));
+            }
+
+            void grow(Aabb& box, const Aabb& other) {
+                grow(box, other._min, other._max);
+            }
+
+            // Half the surface area, 0 for empty boxes
+            float getHalfArea(const XMFLOAT3& min, const XMFLOAT3& max) {
+                const float dx = max.x - min.x;
+                const float dy = max.y - min.y;
+                const float dz = max.z - min.z;
+                if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+                    return 0.0f;
+                }
+                return dx * dy + dy * dz + dz * dx;
+            }
+
+            float getHalfArea(const Aabb& box) {
+                return getHalfArea(box._min, box._max);
+            }
+
+            XMFLOAT3 getCentroid(const Aabb& box) {
+                return XMFLOAT3(0.5f * (box._min.x + box._max.x), 0.5f * (box._min.y + box._max.y), 0.5f * (box._min.z + box._max.z));
+            }
+
+            // The corner furthest along the plane normal decides whether the box is outside, the closest one
+            // whether it is inside. Distances are ((a x + b y) + c z) + d like in isSphereVisible
+            Containment classifyAabb(const FrustumPlanes& planes, const XMFLOAT3& min, const XMFLOAT3& max) {
+                Containment result = Containment::INSIDE;
+                for (size_t p = 0; p < 6; ++p) {
+                    const float a = planes._a[p];
+                    const float b = planes._b[p];
+                    const float c = planes._c[p];
+                    const float far_distance = a * (a >= 0.0f ? max.x : min.x) + b * (b >= 0.0f ? max.y : min.y)
+                        + c * (c >= 0.0f ? max.z : min.z) + planes._d[p];
+                    if (far_distance < 0.0f) {
+                        return Containment::OUTSIDE;
+                    }
+                    const float near_distance = a * (a >= 0.0f ? min.x : max.x) + b * (b >= 0.0f ? min.y : max.y)
+                        + c * (c >= 0.0f ? min.z : max.z) + planes._d[p];
+                    if (near_distance < 0.0f) {
+                        result = Containment::INTERSECTING;
+                    }
+                }
+                return result;
+            }
+
+            bool overlaps(const XMFLOAT3& min, const XMFLOAT3& max, const XMFLOAT3& center, float radius) {
+                const float dx = std::max(std::max(min.x - center.x, center.x - max.x), 0.0f);
+                const float dy = std::max(std::max(min.y - center.y, center.y - max.y), 0.0f);
+                const float dz = std::max(std::max(min.z - center.z, center.z - max.z), 0.0f);
+                return dx * dx + dy * dy + dz * dz <= radius * radius;
+            }
+
+            // Slab test, entry distance clamped to 0 or negative if the ray misses the box before t_max
+            float intersectSlabs(const XMFLOAT3& min, const XMFLOAT3& max, const XMFLOAT3& origin, const XMFLOAT3& inv_dir, float t_max) {
+                const float tx0 = (min.x - origin.x) * inv_dir.x;
+                const float tx1 = (max.x - origin.x) * inv_dir.x;
+                const float ty0 = (min.y - origin.y) * inv_dir.y;
+                const float ty1 = (max.y - origin.y) * inv_dir.y;
+                const float tz0 = (min.z - origin.z) * inv_dir.z;
+                const float tz1 = (max.z - origin.z) * inv_dir.z;
+                const float t_near = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+                const float t_far = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), t_max));
+                return t_near <= t_far ? t_near : -1.0f;
+            }
+
+            int getValidMask(const Bvh4Node& node) {
+                int mask = 0;
+                for (int k = 0; k < 4; ++k) {
+                    if (node._count[k] != BVH4_EMPTY) {
+                        mask |= 1 << k;
+                    }
+                }
+                return mask;
+            }
+        }
+
+        void getSphereBounds(const BoundingSpheres& spheres, std::vector<Aabb>& bounds) {
+            bounds.resize(spheres.size());
+            for (size_t i = 0; i < spheres.size(); ++i) {
+                const float r = spheres._radius[i];
+                bounds[i]._min = XMFLOAT3(spheres._x[i] - r, spheres._y[i] - r, spheres._z[i] - r);
+                bounds[i]._max = XMFLOAT3(spheres._x[i] + r, spheres._y[i] + r, spheres._z[i] + r);
+            }
+        }
+
+        bool isAabbVisible(const FrustumPlanes& planes, const Aabb& box) {
+            return classifyAabb(planes, box._min, box._max) != Containment::OUTSIDE;
+        }
+
+        bool overlapsAabb(const Aabb& box, const XMFLOAT3& center, float radius) {
+            return overlaps(box._min, box._max, center, radius);
+        }
+
+        Bvh::Bvh(const BvhOptions& options)
+            : _options(options) {
+            assert(_options._bin_count >= 2 && _options._max_leaf_size >= 1);
+        }
+
+        void Bvh::build(const std::vector<Aabb>& bounds) {
+            buildNodes(bounds);
+            _cost = computeSahCost();
+            _build_cost = _cost;
+            if (_options._wide) {
+                buildWideNodes();
+            }
+        }
+
+        bool Bvh::refit(const std::vector<Aabb>& bounds) {
+            assert(bounds.size() == _objects.size());
+            refitNodes(bounds);
+            _cost = computeSahCost();
+            if (_cost > _build_cost * _options._rebuild_ratio) {
+                build(bounds);
+                ++_rebuilds;
+                return true;
+            }
+            if (_options._wide) {
+                buildWideNodes();
+            }
+            return false;
+        }
+
+        void Bvh::buildNodes(const std::vector<Aabb>& bounds) {
+            const size_t count = bounds.size();
+            _nodes.clear();
+            _objects.resize(count);
+            std::iota(_objects.begin(), _objects.end(), 0u);
+            _object_bounds.resize(count);
+            if (count == 0) {
+                return;
+            }
+
+            std::vector<XMFLOAT3> centroids(count);
+            for (size_t i = 0; i < count; ++i) {
+                centroids[i] = getCentroid(bounds[i]);
+            }
+
+            struct Task {
+                uint32_t _node;
+                size_t _begin;
+                size_t _end;
+                size_t _depth;
+            };
+            const size_t bin_count = _options._bin_count;
+            std::vector<Bin> bins(bin_count);
+            std::vector<float> right_area(bin_count);
+            std::vector<size_t> right_count(bin_count);
+
+            _nodes.reserve(2 * count);
+            _nodes.push_back(BvhNode());
+            std::vector<Task> tasks = { { 0, 0, count, 0 } };
+            while (!tasks.empty()) {
+                const Task task = tasks.back();
+                tasks.pop_back();
+
+                Aabb box, centroid_box;
+                for (size_t k = task._begin; k < task._end; ++k) {
+                    grow(box, bounds[_objects[k]]);
+                    grow(centroid_box, centroids[_objects[k]], centroids[_objects[k]]);
+                }
+                _nodes[task._node]._min = box._min;
+                _nodes[task._node]._max = box._max;
+
+                const size_t n = task._end - task._begin;
+                if (n <= _options._max_leaf_size) {
+                    _nodes[task._node]._first = (uint32_t)task._begin;
+                    _nodes[task._node]._count = (uint32_t)n;
+                    continue;
+                }
+
+                // Binned SAH, the split between bins with the lowest area weighted object count on either side
+                size_t best_axis = 3;
+                size_t best_split = 0;
+                float best_cost = INFINITY;
+                if (task._depth < _s_MAX_DEPTH) {
+                    for (size_t axis = 0; axis < 3; ++axis) {
+                        const float axis_min = component(centroid_box._min, axis);
+                        const float extent = component(centroid_box._max, axis) - axis_min;
+                        if (!(extent > 0.0f)) {
+                            continue;
+                        }
+                        const float scale = bin_count / extent;
+                        std::fill(bins.begin(), bins.end(), Bin());
+                        for (size_t k = task._begin; k < task._end; ++k) {
+                            size_t bin = std::min(bin_count - 1, (size_t)((component(centroids[_objects[k]], axis) - axis_min) * scale));
+                            grow(bins[bin]._bounds, bounds[_objects[k]]);
+                            ++bins[bin]._count;
+                        }
+
+                        Aabb right;
+                        size_t right_objects = 0;
+                        for (size_t bin = bin_count - 1; bin > 0; --bin) {
+                            grow(right, bins[bin]._bounds);
+                            right_objects += bins[bin]._count;
+                            right_area[bin] = getHalfArea(right);
+                            right_count[bin] = right_objects;
+                        }
+                        Aabb left;
+                        size_t left_objects = 0;
+                        for (size_t split = 1; split < bin_count; ++split) {
+                            grow(left, bins[split - 1]._bounds);
+                            left_objects += bins[split - 1]._count;
+                            if (left_objects == 0 || right_count[split] == 0) {
+                                continue;
+                            }
+                            float cost = getHalfArea(left) * left_objects + right_area[split] * right_count[split];
+                            if (cost < best_cost) {
+                                best_cost = cost;
+                                best_axis = axis;
+                                best_split = split;
+                            }
+                        }
+                    }
+                }
+
+                size_t middle;
+                if (best_axis < 3) {
+                    const size_t axis = best_axis;
+                    const float axis_min = component(centroid_box._min, axis);
+                    const float scale = bin_count / (component(centroid_box._max, axis) - axis_min);
+                    middle = std::partition(_objects.begin() + task._begin, _objects.begin() + task._end, [&](uint32_t object) {
+                        return std::min(bin_count - 1, (size_t)((component(centroids[object], axis) - axis_min) * scale)) < best_split;
+                    }) - _objects.begin();
+                }
+                else {
+                    // Too deep or all centroids in one place, the median along the longest axis keeps the tree balanced
+                    const XMFLOAT3 extent(centroid_box._max.x - centroid_box._min.x, centroid_box._max.y - centroid_box._min.y,
+                        centroid_box._max.z - centroid_box._min.z);
+                    const size_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+                    middle = task._begin + n / 2;
+                    std::nth_element(_objects.begin() + task._begin, _objects.begin() + middle, _objects.begin() + task._end,
+                        [&](uint32_t a, uint32_t b) { return component(centroids[a], axis) < component(centroids[b], axis); });
+                }
+
+                const uint32_t left = (uint32_t)_nodes.size();
+                _nodes.push_back(BvhNode());
+                _nodes.push_back(BvhNode());
+                _nodes[task._node]._first = left;
+                _nodes[task._node]._count = 0;
+                tasks.push_back({ left + 1, middle, task._end, task._depth + 1 });
+                tasks.push_back({ left, task._begin, middle, task._depth + 1 });
+            }
+
+            for (size_t k = 0; k < count; ++k) {
+                _object_bounds[k] = bounds[_objects[k]];
+            }
+        }
+
+        // Children always come after their parent, so going backwards updates them first
+        void Bvh::refitNodes(const std::vector<Aabb>& bounds) {
+            for (size_t k = 0; k < _objects.size(); ++k) {
+                _object_bounds[k] = bounds[_objects[k]];
+            }
+            for (size_t i = _nodes.size(); i-- > 0;) {
+                BvhNode& node = _nodes[i];
+                Aabb box;
+                if (node._count > 0) {
+                    for (uint32_t k = node._first; k < node._first + node._count; ++k) {
+                        grow(box, _object_bounds[k]);
+                    }
+                }
+                else {
+                    grow(box, _nodes[node._first]._min, _nodes[node._first]._max);
+                    grow(box, _nodes[node._first + 1]._min, _nodes[node._first + 1]._max);
+                }
+                node._min = box._min;
+                node._max = box._max;
+            }
+        }
+
+        // Every 4-wide node takes the place of a binary node and keeps opening its largest inner child until it
+        // has four children
+        void Bvh::buildWideNodes() {
+            _wide_nodes.clear();
+            if (_nodes.empty()) {
+                return;
+            }
+            _wide_nodes.reserve(_nodes.size() / 2 + 1);
+            _wide_nodes.push_back(Bvh4Node());
+            std::vector<std::pair<uint32_t, uint32_t>> tasks = { { 0u, 0u } };
+            while (!tasks.empty()) {
+                const uint32_t binary = tasks.back().first;
+                const uint32_t wide = tasks.back().second;
+                tasks.pop_back();
+
+                uint32_t children[4];
+                size_t child_count = 0;
+                if (_nodes[binary]._count > 0) {
+                    children[child_count++] = binary;
+                }
+                else {
+                    children[child_count++] = _nodes[binary]._first;
+                    children[child_count++] = _nodes[binary]._first + 1;
+                    while (child_count < 4) {
+                        size_t largest = 4;
+                        float largest_area = -1.0f;
+                        for (size_t k = 0; k < child_count; ++k) {
+                            const BvhNode& child = _nodes[children[k]];
+                            float area = getHalfArea(child._min, child._max);
+                            if (child._count == 0 && area > largest_area) {
+                                largest = k;
+                                largest_area = area;
+                            }
+                        }
+                        if (largest == 4) {
+                            break;
+                        }
+                        const uint32_t first = _nodes[children[largest]]._first;
+                        children[largest] = first;
+                        children[child_count++] = first + 1;
+                    }
+                }
+
+                for (size_t k = 0; k < 4; ++k) {
+                    uint32_t child = 0;
+                    uint32_t count = BVH4_EMPTY;
+                    XMFLOAT3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+                    XMFLOAT3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+                    if (k < child_count) {
+                        const BvhNode& node = _nodes[children[k]];
+                        min = node._min;
+                        max = node._max;
+                        count = node._count;
+                        if (count > 0) {
+                            child = node._first;
+                        }
+                        else {
+                            child = (uint32_t)_wide_nodes.size();
+                            _wide_nodes.push_back(Bvh4Node());
+                            tasks.push_back({ children[k], child });
+                        }
+                    }
+                    Bvh4Node& node = _wide_nodes[wide];
+                    node._min_x[k] = min.x;
+                    node._min_y[k] = min.y;
+                    node._min_z[k] = min.z;
+                    node._max_x[k] = max.x;
+                    node._max_y[k] = max.y;
+                    node._max_z[k] = max.z;
+                    node._child[k] = child;
+                    node._count[k] = count;
+                }
+            }
+        }
+
+        float Bvh::computeSahCost() const {
+            if (_nodes.empty()) {
+                return 0.0f;
+            }
+            const float root_area = getHalfArea(_nodes[0]._min, _nodes[0]._max);
+            if (!(root_area > 0.0f)) {
+                return 0.0f;
+            }
+            float cost = 0.0f;
+            for (const BvhNode& node : _nodes) {
+                cost += getHalfArea(node._min, node._max) * (node._count > 0 ? node._count : 1);
+            }
+            return cost / root_area;
+        }
+
+        void Bvh::queryFrustum(const FrustumPlanes& planes, std::vector<uint32_t>& objects) const {
+            objects.clear();
+            if (_nodes.empty()) {
+                return;
+            }
+            uint32_t stack[_s_STACK_SIZE];
+            size_t size = 0;
+            stack[size++] = 0;
+
+            if (!_options._wide) {
+                while (size > 0) {
+                    const uint32_t entry = stack[--size];
+                    const BvhNode& node = _nodes[entry & ~ENTRY_FLAG];
+                    uint32_t inside = entry & ENTRY_FLAG;
+                    if (!inside) {
+                        Containment containment = classifyAabb(planes, node._min, node._max);
+                        if (containment == Containment::OUTSIDE) {
+                            continue;
+                        }
+                        inside = containment == Containment::INSIDE ? ENTRY_FLAG : 0;
+                    }
+                    if (node._count > 0) {
+                        for (uint32_t k = node._first; k < node._first + node._count; ++k) {
+                            if (inside || isAabbVisible(planes, _object_bounds[k])) {
+                                objects.push_back(_objects[k]);
+                            }
+                        }
+                    }
+                    else {
+                        stack[size++] = (node._first + 1) | inside;
+                        stack[size++] = node._first | inside;
+                    }
+                }
+                return;
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            while (size > 0) {
+                const uint32_t entry = stack[--size];
+                const Bvh4Node& node = _wide_nodes[entry & ~ENTRY_FLAG];
+                const int valid = getValidMask(node);
+                int visible = valid;
+                int inside = valid;
+                if (!(entry & ENTRY_FLAG)) {
+                    __m128 outside = _mm_setzero_ps();
+                    __m128 contained = _mm_cmpeq_ps(zero, zero);
+                    for (size_t p = 0; p < 6; ++p) {
+                        const float a = planes._a[p];
+                        const float b = planes._b[p];
+                        const float c = planes._c[p];
+                        const __m128 va = _mm_set1_ps(a);
+                        const __m128 vb = _mm_set1_ps(b);
+                        const __m128 vc = _mm_set1_ps(c);
+                        const __m128 vd = _mm_set1_ps(planes._d[p]);
+                        const __m128 far_distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                            _mm_mul_ps(va, _mm_loadu_ps(a >= 0.0f ? node._max_x : node._min_x)),
+                            _mm_mul_ps(vb, _mm_loadu_ps(b >= 0.0f ? node._max_y : node._min_y))),
+                            _mm_mul_ps(vc, _mm_loadu_ps(c >= 0.0f ? node._max_z : node._min_z))), vd);
+                        const __m128 near_distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                            _mm_mul_ps(va, _mm_loadu_ps(a >= 0.0f ? node._min_x : node._max_x)),
+                            _mm_mul_ps(vb, _mm_loadu_ps(b >= 0.0f ? node._min_y : node._max_y))),
+                            _mm_mul_ps(vc, _mm_loadu_ps(c >= 0.0f ? node._min_z : node._max_z))), vd);
+                        outside = _mm_or_ps(outside, _mm_cmplt_ps(far_distance, zero));
+                        contained = _mm_and_ps(contained, _mm_cmpge_ps(near_distance, zero));
+                    }
+                    visible = valid & ~_mm_movemask_ps(outside);
+                    inside = visible & _mm_movemask_ps(contained);
+                }
+                for (int k = 0; k < 4; ++k) {
+                    if (!(visible & (1 << k))) {
+                        continue;
+                    }
+                    const bool child_inside = (inside & (1 << k)) != 0;
+                    if (node._count[k] > 0) {
+                        for (uint32_t i = node._child[k]; i < node._child[k] + node._count[k]; ++i) {
+                            if (child_inside || isAabbVisible(planes, _object_bounds[i])) {
+                                objects.push_back(_objects[i]);
+                            }
+                        }
+                    }
+                    else {
+                        stack[size++] = node._child[k] | (child_inside ? ENTRY_FLAG : 0);
+                    }
+                }
+            }
+        }
+
+        void Bvh::querySphere(const XMFLOAT3& center, float radius, std::vector<uint32_t>& objects) const {
+            objects.clear();
+            if (_nodes.empty()) {
+                return;
+            }
+            uint32_t stack[_s_STACK_SIZE];
+            size_t size = 0;
+            stack[size++] = 0;
+
+            if (!_options._wide) {
+                while (size > 0) {
+                    const BvhNode& node = _nodes[stack[--size]];
+                    if (!overlaps(node._min, node._max, center, radius)) {
+                        continue;
+                    }
+                    if (node._count > 0) {
+                        for (uint32_t k = node._first; k < node._first + node._count; ++k) {
+                            if (overlapsAabb(_object_bounds[k], center, radius)) {
+                                objects.push_back(_objects[k]);
+                            }
+                        }
+                    }
+                    else {
+                        stack[size++] = node._first + 1;
+                        stack[size++] = node._first;
+                    }
+                }
+                return;
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 cx = _mm_set1_ps(center.x);
+            const __m128 cy = _mm_set1_ps(center.y);
+            const __m128 cz = _mm_set1_ps(center.z);
+            const __m128 radius_squared = _mm_set1_ps(radius * radius);
+            while (size > 0) {
+                const Bvh4Node& node = _wide_nodes[stack[--size]];
+                const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node._min_x), cx), _mm_sub_ps(cx, _mm_loadu_ps(node._max_x))), zero);
+                const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node._min_y), cy), _mm_sub_ps(cy, _mm_loadu_ps(node._max_y))), zero);
+                const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node._min_z), cz), _mm_sub_ps(cz, _mm_loadu_ps(node._max_z))), zero);
+                const __m128 distance_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                const int hits = getValidMask(node) & _mm_movemask_ps(_mm_cmple_ps(distance_squared, radius_squared));
+                for (int k = 0; k < 4; ++k) {
+                    if (!(hits & (1 << k))) {
+                        continue;
+                    }
+                    if (node._count[k] > 0) {
+                        for (uint32_t i = node._child[k]; i < node._child[k] + node._count[k]; ++i) {
+                            if (overlapsAabb(_object_bounds[i], center, radius)) {
+                                objects.push_back(_objects[i]);
+                            }
+                        }
+                    }
+                    else {
+                        stack[size++] = node._child[k];
+                    }
+                }
+            }
+        }
+
+        Bvh::RayTraversal Bvh::startRay(FXMVECTOR origin, FXMVECTOR dir) const {
+            RayTraversal traversal;
+            XMStoreFloat3(&traversal._origin, origin);
+            XMFLOAT3 d;
+            XMStoreFloat3(&d, dir);
+            // A tiny component instead of 0 keeps the slab distances finite, and free of 0 * infinity
+            const float tiny = 1e-30f;
+            traversal._inv_dir = XMFLOAT3(1.0f / (std::fabs(d.x) > tiny ? d.x : std::copysign(tiny, d.x)),
+                1.0f / (std::fabs(d.y) > tiny ? d.y : std::copysign(tiny, d.y)),
+                1.0f / (std::fabs(d.z) > tiny ? d.z : std::copysign(tiny, d.z)));
+            if (!_nodes.empty()) {
+                float t = intersectSlabs(_nodes[0]._min, _nodes[0]._max, traversal._origin, traversal._inv_dir, INFINITY);
+                if (t >= 0.0f) {
+                    traversal._stack[0] = 0;
+                    traversal._stack_t[0] = t;
+                    traversal._size = 1;
+                }
+            }
+            return traversal;
+        }
+
+        bool Bvh::nextRayLeaf(RayTraversal& traversal, float t_max, uint32_t& first, uint32_t& count) const {
+            const XMFLOAT3& o = traversal._origin;
+            const XMFLOAT3& inv = traversal._inv_dir;
+            while (traversal._size > 0) {
+                --traversal._size;
+                const uint32_t entry = traversal._stack[traversal._size];
+                if (traversal._stack_t[traversal._size] > t_max) {
+                    continue;
+                }
+
+                if (!_options._wide) {
+                    const BvhNode& node = _nodes[entry];
+                    if (node._count > 0) {
+                        first = node._first;
+                        count = node._count;
+                        return true;
+                    }
+                    float t_left = intersectSlabs(_nodes[node._first]._min, _nodes[node._first]._max, o, inv, t_max);
+                    float t_right = intersectSlabs(_nodes[node._first + 1]._min, _nodes[node._first + 1]._max, o, inv, t_max);
+                    uint32_t near_child = node._first;
+                    uint32_t far_child = node._first + 1;
+                    if (t_right >= 0.0f && (t_left < 0.0f || t_right < t_left)) {
+                        std::swap(near_child, far_child);
+                        std::swap(t_left, t_right);
+                    }
+                    if (t_right >= 0.0f) {
+                        traversal._stack[traversal._size] = far_child;
+                        traversal._stack_t[traversal._size++] = t_right;
+                    }
+                    if (t_left >= 0.0f) {
+                        traversal._stack[traversal._size] = near_child;
+                        traversal._stack_t[traversal._size++] = t_left;
+                    }
+                    continue;
+                }
+
+                if (entry & ENTRY_FLAG) {
+                    const uint32_t slot = entry & ~ENTRY_FLAG;
+                    const Bvh4Node& node = _wide_nodes[slot >> 2];
+                    first = node._child[slot & 3];
+                    count = node._count[slot & 3];
+                    return true;
+                }
+
+                const Bvh4Node& node = _wide_nodes[entry];
+                const __m128 ox = _mm_set1_ps(o.x);
+                const __m128 oy = _mm_set1_ps(o.y);
+                const __m128 oz = _mm_set1_ps(o.z);
+                const __m128 ix = _mm_set1_ps(inv.x);
+                const __m128 iy = _mm_set1_ps(inv.y);
+                const __m128 iz = _mm_set1_ps(inv.z);
+                const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._min_x), ox), ix);
+                const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._max_x), ox), ix);
+                const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._min_y), oy), iy);
+                const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._max_y), oy), iy);
+                const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._min_z), oz), iz);
+                const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node._max_z), oz), iz);
+                const __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), _mm_setzero_ps()));
+                const __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(t_max)));
+                const int hits = getValidMask(node) & _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+                if (!hits) {
+                    continue;
+                }
+
+                // Hit children sorted far to near, so the nearest ends up on top of the stack
+                float t[4];
+                _mm_storeu_ps(t, t_near);
+                int order[4];
+                int hit_count = 0;
+                for (int k = 0; k < 4; ++k) {
+                    if (!(hits & (1 << k))) {
+                        continue;
+                    }
+                    int i = hit_count++;
+                    for (; i > 0 && t[order[i - 1]] < t[k]; --i) {
+                        order[i] = order[i - 1];
+                    }
+                    order[i] = k;
+                }
+                for (int i = 0; i < hit_count; ++i) {
+                    const int k = order[i];
+                    traversal._stack[traversal._size] = node._count[k] > 0 ? (entry * 4 + k) | ENTRY_FLAG : node._child[k];
+                    traversal._stack_t[traversal._size++] = t[k];
+                }
+            }
+            return false;
+        }
+
+        float Bvh::getSahCost() const {
+            return _cost;
+        }
+
+        size_t Bvh::getNodeCount() const {
+            return _options._wide ? _wide_nodes.size() : _nodes.size();
+        }
+
+        size_t Bvh::getRebuildCount() const {
+            return _rebuilds;
+        }
+
+        const std::vector<BvhNode>& Bvh::getNodes() const {
+            return _nodes;
+        }
+
+        const std::vector<Bvh4Node>& Bvh::getWideNodes() const {
+            return _wide_nodes;
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+namespace rendering {
+    namespace scene {
+        struct Aabb {
+            DirectX::XMFLOAT3 _min = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+            DirectX::XMFLOAT3 _max = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        };
+
+        void getSphereBounds(const BoundingSpheres& spheres, std::vector<Aabb>& bounds);
+
+        // A box is culled when it is completely behind one of the planes, the test the BVH applies to its nodes
+        bool isAabbVisible(const FrustumPlanes& planes, const Aabb& box);
+        bool overlapsAabb(const Aabb& box, const DirectX::XMFLOAT3& center, float radius);
+
+        // 32 bytes. Children of a node are next to each other, so a node only stores the first one
+        struct BvhNode {
+            DirectX::XMFLOAT3 _min;
+            // First child for inner nodes, first object of _objects for leaves
+            uint32_t _first;
+            DirectX::XMFLOAT3 _max;
+            // Objects in a leaf, 0 for inner nodes
+            uint32_t _count;
+        };
+
+        // 128 bytes, the bounds of the four children as structure of arrays for one SSE test each
+        struct Bvh4Node {
+            float _min_x[4];
+            float _min_y[4];
+            float _min_z[4];
+            float _max_x[4];
+            float _max_y[4];
+            float _max_z[4];
+            // Node index for inner children, first object for leaves
+            uint32_t _child[4];
+            // Objects in a leaf child, 0 for inner children, BVH4_EMPTY for unused slots
+            uint32_t _count[4];
+        };
+
+        const uint32_t BVH4_EMPTY = ~0u;
+
+        struct BvhOptions {
+            size_t _bin_count = 16;
+            size_t _max_leaf_size = 4;
+            // refit rebuilds once the SAH cost has grown by this factor since the last build
+            float _rebuild_ratio = 1.5f;
+            // Collapse the tree into 4-wide nodes and answer queries with them
+            bool _wide = false;
+        };
+
+        struct BvhRayHit {
+            uint32_t _object = ~0u;
+            float _t = -1.0f;
+        };
+
+        // Bounding volume hierarchy over object boxes. Objects that move keep their index, refit updates
+        // the boxes bottom-up and the tree is only built again when its quality has degraded
+        class Bvh {
+        public:
+            Bvh(const BvhOptions& options = BvhOptions());
+
+            // Binned SAH over the box centroids
+            void build(const std::vector<Aabb>& bounds);
+            // Same objects with new boxes. Returns true if it rebuilt the tree
+            bool refit(const std::vector<Aabb>& bounds);
+
+            // Indices of the objects whose boxes are not culled by the planes, in no particular order
+            void queryFrustum(const FrustumPlanes& planes, std::vector<uint32_t>& objects) const;
+            // Indices of the objects whose boxes overlap the sphere, in no particular order
+            void querySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<uint32_t>& objects) const;
+
+            // Closest hit. intersect(object, t_max) returns the distance to the object or a negative value if the ray
+            // misses it within t_max, so objects can be tested exactly after their box was hit
+            template <typename F>
+            BvhRayHit intersectRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float t_max, const F& intersect) const {
+                BvhRayHit hit;
+                hit._t = t_max;
+                RayTraversal traversal = startRay(origin, dir);
+                uint32_t first, count;
+                while (nextRayLeaf(traversal, hit._t, first, count)) {
+                    for (uint32_t k = first; k < first + count; ++k) {
+                        const uint32_t object = _objects[k];
+                        float t = intersect(object, hit._t);
+                        if (t >= 0.0f && t < hit._t) {
+                            hit._t = t;
+                            hit._object = object;
+                        }
+                    }
+                }
+                if (hit._object == ~0u) {
+                    hit._t = -1.0f;
+                }
+                return hit;
+            }
+
+            // Expected cost of a random ray relative to the root, with traversal and object tests costing 1 each
+            float getSahCost() const;
+            size_t getNodeCount() const;
+            size_t getRebuildCount() const;
+            const std::vector<BvhNode>& getNodes() const;
+            const std::vector<Bvh4Node>& getWideNodes() const;
+
+        private:
+            // Deeper ranges are split at the median, so no tree is deeper than 80 levels
+            static const size_t _s_MAX_DEPTH = 48;
+            // Every level of a 4-wide traversal leaves at most three siblings on the stack
+            static const size_t _s_STACK_SIZE = 256;
+
+            // Nodes still to visit with their entry distances, the closest child is on top
+            struct RayTraversal {
+                DirectX::XMFLOAT3 _origin;
+                DirectX::XMFLOAT3 _inv_dir;
+                uint32_t _stack[_s_STACK_SIZE];
+                float _stack_t[_s_STACK_SIZE];
+                size_t _size = 0;
+            };
+
+            RayTraversal startRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir) const;
+            // Visits nodes until it reaches a leaf whose box the ray enters before t_max, false when none is left
+            bool nextRayLeaf(RayTraversal& traversal, float t_max, uint32_t& first, uint32_t& count) const;
+
+            void buildNodes(const std::vector<Aabb>& bounds);
+            void refitNodes(const std::vector<Aabb>& bounds);
+            void buildWideNodes();
+            float computeSahCost() const;
+
+            BvhOptions _options;
+            std::vector<BvhNode> _nodes;
+            std::vector<Bvh4Node> _wide_nodes;
+            std::vector<uint32_t> _objects;
+            // Boxes of _objects, in the same order
+            std::vector<Aabb> _object_bounds;
+            float _build_cost = 0.0f;
+            float _cost = 0.0f;
+            size_t _rebuilds = 0;
+        };
+    }
+}
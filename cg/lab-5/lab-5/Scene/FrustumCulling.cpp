@@ -0,0 +1,113 @@
+#include "FrustumCulling.h"
+
+#include <cassert>
+#include <cstring>
+
+#include "FrustumCullingKernels.h"
+#include "../Geometry/Meshlets.h"
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            const size_t CULL_CHUNK_SIZE = 16384;
+
+            const SphereCullKernelInfo& getKernel(SimdLevel level) {
+                assert(software::isSimdLevelSupported(level));
+                switch (level) {
+                case SimdLevel::SSE4:
+                    return getSse4SphereCullKernel();
+                case SimdLevel::AVX2:
+                    return getAvx2SphereCullKernel();
+                case SimdLevel::AVX512:
+                    return getAvx512SphereCullKernel();
+                default:
+                    return getScalarSphereCullKernel();
+                }
+            }
+        }
+
+        size_t BoundingSpheres::size() const {
+            return _x.size();
+        }
+
+        void BoundingSpheres::resize(size_t count) {
+            _x.resize(count);
+            _y.resize(count);
+            _z.resize(count);
+            _radius.resize(count);
+        }
+
+        void BoundingSpheres::set(size_t i, const XMFLOAT3& center, float radius) {
+            _x[i] = center.x;
+            _y[i] = center.y;
+            _z[i] = center.z;
+            _radius[i] = radius;
+        }
+
+        FrustumPlanes makeFrustumPlanes(FXMMATRIX view_projection) {
+            XMVECTOR planes[6];
+            geometry::extractFrustumPlanes(view_projection, planes);
+            FrustumPlanes result;
+            for (size_t p = 0; p < 6; ++p) {
+                XMFLOAT4 plane;
+                XMStoreFloat4(&plane, planes[p]);
+                result._a[p] = plane.x;
+                result._b[p] = plane.y;
+                result._c[p] = plane.z;
+                result._d[p] = plane.w;
+            }
+            return result;
+        }
+
+        bool isSphereVisible(const FrustumPlanes& planes, const XMFLOAT3& center, float radius) {
+            for (size_t p = 0; p < 6; ++p) {
+                float distance = planes._a[p] * center.x + planes._b[p] * center.y + planes._c[p] * center.z + planes._d[p];
+                if (!(distance + radius >= 0.0f)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Full vectors go to the requested level, the remainder to the scalar kernel
+        size_t cullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out, SimdLevel level) {
+            assert(begin <= end && end <= spheres.size());
+            const SphereCullKernelInfo& kernel = getKernel(level);
+            const size_t vector_end = end - (end - begin) % kernel._width;
+            size_t count = 0;
+            if (vector_end > begin) {
+                count = kernel._cull(planes, spheres, begin, vector_end, out);
+            }
+            if (vector_end < end) {
+                count += getScalarSphereCullKernel()._cull(planes, spheres, vector_end, end, out + count);
+            }
+            return count;
+        }
+
+        void cullSpheresParallel(const FrustumPlanes& planes, const BoundingSpheres& spheres, std::vector<uint32_t>& visible, SimdLevel level) {
+            const size_t count = spheres.size();
+            const size_t chunk_count = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+            // Every chunk writes to its own range, which is never shorter than its result
+            visible.resize(count);
+            std::vector<size_t> chunk_visible(chunk_count);
+            software::parallelFor(chunk_count, [&](size_t chunk) {
+                const size_t begin = chunk * CULL_CHUNK_SIZE;
+                const size_t end = std::min(count, begin + CULL_CHUNK_SIZE);
+                chunk_visible[chunk] = cullSpheres(planes, spheres, begin, end, visible.data() + begin, level);
+            });
+
+            // Results only move towards the front, so going through the chunks in order never overwrites one
+            size_t total = 0;
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+                if (total != chunk * CULL_CHUNK_SIZE) {
+                    memmove(visible.data() + total, visible.data() + chunk * CULL_CHUNK_SIZE, sizeof(uint32_t) * chunk_visible[chunk]);
+                }
+                total += chunk_visible[chunk];
+            }
+            visible.resize(total);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../SoftwareRenderer/BrdfBatch.h"
+
+namespace rendering {
+    namespace scene {
+        using software::SimdLevel;
+
+        // World space bounding spheres as structure of arrays, so that one register holds the x of 4, 8 or 16 spheres
+        struct BoundingSpheres {
+            std::vector<float> _x;
+            std::vector<float> _y;
+            std::vector<float> _z;
+            std::vector<float> _radius;
+
+            size_t size() const;
+            void resize(size_t count);
+            void set(size_t i, const DirectX::XMFLOAT3& center, float radius);
+        };
+
+        // The six normalized planes of geometry::extractFrustumPlanes, one array per coefficient
+        struct FrustumPlanes {
+            float _a[6];
+            float _b[6];
+            float _c[6];
+            float _d[6];
+        };
+
+        FrustumPlanes makeFrustumPlanes(DirectX::FXMMATRIX view_projection);
+
+        // A sphere is culled when it is completely behind one of the planes, dot(plane, center) + radius < 0.
+        // Every level does the same float operations in the same order, so all of them return the scalar result
+        bool isSphereVisible(const FrustumPlanes& planes, const DirectX::XMFLOAT3& center, float radius);
+
+        // Writes the indices of the visible spheres in [begin, end) to out in increasing order and returns their count.
+        // out needs room for end - begin indices
+        size_t cullSpheres(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out,
+            SimdLevel level = software::getSimdLevel());
+
+        // Culls chunks of the spheres on all threads and compacts the chunk results in order, so visible ends up
+        // the same as with one cullSpheres call over everything
+        void cullSpheresParallel(const FrustumPlanes& planes, const BoundingSpheres& spheres, std::vector<uint32_t>& visible,
+            SimdLevel level = software::getSimdLevel());
+    }
+}
@@ -0,0 +1,75 @@
+#include "FrustumCullingKernels.h"
+
+#include <immintrin.h>
+
+#include "FrustumCulling.h"
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            // Lanes of every 8 bit visibility mask packed to the front, one byte per lane
+            struct CompressTable {
+                uint64_t _lanes[256];
+                uint8_t _counts[256];
+
+                CompressTable() {
+                    for (unsigned mask = 0; mask < 256; ++mask) {
+                        uint64_t lanes = 0;
+                        unsigned count = 0;
+                        for (unsigned lane = 0; lane < 8; ++lane) {
+                            if (mask & (1u << lane)) {
+                                lanes |= (uint64_t)lane << (8 * count++);
+                            }
+                        }
+                        _lanes[mask] = lanes;
+                        _counts[mask] = (uint8_t)count;
+                    }
+                }
+            };
+
+            const CompressTable COMPRESS_TABLE;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "FrustumCullingImpl.h"
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            struct Avx2Traits {
+                using Vec = __m256;
+                using Mask = __m256;
+                static const size_t WIDTH = 8;
+
+                static Vec set(float x) { return _mm256_set1_ps(x); }
+                static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+                static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+                static Mask greaterEqual(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+                static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+                // Stores all 8 lanes, the ones past the count are overwritten by the next group
+                static size_t compress(Mask mask, uint32_t base, uint32_t* out) {
+                    const int bits = _mm256_movemask_ps(mask);
+                    const __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&COMPRESS_TABLE._lanes[bits]));
+                    _mm256_storeu_si256((__m256i*)out, _mm256_add_epi32(lanes, _mm256_set1_epi32((int)base)));
+                    return COMPRESS_TABLE._counts[bits];
+                }
+            };
+        }
+
+        const SphereCullKernelInfo& getAvx2SphereCullKernel() {
+            static const SphereCullKernelInfo info = FrustumCullingImpl<Avx2Traits>::getInfo();
+            return info;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,49 @@
+#include "FrustumCullingKernels.h"
+
+#include <immintrin.h>
+
+#include "FrustumCulling.h"
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include "FrustumCullingImpl.h"
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            struct Avx512Traits {
+                using Vec = __m512;
+                using Mask = __mmask16;
+                static const size_t WIDTH = 16;
+
+                static Vec set(float x) { return _mm512_set1_ps(x); }
+                static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+                static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+                static Mask greaterEqual(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+                static Mask both(Mask a, Mask b) { return _mm512_kand(a, b); }
+                static size_t compress(Mask mask, uint32_t base, uint32_t* out) {
+                    const __m512i lanes = _mm512_add_epi32(_mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi32((int)base));
+                    _mm512_mask_compressstoreu_epi32(out, mask, lanes);
+                    size_t count = 0;
+                    for (unsigned bits = mask; bits != 0; bits &= bits - 1) {
+                        ++count;
+                    }
+                    return count;
+                }
+            };
+        }
+
+        const SphereCullKernelInfo& getAvx512SphereCullKernel() {
+            static const SphereCullKernelInfo info = FrustumCullingImpl<Avx512Traits>::getInfo();
+            return info;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "FrustumCulling.h"
+#include "FrustumCullingKernels.h"
+
+// Kernel body shared by the FrustumCulling*.cpp files, instantiated with their vector traits
+// (Vec, Mask, WIDTH, set, load, add, mul, greaterEqual, both, compress). compress writes base + lane for every
+// set lane of the mask, in lane order, and returns how many it wrote. See BrdfKernelsImpl.h for why the
+// target switch comes after every other include
+namespace rendering {
+    namespace scene {
+        namespace {
+            template <typename T>
+            struct FrustumCullingImpl {
+                using V = typename T::Vec;
+                using M = typename T::Mask;
+
+                static size_t cull(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out) {
+                    V a[6], b[6], c[6], d[6];
+                    for (size_t p = 0; p < 6; ++p) {
+                        a[p] = T::set(planes._a[p]);
+                        b[p] = T::set(planes._b[p]);
+                        c[p] = T::set(planes._c[p]);
+                        d[p] = T::set(planes._d[p]);
+                    }
+                    const V zero = T::set(0.0f);
+
+                    size_t count = 0;
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        const V x = T::load(spheres._x.data() + i);
+                        const V y = T::load(spheres._y.data() + i);
+                        const V z = T::load(spheres._z.data() + i);
+                        const V r = T::load(spheres._radius.data() + i);
+                        M visible = T::greaterEqual(T::add(distance(a[0], b[0], c[0], d[0], x, y, z), r), zero);
+                        for (size_t p = 1; p < 6; ++p) {
+                            visible = T::both(visible, T::greaterEqual(T::add(distance(a[p], b[p], c[p], d[p], x, y, z), r), zero));
+                        }
+                        count += T::compress(visible, (uint32_t)i, out + count);
+                    }
+                    return count;
+                }
+
+                // ((a x + b y) + c z) + d, the order isSphereVisible uses
+                static V distance(V a, V b, V c, V d, V x, V y, V z) {
+                    return T::add(T::add(T::add(T::mul(a, x), T::mul(b, y)), T::mul(c, z)), d);
+                }
+
+                static SphereCullKernelInfo getInfo() {
+                    return { T::WIDTH, &cull };
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rendering {
+    namespace scene {
+        struct BoundingSpheres;
+        struct FrustumPlanes;
+
+        // Culls the spheres [begin, end); end - begin is a multiple of the kernel width
+        using SphereCullKernel = size_t (*)(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t begin, size_t end, uint32_t* out);
+
+        struct SphereCullKernelInfo {
+            size_t _width;
+            SphereCullKernel _cull;
+        };
+
+        const SphereCullKernelInfo& getScalarSphereCullKernel();
+        const SphereCullKernelInfo& getSse4SphereCullKernel();
+        const SphereCullKernelInfo& getAvx2SphereCullKernel();
+        const SphereCullKernelInfo& getAvx512SphereCullKernel();
+    }
+}
@@ -0,0 +1,31 @@
+#include "FrustumCullingKernels.h"
+
+#include "FrustumCullingImpl.h"
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            struct ScalarTraits {
+                using Vec = float;
+                using Mask = bool;
+                static const size_t WIDTH = 1;
+
+                static Vec set(float x) { return x; }
+                static Vec load(const float* p) { return *p; }
+                static Vec add(Vec a, Vec b) { return a + b; }
+                static Vec mul(Vec a, Vec b) { return a * b; }
+                static Mask greaterEqual(Vec a, Vec b) { return a >= b; }
+                static Mask both(Mask a, Mask b) { return a && b; }
+                static size_t compress(Mask mask, uint32_t base, uint32_t* out) {
+                    *out = base;
+                    return mask ? 1 : 0;
+                }
+            };
+        }
+
+        const SphereCullKernelInfo& getScalarSphereCullKernel() {
+            static const SphereCullKernelInfo info = FrustumCullingImpl<ScalarTraits>::getInfo();
+            return info;
+        }
+    }
+}
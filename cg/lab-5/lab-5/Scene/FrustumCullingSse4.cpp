@@ -0,0 +1,50 @@
+#include "FrustumCullingKernels.h"
+
+#include <smmintrin.h>
+
+#include "FrustumCulling.h"
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include "FrustumCullingImpl.h"
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            struct Sse4Traits {
+                using Vec = __m128;
+                using Mask = __m128;
+                static const size_t WIDTH = 4;
+
+                static Vec set(float x) { return _mm_set1_ps(x); }
+                static Vec load(const float* p) { return _mm_loadu_ps(p); }
+                static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+                static Mask greaterEqual(Vec a, Vec b) { return _mm_cmpge_ps(a, b); }
+                static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+                // Every lane is written and only the visible ones advance the output
+                static size_t compress(Mask mask, uint32_t base, uint32_t* out) {
+                    const int bits = _mm_movemask_ps(mask);
+                    size_t count = 0;
+                    for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+                        out[count] = base + lane;
+                        count += (bits >> lane) & 1;
+                    }
+                    return count;
+                }
+            };
+        }
+
+        const SphereCullKernelInfo& getSse4SphereCullKernel() {
+            static const SphereCullKernelInfo info = FrustumCullingImpl<Sse4Traits>::getInfo();
+            return info;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,206 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            // Tiles covering NDC [ndc_min, ndc_max] and one more on each side against rounding, empty when last < first
+            void getTileRange(float ndc_min, float ndc_max, uint32_t tiles, int& first, int& last) {
+                const float tile_min = std::max((ndc_min * 0.5f + 0.5f) * tiles - 1.0f, 0.0f);
+                const float tile_max = std::min((ndc_max * 0.5f + 0.5f) * tiles + 1.0f, tiles - 1.0f);
+                first = (int)std::floor(tile_min);
+                last = tile_max < 0.0f ? -1 : (int)std::floor(tile_max);
+            }
+
+            // NDC extent of view space [min, max] over depths [z0, z1], both positive
+            void getNdcRange(float min, float max, float scale, float z0, float z1, float& ndc_min, float& ndc_max) {
+                ndc_min = std::min(min * scale / z0, min * scale / z1);
+                ndc_max = std::max(max * scale / z0, max * scale / z1);
+            }
+        }
+
+        void LightClusters::setGrid(const ClusterGridSettings& settings) {
+            assert(settings._near_z > 0.0f && settings._far_z > settings._near_z);
+            _settings = settings;
+
+            _slice_depths.resize(settings._slices + 1);
+            for (uint32_t slice = 0; slice <= settings._slices; ++slice) {
+                _slice_depths[slice] = settings._near_z * std::pow(settings._far_z / settings._near_z, (float)slice / settings._slices);
+            }
+            _slice_depths[settings._slices] = settings._far_z;
+
+            _cluster_bounds.resize(getClusterCount());
+            for (uint32_t slice = 0; slice < settings._slices; ++slice) {
+                const float z0 = _slice_depths[slice];
+                const float z1 = _slice_depths[slice + 1];
+                for (uint32_t y = 0; y < settings._tiles_y; ++y) {
+                    const float ndc_y0 = 2.0f * y / settings._tiles_y - 1.0f;
+                    const float ndc_y1 = 2.0f * (y + 1) / settings._tiles_y - 1.0f;
+                    for (uint32_t x = 0; x < settings._tiles_x; ++x) {
+                        const float ndc_x0 = 2.0f * x / settings._tiles_x - 1.0f;
+                        const float ndc_x1 = 2.0f * (x + 1) / settings._tiles_x - 1.0f;
+                        Aabb& box = _cluster_bounds[getClusterIndex(x, y, slice)];
+                        box._min = XMFLOAT3(std::min(ndc_x0 * z0, ndc_x0 * z1) / settings._projection_x,
+                            std::min(ndc_y0 * z0, ndc_y0 * z1) / settings._projection_y, z0);
+                        box._max = XMFLOAT3(std::max(ndc_x1 * z0, ndc_x1 * z1) / settings._projection_x,
+                            std::max(ndc_y1 * z0, ndc_y1 * z1) / settings._projection_y, z1);
+                    }
+                }
+            }
+            _slice_lists.resize(settings._slices);
+            _ranges.assign(getClusterCount(), { 0, 0 });
+            _light_indices.clear();
+            _max_cluster_lights = 0;
+        }
+
+        uint32_t LightClusters::getSlice(float view_z) const {
+            const float slice = std::floor(std::log(view_z / _settings._near_z) * _settings._slices / std::log(_settings._far_z / _settings._near_z));
+            return (uint32_t)std::min(std::max(slice, 0.0f), (float)(_settings._slices - 1));
+        }
+
+        void LightClusters::assign(FXMMATRIX view, const std::vector<ClusterLight>& lights) {
+            const size_t count = lights.size();
+            _view_lights.resize(count);
+            const size_t block_count = (count + _s_LIGHT_BLOCK_SIZE - 1) / _s_LIGHT_BLOCK_SIZE;
+            software::parallelFor(block_count, [&](size_t block) {
+                const size_t end = std::min(count, (block + 1) * _s_LIGHT_BLOCK_SIZE);
+                for (size_t i = block * _s_LIGHT_BLOCK_SIZE; i < end; ++i) {
+                    ViewLight& light = _view_lights[i];
+                    XMStoreFloat3(&light._center, XMVector3TransformCoord(XMLoadFloat3(&lights[i]._position), view));
+                    light._radius = lights[i]._range;
+                    const float z_min = light._center.z - light._radius;
+                    const float z_max = light._center.z + light._radius;
+                    if (z_max < _settings._near_z || z_min > _settings._far_z) {
+                        light._slice_begin = light._slice_end = 0;
+                        continue;
+                    }
+                    // One more slice on each side against rounding in the logarithm, the box tests decide
+                    const uint32_t first = getSlice(std::max(z_min, _settings._near_z));
+                    const uint32_t last = getSlice(std::min(z_max, _settings._far_z));
+                    light._slice_begin = first > 0 ? first - 1 : 0;
+                    light._slice_end = std::min(last + 2, _settings._slices);
+                }
+            });
+
+            software::parallelFor(_settings._slices, [&](size_t slice) {
+                assignSlice((uint32_t)slice);
+            });
+
+            // Slices were compacted on their own, now they are laid out one after another
+            const size_t tiles = (size_t)_settings._tiles_x * _settings._tiles_y;
+            size_t offset = 0;
+            _max_cluster_lights = 0;
+            for (uint32_t slice = 0; slice < _settings._slices; ++slice) {
+                for (size_t tile = 0; tile < tiles; ++tile) {
+                    ClusterRange& range = _ranges[slice * tiles + tile];
+                    range._offset += (uint32_t)offset;
+                    _max_cluster_lights = std::max<size_t>(_max_cluster_lights, range._count);
+                }
+                offset += _slice_lists[slice]._lights.size();
+            }
+            _light_indices.resize(offset);
+            software::parallelFor(_settings._slices, [&](size_t slice) {
+                const std::vector<uint32_t>& slice_lights = _slice_lists[slice]._lights;
+                if (!slice_lights.empty()) {
+                    std::copy(slice_lights.begin(), slice_lights.end(), _light_indices.begin() + _ranges[slice * tiles]._offset);
+                }
+            });
+        }
+
+        void LightClusters::assignSlice(uint32_t slice) {
+            const float z0 = _slice_depths[slice];
+            const float z1 = _slice_depths[slice + 1];
+            const size_t tiles = (size_t)_settings._tiles_x * _settings._tiles_y;
+            Slice& lists = _slice_lists[slice];
+            lists._pairs.clear();
+
+            for (uint32_t i = 0; i < (uint32_t)_view_lights.size(); ++i) {
+                const ViewLight& light = _view_lights[i];
+                if (slice < light._slice_begin || slice >= light._slice_end) {
+                    continue;
+                }
+                const float z_min = std::max(light._center.z - light._radius, z0);
+                const float z_max = std::min(light._center.z + light._radius, z1);
+                if (z_min > z_max) {
+                    continue;
+                }
+                // The sphere lies in a box, whose projection is widest at its corners
+                float ndc_min, ndc_max;
+                int x_first, x_last, y_first, y_last;
+                getNdcRange(light._center.x - light._radius, light._center.x + light._radius, _settings._projection_x, z_min, z_max, ndc_min, ndc_max);
+                getTileRange(ndc_min, ndc_max, _settings._tiles_x, x_first, x_last);
+                getNdcRange(light._center.y - light._radius, light._center.y + light._radius, _settings._projection_y, z_min, z_max, ndc_min, ndc_max);
+                getTileRange(ndc_min, ndc_max, _settings._tiles_y, y_first, y_last);
+                for (int y = y_first; y <= y_last; ++y) {
+                    for (int x = x_first; x <= x_last; ++x) {
+                        const uint32_t tile = (uint32_t)y * _settings._tiles_x + (uint32_t)x;
+                        if (overlapsAabb(_cluster_bounds[slice * tiles + tile], light._center, light._radius)) {
+                            lists._pairs.push_back({ tile, i });
+                        }
+                    }
+                }
+            }
+
+            // Counting sort by tile, stable so that every cluster keeps the light order
+            ClusterRange* ranges = _ranges.data() + slice * tiles;
+            for (size_t tile = 0; tile < tiles; ++tile) {
+                ranges[tile] = { 0, 0 };
+            }
+            for (const SlicePair& pair : lists._pairs) {
+                ++ranges[pair._tile]._count;
+            }
+            uint32_t offset = 0;
+            for (size_t tile = 0; tile < tiles; ++tile) {
+                ranges[tile]._offset = offset;
+                offset += ranges[tile]._count;
+            }
+            lists._lights.resize(lists._pairs.size());
+            std::vector<uint32_t> next(tiles);
+            for (size_t tile = 0; tile < tiles; ++tile) {
+                next[tile] = ranges[tile]._offset;
+            }
+            for (const SlicePair& pair : lists._pairs) {
+                lists._lights[next[pair._tile]++] = pair._light;
+            }
+        }
+
+        const ClusterGridSettings& LightClusters::getSettings() const {
+            return _settings;
+        }
+
+        size_t LightClusters::getClusterCount() const {
+            return (size_t)_settings._tiles_x * _settings._tiles_y * _settings._slices;
+        }
+
+        size_t LightClusters::getClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const {
+            return ((size_t)slice * _settings._tiles_y + y) * _settings._tiles_x + x;
+        }
+
+        float LightClusters::getSliceDepth(uint32_t slice) const {
+            return _slice_depths[slice];
+        }
+
+        const Aabb& LightClusters::getClusterBounds(size_t cluster) const {
+            return _cluster_bounds[cluster];
+        }
+
+        const std::vector<ClusterRange>& LightClusters::getRanges() const {
+            return _ranges;
+        }
+
+        const std::vector<uint32_t>& LightClusters::getLightIndices() const {
+            return _light_indices;
+        }
+
+        size_t LightClusters::getMaxClusterLights() const {
+            return _max_cluster_lights;
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+
+namespace rendering {
+    namespace scene {
+        // View space froxels: the screen is split into tiles, depth into slices of exponentially growing
+        // thickness between the near and the far plane, so froxels stay roughly cubic at every distance
+        struct ClusterGridSettings {
+            uint32_t _tiles_x = 16;
+            uint32_t _tiles_y = 9;
+            uint32_t _slices = 24;
+            float _near_z = 0.1f;
+            float _far_z = 100.0f;
+            // _11 and _22 of the projection, view x / z and y / z times these are the NDC coordinates
+            float _projection_x = 1.0f;
+            float _projection_y = 1.0f;
+        };
+
+        // World space sphere of influence, the light adds nothing beyond _range
+        struct ClusterLight {
+            DirectX::XMFLOAT3 _position;
+            float _range;
+        };
+
+        // Lights of a cluster are _light_indices[_offset, _offset + _count)
+        struct ClusterRange {
+            uint32_t _offset;
+            uint32_t _count;
+        };
+
+        // Assigns lights to the froxels their sphere overlaps. Clusters are slice major, then row, then column,
+        // the same order the shaders compute. A light is tested against the view space boxes of the froxels
+        // its bounds project to, so a cluster may hold a light that only touches the corners of a froxel box,
+        // but never misses one that reaches into the froxel
+        class LightClusters {
+        public:
+            void setGrid(const ClusterGridSettings& settings);
+            // Lights of a cluster keep the order of lights. One depth slice per task
+            void assign(DirectX::FXMMATRIX view, const std::vector<ClusterLight>& lights);
+
+            const ClusterGridSettings& getSettings() const;
+            size_t getClusterCount() const;
+            size_t getClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const;
+            // View space depth where a slice starts, slices + 1 values
+            float getSliceDepth(uint32_t slice) const;
+            const Aabb& getClusterBounds(size_t cluster) const;
+
+            const std::vector<ClusterRange>& getRanges() const;
+            const std::vector<uint32_t>& getLightIndices() const;
+            size_t getMaxClusterLights() const;
+
+        private:
+            struct ViewLight {
+                DirectX::XMFLOAT3 _center;
+                float _radius;
+                uint32_t _slice_begin;
+                uint32_t _slice_end;
+            };
+
+            // Tile within a slice and light index
+            struct SlicePair {
+                uint32_t _tile;
+                uint32_t _light;
+            };
+
+            struct Slice {
+                std::vector<SlicePair> _pairs;
+                // Lights of the slice grouped by tile
+                std::vector<uint32_t> _lights;
+            };
+
+            static const size_t _s_LIGHT_BLOCK_SIZE = 1024;
+
+            uint32_t getSlice(float view_z) const;
+            void assignSlice(uint32_t slice);
+
+            ClusterGridSettings _settings;
+            std::vector<float> _slice_depths;
+            std::vector<Aabb> _cluster_bounds;
+
+            std::vector<ViewLight> _view_lights;
+            std::vector<Slice> _slice_lists;
+            std::vector<ClusterRange> _ranges;
+            std::vector<uint32_t> _light_indices;
+            size_t _max_cluster_lights = 0;
+        };
+    }
+}
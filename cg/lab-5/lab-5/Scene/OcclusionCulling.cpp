@@ -0,0 +1,341 @@
+#include "OcclusionCulling.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            const uint32_t FULL_MASK = 0xFFFFFFFFu;
+
+            // Bit 8 * row + column of a tile
+            uint32_t getRectMask(size_t x0, size_t x1, size_t y0, size_t y1) {
+                const uint32_t row = (0xFFu >> (7 - (x1 - x0))) << x0;
+                uint32_t mask = 0;
+                for (size_t y = y0; y <= y1; ++y) {
+                    mask |= row << (8 * y);
+                }
+                return mask;
+            }
+
+            bool isOutside(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c) {
+                return (a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w)
+                    || (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w)
+                    || (a.z > a.w && b.z > b.w && c.z > c.w);
+            }
+
+            XMFLOAT4 lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t) {
+                return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+            }
+        }
+
+        OcclusionBuffer::OcclusionBuffer(size_t width, size_t height)
+            : _width(width), _height(height), _tiles_x(width / TILE_WIDTH), _tiles_y(height / TILE_HEIGHT) {
+            assert(width % TILE_WIDTH == 0 && height % TILE_HEIGHT == 0 && width > 0 && height > 0);
+            _tiles.resize(_tiles_x * _tiles_y);
+            size_t level_width = _tiles_x;
+            size_t level_height = _tiles_y;
+            while (true) {
+                Level level;
+                level._width = level_width;
+                level._height = level_height;
+                level._min.resize(level_width * level_height);
+                level._max.resize(level_width * level_height);
+                _levels.push_back(std::move(level));
+                if (level_width == 1 && level_height == 1) {
+                    break;
+                }
+                level_width = (level_width + 1) / 2;
+                level_height = (level_height + 1) / 2;
+            }
+            begin(XMMatrixIdentity());
+        }
+
+        void OcclusionBuffer::begin(FXMMATRIX view_projection) {
+            XMStoreFloat4x4(&_view_projection, view_projection);
+            std::fill(_tiles.begin(), _tiles.end(), Tile{ 0, 1.0f, 1.0f, 1.0f });
+            _triangles = 0;
+        }
+
+        XMFLOAT3 OcclusionBuffer::toScreen(FXMVECTOR clip) const {
+            XMFLOAT4 c;
+            XMStoreFloat4(&c, clip);
+            const float inv_w = 1.0f / c.w;
+            return XMFLOAT3((c.x * inv_w * 0.5f + 0.5f) * _width, (0.5f - c.y * inv_w * 0.5f) * _height, c.z * inv_w);
+        }
+
+        void OcclusionBuffer::renderOccluder(const std::vector<XMFLOAT3>& positions, const std::vector<unsigned>& indices, FXMMATRIX world) {
+            const XMMATRIX transform = world * XMLoadFloat4x4(&_view_projection);
+            _clip.resize(positions.size());
+            for (size_t i = 0; i < positions.size(); ++i) {
+                XMStoreFloat4(&_clip[i], XMVector3Transform(XMLoadFloat3(&positions[i]), transform));
+            }
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                const XMFLOAT4& a = _clip[indices[i]];
+                const XMFLOAT4& b = _clip[indices[i + 1]];
+                const XMFLOAT4& c = _clip[indices[i + 2]];
+                if (isOutside(a, b, c)) {
+                    continue;
+                }
+                ++_triangles;
+                if (a.z >= 0.0f && b.z >= 0.0f && c.z >= 0.0f) {
+                    rasterizeTriangle(toScreen(XMLoadFloat4(&a)), toScreen(XMLoadFloat4(&b)), toScreen(XMLoadFloat4(&c)));
+                    continue;
+                }
+
+                // Clipped against the near plane z = 0, which leaves at most a quad
+                const XMFLOAT4 input[3] = { a, b, c };
+                XMFLOAT4 polygon[4];
+                size_t count = 0;
+                for (size_t k = 0; k < 3; ++k) {
+                    const XMFLOAT4& p = input[k];
+                    const XMFLOAT4& q = input[(k + 1) % 3];
+                    if (p.z >= 0.0f) {
+                        polygon[count++] = p;
+                    }
+                    if ((p.z >= 0.0f) != (q.z >= 0.0f)) {
+                        polygon[count++] = lerp(p, q, p.z / (p.z - q.z));
+                    }
+                }
+                if (count < 3) {
+                    continue;
+                }
+                const XMFLOAT3 first = toScreen(XMLoadFloat4(&polygon[0]));
+                for (size_t k = 1; k + 1 < count; ++k) {
+                    rasterizeTriangle(first, toScreen(XMLoadFloat4(&polygon[k])), toScreen(XMLoadFloat4(&polygon[k + 1])));
+                }
+            }
+        }
+
+        // Coverage is sampled at pixel centers with SSE edge functions, four pixels of a tile row at a time.
+        // The depth of a tile is the depth plane at the corner pixels clamped to the depth range of the triangle
+        void OcclusionBuffer::rasterizeTriangle(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2) {
+            const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+            if (!(std::fabs(area) > 0.0f)) {
+                return;
+            }
+            const float tri_z_min = std::max(std::min(std::min(v0.z, v1.z), v2.z), 0.0f);
+            const float tri_z_max = std::max(std::max(v0.z, v1.z), v2.z);
+            if (tri_z_min >= 1.0f) {
+                return;
+            }
+
+            // Pixels whose centers can be covered
+            const float x_min = std::ceil(std::min(std::min(v0.x, v1.x), v2.x) - 0.5f);
+            const float x_max = std::floor(std::max(std::max(v0.x, v1.x), v2.x) - 0.5f);
+            const float y_min = std::ceil(std::min(std::min(v0.y, v1.y), v2.y) - 0.5f);
+            const float y_max = std::floor(std::max(std::max(v0.y, v1.y), v2.y) - 0.5f);
+            if (x_max < 0.0f || y_max < 0.0f || x_min > _width - 1.0f || y_min > _height - 1.0f || x_min > x_max || y_min > y_max) {
+                return;
+            }
+            const size_t tile_x0 = (size_t)std::max(x_min, 0.0f) / TILE_WIDTH;
+            const size_t tile_x1 = (size_t)std::min(x_max, _width - 1.0f) / TILE_WIDTH;
+            const size_t tile_y0 = (size_t)std::max(y_min, 0.0f) / TILE_HEIGHT;
+            const size_t tile_y1 = (size_t)std::min(y_max, _height - 1.0f) / TILE_HEIGHT;
+
+            // Edge functions a x + b y + c, positive inside whatever the winding
+            const float sign = area > 0.0f ? 1.0f : -1.0f;
+            const XMFLOAT3* v[3] = { &v0, &v1, &v2 };
+            float a[3], b[3], c[3];
+            for (size_t e = 0; e < 3; ++e) {
+                const XMFLOAT3& p = *v[e];
+                const XMFLOAT3& q = *v[(e + 1) % 3];
+                a[e] = sign * (p.y - q.y);
+                b[e] = sign * (q.x - p.x);
+                c[e] = sign * (p.x * q.y - q.x * p.y);
+            }
+            const float dz_dx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            const float dz_dy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            for (size_t ty = tile_y0; ty <= tile_y1; ++ty) {
+                const float y_top = ty * TILE_HEIGHT + 0.5f;
+                for (size_t tx = tile_x0; tx <= tile_x1; ++tx) {
+                    const float x_left = (float)(tx * TILE_WIDTH);
+                    const __m128 x_lo = _mm_add_ps(_mm_set1_ps(x_left), offsets);
+                    const __m128 x_hi = _mm_add_ps(x_lo, _mm_set1_ps(4.0f));
+                    __m128 ax_lo[3], ax_hi[3];
+                    for (size_t e = 0; e < 3; ++e) {
+                        const __m128 ae = _mm_set1_ps(a[e]);
+                        ax_lo[e] = _mm_mul_ps(ae, x_lo);
+                        ax_hi[e] = _mm_mul_ps(ae, x_hi);
+                    }
+
+                    uint32_t mask = 0;
+                    for (size_t row = 0; row < TILE_HEIGHT; ++row) {
+                        const float y = y_top + row;
+                        __m128 inside_lo = _mm_cmpeq_ps(zero, zero);
+                        __m128 inside_hi = inside_lo;
+                        for (size_t e = 0; e < 3; ++e) {
+                            const __m128 row_term = _mm_set1_ps(b[e] * y + c[e]);
+                            inside_lo = _mm_and_ps(inside_lo, _mm_cmpge_ps(_mm_add_ps(ax_lo[e], row_term), zero));
+                            inside_hi = _mm_and_ps(inside_hi, _mm_cmpge_ps(_mm_add_ps(ax_hi[e], row_term), zero));
+                        }
+                        mask |= (uint32_t)(_mm_movemask_ps(inside_lo) | (_mm_movemask_ps(inside_hi) << 4)) << (8 * row);
+                    }
+                    if (mask == 0) {
+                        continue;
+                    }
+
+                    const float z_left = v0.z + dz_dx * (x_left + 0.5f - v0.x) + dz_dy * (y_top - v0.y);
+                    const float z_dx = dz_dx * (TILE_WIDTH - 1);
+                    const float z_dy = dz_dy * (TILE_HEIGHT - 1);
+                    const float z_near = z_left + std::min(z_dx, 0.0f) + std::min(z_dy, 0.0f);
+                    const float z_far = z_left + std::max(z_dx, 0.0f) + std::max(z_dy, 0.0f);
+                    updateTile(_tiles[ty * _tiles_x + tx], mask, std::min(std::max(z_near, tri_z_min), tri_z_max),
+                        std::min(std::max(z_far, tri_z_min), tri_z_max));
+                }
+            }
+        }
+
+        // A tile only ever gets closer. Pixels in the mask are at most _z1 away, the others at most _z0. Once the
+        // layer covers the tile it becomes the tile depth, and a layer that a much closer triangle would only
+        // make worse is dropped
+        void OcclusionBuffer::updateTile(Tile& tile, uint32_t mask, float z_min, float z_max) {
+            tile._z_min = std::min(tile._z_min, z_min);
+            if (z_max >= tile._z0) {
+                return;
+            }
+            if (mask == FULL_MASK) {
+                tile._z0 = z_max;
+                if (tile._z1 >= z_max) {
+                    tile._mask = 0;
+                }
+                return;
+            }
+            if (tile._mask != 0 && z_max < tile._z1 && tile._z1 - z_max > tile._z0 - tile._z1) {
+                tile._mask = 0;
+            }
+            tile._z1 = tile._mask != 0 ? std::max(tile._z1, z_max) : z_max;
+            tile._mask |= mask;
+            if (tile._mask == FULL_MASK) {
+                tile._z0 = tile._z1;
+                tile._mask = 0;
+            }
+        }
+
+        void OcclusionBuffer::buildHierarchy() {
+            Level& base = _levels[0];
+            for (size_t i = 0; i < _tiles.size(); ++i) {
+                base._min[i] = _tiles[i]._z_min;
+                base._max[i] = _tiles[i]._z0;
+            }
+            for (size_t l = 1; l < _levels.size(); ++l) {
+                const Level& fine = _levels[l - 1];
+                Level& coarse = _levels[l];
+                for (size_t y = 0; y < coarse._height; ++y) {
+                    const size_t y0 = 2 * y;
+                    const size_t y1 = std::min(y0 + 1, fine._height - 1);
+                    for (size_t x = 0; x < coarse._width; ++x) {
+                        const size_t x0 = 2 * x;
+                        const size_t x1 = std::min(x0 + 1, fine._width - 1);
+                        coarse._min[y * coarse._width + x] = std::min(
+                            std::min(fine._min[y0 * fine._width + x0], fine._min[y0 * fine._width + x1]),
+                            std::min(fine._min[y1 * fine._width + x0], fine._min[y1 * fine._width + x1]));
+                        coarse._max[y * coarse._width + x] = std::max(
+                            std::max(fine._max[y0 * fine._width + x0], fine._max[y0 * fine._width + x1]),
+                            std::max(fine._max[y1 * fine._width + x0], fine._max[y1 * fine._width + x1]));
+                    }
+                }
+            }
+        }
+
+        // The box is reduced to its screen rectangle and closest depth. The coarsest level where the rectangle
+        // spans at most 2x2 texels decides most boxes, the rest go through the tiles and their masks
+        OcclusionResult OcclusionBuffer::testAabb(const Aabb& box) const {
+            const XMMATRIX view_projection = XMLoadFloat4x4(&_view_projection);
+            float x_min = FLT_MAX, y_min = FLT_MAX, z_near = FLT_MAX;
+            float x_max = -FLT_MAX, y_max = -FLT_MAX, z_far = -FLT_MAX;
+            for (size_t corner = 0; corner < 8; ++corner) {
+                const XMVECTOR position = XMVectorSet(corner & 1 ? box._max.x : box._min.x, corner & 2 ? box._max.y : box._min.y,
+                    corner & 4 ? box._max.z : box._min.z, 1.0f);
+                XMFLOAT4 clip;
+                XMStoreFloat4(&clip, XMVector4Transform(position, view_projection));
+                // Crosses the near plane
+                if (!(clip.z >= 0.0f && clip.w > 0.0f)) {
+                    return OcclusionResult::VISIBLE;
+                }
+                const float inv_w = 1.0f / clip.w;
+                x_min = std::min(x_min, clip.x * inv_w);
+                x_max = std::max(x_max, clip.x * inv_w);
+                y_min = std::min(y_min, clip.y * inv_w);
+                y_max = std::max(y_max, clip.y * inv_w);
+                z_near = std::min(z_near, clip.z * inv_w);
+                z_far = std::max(z_far, clip.z * inv_w);
+            }
+            if (x_max < -1.0f || x_min > 1.0f || y_max < -1.0f || y_min > 1.0f || z_near > 1.0f) {
+                return OcclusionResult::VIEW_CULLED;
+            }
+
+            // Every pixel the rectangle touches
+            const size_t px0 = (size_t)std::max((x_min * 0.5f + 0.5f) * _width, 0.0f);
+            const size_t px1 = std::min((size_t)std::max((x_max * 0.5f + 0.5f) * _width, 0.0f), _width - 1);
+            const size_t py0 = (size_t)std::max((0.5f - y_max * 0.5f) * _height, 0.0f);
+            const size_t py1 = std::min((size_t)std::max((0.5f - y_min * 0.5f) * _height, 0.0f), _height - 1);
+            const size_t tx0 = px0 / TILE_WIDTH;
+            const size_t tx1 = px1 / TILE_WIDTH;
+            const size_t ty0 = py0 / TILE_HEIGHT;
+            const size_t ty1 = py1 / TILE_HEIGHT;
+
+            size_t l = 0;
+            while (l + 1 < _levels.size() && ((tx1 >> l) - (tx0 >> l) > 1 || (ty1 >> l) - (ty0 >> l) > 1)) {
+                ++l;
+            }
+            const Level& level = _levels[l];
+            bool occluded = true;
+            for (size_t y = ty0 >> l; y <= ty1 >> l; ++y) {
+                for (size_t x = tx0 >> l; x <= tx1 >> l; ++x) {
+                    // In front of every occluder there
+                    if (z_far < level._min[y * level._width + x]) {
+                        return OcclusionResult::VISIBLE;
+                    }
+                    occluded = occluded && z_near > level._max[y * level._width + x];
+                }
+            }
+            if (occluded) {
+                return OcclusionResult::OCCLUDED;
+            }
+
+            for (size_t ty = ty0; ty <= ty1; ++ty) {
+                const size_t row0 = ty == ty0 ? py0 % TILE_HEIGHT : 0;
+                const size_t row1 = ty == ty1 ? py1 % TILE_HEIGHT : TILE_HEIGHT - 1;
+                for (size_t tx = tx0; tx <= tx1; ++tx) {
+                    const size_t column0 = tx == tx0 ? px0 % TILE_WIDTH : 0;
+                    const size_t column1 = tx == tx1 ? px1 % TILE_WIDTH : TILE_WIDTH - 1;
+                    const Tile& tile = _tiles[ty * _tiles_x + tx];
+                    const uint32_t rect_mask = getRectMask(column0, column1, row0, row1);
+                    const float depth = (rect_mask & ~tile._mask) != 0 ? tile._z0 : std::min(tile._z0, tile._z1);
+                    if (z_near <= depth) {
+                        return OcclusionResult::VISIBLE;
+                    }
+                }
+            }
+            return OcclusionResult::OCCLUDED;
+        }
+
+        size_t OcclusionBuffer::getWidth() const {
+            return _width;
+        }
+
+        size_t OcclusionBuffer::getHeight() const {
+            return _height;
+        }
+
+        size_t OcclusionBuffer::getOccluderTriangleCount() const {
+            return _triangles;
+        }
+
+        float OcclusionBuffer::getDepth(size_t x, size_t y) const {
+            const Tile& tile = _tiles[(y / TILE_HEIGHT) * _tiles_x + x / TILE_WIDTH];
+            const uint32_t bit = 1u << ((y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH);
+            return (tile._mask & bit) != 0 ? std::min(tile._z0, tile._z1) : tile._z0;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+
+namespace rendering {
+    namespace scene {
+        enum class OcclusionResult {
+            VISIBLE,
+            OCCLUDED,
+            // Outside the screen or beyond the far plane, left to frustum culling
+            VIEW_CULLED
+        };
+
+        // Masked software occlusion culling. A few occluders are rasterized into a small depth buffer of
+        // 8x4 pixel tiles. Instead of a depth per pixel a tile keeps a 32 bit coverage mask of the closest
+        // layer being built, the farthest depth of that layer and the farthest depth of the whole tile.
+        // Depths are conservative, an object is only reported as occluded if it is behind every occluder
+        // it overlaps. Occluders have to lie inside the objects they stand for, e.g. inscribed meshes.
+        // Coverage is sampled at pixel centers like on the GPU, so an object that peeks out by less than
+        // a pixel of this buffer may still be culled
+        class OcclusionBuffer {
+        public:
+            static const size_t TILE_WIDTH = 8;
+            static const size_t TILE_HEIGHT = 4;
+
+            // Multiples of the tile size
+            OcclusionBuffer(size_t width = 256, size_t height = 128);
+
+            // Clears the buffer for a frame seen through view_projection, which maps to D3D clip space
+            void begin(DirectX::FXMMATRIX view_projection);
+            // Triangles of positions transformed by world. Winding does not matter
+            void renderOccluder(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<unsigned>& indices, DirectX::FXMMATRIX world);
+            // Min and max pyramid over the tile depths, between the last occluder and the first test
+            void buildHierarchy();
+
+            // World space box
+            OcclusionResult testAabb(const Aabb& box) const;
+
+            size_t getWidth() const;
+            size_t getHeight() const;
+            size_t getOccluderTriangleCount() const;
+            // Conservative depth of the occluders at a pixel, 1 where none was drawn
+            float getDepth(size_t x, size_t y) const;
+
+        private:
+            struct Tile {
+                uint32_t _mask;
+                // Farthest depth of the tile and of the pixels in _mask
+                float _z0;
+                float _z1;
+                // Closest occluder depth in the tile
+                float _z_min;
+            };
+
+            struct Level {
+                size_t _width;
+                size_t _height;
+                std::vector<float> _min;
+                std::vector<float> _max;
+            };
+
+            // x and y in pixels, z in [0, 1]
+            void rasterizeTriangle(const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+            void updateTile(Tile& tile, uint32_t mask, float z_min, float z_max);
+            DirectX::XMFLOAT3 toScreen(DirectX::FXMVECTOR clip) const;
+
+            size_t _width;
+            size_t _height;
+            size_t _tiles_x;
+            size_t _tiles_y;
+            DirectX::XMFLOAT4X4 _view_projection;
+            std::vector<Tile> _tiles;
+            std::vector<Level> _levels;
+            std::vector<DirectX::XMFLOAT4> _clip;
+            size_t _triangles = 0;
+        };
+    }
+}
@@ -0,0 +1,376 @@
+#include "TransformHierarchy.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+#include "../SoftwareRenderer/ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace scene {
+        namespace {
+            // Local components
+            enum {
+                TX, TY, TZ, QX, QY, QZ, QW, SX, SY, SZ
+            };
+
+            // World matrices are the 4x3 of the row vector convention, the last row is the translation
+            struct Columns {
+                const float* _local[10];
+                float* _world[12];
+                float* _normal[9];
+                const uint32_t* _parents;
+            };
+
+            struct ScalarTraits {
+                typedef float Vec;
+                static const size_t WIDTH = 1;
+
+                static Vec load(const float* p) { return *p; }
+                static void store(float* p, Vec v) { *p = v; }
+                static Vec set(float x) { return x; }
+                static Vec add(Vec a, Vec b) { return a + b; }
+                static Vec sub(Vec a, Vec b) { return a - b; }
+                static Vec mul(Vec a, Vec b) { return a * b; }
+                static Vec div(Vec a, Vec b) { return a / b; }
+                static Vec gather(const float* base, const uint32_t* indices) { return base[indices[0]]; }
+            };
+
+            struct SseTraits {
+                typedef __m128 Vec;
+                static const size_t WIDTH = 4;
+
+                static Vec load(const float* p) { return _mm_loadu_ps(p); }
+                static void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+                static Vec set(float x) { return _mm_set1_ps(x); }
+                static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+                static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+                static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+                static Vec gather(const float* base, const uint32_t* indices) {
+                    return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+                }
+            };
+
+            // The same operations in the same order for every width, so the SSE blocks and the scalar tail agree bitwise
+            template <typename T>
+            void updateNodes(const Columns& c, size_t i) {
+                using V = typename T::Vec;
+                const V one = T::set(1.0f);
+                const V two = T::set(2.0f);
+
+                const V qx = T::load(c._local[QX] + i);
+                const V qy = T::load(c._local[QY] + i);
+                const V qz = T::load(c._local[QZ] + i);
+                const V qw = T::load(c._local[QW] + i);
+                const V xx = T::mul(qx, qx), yy = T::mul(qy, qy), zz = T::mul(qz, qz);
+                const V xy = T::mul(qx, qy), xz = T::mul(qx, qz), yz = T::mul(qy, qz);
+                const V wx = T::mul(qw, qx), wy = T::mul(qw, qy), wz = T::mul(qw, qz);
+                // XMMatrixRotationQuaternion
+                const V rotation[3][3] = {
+                    { T::sub(one, T::mul(two, T::add(yy, zz))), T::mul(two, T::add(xy, wz)), T::mul(two, T::sub(xz, wy)) },
+                    { T::mul(two, T::sub(xy, wz)), T::sub(one, T::mul(two, T::add(xx, zz))), T::mul(two, T::add(yz, wx)) },
+                    { T::mul(two, T::add(xz, wy)), T::mul(two, T::sub(yz, wx)), T::sub(one, T::mul(two, T::add(xx, yy))) },
+                };
+
+                // The local 3x3 is S R, its inverse transpose S^-1 R
+                const V scale[3] = { T::load(c._local[SX] + i), T::load(c._local[SY] + i), T::load(c._local[SZ] + i) };
+                V local[3][3], local_normal[3][3];
+                for (size_t r = 0; r < 3; ++r) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        local[r][k] = T::mul(scale[r], rotation[r][k]);
+                        local_normal[r][k] = T::div(rotation[r][k], scale[r]);
+                    }
+                }
+                const V translation[3] = { T::load(c._local[TX] + i), T::load(c._local[TY] + i), T::load(c._local[TZ] + i) };
+
+                const uint32_t* parents = c._parents + i;
+                V parent[4][3], parent_normal[3][3];
+                for (size_t r = 0; r < 4; ++r) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        parent[r][k] = T::gather(c._world[3 * r + k], parents);
+                    }
+                }
+                for (size_t r = 0; r < 3; ++r) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        parent_normal[r][k] = T::gather(c._normal[3 * r + k], parents);
+                    }
+                }
+
+                for (size_t k = 0; k < 3; ++k) {
+                    for (size_t r = 0; r < 3; ++r) {
+                        T::store(c._world[3 * r + k] + i,
+                            T::add(T::add(T::mul(local[r][0], parent[0][k]), T::mul(local[r][1], parent[1][k])), T::mul(local[r][2], parent[2][k])));
+                        T::store(c._normal[3 * r + k] + i,
+                            T::add(T::add(T::mul(local_normal[r][0], parent_normal[0][k]), T::mul(local_normal[r][1], parent_normal[1][k])),
+                                T::mul(local_normal[r][2], parent_normal[2][k])));
+                    }
+                    T::store(c._world[9 + k] + i, T::add(T::add(T::add(T::mul(translation[0], parent[0][k]), T::mul(translation[1], parent[1][k])),
+                        T::mul(translation[2], parent[2][k])), parent[3][k]));
+                }
+            }
+        }
+
+        TransformHandle TransformHierarchy::add(const Transform& local, TransformHandle parent) {
+            assert(parent == NO_TRANSFORM || parent < _parent_handles.size());
+            const TransformHandle handle = (TransformHandle)_parent_handles.size();
+            _parent_handles.push_back(parent);
+            _slots.push_back(handle);
+            _handles.push_back(handle);
+            for (size_t c = 0; c < _s_LOCAL_COMPONENTS; ++c) {
+                _local[c].push_back(0.0f);
+            }
+            _dirty.push_back(1);
+            setLocal(handle, local);
+            _sorted = false;
+            return handle;
+        }
+
+        void TransformHierarchy::setLocal(TransformHandle node, const Transform& local) {
+            const uint32_t slot = _slots[node];
+            _local[TX][slot] = local._translation.x;
+            _local[TY][slot] = local._translation.y;
+            _local[TZ][slot] = local._translation.z;
+            _local[QX][slot] = local._rotation.x;
+            _local[QY][slot] = local._rotation.y;
+            _local[QZ][slot] = local._rotation.z;
+            _local[QW][slot] = local._rotation.w;
+            _local[SX][slot] = local._scale.x;
+            _local[SY][slot] = local._scale.y;
+            _local[SZ][slot] = local._scale.z;
+            if (!_dirty[slot]) {
+                _dirty[slot] = 1;
+                _dirty_slots.push_back(slot);
+            }
+        }
+
+        Transform TransformHierarchy::getLocal(TransformHandle node) const {
+            const uint32_t slot = _slots[node];
+            Transform local;
+            local._translation = XMFLOAT3(_local[TX][slot], _local[TY][slot], _local[TZ][slot]);
+            local._rotation = XMFLOAT4(_local[QX][slot], _local[QY][slot], _local[QZ][slot], _local[QW][slot]);
+            local._scale = XMFLOAT3(_local[SX][slot], _local[SY][slot], _local[SZ][slot]);
+            return local;
+        }
+
+        // Breadth first from the roots in handle order, then every slot array is permuted to match
+        void TransformHierarchy::sortByDepth() {
+            const size_t count = _parent_handles.size();
+            std::vector<uint32_t> child_begin(count + 1, 0);
+            for (TransformHandle parent : _parent_handles) {
+                if (parent != NO_TRANSFORM) {
+                    ++child_begin[parent + 1];
+                }
+            }
+            for (size_t i = 0; i < count; ++i) {
+                child_begin[i + 1] += child_begin[i];
+            }
+            std::vector<TransformHandle> children(child_begin[count]);
+            std::vector<uint32_t> child_end(child_begin.begin(), child_begin.end() - 1);
+            for (TransformHandle handle = 0; handle < count; ++handle) {
+                if (_parent_handles[handle] != NO_TRANSFORM) {
+                    children[child_end[_parent_handles[handle]]++] = handle;
+                }
+            }
+
+            std::vector<TransformHandle> order;
+            order.reserve(count);
+            for (TransformHandle handle = 0; handle < count; ++handle) {
+                if (_parent_handles[handle] == NO_TRANSFORM) {
+                    order.push_back(handle);
+                }
+            }
+            _depth_begin.assign(1, 0);
+            _child_begin.clear();
+            size_t depth_end = order.size();
+            for (size_t i = 0; i < order.size(); ++i) {
+                if (i == depth_end) {
+                    _depth_begin.push_back(depth_end);
+                    depth_end = order.size();
+                }
+                const TransformHandle handle = order[i];
+                _child_begin.push_back((uint32_t)order.size());
+                order.insert(order.end(), children.begin() + child_begin[handle], children.begin() + child_begin[handle + 1]);
+            }
+            if (!order.empty()) {
+                _depth_begin.push_back(order.size());
+            }
+            _child_begin.push_back((uint32_t)order.size());
+
+            std::vector<uint32_t> new_slots(count);
+            for (size_t slot = 0; slot < count; ++slot) {
+                new_slots[order[slot]] = (uint32_t)slot;
+            }
+            std::vector<float> permuted(count);
+            for (size_t c = 0; c < _s_LOCAL_COMPONENTS; ++c) {
+                for (size_t slot = 0; slot < count; ++slot) {
+                    permuted[slot] = _local[c][_slots[order[slot]]];
+                }
+                _local[c].swap(permuted);
+            }
+            _slots.swap(new_slots);
+            _handles = order;
+
+            _parents.resize(count);
+            for (size_t slot = 0; slot < count; ++slot) {
+                const TransformHandle parent = _parent_handles[order[slot]];
+                _parents[slot] = parent == NO_TRANSFORM ? (uint32_t)count : _slots[parent];
+            }
+            const float identity_world[_s_WORLD_COMPONENTS] = { 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0 };
+            for (size_t c = 0; c < _s_WORLD_COMPONENTS; ++c) {
+                _world[c].assign(count + 1, identity_world[c]);
+            }
+            for (size_t c = 0; c < _s_NORMAL_COMPONENTS; ++c) {
+                _normal[c].assign(count + 1, identity_world[c]);
+            }
+            _dirty.assign(count, 1);
+            _dirty_slots.resize(count);
+            std::iota(_dirty_slots.begin(), _dirty_slots.end(), 0u);
+            _sorted = true;
+        }
+
+        void TransformHierarchy::updateRanges(const SlotRange* begin, const SlotRange* end) {
+            Columns columns;
+            for (size_t c = 0; c < _s_LOCAL_COMPONENTS; ++c) {
+                columns._local[c] = _local[c].data();
+            }
+            for (size_t c = 0; c < _s_WORLD_COMPONENTS; ++c) {
+                columns._world[c] = _world[c].data();
+            }
+            for (size_t c = 0; c < _s_NORMAL_COMPONENTS; ++c) {
+                columns._normal[c] = _normal[c].data();
+            }
+            columns._parents = _parents.data();
+
+            for (const SlotRange* range = begin; range != end; ++range) {
+                size_t i = range->_begin;
+                for (; i + SseTraits::WIDTH <= range->_end; i += SseTraits::WIDTH) {
+                    updateNodes<SseTraits>(columns, i);
+                }
+                for (; i < range->_end; ++i) {
+                    updateNodes<ScalarTraits>(columns, i);
+                }
+            }
+        }
+
+        // Depth by depth, the nodes to recompute are the nodes set at that depth and the children of the nodes
+        // recomputed one depth above. Children of consecutive slots are consecutive, so both stay lists of ranges
+        // and nothing outside them is read
+        size_t TransformHierarchy::update() {
+            if (!_sorted) {
+                sortByDepth();
+            }
+            if (_dirty_slots.empty()) {
+                return 0;
+            }
+
+            std::sort(_dirty_slots.begin(), _dirty_slots.end());
+            size_t updated = 0;
+            size_t next_dirty = 0;
+            _ranges.clear();
+            for (size_t depth = 0; depth + 1 < _depth_begin.size(); ++depth) {
+                const size_t depth_end = _depth_begin[depth + 1];
+                _next_ranges.clear();
+                auto append = [&](SlotRange range) {
+                    if (range._begin == range._end) {
+                        return;
+                    }
+                    if (!_next_ranges.empty() && range._begin <= _next_ranges.back()._end) {
+                        _next_ranges.back()._end = std::max(_next_ranges.back()._end, range._end);
+                    } else {
+                        _next_ranges.push_back(range);
+                    }
+                };
+                size_t parent = 0;
+                for (;;) {
+                    const bool dirty = next_dirty < _dirty_slots.size() && _dirty_slots[next_dirty] < depth_end;
+                    if (parent < _ranges.size() && (!dirty || _child_begin[_ranges[parent]._begin] <= _dirty_slots[next_dirty])) {
+                        append({ _child_begin[_ranges[parent]._begin], _child_begin[_ranges[parent]._end] });
+                        ++parent;
+                    } else if (dirty) {
+                        append({ _dirty_slots[next_dirty], _dirty_slots[next_dirty] + 1 });
+                        ++next_dirty;
+                    } else {
+                        break;
+                    }
+                }
+                _ranges.swap(_next_ranges);
+                if (_ranges.empty()) {
+                    if (next_dirty == _dirty_slots.size()) {
+                        break;
+                    }
+                    continue;
+                }
+
+                size_t count = 0;
+                for (const SlotRange& range : _ranges) {
+                    count += range._end - range._begin;
+                }
+                updated += count;
+                if (count <= _s_UPDATE_CHUNK_SIZE) {
+                    updateRanges(_ranges.data(), _ranges.data() + _ranges.size());
+                    continue;
+                }
+
+                // Long ranges are cut, then consecutive pieces are grouped into items of about the chunk size
+                _chunks.clear();
+                _chunk_begin.assign(1, 0);
+                size_t chunk_count = 0;
+                for (const SlotRange& range : _ranges) {
+                    for (uint32_t begin = range._begin; begin < range._end;) {
+                        const uint32_t end = (uint32_t)std::min<size_t>(range._end, begin + _s_UPDATE_CHUNK_SIZE - chunk_count);
+                        _chunks.push_back({ begin, end });
+                        chunk_count += end - begin;
+                        begin = end;
+                        if (chunk_count == _s_UPDATE_CHUNK_SIZE) {
+                            _chunk_begin.push_back(_chunks.size());
+                            chunk_count = 0;
+                        }
+                    }
+                }
+                if (chunk_count > 0) {
+                    _chunk_begin.push_back(_chunks.size());
+                }
+                software::parallelFor(_chunk_begin.size() - 1, [&](size_t chunk) {
+                    updateRanges(_chunks.data() + _chunk_begin[chunk], _chunks.data() + _chunk_begin[chunk + 1]);
+                });
+            }
+
+            for (uint32_t slot : _dirty_slots) {
+                _dirty[slot] = 0;
+            }
+            _dirty_slots.clear();
+            return updated;
+        }
+
+        XMMATRIX TransformHierarchy::getWorld(TransformHandle node) const {
+            const uint32_t slot = _slots[node];
+            return XMMATRIX(
+                _world[0][slot], _world[1][slot], _world[2][slot], 0.0f,
+                _world[3][slot], _world[4][slot], _world[5][slot], 0.0f,
+                _world[6][slot], _world[7][slot], _world[8][slot], 0.0f,
+                _world[9][slot], _world[10][slot], _world[11][slot], 1.0f);
+        }
+
+        XMMATRIX TransformHierarchy::getNormal(TransformHandle node) const {
+            const uint32_t slot = _slots[node];
+            return XMMATRIX(
+                _normal[0][slot], _normal[1][slot], _normal[2][slot], 0.0f,
+                _normal[3][slot], _normal[4][slot], _normal[5][slot], 0.0f,
+                _normal[6][slot], _normal[7][slot], _normal[8][slot], 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f);
+        }
+
+        size_t TransformHierarchy::size() const {
+            return _parent_handles.size();
+        }
+
+        size_t TransformHierarchy::getDepthCount() const {
+            return _depth_begin.empty() ? 0 : _depth_begin.size() - 1;
+        }
+    }
+}
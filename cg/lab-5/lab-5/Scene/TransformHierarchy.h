@@ -0,0 +1,84 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace rendering {
+    namespace scene {
+        // Scale, then rotation, then translation, like XMMatrixScaling * XMMatrixRotationQuaternion * XMMatrixTranslation.
+        // The rotation has to be normalized and the scale must not have zero components
+        struct Transform {
+            DirectX::XMFLOAT3 _translation = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+            DirectX::XMFLOAT4 _rotation = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+            DirectX::XMFLOAT3 _scale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+        };
+
+        typedef uint32_t TransformHandle;
+        const TransformHandle NO_TRANSFORM = ~0u;
+
+        // Nodes are kept as structure of arrays in breadth first order, so every depth is one contiguous range and
+        // the children of a node follow each other. update only recomputes nodes whose local transform changed and
+        // their descendants, four at a time with SSE. Nodes of one depth only depend on the depth above, so large
+        // depths are split across threads
+        class TransformHierarchy {
+        public:
+            // A parent has to be added before its children
+            TransformHandle add(const Transform& local, TransformHandle parent = NO_TRANSFORM);
+            void setLocal(TransformHandle node, const Transform& local);
+            Transform getLocal(TransformHandle node) const;
+
+            // Returns how many nodes were recomputed
+            size_t update();
+
+            // Valid after update
+            DirectX::XMMATRIX getWorld(TransformHandle node) const;
+            // Inverse transpose of the world matrix without translation, for normals
+            DirectX::XMMATRIX getNormal(TransformHandle node) const;
+
+            size_t size() const;
+            size_t getDepthCount() const;
+
+        private:
+            static const size_t _s_LOCAL_COMPONENTS = 10;
+            static const size_t _s_WORLD_COMPONENTS = 12;
+            static const size_t _s_NORMAL_COMPONENTS = 9;
+            // Nodes per work item when a depth is split across threads
+            static const size_t _s_UPDATE_CHUNK_SIZE = 4096;
+
+            // Slots [_begin, _end) of one depth
+            struct SlotRange {
+                uint32_t _begin;
+                uint32_t _end;
+            };
+
+            void sortByDepth();
+            void updateRanges(const SlotRange* begin, const SlotRange* end);
+
+            // By handle, only needed to sort again when nodes are added
+            std::vector<TransformHandle> _parent_handles;
+            bool _sorted = true;
+
+            std::vector<uint32_t> _slots;
+            std::vector<TransformHandle> _handles;
+            std::vector<size_t> _depth_begin;
+
+            // By slot. Parents of roots point to one identity node past the end
+            std::vector<uint32_t> _parents;
+            // The children of a slot are the slots [_child_begin[slot], _child_begin[slot + 1])
+            std::vector<uint32_t> _child_begin;
+            std::vector<float> _local[_s_LOCAL_COMPONENTS];
+            std::vector<float> _world[_s_WORLD_COMPONENTS];
+            std::vector<float> _normal[_s_NORMAL_COMPONENTS];
+            std::vector<uint8_t> _dirty;
+            // Every slot set since the last update once, so update costs what changed and not the whole hierarchy
+            std::vector<uint32_t> _dirty_slots;
+            // Scratch of update: the sorted, disjoint ranges recomputed at one depth, and the work items of a depth
+            std::vector<SlotRange> _ranges;
+            std::vector<SlotRange> _next_ranges;
+            std::vector<SlotRange> _chunks;
+            std::vector<size_t> _chunk_begin;
+        };
+    }
+}
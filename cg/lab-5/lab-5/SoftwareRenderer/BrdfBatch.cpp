@@ -0,0 +1,170 @@
+#include "BrdfBatch.h"
+
+#include <cassert>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "BrdfKernels.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            const size_t AMBIENT_TERMS = 7;
+
+            void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+                __cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+                __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+            }
+
+            unsigned long long xgetbv() {
+#if defined(_MSC_VER)
+                return _xgetbv(0);
+#else
+                unsigned eax, edx;
+                __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                return ((unsigned long long)edx << 32) | eax;
+#endif
+            }
+
+            SimdLevel detectSimdLevel() {
+                unsigned regs[4];
+                cpuid(0, 0, regs);
+                const unsigned max_leaf = regs[0];
+
+                cpuid(1, 0, regs);
+                const bool sse4 = (regs[2] & (1u << 19)) != 0;
+                const bool osxsave = (regs[2] & (1u << 27)) != 0;
+                const bool avx = (regs[2] & (1u << 28)) != 0;
+                if (!sse4) {
+                    return SimdLevel::SCALAR;
+                }
+                if (!osxsave || !avx || max_leaf < 7) {
+                    return SimdLevel::SSE4;
+                }
+
+                // The OS has to save the YMM (and for AVX-512 the opmask and ZMM) state on context switches
+                const unsigned long long xcr0 = xgetbv();
+                const bool ymm_state = (xcr0 & 0x6) == 0x6;
+                const bool zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+                cpuid(7, 0, regs);
+                const bool avx2 = (regs[1] & (1u << 5)) != 0;
+                const bool avx512f = (regs[1] & (1u << 16)) != 0;
+                if (avx512f && zmm_state) {
+                    return SimdLevel::AVX512;
+                }
+                if (avx2 && ymm_state) {
+                    return SimdLevel::AVX2;
+                }
+                return SimdLevel::SSE4;
+            }
+
+            const BrdfKernelTable& getKernels(SimdLevel level) {
+                assert(isSimdLevelSupported(level));
+                switch (level) {
+                case SimdLevel::SSE4:
+                    return getSse4BrdfKernels();
+                case SimdLevel::AVX2:
+                    return getAvx2BrdfKernels();
+                case SimdLevel::AVX512:
+                    return getAvx512BrdfKernels();
+                default:
+                    return getScalarBrdfKernels();
+                }
+            }
+
+            // Full vectors go to the requested level, the remainder to the scalar kernel
+            void run(BrdfKernel BrdfKernelTable::*kernel, const BrdfBatch& batch, const SurfacePropsCB& sprops, float* const* out, SimdLevel level) {
+                const BrdfKernelTable& kernels = getKernels(level);
+                const size_t vector_end = batch._count - batch._count % kernels._width;
+                if (vector_end > 0) {
+                    (kernels.*kernel)(batch, sprops, 0, vector_end, out);
+                }
+                if (vector_end < batch._count) {
+                    (getScalarBrdfKernels().*kernel)(batch, sprops, vector_end, batch._count, out);
+                }
+            }
+        }
+
+        SimdLevel getSimdLevel() {
+            static const SimdLevel level = detectSimdLevel();
+            return level;
+        }
+
+        bool isSimdLevelSupported(SimdLevel level) {
+            return (int)level <= (int)getSimdLevel();
+        }
+
+        const char* getSimdLevelName(SimdLevel level) {
+            switch (level) {
+            case SimdLevel::SSE4:
+                return "SSE4.1";
+            case SimdLevel::AVX2:
+                return "AVX2";
+            case SimdLevel::AVX512:
+                return "AVX-512";
+            default:
+                return "Scalar";
+            }
+        }
+
+        size_t getSimdWidth(SimdLevel level) {
+            return getKernels(level)._width;
+        }
+
+        void batchNdf(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* out, SimdLevel level) {
+            run(&BrdfKernelTable::_ndf, batch, sprops, &out, level);
+        }
+
+        void batchGeometry(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* out, SimdLevel level) {
+            run(&BrdfKernelTable::_geometry, batch, sprops, &out, level);
+        }
+
+        void batchFresnel(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* const out[3], SimdLevel level) {
+            run(&BrdfKernelTable::_fresnel, batch, sprops, out, level);
+        }
+
+        void batchBrdf(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* const out[3], SimdLevel level) {
+            run(&BrdfKernelTable::_brdf, batch, sprops, out, level);
+        }
+
+        void batchAmbient(const BrdfBatch& batch, const SurfacePropsCB& sprops, const ShaderResources& resources, float* const out[3], SimdLevel level) {
+            std::vector<float> terms(AMBIENT_TERMS * batch._count);
+            float* term_arrays[AMBIENT_TERMS];
+            for (size_t i = 0; i < AMBIENT_TERMS; ++i) {
+                term_arrays[i] = terms.data() + i * batch._count;
+            }
+            run(&BrdfKernelTable::_ambient_terms, batch, sprops, term_arrays, level);
+
+            const float MAX_REFLECTION_LOD = 4.0f;
+            const XMVECTOR base_color = XMVectorSet(sprops._base_color.x, sprops._base_color.y, sprops._base_color.z, 0.0f);
+            const XMVECTOR f0 = XMVectorLerp(XMVectorReplicate(0.04f), base_color, sprops._metalness);
+            for (size_t i = 0; i < batch._count; ++i) {
+                const XMVECTOR r = XMVectorSet(term_arrays[0][i], term_arrays[1][i], term_arrays[2][i], 0.0f);
+                const XMVECTOR n = XMVectorSet(batch._normal[0][i], batch._normal[1][i], batch._normal[2][i], 0.0f);
+                const XMVECTOR k_d = XMVectorSet(term_arrays[4][i], term_arrays[5][i], term_arrays[6][i], 0.0f);
+
+                XMVECTOR prefiltered_color = resources._prefiltered->sampleLevel(r, sprops._roughness * MAX_REFLECTION_LOD);
+                XMVECTOR env_brdf = resources._preintegrated->sample(term_arrays[3][i], sprops._roughness, AddressMode::CLAMP);
+                XMVECTOR specular = prefiltered_color * (f0 * XMVectorGetX(env_brdf) + XMVectorSplatY(env_brdf));
+                XMVECTOR diffuse = resources._irradiance->sampleLevel(n, 0.0f) * base_color;
+
+                XMFLOAT3 color;
+                XMStoreFloat3(&color, k_d * diffuse + specular);
+                out[0][i] = color.x;
+                out[1][i] = color.y;
+                out[2][i] = color.z;
+            }
+        }
+    }
+}
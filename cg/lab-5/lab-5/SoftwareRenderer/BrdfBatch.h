@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../ConstantBuffer.h"
+
+#include "ShaderPorts.h"
+
+// Cook-Torrance terms of shaders.hlsl evaluated over structure-of-arrays batches of shading
+// points. Every kernel follows the shader conventions (k = (r + 1)^2 / 8, the EPSILON clamps)
+// and matches the scalar ports in ShaderPorts.h up to rounding.
+namespace rendering {
+    namespace software {
+        enum class SimdLevel {
+            SCALAR,
+            SSE4,
+            AVX2,
+            AVX512,
+        };
+
+        // Best level supported by the CPU and the OS, detected once
+        SimdLevel getSimdLevel();
+        bool isSimdLevelSupported(SimdLevel level);
+        const char* getSimdLevelName(SimdLevel level);
+        size_t getSimdWidth(SimdLevel level);
+
+        // Directions are normalized and point away from the surface, as in psPBR.
+        // _light_dir is only read by the kernels that need it.
+        struct BrdfBatch {
+            size_t _count = 0;
+            const float* _normal[3] = {};
+            const float* _light_dir[3] = {};
+            const float* _camera_dir[3] = {};
+        };
+
+        void batchNdf(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* out, SimdLevel level = getSimdLevel());
+        void batchGeometry(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* out, SimdLevel level = getSimdLevel());
+        void batchFresnel(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* const out[3], SimdLevel level = getSimdLevel());
+        void batchBrdf(const BrdfBatch& batch, const SurfacePropsCB& sprops, float* const out[3], SimdLevel level = getSimdLevel());
+
+        // The Fresnel and reflection terms are vectorized, the texture fetches run per point
+        void batchAmbient(const BrdfBatch& batch, const SurfacePropsCB& sprops, const ShaderResources& resources, float* const out[3], SimdLevel level = getSimdLevel());
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+#include "../ConstantBuffer.h"
+
+namespace rendering {
+    namespace software {
+        struct BrdfBatch;
+
+        // Evaluates the points [begin, end) of a batch; end - begin is a multiple of the table width
+        using BrdfKernel = void (*)(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out);
+
+        // Output layout per kernel:
+        //   _ndf, _geometry: out[0]
+        //   _fresnel, _brdf: out[0..2] (rgb)
+        //   _ambient_terms: out[0..2] reflection direction, out[3] max(n.v, 0), out[4..6] k_d
+        struct BrdfKernelTable {
+            size_t _width;
+            BrdfKernel _ndf;
+            BrdfKernel _geometry;
+            BrdfKernel _fresnel;
+            BrdfKernel _brdf;
+            BrdfKernel _ambient_terms;
+        };
+
+        const BrdfKernelTable& getScalarBrdfKernels();
+        const BrdfKernelTable& getSse4BrdfKernels();
+        const BrdfKernelTable& getAvx2BrdfKernels();
+        const BrdfKernelTable& getAvx512BrdfKernels();
+    }
+}
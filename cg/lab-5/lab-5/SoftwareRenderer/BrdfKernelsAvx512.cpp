@@ -0,0 +1,43 @@
+#include "BrdfKernels.h"
+
+#include <immintrin.h>
+
+#include "BrdfBatch.h"
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+
+#include "BrdfKernelsImpl.h"
+
+namespace rendering {
+    namespace software {
+        namespace {
+            struct Avx512Traits {
+                using Vec = __m512;
+                static const size_t WIDTH = 16;
+
+                static Vec set(float x) { return _mm512_set1_ps(x); }
+                static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+                static void store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+                static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+                static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+                static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+                static Vec min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+                static Vec max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+                static Vec sqrt(Vec a) { return _mm512_sqrt_ps(a); }
+            };
+        }
+
+        const BrdfKernelTable& getAvx512BrdfKernels() {
+            static const BrdfKernelTable table = BrdfKernelsImpl<Avx512Traits>::getTable();
+            return table;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "BrdfBatch.h"
+#include "BrdfKernels.h"
+
+// Kernel bodies shared by the BrdfKernels*.cpp files. Each of them instantiates BrdfKernelsImpl
+// with its vector traits (Vec, WIDTH, set, load, store, add, sub, mul, div, min, max, sqrt).
+// GCC and Clang need the target instruction set enabled per file: those files include every other
+// header first and only then switch the target, so that no inline function compiled for AVX can
+// be chosen by the linker for code that runs on older CPUs. MSVC accepts the intrinsics as is.
+namespace rendering {
+    namespace software {
+        namespace {
+            template <typename T>
+            struct BrdfKernelsImpl {
+                using V = typename T::Vec;
+
+                struct Material {
+                    V _base_color[3];
+                    V _f0[3];
+                    V _roughness;
+                    V _roughness_squared;
+                    V _k;
+                    V _metalness;
+                };
+
+                static Material loadMaterial(const SurfacePropsCB& sprops) {
+                    const float* base_color = &sprops._base_color.x;
+                    const float roughness_squared = sprops._roughness * sprops._roughness;
+                    Material m;
+                    for (size_t c = 0; c < 3; ++c) {
+                        m._base_color[c] = T::set(base_color[c]);
+                        m._f0[c] = T::set((1.0f - sprops._metalness) * 0.04f + sprops._metalness * base_color[c]);
+                    }
+                    m._roughness = T::set(sprops._roughness);
+                    m._roughness_squared = T::set(roughness_squared < EPSILON ? EPSILON : (roughness_squared > 1.0f ? 1.0f : roughness_squared));
+                    m._k = T::set((sprops._roughness + 1.0f) * (sprops._roughness + 1.0f) / 8.0f);
+                    m._metalness = T::set(sprops._metalness);
+                    return m;
+                }
+
+                static void load3(const float* const p[3], size_t i, V v[3]) {
+                    for (size_t c = 0; c < 3; ++c) {
+                        v[c] = T::load(p[c] + i);
+                    }
+                }
+
+                static void store3(float* const* p, size_t i, const V v[3]) {
+                    for (size_t c = 0; c < 3; ++c) {
+                        T::store(p[c] + i, v[c]);
+                    }
+                }
+
+                static V dot3(const V a[3], const V b[3]) {
+                    return T::add(T::add(T::mul(a[0], b[0]), T::mul(a[1], b[1])), T::mul(a[2], b[2]));
+                }
+
+                static V saturate(V x) {
+                    return T::min(T::max(x, T::set(0.0f)), T::set(1.0f));
+                }
+
+                static V pow5(V x) {
+                    V x2 = T::mul(x, x);
+                    return T::mul(T::mul(x2, x2), x);
+                }
+
+                static void halfway(const V l[3], const V v[3], V h[3]) {
+                    V s[3] = { T::add(l[0], v[0]), T::add(l[1], v[1]), T::add(l[2], v[2]) };
+                    V length = T::sqrt(dot3(s, s));
+                    for (size_t c = 0; c < 3; ++c) {
+                        h[c] = T::div(s[c], length);
+                    }
+                }
+
+                static V ndf(const V n[3], const V h[3], const Material& m) {
+                    V n_dot_h = saturate(dot3(n, h));
+                    V denominator = T::add(T::mul(T::mul(n_dot_h, n_dot_h), T::sub(m._roughness_squared, T::set(1.0f))), T::set(1.0f));
+                    return T::div(T::div(m._roughness_squared, T::set(PI)), T::mul(denominator, denominator));
+                }
+
+                static V schlickGGX(V dot_multiplier, V k) {
+                    return T::div(dot_multiplier, T::add(T::mul(dot_multiplier, T::sub(T::set(1.0f), k)), k));
+                }
+
+                // Both dot products are already saturated
+                static V geometry2dir(V l_dot_n, V v_dot_n, const Material& m) {
+                    return T::mul(schlickGGX(l_dot_n, m._k), schlickGGX(v_dot_n, m._k));
+                }
+
+                static void fresnel(const V v[3], const V h[3], const Material& m, V f[3]) {
+                    V t = pow5(T::sub(T::set(1.0f), saturate(dot3(v, h))));
+                    for (size_t c = 0; c < 3; ++c) {
+                        f[c] = T::add(m._f0[c], T::mul(T::sub(T::set(1.0f), m._f0[c]), t));
+                    }
+                }
+
+                static void ndfKernel(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out) {
+                    const Material m = loadMaterial(sprops);
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        V n[3], l[3], v[3], h[3];
+                        load3(batch._normal, i, n);
+                        load3(batch._light_dir, i, l);
+                        load3(batch._camera_dir, i, v);
+                        halfway(l, v, h);
+                        T::store(out[0] + i, ndf(n, h, m));
+                    }
+                }
+
+                static void geometryKernel(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out) {
+                    const Material m = loadMaterial(sprops);
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        V n[3], l[3], v[3];
+                        load3(batch._normal, i, n);
+                        load3(batch._light_dir, i, l);
+                        load3(batch._camera_dir, i, v);
+                        T::store(out[0] + i, geometry2dir(saturate(dot3(n, l)), saturate(dot3(n, v)), m));
+                    }
+                }
+
+                static void fresnelKernel(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out) {
+                    const Material m = loadMaterial(sprops);
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        V l[3], v[3], h[3], f[3];
+                        load3(batch._light_dir, i, l);
+                        load3(batch._camera_dir, i, v);
+                        halfway(l, v, h);
+                        fresnel(v, h, m, f);
+                        store3(out, i, f);
+                    }
+                }
+
+                static void brdfKernel(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out) {
+                    const Material m = loadMaterial(sprops);
+                    const V diffuse_scale = T::div(T::sub(T::set(1.0f), m._metalness), T::set(PI));
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        V n[3], l[3], v[3], h[3], f[3];
+                        load3(batch._normal, i, n);
+                        load3(batch._light_dir, i, l);
+                        load3(batch._camera_dir, i, v);
+                        halfway(l, v, h);
+
+                        const V l_dot_n = saturate(dot3(l, n));
+                        const V v_dot_n = saturate(dot3(v, n));
+                        const V d = ndf(n, h, m);
+                        const V g = geometry2dir(l_dot_n, v_dot_n, m);
+                        fresnel(v, h, m, f);
+
+                        const V specular_scale = T::div(T::mul(d, g), T::add(T::mul(T::mul(T::set(4.0f), l_dot_n), v_dot_n), T::set(EPSILON)));
+                        V result[3];
+                        for (size_t c = 0; c < 3; ++c) {
+                            const V f_lamb = T::mul(T::mul(T::sub(T::set(1.0f), f[c]), m._base_color[c]), diffuse_scale);
+                            result[c] = T::add(f_lamb, T::mul(f[c], specular_scale));
+                        }
+                        store3(out, i, result);
+                    }
+                }
+
+                static void ambientTermsKernel(const BrdfBatch& batch, const SurfacePropsCB& sprops, size_t begin, size_t end, float* const* out) {
+                    const Material m = loadMaterial(sprops);
+                    // lerp(0.04, base_color, metalness) is the same F0 as fresnelFunction uses
+                    V f_max[3];
+                    for (size_t c = 0; c < 3; ++c) {
+                        f_max[c] = T::max(T::sub(T::set(1.0f), m._roughness), m._f0[c]);
+                    }
+                    for (size_t i = begin; i < end; i += T::WIDTH) {
+                        V n[3], v[3];
+                        load3(batch._normal, i, n);
+                        load3(batch._camera_dir, i, v);
+
+                        const V n_dot_v = dot3(n, v);
+                        V r[3];
+                        for (size_t c = 0; c < 3; ++c) {
+                            r[c] = T::sub(T::mul(T::mul(T::set(2.0f), n_dot_v), n[c]), v[c]);
+                        }
+                        const V length = T::sqrt(dot3(r, r));
+                        for (size_t c = 0; c < 3; ++c) {
+                            r[c] = T::div(r[c], length);
+                        }
+
+                        const V t = pow5(T::sub(T::set(1.0f), saturate(n_dot_v)));
+                        V k_d[3];
+                        for (size_t c = 0; c < 3; ++c) {
+                            const V f = T::add(m._f0[c], T::mul(T::sub(f_max[c], m._f0[c]), t));
+                            k_d[c] = T::mul(T::sub(T::set(1.0f), f), T::sub(T::set(1.0f), m._metalness));
+                        }
+
+                        store3(out, i, r);
+                        T::store(out[3] + i, T::max(n_dot_v, T::set(0.0f)));
+                        store3(out + 4, i, k_d);
+                    }
+                }
+
+                static BrdfKernelTable getTable() {
+                    return { T::WIDTH, &ndfKernel, &geometryKernel, &fresnelKernel, &brdfKernel, &ambientTermsKernel };
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#include "BrdfKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BrdfBatch.h"
+#include "BrdfKernelsImpl.h"
+
+namespace rendering {
+    namespace software {
+        namespace {
+            struct ScalarTraits {
+                using Vec = float;
+                static const size_t WIDTH = 1;
+
+                static Vec set(float x) { return x; }
+                static Vec load(const float* p) { return *p; }
+                static void store(float* p, Vec v) { *p = v; }
+                static Vec add(Vec a, Vec b) { return a + b; }
+                static Vec sub(Vec a, Vec b) { return a - b; }
+                static Vec mul(Vec a, Vec b) { return a * b; }
+                static Vec div(Vec a, Vec b) { return a / b; }
+                static Vec min(Vec a, Vec b) { return std::min(a, b); }
+                static Vec max(Vec a, Vec b) { return std::max(a, b); }
+                static Vec sqrt(Vec a) { return sqrtf(a); }
+            };
+        }
+
+        const BrdfKernelTable& getScalarBrdfKernels() {
+            static const BrdfKernelTable table = BrdfKernelsImpl<ScalarTraits>::getTable();
+            return table;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#include "BrdfKernels.h"
+
+#include <immintrin.h>
+
+#include "BrdfBatch.h"
+
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+
+#include "BrdfKernelsImpl.h"
+
+namespace rendering {
+    namespace software {
+        namespace {
+            struct Sse4Traits {
+                using Vec = __m128;
+                static const size_t WIDTH = 4;
+
+                static Vec set(float x) { return _mm_set1_ps(x); }
+                static Vec load(const float* p) { return _mm_loadu_ps(p); }
+                static void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+                static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+                static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+                static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+                static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+                static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+                static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+                static Vec sqrt(Vec a) { return _mm_sqrt_ps(a); }
+            };
+        }
+
+        const BrdfKernelTable& getSse4BrdfKernels() {
+            static const BrdfKernelTable table = BrdfKernelsImpl<Sse4Traits>::getTable();
+            return table;
+        }
+    }
+}
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
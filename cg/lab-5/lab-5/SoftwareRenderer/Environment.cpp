@@ -0,0 +1,70 @@
+#include "Environment.h"
+
+#include "ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            // Evaluates f(dir, mip_level) at every texel center, like createCubeMap does with a quad per face
+            template <typename F>
+            TextureCube bakeCubeMap(size_t size, size_t mip_levels, const F& f) {
+                TextureCube cube(size, mip_levels);
+                parallelFor(6 * mip_levels, [&](size_t i) {
+                    size_t face = i / mip_levels;
+                    size_t mip_level = i % mip_levels;
+                    Texture2D& texture = cube.getFace(face, mip_level);
+                    size_t mip_size = texture.getWidth();
+                    for (size_t y = 0; y < mip_size; ++y) {
+                        for (size_t x = 0; x < mip_size; ++x) {
+                            XMVECTOR dir = TextureCube::texelDirection(face, (x + 0.5f) / mip_size, (y + 0.5f) / mip_size);
+                            XMStoreFloat4(&texture.at(x, y), f(dir, mip_level));
+                        }
+                    }
+                });
+                return cube;
+            }
+        }
+
+        ShaderResources EnvironmentMaps::getResources() const {
+            ShaderResources resources;
+            resources._sky = &_sky;
+            resources._irradiance = &_irradiance;
+            resources._prefiltered = &_prefiltered;
+            resources._preintegrated = &_preintegrated;
+            return resources;
+        }
+
+        EnvironmentMaps bakeEnvironment(const Texture2D& equirect, const EnvironmentBakeDesc& desc) {
+            EnvironmentMaps maps;
+
+            maps._sky = bakeCubeMap(desc._sky_size, desc._sky_mip_levels, [&](FXMVECTOR dir, size_t) {
+                return psCubeMap(dir, equirect);
+            });
+
+            maps._irradiance = bakeCubeMap(desc._irradiance_size, 1, [&](FXMVECTOR dir, size_t) {
+                return psIrradianceMap(dir, maps._sky, desc._irradiance_n1, desc._irradiance_n2);
+            });
+
+            const size_t prefiltered_mip_levels = desc._prefiltered_mip_levels;
+            maps._prefiltered = bakeCubeMap(desc._prefiltered_size, prefiltered_mip_levels, [&](FXMVECTOR dir, size_t mip_level) {
+                float roughness = prefiltered_mip_levels > 1 ? (float)mip_level / (prefiltered_mip_levels - 1) : 0.0f;
+                return psPrefilteredColor(dir, roughness, maps._sky, desc._prefiltered_samples);
+            });
+
+            // The GPU bake runs right after the last prefiltered mip, so SurfaceProps still holds roughness 1
+            const float geometry_roughness = 1.0f;
+            const size_t size = desc._preintegrated_size;
+            maps._preintegrated = Texture2D(size, size);
+            parallelFor(size, [&](size_t y) {
+                for (size_t x = 0; x < size; ++x) {
+                    XMFLOAT2 ab = IntegrateBRDF((x + 0.5f) / size, (y + 0.5f) / size, geometry_roughness, desc._preintegrated_samples);
+                    maps._preintegrated.at(x, y) = XMFLOAT4(ab.x, ab.y, 0.0f, 1.0f);
+                }
+            });
+
+            return maps;
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ShaderPorts.h"
+#include "Texture.h"
+
+namespace rendering {
+    namespace software {
+        // Sizes match Renderer::initScene. The irradiance integral defaults to far fewer
+        // samples than psIrradianceMap (800 x 200), which would take minutes on a CPU.
+        struct EnvironmentBakeDesc {
+            size_t _sky_size = 512;
+            size_t _sky_mip_levels = 10;
+            size_t _irradiance_size = 32;
+            size_t _irradiance_n1 = 100;
+            size_t _irradiance_n2 = 25;
+            size_t _prefiltered_size = 128;
+            size_t _prefiltered_mip_levels = 5;
+            unsigned _prefiltered_samples = 1024;
+            size_t _preintegrated_size = 32;
+            unsigned _preintegrated_samples = 1024;
+        };
+
+        struct EnvironmentMaps {
+            ShaderResources getResources() const;
+
+            TextureCube _sky;
+            TextureCube _irradiance;
+            TextureCube _prefiltered;
+            Texture2D _preintegrated;
+        };
+
+        EnvironmentMaps bakeEnvironment(const Texture2D& equirect, const EnvironmentBakeDesc& desc = EnvironmentBakeDesc());
+    }
+}
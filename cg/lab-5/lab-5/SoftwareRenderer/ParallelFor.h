@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace rendering {
+    namespace software {
+        namespace detail {
+            inline size_t& threadBudget() {
+                thread_local size_t budget = 0;
+                return budget;
+            }
+        }
+
+        // Threads that work started from the calling thread may use, zero for all hardware threads. Work that
+        // runs side by side, like the jobs of the batch tool, sets its share so the machine is not oversubscribed
+        inline void setThreadBudget(size_t n_threads) {
+            detail::threadBudget() = n_threads;
+        }
+
+        inline size_t getThreadBudget() {
+            const size_t budget = detail::threadBudget();
+            return budget > 0 ? budget : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Runs f(i) for every i in [0, count) on the thread budget of the caller. Work items are
+        // handed out one at a time, so uneven items (tiles, rows) balance themselves.
+        template <typename F>
+        void parallelFor(size_t count, const F& f) {
+            size_t n_threads = std::min<size_t>(getThreadBudget(), count);
+            if (n_threads <= 1) {
+                for (size_t i = 0; i < count; ++i) {
+                    f(i);
+                }
+                return;
+            }
+
+            std::atomic<size_t> next(0);
+            auto worker = [&]() {
+                for (size_t i = next++; i < count; i = next++) {
+                    f(i);
+                }
+            };
+
+            std::vector<std::thread> threads;
+            threads.reserve(n_threads - 1);
+            for (size_t i = 0; i + 1 < n_threads; ++i) {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+    }
+}
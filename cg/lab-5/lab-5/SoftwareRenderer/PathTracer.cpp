@@ -0,0 +1,387 @@
+#include "PathTracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "ShaderPorts.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            const float RAY_OFFSET = 1e-4f;
+            const float MIN_LUMINANCE = 1e-4f;
+            const unsigned RUSSIAN_ROULETTE_DEPTH = 3;
+
+            float dot3(FXMVECTOR a, FXMVECTOR b) {
+                return XMVectorGetX(XMVector3Dot(a, b));
+            }
+
+            float luminance(FXMVECTOR color) {
+                XMFLOAT3 c;
+                XMStoreFloat3(&c, color);
+                return 0.2126f * c.x + 0.7151f * c.y + 0.0722f * c.z;
+            }
+
+            XMVECTOR rgb(const XMFLOAT4& color) {
+                return XMVectorSet(color.x, color.y, color.z, 0.0f);
+            }
+
+            float powerHeuristic(float pdf, float other_pdf) {
+                float a = pdf * pdf;
+                float b = other_pdf * other_pdf;
+                return a + b > 0.0f ? a / (a + b) : 0.0f;
+            }
+
+            // The scene has one sphere, the one Renderer draws with an identity world matrix
+            bool intersectSphere(FXMVECTOR origin, FXMVECTOR dir, float& t) {
+                const float radius = 1.0f;
+                float b = dot3(origin, dir);
+                float c = dot3(origin, origin) - radius * radius;
+                float discriminant = b * b - c;
+                if (discriminant < 0.0f) {
+                    return false;
+                }
+                float root = sqrtf(discriminant);
+                t = -b - root;
+                if (t <= RAY_OFFSET) {
+                    t = -b + root;
+                }
+                return t > RAY_OFFSET;
+            }
+
+            void tangentFrame(FXMVECTOR n, XMVECTOR& tangent, XMVECTOR& bitangent) {
+                XMVECTOR up = fabsf(XMVectorGetZ(n)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+                tangent = XMVector3Normalize(XMVector3Cross(up, n));
+                bitangent = XMVector3Cross(n, tangent);
+            }
+
+            // Samples the distribution of ndf(), whose alpha is the roughness itself. ImportanceSampleGGX
+            // squares the roughness once more, so it cannot be used as the pdf of ndf().
+            XMVECTOR sampleHalfway(FXMVECTOR n, float roughness, float u1, float u2) {
+                float alpha_squared = std::clamp(roughness * roughness, EPSILON, 1.0f);
+                float phi = 2.0f * PI * u1;
+                float cos_theta = sqrtf((1.0f - u2) / (1.0f + (alpha_squared - 1.0f) * u2));
+                float sin_theta = sqrtf(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+                XMVECTOR tangent, bitangent;
+                tangentFrame(n, tangent, bitangent);
+                return XMVector3Normalize(tangent * (cosf(phi) * sin_theta) + bitangent * (sinf(phi) * sin_theta) + n * cos_theta);
+            }
+
+            XMVECTOR sampleCosine(FXMVECTOR n, float u1, float u2) {
+                float phi = 2.0f * PI * u1;
+                float r = sqrtf(u2);
+                XMVECTOR tangent, bitangent;
+                tangentFrame(n, tangent, bitangent);
+                return XMVector3Normalize(tangent * (r * cosf(phi)) + bitangent * (r * sinf(phi)) + n * sqrtf(std::max(0.0f, 1.0f - u2)));
+            }
+
+            // Probability of picking the specular lobe, from the Fresnel weight at normal incidence of v
+            float specularProbability(FXMVECTOR n, FXMVECTOR v, const SurfacePropsCB& sprops) {
+                XMVECTOR f = fresnelFunction(v, n, sprops);
+                float specular = luminance(f);
+                float diffuse = luminance((XMVectorReplicate(1.0f) - f) * (1.0f - sprops._metalness) * rgb(sprops._base_color));
+                return std::clamp(specular / (specular + diffuse + 1e-6f), 0.1f, 0.9f);
+            }
+
+            float brdfPdf(FXMVECTOR n, FXMVECTOR v, FXMVECTOR l, const SurfacePropsCB& sprops, float p_specular) {
+                float n_dot_l = dot3(n, l);
+                if (n_dot_l <= 0.0f) {
+                    return 0.0f;
+                }
+                XMVECTOR h = XMVector3Normalize(v + l);
+                float v_dot_h = std::max(dot3(v, h), 1e-6f);
+                float specular_pdf = ndf(n, h, sprops._roughness) * std::max(dot3(n, h), 0.0f) / (4.0f * v_dot_h);
+                float diffuse_pdf = n_dot_l / PI;
+                return p_specular * specular_pdf + (1.0f - p_specular) * diffuse_pdf;
+            }
+
+            void directionToEquirect(FXMVECTOR dir, float& u, float& v) {
+                XMFLOAT3 n;
+                XMStoreFloat3(&n, XMVector3Normalize(dir));
+                u = 1.0f - atan2f(n.z, n.x) / (2 * PI);
+                v = 0.5f - asinf(std::clamp(n.y, -1.0f, 1.0f)) / PI;
+            }
+        }
+
+        EnvironmentSampler::EnvironmentSampler(const Texture2D& equirect)
+            : _equirect(equirect), _width(equirect.getWidth()), _height(equirect.getHeight()),
+              _marginal_cdf(_height + 1), _conditional_cdf((_width + 1) * _height), _texel_pdf(_width * _height) {
+            std::vector<float> row_weights(_height);
+            for (size_t y = 0; y < _height; ++y) {
+                float cos_latitude = cosf(((y + 0.5f) / _height - 0.5f) * PI);
+                float* cdf = &_conditional_cdf[y * (_width + 1)];
+                cdf[0] = 0.0f;
+                for (size_t x = 0; x < _width; ++x) {
+                    const XMFLOAT4& texel = equirect.at(x, y);
+                    float weight = (0.2126f * texel.x + 0.7151f * texel.y + 0.0722f * texel.z + 1e-6f) * cos_latitude;
+                    _texel_pdf[y * _width + x] = weight;
+                    cdf[x + 1] = cdf[x] + weight;
+                }
+                row_weights[y] = cdf[_width];
+                for (size_t x = 1; x <= _width; ++x) {
+                    cdf[x] /= row_weights[y];
+                }
+            }
+
+            _marginal_cdf[0] = 0.0f;
+            for (size_t y = 0; y < _height; ++y) {
+                _marginal_cdf[y + 1] = _marginal_cdf[y] + row_weights[y];
+            }
+            const float total = _marginal_cdf[_height];
+            for (size_t y = 1; y <= _height; ++y) {
+                _marginal_cdf[y] /= total;
+            }
+            for (float& p : _texel_pdf) {
+                p /= total;
+            }
+        }
+
+        XMVECTOR EnvironmentSampler::radiance(FXMVECTOR dir) const {
+            return psCubeMap(dir, _equirect);
+        }
+
+        XMVECTOR EnvironmentSampler::sample(float u1, float u2, float& pdf) const {
+            size_t y = std::min<size_t>(std::upper_bound(_marginal_cdf.begin() + 1, _marginal_cdf.end(), u1) - _marginal_cdf.begin() - 1, _height - 1);
+            const float* cdf = &_conditional_cdf[y * (_width + 1)];
+            size_t x = std::min<size_t>(std::upper_bound(cdf + 1, cdf + _width + 1, u2) - cdf - 1, _width - 1);
+
+            // Reuse the leftover of each random number to place the direction inside the texel
+            float du = (u2 - cdf[x]) / std::max(cdf[x + 1] - cdf[x], 1e-12f);
+            float dv = (u1 - _marginal_cdf[y]) / std::max(_marginal_cdf[y + 1] - _marginal_cdf[y], 1e-12f);
+            float u = (x + std::clamp(du, 0.0f, 1.0f)) / _width;
+            float v = (y + std::clamp(dv, 0.0f, 1.0f)) / _height;
+
+            float latitude = (0.5f - v) * PI;
+            float phi = (1.0f - u) * 2.0f * PI;
+            float cos_latitude = cosf(latitude);
+            XMVECTOR dir = XMVectorSet(cos_latitude * cosf(phi), sinf(latitude), cos_latitude * sinf(phi), 0.0f);
+
+            pdf = cos_latitude > 1e-6f ? _texel_pdf[y * _width + x] * _width * _height / (2.0f * PI * PI * cos_latitude) : 0.0f;
+            return dir;
+        }
+
+        float EnvironmentSampler::pdf(FXMVECTOR dir) const {
+            float u, v;
+            directionToEquirect(dir, u, v);
+            u -= floorf(u);
+            size_t x = std::min((size_t)(u * _width), _width - 1);
+            size_t y = std::min((size_t)(v * _height), _height - 1);
+            float cos_latitude = cosf((0.5f - v) * PI);
+            return cos_latitude > 1e-6f ? _texel_pdf[y * _width + x] * _width * _height / (2.0f * PI * PI * cos_latitude) : 0.0f;
+        }
+
+        PathTracer::Random::Random(uint64_t seed)
+            : _state(seed) {
+            // SplitMix64 scrambles the seed so neighbouring pixels start uncorrelated
+            _state += 0x9E3779B97F4A7C15ull;
+            _state = (_state ^ (_state >> 30)) * 0xBF58476D1CE4E5B9ull;
+            _state = (_state ^ (_state >> 27)) * 0x94D049BB133111EBull;
+            _state ^= _state >> 31;
+        }
+
+        // xorshift64*
+        float PathTracer::Random::next() {
+            _state ^= _state >> 12;
+            _state ^= _state << 25;
+            _state ^= _state >> 27;
+            uint32_t bits = (uint32_t)((_state * 0x2545F4914F6CDD1Dull) >> 40);
+            return bits / 16777216.0f;
+        }
+
+        PathTracer::PathTracer(size_t width, size_t height, const Texture2D& equirect, const PathTracerDesc& desc)
+            : _desc(desc),
+              _environment(equirect),
+              _tiles_x((width + desc._tile_size - 1) / desc._tile_size),
+              _tiles_y((height + desc._tile_size - 1) / desc._tile_size),
+              _projection(makeProjection(width, height)),
+              _inv_view_projection(XMMatrixIdentity()),
+              _camera_pos(XMVectorZero()),
+              _sprops(),
+              _lights(),
+              _image(width, height),
+              _sum(width * height),
+              _sum_squared_luminance(width * height) {}
+
+        void PathTracer::reset(SceneState& scene) {
+            _inv_view_projection = XMMatrixInverse(nullptr, scene._camera.getViewMatrix() * _projection);
+            _camera_pos = XMVectorSetW(scene._camera.getPosition(), 0.0f);
+            _sprops = makeSurfaceProps(scene);
+            _lights = makeLights(scene);
+
+            _passes = 0;
+            _image.clear(XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), 1.0f);
+            std::fill(_sum.begin(), _sum.end(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+            std::fill(_sum_squared_luminance.begin(), _sum_squared_luminance.end(), 0.0f);
+        }
+
+        ConvergenceStats PathTracer::accumulate() {
+            auto start = std::chrono::high_resolution_clock::now();
+            ++_passes;
+            _scheduler.run(_tiles_x * _tiles_y, [&](size_t tile, size_t) {
+                renderTile(tile);
+            });
+
+            ConvergenceStats stats;
+            stats._samples_per_pixel = getSamplesPerPixel();
+            stats._stolen_tiles = _scheduler.getStolenCount();
+            stats._pass_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            stats._samples_per_second = _image._color.size() * _desc._samples_per_pass / (stats._pass_ms / 1000.0f);
+
+            const float n = (float)stats._samples_per_pixel;
+            double error_sum = 0.0;
+            for (size_t i = 0; i < _image._color.size(); ++i) {
+                float mean = luminance(XMLoadFloat4(&_image._color[i]));
+                float variance = std::max(0.0f, _sum_squared_luminance[i] / n - mean * mean);
+                float relative_error = n > 1.0f ? sqrtf(variance / (n - 1.0f)) / std::max(mean, MIN_LUMINANCE) : 1.0f;
+                error_sum += relative_error;
+                stats._max_relative_error = std::max(stats._max_relative_error, relative_error);
+            }
+            stats._mean_relative_error = (float)(error_sum / _image._color.size());
+            return stats;
+        }
+
+        const FrameBuffer& PathTracer::getImage() const {
+            return _image;
+        }
+
+        unsigned PathTracer::getSamplesPerPixel() const {
+            return _passes * _desc._samples_per_pass;
+        }
+
+        void PathTracer::renderTile(size_t tile) {
+            const size_t width = _image._width;
+            const size_t height = _image._height;
+            const size_t min_x = (tile % _tiles_x) * _desc._tile_size;
+            const size_t min_y = (tile / _tiles_x) * _desc._tile_size;
+            const size_t max_x = std::min(min_x + _desc._tile_size, width);
+            const size_t max_y = std::min(min_y + _desc._tile_size, height);
+            const unsigned first_sample = (_passes - 1) * _desc._samples_per_pass;
+
+            for (size_t y = min_y; y < max_y; ++y) {
+                for (size_t x = min_x; x < max_x; ++x) {
+                    const size_t pixel = y * width + x;
+                    Random random(((uint64_t)pixel << 32) | first_sample);
+
+                    XMVECTOR sum = XMLoadFloat3(&_sum[pixel]);
+                    for (unsigned s = 0; s < _desc._samples_per_pass; ++s) {
+                        // Box filter over the pixel, through the same projection as the rasterizer
+                        float ndc_x = ((x + random.next()) / width) * 2.0f - 1.0f;
+                        float ndc_y = 1.0f - ((y + random.next()) / height) * 2.0f;
+                        XMVECTOR far_point = XMVector3TransformCoord(XMVectorSet(ndc_x, ndc_y, 1.0f, 1.0f), _inv_view_projection);
+                        XMVECTOR dir = XMVector3Normalize(far_point - _camera_pos);
+
+                        XMVECTOR radiance = tracePath(_camera_pos, dir, random);
+                        sum += radiance;
+                        float l = luminance(radiance);
+                        _sum_squared_luminance[pixel] += l * l;
+                    }
+                    XMStoreFloat3(&_sum[pixel], sum);
+                    XMStoreFloat4(&_image._color[pixel], XMVectorSetW(sum / (float)getSamplesPerPixel(), 1.0f));
+                }
+            }
+        }
+
+        XMVECTOR PathTracer::tracePath(FXMVECTOR origin, FXMVECTOR dir, Random& random) const {
+            XMVECTOR radiance = XMVectorZero();
+            XMVECTOR throughput = XMVectorReplicate(1.0f);
+            XMVECTOR ray_origin = origin;
+            XMVECTOR ray_dir = dir;
+            float brdf_pdf = 0.0f;
+
+            for (unsigned depth = 0; depth < _desc._max_depth; ++depth) {
+                float t;
+                if (!intersectSphere(ray_origin, ray_dir, t)) {
+                    // Camera rays see the sky directly; bounce rays were also counted by light sampling
+                    float weight = depth == 0 ? 1.0f : powerHeuristic(brdf_pdf, _environment.pdf(ray_dir));
+                    radiance += throughput * _environment.radiance(ray_dir) * weight;
+                    break;
+                }
+
+                const XMVECTOR pos = ray_origin + ray_dir * t;
+                const XMVECTOR n = XMVector3Normalize(pos);
+                const XMVECTOR v = -ray_dir;
+                const XMVECTOR shading_origin = pos + n * RAY_OFFSET;
+                const float p_specular = specularProbability(n, v, _sprops);
+
+                if (_desc._base_color_emission) {
+                    radiance += throughput * rgb(_sprops._base_color);
+                }
+
+                // Point lights, exactly as psPBR lights them, plus a shadow ray
+                for (size_t i = 0; i < N_LIGHTS; ++i) {
+                    XMVECTOR to_light = rgb(_lights._light_pos[i]) - pos;
+                    float distance = XMVectorGetX(XMVector3Length(to_light));
+                    XMVECTOR light_dir = to_light / distance;
+                    float shadow_t;
+                    if (dot3(n, light_dir) > 0.0f && !(intersectSphere(shading_origin, light_dir, shadow_t) && shadow_t < distance)) {
+                        radiance += throughput * projectedRadiance(i, pos, n, _lights) * brdf(n, light_dir, v, _sprops);
+                    }
+                }
+
+                // Environment sample
+                {
+                    float light_pdf;
+                    XMVECTOR l = _environment.sample(random.next(), random.next(), light_pdf);
+                    float n_dot_l = dot3(n, l);
+                    float shadow_t;
+                    if (light_pdf > 0.0f && n_dot_l > 0.0f && !intersectSphere(shading_origin, l, shadow_t)) {
+                        float weight = powerHeuristic(light_pdf, brdfPdf(n, v, l, _sprops, p_specular));
+                        radiance += throughput * _environment.radiance(l) * brdf(n, l, v, _sprops) * (n_dot_l * weight / light_pdf);
+                    }
+                }
+
+                // BRDF sample for the next segment
+                XMVECTOR l;
+                if (random.next() < p_specular) {
+                    XMVECTOR h = sampleHalfway(n, _sprops._roughness, random.next(), random.next());
+                    l = XMVector3Normalize(2.0f * dot3(v, h) * h - v);
+                } else {
+                    l = sampleCosine(n, random.next(), random.next());
+                }
+                float n_dot_l = dot3(n, l);
+                brdf_pdf = brdfPdf(n, v, l, _sprops, p_specular);
+                if (n_dot_l <= 0.0f || brdf_pdf <= 0.0f) {
+                    break;
+                }
+                throughput *= brdf(n, l, v, _sprops) * (n_dot_l / brdf_pdf);
+
+                if (depth + 1 >= RUSSIAN_ROULETTE_DEPTH) {
+                    float survival = std::clamp(luminance(throughput), 0.05f, 1.0f);
+                    if (random.next() >= survival) {
+                        break;
+                    }
+                    throughput /= survival;
+                }
+
+                ray_origin = shading_origin;
+                ray_dir = l;
+            }
+            return radiance;
+        }
+
+        ImageDifference compareImages(const FrameBuffer& reference, const FrameBuffer& image) {
+            ImageDifference difference;
+            const size_t n = std::min(reference._color.size(), image._color.size());
+            if (n == 0) {
+                return difference;
+            }
+            double squared_sum = 0.0;
+            double relative_sum = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                XMVECTOR a = XMLoadFloat4(&reference._color[i]);
+                XMVECTOR b = XMLoadFloat4(&image._color[i]);
+                float error = luminance(XMVectorAbs(a - b));
+                float relative_error = error / std::max(luminance(a), MIN_LUMINANCE);
+                squared_sum += XMVectorGetX(XMVector3LengthSq(a - b)) / 3.0f;
+                relative_sum += relative_error;
+                difference._max_relative_error = std::max(difference._max_relative_error, relative_error);
+            }
+            difference._rmse = (float)sqrt(squared_sum / n);
+            difference._mean_relative_error = (float)(relative_sum / n);
+            return difference;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../ConstantBuffer.h"
+
+#include "Rasterizer.h"
+#include "SoftwareRenderer.h"
+#include "Texture.h"
+#include "TileScheduler.h"
+
+namespace rendering {
+    namespace software {
+        // Importance sampling of an equirectangular map by luminance, with the mapping of psCubeMap
+        class EnvironmentSampler {
+        public:
+            EnvironmentSampler(const Texture2D& equirect);
+
+            DirectX::XMVECTOR radiance(DirectX::FXMVECTOR dir) const;
+            DirectX::XMVECTOR sample(float u1, float u2, float& pdf) const;
+            float pdf(DirectX::FXMVECTOR dir) const;
+
+        private:
+            const Texture2D& _equirect;
+            size_t _width;
+            size_t _height;
+            std::vector<float> _marginal_cdf;
+            std::vector<float> _conditional_cdf;
+            std::vector<float> _texel_pdf;
+        };
+
+        struct PathTracerDesc {
+            size_t _tile_size = 32;
+            unsigned _samples_per_pass = 4;
+            unsigned _max_depth = 8;
+            // psPBR adds _base_color to every shaded point; keep it to compare like with like
+            bool _base_color_emission = true;
+        };
+
+        struct ConvergenceStats {
+            unsigned _samples_per_pixel = 0;
+            // Standard error of the pixel mean luminance relative to the mean
+            float _mean_relative_error = 0.0f;
+            float _max_relative_error = 0.0f;
+            float _pass_ms = 0.0f;
+            float _samples_per_second = 0.0f;
+            size_t _stolen_tiles = 0;
+        };
+
+        // Ground truth for the lab-5 scene: the unit sphere at the origin with the GGX material of
+        // shaders.hlsl, lit by the point lights and the HDR environment. Environment lighting uses
+        // multiple importance sampling of the BRDF and the map; passes accumulate progressively.
+        class PathTracer {
+        public:
+            PathTracer(size_t width, size_t height, const Texture2D& equirect, const PathTracerDesc& desc = PathTracerDesc());
+
+            // Takes a snapshot of the scene and drops the accumulated samples
+            void reset(SceneState& scene);
+            ConvergenceStats accumulate();
+
+            const FrameBuffer& getImage() const;
+            unsigned getSamplesPerPixel() const;
+
+        private:
+            struct Random {
+                Random(uint64_t seed);
+                float next();
+
+                uint64_t _state;
+            };
+
+            DirectX::XMVECTOR tracePath(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, Random& random) const;
+            void renderTile(size_t tile);
+
+            PathTracerDesc _desc;
+            EnvironmentSampler _environment;
+            TileScheduler _scheduler;
+            size_t _tiles_x;
+            size_t _tiles_y;
+
+            DirectX::XMMATRIX _projection;
+            DirectX::XMMATRIX _inv_view_projection;
+            DirectX::XMVECTOR _camera_pos;
+            SurfacePropsCB _sprops;
+            LightsCB _lights;
+
+            unsigned _passes = 0;
+            FrameBuffer _image;
+            std::vector<DirectX::XMFLOAT3> _sum;
+            std::vector<float> _sum_squared_luminance;
+        };
+
+        struct ImageDifference {
+            float _rmse = 0.0f;
+            float _mean_relative_error = 0.0f;
+            float _max_relative_error = 0.0f;
+        };
+
+        // Per-pixel comparison of two HDR images of the same size, e.g. a raster frame against getImage()
+        ImageDifference compareImages(const FrameBuffer& reference, const FrameBuffer& image);
+    }
+}
@@ -0,0 +1,348 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <emmintrin.h>
+
+#include "ParallelFor.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            const size_t VERTEX_CHUNK_SIZE = 1024;
+            const size_t MAX_CLIPPED_VERTICES = 12;
+            const float MIN_CLIP_W = 1e-5f;
+            // Triangles reaching further than this many NDC units off screen are clipped in x and y as well. Inside the
+            // guard band pixel coordinates stay small enough for the float edge functions, and a triangle that only
+            // pokes a little past the screen is left alone
+            const float GUARD_BAND = 8.0f;
+
+            // distance(p) = dot(_plane, p) - _offset, kept where distance(p) >= 0
+            struct ClipPlane {
+                float _plane[4];
+                float _offset;
+
+                double distance(const XMFLOAT4& p) const {
+                    return (double)_plane[0] * p.x + (double)_plane[1] * p.y + (double)_plane[2] * p.z + (double)_plane[3] * p.w - _offset;
+                }
+            };
+
+            // Near and far planes as D3D clips them, w > 0 to keep the divide safe, then the guard band
+            const ClipPlane CLIP_PLANES[] = {
+                { { 0.0f, 0.0f, 1.0f, 0.0f }, 0.0f },
+                { { 0.0f, 0.0f, -1.0f, 1.0f }, 0.0f },
+                { { 0.0f, 0.0f, 0.0f, 1.0f }, MIN_CLIP_W },
+                { { 1.0f, 0.0f, 0.0f, GUARD_BAND }, 0.0f },
+                { { -1.0f, 0.0f, 0.0f, GUARD_BAND }, 0.0f },
+                { { 0.0f, 1.0f, 0.0f, GUARD_BAND }, 0.0f },
+                { { 0.0f, -1.0f, 0.0f, GUARD_BAND }, 0.0f },
+            };
+
+            // In double, a vertex far outside the guard band would otherwise leave the intersection with
+            // an error of its own magnitude
+            RasterVertex lerpVertex(const RasterVertex& a, const RasterVertex& b, double t, size_t n_varyings) {
+                RasterVertex v;
+                const float* pa = &a._position.x;
+                const float* pb = &b._position.x;
+                float* pv = &v._position.x;
+                for (size_t i = 0; i < 4; ++i) {
+                    pv[i] = (float)(pa[i] + (pb[i] - (double)pa[i]) * t);
+                }
+                for (size_t i = 0; i < n_varyings; ++i) {
+                    v._varyings[i] = (float)(a._varyings[i] + (b._varyings[i] - (double)a._varyings[i]) * t);
+                }
+                return v;
+            }
+
+            // Sutherland-Hodgman against one plane. Intersections are computed from the inside vertex, so the
+            // two triangles of a shared edge get exactly the same point and the clipped pieces still meet
+            size_t clipPolygon(const RasterVertex* in, size_t n_in, RasterVertex* out, size_t n_varyings, const ClipPlane& plane) {
+                size_t n_out = 0;
+                for (size_t i = 0; i < n_in; ++i) {
+                    const RasterVertex& a = in[i];
+                    const RasterVertex& b = in[(i + 1) % n_in];
+                    const double da = plane.distance(a._position);
+                    const double db = plane.distance(b._position);
+                    if (da >= 0.0) {
+                        out[n_out++] = a;
+                    }
+                    if ((da >= 0.0) != (db >= 0.0)) {
+                        out[n_out++] = da >= 0.0 ? lerpVertex(a, b, da / (da - db), n_varyings) : lerpVertex(b, a, db / (db - da), n_varyings);
+                    }
+                }
+                return n_out;
+            }
+
+            // Whole triangle outside one of the view frustum planes
+            bool isOutsideFrustum(const RasterVertex* v) {
+                const XMFLOAT4& a = v[0]._position;
+                const XMFLOAT4& b = v[1]._position;
+                const XMFLOAT4& c = v[2]._position;
+                return (a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+                    (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+                    (a.z > a.w && b.z > b.w && c.z > c.w) || (a.z < 0.0f && b.z < 0.0f && c.z < 0.0f);
+            }
+
+            // Edge function w(p) = a * p.x + b * p.y + c. The endpoints are put in a fixed order so
+            // that two triangles sharing an edge get exactly opposite values and never both cover a pixel.
+            struct Edge {
+                Edge(float x0, float y0, float x1, float y1) {
+                    _sign = 1.0f;
+                    if (x0 > x1 || (x0 == x1 && y0 > y1)) {
+                        std::swap(x0, x1);
+                        std::swap(y0, y1);
+                        _sign = -1.0f;
+                    }
+                    _a = y0 - y1;
+                    _b = x1 - x0;
+                    _c = (y1 - y0) * x0 - (x1 - x0) * y0;
+                }
+
+                __m128 evaluate(__m128 px, __m128 py) const {
+                    __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(_a), px), _mm_mul_ps(_mm_set1_ps(_b), py)), _mm_set1_ps(_c));
+                    return _mm_mul_ps(w, _mm_set1_ps(_sign));
+                }
+
+                float _a, _b, _c, _sign;
+            };
+        }
+
+        FrameBuffer::FrameBuffer(size_t width, size_t height)
+            : _width(width), _height(height), _color(width * height), _depth(width * height) {}
+
+        void FrameBuffer::clear(const XMFLOAT4& color, float depth) {
+            std::fill(_color.begin(), _color.end(), color);
+            std::fill(_depth.begin(), _depth.end(), depth);
+        }
+
+        Rasterizer::Rasterizer(FrameBuffer& target)
+            : _target(target),
+              _tiles_x((target._width + TILE_SIZE - 1) / TILE_SIZE),
+              _tiles_y((target._height + TILE_SIZE - 1) / TILE_SIZE),
+              _bins(_tiles_x * _tiles_y),
+              _tile_pixels(_tiles_x * _tiles_y) {}
+
+        void Rasterizer::drawIndexed(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, size_t n_varyings,
+            const VertexFunction& vertex_shader, const PixelFunction& pixel_shader) {
+            std::vector<RasterVertex> shaded(vertices.size());
+            parallelFor((vertices.size() + VERTEX_CHUNK_SIZE - 1) / VERTEX_CHUNK_SIZE, [&](size_t chunk) {
+                size_t end = std::min(vertices.size(), (chunk + 1) * VERTEX_CHUNK_SIZE);
+                for (size_t i = chunk * VERTEX_CHUNK_SIZE; i < end; ++i) {
+                    shaded[i] = vertex_shader(vertices[i]);
+                }
+            });
+
+            _triangles.clear();
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                ++_stats._triangles;
+
+                RasterVertex polygon[MAX_CLIPPED_VERTICES] = { shaded[indices[i]], shaded[indices[i + 1]], shaded[indices[i + 2]] };
+                if (isOutsideFrustum(polygon)) {
+                    continue;
+                }
+                size_t n = 3;
+                bool inside = true;
+                for (size_t j = 0; j < 3; ++j) {
+                    const XMFLOAT4& p = polygon[j]._position;
+                    inside = inside && p.z >= 0.0f && p.z <= p.w && p.w >= MIN_CLIP_W &&
+                        fabsf(p.x) <= GUARD_BAND * p.w && fabsf(p.y) <= GUARD_BAND * p.w;
+                }
+                if (!inside) {
+                    ++_stats._clipped;
+                    RasterVertex clipped[MAX_CLIPPED_VERTICES];
+                    RasterVertex* in = polygon;
+                    RasterVertex* out = clipped;
+                    for (const ClipPlane& plane : CLIP_PLANES) {
+                        n = clipPolygon(in, n, out, n_varyings, plane);
+                        std::swap(in, out);
+                        if (n < 3) {
+                            break;
+                        }
+                    }
+                    if (in != polygon) {
+                        std::copy(in, in + n, polygon);
+                    }
+                }
+                for (size_t j = 1; j + 1 < n; ++j) {
+                    setupTriangle(polygon[0], polygon[j], polygon[j + 1], n_varyings);
+                }
+            }
+
+            for (auto& bin : _bins) {
+                bin.clear();
+            }
+            for (unsigned t = 0; t < (unsigned)_triangles.size(); ++t) {
+                const Triangle& triangle = _triangles[t];
+                for (size_t ty = triangle._min_y / TILE_SIZE; ty <= triangle._max_y / TILE_SIZE; ++ty) {
+                    for (size_t tx = triangle._min_x / TILE_SIZE; tx <= triangle._max_x / TILE_SIZE; ++tx) {
+                        _bins[ty * _tiles_x + tx].push_back(t);
+                    }
+                }
+            }
+
+            std::fill(_tile_pixels.begin(), _tile_pixels.end(), 0);
+            parallelFor(_bins.size(), [&](size_t tile) {
+                rasterizeTile(tile, n_varyings, pixel_shader);
+            });
+            for (size_t pixels : _tile_pixels) {
+                _stats._pixels += pixels;
+            }
+        }
+
+        const RasterStats& Rasterizer::getStats() const {
+            return _stats;
+        }
+
+        void Rasterizer::resetStats() {
+            _stats = RasterStats();
+        }
+
+        void Rasterizer::setupTriangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2, size_t n_varyings) {
+            const RasterVertex* v[3] = { &v0, &v1, &v2 };
+            Triangle t;
+            for (size_t i = 0; i < 3; ++i) {
+                const XMFLOAT4& p = v[i]->_position;
+                t._inv_w[i] = 1.0f / p.w;
+                t._x[i] = (p.x * t._inv_w[i] * 0.5f + 0.5f) * _target._width;
+                t._y[i] = (0.5f - p.y * t._inv_w[i] * 0.5f) * _target._height;
+                t._z[i] = p.z * t._inv_w[i];
+                for (size_t k = 0; k < n_varyings; ++k) {
+                    t._varyings[i][k] = v[i]->_varyings[k] * t._inv_w[i];
+                }
+            }
+
+            // With y pointing down a positive area means clockwise, which D3D treats as the front face
+            t._area = (t._x[1] - t._x[0]) * (t._y[2] - t._y[0]) - (t._x[2] - t._x[0]) * (t._y[1] - t._y[0]);
+            if (!(t._area > 0.0f)) {
+                ++_stats._culled;
+                return;
+            }
+
+            // Edge i is opposite to vertex i
+            for (size_t i = 0; i < 3; ++i) {
+                size_t a = (i + 1) % 3;
+                size_t b = (i + 2) % 3;
+                bool top = t._y[a] == t._y[b] && t._x[b] > t._x[a];
+                bool left = t._y[b] < t._y[a];
+                t._top_left[i] = top || left;
+            }
+
+            float min_x = std::min({ t._x[0], t._x[1], t._x[2] });
+            float max_x = std::max({ t._x[0], t._x[1], t._x[2] });
+            float min_y = std::min({ t._y[0], t._y[1], t._y[2] });
+            float max_y = std::max({ t._y[0], t._y[1], t._y[2] });
+            t._min_x = std::max(0, (int)floorf(min_x));
+            t._min_y = std::max(0, (int)floorf(min_y));
+            t._max_x = std::min((int)_target._width - 1, (int)ceilf(max_x));
+            t._max_y = std::min((int)_target._height - 1, (int)ceilf(max_y));
+            if (t._min_x > t._max_x || t._min_y > t._max_y) {
+                return;
+            }
+            _triangles.push_back(t);
+        }
+
+        void Rasterizer::rasterizeTile(size_t tile, size_t n_varyings, const PixelFunction& pixel_shader) {
+            const int tile_min_x = (int)((tile % _tiles_x) * TILE_SIZE);
+            const int tile_min_y = (int)((tile / _tiles_x) * TILE_SIZE);
+            const int tile_max_x = std::min(tile_min_x + (int)TILE_SIZE, (int)_target._width) - 1;
+            const int tile_max_y = std::min(tile_min_y + (int)TILE_SIZE, (int)_target._height) - 1;
+            const int width = (int)_target._width;
+
+            const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            size_t pixels = 0;
+            float varyings[MAX_VARYINGS];
+            for (unsigned index : _bins[tile]) {
+                const Triangle& t = _triangles[index];
+                const int min_x = std::max(t._min_x, tile_min_x);
+                const int max_x = std::min(t._max_x, tile_max_x);
+                const int min_y = std::max(t._min_y, tile_min_y);
+                const int max_y = std::min(t._max_y, tile_max_y);
+                if (min_x > max_x || min_y > max_y) {
+                    continue;
+                }
+
+                const Edge edges[3] = {
+                    Edge(t._x[1], t._y[1], t._x[2], t._y[2]),
+                    Edge(t._x[2], t._y[2], t._x[0], t._y[0]),
+                    Edge(t._x[0], t._y[0], t._x[1], t._y[1])
+                };
+                __m128 top_left[3];
+                for (size_t i = 0; i < 3; ++i) {
+                    top_left[i] = _mm_castsi128_ps(_mm_set1_epi32(t._top_left[i] ? -1 : 0));
+                }
+                const __m128 inv_area = _mm_set1_ps(1.0f / t._area);
+                const __m128 end_x = _mm_set1_ps((float)max_x + 1.0f);
+
+                for (int y = min_y; y <= max_y; ++y) {
+                    const __m128 py = _mm_set1_ps(y + 0.5f);
+                    float* depth_row = &_target._depth[(size_t)y * width];
+                    for (int x = min_x; x <= max_x; x += 4) {
+                        const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+                        __m128 mask = _mm_cmplt_ps(px, end_x);
+                        __m128 w[3];
+                        for (size_t i = 0; i < 3; ++i) {
+                            w[i] = edges[i].evaluate(px, py);
+                            __m128 covered = _mm_or_ps(_mm_cmpgt_ps(w[i], zero), _mm_and_ps(_mm_cmpeq_ps(w[i], zero), top_left[i]));
+                            mask = _mm_and_ps(mask, covered);
+                        }
+                        if (_mm_movemask_ps(mask) == 0) {
+                            continue;
+                        }
+
+                        const __m128 b0 = _mm_mul_ps(w[0], inv_area);
+                        const __m128 b1 = _mm_mul_ps(w[1], inv_area);
+                        const __m128 b2 = _mm_mul_ps(w[2], inv_area);
+                        // Interpolation can overshoot [0, 1] slightly, e.g. for the sky drawn at z == w
+                        const __m128 z = _mm_min_ps(one, _mm_max_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, _mm_set1_ps(t._z[0])), _mm_mul_ps(b1, _mm_set1_ps(t._z[1]))), _mm_mul_ps(b2, _mm_set1_ps(t._z[2])))));
+
+                        __m128 depth;
+                        if (x + 4 <= width) {
+                            depth = _mm_loadu_ps(depth_row + x);
+                        } else {
+                            float tail[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                            std::copy(depth_row + x, depth_row + width, tail);
+                            depth = _mm_loadu_ps(tail);
+                        }
+                        mask = _mm_and_ps(mask, _mm_cmple_ps(z, depth));
+
+                        int bits = _mm_movemask_ps(mask);
+                        if (bits == 0) {
+                            continue;
+                        }
+
+                        alignas(16) float lane_b[3][4];
+                        alignas(16) float lane_z[4];
+                        _mm_store_ps(lane_b[0], b0);
+                        _mm_store_ps(lane_b[1], b1);
+                        _mm_store_ps(lane_b[2], b2);
+                        _mm_store_ps(lane_z, z);
+                        for (int lane = 0; lane < 4; ++lane) {
+                            if (!(bits & (1 << lane))) {
+                                continue;
+                            }
+                            const float c0 = lane_b[0][lane];
+                            const float c1 = lane_b[1][lane];
+                            const float c2 = lane_b[2][lane];
+                            const float w_inv = 1.0f / (c0 * t._inv_w[0] + c1 * t._inv_w[1] + c2 * t._inv_w[2]);
+                            for (size_t k = 0; k < n_varyings; ++k) {
+                                varyings[k] = (c0 * t._varyings[0][k] + c1 * t._varyings[1][k] + c2 * t._varyings[2][k]) * w_inv;
+                            }
+
+                            size_t pixel = (size_t)y * width + x + lane;
+                            XMStoreFloat4(&_target._color[pixel], pixel_shader(varyings));
+                            _target._depth[pixel] = lane_z[lane];
+                            ++pixels;
+                        }
+                    }
+                }
+            }
+            _tile_pixels[tile] = pixels;
+        }
+    }
+}
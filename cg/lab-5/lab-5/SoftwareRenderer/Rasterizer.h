@@ -0,0 +1,81 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <functional>
+#include <vector>
+
+#include "../SimpleVertex.h"
+
+namespace rendering {
+    namespace software {
+        struct FrameBuffer {
+            FrameBuffer(size_t width = 0, size_t height = 0);
+
+            void clear(const DirectX::XMFLOAT4& color, float depth);
+
+            size_t _width;
+            size_t _height;
+            std::vector<DirectX::XMFLOAT4> _color;
+            std::vector<float> _depth;
+        };
+
+        const size_t MAX_VARYINGS = 8;
+
+        // Vertex shader output: clip-space position and the attributes to interpolate
+        struct RasterVertex {
+            DirectX::XMFLOAT4 _position;
+            float _varyings[MAX_VARYINGS];
+        };
+
+        using VertexFunction = std::function<RasterVertex(const SimpleVertex&)>;
+        using PixelFunction = std::function<DirectX::XMVECTOR(const float* varyings)>;
+
+        struct RasterStats {
+            size_t _triangles = 0;
+            size_t _culled = 0;
+            size_t _clipped = 0;
+            size_t _pixels = 0;
+        };
+
+        // Draws with the default D3D11 rasterizer state (back faces culled, clockwise is front) and
+        // the LESS_EQUAL depth test used by Renderer. The screen is split into TILE_SIZE tiles,
+        // triangles are binned per tile and the tiles are rasterized in parallel, 4 pixels at a time.
+        class Rasterizer {
+        public:
+            static const size_t TILE_SIZE = 64;
+
+            Rasterizer(FrameBuffer& target);
+
+            void drawIndexed(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, size_t n_varyings,
+                const VertexFunction& vertex_shader, const PixelFunction& pixel_shader);
+
+            const RasterStats& getStats() const;
+            void resetStats();
+
+        private:
+            struct Triangle {
+                float _x[3];
+                float _y[3];
+                float _z[3];
+                float _inv_w[3];
+                float _varyings[3][MAX_VARYINGS];
+                float _area;
+                bool _top_left[3];
+                int _min_x, _min_y, _max_x, _max_y;
+            };
+
+            void setupTriangle(const RasterVertex& v0, const RasterVertex& v1, const RasterVertex& v2, size_t n_varyings);
+            void rasterizeTile(size_t tile, size_t n_varyings, const PixelFunction& pixel_shader);
+
+            FrameBuffer& _target;
+            size_t _tiles_x;
+            size_t _tiles_y;
+
+            std::vector<Triangle> _triangles;
+            std::vector<std::vector<unsigned>> _bins;
+            std::vector<size_t> _tile_pixels;
+            RasterStats _stats;
+        };
+    }
+}
@@ -0,0 +1,289 @@
+#include "ShaderPorts.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            float dot3(FXMVECTOR a, FXMVECTOR b) {
+                return XMVectorGetX(XMVector3Dot(a, b));
+            }
+
+            float saturate(float x) {
+                return std::clamp(x, 0.0f, 1.0f);
+            }
+
+            XMVECTOR mul(FXMVECTOR v, CXMMATRIX uploaded) {
+                return XMVector4Transform(v, XMMatrixTranspose(uploaded));
+            }
+
+            XMVECTOR loadPosition(const SimpleVertex& input) {
+                return XMVectorSetW(XMLoadFloat3(&input._pos), 1.0f);
+            }
+
+            XMVECTOR rgb(const XMFLOAT4& color) {
+                return XMVectorSet(color.x, color.y, color.z, 0.0f);
+            }
+
+            XMVECTOR uncharted2Tonemap(FXMVECTOR x) {
+                const float a = 0.1f;  // Shoulder Strength
+                const float b = 0.50f; // Linear Strength
+                const float c = 0.1f;  // Linear Angle
+                const float d = 0.20f; // Toe Strength
+                const float e = 0.02f; // Toe Numerator
+                const float f = 0.30f; // Toe Denominator
+                XMVECTOR numerator = x * (a * x + XMVectorReplicate(c * b)) + XMVectorReplicate(d * e);
+                XMVECTOR denominator = x * (a * x + XMVectorReplicate(b)) + XMVectorReplicate(d * f);
+                return numerator / denominator - XMVectorReplicate(e / f);
+            }
+
+            float keyValue(float l) {
+                return 1.03f - 2.0f / (2.0f + log10f(l + 1.0f));
+            }
+
+            float exposure(const AdaptationCB& adaptation) {
+                float l = expf(adaptation._adapted_log_luminance) - 1.0f;
+                return keyValue(l) / l;
+            }
+        }
+
+        float ndf(FXMVECTOR normal, FXMVECTOR halfway, float roughness) {
+            const float roughness_squared = std::clamp(roughness * roughness, EPSILON, 1.0f);
+            const float n_dot_h = saturate(dot3(normal, halfway));
+            const float denominator = n_dot_h * n_dot_h * (roughness_squared - 1.0f) + 1.0f;
+            return roughness_squared / PI / (denominator * denominator);
+        }
+
+        float SchlickGGX(FXMVECTOR n, FXMVECTOR v, float k) {
+            const float dot_multiplier = saturate(dot3(n, v));
+            return dot_multiplier / (dot_multiplier * (1.0f - k) + k);
+        }
+
+        float geometryFunction(FXMVECTOR normal, FXMVECTOR dir, float roughness) {
+            const float k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+            return SchlickGGX(normal, dir, k);
+        }
+
+        float geometryFunction2dir(FXMVECTOR normal, FXMVECTOR light_dir, FXMVECTOR camera_dir, float roughness) {
+            return geometryFunction(normal, light_dir, roughness) * geometryFunction(normal, camera_dir, roughness);
+        }
+
+        XMVECTOR fresnelFunction(FXMVECTOR camera_dir, FXMVECTOR halfway, const SurfacePropsCB& sprops) {
+            const XMVECTOR f0_noncond = XMVectorReplicate(0.04f);
+            const XMVECTOR f0 = (1.0f - sprops._metalness) * f0_noncond + sprops._metalness * rgb(sprops._base_color);
+            const float dot_multiplier = saturate(dot3(camera_dir, halfway));
+            return f0 + (XMVectorReplicate(1.0f) - f0) * powf(1.0f - dot_multiplier, 5);
+        }
+
+        XMVECTOR fresnelFunctionAmbient(FXMVECTOR f0, FXMVECTOR camera_dir, FXMVECTOR normal, float roughness) {
+            const float dot_multiplier = saturate(dot3(camera_dir, normal));
+            return f0 + (XMVectorMax(XMVectorReplicate(1.0f - roughness), f0) - f0) * powf(1.0f - dot_multiplier, 5);
+        }
+
+        XMVECTOR brdf(FXMVECTOR normal, FXMVECTOR light_dir, FXMVECTOR camera_dir, const SurfacePropsCB& sprops) {
+            const XMVECTOR halfway = XMVector3Normalize(camera_dir + light_dir);
+            const float l_dot_n = saturate(dot3(light_dir, normal));
+            const float v_dot_n = saturate(dot3(camera_dir, normal));
+            const float d = ndf(normal, halfway, sprops._roughness);
+            const float g = geometryFunction2dir(normal, light_dir, camera_dir, sprops._roughness);
+            const XMVECTOR f = fresnelFunction(camera_dir, halfway, sprops);
+
+            const XMVECTOR f_lamb = (XMVectorReplicate(1.0f) - f) * (1.0f - sprops._metalness) * rgb(sprops._base_color) / PI;
+            const XMVECTOR f_ct = d * f * g / (4.0f * l_dot_n * v_dot_n + EPSILON);
+            return f_lamb + f_ct;
+        }
+
+        XMVECTOR projectedRadiance(size_t index, FXMVECTOR pos, FXMVECTOR normal, const LightsCB& lights) {
+            const float deg = 1.0f;
+            const XMVECTOR light_dir = rgb(lights._light_pos[index]) - pos;
+            const float dist = XMVectorGetX(XMVector3Length(light_dir));
+            const float dot_multiplier = powf(saturate(dot3(light_dir / dist, normal)), deg);
+            const XMFLOAT4& attenuation = lights._light_attenuation[index];
+            float att = attenuation.x + attenuation.y * dist * dist;
+            // float _light_intensity[N_LIGHTS] takes a whole register per element
+            return lights._light_intensity[4 * index] * dot_multiplier / att * rgb(lights._light_color[index]);
+        }
+
+        XMVECTOR ambient(FXMVECTOR v, FXMVECTOR n, const SurfacePropsCB& sprops, const ShaderResources& resources) {
+            XMVECTOR r = XMVector3Normalize(XMVector3Reflect(-v, n));
+
+            const float MAX_REFLECTION_LOD = 4.0f;
+            XMVECTOR prefiltered_color = resources._prefiltered->sampleLevel(r, sprops._roughness * MAX_REFLECTION_LOD);
+            XMVECTOR base_color = rgb(sprops._base_color);
+            XMVECTOR f0 = XMVectorLerp(XMVectorReplicate(0.04f), base_color, sprops._metalness);
+            XMVECTOR f = fresnelFunctionAmbient(f0, v, n, sprops._roughness);
+            XMVECTOR env_brdf = resources._preintegrated->sample(std::max(dot3(n, v), 0.0f), sprops._roughness, AddressMode::CLAMP);
+            XMVECTOR specular = prefiltered_color * (f0 * XMVectorGetX(env_brdf) + XMVectorSplatY(env_brdf));
+
+            XMVECTOR k_s = f;
+            XMVECTOR k_d = (XMVectorReplicate(1.0f) - k_s) * (1.0f - sprops._metalness);
+            XMVECTOR irradiance = resources._irradiance->sampleLevel(n, 0.0f);
+            XMVECTOR diffuse = irradiance * base_color;
+            return k_d * diffuse + specular;
+        }
+
+        VsOut vsMain(const SimpleVertex& input, const GeometryOperatorsCB& geometry) {
+            VsOut output;
+            output._position_world = mul(loadPosition(input), geometry._world);
+            output._normal_world = XMVector3Normalize(XMVectorSetW(mul(XMVectorSetW(XMLoadFloat3(&input._nor), 1.0f), geometry._world_normals), 0.0f));
+
+            output._position_projected = mul(output._position_world, geometry._view);
+            output._position_projected = mul(output._position_projected, geometry._projection);
+            return output;
+        }
+
+        XMVECTOR psPBR(const VsOut& input, const GeometryOperatorsCB& geometry, const SurfacePropsCB& sprops, const LightsCB& lights, const ShaderResources& resources) {
+            const XMVECTOR pos = XMVectorSetW(input._position_world, 0.0f);
+            const XMVECTOR normal = XMVector3Normalize(input._normal_world);
+            const XMVECTOR camera_dir = XMVector3Normalize(rgb(geometry._camera_pos) - pos);
+            XMVECTOR color = rgb(sprops._base_color);
+            for (size_t i = 0; i < N_LIGHTS; i++) {
+                const XMVECTOR light_dir = XMVector3Normalize(rgb(lights._light_pos[i]) - pos);
+                const XMVECTOR radiance = projectedRadiance(i, pos, normal, lights);
+                color += radiance * brdf(normal, light_dir, camera_dir, sprops);
+            }
+            color += ambient(camera_dir, normal, sprops, resources);
+            return XMVectorSetW(color, sprops._base_color.w);
+        }
+
+        VsSkymapOut vsSkymap(const SimpleVertex& input, const GeometryOperatorsCB& geometry) {
+            VsSkymapOut output;
+            output._pos = mul(loadPosition(input), geometry._world);
+            output._pos = mul(output._pos, geometry._view);
+            output._pos = mul(output._pos, geometry._projection);
+            output._pos = XMVectorSwizzle<0, 1, 3, 3>(output._pos);
+            output._tex = XMLoadFloat3(&input._pos);
+            return output;
+        }
+
+        XMVECTOR psSkymap(const VsSkymapOut& input, const ShaderResources& resources) {
+            return resources._sky->sampleLevel(input._tex, 0.0f);
+        }
+
+        float logLuminance(FXMVECTOR color) {
+            XMFLOAT4 p;
+            XMStoreFloat4(&p, color);
+            float l = 0.2126f * p.x + 0.7151f * p.y + 0.0722f * p.z;
+            return logf(l + 1.0f);
+        }
+
+        XMVECTOR tonemapFilmic(FXMVECTOR color, const AdaptationCB& adaptation) {
+            const float w = 11.2f; // Linear White Point Value
+            float e = exposure(adaptation) * adaptation._exposure_scale;
+            XMVECTOR curr = uncharted2Tonemap(e * color);
+            XMVECTOR white_scale = XMVectorReciprocal(uncharted2Tonemap(XMVectorReplicate(w)));
+            return curr * white_scale;
+        }
+
+        XMVECTOR psToneMapping(FXMVECTOR color, const AdaptationCB& adaptation) {
+            XMVECTOR mapped = XMVectorPow(XMVectorMax(tonemapFilmic(color, adaptation), XMVectorZero()), XMVectorReplicate(1.0f / 2.2f));
+            return XMVectorSetW(mapped, XMVectorGetW(color));
+        }
+
+        XMVECTOR psCubeMap(FXMVECTOR position_world, const Texture2D& equirect) {
+            XMFLOAT3 n;
+            XMStoreFloat3(&n, XMVector3Normalize(position_world));
+            float u = 1.0f - atan2f(n.z, n.x) / (2 * PI);
+            float v = 0.5f - asinf(n.y) / PI;
+            return equirect.sample(u, v, AddressMode::WRAP);
+        }
+
+        XMVECTOR psIrradianceMap(FXMVECTOR position_world, const TextureCube& sky, size_t n1, size_t n2) {
+            XMVECTOR normal = XMVector3Normalize(position_world);
+            XMVECTOR dir = fabsf(XMVectorGetZ(normal)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+            XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(dir, normal));
+            XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+            XMVECTOR irradiance = XMVectorZero();
+            for (size_t i = 0; i < n1; i++) {
+                for (size_t j = 0; j < n2; j++) {
+                    float phi = i * (2 * PI / n1);
+                    float theta = j * (PI / 2 / n2);
+                    XMVECTOR sample_vec = sinf(theta) * cosf(phi) * tangent + sinf(theta) * sinf(phi) * bitangent + cosf(theta) * normal;
+                    irradiance += sky.sampleLevel(sample_vec, 0.0f) * cosf(theta) * sinf(theta);
+                }
+            }
+            irradiance = PI * irradiance / (float)(n1 * n2);
+            return XMVectorSetW(irradiance, 1.0f);
+        }
+
+        float RadicalInverse_VdC(unsigned bits) {
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            return float(bits) * 2.3283064365386963e-10f; // / 0x100000000
+        }
+
+        XMFLOAT2 Hammersley(unsigned i, unsigned n) {
+            return XMFLOAT2(float(i) / float(n), RadicalInverse_VdC(i));
+        }
+
+        XMVECTOR ImportanceSampleGGX(const XMFLOAT2& xi, FXMVECTOR norm, float roughness) {
+            float a = roughness * roughness;
+            float phi = 2.0f * PI * xi.x;
+            float cos_theta = sqrtf((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+            float sin_theta = sqrtf(1.0f - cos_theta * cos_theta);
+            XMVECTOR up = fabsf(XMVectorGetZ(norm)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+            XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(up, norm));
+            XMVECTOR bitangent = XMVector3Cross(norm, tangent);
+            XMVECTOR sample_vec = tangent * (cosf(phi) * sin_theta) + bitangent * (sinf(phi) * sin_theta) + norm * cos_theta;
+            return XMVector3Normalize(sample_vec);
+        }
+
+        XMVECTOR psPrefilteredColor(FXMVECTOR position_world, float roughness, const TextureCube& sky, unsigned sample_count) {
+            XMVECTOR norm = XMVector3Normalize(position_world);
+            XMVECTOR view = norm;
+            float total_weight = 0.0f;
+            XMVECTOR prefiltered_color = XMVectorZero();
+            for (unsigned i = 0u; i < sample_count; ++i) {
+                XMFLOAT2 xi = Hammersley(i, sample_count);
+                XMVECTOR h = ImportanceSampleGGX(xi, norm, roughness);
+                XMVECTOR l = XMVector3Normalize(2.0f * dot3(view, h) * h - view);
+                float ndotl = std::max(dot3(norm, l), 0.0f);
+                float ndoth = std::max(dot3(norm, h), 0.0f);
+                float hdotv = std::max(dot3(h, view), 0.0f);
+                float d = ndf(norm, h, roughness);
+                float pdf = (d * ndoth / (4.0f * hdotv)) + 0.0001f;
+                float resolution = 512.0f; // resolution of the source environment map
+                float sa_texel = 4.0f * PI / (6.0f * resolution * resolution);
+                float sa_sample = 1.0f / (float(sample_count) * pdf + 0.0001f);
+                float mip_level = roughness == 0.0f ? 0.0f : 0.5f * log2f(sa_sample / sa_texel);
+                if (ndotl > 0.0f) {
+                    prefiltered_color += sky.sampleLevel(l, mip_level) * ndotl;
+                    total_weight += ndotl;
+                }
+            }
+            prefiltered_color = prefiltered_color / total_weight;
+            return XMVectorSetW(prefiltered_color, 1.0f);
+        }
+
+        XMFLOAT2 IntegrateBRDF(float n_dot_v, float roughness, float geometry_roughness, unsigned sample_count) {
+            XMVECTOR v = XMVectorSet(sqrtf(1.0f - n_dot_v * n_dot_v), n_dot_v, 0.0f, 0.0f);
+            float a = 0.0f;
+            float b = 0.0f;
+            XMVECTOR n = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+            // GeometrySmith in the shader reads _roughness from SurfaceProps, not its argument
+            const float k = geometry_roughness * geometry_roughness / 2.0f;
+            for (unsigned i = 0u; i < sample_count; ++i) {
+                XMFLOAT2 xi = Hammersley(i, sample_count);
+                XMVECTOR h = ImportanceSampleGGX(xi, n, roughness);
+                XMVECTOR l = XMVector3Normalize(2.0f * dot3(v, h) * h - v);
+                float n_dot_l = std::max(XMVectorGetY(l), 0.0f);
+                float n_dot_h = std::max(XMVectorGetY(h), 0.0f);
+                float v_dot_h = std::max(dot3(v, h), 0.0f);
+                if (n_dot_l > 0.0f) {
+                    float g = SchlickGGX(n, v, k) * SchlickGGX(n, l, k);
+                    float g_vis = (g * v_dot_h) / (n_dot_h * n_dot_v);
+                    float fc = powf(1.0f - v_dot_h, 5.0f);
+                    a += (1.0f - fc) * g_vis;
+                    b += fc * g_vis;
+                }
+            }
+            return XMFLOAT2(a / sample_count, b / sample_count);
+        }
+    }
+}
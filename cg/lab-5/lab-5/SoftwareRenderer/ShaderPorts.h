@@ -0,0 +1,65 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "../ConstantBuffer.h"
+#include "../SimpleVertex.h"
+
+#include "Texture.h"
+
+// C++ ports of the entry points in shaders.hlsl. Constant buffers are read the way the GPU
+// sees them: matrices are uploaded transposed, so every matrix is transposed back before use.
+namespace rendering {
+    namespace software {
+        const float PI = 3.14159265f;
+        const float EPSILON = 1e-3f;
+
+        struct ShaderResources {
+            const TextureCube* _sky = nullptr;
+            const TextureCube* _irradiance = nullptr;
+            const TextureCube* _prefiltered = nullptr;
+            const Texture2D* _preintegrated = nullptr;
+        };
+
+        struct VsOut {
+            DirectX::XMVECTOR _position_projected;
+            DirectX::XMVECTOR _position_world;
+            DirectX::XMVECTOR _normal_world;
+        };
+
+        struct VsSkymapOut {
+            DirectX::XMVECTOR _pos;
+            DirectX::XMVECTOR _tex;
+        };
+
+        float ndf(DirectX::FXMVECTOR normal, DirectX::FXMVECTOR halfway, float roughness);
+        float SchlickGGX(DirectX::FXMVECTOR n, DirectX::FXMVECTOR v, float k);
+        float geometryFunction(DirectX::FXMVECTOR normal, DirectX::FXMVECTOR dir, float roughness);
+        float geometryFunction2dir(DirectX::FXMVECTOR normal, DirectX::FXMVECTOR light_dir, DirectX::FXMVECTOR camera_dir, float roughness);
+        DirectX::XMVECTOR fresnelFunction(DirectX::FXMVECTOR camera_dir, DirectX::FXMVECTOR halfway, const SurfacePropsCB& sprops);
+        DirectX::XMVECTOR fresnelFunctionAmbient(DirectX::FXMVECTOR f0, DirectX::FXMVECTOR camera_dir, DirectX::FXMVECTOR normal, float roughness);
+        DirectX::XMVECTOR brdf(DirectX::FXMVECTOR normal, DirectX::FXMVECTOR light_dir, DirectX::FXMVECTOR camera_dir, const SurfacePropsCB& sprops);
+        DirectX::XMVECTOR projectedRadiance(size_t index, DirectX::FXMVECTOR pos, DirectX::FXMVECTOR normal, const LightsCB& lights);
+        DirectX::XMVECTOR ambient(DirectX::FXMVECTOR v, DirectX::FXMVECTOR n, const SurfacePropsCB& sprops, const ShaderResources& resources);
+
+        VsOut vsMain(const SimpleVertex& input, const GeometryOperatorsCB& geometry);
+        DirectX::XMVECTOR psPBR(const VsOut& input, const GeometryOperatorsCB& geometry, const SurfacePropsCB& sprops, const LightsCB& lights, const ShaderResources& resources);
+
+        VsSkymapOut vsSkymap(const SimpleVertex& input, const GeometryOperatorsCB& geometry);
+        DirectX::XMVECTOR psSkymap(const VsSkymapOut& input, const ShaderResources& resources);
+
+        float logLuminance(DirectX::FXMVECTOR color);
+        DirectX::XMVECTOR tonemapFilmic(DirectX::FXMVECTOR color, const AdaptationCB& adaptation);
+        DirectX::XMVECTOR psToneMapping(DirectX::FXMVECTOR color, const AdaptationCB& adaptation);
+
+        // Environment bakes, evaluated per texel direction
+        DirectX::XMVECTOR psCubeMap(DirectX::FXMVECTOR position_world, const Texture2D& equirect);
+        DirectX::XMVECTOR psIrradianceMap(DirectX::FXMVECTOR position_world, const TextureCube& sky, size_t n1, size_t n2);
+        DirectX::XMVECTOR psPrefilteredColor(DirectX::FXMVECTOR position_world, float roughness, const TextureCube& sky, unsigned sample_count);
+        DirectX::XMFLOAT2 IntegrateBRDF(float n_dot_v, float roughness, float geometry_roughness, unsigned sample_count);
+
+        float RadicalInverse_VdC(unsigned bits);
+        DirectX::XMFLOAT2 Hammersley(unsigned i, unsigned n);
+        DirectX::XMVECTOR ImportanceSampleGGX(const DirectX::XMFLOAT2& xi, DirectX::FXMVECTOR norm, float roughness);
+    }
+}
@@ -0,0 +1,193 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <DirectXColors.h>
+
+#include "ParallelFor.h"
+#include "ShaderPorts.h"
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            const size_t PBR_VARYINGS = 7;
+            const size_t SKYMAP_VARYINGS = 3;
+            const size_t ROWS_PER_TASK = 16;
+
+            float millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+                return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+
+            uint8_t toUnorm8(float value) {
+                return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+
+        SceneState::SceneState()
+            : _camera(XMVectorSet(0.0f, 1.5f, -3.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)) {
+            _lights[0]._pos = { 0.0f, 3.0f, -2.0f, 0.0f };
+            _lights[0]._color = (XMFLOAT4)Colors::White;
+        }
+
+        XMMATRIX makeProjection(size_t width, size_t height) {
+            return XMMatrixPerspectiveFovLH(XM_PIDIV2, width / (float)height, 0.01f, 100.0f);
+        }
+
+        SurfacePropsCB makeSurfaceProps(const SceneState& scene) {
+            XMFLOAT4 sphere_color_srgb;
+            float* srgb = &sphere_color_srgb.x;
+            for (size_t i = 0; i < 4; ++i) {
+                srgb[i] = powf(scene._sphere_color_rgb[i], 2.2f);
+            }
+            return { sphere_color_srgb, scene._roughness, scene._metalness };
+        }
+
+        LightsCB makeLights(SceneState& scene) {
+            LightsCB lights = {};
+            for (size_t i = 0; i < N_LIGHTS; ++i) {
+                lights._light_pos[i] = scene._lights[i]._pos;
+                lights._light_color[i] = scene._lights[i]._color;
+                lights._light_attenuation[i] = XMFLOAT4(scene._lights[i]._const_att, scene._lights[i]._quadratic_att, 0.0f, 0.0f);
+                lights._light_intensity[4 * i] = scene._lights[i].getIntensity();
+            }
+            return lights;
+        }
+
+        float toneMap(const FrameBuffer& hdr, float exposure_scale, std::vector<uint8_t>& ldr) {
+            // The GPU averages a power-of-two copy through a mip chain; here every pixel is averaged directly
+            const size_t width = hdr._width;
+            const size_t height = hdr._height;
+            const size_t n_tasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+            std::vector<double> row_sums(n_tasks, 0.0);
+            parallelFor(n_tasks, [&](size_t task) {
+                size_t end = std::min(height, (task + 1) * ROWS_PER_TASK) * width;
+                for (size_t i = task * ROWS_PER_TASK * width; i < end; ++i) {
+                    row_sums[task] += logLuminance(XMLoadFloat4(&hdr._color[i]));
+                }
+            });
+            double sum = 0.0;
+            for (double row_sum : row_sums) {
+                sum += row_sum;
+            }
+            const float average_log_luminance = (float)(sum / (width * height));
+
+            AdaptationCB adaptation;
+            adaptation._exposure_scale = exposure_scale;
+            adaptation._adapted_log_luminance = average_log_luminance;
+            adaptation._uv_scale = XMFLOAT2(1.0f, 1.0f);
+            ldr.resize(width * height * 4);
+            parallelFor(n_tasks, [&](size_t task) {
+                size_t end = std::min(height, (task + 1) * ROWS_PER_TASK) * width;
+                for (size_t i = task * ROWS_PER_TASK * width; i < end; ++i) {
+                    XMFLOAT4 mapped;
+                    XMStoreFloat4(&mapped, psToneMapping(XMLoadFloat4(&hdr._color[i]), adaptation));
+                    ldr[4 * i + 0] = toUnorm8(mapped.x);
+                    ldr[4 * i + 1] = toUnorm8(mapped.y);
+                    ldr[4 * i + 2] = toUnorm8(mapped.z);
+                    ldr[4 * i + 3] = toUnorm8(mapped.w);
+                }
+            });
+            return average_log_luminance;
+        }
+
+        SoftwareRenderer::SoftwareRenderer(size_t width, size_t height, const EnvironmentMaps& environment)
+            : _environment(environment),
+              _sphere(1.0f, 30, 30, true, true),
+              _sky_sphere(1.0f, 10, 10, false, true),
+              _projection(makeProjection(width, height)),
+              _frame_buffer(width, height),
+              _rasterizer(_frame_buffer),
+              _ldr(width * height * 4) {}
+
+        FrameStats SoftwareRenderer::render(SceneState& scene) {
+            FrameStats stats;
+            auto frame_start = std::chrono::high_resolution_clock::now();
+            _rasterizer.resetStats();
+
+            _frame_buffer.clear(XMFLOAT4(0.05f, 0.05f, 0.1f, 1.0f), 1.0f);
+
+            // Constant buffers are filled exactly as Renderer::render fills them
+            const XMMATRIX world = XMMatrixIdentity();
+            XMFLOAT4 camera_pos;
+            XMStoreFloat4(&camera_pos, scene._camera.getPosition());
+
+            GeometryOperatorsCB geometry;
+            geometry._world = XMMatrixTranspose(world);
+            geometry._world_normals = XMMatrixInverse(nullptr, world);
+            geometry._view = XMMatrixTranspose(scene._camera.getViewMatrix());
+            geometry._projection = XMMatrixTranspose(_projection);
+            geometry._camera_pos = camera_pos;
+
+            const SurfacePropsCB sprops = makeSurfaceProps(scene);
+            const LightsCB lights = makeLights(scene);
+
+            const ShaderResources resources = _environment.getResources();
+
+            auto raster_start = std::chrono::high_resolution_clock::now();
+            _rasterizer.drawIndexed(_sphere.getVertices(), _sphere.getIndices(), PBR_VARYINGS,
+                [&](const SimpleVertex& vertex) {
+                    VsOut out = vsMain(vertex, geometry);
+                    RasterVertex result;
+                    XMStoreFloat4(&result._position, out._position_projected);
+                    XMStoreFloat4((XMFLOAT4*)&result._varyings[0], out._position_world);
+                    XMStoreFloat3((XMFLOAT3*)&result._varyings[4], out._normal_world);
+                    return result;
+                },
+                [&](const float* varyings) {
+                    VsOut in;
+                    in._position_world = XMLoadFloat4((const XMFLOAT4*)&varyings[0]);
+                    in._normal_world = XMLoadFloat3((const XMFLOAT3*)&varyings[4]);
+                    return psPBR(in, geometry, sprops, lights, resources);
+                });
+
+            GeometryOperatorsCB sky_geometry = geometry;
+            sky_geometry._world = XMMatrixTranspose(XMMatrixScaling(5, 5, 5) * XMMatrixTranslation(camera_pos.x, camera_pos.y, camera_pos.z));
+            _rasterizer.drawIndexed(_sky_sphere.getVertices(), _sky_sphere.getIndices(), SKYMAP_VARYINGS,
+                [&](const SimpleVertex& vertex) {
+                    VsSkymapOut out = vsSkymap(vertex, sky_geometry);
+                    RasterVertex result;
+                    XMStoreFloat4(&result._position, out._pos);
+                    XMStoreFloat3((XMFLOAT3*)&result._varyings[0], out._tex);
+                    return result;
+                },
+                [&](const float* varyings) {
+                    VsSkymapOut in;
+                    in._tex = XMLoadFloat3((const XMFLOAT3*)&varyings[0]);
+                    return psSkymap(in, resources);
+                });
+            stats._raster_ms = millisecondsSince(raster_start);
+
+            auto tone_mapping_start = std::chrono::high_resolution_clock::now();
+            _average_log_luminance = toneMap(_frame_buffer, scene._exposure_scale, _ldr);
+            stats._tone_mapping_ms = millisecondsSince(tone_mapping_start);
+
+            stats._total_ms = millisecondsSince(frame_start);
+            stats._raster = _rasterizer.getStats();
+            return stats;
+        }
+
+        size_t SoftwareRenderer::getWidth() const {
+            return _frame_buffer._width;
+        }
+
+        size_t SoftwareRenderer::getHeight() const {
+            return _frame_buffer._height;
+        }
+
+        const FrameBuffer& SoftwareRenderer::getHDR() const {
+            return _frame_buffer;
+        }
+
+        const std::vector<uint8_t>& SoftwareRenderer::getLDR() const {
+            return _ldr;
+        }
+
+        float SoftwareRenderer::getAverageLogLuminance() const {
+            return _average_log_luminance;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../Camera.h"
+#include "../ConstantBuffer.h"
+#include "../PointLight.h"
+#include "../Sphere.h"
+
+#include "Environment.h"
+#include "Rasterizer.h"
+
+namespace rendering {
+    namespace software {
+        // Everything Renderer::render reads from its members, with the defaults of Renderer::initScene
+        struct SceneState {
+            SceneState();
+
+            Camera _camera;
+            PointLight _lights[N_LIGHTS];
+            float _sphere_color_rgb[4] = { 0.2f, 0.0f, 0.0f, 1.0f };
+            float _roughness = 0.3f;
+            float _metalness = 0.2f;
+            float _exposure_scale = 10.0f;
+        };
+
+        DirectX::XMMATRIX makeProjection(size_t width, size_t height);
+        SurfacePropsCB makeSurfaceProps(const SceneState& scene);
+        LightsCB makeLights(SceneState& scene);
+
+        // Fully adapted tone mapping of a whole frame into RGBA8; returns the average log luminance
+        float toneMap(const FrameBuffer& hdr, float exposure_scale, std::vector<uint8_t>& ldr);
+
+        struct FrameStats {
+            float _raster_ms = 0.0f;
+            float _tone_mapping_ms = 0.0f;
+            float _total_ms = 0.0f;
+            RasterStats _raster;
+        };
+
+        // Runs the PBR path of lab-5 on the CPU: the sphere and the sky into an HDR frame buffer,
+        // then the average log luminance and tone mapping into an RGBA8 image.
+        class SoftwareRenderer {
+        public:
+            SoftwareRenderer(size_t width, size_t height, const EnvironmentMaps& environment);
+
+            FrameStats render(SceneState& scene);
+
+            size_t getWidth() const;
+            size_t getHeight() const;
+            const FrameBuffer& getHDR() const;
+            const std::vector<uint8_t>& getLDR() const;
+            float getAverageLogLuminance() const;
+
+        private:
+            const EnvironmentMaps& _environment;
+            Sphere _sphere;
+            Sphere _sky_sphere;
+            DirectX::XMMATRIX _projection;
+
+            FrameBuffer _frame_buffer;
+            Rasterizer _rasterizer;
+            std::vector<uint8_t> _ldr;
+            float _average_log_luminance = 0.0f;
+        };
+    }
+}
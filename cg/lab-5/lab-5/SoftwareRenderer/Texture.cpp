@@ -0,0 +1,148 @@
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace software {
+        namespace {
+            int wrapCoordinate(int i, int n) {
+                i %= n;
+                return i < 0 ? i + n : i;
+            }
+        }
+
+        Texture2D::Texture2D(size_t width, size_t height)
+            : _width(width), _height(height), _texels(width * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f)) {}
+
+        size_t Texture2D::getWidth() const {
+            return _width;
+        }
+
+        size_t Texture2D::getHeight() const {
+            return _height;
+        }
+
+        XMFLOAT4& Texture2D::at(size_t x, size_t y) {
+            return _texels[y * _width + x];
+        }
+
+        const XMFLOAT4& Texture2D::at(size_t x, size_t y) const {
+            return _texels[y * _width + x];
+        }
+
+        XMVECTOR Texture2D::load(int x, int y, AddressMode address) const {
+            if (address == AddressMode::WRAP) {
+                x = wrapCoordinate(x, (int)_width);
+                y = wrapCoordinate(y, (int)_height);
+            } else {
+                x = std::clamp(x, 0, (int)_width - 1);
+                y = std::clamp(y, 0, (int)_height - 1);
+            }
+            return XMLoadFloat4(&at(x, y));
+        }
+
+        XMVECTOR Texture2D::sample(float u, float v, AddressMode address) const {
+            float x = u * _width - 0.5f;
+            float y = v * _height - 0.5f;
+            float x0 = floorf(x);
+            float y0 = floorf(y);
+            float fx = x - x0;
+            float fy = y - y0;
+            int ix = (int)x0;
+            int iy = (int)y0;
+            XMVECTOR top = XMVectorLerp(load(ix, iy, address), load(ix + 1, iy, address), fx);
+            XMVECTOR bottom = XMVectorLerp(load(ix, iy + 1, address), load(ix + 1, iy + 1, address), fx);
+            return XMVectorLerp(top, bottom, fy);
+        }
+
+        TextureCube::TextureCube(size_t size, size_t mip_levels) : _size(size), _mip_levels(mip_levels) {
+            _faces.reserve(6 * mip_levels);
+            for (size_t face = 0; face < 6; ++face) {
+                for (size_t mip_level = 0; mip_level < mip_levels; ++mip_level) {
+                    size_t mip_size = std::max<size_t>(size >> mip_level, 1);
+                    _faces.emplace_back(mip_size, mip_size);
+                }
+            }
+        }
+
+        size_t TextureCube::getSize() const {
+            return _size;
+        }
+
+        size_t TextureCube::getMipLevels() const {
+            return _mip_levels;
+        }
+
+        Texture2D& TextureCube::getFace(size_t face, size_t mip_level) {
+            return _faces[face * _mip_levels + mip_level];
+        }
+
+        const Texture2D& TextureCube::getFace(size_t face, size_t mip_level) const {
+            return _faces[face * _mip_levels + mip_level];
+        }
+
+        XMVECTOR TextureCube::sampleLevel(FXMVECTOR dir, float lod) const {
+            XMFLOAT3 d;
+            XMStoreFloat3(&d, dir);
+            float ax = fabsf(d.x);
+            float ay = fabsf(d.y);
+            float az = fabsf(d.z);
+
+            size_t face;
+            float sc, tc, ma;
+            if (ax >= ay && ax >= az) {
+                face = d.x >= 0.0f ? 0 : 1;
+                sc = d.x >= 0.0f ? -d.z : d.z;
+                tc = -d.y;
+                ma = ax;
+            } else if (ay >= az) {
+                face = d.y >= 0.0f ? 2 : 3;
+                sc = d.x;
+                tc = d.y >= 0.0f ? d.z : -d.z;
+                ma = ay;
+            } else {
+                face = d.z >= 0.0f ? 4 : 5;
+                sc = d.z >= 0.0f ? d.x : -d.x;
+                tc = -d.y;
+                ma = az;
+            }
+            float u = 0.5f * (sc / ma + 1.0f);
+            float v = 0.5f * (tc / ma + 1.0f);
+
+            lod = std::clamp(lod, 0.0f, (float)(_mip_levels - 1));
+            size_t mip0 = (size_t)lod;
+            size_t mip1 = std::min(mip0 + 1, _mip_levels - 1);
+            XMVECTOR c0 = sampleMip(face, mip0, u, v);
+            if (mip1 == mip0) {
+                return c0;
+            }
+            return XMVectorLerp(c0, sampleMip(face, mip1, u, v), lod - mip0);
+        }
+
+        XMVECTOR TextureCube::texelDirection(size_t face, float u, float v) {
+            float sc = 2.0f * u - 1.0f;
+            float tc = 2.0f * v - 1.0f;
+            switch (face) {
+            case 0:
+                return XMVectorSet(1.0f, -tc, -sc, 0.0f);
+            case 1:
+                return XMVectorSet(-1.0f, -tc, sc, 0.0f);
+            case 2:
+                return XMVectorSet(sc, 1.0f, tc, 0.0f);
+            case 3:
+                return XMVectorSet(sc, -1.0f, -tc, 0.0f);
+            case 4:
+                return XMVectorSet(sc, -tc, 1.0f, 0.0f);
+            default:
+                return XMVectorSet(-sc, -tc, -1.0f, 0.0f);
+            }
+        }
+
+        XMVECTOR TextureCube::sampleMip(size_t face, size_t mip_level, float u, float v) const {
+            return getFace(face, mip_level).sample(u, v, AddressMode::CLAMP);
+        }
+    }
+}
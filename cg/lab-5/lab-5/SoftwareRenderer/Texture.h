@@ -0,0 +1,58 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+namespace rendering {
+    namespace software {
+        enum class AddressMode {
+            WRAP,
+            CLAMP,
+        };
+
+        // CPU counterpart of a single-mip R32G32B32A32_FLOAT texture
+        class Texture2D {
+        public:
+            Texture2D(size_t width = 0, size_t height = 0);
+
+            size_t getWidth() const;
+            size_t getHeight() const;
+
+            DirectX::XMFLOAT4& at(size_t x, size_t y);
+            const DirectX::XMFLOAT4& at(size_t x, size_t y) const;
+
+            DirectX::XMVECTOR load(int x, int y, AddressMode address) const;
+            DirectX::XMVECTOR sample(float u, float v, AddressMode address) const;
+
+        private:
+            size_t _width;
+            size_t _height;
+            std::vector<DirectX::XMFLOAT4> _texels;
+        };
+
+        // Faces are stored in D3D order (+X, -X, +Y, -Y, +Z, -Z), each with its own mip chain
+        class TextureCube {
+        public:
+            TextureCube(size_t size = 0, size_t mip_levels = 1);
+
+            size_t getSize() const;
+            size_t getMipLevels() const;
+
+            Texture2D& getFace(size_t face, size_t mip_level);
+            const Texture2D& getFace(size_t face, size_t mip_level) const;
+
+            DirectX::XMVECTOR sampleLevel(DirectX::FXMVECTOR dir, float lod) const;
+
+            // Direction through the point (u, v) of a face, the inverse of the face selection in sampleLevel
+            static DirectX::XMVECTOR texelDirection(size_t face, float u, float v);
+
+        private:
+            DirectX::XMVECTOR sampleMip(size_t face, size_t mip_level, float u, float v) const;
+
+            size_t _size;
+            size_t _mip_levels;
+            std::vector<Texture2D> _faces;
+        };
+    }
+}
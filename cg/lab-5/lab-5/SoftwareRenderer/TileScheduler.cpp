@@ -0,0 +1,90 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "ParallelFor.h"
+
+namespace rendering {
+    namespace software {
+        TileScheduler::TileScheduler(size_t n_workers) {
+            if (n_workers == 0) {
+                n_workers = getThreadBudget();
+            }
+            for (size_t i = 0; i < n_workers; ++i) {
+                _queues.push_back(std::make_unique<Queue>());
+            }
+        }
+
+        size_t TileScheduler::getWorkerCount() const {
+            return _queues.size();
+        }
+
+        size_t TileScheduler::getStolenCount() const {
+            return _stolen;
+        }
+
+        void TileScheduler::run(size_t n_tiles, const TileFunction& f) {
+            const size_t n_workers = _queues.size();
+            for (size_t i = 0; i < n_workers; ++i) {
+                size_t begin = n_tiles * i / n_workers;
+                size_t end = n_tiles * (i + 1) / n_workers;
+                for (size_t tile = begin; tile < end; ++tile) {
+                    _queues[i]->_tiles.push_back(tile);
+                }
+            }
+
+            std::atomic<size_t> stolen(0);
+            auto worker = [&](size_t index) {
+                size_t tile;
+                while (true) {
+                    if (pop(index, tile)) {
+                        f(tile, index);
+                    } else if (steal(index, tile)) {
+                        ++stolen;
+                        f(tile, index);
+                    } else {
+                        // Tiles are never added while running, so empty queues everywhere mean done
+                        break;
+                    }
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < n_workers; ++i) {
+                threads.emplace_back(worker, i);
+            }
+            worker(0);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            _stolen = stolen;
+        }
+
+        bool TileScheduler::pop(size_t worker, size_t& tile) {
+            Queue& queue = *_queues[worker];
+            std::lock_guard<std::mutex> lock(queue._mutex);
+            if (queue._tiles.empty()) {
+                return false;
+            }
+            tile = queue._tiles.front();
+            queue._tiles.pop_front();
+            return true;
+        }
+
+        bool TileScheduler::steal(size_t worker, size_t& tile) {
+            const size_t n_workers = _queues.size();
+            for (size_t i = 1; i < n_workers; ++i) {
+                Queue& victim = *_queues[(worker + i) % n_workers];
+                std::lock_guard<std::mutex> lock(victim._mutex);
+                if (!victim._tiles.empty()) {
+                    tile = victim._tiles.back();
+                    victim._tiles.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+}
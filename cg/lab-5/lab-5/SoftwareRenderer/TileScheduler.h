@@ -0,0 +1,40 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rendering {
+    namespace software {
+        // Work-stealing scheduler for image tiles. Each worker starts with a contiguous run of
+        // tiles, takes them from the front of its own queue and, once that is empty, steals from
+        // the back of the other queues. Cheap tiles (sky) and expensive ones (the sphere) then
+        // even out without a shared counter every worker contends on.
+        class TileScheduler {
+        public:
+            using TileFunction = std::function<void(size_t tile, size_t worker)>;
+
+            // Zero takes the thread budget of the calling thread
+            TileScheduler(size_t n_workers = 0);
+
+            size_t getWorkerCount() const;
+            size_t getStolenCount() const;
+
+            void run(size_t n_tiles, const TileFunction& f);
+
+        private:
+            struct Queue {
+                std::mutex _mutex;
+                std::deque<size_t> _tiles;
+            };
+
+            bool pop(size_t worker, size_t& tile);
+            bool steal(size_t worker, size_t& tile);
+
+            std::vector<std::unique_ptr<Queue>> _queues;
+            size_t _stolen = 0;
+        };
+    }
+}
@@ -1,30 +1,13 @@
 #include "Sphere.h"
 
+#include "ParametricSurface.h"
+#include "SphereTessellation.h"
+
 namespace rendering {
 	namespace {
 		std::vector<SimpleVertex> calculateVertices(float radius, size_t n_theta, size_t n_phi) {
-			const float d_theta = DirectX::XM_PI / (n_theta - 1);
-			const float d_phi = DirectX::XM_2PI / n_phi;
-			float theta = d_theta;
-
-			std::vector<SimpleVertex> vertices;
-			vertices.push_back({ DirectX::XMFLOAT3(0.0f, radius, 0.0f), DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f) });
-			for (size_t i = 0; i + 2 < n_theta; i++) {
-				float sin_theta = sinf(theta);
-				float cos_theta = cosf(theta);
-				float phi = 0.0f;
-				for (int j = 0; j < n_phi; j++) {
-					float sin_phi = sinf(phi);
-					float cos_phi = cosf(phi);
-					float x = sin_theta * sin_phi;
-					float z = -sin_theta * cos_phi;
-					float y = cos_theta;
-					vertices.push_back({ DirectX::XMFLOAT3(x * radius, y * radius, z * radius), DirectX::XMFLOAT3(x, y, z) });
-					phi += d_phi;
-				}
-				theta += d_theta;
-			}
-			vertices.push_back({ DirectX::XMFLOAT3(0.0f, -radius, 0.0f), DirectX::XMFLOAT3(0.0f, -1.0f, 0.0f) });
+			std::vector<SimpleVertex> vertices(uvSphereVertexCount(n_theta, n_phi));
+			generateUvSphere(radius, n_theta, n_phi, vertices.data());
 			return vertices;
 		}
 
@@ -80,6 +63,15 @@ namespace rendering {
 		: _vertices(calculateVertices(radius, n_theta, n_phi)),
 		  _indices(calculateIndices((unsigned)_vertices.size(), (unsigned)n_theta, (unsigned)n_phi, outer_normals, correct_orientation)) {}
 
+	Sphere Sphere::fromMaxError(float radius, float max_error, bool outer_normals, bool correct_orientation) {
+		const size_t max_n_theta = 4096;
+		size_t n_theta = findResolution(3, max_n_theta, max_error, [&](size_t n_theta) {
+			Sphere sphere(radius, n_theta, 2 * (n_theta - 1), outer_normals, correct_orientation);
+			return sphereChordError(sphere._vertices, sphere._indices, radius);
+		});
+		return Sphere(radius, n_theta, 2 * (n_theta - 1), outer_normals, correct_orientation);
+	}
+
 	const std::vector<SimpleVertex>& Sphere::getVertices() const {
 		return _vertices;
 	}
@@ -9,6 +9,9 @@ namespace rendering {
 	public:
 		Sphere(float radius, size_t n_theta, size_t n_phi, bool outer_normals, bool correct_orientation);
 
+		// Fewest rings with sphereChordError <= max_error, with n_phi = 2 * (n_theta - 1) so that quads stay square at the equator
+		static Sphere fromMaxError(float radius, float max_error, bool outer_normals, bool correct_orientation);
+
 		const std::vector<SimpleVertex>& getVertices() const;
 		const std::vector<unsigned>& getIndices() const;
 
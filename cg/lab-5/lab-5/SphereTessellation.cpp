@@ -0,0 +1,34 @@
+#include "SphereTessellation.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    float sphereChordError(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, float radius) {
+        float error = 0.0f;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]]._pos);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]]._pos);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]]._pos);
+            XMVECTOR normal = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+            float distance = fabsf(XMVectorGetX(XMVector3Dot(normal, p0)));
+            error = std::max(error, radius - distance);
+        }
+        return error;
+    }
+
+    void orientSphereTriangles(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, bool outer_normals) {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]]._pos);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]]._pos);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]]._pos);
+            // cross(p1 - p0, p2 - p0) points out of the front face
+            bool outward = XMVectorGetX(XMVector3Dot(XMVector3Cross(p1 - p0, p2 - p0), p0 + p1 + p2)) > 0.0f;
+            if (outward != outer_normals) {
+                std::swap(indices[i + 1], indices[i + 2]);
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "SimpleVertex.h"
+
+namespace rendering {
+    // Largest distance between the flat triangles and the sphere they approximate: the radius minus
+    // the distance from the center to the triangle plane, maximized over all triangles
+    float sphereChordError(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, float radius);
+
+    // Gives every triangle the winding Sphere produces with correct_orientation: front faces are
+    // clockwise seen from outside, or from inside when the sphere is drawn around the camera
+    void orientSphereTriangles(const std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, bool outer_normals);
+
+    // Smallest resolution in [min_resolution, max_resolution] with error(resolution) <= max_error.
+    // Doubles first, then bisects, so only O(log n) meshes are built
+    template <typename F>
+    size_t findResolution(size_t min_resolution, size_t max_resolution, float max_error, const F& error) {
+        size_t low = min_resolution;
+        size_t high = min_resolution;
+        while (high < max_resolution && error(high) > max_error) {
+            low = high + 1;
+            high = high * 2 < max_resolution ? high * 2 : max_resolution;
+        }
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (error(middle) > max_error) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return high;
+    }
+}
@@ -0,0 +1,112 @@
+#include "TemporalUpsampling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace rendering {
+    namespace {
+        const unsigned JITTER_SEQUENCE_LENGTH = 8;
+
+        XMVECTOR loadTexel(const TemporalImage& image, int x, int y) {
+            XMFLOAT4 texel = image.load(x, y);
+            return XMLoadFloat4(&texel);
+        }
+    }
+
+    float halton(unsigned index, unsigned base) {
+        float result = 0.0f;
+        float f = 1.0f;
+        while (index > 0) {
+            f /= base;
+            result += f * (index % base);
+            index /= base;
+        }
+        return result;
+    }
+
+    XMFLOAT2 temporalJitter(unsigned frame_index) {
+        // Index 0 of the sequence is the pixel corner, so start from 1
+        unsigned i = frame_index % JITTER_SEQUENCE_LENGTH + 1;
+        return XMFLOAT2(halton(i, 2) - 0.5f, halton(i, 3) - 0.5f);
+    }
+
+    XMMATRIX jitterProjection(FXMMATRIX projection, const XMFLOAT2& jitter, float width, float height) {
+        // Texture y goes down while clip space y goes up
+        return projection * XMMatrixTranslation(2.0f * jitter.x / width, -2.0f * jitter.y / height, 0.0f);
+    }
+
+    XMFLOAT2 reprojectTexCoord(const XMFLOAT2& tex, float depth, FXMMATRIX inv_view_projection, CXMMATRIX prev_view_projection) {
+        XMVECTOR ndc = XMVectorSet(tex.x * 2.0f - 1.0f, 1.0f - tex.y * 2.0f, depth, 1.0f);
+        XMVECTOR world = XMVector4Transform(ndc, inv_view_projection);
+        world /= XMVectorGetW(world);
+        XMVECTOR prev = XMVector4Transform(world, prev_view_projection);
+        float w = XMVectorGetW(prev);
+        return XMFLOAT2(XMVectorGetX(prev) / w * 0.5f + 0.5f, 0.5f - XMVectorGetY(prev) / w * 0.5f);
+    }
+
+    TemporalImage::TemporalImage(size_t width, size_t height)
+        : _width(width), _height(height), _texels(width * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f)) {}
+
+    XMFLOAT4 TemporalImage::load(int x, int y) const {
+        x = std::clamp(x, 0, (int)_width - 1);
+        y = std::clamp(y, 0, (int)_height - 1);
+        return _texels[y * _width + x];
+    }
+
+    // Bilinear filtering with clamp addressing, as _min_mag_linear_mip_point_border does
+    XMFLOAT4 TemporalImage::sample(const XMFLOAT2& tex) const {
+        float x = tex.x * _width - 0.5f;
+        float y = tex.y * _height - 0.5f;
+        float x0 = floorf(x);
+        float y0 = floorf(y);
+        float fx = x - x0;
+        float fy = y - y0;
+        XMVECTOR top = XMVectorLerp(loadTexel(*this, (int)x0, (int)y0), loadTexel(*this, (int)x0 + 1, (int)y0), fx);
+        XMVECTOR bottom = XMVectorLerp(loadTexel(*this, (int)x0, (int)y0 + 1), loadTexel(*this, (int)x0 + 1, (int)y0 + 1), fx);
+        XMFLOAT4 result;
+        XMStoreFloat4(&result, XMVectorLerp(top, bottom, fy));
+        return result;
+    }
+
+    void resolveTemporal(const TemporalImage& current, const std::vector<float>& depth, const TemporalImage& history, const TemporalResolveParams& params, TemporalImage& output) {
+        const float width = (float)current._width;
+        const float height = (float)current._height;
+        const int last_x = (int)(params._uv_scale.x * width) - 1;
+        const int last_y = (int)(params._uv_scale.y * height) - 1;
+
+        for (size_t y = 0; y < output._height; ++y) {
+            for (size_t x = 0; x < output._width; ++x) {
+                XMFLOAT2 out_tex((x + 0.5f) / output._width, (y + 0.5f) / output._height);
+                XMFLOAT2 tex(out_tex.x * params._uv_scale.x + params._jitter_uv.x, out_tex.y * params._uv_scale.y + params._jitter_uv.y);
+                int cx = std::clamp((int)(tex.x * width), 0, last_x);
+                int cy = std::clamp((int)(tex.y * height), 0, last_y);
+
+                XMVECTOR color_min = XMVectorReplicate(FLT_MAX);
+                XMVECTOR color_max = XMVectorReplicate(-FLT_MAX);
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        XMVECTOR c = loadTexel(current, std::clamp(cx + dx, 0, last_x), std::clamp(cy + dy, 0, last_y));
+                        color_min = XMVectorMin(color_min, c);
+                        color_max = XMVectorMax(color_max, c);
+                    }
+                }
+
+                XMFLOAT2 clamped_tex(std::min(tex.x, params._uv_scale.x - 0.5f / width), std::min(tex.y, params._uv_scale.y - 0.5f / height));
+                XMFLOAT4 current_texel = current.sample(clamped_tex);
+                XMVECTOR color = XMLoadFloat4(&current_texel);
+
+                XMFLOAT2 prev_tex = reprojectTexCoord(out_tex, depth[cy * current._width + cx], params._inv_view_projection, params._prev_view_projection);
+                if (prev_tex.x >= 0.0f && prev_tex.x <= 1.0f && prev_tex.y >= 0.0f && prev_tex.y <= 1.0f) {
+                    XMFLOAT4 history_texel = history.sample(prev_tex);
+                    XMVECTOR clamped_history = XMVectorClamp(XMLoadFloat4(&history_texel), color_min, color_max);
+                    color = XMVectorLerp(clamped_history, color, params._current_weight);
+                }
+
+                XMStoreFloat4(&output._texels[y * output._width + x], XMVectorSetW(color, 1.0f));
+            }
+        }
+    }
+}
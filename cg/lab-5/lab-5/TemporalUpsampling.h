@@ -0,0 +1,42 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+namespace rendering {
+    float halton(unsigned index, unsigned base);
+
+    // Sub-pixel offset in [-0.5, 0.5) pixels, Halton(2, 3) over an 8-frame cycle.
+    DirectX::XMFLOAT2 temporalJitter(unsigned frame_index);
+
+    DirectX::XMMATRIX jitterProjection(DirectX::FXMMATRIX projection, const DirectX::XMFLOAT2& jitter, float width, float height);
+
+    // Maps a texture coordinate and a post-projection depth of the current frame to
+    // the texture coordinate the same point had in the previous frame.
+    DirectX::XMFLOAT2 reprojectTexCoord(const DirectX::XMFLOAT2& tex, float depth, DirectX::FXMMATRIX inv_view_projection, DirectX::CXMMATRIX prev_view_projection);
+
+    struct TemporalImage {
+        TemporalImage(size_t width = 0, size_t height = 0);
+
+        DirectX::XMFLOAT4 load(int x, int y) const;
+        DirectX::XMFLOAT4 sample(const DirectX::XMFLOAT2& tex) const;
+
+        size_t _width;
+        size_t _height;
+        std::vector<DirectX::XMFLOAT4> _texels;
+    };
+
+    struct TemporalResolveParams {
+        DirectX::XMMATRIX _inv_view_projection;
+        DirectX::XMMATRIX _prev_view_projection;
+        DirectX::XMFLOAT2 _jitter_uv;
+        DirectX::XMFLOAT2 _uv_scale;
+        float _current_weight;
+    };
+
+    // CPU reference of psTemporalResolve. current and depth have the size of the render
+    // texture, of which only _uv_scale is covered by the scene; history and output have
+    // the output size.
+    void resolveTemporal(const TemporalImage& current, const std::vector<float>& depth, const TemporalImage& history, const TemporalResolveParams& params, TemporalImage& output);
+}
@@ -1,3 +1,5 @@
+#include <shellapi.h>
+
 #include "ImGui/imgui_impl_win32.h"
 
 #include "Renderer.h"
@@ -9,6 +11,22 @@ LRESULT CALLBACK windowProc(HWND hwnd, UINT u_msg, WPARAM w_param, LPARAM l_para
 int WINAPI wWinMain(HINSTANCE h_instance, HINSTANCE h_prev_instance, PWSTR p_cmd_line, int n_cmd_show) {
     s_g_renderer.init(h_instance, windowProc, n_cmd_show);
 
+    // --record <file> writes the input journal on exit, --replay <file> plays one back and closes the window
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (wcscmp(argv[i], L"--record") == 0) {
+            s_g_renderer.startRecording(argv[++i]);
+        } else if (wcscmp(argv[i], L"--replay") == 0) {
+            if (!s_g_renderer.startReplay(argv[++i])) {
+                MessageBoxW(nullptr, argv[i], L"Cannot read the input journal", MB_ICONERROR);
+                LocalFree(argv);
+                return 1;
+            }
+        }
+    }
+    LocalFree(argv);
+
     MSG msg = {};
     while (msg.message != WM_QUIT) {
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
@@ -12,6 +12,9 @@ TextureCube _irradiance : register(t0);
 TextureCube _prefiltered : register(t1);
 Texture2D _preintegrated : register(t2);
 
+Texture2D<float> _scene_depth : register(t1);
+Texture2D _history : register(t2);
+
 SamplerState _min_mag_mip_linear : register(s0);
 SamplerState _min_mag_linear_mip_point_border : register(s1);
 
@@ -24,12 +27,19 @@ cbuffer GeometryOperators : register(b0)
     float4 _camera_pos;
 };
 
+// Compiled with INSTANCED for the material grid, every sphere then brings its own material
+#if defined(INSTANCED)
+static float4 _base_color;
+static float _roughness;
+static float _metalness;
+#else
 cbuffer SurfaceProps : register(b1)
 {
     float4 _base_color; // albedo
     float _roughness;   // alpha
     float _metalness;
 };
+#endif
 
 cbuffer Lights : register(b2)
 {
@@ -42,17 +52,71 @@ cbuffer Lights : register(b2)
 cbuffer Adaptation : register(b3) {
     float _exposure_scale;
     float _adapted_log_luminance;
+    float2 _uv_scale;   // part of the render texture covered by the scene viewport
+};
+
+cbuffer TemporalResolve : register(b4) {
+    matrix _inv_view_projection;
+    matrix _prev_view_projection;
+    float2 _jitter_uv;
+    float _current_weight;
+};
+
+cbuffer MeshDecode : register(b5) {
+    float4 _position_scale;
+    float4 _position_offset;
+};
+
+cbuffer ClusterGrid : register(b6) {
+    float4 _projection_tiles;   // _11 and _22 of the projection, tiles along x and y
+    float4 _depth_slices;       // near z, slices over log(far z / near z), slices
 };
 
+// Fill lights, assigned on the CPU to view space froxels. A cluster lists its lights in
+// _cluster_light_indices[range.x, range.x + range.y)
+struct ClusteredLight {
+    float4 _position;   // w: range
+    float4 _radiance;
+    float4 _attenuation;
+};
+
+StructuredBuffer<ClusteredLight> _clustered_lights : register(t3);
+StructuredBuffer<uint2> _cluster_ranges : register(t4);
+StructuredBuffer<uint> _cluster_light_indices : register(t5);
+
 struct VsIn {
     float4 _position_local : POS;
     float3 _normal_local : NOR;
 };
 
+// Geometry::CompactVertex: SNORM16 or half position and an octahedral SNORM16 normal
+struct VsCompactIn {
+    float4 _position_quantized : POS;
+    float2 _normal_octahedral : NOR;
+};
+
+#if defined(INSTANCED)
+struct MaterialInstance {
+    float4 _world_x;
+    float4 _world_y;
+    float4 _world_z;
+    float4 _base_color;
+    float2 _material;
+    float2 _padding;
+};
+
+// Every sphere of the grid. The instanced vertex stream only holds the indices of the visible ones
+StructuredBuffer<MaterialInstance> _instances : register(t0);
+#endif
+
 struct VsOut {
     float4 _position_projected : SV_POSITION;
     float4 _position_world : TEXCOORD0;
     float3 _normal_world : TEXCOORD1;
+#if defined(INSTANCED)
+    nointerpolation float4 _instance_color : TEXCOORD2;
+    nointerpolation float2 _instance_material : TEXCOORD3;
+#endif
 };
 
 struct VsCopyOut {
@@ -76,6 +140,52 @@ VsOut vsMain(VsIn input) {
     return output;
 }
 
+#if defined(INSTANCED)
+VsOut vsMainInstanced(VsIn input, uint instance_index : INSTANCE) {
+    const MaterialInstance instance = _instances[instance_index];
+    VsOut output = (VsOut)0;
+    const float4 pos = float4(input._position_local.xyz, 1);
+    output._position_world = float4(dot(instance._world_x, pos), dot(instance._world_y, pos), dot(instance._world_z, pos), 1);
+    // Grid spheres are only scaled uniformly, so the linear part transforms normals as well
+    const float3 nor = input._normal_local;
+    output._normal_world = normalize(float3(dot(instance._world_x.xyz, nor), dot(instance._world_y.xyz, nor), dot(instance._world_z.xyz, nor)));
+
+    output._position_projected = mul(output._position_world, _view);
+    output._position_projected = mul(output._position_projected, _projection);
+
+    output._instance_color = instance._base_color;
+    output._instance_material = instance._material;
+    return output;
+}
+#endif
+
+// Pixel shaders of the scene start with this, the instanced build takes the material from the sphere
+void loadSurfaceProps(VsOut input) {
+#if defined(INSTANCED)
+    _base_color = input._instance_color;
+    _roughness = input._instance_material.x;
+    _metalness = input._instance_material.y;
+#endif
+}
+
+float3 octahedralDecode(float2 e) {
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+VsIn decodeVertex(VsCompactIn input) {
+    VsIn output;
+    output._position_local = float4(input._position_quantized.xyz * _position_scale.xyz + _position_offset.xyz, 1.0f);
+    output._normal_local = octahedralDecode(input._normal_octahedral);
+    return output;
+}
+
+VsOut vsMainCompact(VsCompactIn input) {
+    return vsMain(decodeVertex(input));
+}
+
 float3 projectedRadiance(int index, float3 pos, float3 normal) // L_i * (l, n)
 {
     const float deg = 1.0f;
@@ -86,6 +196,25 @@ float3 projectedRadiance(int index, float3 pos, float3 normal) // L_i * (l, n)
     return _light_intensity[index] * dot_multiplier / att * _light_color[index].rgb;
 }
 
+uint2 clusterRange(float3 pos) {
+    const float3 view = mul(float4(pos, 1), _view).xyz;
+    const float2 ndc = view.xy * _projection_tiles.xy / view.z;
+    const float2 tile = clamp(floor((ndc * 0.5f + 0.5f) * _projection_tiles.zw), 0.0f, _projection_tiles.zw - 1.0f);
+    const float slice = clamp(floor(log(view.z / _depth_slices.x) * _depth_slices.y), 0.0f, _depth_slices.z - 1.0f);
+    return _cluster_ranges[((uint)slice * (uint)_projection_tiles.w + (uint)tile.y) * (uint)_projection_tiles.z + (uint)tile.x];
+}
+
+// Like projectedRadiance, faded to zero at the range the light was assigned with
+float3 clusteredRadiance(ClusteredLight light, float3 pos, float3 normal)
+{
+    const float3 light_dir = light._position.xyz - pos;
+    const float dist = length(light_dir);
+    const float dot_multiplier = saturate(dot(light_dir / dist, normal));
+    const float att = light._attenuation.x + light._attenuation.y * dist * dist;
+    const float fade = saturate(1.0f - pow(dist / light._position.w, 4));
+    return light._radiance.rgb * dot_multiplier / att * fade * fade;
+}
+
 float ndf(float3 normal, float3 halfway) { // D (Trowbridge-Reitz GGX)
     const float roughness_squared = clamp(_roughness * _roughness, EPSILON, 1.0f);
     const float n_dot_h = saturate(dot(normal, halfway));
@@ -156,16 +285,23 @@ float3 ambient(float3 v, float3 n)
 }
 
 float4 psLambert(VsOut input) : SV_TARGET{
+    loadSurfaceProps(input);
     const float3 normal = normalize(input._normal_world);
     float3 color = _base_color.rgb;
     for (int i = 0; i < N_LIGHTS; i++)
     {
         color += projectedRadiance(i, input._position_world.xyz, normal);
     }
+    const uint2 range = clusterRange(input._position_world.xyz);
+    for (uint j = 0; j < range.y; j++)
+    {
+        color += clusteredRadiance(_clustered_lights[_cluster_light_indices[range.x + j]], input._position_world.xyz, normal);
+    }
     return float4(color, _base_color.a);
 }
 
 float4 psNDF(VsOut input) : SV_TARGET {
+    loadSurfaceProps(input);
     const float3 pos = input._position_world.xyz;
     const float3 normal = normalize(input._normal_world);
     const float3 camera_dir = normalize(_camera_pos.xyz - pos);
@@ -180,6 +316,7 @@ float4 psNDF(VsOut input) : SV_TARGET {
 }
 
 float4 psGeometry(VsOut input) : SV_TARGET{
+    loadSurfaceProps(input);
     const float3 pos = input._position_world.xyz;
     const float3 normal = normalize(input._normal_world);
     const float3 camera_dir = normalize(_camera_pos.xyz - pos);
@@ -193,6 +330,7 @@ float4 psGeometry(VsOut input) : SV_TARGET{
 }
 
 float4 psFresnel(VsOut input) : SV_TARGET{
+    loadSurfaceProps(input);
     const float3 pos = input._position_world.xyz;
     const float3 normal = normalize(input._normal_world);
     const float3 camera_dir = normalize(_camera_pos.xyz - pos);
@@ -207,6 +345,7 @@ float4 psFresnel(VsOut input) : SV_TARGET{
 }
 
 float4 psPBR(VsOut input) : SV_TARGET{
+    loadSurfaceProps(input);
     const float3 pos = input._position_world.xyz;
     const float3 normal = normalize(input._normal_world);
     const float3 camera_dir = normalize(_camera_pos.xyz - pos);
@@ -218,6 +357,13 @@ float4 psPBR(VsOut input) : SV_TARGET{
         const float3 radiance = projectedRadiance(i, pos, normal);
         color += radiance * brdf(normal, light_dir, camera_dir);
     }
+    const uint2 range = clusterRange(pos);
+    for (uint j = 0; j < range.y; j++)
+    {
+        const ClusteredLight light = _clustered_lights[_cluster_light_indices[range.x + j]];
+        const float3 light_dir = normalize(light._position.xyz - pos);
+        color += clusteredRadiance(light, pos, normal) * brdf(normal, light_dir, camera_dir);
+    }
     color += ambient(camera_dir, normal);
     return float4(color, _base_color.a);
 }
@@ -234,6 +380,54 @@ float4 psCopyMain(VsCopyOut input) : SV_TARGET {
     return _texture_2d.Sample(_min_mag_mip_linear, input._tex);
 }
 
+float2 scaledTexCoord(float2 tex) {
+    float width, height;
+    _texture_2d.GetDimensions(width, height);
+    // Keep bilinear taps inside the rendered region
+    return min(tex * _uv_scale, _uv_scale - 0.5f / float2(width, height));
+}
+
+float4 psCopyScaledMain(VsCopyOut input) : SV_TARGET {
+    return _texture_2d.Sample(_min_mag_mip_linear, scaledTexCoord(input._tex));
+}
+
+float2 reprojectTexCoord(float2 tex, float depth) {
+    float4 world = mul(float4(tex.x * 2 - 1, 1 - tex.y * 2, depth, 1), _inv_view_projection);
+    float4 prev = mul(world / world.w, _prev_view_projection);
+    return float2(prev.x / prev.w * 0.5f + 0.5f, 0.5f - prev.y / prev.w * 0.5f);
+}
+
+// Temporal upsampling, see TemporalUpsampling.cpp for the CPU reference
+float4 psTemporalResolve(VsCopyOut input) : SV_TARGET {
+    float width, height;
+    _texture_2d.GetDimensions(width, height);
+    float2 size = float2(width, height);
+
+    // Same point of the jittered and possibly downscaled scene
+    float2 tex = input._tex * _uv_scale + _jitter_uv;
+    int2 last = int2(_uv_scale * size) - 1;
+    int2 center = clamp(int2(tex * size), 0, last);
+
+    float3 color_min = 1e30f;
+    float3 color_max = -1e30f;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            float3 c = _texture_2d.Load(int3(clamp(center + int2(dx, dy), 0, last), 0)).rgb;
+            color_min = min(color_min, c);
+            color_max = max(color_max, c);
+        }
+    }
+
+    float3 color = _texture_2d.SampleLevel(_min_mag_linear_mip_point_border, min(tex, _uv_scale - 0.5f / size), 0).rgb;
+
+    float2 prev_tex = reprojectTexCoord(input._tex, _scene_depth.Load(int3(center, 0)));
+    if (all(prev_tex == saturate(prev_tex))) {
+        float3 history = clamp(_history.SampleLevel(_min_mag_linear_mip_point_border, prev_tex, 0).rgb, color_min, color_max);
+        color = lerp(history, color, _current_weight);
+    }
+    return float4(color, 1);
+}
+
 float4 psLogLuminanceMain(VsCopyOut input) : SV_TARGET {
     float4 p = _texture_2d.Sample(_min_mag_mip_linear, input._tex);
     float l = 0.2126 * p.r + 0.7151 * p.g + 0.0722 * p.b;
@@ -271,7 +465,7 @@ float3 tonemapFilmic(float3 color)
 }
 
 float4 psToneMappingMain(VsCopyOut input) : SV_TARGET {
-    float4 color = _texture_2d.Sample(_min_mag_mip_linear, input._tex);
+    float4 color = _texture_2d.Sample(_min_mag_mip_linear, scaledTexCoord(input._tex));
     return float4(pow(tonemapFilmic(color.xyz), 1 / 2.2), color.a);
 }
 
@@ -419,6 +613,10 @@ VsSkymapOut vsSkymap(VsIn input) {
     return output;
 }
 
+VsSkymapOut vsSkymapCompact(VsCompactIn input) {
+    return vsSkymap(decodeVertex(input));
+}
+
 float4 psSkymap(VsSkymapOut input) : SV_TARGET {
     return _sky.SampleLevel(_min_mag_mip_linear, input._tex, 0);
 }
@@ -0,0 +1,239 @@
+#include "../lab-5/SoftwareRenderer/BrdfBatch.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+namespace {
+    const SimdLevel LEVELS[] = { SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    // Not a multiple of any vector width, so every level also runs its scalar tail
+    const size_t COUNT = 4099;
+
+    struct Points {
+        std::vector<float> _values[9];
+        BrdfBatch _batch;
+
+        explicit Points(size_t count, unsigned seed) {
+            std::mt19937 random(seed);
+            std::normal_distribution<float> gaussian;
+            for (std::vector<float>& values : _values) {
+                values.resize(count);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                // Normal, light and camera on the upper hemisphere, plus a few grazing and back facing ones
+                XMVECTOR n = XMVector3Normalize(XMVectorSet(gaussian(random), gaussian(random), gaussian(random), 0.0f));
+                XMVECTOR directions[2];
+                for (XMVECTOR& d : directions) {
+                    d = XMVector3Normalize(XMVectorSet(gaussian(random), gaussian(random), gaussian(random), 0.0f));
+                    if (i % 16 != 0 && XMVectorGetX(XMVector3Dot(d, n)) < 0.0f) {
+                        d = -d;
+                    }
+                }
+                const XMVECTOR vectors[3] = { n, directions[0], directions[1] };
+                for (size_t v = 0; v < 3; ++v) {
+                    XMFLOAT3 f;
+                    XMStoreFloat3(&f, vectors[v]);
+                    _values[3 * v][i] = f.x;
+                    _values[3 * v + 1][i] = f.y;
+                    _values[3 * v + 2][i] = f.z;
+                }
+            }
+            _batch._count = count;
+            for (size_t c = 0; c < 3; ++c) {
+                _batch._normal[c] = _values[c].data();
+                _batch._light_dir[c] = _values[3 + c].data();
+                _batch._camera_dir[c] = _values[6 + c].data();
+            }
+        }
+
+        XMVECTOR get(size_t v, size_t i) const {
+            return XMVectorSet(_values[3 * v][i], _values[3 * v + 1][i], _values[3 * v + 2][i], 0.0f);
+        }
+    };
+
+    std::vector<SurfacePropsCB> materials() {
+        std::vector<SurfacePropsCB> result;
+        const float roughnesses[] = { 0.0f, 0.05f, 0.3f, 0.7f, 1.0f };
+        const float metalnesses[] = { 0.0f, 0.5f, 1.0f };
+        for (float roughness : roughnesses) {
+            for (float metalness : metalnesses) {
+                SurfacePropsCB sprops;
+                sprops._base_color = XMFLOAT4(0.9f, 0.6f, 0.2f, 1.0f);
+                sprops._roughness = roughness;
+                sprops._metalness = metalness;
+                result.push_back(sprops);
+            }
+        }
+        return result;
+    }
+
+    // Outputs of one kernel, up to three channels
+    struct Output {
+        std::vector<float> _channels[3];
+        float* _pointers[3];
+
+        explicit Output(size_t count) {
+            for (size_t c = 0; c < 3; ++c) {
+                _channels[c].assign(count, -1.0f);
+                _pointers[c] = _channels[c].data();
+            }
+        }
+    };
+
+    using BatchFunction = void (*)(const Points& points, const SurfacePropsCB& sprops, Output& out, SimdLevel level);
+
+    void runNdf(const Points& points, const SurfacePropsCB& sprops, Output& out, SimdLevel level) {
+        batchNdf(points._batch, sprops, out._pointers[0], level);
+    }
+
+    void runGeometry(const Points& points, const SurfacePropsCB& sprops, Output& out, SimdLevel level) {
+        batchGeometry(points._batch, sprops, out._pointers[0], level);
+    }
+
+    void runFresnel(const Points& points, const SurfacePropsCB& sprops, Output& out, SimdLevel level) {
+        batchFresnel(points._batch, sprops, out._pointers, level);
+    }
+
+    void runBrdf(const Points& points, const SurfacePropsCB& sprops, Output& out, SimdLevel level) {
+        batchBrdf(points._batch, sprops, out._pointers, level);
+    }
+
+    // Every level runs the same operations in the same order and fused multiply-adds are off in the kernel
+    // files, so the vector kernels reproduce the scalar one bit for bit
+    void checkParity(BatchFunction function, size_t channels) {
+        const Points points(COUNT, 11);
+        for (const SurfacePropsCB& sprops : materials()) {
+            Output scalar(COUNT);
+            function(points, sprops, scalar, SimdLevel::SCALAR);
+            for (SimdLevel level : LEVELS) {
+                if (!isSimdLevelSupported(level)) {
+                    continue;
+                }
+                Output vector(COUNT);
+                function(points, sprops, vector, level);
+                size_t mismatches = 0;
+                for (size_t c = 0; c < channels; ++c) {
+                    for (size_t i = 0; i < COUNT; ++i) {
+                        mismatches += scalar._channels[c][i] != vector._channels[c][i];
+                    }
+                }
+                if (!CHECK(mismatches == 0)) {
+                    std::fprintf(stderr, "  %s, roughness %.2f, metalness %.2f: %zu mismatches\n", getSimdLevelName(level), sprops._roughness, sprops._metalness, mismatches);
+                }
+            }
+        }
+    }
+
+    void ndfParity() {
+        checkParity(runNdf, 1);
+    }
+
+    void geometryParity() {
+        checkParity(runGeometry, 1);
+    }
+
+    void fresnelParity() {
+        checkParity(runFresnel, 3);
+    }
+
+    void brdfParity() {
+        checkParity(runBrdf, 3);
+    }
+
+    // The batch kernels against the per-point ports of shaders.hlsl, which use DirectXMath and round differently
+    void brdfMatchesShaderPort() {
+        const Points points(COUNT, 5);
+        for (const SurfacePropsCB& sprops : materials()) {
+            Output out(COUNT);
+            batchBrdf(points._batch, sprops, out._pointers);
+            float max_error = 0.0f;
+            for (size_t i = 0; i < COUNT; ++i) {
+                XMFLOAT3 expected;
+                XMStoreFloat3(&expected, brdf(points.get(0, i), points.get(1, i), points.get(2, i), sprops));
+                const float e[3] = { expected.x, expected.y, expected.z };
+                for (size_t c = 0; c < 3; ++c) {
+                    max_error = std::max(max_error, std::fabs(out._channels[c][i] - e[c]) / std::max(1.0f, std::fabs(e[c])));
+                }
+            }
+            if (!CHECK(max_error < 1e-4f)) {
+                std::fprintf(stderr, "  roughness %.2f, metalness %.2f: relative error %g\n", sprops._roughness, sprops._metalness, max_error);
+            }
+        }
+    }
+
+    void ambientParity() {
+        // Small environment maps with distinct colors per direction are enough to see every fetch
+        TextureCube cube(8, 4);
+        for (size_t face = 0; face < 6; ++face) {
+            for (size_t mip = 0; mip < cube.getMipLevels(); ++mip) {
+                Texture2D& texture = cube.getFace(face, mip);
+                for (size_t y = 0; y < texture.getHeight(); ++y) {
+                    for (size_t x = 0; x < texture.getWidth(); ++x) {
+                        texture.at(x, y) = XMFLOAT4(0.1f * face + 0.05f * mip, (float)x / texture.getWidth(), (float)y / texture.getHeight(), 1.0f);
+                    }
+                }
+            }
+        }
+        Texture2D preintegrated(16, 16);
+        for (size_t y = 0; y < 16; ++y) {
+            for (size_t x = 0; x < 16; ++x) {
+                preintegrated.at(x, y) = XMFLOAT4(x / 16.0f, 1.0f - y / 16.0f, 0.0f, 1.0f);
+            }
+        }
+        ShaderResources resources;
+        resources._sky = &cube;
+        resources._irradiance = &cube;
+        resources._prefiltered = &cube;
+        resources._preintegrated = &preintegrated;
+
+        const Points points(COUNT, 3);
+        for (const SurfacePropsCB& sprops : materials()) {
+            Output scalar(COUNT);
+            batchAmbient(points._batch, sprops, resources, scalar._pointers, SimdLevel::SCALAR);
+            for (SimdLevel level : LEVELS) {
+                if (!isSimdLevelSupported(level)) {
+                    continue;
+                }
+                Output vector(COUNT);
+                batchAmbient(points._batch, sprops, resources, vector._pointers, level);
+                size_t mismatches = 0;
+                for (size_t c = 0; c < 3; ++c) {
+                    for (size_t i = 0; i < COUNT; ++i) {
+                        mismatches += scalar._channels[c][i] != vector._channels[c][i];
+                    }
+                }
+                CHECK(mismatches == 0);
+            }
+            // And the per-point port
+            float max_error = 0.0f;
+            for (size_t i = 0; i < COUNT; ++i) {
+                XMFLOAT3 expected;
+                XMStoreFloat3(&expected, ambient(points.get(2, i), points.get(0, i), sprops, resources));
+                max_error = std::max({ max_error, std::fabs(scalar._channels[0][i] - expected.x), std::fabs(scalar._channels[1][i] - expected.y),
+                    std::fabs(scalar._channels[2][i] - expected.z) });
+            }
+            CHECK(max_error < 1e-4f);
+        }
+    }
+}
+
+int main() {
+    for (SimdLevel level : LEVELS) {
+        std::printf("%s %s\n", getSimdLevelName(level), isSimdLevelSupported(level) ? "checked" : "not supported here, skipped");
+    }
+    return test::run({
+        { "ndf parity", ndfParity },
+        { "geometry parity", geometryParity },
+        { "fresnel parity", fresnelParity },
+        { "brdf parity", brdfParity },
+        { "brdf matches shader port", brdfMatchesShaderPort },
+        { "ambient parity", ambientParity },
+    });
+}
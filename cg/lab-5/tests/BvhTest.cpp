@@ -0,0 +1,222 @@
+#include "../lab-5/Scene/Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+namespace {
+    // Spheres in a flat slab like a scene, the first half of them stacked on one point when degenerate is set
+    BoundingSpheres makeSpheres(size_t count, bool degenerate, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+        BoundingSpheres spheres;
+        spheres.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (degenerate && i < count / 2) {
+                spheres.set(i, XMFLOAT3(1.0f, 2.0f, 3.0f), 1.0f);
+            } else {
+                spheres.set(i, XMFLOAT3(position(random), 0.3f * position(random), position(random)), size(random));
+            }
+        }
+        return spheres;
+    }
+
+    // Distance along a unit direction to the first point of the sphere in front of the origin, negative on a miss
+    float intersectSphere(const BoundingSpheres& spheres, uint32_t i, const XMFLOAT3& origin, const XMFLOAT3& dir, float t_max) {
+        const float ox = origin.x - spheres._x[i];
+        const float oy = origin.y - spheres._y[i];
+        const float oz = origin.z - spheres._z[i];
+        const float b = ox * dir.x + oy * dir.y + oz * dir.z;
+        const float h = b * b - (ox * ox + oy * oy + oz * oz - spheres._radius[i] * spheres._radius[i]);
+        if (h < 0.0f) {
+            return -1.0f;
+        }
+        float t = -b - std::sqrt(h);
+        if (t < 0.0f) {
+            t = -b + std::sqrt(h);
+        }
+        return t >= 0.0f && t <= t_max ? t : -1.0f;
+    }
+
+    std::vector<uint32_t> sorted(std::vector<uint32_t> objects) {
+        std::sort(objects.begin(), objects.end());
+        return objects;
+    }
+
+    FrustumPlanes randomFrustum(std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        const XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1.0f);
+        const XMVECTOR target = XMVectorSet(position(random), position(random), position(random), 1.0f);
+        return makeFrustumPlanes(XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(1.0f, 1.5f, 0.5f, 80.0f));
+    }
+
+    // Frustum and sphere queries against testing every box, both return each object once
+    size_t countQueryErrors(const Bvh& bvh, const std::vector<Aabb>& bounds, size_t queries, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> size(0.5f, 10.0f);
+        size_t errors = 0;
+        std::vector<uint32_t> objects;
+        for (size_t q = 0; q < queries; ++q) {
+            const FrustumPlanes planes = randomFrustum(random);
+            std::vector<uint32_t> expected;
+            for (uint32_t i = 0; i < bounds.size(); ++i) {
+                if (isAabbVisible(planes, bounds[i])) {
+                    expected.push_back(i);
+                }
+            }
+            bvh.queryFrustum(planes, objects);
+            errors += sorted(objects) != expected;
+
+            const XMFLOAT3 center(position(random), position(random), position(random));
+            const float radius = size(random);
+            expected.clear();
+            for (uint32_t i = 0; i < bounds.size(); ++i) {
+                if (overlapsAabb(bounds[i], center, radius)) {
+                    expected.push_back(i);
+                }
+            }
+            bvh.querySphere(center, radius, objects);
+            errors += sorted(objects) != expected;
+        }
+        return errors;
+    }
+
+    // Closest hit against every sphere. Rays start inside and outside the spheres, some run parallel to the slab
+    size_t countRayErrors(const Bvh& bvh, const BoundingSpheres& spheres, size_t rays, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        size_t errors = 0;
+        for (size_t r = 0; r < rays; ++r) {
+            const XMFLOAT3 origin(position(random), position(random), position(random));
+            const XMVECTOR dir_vector = XMVector3Normalize(XMVectorSet(position(random), r % 7 == 0 ? 0.0f : position(random), position(random), 0.0f));
+            XMFLOAT3 dir;
+            XMStoreFloat3(&dir, dir_vector);
+            const BvhRayHit hit = bvh.intersectRay(XMLoadFloat3(&origin), dir_vector, 1000.0f, [&](uint32_t i, float t_max) {
+                return intersectSphere(spheres, i, origin, dir, t_max);
+            });
+
+            float expected_t = -1.0f;
+            uint32_t expected = ~0u;
+            for (uint32_t i = 0; i < spheres.size(); ++i) {
+                const float t = intersectSphere(spheres, i, origin, dir, 1000.0f);
+                if (t >= 0.0f && (expected == ~0u || t < expected_t)) {
+                    expected_t = t;
+                    expected = i;
+                }
+            }
+            // Two spheres at the same distance may come back in either order
+            const bool same = hit._object == expected || (expected != ~0u && hit._object != ~0u && std::fabs(hit._t - expected_t) < 1e-4f);
+            errors += !same || (expected == ~0u) != (hit._t < 0.0f);
+        }
+        return errors;
+    }
+
+    void queriesMatchBruteForce() {
+        std::mt19937 random(1);
+        for (bool wide : { false, true }) {
+            for (size_t count : { (size_t)1, (size_t)3, (size_t)5, (size_t)100, (size_t)20000 }) {
+                for (bool degenerate : { false, true }) {
+                    const BoundingSpheres spheres = makeSpheres(count, degenerate, random);
+                    std::vector<Aabb> bounds;
+                    getSphereBounds(spheres, bounds);
+                    BvhOptions options;
+                    options._wide = wide;
+                    Bvh bvh(options);
+                    bvh.build(bounds);
+                    const size_t query_errors = countQueryErrors(bvh, bounds, 20, random);
+                    const size_t ray_errors = countRayErrors(bvh, spheres, count > 1000 ? 500 : 2000, random);
+                    if (!CHECK(query_errors == 0 && ray_errors == 0)) {
+                        std::fprintf(stderr, "  %s, %zu objects%s: %zu query and %zu ray errors\n", wide ? "4-wide" : "binary", count,
+                            degenerate ? ", half on one point" : "", query_errors, ray_errors);
+                    }
+                }
+            }
+        }
+    }
+
+    void refitKeepsQueriesExact() {
+        std::mt19937 random(2);
+        for (bool wide : { false, true }) {
+            BoundingSpheres spheres = makeSpheres(20000, false, random);
+            std::vector<Aabb> bounds;
+            getSphereBounds(spheres, bounds);
+            BvhOptions options;
+            options._wide = wide;
+            Bvh bvh(options);
+            bvh.build(bounds);
+            const float built_cost = bvh.getSahCost();
+            CHECK(bvh.getRebuildCount() == 0);
+
+            // A small move keeps the tree, its boxes follow the objects
+            for (size_t i = 0; i < spheres.size(); ++i) {
+                spheres._x[i] += i % 2 ? 0.5f : -0.5f;
+            }
+            getSphereBounds(spheres, bounds);
+            CHECK(!bvh.refit(bounds));
+            CHECK(bvh.getRebuildCount() == 0);
+            CHECK(bvh.getSahCost() >= built_cost && bvh.getSahCost() < built_cost * options._rebuild_ratio);
+            CHECK(countQueryErrors(bvh, bounds, 10, random) == 0);
+            CHECK(countRayErrors(bvh, spheres, 200, random) == 0);
+
+            // Shuffling every object degrades the tree past the ratio, refit builds it again
+            std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+            for (size_t i = 0; i < spheres.size(); ++i) {
+                spheres._x[i] = position(random);
+                spheres._z[i] = position(random);
+            }
+            getSphereBounds(spheres, bounds);
+            const bool rebuilt = bvh.refit(bounds);
+            if (!CHECK(rebuilt && bvh.getRebuildCount() == 1)) {
+                std::fprintf(stderr, "  %s: no rebuild at SAH cost %g, built at %g\n", wide ? "4-wide" : "binary", bvh.getSahCost(), built_cost);
+            }
+            CHECK(bvh.getSahCost() < built_cost * options._rebuild_ratio);
+            CHECK(countQueryErrors(bvh, bounds, 10, random) == 0);
+            CHECK(countRayErrors(bvh, spheres, 200, random) == 0);
+        }
+    }
+
+    void treeIsWellFormed() {
+        std::mt19937 random(3);
+        const BoundingSpheres spheres = makeSpheres(5000, true, random);
+        std::vector<Aabb> bounds;
+        getSphereBounds(spheres, bounds);
+        BvhOptions options;
+        Bvh bvh(options);
+        bvh.build(bounds);
+        // Leaves hold every object, every node box contains its children
+        const std::vector<BvhNode>& nodes = bvh.getNodes();
+        CHECK(nodes.size() == bvh.getNodeCount());
+        size_t objects = 0;
+        size_t bad = 0;
+        for (const BvhNode& node : nodes) {
+            if (node._count > 0) {
+                objects += node._count;
+                continue;
+            }
+            for (uint32_t child = node._first; child < node._first + 2; ++child) {
+                const BvhNode& c = nodes[child];
+                bad += c._min.x < node._min.x || c._min.y < node._min.y || c._min.z < node._min.z || c._max.x > node._max.x || c._max.y > node._max.y
+                    || c._max.z > node._max.z;
+            }
+        }
+        CHECK(objects == spheres.size());
+        CHECK(bad == 0);
+        // Nearly a cost of one object test per ray means the tree separates the objects
+        CHECK(bvh.getSahCost() > 1.0f && bvh.getSahCost() < 50.0f);
+    }
+}
+
+int main() {
+    return test::run({
+        { "queries match brute force", queriesMatchBruteForce },
+        { "refit keeps queries exact", refitKeepsQueriesExact },
+        { "tree is well formed", treeIsWellFormed },
+    });
+}
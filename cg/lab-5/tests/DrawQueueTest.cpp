@@ -0,0 +1,238 @@
+#include "../lab-5/DrawQueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace rendering;
+
+namespace {
+    struct Field {
+        const char* _name;
+        uint32_t DrawKeyFields::*_member;
+        uint32_t _bits;
+        // Lowest bit in the opaque and in the blended key
+        uint32_t _opaque_shift;
+        uint32_t _blended_shift;
+    };
+
+    const Field FIELDS[] = {
+        { "pass", &DrawKeyFields::_pass, DRAW_KEY_PASS_BITS, 60, 60 },
+        { "shader", &DrawKeyFields::_shader, DRAW_KEY_SHADER_BITS, 50, 26 },
+        { "material", &DrawKeyFields::_material, DRAW_KEY_MATERIAL_BITS, 36, 12 },
+        { "resources", &DrawKeyFields::_resources, DRAW_KEY_RESOURCE_BITS, 24, 0 },
+    };
+
+    uint64_t fieldMask(uint32_t bits, uint32_t shift) {
+        return (((uint64_t)1 << bits) - 1) << shift;
+    }
+
+    bool sameOrder(const std::vector<DrawPacket>& a, const std::vector<DrawPacket>& b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const DrawPacket& x, const DrawPacket& y) {
+            return x._key == y._key && x._draw == y._draw;
+        });
+    }
+
+    std::vector<DrawPacket> stableSorted(std::vector<DrawPacket> packets) {
+        std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket& x, const DrawPacket& y) {
+            return x._key < y._key;
+        });
+        return packets;
+    }
+
+    void keyOrder() {
+        DrawKeyFields near_draw;
+        near_draw._depth = 0.2f;
+        DrawKeyFields far_draw;
+        far_draw._depth = 0.7f;
+        // Front to back for opaque, back to front for blended
+        CHECK(makeOpaqueDrawKey(near_draw) < makeOpaqueDrawKey(far_draw));
+        CHECK(makeBlendedDrawKey(near_draw) > makeBlendedDrawKey(far_draw));
+        // In an opaque pass the shaders come before the depth, in any pass the pass comes first
+        far_draw._depth = 0.1f;
+        far_draw._shader = 1;
+        CHECK(makeOpaqueDrawKey(near_draw) < makeOpaqueDrawKey(far_draw));
+        near_draw._pass = 1;
+        CHECK(makeOpaqueDrawKey(near_draw) > makeOpaqueDrawKey(far_draw));
+        CHECK(getDrawKeyPass(makeOpaqueDrawKey(near_draw)) == 1 && getDrawKeyPass(makeBlendedDrawKey(near_draw)) == 1);
+
+        CHECK(quantizeDrawDepth(-1.0f) == 0 && quantizeDrawDepth(NAN) == 0);
+        CHECK(quantizeDrawDepth(1.0f) == (1u << DRAW_KEY_DEPTH_BITS) - 1 && quantizeDrawDepth(2.0f) == (1u << DRAW_KEY_DEPTH_BITS) - 1);
+    }
+
+    void fieldsFillTheirBitsExactly() {
+        // Every field at its largest value sets its bits and nothing else
+        for (const Field& field : FIELDS) {
+            DrawKeyFields fields;
+            fields.*field._member = (1u << field._bits) - 1;
+            const uint64_t opaque_depth = makeOpaqueDrawKey(DrawKeyFields());
+            const uint64_t blended_depth = makeBlendedDrawKey(DrawKeyFields());
+            if (!CHECK(makeOpaqueDrawKey(fields) == (fieldMask(field._bits, field._opaque_shift) | opaque_depth)
+                    && makeBlendedDrawKey(fields) == (fieldMask(field._bits, field._blended_shift) | blended_depth))) {
+                std::fprintf(stderr, "  %s at %u\n", field._name, fields.*field._member);
+            }
+        }
+        // The fields tile the key, all at their largest value give all ones
+        DrawKeyFields full;
+        full._pass = (1u << DRAW_KEY_PASS_BITS) - 1;
+        full._shader = (1u << DRAW_KEY_SHADER_BITS) - 1;
+        full._material = (1u << DRAW_KEY_MATERIAL_BITS) - 1;
+        full._resources = (1u << DRAW_KEY_RESOURCE_BITS) - 1;
+        full._depth = 1.0f;
+        CHECK(makeOpaqueDrawKey(full) == ~0ull);
+        full._depth = 0.0f;
+        CHECK(makeBlendedDrawKey(full) == ~0ull);
+        CHECK(DRAW_KEY_PASS_BITS + DRAW_KEY_SHADER_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_RESOURCE_BITS + DRAW_KEY_DEPTH_BITS == 64);
+        CHECK(makeOpaqueDrawKey(DrawKeyFields()) == 0);
+
+#ifdef NDEBUG
+        // Too large values assert in debug builds. Otherwise they clamp and leave the field above alone
+        for (const Field& field : FIELDS) {
+            for (uint32_t value : { 1u << field._bits, (1u << field._bits) + 1, ~0u }) {
+                DrawKeyFields fields;
+                fields.*field._member = value;
+                const uint64_t opaque = makeOpaqueDrawKey(fields);
+                const uint64_t blended = makeBlendedDrawKey(fields);
+                fields.*field._member = (1u << field._bits) - 1;
+                if (!CHECK(opaque == makeOpaqueDrawKey(fields) && blended == makeBlendedDrawKey(fields))) {
+                    std::fprintf(stderr, "  %s at %u\n", field._name, value);
+                }
+            }
+        }
+#endif
+    }
+
+    void stateIdsAreStableAndSmall() {
+        DrawStateIds ids(2);
+        const uintptr_t a[] = { 0x1000, 0x2000 };
+        const uintptr_t b[] = { 0x2000, 0x1000 };
+        const uintptr_t c[] = { 0x1000, 0x2000, 0 };
+        CHECK(ids.getId(a, 2) == 0);
+        CHECK(ids.getId(b, 2) == 1);
+        // A longer state is a different state even when it only adds a zero
+        CHECK(ids.getId(c, 3) == 2);
+        CHECK(ids.getId(a, 2) == 0 && ids.getId(b, 2) == 1 && ids.getId(c, 3) == 2);
+        CHECK(ids.getId(nullptr, 0) == 3);
+        CHECK(ids.getCount() == 4);
+#ifdef NDEBUG
+        // Past what two bits hold new states share the largest id
+        const uintptr_t d = 0x3000;
+        CHECK(ids.getId(&d, 1) == 3);
+#endif
+        ids.clear();
+        CHECK(ids.getCount() == 0 && ids.getId(b, 2) == 0);
+    }
+
+    // Thousands of states of every size, many of them differing in one word, against ids from a std::map.
+    // The table grows several times on the way
+    void stateIdsMatchReference() {
+        std::mt19937_64 random(5);
+        std::uniform_int_distribution<uintptr_t> handle(0, 63);
+        DrawStateIds ids(DRAW_KEY_MATERIAL_BITS);
+        std::map<std::vector<uintptr_t>, uint32_t> reference;
+        size_t mismatches = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t i = 0; i < 20000; ++i) {
+                std::vector<uintptr_t> state(random() % (DrawStateIds::MAX_STATE_SIZE + 1));
+                for (uintptr_t& word : state) {
+                    word = 0x10000 + handle(random) * 64;
+                }
+                const uint32_t expected = reference.emplace(state, (uint32_t)reference.size()).first->second;
+                mismatches += ids.getId(state.data(), state.size()) != expected;
+            }
+            CHECK(ids.getCount() == reference.size());
+            // Cleared, the same states are numbered again from zero
+            ids.clear();
+            reference.clear();
+        }
+        if (!CHECK(mismatches == 0)) {
+            std::fprintf(stderr, "  %zu ids differ\n", mismatches);
+        }
+    }
+
+    void sortIsStable() {
+        std::mt19937_64 random(3);
+        for (size_t count : { (size_t)0, (size_t)1, (size_t)2, (size_t)31, (size_t)32, (size_t)33, (size_t)100, (size_t)1000, (size_t)100000 }) {
+            // Random keys, keys that only differ in the pass and the lowest byte, and keys that are all equal
+            for (int distribution = 0; distribution < 3; ++distribution) {
+                std::vector<DrawPacket> packets(count);
+                for (size_t i = 0; i < count; ++i) {
+                    uint64_t key = random();
+                    key = distribution == 1 ? key & 0xf0000000000000ffull : distribution == 2 ? 42 : key;
+                    packets[i] = { key, (uint32_t)i };
+                }
+                const std::vector<DrawPacket> expected = stableSorted(packets);
+                std::vector<DrawPacket> scratch;
+                radixSortDrawPackets(packets, scratch);
+                if (!CHECK(sameOrder(packets, expected))) {
+                    std::fprintf(stderr, "  %zu packets, distribution %d\n", count, distribution);
+                }
+            }
+        }
+    }
+
+    void sceneDrawsGroupByState() {
+        // 100k draws over 32 shader pairs, 500 materials and 200 resource sets, every tenth one blended
+        std::mt19937 random(5);
+        std::uniform_int_distribution<uint32_t> shader(0, 31);
+        std::uniform_int_distribution<uint32_t> material(0, 499);
+        std::uniform_int_distribution<uint32_t> resources(0, 199);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        const size_t count = 100000;
+        std::vector<DrawKeyFields> draws(count);
+        DrawQueue queue;
+        for (size_t i = 0; i < count; ++i) {
+            DrawKeyFields& draw = draws[i];
+            draw._pass = i % 10 == 0 ? 1 : 0;
+            draw._shader = shader(random);
+            draw._material = material(random);
+            draw._resources = resources(random);
+            draw._depth = depth(random);
+            queue.push(draw._pass ? makeBlendedDrawKey(draw) : makeOpaqueDrawKey(draw), (uint32_t)i);
+        }
+        queue.sort();
+        const std::vector<DrawPacket>& packets = queue.getPackets();
+        CHECK(packets.size() == count);
+
+        // Every opaque draw before every blended one. Opaque draws change shaders once per pair, and
+        // within a shader front to back for equal state. Blended draws go back to front
+        size_t shader_changes = 0;
+        size_t order_errors = 0;
+        std::vector<bool> seen(count, false);
+        for (size_t i = 0; i < count; ++i) {
+            seen[packets[i]._draw] = true;
+            if (i == 0) {
+                continue;
+            }
+            const DrawKeyFields& a = draws[packets[i - 1]._draw];
+            const DrawKeyFields& b = draws[packets[i]._draw];
+            order_errors += a._pass > b._pass;
+            if (a._pass == 0 && b._pass == 0) {
+                shader_changes += a._shader != b._shader;
+                const bool same_state = a._shader == b._shader && a._material == b._material && a._resources == b._resources;
+                order_errors += same_state && quantizeDrawDepth(a._depth) > quantizeDrawDepth(b._depth);
+            } else if (a._pass == 1 && b._pass == 1) {
+                order_errors += quantizeDrawDepth(a._depth) < quantizeDrawDepth(b._depth);
+            }
+        }
+        CHECK(order_errors == 0);
+        CHECK(shader_changes == 31);
+        CHECK(std::count(seen.begin(), seen.end(), true) == (std::ptrdiff_t)count);
+    }
+}
+
+int main() {
+    return test::run({
+        { "key order", keyOrder },
+        { "fields fill their bits exactly", fieldsFillTheirBitsExactly },
+        { "state ids are stable and small", stateIdsAreStableAndSmall },
+        { "state ids match reference", stateIdsMatchReference },
+        { "sort is stable", sortIsStable },
+        { "scene draws group by state", sceneDrawsGroupByState },
+    });
+}
@@ -0,0 +1,123 @@
+#include "../lab-5/Scene/FrustumCulling.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+namespace {
+    const SimdLevel LEVELS[] = { SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2, SimdLevel::AVX512 };
+
+    FrustumPlanes makePlanes() {
+        const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(3.0f, 2.0f, -10.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+        return makeFrustumPlanes(view * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 50.0f));
+    }
+
+    // Spheres all around the frustum. Every third one touches a plane: its radius is minus the distance the
+    // kernels compute, so whether it stays depends on the last bit of the distance and a fused multiply-add flips it
+    BoundingSpheres makeSpheres(const FrustumPlanes& planes, size_t count, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+        std::uniform_real_distribution<float> size(0.01f, 3.0f);
+        std::uniform_int_distribution<int> plane(0, 5);
+        BoundingSpheres spheres;
+        spheres.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const XMFLOAT3 center(position(random), position(random), position(random) + 20.0f);
+            float radius = size(random);
+            if (i % 3 == 0) {
+                const int p = plane(random);
+                const float distance = planes._a[p] * center.x + planes._b[p] * center.y + planes._c[p] * center.z + planes._d[p];
+                radius = distance < 0.0f ? -distance : radius;
+            }
+            spheres.set(i, center, radius);
+        }
+        return spheres;
+    }
+
+    std::vector<uint32_t> reference(const FrustumPlanes& planes, const BoundingSpheres& spheres, size_t begin, size_t end) {
+        std::vector<uint32_t> visible;
+        for (size_t i = begin; i < end; ++i) {
+            if (isSphereVisible(planes, XMFLOAT3(spheres._x[i], spheres._y[i], spheres._z[i]), spheres._radius[i])) {
+                visible.push_back((uint32_t)i);
+            }
+        }
+        return visible;
+    }
+
+    void kernelsMatchScalarExactly() {
+        const FrustumPlanes planes = makePlanes();
+        const BoundingSpheres spheres = makeSpheres(planes, 4099, 7);
+        const std::vector<uint32_t> expected = reference(planes, spheres, 0, spheres.size());
+        // The test only means something when both sides of the borderline spheres are there
+        CHECK(expected.size() > spheres.size() / 10 && expected.size() < spheres.size() * 9 / 10);
+
+        for (SimdLevel level : LEVELS) {
+            if (!software::isSimdLevelSupported(level)) {
+                continue;
+            }
+            // Ranges that start and end off the vector width, and ranges shorter than one vector
+            const size_t ranges[][2] = { { 0, spheres.size() }, { 1, spheres.size() }, { 5, 4000 }, { 17, 30 }, { 100, 103 }, { 50, 50 } };
+            for (const size_t* range : ranges) {
+                const std::vector<uint32_t> range_expected = reference(planes, spheres, range[0], range[1]);
+                // One guard index past the room cullSpheres may use
+                std::vector<uint32_t> out(range[1] - range[0] + 1, 0xdeadbeef);
+                const size_t count = cullSpheres(planes, spheres, range[0], range[1], out.data(), level);
+                const bool same = count == range_expected.size() && std::vector<uint32_t>(out.begin(), out.begin() + count) == range_expected
+                    && out.back() == 0xdeadbeef;
+                if (!CHECK(same)) {
+                    std::fprintf(stderr, "  %s [%zu, %zu): %zu visible, %zu expected\n", software::getSimdLevelName(level), range[0], range[1], count,
+                        range_expected.size());
+                }
+            }
+        }
+    }
+
+    void parallelMatchesSerial() {
+        // Several chunks and a partial one, chunks see very different visible counts
+        const FrustumPlanes planes = makePlanes();
+        const BoundingSpheres spheres = makeSpheres(planes, 100003, 11);
+        const std::vector<uint32_t> expected = reference(planes, spheres, 0, spheres.size());
+        for (SimdLevel level : LEVELS) {
+            if (!software::isSimdLevelSupported(level)) {
+                continue;
+            }
+            std::vector<uint32_t> visible;
+            cullSpheresParallel(planes, spheres, visible, level);
+            if (!CHECK(visible == expected)) {
+                std::fprintf(stderr, "  %s: %zu visible, %zu expected\n", software::getSimdLevelName(level), visible.size(), expected.size());
+            }
+        }
+
+        // Nothing visible and everything visible
+        BoundingSpheres far_away;
+        far_away.resize(40000);
+        for (size_t i = 0; i < far_away.size(); ++i) {
+            far_away.set(i, XMFLOAT3(0.0f, 0.0f, -1000.0f - i), 1.0f);
+        }
+        std::vector<uint32_t> visible(5, 0);
+        cullSpheresParallel(planes, far_away, visible);
+        CHECK(visible.empty());
+        BoundingSpheres huge = far_away;
+        for (float& radius : huge._radius) {
+            radius = 1e6f;
+        }
+        cullSpheresParallel(planes, huge, visible);
+        CHECK(visible.size() == huge.size() && visible.back() == huge.size() - 1);
+    }
+}
+
+int main() {
+    for (SimdLevel level : LEVELS) {
+        std::printf("%s %s\n", software::getSimdLevelName(level), software::isSimdLevelSupported(level) ? "checked" : "not supported here, skipped");
+    }
+    return test::run({
+        { "kernels match scalar exactly", kernelsMatchScalarExactly },
+        { "parallel matches serial", parallelMatchesSerial },
+    });
+}
@@ -0,0 +1,266 @@
+#include "../lab-5/Geometry/GeometryRegistry.h"
+#include "../lab-5/Sphere.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    // Buffers in plain memory. Every byte remembers how often it was written, so an upload has to cover
+    // each one exactly once
+    class MockDevice : public GeometryDevice {
+    public:
+        struct Buffer {
+            GeometryBufferType _type;
+            std::vector<uint8_t> _bytes;
+            std::vector<uint8_t> _writes;
+            bool _misaligned = false;
+        };
+
+        void* createBuffer(GeometryBufferType type, size_t byte_size) override {
+            ++_created;
+            _live.push_back(std::unique_ptr<Buffer>(new Buffer{ type, std::vector<uint8_t>(byte_size), std::vector<uint8_t>(byte_size) }));
+            return _live.back().get();
+        }
+
+        void writeBuffer(void* buffer, size_t byte_offset, size_t byte_size, const void* data) override {
+            ++_written;
+            Buffer& target = *(Buffer*)buffer;
+            const size_t element_size = target._type == GeometryBufferType::VERTEX ? sizeof(SimpleVertex) : sizeof(unsigned);
+            target._misaligned |= byte_offset % element_size != 0 || byte_size % element_size != 0;
+            if (byte_offset + byte_size > target._bytes.size()) {
+                target._misaligned = true;
+                return;
+            }
+            memcpy(target._bytes.data() + byte_offset, data, byte_size);
+            for (size_t i = byte_offset; i < byte_offset + byte_size; ++i) {
+                ++target._writes[i];
+            }
+        }
+
+        void releaseBuffer(void* buffer) override {
+            for (size_t i = 0; i < _live.size(); ++i) {
+                if (_live[i].get() == buffer) {
+                    _live.erase(_live.begin() + i);
+                    return;
+                }
+            }
+            ++_bad_releases;
+        }
+
+        // Written once everywhere and only in whole elements
+        static bool complete(const Buffer& buffer) {
+            for (uint8_t writes : buffer._writes) {
+                if (writes != 1) {
+                    return false;
+                }
+            }
+            return !buffer._misaligned;
+        }
+
+        std::vector<std::unique_ptr<Buffer>> _live;
+        size_t _created = 0;
+        size_t _written = 0;
+        size_t _bad_releases = 0;
+    };
+
+    bool sameVertex(const SimpleVertex& a, const SimpleVertex& b) {
+        return memcmp(&a, &b, sizeof(SimpleVertex)) == 0;
+    }
+
+    // What DrawIndexed(handle) reads from the uploaded buffers matches the mesh the registry was given
+    bool drawsMesh(const GeometryRegistry& registry, const MeshHandle& handle, const SimpleVertex* vertices, const unsigned* indices) {
+        const SimpleVertex* arena_vertices = (const SimpleVertex*)((MockDevice::Buffer*)registry.getVertexBuffer())->_bytes.data();
+        const unsigned* arena_indices = (const unsigned*)((MockDevice::Buffer*)registry.getIndexBuffer())->_bytes.data();
+        for (uint32_t i = 0; i < handle._index_count; ++i) {
+            const unsigned index = arena_indices[handle._first_index + i];
+            if (index != indices[i] || index >= handle._vertex_count || !sameVertex(arena_vertices[handle._base_vertex + index], vertices[index])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void keysSeparateEveryParameter() {
+        const MeshKey base = sphereKey(1.0f, 30, 30, true, true);
+        MeshKey keys[] = { base, base, base, base, base, base, base, base };
+        keys[1]._radius = 2.0f;
+        keys[2]._n_theta = 31;
+        keys[3]._n_phi = 31;
+        keys[4]._flags = MESH_OUTER_NORMALS;
+        keys[5]._kind = MeshKind::SPHERE_LOD_CHAIN;
+        keys[6]._level_count = 4;
+        keys[7]._length = 0.5f;
+        for (size_t i = 0; i < 8; ++i) {
+            for (size_t j = 0; j < 8; ++j) {
+                CHECK((keys[i] == keys[j]) == (i == j));
+            }
+        }
+        CHECK(MeshKeyHash()(base) == MeshKeyHash()(sphereKey(1.0f, 30, 30, true, true)));
+
+        // Every key gets its own mesh, asking again is a hit and does not build
+        GeometryRegistry registry;
+        size_t builds = 0;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const MeshKey& key : keys) {
+                registry.getOrBuild(key, [&](std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices) {
+                    ++builds;
+                    vertices.resize(3);
+                    indices = { 0, 1, 2 };
+                });
+            }
+        }
+        CHECK(builds == 8 && registry.getMeshCount() == 8 && registry.getHitCount() == 8);
+    }
+
+    void meshesAreBuiltOnce() {
+        GeometryRegistry registry;
+        const MeshHandle sphere = registry.getSphere(1.0f, 20, 20, true, true);
+        const MeshHandle quad = registry.getQuad();
+        CHECK(registry.getMeshCount() == 2 && registry.getHitCount() == 0);
+
+        const MeshHandle again = registry.getSphere(1.0f, 20, 20, true, true);
+        CHECK(memcmp(&again, &sphere, sizeof(MeshHandle)) == 0);
+        const MeshHandle quad_again = registry.getQuad();
+        CHECK(memcmp(&quad_again, &quad, sizeof(MeshHandle)) == 0);
+        // Same parameters through add: the data is not looked at and nothing grows
+        const size_t vertex_count = registry.getVertexCount();
+        const MeshHandle added = registry.add(sphereKey(1.0f, 20, 20, true, true), nullptr, 123, nullptr, 456);
+        CHECK(memcmp(&added, &sphere, sizeof(MeshHandle)) == 0);
+        CHECK(registry.getVertexCount() == vertex_count && registry.getMeshCount() == 2 && registry.getHitCount() == 3);
+
+        // Other orientation flags are another mesh with the same vertex count
+        const MeshHandle inner = registry.getSphere(1.0f, 20, 20, false, true);
+        CHECK(inner._base_vertex != sphere._base_vertex && inner._vertex_count == sphere._vertex_count);
+        CHECK(registry.getMeshCount() == 3);
+    }
+
+    void arenaPacksStoredAndExternalMeshes() {
+        const Sphere external_sphere(1.0f, 12, 16, true, true);
+        const Sphere stored_sphere(2.0f, 8, 8, true, true);
+        GeometryRegistry registry;
+        MockDevice device;
+
+        // Stored, external, stored, stored, external: the handles tile both arenas in order
+        const MeshHandle quad = registry.getQuad();
+        MeshKey external_key = sphereKey(1.0f, 12, 16, true, true);
+        external_key._kind = MeshKind::SPHERE_LOD_CHAIN;
+        const MeshHandle external = registry.addExternal(external_key, external_sphere.getVertices().data(), external_sphere.getVertices().size(),
+            external_sphere.getIndices().data(), external_sphere.getIndices().size());
+        const MeshHandle stored = registry.add(sphereKey(2.0f, 8, 8, true, true), stored_sphere.getVertices().data(), stored_sphere.getVertices().size(),
+            stored_sphere.getIndices().data(), stored_sphere.getIndices().size());
+        const MeshHandle cube = registry.getCubeFaces();
+        std::vector<SimpleVertex> triangle_vertices(3);
+        triangle_vertices[1]._pos.x = 1.0f;
+        triangle_vertices[2]._pos.y = 1.0f;
+        const std::vector<unsigned> triangle_indices = { 0, 1, 2 };
+        MeshKey triangle_key;
+        triangle_key._kind = MeshKind::TORUS;
+        const MeshHandle triangle = registry.addExternal(triangle_key, triangle_vertices.data(), 3, triangle_indices.data(), 3);
+
+        const MeshHandle handles[] = { quad, external, stored, cube, triangle };
+        uint32_t next_vertex = 0;
+        uint32_t next_index = 0;
+        for (const MeshHandle& handle : handles) {
+            CHECK(handle._base_vertex == (int32_t)next_vertex && handle._first_index == next_index);
+            next_vertex += handle._vertex_count;
+            next_index += handle._index_count;
+        }
+        CHECK(registry.getVertexCount() == next_vertex && registry.getIndexCount() == next_index);
+        // External meshes are not copied
+        const size_t stored_bytes = sizeof(SimpleVertex) * (quad._vertex_count + stored._vertex_count + cube._vertex_count)
+            + sizeof(unsigned) * (quad._index_count + stored._index_count + cube._index_count);
+        CHECK(registry.getStoredByteSize() == stored_bytes);
+        CHECK(registry.getVertices(external) == external_sphere.getVertices().data());
+        CHECK(registry.getIndices(triangle) == triangle_indices.data());
+
+        // Byte offsets in whole elements, every byte written once, runs of stored meshes in one write
+        CHECK(registry.upload(device));
+        CHECK(device._created == 2 && device._live.size() == 2);
+        CHECK(device._written == 2 * 4);
+        const MockDevice::Buffer& vertex_buffer = *(MockDevice::Buffer*)registry.getVertexBuffer();
+        const MockDevice::Buffer& index_buffer = *(MockDevice::Buffer*)registry.getIndexBuffer();
+        CHECK(vertex_buffer._type == GeometryBufferType::VERTEX && vertex_buffer._bytes.size() == sizeof(SimpleVertex) * next_vertex);
+        CHECK(index_buffer._type == GeometryBufferType::INDEX && index_buffer._bytes.size() == sizeof(unsigned) * next_index);
+        CHECK(MockDevice::complete(vertex_buffer) && MockDevice::complete(index_buffer));
+
+        CHECK(drawsMesh(registry, external, external_sphere.getVertices().data(), external_sphere.getIndices().data()));
+        CHECK(drawsMesh(registry, stored, stored_sphere.getVertices().data(), stored_sphere.getIndices().data()));
+        CHECK(drawsMesh(registry, triangle, triangle_vertices.data(), triangle_indices.data()));
+        CHECK(drawsMesh(registry, quad, registry.getVertices(quad), registry.getIndices(quad)));
+        // The six face draws of a cube map bake land on the right face: face f has the normal of axis f / 2
+        for (uint32_t face = 0; face < 6; ++face) {
+            MeshHandle face_handle = cube;
+            face_handle._first_index += 6 * face;
+            face_handle._index_count = 6;
+            const SimpleVertex* arena_vertices = (const SimpleVertex*)vertex_buffer._bytes.data();
+            const unsigned* arena_indices = (const unsigned*)index_buffer._bytes.data();
+            for (uint32_t i = 0; i < 6; ++i) {
+                const SimpleVertex& vertex = arena_vertices[cube._base_vertex + arena_indices[face_handle._first_index + i]];
+                const float coordinates[] = { vertex._pos.x, vertex._pos.y, vertex._pos.z };
+                CHECK(coordinates[face / 2] == (face % 2 == 0 ? 0.5f : -0.5f));
+            }
+        }
+
+        registry.release(device);
+        CHECK(device._live.empty() && device._bad_releases == 0);
+    }
+
+    void uploadsFollowTheArena() {
+        GeometryRegistry registry;
+        MockDevice device;
+        const MeshHandle quad = registry.getQuad();
+        CHECK(registry.upload(device));
+        CHECK(device._created == 2);
+        // Clean: nothing is created or written
+        const size_t written = device._written;
+        CHECK(!registry.upload(device));
+        CHECK(device._created == 2 && device._written == written);
+        // A hit does not dirty the arena
+        registry.getQuad();
+        CHECK(!registry.upload(device));
+
+        // Growth replaces both buffers, old handles still draw the same mesh
+        std::vector<SimpleVertex> quad_vertices(registry.getVertices(quad), registry.getVertices(quad) + quad._vertex_count);
+        const MeshHandle torus = registry.getTorus(1.0f, 0.25f, 24, 12);
+        CHECK(registry.upload(device));
+        CHECK(device._created == 4 && device._live.size() == 2 && device._bad_releases == 0);
+        CHECK(drawsMesh(registry, quad, quad_vertices.data(), registry.getIndices(quad)));
+        CHECK(torus._base_vertex == (int32_t)quad._vertex_count && torus._first_index == quad._index_count);
+
+        // External data is read again by every upload, so it has to be valid until release
+        std::vector<SimpleVertex> vertices(3);
+        const std::vector<unsigned> indices = { 0, 2, 1 };
+        MeshKey key;
+        key._kind = MeshKind::CAPSULE;
+        const MeshHandle external = registry.addExternal(key, vertices.data(), 3, indices.data(), 3);
+        vertices[2]._pos.z = 7.0f;
+        CHECK(registry.upload(device));
+        CHECK(drawsMesh(registry, external, vertices.data(), indices.data()));
+        CHECK(MockDevice::complete(*(MockDevice::Buffer*)registry.getVertexBuffer()));
+
+        // After a release, for a lost device, the next upload creates everything again
+        registry.release(device);
+        CHECK(device._live.empty());
+        CHECK(registry.upload(device));
+        CHECK(device._live.size() == 2 && drawsMesh(registry, torus, registry.getVertices(torus), registry.getIndices(torus)));
+        registry.release(device);
+        CHECK(device._live.empty() && device._bad_releases == 0);
+    }
+}
+
+int main() {
+    return test::run({
+        { "keys separate every parameter", keysSeparateEveryParameter },
+        { "meshes are built once", meshesAreBuiltOnce },
+        { "arena packs stored and external meshes", arenaPacksStoredAndExternalMeshes },
+        { "uploads follow the arena", uploadsFollowTheArena },
+    });
+}
@@ -0,0 +1,234 @@
+#include "../lab-5/InputJournal.h"
+#include "../lab-5/Keys.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    // Byte offset of the event count in the header
+    const size_t EVENT_COUNT_OFFSET = 16;
+
+    InputJournal sampleJournal() {
+        InputJournal journal(1.0f / 30.0f);
+        journal.record(resizeEvent(1280, 720));
+        journal.record(parameterEvent(InputParameter::EXPOSURE_SCALE, 1.5f));
+        journal.nextFrame();
+        journal.record(keyEvent('W', false));
+        journal.record(keyEvent('W', true));
+        journal.nextFrame();
+        journal.nextFrame();
+        journal.record(mouseEvent(-3, 200));
+        journal.record(parameterEvent(InputParameter::FILL_LIGHTS, 64.0f));
+        journal.nextFrame();
+        return journal;
+    }
+
+    void setU32(std::vector<uint8_t>& bytes, size_t offset, uint32_t value) {
+        for (size_t i = 0; i < 4; ++i) {
+            bytes[offset + i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+
+    void roundTrip() {
+        const InputJournal journal = sampleJournal();
+        std::vector<uint8_t> bytes;
+        journal.encode(bytes);
+
+        InputJournal decoded;
+        CHECK(decoded.decode(bytes));
+        CHECK(decoded.getTimestep() == journal.getTimestep());
+        CHECK(decoded.getFrameCount() == 4);
+        const std::vector<InputEvent>& expected = journal.getEvents();
+        const std::vector<InputEvent>& events = decoded.getEvents();
+        if (!CHECK(events.size() == expected.size())) {
+            return;
+        }
+        for (size_t i = 0; i < events.size(); ++i) {
+            CHECK(events[i]._frame == expected[i]._frame);
+            CHECK(events[i]._type == expected[i]._type);
+            CHECK(events[i]._code == expected[i]._code);
+            CHECK(events[i]._x == expected[i]._x);
+            CHECK(events[i]._y == expected[i]._y);
+            CHECK(events[i]._value == expected[i]._value);
+        }
+    }
+
+    void rejectsTruncatedJournal() {
+        std::vector<uint8_t> bytes;
+        sampleJournal().encode(bytes);
+        for (size_t size = 0; size < bytes.size(); ++size) {
+            InputJournal decoded;
+            CHECK(!decoded.decode(std::vector<uint8_t>(bytes.begin(), bytes.begin() + size)));
+            // A failed decode leaves the journal as it was
+            CHECK(decoded.getEvents().empty() && decoded.getFrameCount() == 0);
+        }
+        bytes.push_back(0);
+        CHECK(!InputJournal().decode(bytes));
+    }
+
+    void rejectsEventCountBeyondData() {
+        std::vector<uint8_t> bytes;
+        sampleJournal().encode(bytes);
+        // Would reserve tens of gigabytes before reading the first event
+        setU32(bytes, EVENT_COUNT_OFFSET, 0xffffffff);
+        CHECK(!InputJournal().decode(bytes));
+        setU32(bytes, EVENT_COUNT_OFFSET, (uint32_t)(bytes.size() - EVENT_COUNT_OFFSET - 4) / 4 + 1);
+        CHECK(!InputJournal().decode(bytes));
+
+        // The smallest events are four bytes, a count right at the limit still decodes
+        InputJournal mouse_only;
+        for (int i = 0; i < 10; ++i) {
+            mouse_only.record(mouseEvent(i, -i));
+        }
+        mouse_only.encode(bytes);
+        CHECK(bytes.size() == EVENT_COUNT_OFFSET + 4 + 40);
+        CHECK(InputJournal().decode(bytes));
+    }
+
+    void rejectsUnknownParameter() {
+        InputJournal journal;
+        journal.record(parameterEvent(InputParameter::FILL_LIGHTS, 1.0f));
+        std::vector<uint8_t> bytes;
+        journal.encode(bytes);
+        CHECK(InputJournal().decode(bytes));
+
+        // Type, frame delta, then the parameter code
+        const size_t code_offset = EVENT_COUNT_OFFSET + 4 + 2;
+        CHECK(bytes[code_offset] == (uint8_t)InputParameter::FILL_LIGHTS);
+        bytes[code_offset] = (uint8_t)INPUT_PARAMETER_COUNT;
+        CHECK(!InputJournal().decode(bytes));
+        bytes[code_offset] = 0xff;
+        CHECK(!InputJournal().decode(bytes));
+    }
+
+    void rejectsUnknownEventType() {
+        InputJournal journal;
+        journal.record(mouseEvent(1, 1));
+        std::vector<uint8_t> bytes;
+        journal.encode(bytes);
+        bytes[EVENT_COUNT_OFFSET + 4] = (uint8_t)InputEventType::PARAMETER + 1;
+        CHECK(!InputJournal().decode(bytes));
+    }
+
+    // What Renderer keeps of the input outside the UI: the camera, the viewport size and the simulated time
+    struct HeadlessView {
+        Camera _camera = Camera(XMVectorSet(0.0f, 1.5f, -3.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+        WorldBorders _borders = { XMVectorSet(-20.0f, -10.0f, -20.0f, 0.0f), XMVectorSet(20.0f, 10.0f, 20.0f, 0.0f) };
+        uint32_t _width = 1280;
+        uint32_t _height = 720;
+        float _time = 0.0f;
+
+        // Renderer::applyInput without the light keys and the parameters, which do not touch this state
+        void apply(const InputEvent& event) {
+            if (!applyCameraInput(event, _camera, _borders) && event._type == InputEventType::RESIZE) {
+                _width = (uint32_t)event._x;
+                _height = (uint32_t)event._y;
+            }
+        }
+
+        XMFLOAT4X4 getViewProjection() const {
+            XMFLOAT4X4 matrix;
+            XMStoreFloat4x4(&matrix, _camera.getViewMatrix() * XMMatrixPerspectiveFovLH(XM_PIDIV2, _width / (float)_height, 0.01f, 100.0f));
+            return matrix;
+        }
+    };
+
+    bool sameBits(const XMFLOAT4X4& a, const XMFLOAT4X4& b) {
+        return std::memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    bool sameBits(FXMVECTOR a, FXMVECTOR b) {
+        XMFLOAT4 x, y;
+        XMStoreFloat4(&x, a);
+        XMStoreFloat4(&y, b);
+        return std::memcmp(&x, &y, sizeof(x)) == 0;
+    }
+
+    void replayReproducesCamera() {
+        // Random WASD, light keys with and without repeat, mouse look, resizes and parameters for 1200 frames,
+        // long enough to walk into the world borders
+        std::mt19937 random(7);
+        // Mostly forward and small turns, so the walk drifts away from the start
+        const uint32_t keys[] = { (uint32_t)Keys::W_KEY, (uint32_t)Keys::W_KEY, (uint32_t)Keys::W_KEY, (uint32_t)Keys::A_KEY,
+            (uint32_t)Keys::S_KEY, (uint32_t)Keys::D_KEY, (uint32_t)Keys::_1_KEY };
+        std::uniform_int_distribution<int> event_count(0, 3);
+        std::uniform_int_distribution<int> kind(0, 9);
+        std::uniform_int_distribution<int> delta(-10, 10);
+        std::uniform_int_distribution<uint32_t> size(200, 2000);
+
+        InputJournal journal;
+        HeadlessView live;
+        std::vector<XMFLOAT4X4> frames;
+        size_t border_frames = 0;
+        for (int frame = 0; frame < 1200; ++frame) {
+            for (int e = event_count(random); e > 0; --e) {
+                const int k = kind(random);
+                InputEvent event;
+                if (k < 6) {
+                    event = keyEvent(keys[random() % 7], random() % 2 == 0);
+                } else if (k < 9) {
+                    event = mouseEvent(delta(random), delta(random));
+                } else if (random() % 2 == 0) {
+                    event = resizeEvent(size(random), size(random));
+                } else {
+                    event = parameterEvent(InputParameter::ROUGHNESS, (float)(random() % 100) / 100.0f);
+                }
+                // Renderer::handleInput records before it applies
+                journal.record(event);
+                live.apply(event);
+            }
+            XMFLOAT3 position;
+            XMStoreFloat3(&position, live._camera.getPosition());
+            border_frames += std::fabs(position.x) == 20.0f || std::fabs(position.y) == 10.0f || std::fabs(position.z) == 20.0f;
+            live._time += journal.getTimestep();
+            frames.push_back(live.getViewProjection());
+            journal.nextFrame();
+        }
+
+        std::vector<uint8_t> bytes;
+        journal.encode(bytes);
+        InputJournal decoded;
+        if (!CHECK(decoded.decode(bytes))) {
+            return;
+        }
+        InputReplay replay(decoded);
+        HeadlessView replayed;
+        size_t different_frames = 0;
+        while (!replay.isFinished()) {
+            const uint32_t frame = replay.getFrame();
+            replay.advance([&](const InputEvent& event) { replayed.apply(event); });
+            replayed._time += replay.getTimestep();
+            different_frames += !sameBits(replayed.getViewProjection(), frames[frame]);
+        }
+        CHECK(replay.getFrame() == frames.size());
+        CHECK(different_frames == 0);
+        CHECK(sameBits(replayed._camera.getPosition(), live._camera.getPosition()));
+        CHECK(sameBits(replayed._camera.getDirection(), live._camera.getDirection()));
+        XMFLOAT4X4 live_view, replayed_view;
+        XMStoreFloat4x4(&live_view, live._camera.getViewMatrix());
+        XMStoreFloat4x4(&replayed_view, replayed._camera.getViewMatrix());
+        CHECK(sameBits(replayed_view, live_view));
+        CHECK(replayed._width == live._width && replayed._height == live._height && replayed._time == live._time);
+
+        // The walk did reach the borders, so the clipping was replayed too
+        CHECK(border_frames > 0);
+    }
+}
+
+int main() {
+    return test::run({
+        { "round trip", roundTrip },
+        { "rejects truncated journal", rejectsTruncatedJournal },
+        { "rejects event count beyond data", rejectsEventCountBeyondData },
+        { "rejects unknown parameter", rejectsUnknownParameter },
+        { "rejects unknown event type", rejectsUnknownEventType },
+        { "replay reproduces camera", replayReproducesCamera },
+    });
+}
@@ -0,0 +1,224 @@
+#include "../lab-5/Scene/LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+namespace {
+    ClusterGridSettings makeGrid(uint32_t tiles_x, uint32_t tiles_y, uint32_t slices, float fov, float aspect) {
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(fov, aspect, 0.1f, 100.0f);
+        ClusterGridSettings settings;
+        settings._tiles_x = tiles_x;
+        settings._tiles_y = tiles_y;
+        settings._slices = slices;
+        settings._projection_x = XMVectorGetX(projection.r[0]);
+        settings._projection_y = XMVectorGetY(projection.r[1]);
+        return settings;
+    }
+
+    // Lights around and behind the camera, some far past the far plane, large ones covering many froxels
+    std::vector<ClusterLight> makeLights(size_t count, float max_range, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-30.0f, 30.0f);
+        std::uniform_real_distribution<float> depth(-30.0f, 140.0f);
+        std::uniform_real_distribution<float> range(0.05f, max_range);
+        std::vector<ClusterLight> lights(count);
+        for (ClusterLight& light : lights) {
+            light._position = XMFLOAT3(position(random), position(random), depth(random));
+            light._range = range(random);
+        }
+        return lights;
+    }
+
+    XMMATRIX randomView(std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+        const XMVECTOR eye = XMVectorSet(position(random), position(random), position(random), 1.0f);
+        const XMVECTOR target = XMVectorSet(position(random), position(random), 20.0f + position(random), 1.0f);
+        return XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    }
+
+    XMFLOAT3 toView(FXMMATRIX view, const ClusterLight& light) {
+        XMFLOAT3 center;
+        XMStoreFloat3(&center, XMVector3TransformCoord(XMLoadFloat3(&light._position), view));
+        return center;
+    }
+
+    // Whether the sphere lies entirely outside one of the four planes through the eye and the tile edges
+    bool isOutsideTile(const ClusterGridSettings& grid, uint32_t x, uint32_t y, const XMFLOAT3& center, float radius) {
+        const float x0 = 2.0f * x / grid._tiles_x - 1.0f;
+        const float x1 = 2.0f * (x + 1) / grid._tiles_x - 1.0f;
+        const float y0 = 2.0f * y / grid._tiles_y - 1.0f;
+        const float y1 = 2.0f * (y + 1) / grid._tiles_y - 1.0f;
+        const float px = grid._projection_x;
+        const float py = grid._projection_y;
+        return (px * center.x - x0 * center.z) / std::sqrt(px * px + x0 * x0) < -radius
+            || (x1 * center.z - px * center.x) / std::sqrt(px * px + x1 * x1) < -radius
+            || (py * center.y - y0 * center.z) / std::sqrt(py * py + y0 * y0) < -radius
+            || (y1 * center.z - py * center.y) / std::sqrt(py * py + y1 * y1) < -radius;
+    }
+
+    // Every cluster against every light. A list may only hold lights whose sphere overlaps the froxel box, and
+    // has to hold every one of them that is also inside the side planes of the froxel, in light order
+    void compareWithBruteForce(const LightClusters& clusters, FXMMATRIX view, const std::vector<ClusterLight>& lights, size_t& missed,
+        size_t& extra, size_t& misordered) {
+        std::vector<XMFLOAT3> centers(lights.size());
+        for (size_t i = 0; i < lights.size(); ++i) {
+            centers[i] = toView(view, lights[i]);
+        }
+        const ClusterGridSettings& grid = clusters.getSettings();
+        const std::vector<uint32_t>& indices = clusters.getLightIndices();
+        std::vector<uint32_t> allowed, required;
+        for (size_t cluster = 0; cluster < clusters.getClusterCount(); ++cluster) {
+            const uint32_t x = (uint32_t)(cluster % grid._tiles_x);
+            const uint32_t y = (uint32_t)(cluster / grid._tiles_x % grid._tiles_y);
+            allowed.clear();
+            required.clear();
+            for (uint32_t i = 0; i < lights.size(); ++i) {
+                if (overlapsAabb(clusters.getClusterBounds(cluster), centers[i], lights[i]._range)) {
+                    allowed.push_back(i);
+                    if (!isOutsideTile(grid, x, y, centers[i], lights[i]._range)) {
+                        required.push_back(i);
+                    }
+                }
+            }
+            const ClusterRange range = clusters.getRanges()[cluster];
+            const std::vector<uint32_t> found(indices.begin() + range._offset, indices.begin() + range._offset + range._count);
+            for (uint32_t i : required) {
+                missed += std::find(found.begin(), found.end(), i) == found.end();
+            }
+            for (uint32_t i : found) {
+                extra += std::find(allowed.begin(), allowed.end(), i) == allowed.end();
+            }
+            misordered += !std::is_sorted(found.begin(), found.end());
+        }
+    }
+
+    void assignmentMatchesBruteForce() {
+        std::mt19937 random(1);
+        const ClusterGridSettings grids[] = {
+            makeGrid(16, 9, 24, XM_PIDIV2, 16.0f / 9.0f),
+            makeGrid(7, 5, 11, 1.0f, 1.3f),
+        };
+        for (const ClusterGridSettings& grid : grids) {
+            LightClusters clusters;
+            clusters.setGrid(grid);
+            // Past 1024 lights the view transform is split into blocks
+            for (size_t count : { (size_t)0, (size_t)1, (size_t)100, (size_t)1500, (size_t)3000 }) {
+                for (float max_range : { 4.0f, 40.0f }) {
+                    const XMMATRIX view = randomView(random);
+                    const std::vector<ClusterLight> lights = makeLights(count, max_range, random);
+                    clusters.assign(view, lights);
+                    size_t missed = 0, extra = 0, misordered = 0;
+                    compareWithBruteForce(clusters, view, lights, missed, extra, misordered);
+                    if (!CHECK(missed == 0 && extra == 0 && misordered == 0)) {
+                        std::fprintf(stderr, "  %ux%ux%u grid, %zu lights up to %g: %zu missed, %zu extra, %zu out of order\n", grid._tiles_x,
+                            grid._tiles_y, grid._slices, count, max_range, missed, extra, misordered);
+                    }
+                }
+            }
+        }
+    }
+
+    void layoutIsContiguous() {
+        std::mt19937 random(2);
+        LightClusters clusters;
+        clusters.setGrid(makeGrid(16, 9, 24, XM_PIDIV2, 16.0f / 9.0f));
+        const std::vector<ClusterLight> lights = makeLights(2000, 6.0f, random);
+        clusters.assign(randomView(random), lights);
+
+        // Ranges follow each other in cluster order and end with the index list
+        const std::vector<ClusterRange>& ranges = clusters.getRanges();
+        CHECK(ranges.size() == clusters.getClusterCount());
+        size_t offset = 0;
+        size_t max_lights = 0;
+        bool contiguous = true;
+        for (const ClusterRange& range : ranges) {
+            contiguous = contiguous && range._offset == offset;
+            offset += range._count;
+            max_lights = std::max<size_t>(max_lights, range._count);
+        }
+        CHECK(contiguous);
+        CHECK(offset == clusters.getLightIndices().size());
+        CHECK(max_lights == clusters.getMaxClusterLights() && max_lights > 0);
+
+        // Slices grow from the near to the far plane, and the froxel boxes of a slice sit between its depths
+        const ClusterGridSettings& grid = clusters.getSettings();
+        CHECK(clusters.getSliceDepth(0) == grid._near_z && clusters.getSliceDepth(grid._slices) == grid._far_z);
+        bool growing = true;
+        for (uint32_t slice = 0; slice < grid._slices; ++slice) {
+            const float z0 = clusters.getSliceDepth(slice);
+            const float z1 = clusters.getSliceDepth(slice + 1);
+            growing = growing && z1 > z0 && (slice == 0 || z1 - z0 > z0 - clusters.getSliceDepth(slice - 1));
+            const Aabb& box = clusters.getClusterBounds(clusters.getClusterIndex(grid._tiles_x - 1, 0, slice));
+            CHECK(box._min.z == z0 && box._max.z == z1);
+        }
+        CHECK(growing);
+
+        // Moving every light out of view empties every cluster
+        std::vector<ClusterLight> behind = lights;
+        for (ClusterLight& light : behind) {
+            light._position.z = -1000.0f;
+        }
+        clusters.assign(XMMatrixIdentity(), behind);
+        CHECK(clusters.getLightIndices().empty() && clusters.getMaxClusterLights() == 0);
+    }
+
+    // The lookup of the shaders: a point inside a light's sphere finds the light in its cluster
+    void shadedPointsFindTheirLights() {
+        std::mt19937 random(3);
+        const ClusterGridSettings grid = makeGrid(16, 9, 24, XM_PIDIV2, 16.0f / 9.0f);
+        LightClusters clusters;
+        clusters.setGrid(grid);
+        const XMMATRIX view = randomView(random);
+        const std::vector<ClusterLight> lights = makeLights(1000, 6.0f, random);
+        clusters.assign(view, lights);
+        std::vector<XMFLOAT3> centers(lights.size());
+        for (size_t i = 0; i < lights.size(); ++i) {
+            centers[i] = toView(view, lights[i]);
+        }
+
+        std::uniform_real_distribution<float> ndc(-0.999f, 0.999f);
+        std::uniform_real_distribution<float> depth(grid._near_z, grid._far_z);
+        const float log_depth = std::log(grid._far_z / grid._near_z);
+        size_t lit = 0;
+        size_t misses = 0;
+        for (size_t p = 0; p < 20000; ++p) {
+            const float z = depth(random);
+            const XMFLOAT3 point(ndc(random) * z / grid._projection_x, ndc(random) * z / grid._projection_y, z);
+            const int x = (int)std::floor((point.x * grid._projection_x / z * 0.5f + 0.5f) * grid._tiles_x);
+            const int y = (int)std::floor((point.y * grid._projection_y / z * 0.5f + 0.5f) * grid._tiles_y);
+            const int slice = std::min((int)std::floor(std::log(z / grid._near_z) * grid._slices / log_depth), (int)grid._slices - 1);
+            const ClusterRange range = clusters.getRanges()[clusters.getClusterIndex(x, y, slice)];
+            const uint32_t* first = clusters.getLightIndices().data() + range._offset;
+            for (uint32_t i = 0; i < lights.size(); ++i) {
+                const float dx = centers[i].x - point.x;
+                const float dy = centers[i].y - point.y;
+                const float dz = centers[i].z - point.z;
+                // Clear of the sphere surface, where the shader and this test may round differently
+                if (dx * dx + dy * dy + dz * dz < lights[i]._range * lights[i]._range * 0.999f) {
+                    ++lit;
+                    misses += std::find(first, first + range._count, i) == first + range._count;
+                }
+            }
+        }
+        CHECK(lit > 1000);
+        if (!CHECK(misses == 0)) {
+            std::fprintf(stderr, "  %zu of %zu lit points miss their light\n", misses, lit);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "assignment matches brute force", assignmentMatchesBruteForce },
+        { "layout is contiguous", layoutIsContiguous },
+        { "shaded points find their lights", shadedPointsFindTheirLights },
+    });
+}
@@ -0,0 +1,203 @@
+#include "../lab-5/Geometry/LodChain.h"
+#include "../lab-5/Geometry/MeshCache.h"
+#include "../lab-5/ParametricSurface.h"
+#include "../lab-5/SphereTessellation.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    const float VIEWPORT_HEIGHT = 1080.0f;
+
+    XMMATRIX projection() {
+        return XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f);
+    }
+
+    std::vector<unsigned> levelIndices(const LodChain& chain, size_t level) {
+        const LodLevel& lod = chain.getLevel(level);
+        return std::vector<unsigned>(chain.getIndices().begin() + lod._first_index, chain.getIndices().begin() + lod._first_index + lod._index_count);
+    }
+
+    // Levels tile the index buffer finest first, every index is valid and the errors only grow
+    bool checkLayout(const LodChain& chain) {
+        bool ok = CHECK(chain.getLevelCount() > 1);
+        uint32_t next_index = 0;
+        for (size_t level = 0; level < chain.getLevelCount(); ++level) {
+            const LodLevel& lod = chain.getLevel(level);
+            ok &= CHECK(lod._first_index == next_index);
+            ok &= CHECK(lod._index_count > 0 && lod._index_count % 3 == 0);
+            next_index += lod._index_count;
+            if (level > 0) {
+                ok &= CHECK(lod._index_count < chain.getLevel(level - 1)._index_count);
+                ok &= CHECK(lod._error >= chain.getLevel(level - 1)._error);
+            }
+        }
+        ok &= CHECK(next_index == chain.getIndices().size());
+        for (unsigned index : chain.getIndices()) {
+            ok &= CHECK(index < chain.getVertices().size());
+        }
+        return ok;
+    }
+
+    void sphereChainLevels() {
+        const float radius = 1.5f;
+        const LodChain chain = makeSphereLodChain(radius, 60, 60, 5, true, true);
+        CHECK(chain.getLevelCount() == 5);
+        checkLayout(chain);
+        CHECK_NEAR(chain.getBoundingRadius(), radius, 1e-5f);
+        for (size_t level = 0; level < chain.getLevelCount(); ++level) {
+            CHECK(chain.getLevel(level)._error == sphereChordError(chain.getVertices(), levelIndices(chain, level), radius));
+        }
+        for (size_t level = 1; level < chain.getLevelCount(); ++level) {
+            CHECK(chain.getLevel(level)._error > chain.getLevel(level - 1)._error);
+        }
+
+        // Asking for more levels than halving allows stops at the smallest closed sphere
+        const LodChain short_chain = makeSphereLodChain(radius, 12, 12, 10, true, true);
+        CHECK(short_chain.getLevelCount() == 3);
+    }
+
+    void simplifiedChainLevels() {
+        const size_t n_major = 64;
+        const size_t n_minor = 32;
+        std::vector<SimpleVertex> vertices(torusVertexCount(n_major, n_minor));
+        std::vector<unsigned> indices(torusIndexCount(n_major, n_minor));
+        generateTorus(1.0f, 0.3f, n_major, n_minor, vertices.data(), indices.data());
+
+        const LodChain chain = makeSimplifiedLodChain(vertices, indices, 5);
+        checkLayout(chain);
+        CHECK(chain.getLevel(0)._error == 0.0f);
+        CHECK(chain.getLevel(0)._index_count == indices.size());
+        for (size_t level = 1; level < chain.getLevelCount(); ++level) {
+            // About half of the triangles each time
+            const float ratio = (float)chain.getLevel(level)._index_count / chain.getLevel(level - 1)._index_count;
+            CHECK(ratio > 0.4f && ratio < 0.6f);
+            // The last level starts to close the 0.3 thick tube
+            CHECK(chain.getLevel(level)._error > 0.0f && chain.getLevel(level)._error < 0.5f);
+        }
+    }
+
+    void projectedErrorScales() {
+        // With a 90 degree field of view an error of 1 at distance 1 covers half the viewport height
+        CHECK_NEAR(projectedError(1.0f, 1.0f, projection(), VIEWPORT_HEIGHT), VIEWPORT_HEIGHT * 0.5f, 1e-2f);
+        CHECK_NEAR(projectedError(0.5f, 4.0f, projection(), VIEWPORT_HEIGHT), VIEWPORT_HEIGHT / 16.0f, 1e-2f);
+
+        // Closest point of the bounding sphere, clamped to the near plane from inside
+        CHECK_NEAR(lodDistance(XMVectorSet(0.0f, 3.0f, 4.0f, 1.0f), XMVectorZero(), 2.0f, 0.01f), 3.0f, 1e-6f);
+        CHECK(lodDistance(XMVectorSet(0.5f, 0.0f, 0.0f, 1.0f), XMVectorZero(), 2.0f, 0.01f) == 0.01f);
+    }
+
+    // The camera moves out along a line and back in. The level only depends on the distance: it never gets
+    // finer moving away, the way back retraces the same levels, and every pick is the coarsest within threshold
+    void cameraSweepIsMonotonic() {
+        const LodChain chain = makeSphereLodChain(1.0f, 60, 60, 5, true, true);
+        const XMVECTOR center = XMVectorSet(2.0f, -1.0f, 5.0f, 1.0f);
+        const XMVECTOR direction = XMVector3Normalize(XMVectorSet(0.3f, 0.2f, -1.0f, 0.0f));
+        std::vector<float> offsets;
+        for (float offset = 0.5f; offset < 4000.0f; offset *= 1.02f) {
+            offsets.push_back(offset);
+        }
+
+        for (float threshold : { 0.5f, 1.0f, 4.0f }) {
+            for (float scale : { 1.0f, 3.0f }) {
+                auto select = [&](float offset) {
+                    const float distance = lodDistance(center + direction * offset, center, chain.getBoundingRadius() * scale, 0.01f);
+                    const size_t level = selectLodLevel(chain, distance, scale, projection(), VIEWPORT_HEIGHT, threshold);
+                    const float error = projectedError(chain.getLevel(level)._error * scale, distance, projection(), VIEWPORT_HEIGHT);
+                    CHECK(level == 0 || error <= threshold);
+                    if (level + 1 < chain.getLevelCount()) {
+                        CHECK(projectedError(chain.getLevel(level + 1)._error * scale, distance, projection(), VIEWPORT_HEIGHT) > threshold);
+                    }
+                    return level;
+                };
+
+                std::vector<size_t> outwards;
+                for (float offset : offsets) {
+                    outwards.push_back(select(offset));
+                }
+                size_t switches = 0;
+                for (size_t i = 1; i < outwards.size(); ++i) {
+                    CHECK(outwards[i] >= outwards[i - 1]);
+                    switches += outwards[i] != outwards[i - 1];
+                }
+                // Up close the finest level, far away the coarsest, one switch per level in between
+                CHECK(outwards.front() == 0);
+                CHECK(outwards.back() == chain.getLevelCount() - 1);
+                CHECK(switches <= chain.getLevelCount() - 1);
+
+                for (size_t i = offsets.size(); i > 0; --i) {
+                    CHECK(select(offsets[i - 1]) == outwards[i - 1]);
+                }
+            }
+        }
+    }
+
+    void fromDataRoundTrip() {
+        const LodChain chain = makeSphereLodChain(1.0f, 20, 20, 3, false, true);
+        std::vector<LodLevel> levels;
+        for (size_t level = 0; level < chain.getLevelCount(); ++level) {
+            levels.push_back(chain.getLevel(level));
+        }
+        const LodChain copy = LodChain::fromData(levels.data(), levels.size(), chain.getVertices().data(), chain.getVertices().size(),
+            chain.getIndices().data(), chain.getIndices().size(), chain.getBoundingRadius());
+        CHECK(copy.getLevelCount() == chain.getLevelCount());
+        CHECK(copy.getIndices() == chain.getIndices());
+        CHECK(copy.getVertices().size() == chain.getVertices().size());
+        CHECK(copy.getBoundingRadius() == chain.getBoundingRadius());
+        for (size_t level = 0; level < chain.getLevelCount(); ++level) {
+            CHECK(copy.getLevel(level)._first_index == chain.getLevel(level)._first_index);
+            CHECK(copy.getLevel(level)._error == chain.getLevel(level)._error);
+        }
+    }
+
+    // The renderer draws and selects levels straight from the mapped file
+    void mappedCacheView() {
+        const LodChain chain = makeSphereLodChain(1.0f, 40, 40, 4, true, true);
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "lab5-lod-chain-test.meshcache";
+        const uint64_t source_hash = hashMeshSource("sphere 40", 9);
+        if (!CHECK(writeMeshCache(path, chain, source_hash))) {
+            return;
+        }
+        {
+            MeshCacheFile cache;
+            CHECK(cache.open(path, source_hash + 1) == MeshCacheStatus::STALE);
+            if (CHECK(cache.open(path, source_hash, true) == MeshCacheStatus::OK)) {
+                const LodChainView view = cache.getView();
+                const LodChainView expected = chain.getView();
+                CHECK(view._level_count == expected._level_count);
+                CHECK(view._vertex_count == expected._vertex_count);
+                CHECK(view._index_count == expected._index_count);
+                CHECK(view._bounding_radius == expected._bounding_radius);
+                CHECK(std::memcmp(view._levels, expected._levels, view._level_count * sizeof(LodLevel)) == 0);
+                CHECK(std::memcmp(view._vertices, expected._vertices, view._vertex_count * sizeof(SimpleVertex)) == 0);
+                CHECK(std::memcmp(view._indices, expected._indices, view._index_count * sizeof(unsigned)) == 0);
+                // The blobs are used in place, so they have to be aligned for SIMD loads
+                CHECK((uintptr_t)view._vertices % 16 == 0 && (uintptr_t)view._indices % 16 == 0);
+                for (float distance = 0.5f; distance < 200.0f; distance *= 1.5f) {
+                    CHECK(selectLodLevel(view, distance, 1.0f, projection(), VIEWPORT_HEIGHT, 1.0f) == selectLodLevel(chain, distance, 1.0f, projection(), VIEWPORT_HEIGHT, 1.0f));
+                }
+            }
+        }
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+}
+
+int main() {
+    return test::run({
+        { "sphere chain levels", sphereChainLevels },
+        { "simplified chain levels", simplifiedChainLevels },
+        { "projected error scales", projectedErrorScales },
+        { "camera sweep is monotonic", cameraSweepIsMonotonic },
+        { "from data round trip", fromDataRoundTrip },
+        { "mapped cache view", mappedCacheView },
+    });
+}
@@ -0,0 +1,227 @@
+#include "../lab-5/MaterialGrid.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    MaterialGridSettings settings(uint32_t columns, uint32_t rows) {
+        MaterialGridSettings result;
+        result._columns = columns;
+        result._rows = rows;
+        return result;
+    }
+
+    // What pack has to write for one sphere, one instance at a time
+    MaterialInstance referenceInstance(const MaterialGrid& grid, size_t i) {
+        const MaterialGridSettings& s = grid.getSettings();
+        const scene::BoundingSpheres& bounds = grid.getBounds();
+        MaterialInstance instance;
+        instance._world[0] = XMFLOAT4(s._radius, 0.0f, 0.0f, bounds._x[i]);
+        instance._world[1] = XMFLOAT4(0.0f, s._radius, 0.0f, bounds._y[i]);
+        instance._world[2] = XMFLOAT4(0.0f, 0.0f, s._radius, bounds._z[i]);
+        instance._base_color = s._base_color;
+        instance._roughness = grid.getRoughness(i);
+        instance._metalness = grid.getMetalness(i);
+        instance._padding[0] = 0.0f;
+        instance._padding[1] = 0.0f;
+        return instance;
+    }
+
+    void layoutAndRamps() {
+        MaterialGrid grid;
+        CHECK(grid.getInstanceCount() == 0);
+        MaterialGridSettings s = settings(5, 3);
+        s._spacing = 2.0f;
+        CHECK(grid.update(s));
+        CHECK(grid.getInstanceCount() == 15 && grid.getBounds().size() == 15);
+        // Row major, centered on the origin in the xy plane
+        const scene::BoundingSpheres& bounds = grid.getBounds();
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t column = 0; column < 5; ++column) {
+                const size_t i = row * 5 + column;
+                CHECK(bounds._x[i] == -4.0f + 2.0f * column && bounds._y[i] == -2.0f + 2.0f * row && bounds._z[i] == 0.0f);
+                CHECK(bounds._radius[i] == 1.0f);
+                CHECK_NEAR(grid.getRoughness(i), column / 4.0f, 1e-6f);
+                CHECK_NEAR(grid.getMetalness(i), row / 2.0f, 1e-6f);
+            }
+        }
+        // Both ramps reach 1 exactly, a single column or row stays at 0
+        CHECK(grid.getRoughness(4) == 1.0f && grid.getMetalness(14) == 1.0f);
+        CHECK(grid.update(settings(1, 1)));
+        CHECK(grid.getInstanceCount() == 1 && grid.getRoughness(0) == 0.0f && grid.getMetalness(0) == 0.0f);
+        CHECK(grid.getBounds()._x[0] == 0.0f && grid.getBounds()._y[0] == 0.0f);
+    }
+
+    void updateReportsChanges() {
+        MaterialGrid grid;
+        MaterialGridSettings s = settings(4, 4);
+        CHECK(grid.update(s));
+        CHECK(!grid.update(s));
+
+        // A new radius or color changes the instances, but not where the spheres are
+        const std::vector<float> x = grid.getBounds()._x;
+        s._radius = 0.5f;
+        CHECK(grid.update(s));
+        CHECK(grid.getBounds()._x == x);
+        for (float radius : grid.getBounds()._radius) {
+            CHECK(radius == 0.5f);
+        }
+        s._base_color = XMFLOAT4(0.5f, 0.25f, 0.125f, 1.0f);
+        CHECK(grid.update(s));
+        CHECK(!grid.update(s));
+        std::vector<MaterialInstance> packed(grid.getInstanceCount());
+        grid.pack(packed.data());
+        CHECK(packed[0]._base_color.x == 0.5f && packed[0]._base_color.z == 0.125f && packed[0]._world[0].x == 0.5f);
+
+        // A larger grid keeps the radius for the new spheres too
+        s._columns = 6;
+        CHECK(grid.update(s));
+        CHECK(grid.getInstanceCount() == 24);
+        for (float radius : grid.getBounds()._radius) {
+            CHECK(radius == 0.5f);
+        }
+        s._spacing = 3.0f;
+        CHECK(grid.update(s));
+        CHECK(grid.getBounds()._x[1] - grid.getBounds()._x[0] == 3.0f);
+    }
+
+    void instanceLayoutMatchesShader() {
+        // MaterialInstance in shaders.hlsl: three float4 rows, float4 color, float2 material, float2 padding
+        CHECK(sizeof(MaterialInstance) == 80);
+        CHECK(offsetof(MaterialInstance, _world) == 0);
+        CHECK(offsetof(MaterialInstance, _base_color) == 48);
+        CHECK(offsetof(MaterialInstance, _roughness) == 64);
+        CHECK(offsetof(MaterialInstance, _metalness) == 68);
+        CHECK(offsetof(MaterialInstance, _padding) == 72);
+    }
+
+    void packMatchesSerialReference() {
+        // 300 x 300 spans several pack blocks and ends in a partial one
+        for (uint32_t side : { 1u, 7u, 300u }) {
+            MaterialGrid grid;
+            MaterialGridSettings s = settings(side, side + 1);
+            s._radius = 0.75f;
+            s._base_color = XMFLOAT4(0.9f, 0.6f, 0.3f, 1.0f);
+            grid.update(s);
+            const size_t count = grid.getInstanceCount();
+            // One guard instance past the end must stay untouched
+            std::vector<MaterialInstance> packed(count + 1);
+            memset(packed.data(), 0x5a, sizeof(MaterialInstance) * packed.size());
+            const MaterialInstance guard = packed.back();
+            grid.pack(packed.data());
+            size_t mismatches = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const MaterialInstance expected = referenceInstance(grid, i);
+                mismatches += memcmp(&packed[i], &expected, sizeof(MaterialInstance)) != 0;
+            }
+            if (!CHECK(mismatches == 0 && memcmp(&packed.back(), &guard, sizeof(MaterialInstance)) == 0)) {
+                std::fprintf(stderr, "  %u x %u: %zu instances differ\n", side, side + 1, mismatches);
+            }
+        }
+    }
+
+    void lodGroupsMatchPerInstanceSelection() {
+        const geometry::LodChain chain = geometry::makeSphereLodChain(1.0f, 128, 256, 5, true, true);
+        const geometry::LodChainView view = chain.getView();
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+        const float near_z = 0.1f;
+        const float height = 1080.0f;
+
+        MaterialGrid grid;
+        MaterialGridSettings s = settings(120, 80);
+        s._radius = 0.8f;
+        grid.update(s);
+        const scene::BoundingSpheres& bounds = grid.getBounds();
+
+        // Every other sphere, like a culled list, so positions in the list and instance ids differ. The camera
+        // looks at sphere 4860 in the middle of the grid
+        std::vector<uint32_t> instances;
+        for (uint32_t i = 0; i < grid.getInstanceCount(); i += 2) {
+            instances.push_back(i);
+        }
+
+        LodInstanceGroups groups;
+        size_t levels_seen = 0;
+        for (float z : { -1.2f, -6.0f, -40.0f, -400.0f }) {
+            for (float threshold : { 0.5f, 1.0f, 4.0f }) {
+                const XMVECTOR camera = XMVectorSet(1.25f, 1.25f, z, 1.0f);
+                groupInstancesByLod(bounds, instances, view, camera, projection, near_z, height, threshold, groups);
+                if (!CHECK(groups._offsets.size() == view._level_count + 1 && groups._instances.size() == instances.size())) {
+                    continue;
+                }
+                CHECK(groups._offsets.front() == 0 && groups._offsets.back() == instances.size());
+
+                // Each group is in list order and holds the instances whose own selection gives its level.
+                // Levels only differ where an instance sits on a band border within float rounding
+                size_t mismatches = 0;
+                size_t position = 0;
+                for (size_t level = 0; level < view._level_count; ++level) {
+                    CHECK(groups._offsets[level] <= groups._offsets[level + 1]);
+                    levels_seen |= (size_t)(groups._offsets[level + 1] > groups._offsets[level]) << level;
+                    for (uint32_t k = groups._offsets[level]; k < groups._offsets[level + 1]; ++k) {
+                        const uint32_t instance = groups._instances[k];
+                        while (position < instances.size() && instances[position] != instance) {
+                            ++position;
+                        }
+                        CHECK(position < instances.size());
+                        const XMVECTOR center = XMVectorSet(bounds._x[instance], bounds._y[instance], bounds._z[instance], 1.0f);
+                        const float distance = geometry::lodDistance(camera, center, bounds._radius[instance] * view._bounding_radius, near_z);
+                        const size_t expected = geometry::selectLodLevel(view, distance, bounds._radius[instance], projection, height, threshold);
+                        if (expected != level) {
+                            const size_t closer = geometry::selectLodLevel(view, distance * 0.9999f, bounds._radius[instance], projection, height, threshold);
+                            const size_t farther = geometry::selectLodLevel(view, distance * 1.0001f, bounds._radius[instance], projection, height, threshold);
+                            mismatches += level != closer && level != farther;
+                        }
+                    }
+                    position = 0;
+                }
+                if (!CHECK(mismatches == 0)) {
+                    std::fprintf(stderr, "  camera z %g, threshold %g: %zu instances in the wrong level\n", z, threshold, mismatches);
+                }
+
+                // Every listed instance shows up once
+                std::vector<uint32_t> seen(grid.getInstanceCount(), 0);
+                for (uint32_t instance : groups._instances) {
+                    ++seen[instance];
+                }
+                size_t wrong = 0;
+                for (uint32_t i = 0; i < grid.getInstanceCount(); ++i) {
+                    wrong += seen[i] != (i % 2 == 0 ? 1u : 0u);
+                }
+                CHECK(wrong == 0);
+            }
+        }
+        // The sweep has to reach the finest and the coarsest level
+        CHECK((levels_seen & 1) && (levels_seen >> (view._level_count - 1) & 1));
+
+        // Up close in a wide grid the levels are mixed within one call
+        groupInstancesByLod(bounds, instances, view, XMVectorSet(0.0f, 0.0f, -3.0f, 1.0f), projection, near_z, height, 1.0f, groups);
+        size_t used = 0;
+        for (size_t level = 0; level < view._level_count; ++level) {
+            used += groups._offsets[level + 1] > groups._offsets[level];
+        }
+        CHECK(used >= 3);
+
+        // An empty list gives empty groups
+        groupInstancesByLod(bounds, {}, view, XMVectorSet(0.0f, 0.0f, -3.0f, 1.0f), projection, near_z, height, 1.0f, groups);
+        CHECK(groups._instances.empty() && groups._offsets == std::vector<uint32_t>(view._level_count + 1, 0));
+    }
+}
+
+int main() {
+    return test::run({
+        { "layout and ramps", layoutAndRamps },
+        { "update reports changes", updateReportsChanges },
+        { "instance layout matches shader", instanceLayoutMatchesShader },
+        { "pack matches serial reference", packMatchesSerialReference },
+        { "LOD groups match per instance selection", lodGroupsMatchPerInstanceSelection },
+    });
+}
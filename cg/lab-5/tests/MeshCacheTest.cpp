@@ -0,0 +1,149 @@
+#include "../lab-5/Geometry/MeshCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    const uint64_t SOURCE_HASH = 0x5eed;
+
+    std::filesystem::path cachePath() {
+        return std::filesystem::temp_directory_path() / "lab5-mesh-cache-test.meshcache";
+    }
+
+    // The bytes of a valid cache of a small sphere chain
+    std::vector<uint8_t> validCache() {
+        const LodChain chain = makeSphereLodChain(1.0f, 12, 16, 3, true, true);
+        std::vector<uint8_t> bytes;
+        if (writeMeshCache(cachePath(), chain, SOURCE_HASH)) {
+            std::ifstream file(cachePath(), std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        return bytes;
+    }
+
+    MeshCacheHeader header(const std::vector<uint8_t>& bytes) {
+        MeshCacheHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        return header;
+    }
+
+    template <typename T>
+    std::vector<uint8_t> patched(std::vector<uint8_t> bytes, size_t offset, T value) {
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+        return bytes;
+    }
+
+    MeshCacheStatus openBytes(const std::vector<uint8_t>& bytes, bool validate_indices = false) {
+        {
+            std::ofstream file(cachePath(), std::ios::binary | std::ios::trunc);
+            file.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+        }
+        MeshCacheFile cache;
+        return cache.open(cachePath(), SOURCE_HASH, validate_indices);
+    }
+
+    bool expectStatus(const std::vector<uint8_t>& bytes, MeshCacheStatus expected, const char* what, bool validate_indices = false) {
+        const MeshCacheStatus status = openBytes(bytes, validate_indices);
+        if (!CHECK(status == expected)) {
+            std::fprintf(stderr, "  %s: %s instead of %s\n", what, getMeshCacheStatusName(status), getMeshCacheStatusName(expected));
+            return false;
+        }
+        return true;
+    }
+
+    void removeCache() {
+        std::error_code error;
+        std::filesystem::remove(cachePath(), error);
+    }
+
+    void opensValidCache() {
+        const std::vector<uint8_t> bytes = validCache();
+        if (CHECK(bytes.size() == header(bytes)._file_size)) {
+            expectStatus(bytes, MeshCacheStatus::OK, "written cache", true);
+            MeshCacheFile cache;
+            CHECK(cache.open(cachePath(), SOURCE_HASH + 1) == MeshCacheStatus::STALE);
+        }
+        removeCache();
+        MeshCacheFile cache;
+        CHECK(cache.open(cachePath(), SOURCE_HASH) == MeshCacheStatus::MISSING);
+    }
+
+    void truncated() {
+        const std::vector<uint8_t> bytes = validCache();
+        // Empty files cannot be mapped, shorter than the header, the header alone and one byte short of the end
+        for (size_t size : { (size_t)0, (size_t)7, sizeof(MeshCacheHeader) - 1, sizeof(MeshCacheHeader), bytes.size() - 1 }) {
+            expectStatus(std::vector<uint8_t>(bytes.begin(), bytes.begin() + size), MeshCacheStatus::TRUNCATED, "cut file");
+        }
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _file_size), (uint64_t)bytes.size() + 1), MeshCacheStatus::TRUNCATED, "file size too large");
+        removeCache();
+    }
+
+    void headerFields() {
+        const std::vector<uint8_t> bytes = validCache();
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _magic), (uint32_t)0x12345678), MeshCacheStatus::BAD_MAGIC, "magic");
+        // Magic and byte order as a machine of the other endianness writes them
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _magic), (uint32_t)0x4d534843), MeshCacheStatus::FOREIGN_BYTE_ORDER, "swapped magic");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _byte_order), (uint32_t)0x04030201), MeshCacheStatus::FOREIGN_BYTE_ORDER, "swapped byte order");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _byte_order), (uint32_t)0x01020305), MeshCacheStatus::CORRUPT, "byte order");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _version), (uint32_t)2), MeshCacheStatus::BAD_VERSION, "version");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _vertex_format), (uint32_t)1), MeshCacheStatus::BAD_VERTEX_FORMAT, "vertex format");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _vertex_stride), (uint32_t)32), MeshCacheStatus::BAD_VERTEX_FORMAT, "vertex stride");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _index_size), (uint32_t)2), MeshCacheStatus::BAD_VERTEX_FORMAT, "index size");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _source_hash), SOURCE_HASH + 1), MeshCacheStatus::STALE, "source hash");
+        removeCache();
+    }
+
+    void corruptBlobs() {
+        std::vector<uint8_t> bytes = validCache();
+        const MeshCacheHeader valid = header(bytes);
+        std::vector<uint8_t> longer = bytes;
+        longer.push_back(0);
+        expectStatus(longer, MeshCacheStatus::CORRUPT, "trailing bytes");
+
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _levels_offset), (uint64_t)sizeof(MeshCacheHeader) - 4), MeshCacheStatus::CORRUPT, "levels inside header");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _levels_offset), valid._levels_offset + 1), MeshCacheStatus::CORRUPT, "levels misaligned");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _vertices_offset), valid._vertices_offset + 4), MeshCacheStatus::CORRUPT, "vertices misaligned");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _indices_offset), valid._indices_offset + 8), MeshCacheStatus::CORRUPT, "indices misaligned");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _indices_offset), (valid._file_size + 16) & ~(uint64_t)15), MeshCacheStatus::CORRUPT, "indices past the end");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _level_count), (uint32_t)(valid._file_size / sizeof(LodLevel))), MeshCacheStatus::CORRUPT, "level count");
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _vertex_count), valid._vertex_count + 1000), MeshCacheStatus::CORRUPT, "vertex count");
+        // Large enough that count * size wraps around to a small number
+        expectStatus(patched(bytes, offsetof(MeshCacheHeader, _index_count), (uint64_t)1 << 62), MeshCacheStatus::CORRUPT, "wrapping index count");
+        // Only the finest level kept, so every level still lies within the shorter index blob
+        LodLevel finest;
+        std::memcpy(&finest, bytes.data() + valid._levels_offset, sizeof(finest));
+        const std::vector<uint8_t> one_level = patched(bytes, offsetof(MeshCacheHeader, _level_count), (uint32_t)1);
+        expectStatus(patched(one_level, offsetof(MeshCacheHeader, _index_count), (uint64_t)finest._index_count), MeshCacheStatus::OK, "finest level only");
+        expectStatus(patched(one_level, offsetof(MeshCacheHeader, _index_count), (uint64_t)finest._index_count + 1), MeshCacheStatus::CORRUPT, "index count not whole triangles");
+
+        // Level ranges: the first level covers the finest mesh from index zero
+        const size_t level = valid._levels_offset;
+        expectStatus(patched(bytes, level + offsetof(LodLevel, _first_index), (uint32_t)valid._index_count + 3), MeshCacheStatus::CORRUPT, "level starts past the indices");
+        expectStatus(patched(bytes, level + offsetof(LodLevel, _index_count), (uint32_t)valid._index_count + 3), MeshCacheStatus::CORRUPT, "level ends past the indices");
+        expectStatus(patched(bytes, level + offsetof(LodLevel, _index_count), (uint32_t)2), MeshCacheStatus::CORRUPT, "level not whole triangles");
+
+        // Indices are only read when asked to
+        std::vector<uint8_t> bad_index = patched(bytes, valid._indices_offset + 4 * (valid._index_count - 1), (uint32_t)valid._vertex_count);
+        expectStatus(bad_index, MeshCacheStatus::OK, "index out of range, unchecked");
+        expectStatus(bad_index, MeshCacheStatus::CORRUPT, "index out of range", true);
+        removeCache();
+    }
+}
+
+int main() {
+    return test::run({
+        { "opens valid cache", opensValidCache },
+        { "truncated", truncated },
+        { "header fields", headerFields },
+        { "corrupt blobs", corruptBlobs },
+    });
+}
@@ -0,0 +1,174 @@
+#include "../lab-5/Geometry/MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestMeshes.h"
+
+using namespace rendering;
+using namespace rendering::geometry;
+using test::Mesh;
+
+namespace {
+    // Triangles in random order, the worst case for the cache
+    Mesh shuffleTriangles(Mesh mesh, unsigned seed) {
+        std::vector<std::array<unsigned, 3>> triangles(mesh._indices.size() / 3);
+        std::memcpy(triangles.data(), mesh._indices.data(), mesh._indices.size() * sizeof(unsigned));
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+        std::memcpy(mesh._indices.data(), triangles.data(), mesh._indices.size() * sizeof(unsigned));
+        mesh._name = "shuffled " + mesh._name;
+        return mesh;
+    }
+
+    std::vector<Mesh> meshes() {
+        // Inward facing like the sky sphere, the passes must keep its winding too
+        return { test::makeUvSphere(40, 78), test::makeUvSphere(20, 38, false), test::makeIcosphere(4), test::makeTorus(64, 24),
+            shuffleTriangles(test::makeTorus(64, 24), 5) };
+    }
+
+    using Corner = std::array<float, 6>;
+    using Triangle = std::array<Corner, 3>;
+
+    // Triangles by vertex contents, each rotated to start at its smallest corner. Rotation keeps the
+    // winding, so a flipped triangle does not match, and index renumbering does not matter
+    std::vector<Triangle> triangleSet(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices) {
+        std::vector<Triangle> triangles;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            Triangle triangle;
+            for (size_t k = 0; k < 3; ++k) {
+                const SimpleVertex& v = vertices[indices[3 * t + k]];
+                triangle[k] = { v._pos.x, v._pos.y, v._pos.z, v._nor.x, v._nor.y, v._nor.z };
+            }
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    void cacheOptimizationKeepsTriangles() {
+        for (const Mesh& mesh : meshes()) {
+            std::vector<unsigned> indices = mesh._indices;
+            optimizeVertexCache(indices, mesh._vertices.size());
+            if (!CHECK(triangleSet(mesh._vertices, indices) == triangleSet(mesh._vertices, mesh._indices))) {
+                std::fprintf(stderr, "  %s\n", mesh._name.c_str());
+            }
+
+            const VertexCacheStats before = analyzeVertexCache(mesh._indices, mesh._vertices.size());
+            const VertexCacheStats after = analyzeVertexCache(indices, mesh._vertices.size());
+            // Close to the 0.5 limit of a regular grid whatever the input order was
+            if (!CHECK(after._acmr < 0.75f && after._acmr < before._acmr)) {
+                std::fprintf(stderr, "  %s: ACMR %.3f -> %.3f\n", mesh._name.c_str(), before._acmr, after._acmr);
+            }
+        }
+    }
+
+    void overdrawOrderKeepsTrianglesAndCache() {
+        for (const Mesh& mesh : meshes()) {
+            std::vector<unsigned> indices = mesh._indices;
+            optimizeVertexCache(indices, mesh._vertices.size());
+            const float cache_acmr = analyzeVertexCache(indices, mesh._vertices.size())._acmr;
+            const float threshold = 1.05f;
+            optimizeOverdraw(indices, mesh._vertices, threshold);
+            CHECK(triangleSet(mesh._vertices, indices) == triangleSet(mesh._vertices, mesh._indices));
+
+            // Clusters only split where their own ACMR stays within the threshold
+            const float acmr = analyzeVertexCache(indices, mesh._vertices.size())._acmr;
+            if (!CHECK(acmr <= threshold * cache_acmr)) {
+                std::fprintf(stderr, "  %s: ACMR %.3f -> %.3f\n", mesh._name.c_str(), cache_acmr, acmr);
+            }
+        }
+    }
+
+    void vertexFetchKeepsTriangles() {
+        for (const Mesh& mesh : meshes()) {
+            // Vertices in random order, with unused ones in front and at the end that have to be dropped
+            std::vector<unsigned> permutation(mesh._vertices.size());
+            std::iota(permutation.begin(), permutation.end(), 1u);
+            std::shuffle(permutation.begin(), permutation.end(), std::mt19937(3));
+            std::vector<SimpleVertex> vertices(mesh._vertices.size() + 2, SimpleVertex{ { 9.0f, 9.0f, 9.0f }, { 0.0f, 1.0f, 0.0f } });
+            for (size_t v = 0; v < mesh._vertices.size(); ++v) {
+                vertices[permutation[v]] = mesh._vertices[v];
+            }
+            std::vector<unsigned> indices = mesh._indices;
+            optimizeVertexCache(indices, mesh._vertices.size());
+            for (unsigned& v : indices) {
+                v = permutation[v];
+            }
+            const float overfetch = analyzeVertexFetch(indices, vertices.size(), sizeof(SimpleVertex))._overfetch;
+            const std::vector<Triangle> expected = triangleSet(vertices, indices);
+            std::reverse(indices.begin(), indices.end());
+            const std::vector<Triangle> reversed = triangleSet(vertices, indices);
+            std::reverse(indices.begin(), indices.end());
+
+            optimizeVertexFetch(vertices, indices);
+            CHECK(triangleSet(vertices, indices) == expected);
+            CHECK(triangleSet(vertices, indices) != reversed);
+
+            // Every vertex is used, in order of first use
+            std::vector<bool> used(vertices.size(), false);
+            unsigned next = 0;
+            bool in_order = true;
+            for (unsigned v : indices) {
+                if (!used[v]) {
+                    in_order &= v == next++;
+                    used[v] = true;
+                }
+            }
+            CHECK(in_order);
+            CHECK(next == vertices.size());
+            // First use order brings vertices used together next to each other
+            const float optimized_overfetch = analyzeVertexFetch(indices, vertices.size(), sizeof(SimpleVertex))._overfetch;
+            if (!CHECK(optimized_overfetch < 0.5f * overfetch)) {
+                std::fprintf(stderr, "  %s: overfetch %.3f -> %.3f\n", mesh._name.c_str(), overfetch, optimized_overfetch);
+            }
+        }
+    }
+
+    void optimizeMeshReportsAndKeepsTriangles() {
+        for (Mesh mesh : meshes()) {
+            const std::vector<Triangle> expected = triangleSet(mesh._vertices, mesh._indices);
+            const MeshOptimizationReport report = optimizeMesh(mesh._vertices, mesh._indices);
+            CHECK(triangleSet(mesh._vertices, mesh._indices) == expected);
+
+            const VertexCacheStats cache = analyzeVertexCache(mesh._indices, mesh._vertices.size());
+            const VertexFetchStats fetch = analyzeVertexFetch(mesh._indices, mesh._vertices.size(), sizeof(SimpleVertex));
+            CHECK(report._cache_after._acmr == cache._acmr);
+            CHECK(report._fetch_after._bytes_fetched == fetch._bytes_fetched);
+            CHECK(report._cache_after._acmr <= report._cache_before._acmr);
+        }
+    }
+
+    void degenerateInputs() {
+        std::vector<SimpleVertex> vertices(3);
+        std::vector<unsigned> indices;
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        CHECK(indices.empty());
+        CHECK(analyzeVertexCache(indices, vertices.size())._acmr == 0.0f);
+
+        indices = { 2, 0, 1 };
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        CHECK((indices == std::vector<unsigned>{ 2, 0, 1 }));
+        optimizeVertexFetch(vertices, indices);
+        CHECK((indices == std::vector<unsigned>{ 0, 1, 2 }));
+        CHECK(vertices.size() == 3);
+    }
+}
+
+int main() {
+    return test::run({
+        { "cache optimization keeps triangles", cacheOptimizationKeepsTriangles },
+        { "overdraw order keeps triangles and cache", overdrawOrderKeepsTrianglesAndCache },
+        { "vertex fetch keeps triangles", vertexFetchKeepsTriangles },
+        { "optimize mesh reports and keeps triangles", optimizeMeshReportsAndKeepsTriangles },
+        { "degenerate inputs", degenerateInputs },
+    });
+}
@@ -0,0 +1,268 @@
+#include "../lab-5/Geometry/MeshSimplifier.h"
+#include "../lab-5/SphereTessellation.h"
+
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestMeshes.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+using test::Mesh;
+
+namespace {
+    const float MAJOR_RADIUS = 1.0f;
+    const float MINOR_RADIUS = 0.3f;
+
+    // The upper half of an icosphere, open along a ragged border
+    Mesh makeCap(size_t subdivisions) {
+        Mesh mesh = test::makeIcosphere(subdivisions);
+        std::vector<unsigned> indices;
+        for (size_t t = 0; t < mesh._indices.size() / 3; ++t) {
+            float y = 0.0f;
+            for (size_t k = 0; k < 3; ++k) {
+                y += mesh._vertices[mesh._indices[3 * t + k]]._pos.y;
+            }
+            if (y > 0.3f) {
+                indices.insert(indices.end(), &mesh._indices[3 * t], &mesh._indices[3 * t] + 3);
+            }
+        }
+        mesh._indices = indices;
+        return mesh;
+    }
+
+    using DirectedEdges = std::map<std::pair<unsigned, unsigned>, int>;
+
+    DirectedEdges directedEdges(const std::vector<unsigned>& indices) {
+        DirectedEdges edges;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                ++edges[{ indices[3 * t + k], indices[3 * t + (k + 1) % 3] }];
+            }
+        }
+        return edges;
+    }
+
+    // Edges without an opposite
+    std::set<std::pair<unsigned, unsigned>> borderEdges(const std::vector<unsigned>& indices) {
+        const DirectedEdges edges = directedEdges(indices);
+        std::set<std::pair<unsigned, unsigned>> border;
+        for (const auto& edge : edges) {
+            if (!edges.count({ edge.first.second, edge.first.first })) {
+                border.insert(edge.first);
+            }
+        }
+        return border;
+    }
+
+    // No degenerate triangles, every directed edge at most once and interior edges matched by exactly one
+    // opposite, with the Euler characteristic of the input
+    bool checkManifold(const std::vector<unsigned>& indices, long long euler_characteristic) {
+        bool ok = true;
+        std::set<unsigned> used;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            const unsigned* triangle = &indices[3 * t];
+            ok &= CHECK(triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[2] != triangle[0]);
+            used.insert(triangle, triangle + 3);
+        }
+        const DirectedEdges edges = directedEdges(indices);
+        size_t undirected = 0;
+        for (const auto& edge : edges) {
+            ok &= CHECK(edge.second == 1);
+            undirected += !edges.count({ edge.first.second, edge.first.first }) || edge.first.first < edge.first.second;
+        }
+        ok &= CHECK((long long)used.size() - (long long)undirected + (long long)indices.size() / 3 == euler_characteristic);
+        return ok;
+    }
+
+    XMVECTOR position(const Mesh& mesh, unsigned v) {
+        return XMLoadFloat3(&mesh._vertices[v]._pos);
+    }
+
+    // Every triangle still faces away from the tube center
+    bool checkTorusOrientation(const Mesh& mesh, const std::vector<unsigned>& indices) {
+        size_t flipped = 0;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            const XMVECTOR p0 = position(mesh, indices[3 * t]);
+            const XMVECTOR p1 = position(mesh, indices[3 * t + 1]);
+            const XMVECTOR p2 = position(mesh, indices[3 * t + 2]);
+            const XMVECTOR centroid = (p0 + p1 + p2) / 3.0f;
+            const XMVECTOR tube_center = XMVector3Normalize(centroid * XMVectorSet(1.0f, 0.0f, 1.0f, 0.0f)) * MAJOR_RADIUS;
+            flipped += XMVectorGetX(XMVector3Dot(XMVector3Cross(p1 - p0, p2 - p0), centroid - tube_center)) <= 0.0f;
+        }
+        return CHECK(flipped == 0);
+    }
+
+    void reachesTargetCount() {
+        const Mesh torus = test::makeTorus(96, 48, MAJOR_RADIUS, MINOR_RADIUS);
+        float previous_error = 0.0f;
+        for (float ratio : { 0.5f, 0.1f, 0.02f }) {
+            SimplifyOptions options;
+            options._target_index_count = (size_t)(torus._indices.size() * ratio) / 3 * 3;
+            std::vector<unsigned> indices = torus._indices;
+            const float error = simplifyMesh(torus._vertices, indices, options);
+            if (!CHECK(indices.size() <= options._target_index_count)) {
+                std::fprintf(stderr, "  ratio %.2f: %zu of %zu indices\n", ratio, indices.size(), options._target_index_count);
+            }
+            // Each collapse removes two triangles on a closed surface, so it stops right at the target
+            CHECK(indices.size() + 6 > options._target_index_count);
+            CHECK(error > previous_error);
+            previous_error = error;
+            checkManifold(indices, 0);
+            checkTorusOrientation(torus, indices);
+        }
+    }
+
+    // Largest distance from the unit sphere, over the corners, edge midpoints and centroids of the triangles
+    float sphereDeviation(const Mesh& mesh, const std::vector<unsigned>& indices) {
+        float deviation = 0.0f;
+        for (size_t t = 0; t < indices.size() / 3; ++t) {
+            const XMVECTOR p0 = position(mesh, indices[3 * t]);
+            const XMVECTOR p1 = position(mesh, indices[3 * t + 1]);
+            const XMVECTOR p2 = position(mesh, indices[3 * t + 2]);
+            for (XMVECTOR p : { p0, (p0 + p1) * 0.5f, (p1 + p2) * 0.5f, (p2 + p0) * 0.5f, (p0 + p1 + p2) / 3.0f }) {
+                deviation = std::max(deviation, std::fabs(1.0f - XMVectorGetX(XMVector3Length(p))));
+            }
+        }
+        return deviation;
+    }
+
+    void respectsTargetError() {
+        const Mesh sphere = test::makeIcosphere(5);
+        size_t previous_count = sphere._indices.size();
+        for (float target_error : { 2e-3f, 1e-2f, 5e-2f }) {
+            SimplifyOptions options;
+            options._target_error = target_error;
+            std::vector<unsigned> indices = sphere._indices;
+            const float error = simplifyMesh(sphere._vertices, indices, options);
+            CHECK(error <= target_error);
+            CHECK(indices.size() < previous_count);
+            previous_count = indices.size();
+            // Quadrics sum the squared distances to every merged plane, so the surface moves less than the error says
+            const float deviation = sphereDeviation(sphere, indices);
+            if (!CHECK(deviation <= target_error)) {
+                std::fprintf(stderr, "  target %g: deviation %g\n", target_error, deviation);
+            }
+            checkManifold(indices, 2);
+        }
+    }
+
+    void lockedBorderStaysPut() {
+        const Mesh cap = makeCap(4);
+        const std::set<std::pair<unsigned, unsigned>> border = borderEdges(cap._indices);
+        CHECK(border.size() > 20);
+
+        SimplifyOptions options;
+        options._target_index_count = cap._indices.size() / 10 / 3 * 3;
+        std::vector<unsigned> indices = cap._indices;
+        simplifyMesh(cap._vertices, indices, options);
+        // The very same border edges, so the cap still fits whatever it was cut from
+        CHECK(borderEdges(indices) == border);
+        checkManifold(indices, 1);
+        CHECK(indices.size() < cap._indices.size() / 2);
+    }
+
+    void freeBorderStaysOnItsLine() {
+        const Mesh cap = makeCap(4);
+        std::set<unsigned> border_vertices;
+        for (const auto& edge : borderEdges(cap._indices)) {
+            border_vertices.insert(edge.first);
+        }
+
+        SimplifyOptions options;
+        options._lock_border = false;
+        options._target_index_count = cap._indices.size() / 10 / 3 * 3;
+        std::vector<unsigned> indices = cap._indices;
+        simplifyMesh(cap._vertices, indices, options);
+        CHECK(indices.size() <= options._target_index_count);
+        checkManifold(indices, 1);
+        // The border may lose vertices, but only ever to other border vertices
+        const std::set<std::pair<unsigned, unsigned>> border = borderEdges(indices);
+        CHECK(border.size() < border_vertices.size());
+        for (const auto& edge : border) {
+            CHECK(border_vertices.count(edge.first) && border_vertices.count(edge.second));
+        }
+    }
+
+    // A hard edge around the x = 0 circle: the triangles on the positive side get their own copies of the
+    // vertices with different normals, as an importer would produce them
+    void seamVerticesAreKept() {
+        Mesh sphere = test::makeIcosphere(4);
+        const size_t original_count = sphere._vertices.size();
+        std::vector<unsigned> copies(original_count, ~0u);
+        for (size_t t = 0; t < sphere._indices.size() / 3; ++t) {
+            unsigned* triangle = &sphere._indices[3 * t];
+            if (sphere._vertices[triangle[0]]._pos.x + sphere._vertices[triangle[1]]._pos.x + sphere._vertices[triangle[2]]._pos.x <= 0.0f) {
+                continue;
+            }
+            for (size_t k = 0; k < 3; ++k) {
+                if (copies[triangle[k]] == ~0u) {
+                    copies[triangle[k]] = (unsigned)sphere._vertices.size();
+                    SimpleVertex copy = sphere._vertices[triangle[k]];
+                    copy._nor = XMFLOAT3(1.0f, 0.0f, 0.0f);
+                    sphere._vertices.push_back(copy);
+                }
+                triangle[k] = copies[triangle[k]];
+            }
+        }
+        std::set<unsigned> seam;
+        const std::set<unsigned> negative_side(sphere._indices.begin(), sphere._indices.end());
+        for (unsigned v = 0; v < original_count; ++v) {
+            if (copies[v] != ~0u && negative_side.count(v)) {
+                seam.insert(v);
+                seam.insert(copies[v]);
+            }
+        }
+        CHECK(seam.size() > 20);
+        const std::set<std::pair<unsigned, unsigned>> border = borderEdges(sphere._indices);
+
+        SimplifyOptions options;
+        options._lock_border = false;
+        options._target_index_count = sphere._indices.size() / 10 / 3 * 3;
+        std::vector<unsigned> indices = sphere._indices;
+        simplifyMesh(sphere._vertices, indices, options);
+        // The originals of the copied vertices are left unused in the buffer, they must not lock anything
+        CHECK(indices.size() <= options._target_index_count);
+        // Both sides keep every seam vertex, so the two halves still meet without a crack
+        const std::set<unsigned> used(indices.begin(), indices.end());
+        for (unsigned v : seam) {
+            CHECK(used.count(v) == 1);
+        }
+        CHECK(borderEdges(indices) == border);
+    }
+
+    void parallelKeepsSeamsClosed() {
+        const Mesh torus = test::makeTorus(128, 48, MAJOR_RADIUS, MINOR_RADIUS);
+        SimplifyOptions options;
+        options._target_index_count = torus._indices.size() / 50 / 3 * 3;
+        std::vector<unsigned> serial_indices = torus._indices;
+        const float serial_error = simplifyMesh(torus._vertices, serial_indices, options);
+        for (size_t chunk_count : { 1, 4, 8 }) {
+            std::vector<unsigned> indices = torus._indices;
+            const float error = simplifyMeshParallel(torus._vertices, indices, options, chunk_count);
+            // The serial pass after the slabs reaches the target, and thin slabs do not tear the surface up on the way
+            CHECK(indices.size() <= options._target_index_count);
+            CHECK(error > 0.0f);
+            if (!CHECK(error <= 2.0f * serial_error)) {
+                std::fprintf(stderr, "  %zu chunks: error %g, serial %g\n", chunk_count, error, serial_error);
+            }
+            checkManifold(indices, 0);
+            checkTorusOrientation(torus, indices);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "reaches target count", reachesTargetCount },
+        { "respects target error", respectsTargetError },
+        { "locked border stays put", lockedBorderStaysPut },
+        { "free border stays on its line", freeBorderStaysOnItsLine },
+        { "seam vertices are kept", seamVerticesAreKept },
+        { "parallel keeps seams closed", parallelKeepsSeamsClosed },
+    });
+}
@@ -0,0 +1,236 @@
+#include "../lab-5/Camera.h"
+#include "../lab-5/Geometry/MeshOptimizer.h"
+#include "../lab-5/Geometry/Meshlets.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestMeshes.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+using test::Mesh;
+
+namespace {
+    std::vector<Mesh> meshes() {
+        Mesh uv_sphere = test::makeUvSphere(60, 60);
+        optimizeMesh(uv_sphere._vertices, uv_sphere._indices);
+        // Not convex, so some front facing triangles are hidden behind others and must still be kept
+        return { uv_sphere, test::makeIcosphere(5), test::makeTorus(96, 32) };
+    }
+
+    using Triangle = std::array<unsigned, 3>;
+
+    // Rotated to start at the smallest index, so the winding still has to match
+    Triangle canonical(unsigned a, unsigned b, unsigned c) {
+        Triangle triangle = { a, b, c };
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        return triangle;
+    }
+
+    std::multiset<Triangle> triangleSet(const std::vector<unsigned>& indices) {
+        std::multiset<Triangle> triangles;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            triangles.insert(canonical(indices[i], indices[i + 1], indices[i + 2]));
+        }
+        return triangles;
+    }
+
+    std::vector<unsigned> meshletIndices(const MeshletMesh& mesh, const Meshlet& meshlet) {
+        std::vector<unsigned> indices;
+        for (uint32_t i = 0; i < 3 * meshlet._triangle_count; ++i) {
+            indices.push_back(mesh._vertices[meshlet._vertex_offset + mesh._triangles[meshlet._triangle_offset + i]]);
+        }
+        return indices;
+    }
+
+    void buildKeepsEveryTriangle() {
+        for (const Mesh& mesh : meshes()) {
+            for (size_t max_vertices : { (size_t)MESHLET_MAX_VERTICES, (size_t)32 }) {
+                const size_t max_triangles = max_vertices == 32 ? 40 : MESHLET_MAX_TRIANGLES;
+                const MeshletMesh meshlets = buildMeshlets(mesh._vertices, mesh._indices, max_vertices, max_triangles);
+                std::vector<unsigned> indices;
+                bool within_limits = true;
+                bool unique_vertices = true;
+                for (const Meshlet& meshlet : meshlets._meshlets) {
+                    within_limits &= meshlet._vertex_count <= max_vertices && meshlet._triangle_count <= max_triangles && meshlet._triangle_count > 0;
+                    const std::set<unsigned> vertices(meshlets._vertices.begin() + meshlet._vertex_offset,
+                        meshlets._vertices.begin() + meshlet._vertex_offset + meshlet._vertex_count);
+                    unique_vertices &= vertices.size() == meshlet._vertex_count;
+                    const std::vector<unsigned> meshlet_indices = meshletIndices(meshlets, meshlet);
+                    indices.insert(indices.end(), meshlet_indices.begin(), meshlet_indices.end());
+                }
+                CHECK(within_limits);
+                CHECK(unique_vertices);
+                CHECK(triangleSet(indices) == triangleSet(mesh._indices));
+                // Growing over neighbours fills the meshlets, a fragmented builder would end up with many small ones
+                const double average = (double)mesh._indices.size() / 3 / meshlets._meshlets.size();
+                if (!CHECK(average >= 0.5 * max_triangles)) {
+                    std::fprintf(stderr, "  %s, %zu vertices: %.1f triangles per meshlet\n", mesh._name.c_str(), max_vertices, average);
+                }
+            }
+        }
+    }
+
+    void boundsContainMeshlets() {
+        for (const Mesh& mesh : meshes()) {
+            const MeshletMesh meshlets = buildMeshlets(mesh._vertices, mesh._indices);
+            size_t outside = 0;
+            size_t off_cone = 0;
+            size_t without_cone = 0;
+            for (const Meshlet& meshlet : meshlets._meshlets) {
+                const std::vector<unsigned> indices = meshletIndices(meshlets, meshlet);
+                const XMVECTOR center = XMLoadFloat3(&meshlet._center);
+                const XMVECTOR axis = XMLoadFloat3(&meshlet._cone_axis);
+                const float min_cos = sqrtf(1.0f - meshlet._cone_cutoff * meshlet._cone_cutoff);
+                without_cone += meshlet._cone_cutoff >= 1.0f;
+                for (size_t i = 0; i < indices.size(); i += 3) {
+                    XMVECTOR p[3];
+                    for (size_t k = 0; k < 3; ++k) {
+                        p[k] = XMLoadFloat3(&mesh._vertices[indices[i + k]]._pos);
+                        outside += XMVectorGetX(XMVector3Length(p[k] - center)) > meshlet._radius * 1.0001f + 1e-6f;
+                    }
+                    const XMVECTOR normal = XMVector3Normalize(XMVector3Cross(p[1] - p[0], p[2] - p[0]));
+                    off_cone += meshlet._cone_cutoff < 1.0f && XMVectorGetX(XMVector3Dot(normal, axis)) < min_cos - 1e-4f;
+                }
+            }
+            CHECK(outside == 0);
+            CHECK(off_cone == 0);
+            // Smooth surfaces give every meshlet a cone narrow enough to cull with
+            if (!CHECK(without_cone == 0)) {
+                std::fprintf(stderr, "  %s: %zu of %zu meshlets without a cone\n", mesh._name.c_str(), without_cone, meshlets._meshlets.size());
+            }
+        }
+    }
+
+    // A triangle is visible when it faces the camera and some point of it is inside the clip volume.
+    // Corners, edge midpoints and the centroid are enough for the small triangles of these meshes
+    bool isTriangleVisible(const XMVECTOR p[3], CXMMATRIX view_projection, FXMVECTOR camera_pos) {
+        if (XMVectorGetX(XMVector3Dot(XMVector3Cross(p[1] - p[0], p[2] - p[0]), p[0] - camera_pos)) >= 0.0f) {
+            return false;
+        }
+        const XMVECTOR samples[7] = { p[0], p[1], p[2], (p[0] + p[1]) * 0.5f, (p[1] + p[2]) * 0.5f, (p[2] + p[0]) * 0.5f, (p[0] + p[1] + p[2]) / 3.0f };
+        for (const XMVECTOR& sample : samples) {
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector4Transform(XMVectorSetW(sample, 1.0f), view_projection));
+            if (clip.w > 0.0f && fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z >= 0.0f && clip.z <= clip.w) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct SweepResult {
+        size_t _triangles = 0;
+        size_t _visible_triangles = 0;
+        // Triangles culling each triangle on its own would keep
+        size_t _needed_triangles = 0;
+        size_t _wrongly_culled = 0;
+    };
+
+    // The camera orbits the mesh and looks at it or past it, every front facing triangle in view has to survive
+    SweepResult sweep(const Mesh& mesh, const MeshletMesh& meshlets, CXMMATRIX world, float distance) {
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f);
+        const XMVECTOR target = XMVector3TransformCoord(XMVectorZero(), world);
+        SweepResult result;
+        std::vector<unsigned> indices;
+        for (size_t step = 0; step < 16; ++step) {
+            const float angle = step * XM_2PI / 16;
+            const XMVECTOR offset = XMVectorSet(distance * sinf(angle), 0.3f * distance, -distance * cosf(angle), 0.0f);
+            const XMVECTOR directions[2] = { -offset, XMVector3Cross(offset, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) };
+            for (const XMVECTOR& direction : directions) {
+                const Camera camera(target + offset, XMVector3Normalize(direction));
+                const XMMATRIX view_projection = camera.getViewMatrix() * projection;
+                const MeshletCullStats stats = cullMeshlets(meshlets, world, view_projection, camera.getPosition(), indices);
+                result._triangles += stats._triangles;
+                result._visible_triangles += stats._visible_triangles;
+                CHECK(indices.size() == 3 * stats._visible_triangles);
+
+                const std::multiset<Triangle> kept = triangleSet(indices);
+                for (size_t i = 0; i < mesh._indices.size(); i += 3) {
+                    XMVECTOR p[3];
+                    for (size_t k = 0; k < 3; ++k) {
+                        p[k] = XMVector3TransformCoord(XMLoadFloat3(&mesh._vertices[mesh._indices[i + k]]._pos), world);
+                    }
+                    if (isTriangleVisible(p, view_projection, camera.getPosition())) {
+                        ++result._needed_triangles;
+                        result._wrongly_culled += kept.count(canonical(mesh._indices[i], mesh._indices[i + 1], mesh._indices[i + 2])) == 0;
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    void cullingKeepsVisibleTriangles() {
+        // Moved and uniformly scaled as well, the bounds go through the world matrix
+        const XMMATRIX worlds[2] = { XMMatrixIdentity(), XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(3.0f, -1.0f, 5.0f) };
+        for (const Mesh& mesh : meshes()) {
+            const MeshletMesh meshlets = buildMeshlets(mesh._vertices, mesh._indices);
+            for (const XMMATRIX& world : worlds) {
+                for (float distance : { 1.5f, 3.0f, 10.0f }) {
+                    const SweepResult result = sweep(mesh, meshlets, world, distance * XMVectorGetX(XMVector3Length(world.r[0])));
+                    if (!CHECK(result._wrongly_culled == 0)) {
+                        std::fprintf(stderr, "  %s at %.1f: %zu triangles wrongly culled\n", mesh._name.c_str(), distance, result._wrongly_culled);
+                    }
+                }
+            }
+        }
+    }
+
+    void cullingRejectsBackFacingAndOffscreen() {
+        // Whole meshlets are kept or dropped, so they can only reject part of what culling each triangle would.
+        // Most of it from afar, close up the bounding spheres are large next to the distance and the cone test
+        // gives up on the meshlets around the silhouette, on the torus that is half of them
+        for (const Mesh& mesh : meshes()) {
+            const MeshletMesh meshlets = buildMeshlets(mesh._vertices, mesh._indices);
+            for (float distance : { 1.5f, 3.0f, 10.0f }) {
+                const SweepResult result = sweep(mesh, meshlets, XMMatrixIdentity(), distance);
+                const float rejected = 1.0f - (float)result._visible_triangles / result._triangles;
+                const float rejectable = 1.0f - (float)result._needed_triangles / result._triangles;
+                if (!CHECK(rejected >= (distance >= 10.0f ? 0.8f : 0.45f) * rejectable)) {
+                    std::fprintf(stderr, "  %s at %.1f: rejected %.1f%% of %.1f%%\n", mesh._name.c_str(), distance, 100.0f * rejected, 100.0f * rejectable);
+                }
+            }
+        }
+
+        // Looking straight down the axis of a meshlet from behind culls it, from in front keeps it
+        const Icosphere icosphere(1.0f, 4, true);
+        const MeshletMesh meshlets = buildMeshlets(icosphere.getVertices(), icosphere.getIndices());
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.01f, 100.0f);
+        size_t culled_from_behind = 0;
+        size_t kept_from_front = 0;
+        for (const Meshlet& meshlet : meshlets._meshlets) {
+            const XMVECTOR center = XMLoadFloat3(&meshlet._center);
+            const XMVECTOR axis = XMLoadFloat3(&meshlet._cone_axis);
+            for (float side : { 1.0f, -1.0f }) {
+                const Camera camera(center + axis * (3.0f * side), -axis * side);
+                XMVECTOR planes[6];
+                extractFrustumPlanes(camera.getViewMatrix() * projection, planes);
+                const bool visible = isMeshletVisible(meshlet, XMMatrixIdentity(), planes, camera.getPosition());
+                if (side > 0.0f) {
+                    kept_from_front += visible;
+                } else {
+                    culled_from_behind += !visible;
+                }
+            }
+        }
+        CHECK(kept_from_front == meshlets._meshlets.size());
+        CHECK(culled_from_behind == meshlets._meshlets.size());
+    }
+}
+
+int main() {
+    return test::run({
+        { "build keeps every triangle", buildKeepsEveryTriangle },
+        { "bounds contain meshlets", boundsContainMeshlets },
+        { "culling keeps visible triangles", cullingKeepsVisibleTriangles },
+        { "culling rejects back facing and offscreen", cullingRejectsBackFacingAndOffscreen },
+    });
+}
@@ -0,0 +1,276 @@
+#include "../lab-5/Geometry/ObjImporter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    const char* FIXTURES = "fixtures/obj/";
+
+    struct Mesh {
+        ObjImportReport _report;
+        std::vector<SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+    };
+
+    // Without the optimizer, so the output order only depends on the parser
+    ObjImportOptions options(size_t chunk_size = ObjImportOptions()._chunk_size) {
+        ObjImportOptions result;
+        result._chunk_size = chunk_size;
+        result._optimize = false;
+        return result;
+    }
+
+    Mesh parse(const std::string& text, const ObjImportOptions& import_options = options()) {
+        Mesh mesh;
+        mesh._report = parseObj(text.data(), text.size(), mesh._vertices, mesh._indices, import_options);
+        return mesh;
+    }
+
+    Mesh import(const char* name, const ObjImportOptions& import_options = options()) {
+        Mesh mesh;
+        mesh._report = importObj(std::string(FIXTURES) + name, mesh._vertices, mesh._indices, import_options);
+        return mesh;
+    }
+
+    std::string readFixture(const char* name) {
+        std::ifstream file(std::string(FIXTURES) + name, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    using Corner = std::array<float, 6>;
+    using Triangle = std::array<Corner, 3>;
+
+    // Triangles by vertex contents, each rotated to start at its smallest corner, so the winding has to match
+    std::vector<Triangle> triangleSet(const Mesh& mesh) {
+        std::vector<Triangle> triangles;
+        for (size_t t = 0; t < mesh._indices.size() / 3; ++t) {
+            Triangle triangle;
+            for (size_t k = 0; k < 3; ++k) {
+                const SimpleVertex& v = mesh._vertices[mesh._indices[3 * t + k]];
+                triangle[k] = { v._pos.x, v._pos.y, v._pos.z, v._nor.x, v._nor.y, v._nor.z };
+            }
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    bool sameMesh(const Mesh& a, const Mesh& b) {
+        return a._vertices.size() == b._vertices.size() && a._indices == b._indices
+            && std::equal(a._vertices.begin(), a._vertices.end(), b._vertices.begin(), [](const SimpleVertex& x, const SimpleVertex& y) {
+                return x._pos.x == y._pos.x && x._pos.y == y._pos.y && x._pos.z == y._pos.z && x._nor.x == y._nor.x && x._nor.y == y._nor.y && x._nor.z == y._nor.z;
+            });
+    }
+
+    XMVECTOR faceNormal(const Mesh& mesh, size_t t) {
+        XMVECTOR p0 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t]]._pos);
+        XMVECTOR p1 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 1]]._pos);
+        XMVECTOR p2 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 2]]._pos);
+        return XMVector3Cross(p1 - p0, p2 - p0);
+    }
+
+    void cubeWithTextureCoordinates() {
+        const Mesh cube = import("cube.obj");
+        CHECK(cube._report._status == ObjStatus::OK);
+        CHECK(cube._report._positions == 8 && cube._report._normals == 6);
+        // Quads are fanned, texture coordinates, groups, materials, lines and comments are skipped
+        CHECK(cube._report._triangles == 12 && cube._indices.size() == 36);
+        CHECK(!cube._report._generated_normals);
+        // Four corners per face share a normal, texture coordinates do not split vertices
+        CHECK(cube._vertices.size() == 24);
+        for (size_t t = 0; t < 12; ++t) {
+            // Winding is kept: every triangle turns towards the normal its file gave it
+            const XMVECTOR normal = XMLoadFloat3(&cube._vertices[cube._indices[3 * t]]._nor);
+            CHECK(XMVectorGetX(XMVector3Dot(faceNormal(cube, t), normal)) > 0.0f);
+            CHECK(XMVectorGetX(XMVector3Length(faceNormal(cube, t))) == 4.0f);
+        }
+    }
+
+    void negativeIndicesMatchPositive() {
+        const Mesh cube = import("cube.obj");
+        const Mesh negative = import("cube_negative.obj");
+        CHECK(negative._report._status == ObjStatus::OK);
+        CHECK(!negative._report._generated_normals);
+        CHECK(negative._vertices.size() == cube._vertices.size());
+        CHECK(triangleSet(negative) == triangleSet(cube));
+
+        // Relative indices are resolved after the chunks are counted, so they may point into earlier chunks.
+        // Down to one line per chunk the result does not change
+        for (size_t chunk_size : { (size_t)1, (size_t)16, (size_t)100 }) {
+            CHECK(sameMesh(import("cube_negative.obj", options(chunk_size)), negative));
+        }
+    }
+
+    void missingNormalsAreGenerated() {
+        // Two faces without texture coordinates, two with them, none with normals
+        const Mesh tetrahedron = import("tetrahedron.obj");
+        CHECK(tetrahedron._report._status == ObjStatus::OK);
+        CHECK(tetrahedron._report._generated_normals);
+        CHECK(tetrahedron._vertices.size() == 4 && tetrahedron._indices.size() == 12);
+        // Every corner touches three faces of a regular tetrahedron, their average points away from the center
+        for (const SimpleVertex& vertex : tetrahedron._vertices) {
+            const XMVECTOR normal = XMLoadFloat3(&vertex._nor);
+            const XMVECTOR radial = XMVector3Normalize(XMLoadFloat3(&vertex._pos));
+            CHECK_NEAR(XMVectorGetX(XMVector3Length(normal)), 1.0f, 1e-6f);
+            CHECK(XMVectorGetX(XMVector3Dot(normal, radial)) > 0.9999f);
+        }
+        for (size_t t = 0; t < 4; ++t) {
+            const XMVECTOR center = XMLoadFloat3(&tetrahedron._vertices[tetrahedron._indices[3 * t]]._pos);
+            CHECK(XMVectorGetX(XMVector3Dot(faceNormal(tetrahedron, t), center)) > 0.0f);
+        }
+
+        // A mesh that mixes corners with and without normals keeps the given ones
+        const Mesh mixed = parse("v 0 0 0\nv 1 0 0\nv 0 1 0\nv 0 0 1\nvn 0 0 -1\nf 1//1 3//1 2//1\nf 1 2 4\n");
+        CHECK(mixed._report._status == ObjStatus::OK && mixed._report._generated_normals);
+        size_t given = 0;
+        for (const SimpleVertex& vertex : mixed._vertices) {
+            given += vertex._nor.x == 0.0f && vertex._nor.y == 0.0f && vertex._nor.z == -1.0f;
+        }
+        CHECK(given == 3);
+        CHECK(mixed._vertices.size() == 6);
+    }
+
+    void layoutVariationsParseTheSame() {
+        const std::string text = readFixture("cube.obj");
+        const Mesh reference = parse(text);
+        // CRLF line ends, tabs and runs of spaces, trailing comments, no newline at the end of the file
+        std::string variant;
+        for (char c : text) {
+            if (c == '\n') {
+                variant += "  # end\r\n";
+            } else if (c == ' ') {
+                variant += " \t ";
+            } else {
+                variant += c;
+            }
+        }
+        variant.resize(variant.size() - 2);
+        CHECK(sameMesh(parse(variant), reference));
+        CHECK(sameMesh(parse(variant, options(7)), reference));
+
+        // Polygons fan around their first corner
+        const Mesh pentagon = parse("v 0 0 0\nv 2 0 0\nv 3 1 0\nv 1 2 0\nv -1 1 0\nf 1 2 3 4 5\n");
+        CHECK(pentagon._report._triangles == 3);
+        // By the x of each corner, vertices are numbered by hash shard and not in file order
+        const float expected[] = { 0.0f, 2.0f, 3.0f, 0.0f, 3.0f, 1.0f, 0.0f, 1.0f, -1.0f };
+        std::vector<float> corners;
+        for (unsigned index : pentagon._indices) {
+            corners.push_back(pentagon._vertices[index]._pos.x);
+        }
+        CHECK(corners == std::vector<float>(std::begin(expected), std::end(expected)));
+
+        const Mesh empty = parse("");
+        CHECK(empty._report._status == ObjStatus::OK && empty._vertices.empty() && empty._indices.empty());
+        CHECK(import("does_not_exist.obj")._report._status == ObjStatus::MISSING);
+    }
+
+    void floatsRoundCorrectly() {
+        // The fast path and the strtod fallback both have to give the correctly rounded float
+        const char* tokens[] = {
+            "0", "-0.5", "+.5", "1.", "150e0", "1.5E2", "-0.000125", "3.14159265358979323846", "1e-30", "1e30",
+            "12345678901234567890", "0.1", "0.30000000000000004", "1e22", "1e23", "123456.789e-3", "7e-46",
+        };
+        for (const char* token : tokens) {
+            const std::string text = std::string("v ") + token + " 0 0\nv 0 1 0\nv 0 0 1\nf 1 2 3\n";
+            const Mesh mesh = parse(text);
+            if (!CHECK(mesh._report._status == ObjStatus::OK)) {
+                continue;
+            }
+            const float expected = (float)strtod(token, nullptr);
+            bool found = false;
+            for (const SimpleVertex& vertex : mesh._vertices) {
+                found |= vertex._pos.x == expected && vertex._pos.y == 0.0f;
+            }
+            if (!CHECK(found)) {
+                std::fprintf(stderr, "  %s\n", token);
+            }
+        }
+    }
+
+    // Only an empty regular file is an empty mesh, every other path that cannot be mapped is an error
+    void unmappablePaths() {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "lab5-obj-importer-test";
+        std::filesystem::create_directories(directory);
+        std::vector<SimpleVertex> vertices = { SimpleVertex() };
+        std::vector<unsigned> indices = { 0, 0, 0 };
+        const ObjImportReport directory_report = importObj(directory, vertices, indices, options());
+        CHECK(directory_report._status == ObjStatus::UNREADABLE);
+        CHECK(vertices.empty() && indices.empty());
+
+        const std::filesystem::path empty = directory / "empty.obj";
+        std::ofstream(empty).close();
+        CHECK(importObj(empty, vertices, indices, options())._status == ObjStatus::OK);
+
+        const std::filesystem::path locked = directory / "locked.obj";
+        std::ofstream(locked) << readFixture("tetrahedron.obj");
+        std::filesystem::permissions(locked, std::filesystem::perms::none);
+        // Root and Windows administrators read it anyway, the status can only be checked where opening fails
+        if (!std::ifstream(locked)) {
+            const ObjImportReport locked_report = importObj(locked, vertices, indices, options());
+            if (!CHECK(locked_report._status == ObjStatus::UNREADABLE)) {
+                std::fprintf(stderr, "  locked file: %s\n", getObjStatusName(locked_report._status));
+            }
+        } else {
+            std::printf("  skipped the locked file, this process can read it\n");
+        }
+        std::filesystem::permissions(locked, std::filesystem::perms::owner_all);
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    void malformedFilesAreRejected() {
+        struct Case {
+            const char* _name;
+            ObjStatus _status;
+            // 0 when the parser cannot tell, indices are only checked against the whole file
+            size_t _line;
+        };
+        const Case cases[] = {
+            { "bad_float.obj", ObjStatus::PARSE_ERROR, 3 },
+            { "missing_exponent.obj", ObjStatus::PARSE_ERROR, 2 },
+            { "short_vertex.obj", ObjStatus::PARSE_ERROR, 2 },
+            { "short_face.obj", ObjStatus::PARSE_ERROR, 5 },
+            { "bad_face_token.obj", ObjStatus::PARSE_ERROR, 5 },
+            { "zero_index.obj", ObjStatus::BAD_INDEX, 4 },
+            { "out_of_range.obj", ObjStatus::BAD_INDEX, 0 },
+            { "before_start.obj", ObjStatus::BAD_INDEX, 0 },
+            { "normal_out_of_range.obj", ObjStatus::BAD_INDEX, 0 },
+        };
+        for (const Case& test_case : cases) {
+            const std::string name = std::string("malformed/") + test_case._name;
+            for (size_t chunk_size : { ObjImportOptions()._chunk_size, (size_t)1, (size_t)10 }) {
+                const Mesh mesh = import(name.c_str(), options(chunk_size));
+                const bool ok = CHECK(mesh._report._status == test_case._status) && CHECK(mesh._report._error_line == test_case._line);
+                if (!ok) {
+                    std::fprintf(stderr, "  %s, chunks of %zu: %s at line %zu\n", test_case._name, chunk_size, getObjStatusName(mesh._report._status),
+                        mesh._report._error_line);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "cube with texture coordinates", cubeWithTextureCoordinates },
+        { "negative indices match positive", negativeIndicesMatchPositive },
+        { "missing normals are generated", missingNormalsAreGenerated },
+        { "layout variations parse the same", layoutVariationsParseTheSame },
+        { "floats round correctly", floatsRoundCorrectly },
+        { "unmappable paths", unmappablePaths },
+        { "malformed files are rejected", malformedFilesAreRejected },
+    });
+}
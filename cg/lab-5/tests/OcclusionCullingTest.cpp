@@ -0,0 +1,262 @@
+#include "../lab-5/Scene/OcclusionCulling.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::scene;
+
+namespace {
+    struct Triangle {
+        XMFLOAT3 _a;
+        XMFLOAT3 _b;
+        XMFLOAT3 _c;
+    };
+
+    struct Occluder {
+        const std::vector<XMFLOAT3>* _positions;
+        const std::vector<unsigned>* _indices;
+        XMMATRIX _world;
+    };
+
+    const std::vector<XMFLOAT3> QUAD = { XMFLOAT3(-1.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 0.0f), XMFLOAT3(-1.0f, 1.0f, 0.0f) };
+    const std::vector<unsigned> QUAD_INDICES = { 0, 1, 2, 0, 2, 3 };
+    const std::vector<XMFLOAT3> CUBE = {
+        XMFLOAT3(-1.0f, -1.0f, -1.0f), XMFLOAT3(1.0f, -1.0f, -1.0f), XMFLOAT3(-1.0f, 1.0f, -1.0f), XMFLOAT3(1.0f, 1.0f, -1.0f),
+        XMFLOAT3(-1.0f, -1.0f, 1.0f), XMFLOAT3(1.0f, -1.0f, 1.0f), XMFLOAT3(-1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f),
+    };
+    const std::vector<unsigned> CUBE_INDICES = {
+        0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, 0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, 0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3,
+    };
+
+    // The camera sits at the origin and looks down +z, so view space is world space
+    const float FOV_Y = XM_PIDIV2;
+    const float ASPECT = 16.0f / 9.0f;
+
+    XMMATRIX viewProjection() {
+        return XMMatrixPerspectiveFovLH(FOV_Y, ASPECT, 0.1f, 200.0f);
+    }
+
+    // Three walls at different depths and angles, and with near_box a small box that crosses the near plane
+    std::vector<Occluder> makeOccluders(bool near_box) {
+        std::vector<Occluder> occluders = {
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(6.0f, 4.0f, 1.0f) * XMMatrixTranslation(-5.0f, 0.0f, 10.0f) },
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(4.0f, 6.0f, 1.0f) * XMMatrixRotationY(0.4f) * XMMatrixTranslation(6.0f, 1.0f, 14.0f) },
+            { &QUAD, &QUAD_INDICES, XMMatrixScaling(20.0f, 2.0f, 1.0f) * XMMatrixTranslation(0.0f, -6.0f, 20.0f) },
+        };
+        if (near_box) {
+            occluders.push_back({ &CUBE, &CUBE_INDICES, XMMatrixScaling(0.2f, 0.2f, 0.225f) * XMMatrixTranslation(0.3f, -0.1f, 0.275f) });
+        }
+        return occluders;
+    }
+
+    void render(OcclusionBuffer& buffer, const std::vector<Occluder>& occluders) {
+        buffer.begin(viewProjection());
+        for (const Occluder& occluder : occluders) {
+            buffer.renderOccluder(*occluder._positions, *occluder._indices, occluder._world);
+        }
+        buffer.buildHierarchy();
+    }
+
+    std::vector<Triangle> getTriangles(const std::vector<Occluder>& occluders) {
+        std::vector<Triangle> triangles;
+        for (const Occluder& occluder : occluders) {
+            const std::vector<unsigned>& indices = *occluder._indices;
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                XMFLOAT3 corners[3];
+                for (size_t k = 0; k < 3; ++k) {
+                    XMStoreFloat3(&corners[k], XMVector3TransformCoord(XMLoadFloat3(&(*occluder._positions)[indices[i + k]]), occluder._world));
+                }
+                triangles.push_back({ corners[0], corners[1], corners[2] });
+            }
+        }
+        return triangles;
+    }
+
+    // Moller-Trumbore from the camera, true if the triangle is hit before distance
+    bool blocks(const Triangle& triangle, FXMVECTOR dir, float distance) {
+        const XMVECTOR a = XMLoadFloat3(&triangle._a);
+        const XMVECTOR e1 = XMLoadFloat3(&triangle._b) - a;
+        const XMVECTOR e2 = XMLoadFloat3(&triangle._c) - a;
+        const XMVECTOR p = XMVector3Cross(dir, e2);
+        const float det = XMVectorGetX(XMVector3Dot(e1, p));
+        if (std::fabs(det) < 1e-12f) {
+            return false;
+        }
+        const float inv_det = 1.0f / det;
+        const XMVECTOR s = -a;
+        const float u = XMVectorGetX(XMVector3Dot(s, p)) * inv_det;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        const XMVECTOR q = XMVector3Cross(s, e1);
+        const float v = XMVectorGetX(XMVector3Dot(dir, q)) * inv_det;
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+        const float t = XMVectorGetX(XMVector3Dot(e2, q)) * inv_det;
+        return t > 0.0f && t < distance - 1e-3f;
+    }
+
+    // The point at view depth z along the direction through (ndc_x, ndc_y) can be seen
+    bool isSeen(const std::vector<Triangle>& triangles, float ndc_x, float ndc_y, float z) {
+        if (std::fabs(ndc_x) > 1.0f || std::fabs(ndc_y) > 1.0f) {
+            return false;
+        }
+        const float tan_y = std::tan(0.5f * FOV_Y);
+        const XMVECTOR ray = XMVectorSet(ndc_x * tan_y * ASPECT * z, ndc_y * tan_y * z, z, 0.0f);
+        const float distance = XMVectorGetX(XMVector3Length(ray));
+        const XMVECTOR dir = ray / distance;
+        for (const Triangle& triangle : triangles) {
+            if (blocks(triangle, dir, distance)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Truth {
+        bool _in_view = false;
+        bool _visible = false;
+        // Some point is seen along with the points one buffer pixel around it
+        bool _clearly_visible = false;
+    };
+
+    // Samples a grid on every face of the box
+    Truth sampleBox(const std::vector<Triangle>& triangles, const Aabb& box, size_t width, size_t height) {
+        const XMMATRIX view_projection = viewProjection();
+        const float pixel_x = 2.0f / width;
+        const float pixel_y = 2.0f / height;
+        const float box_min[3] = { box._min.x, box._min.y, box._min.z };
+        const float box_max[3] = { box._max.x, box._max.y, box._max.z };
+        const size_t steps = 6;
+        Truth truth;
+        for (size_t face = 0; face < 6 && !truth._clearly_visible; ++face) {
+            const size_t axis = face / 2;
+            for (size_t u = 0; u <= steps && !truth._clearly_visible; ++u) {
+                for (size_t v = 0; v <= steps && !truth._clearly_visible; ++v) {
+                    float p[3];
+                    p[axis] = face & 1 ? box_max[axis] : box_min[axis];
+                    const size_t axis_u = (axis + 1) % 3;
+                    const size_t axis_v = (axis + 2) % 3;
+                    p[axis_u] = box_min[axis_u] + (box_max[axis_u] - box_min[axis_u]) * u / steps;
+                    p[axis_v] = box_min[axis_v] + (box_max[axis_v] - box_min[axis_v]) * v / steps;
+                    XMFLOAT4 clip;
+                    XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(p[0], p[1], p[2], 1.0f), view_projection));
+                    if (clip.w <= 0.0f || clip.z < 0.0f || clip.z > clip.w || std::fabs(clip.x) > clip.w || std::fabs(clip.y) > clip.w) {
+                        continue;
+                    }
+                    truth._in_view = true;
+                    const float ndc_x = clip.x / clip.w;
+                    const float ndc_y = clip.y / clip.w;
+                    if (!isSeen(triangles, ndc_x, ndc_y, p[2])) {
+                        continue;
+                    }
+                    truth._visible = true;
+                    truth._clearly_visible = isSeen(triangles, ndc_x - pixel_x, ndc_y, p[2]) && isSeen(triangles, ndc_x + pixel_x, ndc_y, p[2])
+                        && isSeen(triangles, ndc_x, ndc_y - pixel_y, p[2]) && isSeen(triangles, ndc_x, ndc_y + pixel_y, p[2]);
+                }
+            }
+        }
+        return truth;
+    }
+
+    std::vector<Aabb> makeBoxes(size_t count, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Aabb> boxes(count);
+        for (Aabb& box : boxes) {
+            const XMFLOAT3 center(unit(random) * 80.0f - 40.0f, unit(random) * 40.0f - 20.0f, unit(random) * 100.0f + 2.0f);
+            const float size = 0.1f + unit(random) * 1.5f;
+            box._min = XMFLOAT3(center.x - size, center.y - size, center.z - size);
+            box._max = XMFLOAT3(center.x + size, center.y + size, center.z + size);
+        }
+        return boxes;
+    }
+
+    Aabb makeBox(const XMFLOAT3& center, float size) {
+        Aabb box;
+        box._min = XMFLOAT3(center.x - size, center.y - size, center.z - size);
+        box._max = XMFLOAT3(center.x + size, center.y + size, center.z + size);
+        return box;
+    }
+
+    void simpleCases() {
+        OcclusionBuffer buffer;
+        const std::vector<Occluder> walls = makeOccluders(false);
+        render(buffer, walls);
+        CHECK(buffer.getOccluderTriangleCount() == 6);
+        // The first wall covers x in [-11, 1] and y in [-4, 4] at z 10
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(-5.0f, 0.0f, 20.0f), 1.0f)) == OcclusionResult::OCCLUDED);
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(-5.0f, 0.0f, 5.0f), 1.0f)) == OcclusionResult::VISIBLE);
+        // Straddles the wall in depth, and peeks out next to it
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(-5.0f, 0.0f, 10.0f), 1.0f)) == OcclusionResult::VISIBLE);
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(1.5f, 0.0f, 20.0f), 1.0f)) == OcclusionResult::VISIBLE);
+        // Behind the camera, beside the view and beyond the far plane
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(0.0f, 0.0f, -10.0f), 1.0f)) != OcclusionResult::OCCLUDED);
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(100.0f, 0.0f, 10.0f), 1.0f)) == OcclusionResult::VIEW_CULLED);
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(0.0f, 0.0f, 300.0f), 1.0f)) == OcclusionResult::VIEW_CULLED);
+        // A box around the camera crosses the near plane
+        CHECK(buffer.testAabb(makeBox(XMFLOAT3(0.0f, 0.0f, 0.0f), 1.0f)) == OcclusionResult::VISIBLE);
+
+        // Without occluders nothing is occluded and the buffer is empty
+        buffer.begin(viewProjection());
+        buffer.buildHierarchy();
+        CHECK(buffer.getOccluderTriangleCount() == 0);
+        CHECK(buffer.getDepth(buffer.getWidth() / 2, buffer.getHeight() / 2) == 1.0f);
+        size_t occluded = 0;
+        for (const Aabb& box : makeBoxes(2000, 3)) {
+            occluded += buffer.testAabb(box) == OcclusionResult::OCCLUDED;
+        }
+        CHECK(occluded == 0);
+    }
+
+    void noFalseOcclusionAndHighCullRate() {
+        for (bool near_box : { false, true }) {
+            const std::vector<Occluder> occluders = makeOccluders(near_box);
+            const std::vector<Triangle> triangles = getTriangles(occluders);
+            OcclusionBuffer buffer;
+            render(buffer, occluders);
+
+            size_t truly_occluded = 0;
+            size_t occluded = 0;
+            size_t false_occlusions = 0;
+            size_t wrongly_view_culled = 0;
+            size_t subpixel = 0;
+            for (const Aabb& box : makeBoxes(10000, 7)) {
+                const OcclusionResult result = buffer.testAabb(box);
+                const Truth truth = sampleBox(triangles, box, buffer.getWidth(), buffer.getHeight());
+                truly_occluded += truth._in_view && !truth._visible;
+                if (result == OcclusionResult::OCCLUDED) {
+                    occluded += !truth._visible;
+                    false_occlusions += truth._clearly_visible;
+                    subpixel += truth._visible && !truth._clearly_visible;
+                }
+                wrongly_view_culled += result == OcclusionResult::VIEW_CULLED && truth._in_view;
+            }
+            // Objects may only disappear where they peek out by less than a pixel
+            if (!CHECK(false_occlusions == 0 && wrongly_view_culled == 0)) {
+                std::fprintf(stderr, "  %s: %zu boxes occluded although seen, %zu view culled although in view\n", near_box ? "near box" : "walls",
+                    false_occlusions, wrongly_view_culled);
+            }
+            const float cull_rate = (float)occluded / truly_occluded;
+            if (!CHECK(truly_occluded > 1000 && cull_rate > 0.9f)) {
+                std::fprintf(stderr, "  %s: %zu of %zu occluded boxes culled\n", near_box ? "near box" : "walls", occluded, truly_occluded);
+            }
+            std::printf("%s: %.1f%% of %zu occluded boxes culled, %zu culled within a pixel of an edge\n", near_box ? "near box" : "walls",
+                100.0f * cull_rate, truly_occluded, subpixel);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "simple cases", simpleCases },
+        { "no false occlusion and high cull rate", noFalseOcclusionAndHighCullRate },
+    });
+}
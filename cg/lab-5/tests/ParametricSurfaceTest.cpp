@@ -0,0 +1,191 @@
+#include "../lab-5/Geometry/GeometryRegistry.h"
+#include "../lab-5/ParametricSurface.h"
+#include "../lab-5/Sphere.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    // What every column of a ring has to be, one float operation per component
+    SimpleVertex referenceVertex(float s, float c, float rho, float y, float n_rho, float n_y) {
+        const float neg_rho = -rho;
+        const float neg_n_rho = -n_rho;
+        return { XMFLOAT3(rho * s, y, neg_rho * c), XMFLOAT3(n_rho * s, n_y, neg_n_rho * c) };
+    }
+
+    bool sameBits(const SimpleVertex& a, const SimpleVertex& b) {
+        return memcmp(&a, &b, sizeof(SimpleVertex)) == 0;
+    }
+
+    // Every edge is walked once in each direction, so the surface is closed and consistently wound
+    bool closedManifold(const std::vector<unsigned>& indices) {
+        std::map<std::pair<unsigned, unsigned>, int> edges;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (size_t k = 0; k < 3; ++k) {
+                ++edges[{ indices[t + k], indices[t + (k + 1) % 3] }];
+            }
+        }
+        for (const auto& edge : edges) {
+            auto reverse = edges.find({ edge.first.second, edge.first.first });
+            if (edge.second != 1 || reverse == edges.end() || reverse->second != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Positions lie on the surface, normals are unit and point away from the closest point of the core
+    // (a circle for the torus, a segment for the capsule), triangles turn the same way
+    template <typename F>
+    void checkSurface(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices, float radius, const F& core) {
+        float worst_radius = 0.0f;
+        float worst_normal = 1.0f;
+        for (const SimpleVertex& vertex : vertices) {
+            const XMVECTOR pos = XMLoadFloat3(&vertex._pos);
+            const XMVECTOR offset = pos - core(pos);
+            worst_radius = std::fmax(worst_radius, std::fabs(XMVectorGetX(XMVector3Length(offset)) - radius));
+            worst_normal = std::fmin(worst_normal, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&vertex._nor), offset)) / radius);
+        }
+        if (!CHECK(worst_radius < 1e-5f * (1.0f + radius) && worst_normal > 0.99999f)) {
+            std::fprintf(stderr, "  off the surface by %g, normal dot %g\n", worst_radius, worst_normal);
+        }
+        size_t outward = 0;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            const XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t]]._pos);
+            const XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t + 1]]._pos);
+            const XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t + 2]]._pos);
+            const XMVECTOR centroid = (p0 + p1 + p2) / 3.0f;
+            outward += XMVectorGetX(XMVector3Dot(XMVector3Cross(p1 - p0, p2 - p0), centroid - core(centroid))) > 0.0f;
+        }
+        CHECK(outward == indices.size() / 3);
+        CHECK(closedManifold(indices));
+    }
+
+    void ringMatchesScalarBitwise() {
+        // Every length from below one SSE block to several blocks and a tail, and parameters with signed zeros
+        const float parameters[][4] = {
+            { 1.0f, 0.0f, 1.0f, 0.0f }, { 0.37f, -0.8f, 0.6f, -0.8f }, { 1e-20f, 3.0f, -0.0f, 1.0f }, { 12345.678f, -0.0f, 0.70710677f, 0.70710677f },
+        };
+        for (size_t count = 1; count <= 19; ++count) {
+            const TrigTable phi = makeTrigTable(count, XM_2PI / count, 0.1f);
+            for (const float* p : parameters) {
+                // One guard vertex past the end must stay untouched
+                std::vector<SimpleVertex> ring(count + 1);
+                memset(ring.data(), 0x5a, sizeof(SimpleVertex) * ring.size());
+                const SimpleVertex guard = ring.back();
+                writeRevolutionRing(phi, p[0], p[1], p[2], p[3], ring.data());
+                size_t mismatches = 0;
+                for (size_t j = 0; j < count; ++j) {
+                    mismatches += !sameBits(ring[j], referenceVertex(phi._sin[j], phi._cos[j], p[0], p[1], p[2], p[3]));
+                }
+                if (!CHECK(mismatches == 0 && sameBits(ring.back(), guard))) {
+                    std::fprintf(stderr, "  ring of %zu, rho %g: %zu columns differ\n", count, p[0], mismatches);
+                }
+            }
+        }
+
+        // The same column comes out the same whether the SSE block or the scalar tail wrote it
+        const TrigTable full = makeTrigTable(23, 0.27f, -1.0f);
+        std::vector<SimpleVertex> full_ring(23);
+        writeRevolutionRing(full, 0.9f, 0.1f, 0.9f, 0.43588989f, full_ring.data());
+        for (size_t count = 1; count < 23; ++count) {
+            TrigTable prefix = full;
+            prefix._sin.resize(count);
+            prefix._cos.resize(count);
+            std::vector<SimpleVertex> ring(count);
+            writeRevolutionRing(prefix, 0.9f, 0.1f, 0.9f, 0.43588989f, ring.data());
+            CHECK(memcmp(ring.data(), full_ring.data(), sizeof(SimpleVertex) * count) == 0);
+        }
+    }
+
+    void tablesDoNotDrift() {
+        // Angles are multiplied out, so the last entry is as exact as a direct call
+        const size_t count = 4096;
+        const float step = XM_2PI / count;
+        const TrigTable table = makeTrigTable(count, step, 0.5f);
+        for (size_t i : { (size_t)0, (size_t)1, count / 2, count - 1 }) {
+            const float angle = 0.5f + (float)i * step;
+            CHECK(table._sin[i] == sinf(angle) && table._cos[i] == cosf(angle));
+            CHECK_NEAR(table._sin[i], sin(0.5 + (double)i * (2.0 * 3.14159265358979323846 / count)), 2e-6);
+        }
+    }
+
+    void generationIsDeterministic() {
+        // Sphere generates through the same kernel, twice the same bits
+        const Sphere a(1.5f, 101, 203, true, true);
+        const Sphere b(1.5f, 101, 203, true, true);
+        CHECK(a.getVertices().size() == uvSphereVertexCount(101, 203));
+        CHECK(memcmp(a.getVertices().data(), b.getVertices().data(), sizeof(SimpleVertex) * a.getVertices().size()) == 0);
+        std::vector<SimpleVertex> direct(uvSphereVertexCount(101, 203));
+        generateUvSphere(1.5f, 101, 203, direct.data());
+        CHECK(memcmp(direct.data(), a.getVertices().data(), sizeof(SimpleVertex) * direct.size()) == 0);
+
+        // The registry generates into the arena, the result is the same as into a vector
+        geometry::GeometryRegistry registry;
+        registry.getQuad();
+        const geometry::MeshHandle torus = registry.getTorus(1.0f, 0.25f, 37, 13);
+        const geometry::MeshHandle capsule = registry.getCapsule(0.5f, 0.75f, 5, 22);
+        const geometry::MeshHandle torus_again = registry.getTorus(1.0f, 0.25f, 37, 13);
+        CHECK(memcmp(&torus_again, &torus, sizeof(torus)) == 0);
+        CHECK(registry.getMeshCount() == 3);
+
+        std::vector<SimpleVertex> vertices(torusVertexCount(37, 13));
+        std::vector<unsigned> indices(torusIndexCount(37, 13));
+        generateTorus(1.0f, 0.25f, 37, 13, vertices.data(), indices.data());
+        CHECK(torus._vertex_count == vertices.size() && torus._index_count == indices.size());
+        CHECK(memcmp(registry.getVertices(torus), vertices.data(), sizeof(SimpleVertex) * vertices.size()) == 0);
+        CHECK(memcmp(registry.getIndices(torus), indices.data(), sizeof(unsigned) * indices.size()) == 0);
+
+        vertices.assign(capsuleVertexCount(5, 22), SimpleVertex());
+        indices.assign(capsuleIndexCount(5, 22), 0);
+        generateCapsule(0.5f, 0.75f, 5, 22, vertices.data(), indices.data());
+        CHECK(memcmp(registry.getVertices(capsule), vertices.data(), sizeof(SimpleVertex) * vertices.size()) == 0);
+        CHECK(memcmp(registry.getIndices(capsule), indices.data(), sizeof(unsigned) * indices.size()) == 0);
+    }
+
+    void torusIsClosed() {
+        for (size_t n : { (size_t)3, (size_t)7, (size_t)64 }) {
+            const float major = 2.0f;
+            const float minor = 0.5f;
+            std::vector<SimpleVertex> vertices(torusVertexCount(n + 5, n));
+            std::vector<unsigned> indices(torusIndexCount(n + 5, n));
+            generateTorus(major, minor, n + 5, n, vertices.data(), indices.data());
+            checkSurface(vertices, indices, minor, [&](FXMVECTOR p) {
+                return XMVector3Normalize(XMVectorSet(XMVectorGetX(p), 0.0f, XMVectorGetZ(p), 0.0f)) * major;
+            });
+        }
+    }
+
+    void capsuleIsClosed() {
+        for (size_t n_cap : { (size_t)1, (size_t)2, (size_t)16 }) {
+            const float radius = 0.5f;
+            const float half_height = 1.25f;
+            std::vector<SimpleVertex> vertices(capsuleVertexCount(n_cap, 3 * n_cap + 3));
+            std::vector<unsigned> indices(capsuleIndexCount(n_cap, 3 * n_cap + 3));
+            generateCapsule(radius, half_height, n_cap, 3 * n_cap + 3, vertices.data(), indices.data());
+            checkSurface(vertices, indices, radius, [&](FXMVECTOR p) {
+                return XMVectorSet(0.0f, std::fmax(-half_height, std::fmin(half_height, XMVectorGetY(p))), 0.0f, 0.0f);
+            });
+            CHECK(vertices.front()._pos.y == radius + half_height && vertices.back()._pos.y == -radius - half_height);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "ring matches scalar bitwise", ringMatchesScalarBitwise },
+        { "tables do not drift", tablesDoNotDrift },
+        { "generation is deterministic", generationIsDeterministic },
+        { "torus is closed", torusIsClosed },
+        { "capsule is closed", capsuleIsClosed },
+    });
+}
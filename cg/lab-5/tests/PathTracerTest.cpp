@@ -0,0 +1,114 @@
+#include "../lab-5/SoftwareRenderer/Environment.h"
+#include "../lab-5/SoftwareRenderer/PathTracer.h"
+
+#include <cmath>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestEnvironment.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+namespace {
+    const size_t WIDTH = 48;
+    const size_t HEIGHT = 36;
+
+    struct Fixture {
+        Texture2D _equirect = test::makeEquirect();
+        EnvironmentMaps _maps = bakeEnvironment(_equirect, test::smallBake());
+    };
+
+    const Fixture& fixture() {
+        static const Fixture instance;
+        return instance;
+    }
+
+    std::vector<SceneState> scenes() {
+        SceneState smooth;
+        SceneState rough_metal;
+        rough_metal._roughness = 0.7f;
+        rough_metal._metalness = 1.0f;
+        return { smooth, rough_metal };
+    }
+
+    // Images after each power of four samples per pixel, up to max_spp
+    std::vector<FrameBuffer> trace(SceneState scene, unsigned max_spp, std::vector<ConvergenceStats>* stats = nullptr) {
+        PathTracer tracer(WIDTH, HEIGHT, fixture()._equirect);
+        tracer.reset(scene);
+        std::vector<FrameBuffer> images;
+        unsigned next_spp = 4;
+        while (tracer.getSamplesPerPixel() < max_spp) {
+            const ConvergenceStats pass = tracer.accumulate();
+            if (tracer.getSamplesPerPixel() == next_spp) {
+                images.push_back(tracer.getImage());
+                if (stats) {
+                    stats->push_back(pass);
+                }
+                next_spp *= 4;
+            }
+        }
+        return images;
+    }
+
+    void approachesRasterizedImage() {
+        for (SceneState scene : scenes()) {
+            SoftwareRenderer raster(WIDTH, HEIGHT, fixture()._maps);
+            raster.render(scene);
+            const std::vector<FrameBuffer> images = trace(scene, 256);
+
+            std::vector<ImageDifference> differences;
+            for (const FrameBuffer& image : images) {
+                differences.push_back(compareImages(raster.getHDR(), image));
+            }
+            // Noise dominates at first and falls until only the bias of the prefiltered approximation is left
+            for (size_t i = 1; i < differences.size(); ++i) {
+                CHECK(differences[i]._rmse <= differences[i - 1]._rmse * 1.01f);
+            }
+            CHECK(differences.back()._rmse < 0.9f * differences.front()._rmse);
+            // That bias is small: the split sum of the raster path agrees with ground truth
+            if (!CHECK(differences.back()._mean_relative_error < 0.05f)) {
+                std::fprintf(stderr, "  roughness %.2f: mean relative error %g\n", scene._roughness, differences.back()._mean_relative_error);
+            }
+        }
+    }
+
+    void noiseFallsWithSampleCount() {
+        for (SceneState scene : scenes()) {
+            std::vector<ConvergenceStats> stats;
+            const std::vector<FrameBuffer> images = trace(scene, 1024, &stats);
+            const FrameBuffer& reference = images.back();
+
+            // Against the 1024 spp image the error of N samples goes as sqrt(1/N - 1/1024), each step of four
+            // samples at least nearly halves it
+            for (size_t i = 1; i + 1 < images.size(); ++i) {
+                const float previous = compareImages(reference, images[i - 1])._rmse;
+                const float current = compareImages(reference, images[i])._rmse;
+                if (!CHECK(current < 0.6f * previous)) {
+                    std::fprintf(stderr, "  roughness %.2f, %zu spp: rmse %g after %g\n", scene._roughness, (size_t)4 << (2 * i), current, previous);
+                }
+            }
+            // The tracer's own estimate of the standard error follows 1/sqrt(N) as well
+            for (size_t i = 1; i < stats.size(); ++i) {
+                const float ratio = stats[i]._mean_relative_error / stats[i - 1]._mean_relative_error;
+                CHECK(ratio > 0.35f && ratio < 0.65f);
+            }
+        }
+    }
+
+    void accumulationIsDeterministic() {
+        SceneState scene;
+        const std::vector<FrameBuffer> first = trace(scene, 16);
+        const std::vector<FrameBuffer> second = trace(scene, 16);
+        CHECK(compareImages(first.back(), second.back())._rmse == 0.0f);
+    }
+}
+
+int main() {
+    return test::run({
+        { "approaches rasterized image", approachesRasterizedImage },
+        { "noise falls with sample count", noiseFallsWithSampleCount },
+        { "accumulation is deterministic", accumulationIsDeterministic },
+    });
+}
@@ -0,0 +1,278 @@
+#include "../lab-5/SoftwareRenderer/Rasterizer.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+namespace {
+    const size_t WIDTH = 128;
+    const size_t HEIGHT = 64;
+
+    // Vertices carry their clip position, _nor.x is w
+    SimpleVertex clipVertex(float x, float y, float z, float w) {
+        return { XMFLOAT3(x, y, z), XMFLOAT3(w, 0.0f, 0.0f) };
+    }
+
+    // Clip position from pixel coordinates at w = 1, exact for the power of two target size
+    SimpleVertex pixelVertex(float x, float y, float z = 0.5f) {
+        return clipVertex(x / WIDTH * 2.0f - 1.0f, 1.0f - y / HEIGHT * 2.0f, z, 1.0f);
+    }
+
+    // Counts how often every pixel is shaded. The clip position is interpolated as well, so the
+    // shader knows its pixel, and since tiles own disjoint pixels the counters need no atomics
+    struct CoverageCounter {
+        FrameBuffer _target = FrameBuffer(WIDTH, HEIGHT);
+        std::vector<int> _counts = std::vector<int>(WIDTH * HEIGHT, 0);
+        // Largest difference between the interpolated NDC position and the pixel center
+        float _max_position_error = 0.0f;
+        RasterStats _stats;
+
+        void draw(const std::vector<SimpleVertex>& vertices, const std::vector<unsigned>& indices) {
+            _target.clear(XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f), 1.0f);
+            std::vector<float> errors(WIDTH * HEIGHT, 0.0f);
+            Rasterizer rasterizer(_target);
+            rasterizer.drawIndexed(vertices, indices, 3,
+                [](const SimpleVertex& v) {
+                    RasterVertex out;
+                    out._position = XMFLOAT4(v._pos.x, v._pos.y, v._pos.z, v._nor.x);
+                    out._varyings[0] = v._pos.x;
+                    out._varyings[1] = v._pos.y;
+                    out._varyings[2] = v._nor.x;
+                    return out;
+                },
+                [&](const float* varyings) {
+                    const float x = (varyings[0] / varyings[2] * 0.5f + 0.5f) * WIDTH;
+                    const float y = (0.5f - varyings[1] / varyings[2] * 0.5f) * HEIGHT;
+                    const int px = std::min(std::max((int)std::floor(x), 0), (int)WIDTH - 1);
+                    const int py = std::min(std::max((int)std::floor(y), 0), (int)HEIGHT - 1);
+                    const size_t pixel = (size_t)py * WIDTH + px;
+                    ++_counts[pixel];
+                    errors[pixel] = std::max(std::fabs(x - (px + 0.5f)), std::fabs(y - (py + 0.5f)));
+                    return XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
+                });
+            _stats = rasterizer.getStats();
+            for (float error : errors) {
+                _max_position_error = std::max(_max_position_error, error);
+            }
+        }
+
+        size_t countCovered() const {
+            size_t covered = 0;
+            for (int count : _counts) {
+                covered += count > 0;
+            }
+            return covered;
+        }
+
+        int maxCount() const {
+            int max_count = 0;
+            for (int count : _counts) {
+                max_count = std::max(max_count, count);
+            }
+            return max_count;
+        }
+    };
+
+    // A grid of quads with jittered inner vertices, two clockwise triangles per quad
+    void makeGrid(size_t n, float x0, float y0, float x1, float y1, float jitter, unsigned seed,
+        std::vector<SimpleVertex>& vertices, std::vector<unsigned>& indices, float z0 = 0.5f, float z1 = 0.5f) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> offset(-jitter, jitter);
+        vertices.clear();
+        indices.clear();
+        for (size_t j = 0; j <= n; ++j) {
+            for (size_t i = 0; i <= n; ++i) {
+                const bool inner = i > 0 && j > 0 && i < n && j < n;
+                const float u = (float)i / n + (inner ? offset(random) / n : 0.0f);
+                const float v = (float)j / n + (inner ? offset(random) / n : 0.0f);
+                vertices.push_back(pixelVertex(x0 + (x1 - x0) * u, y0 + (y1 - y0) * v, z0 + (z1 - z0) * v));
+            }
+        }
+        for (unsigned j = 0; j < n; ++j) {
+            for (unsigned i = 0; i < n; ++i) {
+                const unsigned a = j * (unsigned)(n + 1) + i;
+                const unsigned b = a + 1;
+                const unsigned c = a + (unsigned)(n + 1);
+                const unsigned d = c + 1;
+                // Alternate the diagonal so that both orientations of shared edges show up
+                if ((i + j) % 2) {
+                    indices.insert(indices.end(), { a, b, d, a, d, c });
+                } else {
+                    indices.insert(indices.end(), { a, b, c, b, d, c });
+                }
+            }
+        }
+    }
+
+    // Pixel centers inside [x0, x1) x [y0, y1), the fill rule of an axis aligned rectangle
+    size_t countCenters(float x0, float y0, float x1, float y1) {
+        size_t count = 0;
+        for (size_t y = 0; y < HEIGHT; ++y) {
+            for (size_t x = 0; x < WIDTH; ++x) {
+                count += x + 0.5f >= x0 && x + 0.5f < x1 && y + 0.5f >= y0 && y + 0.5f < y1;
+            }
+        }
+        return count;
+    }
+
+    void sharedEdgesCoverOnce() {
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        for (unsigned seed = 1; seed <= 8; ++seed) {
+            // Fractional bounds keep the outer edges off pixel centers, inner vertices land anywhere
+            makeGrid(12, 10.3f, 7.7f, 117.9f, 57.2f, 0.2f, seed, vertices, indices);
+            CoverageCounter counter;
+            counter.draw(vertices, indices);
+            CHECK(counter.maxCount() == 1);
+            CHECK(counter.countCovered() == countCenters(10.3f, 7.7f, 117.9f, 57.2f));
+            CHECK(counter._stats._pixels == counter.countCovered());
+        }
+    }
+
+    void topLeftRuleOwnsCenters() {
+        // Edges through pixel centers: left and top edges own them, right and bottom ones do not
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        makeGrid(1, 2.5f, 1.5f, 6.5f, 4.5f, 0.0f, 1, vertices, indices);
+        CoverageCounter counter;
+        counter.draw(vertices, indices);
+        CHECK(counter.maxCount() == 1);
+        for (size_t y = 0; y < HEIGHT; ++y) {
+            for (size_t x = 0; x < WIDTH; ++x) {
+                const bool inside = x >= 2 && x <= 5 && y >= 1 && y <= 3;
+                CHECK((counter._counts[y * WIDTH + x] == 1) == inside);
+            }
+        }
+
+        // A fan around a vertex on a pixel center, the center belongs to exactly one triangle
+        const float cx = 20.5f;
+        const float cy = 20.5f;
+        vertices = { pixelVertex(cx, cy) };
+        indices.clear();
+        const size_t segments = 12;
+        for (size_t i = 0; i < segments; ++i) {
+            const float angle = 6.2831853f * i / segments;
+            vertices.push_back(pixelVertex(cx + 8.0f * std::cos(angle), cy + 8.0f * std::sin(angle)));
+        }
+        for (unsigned i = 0; i < segments; ++i) {
+            indices.insert(indices.end(), { 0, 1 + i, 1 + (i + 1) % (unsigned)segments });
+        }
+        counter.draw(vertices, indices);
+        CHECK(counter.maxCount() == 1);
+        CHECK(counter._counts[20 * WIDTH + 20] == 1);
+    }
+
+    void hugeTrianglesCoverTheScreen() {
+        // A single triangle far larger than the screen, and one that is mostly behind the camera
+        const float sizes[] = { 4.0f, 1e3f, 1e6f, 1e9f };
+        for (float size : sizes) {
+            std::vector<SimpleVertex> vertices = { clipVertex(-size, -size, 0.5f, 1.0f), clipVertex(0.0f, size, 0.5f, 1.0f), clipVertex(size, -size, 0.5f, 1.0f) };
+            CoverageCounter counter;
+            counter.draw(vertices, { 0, 1, 2 });
+            CHECK(counter.maxCount() == 1);
+            CHECK(counter.countCovered() == WIDTH * HEIGHT);
+            CHECK(counter._max_position_error < 1e-2f);
+        }
+
+        // The near vertex sits just above w = 0, its projection is astronomically far off screen
+        std::vector<SimpleVertex> vertices = { clipVertex(-1.0f, -1.0f, 0.1f, 1.0f), clipVertex(0.0f, 1e-3f, 1e-6f, 2e-5f), clipVertex(1.0f, -1.0f, 0.1f, 1.0f) };
+        CoverageCounter counter;
+        counter.draw(vertices, { 0, 1, 2 });
+        CHECK(counter.maxCount() == 1);
+        CHECK(counter.countCovered() > 0);
+        CHECK(counter._max_position_error < 1e-2f);
+    }
+
+    void offscreenTrianglesDrawNothing() {
+        std::vector<SimpleVertex> vertices = {
+            clipVertex(2.0f, -1e7f, 0.5f, 1.0f), clipVertex(2.0f, 1e7f, 0.5f, 1.0f), clipVertex(1e7f, 0.0f, 0.5f, 1.0f),
+            clipVertex(-1e8f, 3.0f, 0.5f, 1.0f), clipVertex(0.0f, 1e8f, 0.5f, 1.0f), clipVertex(1e8f, 3.0f, 0.5f, 1.0f),
+        };
+        CoverageCounter counter;
+        counter.draw(vertices, { 0, 1, 2, 3, 4, 5 });
+        CHECK(counter.countCovered() == 0);
+        CHECK(counter._stats._pixels == 0);
+    }
+
+    void nearClippedFloorStaysWatertight() {
+        // A floor grid under a perspective camera that reaches behind it, the near plane cuts the shared
+        // edges right at the bottom of the screen
+        const XMMATRIX view_projection = XMMatrixLookToLH(XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), XMVectorSet(0.1f, -0.35f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+            XMMatrixPerspectiveFovLH(1.2f, (float)WIDTH / HEIGHT, 0.5f, 500.0f);
+        const size_t n = 64;
+        for (unsigned seed = 1; seed <= 4; ++seed) {
+            std::mt19937 random(seed);
+            std::uniform_real_distribution<float> offset(-0.2f, 0.2f);
+            std::vector<SimpleVertex> vertices;
+            std::vector<unsigned> indices;
+            for (size_t j = 0; j <= n; ++j) {
+                for (size_t i = 0; i <= n; ++i) {
+                    const float x = -40.0f + 80.0f * (i + offset(random)) / n;
+                    const float z = -4.0f + 64.0f * (j + offset(random)) / n;
+                    XMFLOAT4 clip;
+                    XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(x, 0.0f, z, 1.0f), view_projection));
+                    vertices.push_back(clipVertex(clip.x, clip.y, clip.z, clip.w));
+                }
+            }
+            // Counter-clockwise in x and z is clockwise on screen seen from above
+            for (unsigned j = 0; j < n; ++j) {
+                for (unsigned i = 0; i < n; ++i) {
+                    const unsigned a = j * (unsigned)(n + 1) + i;
+                    const unsigned b = a + 1;
+                    const unsigned c = a + (unsigned)(n + 1);
+                    const unsigned d = c + 1;
+                    indices.insert(indices.end(), { a, c, b, b, c, d });
+                }
+            }
+            CoverageCounter counter;
+            counter.draw(vertices, indices);
+            CHECK(counter._stats._clipped > 0);
+            CHECK(counter.maxCount() == 1);
+            // The bottom rows see the floor close up, none of them may have holes
+            for (size_t y = HEIGHT / 2 + 8; y < HEIGHT; ++y) {
+                for (size_t x = 0; x < WIDTH; ++x) {
+                    CHECK(counter._counts[y * WIDTH + x] == 1);
+                }
+            }
+        }
+    }
+
+    void clippedMeshStaysWatertight() {
+        // A grid much larger than the screen that also crosses the near plane: every shared edge is cut
+        // by the clipper in both of its triangles, and the pieces still have to meet exactly
+        std::vector<SimpleVertex> vertices;
+        std::vector<unsigned> indices;
+        for (unsigned seed = 1; seed <= 4; ++seed) {
+            makeGrid(24, -40.0f * WIDTH, -40.0f * HEIGHT, 41.0f * WIDTH, 41.0f * HEIGHT, 0.2f, seed, vertices, indices, -0.5f, 0.9f);
+            CoverageCounter counter;
+            counter.draw(vertices, indices);
+            CHECK(counter.maxCount() == 1);
+            // Rows whose depth is in front of the near plane stay empty, every other pixel is covered
+            size_t expected = 0;
+            for (size_t y = 0; y < HEIGHT; ++y) {
+                for (size_t x = 0; x < WIDTH; ++x) {
+                    expected += counter._counts[y * WIDTH + x] == 1;
+                }
+            }
+            CHECK(expected == counter.countCovered());
+            CHECK(counter.countCovered() == WIDTH * HEIGHT);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "shared edges cover once", sharedEdgesCoverOnce },
+        { "top left rule owns centers", topLeftRuleOwnsCenters },
+        { "huge triangles cover the screen", hugeTrianglesCoverTheScreen },
+        { "offscreen triangles draw nothing", offscreenTrianglesDrawNothing },
+        { "near clipped floor stays watertight", nearClippedFloorStaysWatertight },
+        { "clipped mesh stays watertight", clippedMeshStaysWatertight },
+    });
+}
@@ -0,0 +1,141 @@
+#include "../lab-5/ResolutionGovernor.h"
+
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace rendering;
+
+namespace {
+    const float BUDGET_MS = 16.0f;
+    // The governor settles one deadband below the budget
+    const float TARGET_MS = BUDGET_MS * 0.95f;
+
+    // Frame time grows with the shaded area on top of a fixed cost
+    struct LoadModel {
+        float _fixed_ms;
+        float _full_area_ms;
+
+        float frameTime(float scale) const {
+            return _fixed_ms + _full_area_ms * scale * scale;
+        }
+    };
+
+    // Scales of every frame
+    std::vector<float> simulate(ResolutionGovernor& governor, const LoadModel& load, size_t frames, float noise = 0.0f, unsigned seed = 1) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> jitter(-noise, noise);
+        std::vector<float> scales;
+        for (size_t i = 0; i < frames; ++i) {
+            const float frame_ms = load.frameTime(governor.getScale()) * (1.0f + jitter(random));
+            scales.push_back(governor.update(frame_ms));
+        }
+        return scales;
+    }
+
+    size_t countChanges(const std::vector<float>& scales, size_t first) {
+        size_t changes = 0;
+        for (size_t i = first + 1; i < scales.size(); ++i) {
+            changes += scales[i] != scales[i - 1];
+        }
+        return changes;
+    }
+
+    // Changes of direction, a limit cycle shows up as one per half period
+    size_t countReversals(const std::vector<float>& scales, size_t first) {
+        size_t reversals = 0;
+        float previous_step = 0.0f;
+        for (size_t i = first + 1; i < scales.size(); ++i) {
+            const float step = scales[i] - scales[i - 1];
+            if (step == 0.0f) {
+                continue;
+            }
+            reversals += previous_step * step < 0.0f;
+            previous_step = step;
+        }
+        return reversals;
+    }
+
+    void stepLoadSettlesWithinBudget() {
+        ResolutionGovernor governor(BUDGET_MS);
+        const LoadModel light = { 2.0f, 8.0f };
+        const LoadModel heavy = { 2.0f, 30.0f };
+
+        std::vector<float> scales = simulate(governor, light, 200);
+        CHECK(scales.back() == 1.0f);
+
+        scales = simulate(governor, heavy, 600);
+        const float settled_ms = heavy.frameTime(scales.back());
+        CHECK(settled_ms <= BUDGET_MS);
+        CHECK(settled_ms >= BUDGET_MS * 0.85f);
+        CHECK(scales.back() < 1.0f && scales.back() > 0.5f);
+        // A step down, perhaps a small correction back, then it holds
+        CHECK(countReversals(scales, 0) <= 2);
+        CHECK(countChanges(scales, 300) == 0);
+
+        // And back up once the load goes away
+        scales = simulate(governor, light, 600);
+        CHECK(scales.back() == 1.0f);
+        CHECK(countReversals(scales, 0) <= 2);
+    }
+
+    void noisyFeedDoesNotOscillate() {
+        ResolutionGovernor governor(BUDGET_MS);
+        const LoadModel heavy = { 2.0f, 30.0f };
+        const std::vector<float> scales = simulate(governor, heavy, 3000, 0.1f, 7);
+
+        // Noise of +-10% per frame is mostly filtered out, the scale may step now and then but never cycles
+        CHECK(countReversals(scales, 500) <= 4);
+        CHECK(countChanges(scales, 500) <= 8);
+        float min_scale = 1.0f;
+        float max_scale = 0.0f;
+        for (size_t i = 500; i < scales.size(); ++i) {
+            min_scale = std::min(min_scale, scales[i]);
+            max_scale = std::max(max_scale, scales[i]);
+        }
+        CHECK(max_scale - min_scale <= 2.0f / 32.0f);
+        CHECK(heavy.frameTime(max_scale) <= BUDGET_MS * 1.05f);
+    }
+
+    void holdsInsideDeadband() {
+        // Settle first, then feed frame times anywhere inside the deadband around the target
+        ResolutionGovernor governor(BUDGET_MS);
+        const LoadModel heavy = { 2.0f, 30.0f };
+        simulate(governor, heavy, 600);
+        const float settled_scale = governor.getScale();
+
+        std::mt19937 random(3);
+        std::uniform_real_distribution<float> in_band(TARGET_MS - 0.04f * BUDGET_MS, TARGET_MS + 0.04f * BUDGET_MS);
+        for (size_t i = 0; i < 2000; ++i) {
+            governor.update(in_band(random));
+            if (!CHECK(governor.getScale() == settled_scale)) {
+                break;
+            }
+        }
+    }
+
+    void staysWithinLimits() {
+        ResolutionGovernor governor(BUDGET_MS, 0.5f, 1.0f);
+        const std::vector<float> overloaded = simulate(governor, { 10.0f, 100.0f }, 500);
+        CHECK(overloaded.back() == 0.5f);
+        for (float scale : overloaded) {
+            CHECK(scale >= 0.5f && scale <= 1.0f);
+        }
+        // The velocity form has nothing to wind up while pinned, recovery is as quick as from anywhere else
+        const std::vector<float> recovered = simulate(governor, { 1.0f, 4.0f }, 200);
+        CHECK(recovered.back() == 1.0f);
+
+        governor.reset();
+        CHECK(governor.getScale() == 1.0f);
+    }
+}
+
+int main() {
+    return test::run({
+        { "step load settles within budget", stepLoadSettlesWithinBudget },
+        { "noisy feed does not oscillate", noisyFeedDoesNotOscillate },
+        { "holds inside deadband", holdsInsideDeadband },
+        { "stays within limits", staysWithinLimits },
+    });
+}
@@ -0,0 +1,135 @@
+#include "../lab-5/SoftwareRenderer/SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestEnvironment.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::software;
+
+namespace {
+    const size_t WIDTH = 96;
+    const size_t HEIGHT = 72;
+    // The frames of every scene one below the other, as binary PPM. Run with --update to write it again
+    const char* GOLDEN_PATH = "fixtures/golden/SoftwareRenderer.ppm";
+    bool update_golden = false;
+
+    // Fixed cameras and materials: the defaults of Renderer::initScene, a rough gold sphere from the side under the
+    // brightest light preset and a glossy dark one seen from close by and below
+    std::vector<SceneState> scenes() {
+        SceneState initial;
+
+        SceneState gold;
+        gold._camera = Camera(XMVectorSet(1.3f, 0.5f, -1.0f, 0.0f), XMVectorSet(-1.3f, -0.5f, 1.0f, 0.0f));
+        gold._sphere_color_rgb[0] = 1.0f;
+        gold._sphere_color_rgb[1] = 0.8f;
+        gold._sphere_color_rgb[2] = 0.3f;
+        gold._roughness = 0.6f;
+        gold._metalness = 1.0f;
+        gold._lights[0].changeIntensity();
+        gold._lights[0].changeIntensity();
+
+        SceneState glossy;
+        glossy._camera = Camera(XMVectorSet(0.2f, -0.4f, -1.4f, 0.0f), XMVectorSet(-0.2f, 0.4f, 1.4f, 0.0f));
+        glossy._sphere_color_rgb[0] = 0.05f;
+        glossy._sphere_color_rgb[1] = 0.1f;
+        glossy._sphere_color_rgb[2] = 0.3f;
+        glossy._roughness = 0.1f;
+        glossy._metalness = 0.0f;
+        glossy._exposure_scale = 6.0f;
+        return { initial, gold, glossy };
+    }
+
+    // RGB of every scene, alpha is always one
+    std::vector<uint8_t> renderScenes() {
+        const Texture2D equirect = test::makeEquirect();
+        const EnvironmentMaps maps = bakeEnvironment(equirect, test::smallBake());
+        SoftwareRenderer renderer(WIDTH, HEIGHT, maps);
+        std::vector<uint8_t> rgb;
+        for (SceneState scene : scenes()) {
+            renderer.render(scene);
+            const std::vector<uint8_t>& ldr = renderer.getLDR();
+            for (size_t i = 0; i < WIDTH * HEIGHT; ++i) {
+                rgb.insert(rgb.end(), ldr.begin() + 4 * i, ldr.begin() + 4 * i + 3);
+            }
+        }
+        return rgb;
+    }
+
+    bool readPpm(const char* path, size_t& width, size_t& height, std::vector<uint8_t>& rgb) {
+        std::ifstream file(path, std::ios::binary);
+        std::string magic;
+        int max_value = 0;
+        if (!(file >> magic >> width >> height >> max_value) || magic != "P6" || max_value != 255) {
+            return false;
+        }
+        file.get();
+        rgb.resize(width * height * 3);
+        return (bool)file.read((char*)rgb.data(), rgb.size());
+    }
+
+    bool writePpm(const char* path, size_t width, size_t height, const std::vector<uint8_t>& rgb) {
+        std::ofstream file(path, std::ios::binary);
+        file << "P6\n" << width << " " << height << "\n255\n";
+        return (bool)file.write((const char*)rgb.data(), rgb.size());
+    }
+
+    void matchesGoldenImage() {
+        const std::vector<uint8_t> image = renderScenes();
+        const size_t height = HEIGHT * scenes().size();
+        if (update_golden) {
+            CHECK(writePpm(GOLDEN_PATH, WIDTH, height, image));
+            std::printf("wrote %s\n", GOLDEN_PATH);
+            return;
+        }
+        size_t golden_width = 0, golden_height = 0;
+        std::vector<uint8_t> golden;
+        if (!CHECK(readPpm(GOLDEN_PATH, golden_width, golden_height, golden) && golden_width == WIDTH && golden_height == height)) {
+            return;
+        }
+
+        // Compilers may round the shader math differently, which moves a few edge pixels and shifts others by a
+        // level. A change to the shading moves whole regions of a frame by more
+        bool matches = true;
+        for (size_t scene = 0; scene < scenes().size(); ++scene) {
+            size_t far_pixels = 0;
+            double sum = 0.0;
+            for (size_t i = scene * WIDTH * HEIGHT; i < (scene + 1) * WIDTH * HEIGHT; ++i) {
+                int max_difference = 0;
+                for (size_t c = 0; c < 3; ++c) {
+                    const int difference = std::abs((int)image[3 * i + c] - (int)golden[3 * i + c]);
+                    max_difference = std::max(max_difference, difference);
+                    sum += difference;
+                }
+                far_pixels += max_difference > 4;
+            }
+            const double mean = sum / (3.0 * WIDTH * HEIGHT);
+            if (!CHECK(mean < 0.5 && far_pixels <= WIDTH * HEIGHT / 100)) {
+                std::fprintf(stderr, "  scene %zu: mean difference %g levels, %zu pixels off by more than 4\n", scene, mean, far_pixels);
+                matches = false;
+            }
+        }
+        if (!matches) {
+            const std::string actual_path = (std::filesystem::temp_directory_path() / "SoftwareRenderer.actual.ppm").string();
+            if (writePpm(actual_path.c_str(), WIDTH, height, image)) {
+                std::fprintf(stderr, "  wrote %s\n", actual_path.c_str());
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    update_golden = argc > 1 && std::strcmp(argv[1], "--update") == 0;
+    return test::run({
+        { "matches golden image", matchesGoldenImage },
+    });
+}
@@ -0,0 +1,208 @@
+#include "../lab-5/CubeSphere.h"
+#include "../lab-5/Icosphere.h"
+#include "../lab-5/Sphere.h"
+#include "../lab-5/SphereTessellation.h"
+
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestMeshes.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    struct SphereMesh : test::Mesh {
+        float _radius;
+        bool _outer_normals;
+    };
+
+    template <typename T>
+    SphereMesh makeSphereMesh(const std::string& name, float radius, bool outer_normals, const T& tessellation) {
+        return { test::makeMesh(name, tessellation), radius, outer_normals };
+    }
+
+    std::vector<SphereMesh> meshes() {
+        std::vector<SphereMesh> result;
+        for (bool outer_normals : { true, false }) {
+            const std::string side = outer_normals ? " outer" : " inner";
+            result.push_back(makeSphereMesh("uv sphere 3x4" + side, 1.0f, outer_normals, Sphere(1.0f, 3, 4, outer_normals, true)));
+            result.push_back(makeSphereMesh("uv sphere 31x60" + side, 2.0f, outer_normals, Sphere(2.0f, 31, 60, outer_normals, true)));
+            result.push_back(makeSphereMesh("icosphere 0" + side, 1.0f, outer_normals, Icosphere(1.0f, 0, outer_normals)));
+            result.push_back(makeSphereMesh("icosphere 5" + side, 3.0f, outer_normals, Icosphere(3.0f, 5, outer_normals)));
+            result.push_back(makeSphereMesh("cube sphere 1" + side, 1.0f, outer_normals, CubeSphere(1.0f, 1, outer_normals)));
+            result.push_back(makeSphereMesh("cube sphere 24" + side, 0.5f, outer_normals, CubeSphere(0.5f, 24, outer_normals)));
+        }
+        return result;
+    }
+
+    // Seam and pole vertices are duplicated with different attributes, topology goes by position.
+    // Duplicates are computed along different paths, so positions are matched to a tolerance
+    std::vector<unsigned> weldPositions(const SphereMesh& mesh) {
+        std::map<std::array<long long, 3>, unsigned> ids;
+        std::vector<unsigned> welded(mesh._vertices.size());
+        const float cell = 1e-4f * mesh._radius;
+        for (size_t v = 0; v < mesh._vertices.size(); ++v) {
+            const XMFLOAT3& p = mesh._vertices[v]._pos;
+            const std::array<long long, 3> key = { std::llround(p.x / cell), std::llround(p.y / cell), std::llround(p.z / cell) };
+            welded[v] = ids.emplace(key, (unsigned)ids.size()).first->second;
+        }
+        return welded;
+    }
+
+    void checkMesh(const std::function<bool(const SphereMesh&)>& check) {
+        for (const SphereMesh& mesh : meshes()) {
+            if (!check(mesh)) {
+                std::fprintf(stderr, "  %s\n", mesh._name.c_str());
+            }
+        }
+    }
+
+    // Every directed edge has exactly one opposite: closed, manifold and consistently wound, and with V - E + F = 2
+    // a topological sphere. Triangles that collapse to a point or an edge would break both
+    void watertight() {
+        checkMesh([](const SphereMesh& mesh) {
+            const std::vector<unsigned> welded = weldPositions(mesh);
+            std::map<std::pair<unsigned, unsigned>, int> edges;
+            bool ok = mesh._indices.size() % 3 == 0;
+            for (size_t t = 0; t < mesh._indices.size() / 3; ++t) {
+                for (size_t k = 0; k < 3; ++k) {
+                    const unsigned a = welded[mesh._indices[3 * t + k]];
+                    const unsigned b = welded[mesh._indices[3 * t + (k + 1) % 3]];
+                    ok &= CHECK(a != b);
+                    ++edges[{ a, b }];
+                }
+            }
+            for (const auto& edge : edges) {
+                ok &= CHECK(edge.second == 1);
+                const auto opposite = edges.find({ edge.first.second, edge.first.first });
+                ok &= CHECK(opposite != edges.end() && opposite->second == 1);
+            }
+            size_t vertex_count = 0;
+            for (unsigned id : welded) {
+                vertex_count = std::max<size_t>(vertex_count, id + 1);
+            }
+            const long long euler = (long long)vertex_count - (long long)edges.size() / 2 + (long long)mesh._indices.size() / 3;
+            ok &= CHECK(euler == 2);
+            return ok;
+        });
+    }
+
+    void orientedAsRequested() {
+        checkMesh([](const SphereMesh& mesh) {
+            bool ok = true;
+            for (size_t t = 0; t < mesh._indices.size() / 3; ++t) {
+                const XMVECTOR p0 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t]]._pos);
+                const XMVECTOR p1 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 1]]._pos);
+                const XMVECTOR p2 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 2]]._pos);
+                const float facing = XMVectorGetX(XMVector3Dot(XMVector3Cross(p1 - p0, p2 - p0), p0 + p1 + p2));
+                ok &= CHECK(mesh._outer_normals ? facing > 0.0f : facing < 0.0f);
+            }
+            return ok;
+        });
+    }
+
+    // Vertices lie on the sphere and the normals point radially outwards. outer_normals only picks the
+    // winding, as in Sphere, which the sky sphere relies on
+    void verticesOnSphere() {
+        checkMesh([](const SphereMesh& mesh) {
+            bool ok = true;
+            for (const SimpleVertex& vertex : mesh._vertices) {
+                const XMVECTOR p = XMLoadFloat3(&vertex._pos);
+                const XMVECTOR n = XMLoadFloat3(&vertex._nor);
+                ok &= CHECK_NEAR(XMVectorGetX(XMVector3Length(p)), mesh._radius, 1e-5f * mesh._radius);
+                ok &= CHECK_NEAR(XMVectorGetX(XMVector3Length(n)), 1.0f, 1e-5f);
+                ok &= CHECK(XMVectorGetX(XMVector3Length(n - XMVector3Normalize(p))) < 1e-4f);
+            }
+            return ok;
+        });
+    }
+
+    // The chord error falls with the resolution, fromMaxError meets the bound with the fewest triangles that do
+    void errorBoundIsTight() {
+        const float radius = 2.0f;
+        for (float max_error : { 0.05f, 1e-2f, 1e-3f, 2e-4f }) {
+            const Icosphere icosphere = Icosphere::fromMaxError(radius, max_error, true);
+            CHECK(sphereChordError(icosphere.getVertices(), icosphere.getIndices(), radius) <= max_error);
+            if (icosphere.getSubdivisions() > 0) {
+                const Icosphere coarser(radius, icosphere.getSubdivisions() - 1, true);
+                CHECK(sphereChordError(coarser.getVertices(), coarser.getIndices(), radius) > max_error);
+            }
+
+            const CubeSphere cube_sphere = CubeSphere::fromMaxError(radius, max_error, true);
+            CHECK(sphereChordError(cube_sphere.getVertices(), cube_sphere.getIndices(), radius) <= max_error);
+            if (cube_sphere.getResolution() > 1) {
+                const CubeSphere coarser(radius, cube_sphere.getResolution() - 1, true);
+                CHECK(sphereChordError(coarser.getVertices(), coarser.getIndices(), radius) > max_error);
+            }
+
+            const Sphere sphere = Sphere::fromMaxError(radius, max_error, true, true);
+            CHECK(sphereChordError(sphere.getVertices(), sphere.getIndices(), radius) <= max_error);
+        }
+
+        // The chord error of a great circle split into n segments is r (1 - cos(pi / n)), it bounds the
+        // triangles of a regular tessellation from below and the chord error function sees it
+        float previous = radius;
+        for (size_t resolution = 1; resolution <= 64; resolution *= 2) {
+            const CubeSphere sphere(radius, resolution, true);
+            const float error = sphereChordError(sphere.getVertices(), sphere.getIndices(), radius);
+            CHECK(error < previous);
+            CHECK(error >= radius * (1.0f - std::cos(XM_PI / (4.0f * resolution))) * 0.99f);
+            previous = error;
+        }
+    }
+
+    // The counts quoted when the generators were added, UV / ico / cube on a unit sphere. The icosphere can
+    // only quadruple between levels, so it lands on either side of the other two
+    void triangleCountsAtEqualError() {
+        const struct {
+            float _max_error;
+            size_t _uv, _ico, _cube;
+        } expected[] = {
+            { 1e-2f, 960, 1280, 1200 },
+            { 1e-3f, 9800, 20480, 13068 },
+            { 1e-4f, 99224, 81920, 132300 },
+        };
+        for (const auto& row : expected) {
+            const size_t uv = Sphere::fromMaxError(1.0f, row._max_error, true, true).getIndices().size() / 3;
+            const size_t ico = Icosphere::fromMaxError(1.0f, row._max_error, true).getIndices().size() / 3;
+            const size_t cube = CubeSphere::fromMaxError(1.0f, row._max_error, true).getIndices().size() / 3;
+            if (!CHECK(uv == row._uv && ico == row._ico && cube == row._cube)) {
+                std::fprintf(stderr, "  %g: %zu / %zu / %zu\n", row._max_error, uv, ico, cube);
+            }
+        }
+    }
+
+    void orientFixesWinding() {
+        const Icosphere icosphere(1.0f, 2, true);
+        std::vector<unsigned> indices = icosphere.getIndices();
+        for (size_t t = 0; t < indices.size() / 3; t += 2) {
+            std::swap(indices[3 * t + 1], indices[3 * t + 2]);
+        }
+        std::vector<unsigned> outer = indices;
+        orientSphereTriangles(icosphere.getVertices(), outer, true);
+        CHECK(outer == icosphere.getIndices());
+
+        std::vector<unsigned> inner = indices;
+        orientSphereTriangles(icosphere.getVertices(), inner, false);
+        for (size_t t = 0; t < inner.size() / 3; ++t) {
+            CHECK(inner[3 * t] == outer[3 * t] && inner[3 * t + 1] == outer[3 * t + 2] && inner[3 * t + 2] == outer[3 * t + 1]);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "watertight", watertight },
+        { "oriented as requested", orientedAsRequested },
+        { "vertices on sphere", verticesOnSphere },
+        { "error bound is tight", errorBoundIsTight },
+        { "triangle counts at equal error", triangleCountsAtEqualError },
+        { "orient fixes winding", orientFixesWinding },
+    });
+}
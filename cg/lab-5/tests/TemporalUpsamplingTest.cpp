@@ -0,0 +1,188 @@
+#include "../lab-5/TemporalUpsampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+
+namespace {
+    const size_t WIDTH = 32;
+    const size_t HEIGHT = 4;
+    const float CURRENT_WEIGHT = 0.1f;
+
+    // Scene as a function of the unjittered pixel x coordinate, constant along y
+    using Scene = std::function<float(float)>;
+
+    struct Sequence {
+        TemporalImage _history = TemporalImage(WIDTH, HEIGHT);
+        std::vector<float> _depth = std::vector<float>(WIDTH * HEIGHT, 0.5f);
+        unsigned _frame = 0;
+        // Camera pan in pixels, the view projection of frame n moves the screen by -_pan pixels
+        float _pan = 0.0f;
+        bool _has_history = false;
+
+        TemporalImage render(const Scene& scene, const XMFLOAT2& jitter) const {
+            TemporalImage image(WIDTH, HEIGHT);
+            for (size_t y = 0; y < HEIGHT; ++y) {
+                for (size_t x = 0; x < WIDTH; ++x) {
+                    // The jittered projection moves the scene by +jitter pixels
+                    const float value = scene(x + 0.5f - jitter.x);
+                    image._texels[y * WIDTH + x] = XMFLOAT4(value, value, value, 1.0f);
+                }
+            }
+            return image;
+        }
+
+        // Resolves one frame, the camera moved by pan_step pixels since the previous one
+        TemporalImage step(const Scene& scene, float pan_step, float current_weight = CURRENT_WEIGHT) {
+            const XMFLOAT2 jitter = temporalJitter(_frame++);
+            const TemporalImage current = render(scene, jitter);
+            TemporalResolveParams params;
+            const float ndc_step = 2.0f / WIDTH;
+            params._inv_view_projection = XMMatrixTranslation(_pan * ndc_step, 0.0f, 0.0f);
+            params._prev_view_projection = XMMatrixTranslation(-(_pan - pan_step) * ndc_step, 0.0f, 0.0f);
+            params._jitter_uv = XMFLOAT2(jitter.x / WIDTH, jitter.y / HEIGHT);
+            params._uv_scale = XMFLOAT2(1.0f, 1.0f);
+            params._current_weight = _has_history ? current_weight : 1.0f;
+
+            TemporalImage output(WIDTH, HEIGHT);
+            resolveTemporal(current, _depth, _history, params, output);
+            _history = output;
+            _has_history = true;
+            return output;
+        }
+    };
+
+    float value(const TemporalImage& image, size_t x) {
+        return image._texels[x].x;
+    }
+
+    Scene edgeAt(float edge) {
+        return [edge](float x) { return x < edge ? 0.0f : 1.0f; };
+    }
+
+    void staticEdgeIsAntialiased() {
+        Sequence sequence;
+        const float edge = 10.3f;
+        TemporalImage output;
+        std::vector<float> edge_values;
+        for (size_t frame = 0; frame < 64; ++frame) {
+            output = sequence.step(edgeAt(edge), 0.0f);
+            edge_values.push_back(value(output, 10));
+        }
+        // Away from the edge every sample agrees
+        for (size_t x = 0; x < WIDTH; ++x) {
+            if (x < 9 || x > 11) {
+                CHECK(value(output, x) == (x < 10 ? 0.0f : 1.0f));
+            }
+        }
+        // The edge pixel holds the average over the jitter cycle, and it stays put
+        CHECK(value(output, 10) > 0.3f && value(output, 10) < 0.95f);
+        for (size_t frame = 32; frame < edge_values.size(); ++frame) {
+            CHECK(std::fabs(edge_values[frame] - edge_values[frame - 1]) < 0.1f);
+        }
+        // Monotonic across the edge
+        for (size_t x = 1; x < WIDTH; ++x) {
+            CHECK(value(output, x) >= value(output, x - 1));
+        }
+    }
+
+    void checkNoTrail(const TemporalImage& output, float screen_edge) {
+        for (size_t x = 0; x < WIDTH; ++x) {
+            const float v = value(output, x);
+            CHECK(v >= 0.0f && v <= 1.0f);
+            // Nothing of an old edge position survives more than a pixel away from the new one
+            if (x + 2.0f < screen_edge || x > screen_edge + 1.0f) {
+                CHECK(v == (x < screen_edge ? 0.0f : 1.0f));
+            }
+        }
+    }
+
+    void movingEdgeLeavesNoTrail() {
+        const float edge = 20.3f;
+        Sequence sequence;
+        for (size_t frame = 0; frame < 32; ++frame) {
+            sequence.step(edgeAt(edge), 0.0f);
+        }
+        Sequence object_motion = sequence;
+
+        // The camera pans one pixel per frame, the edge moves left across the screen and reprojection follows it
+        for (size_t frame = 1; frame <= 12; ++frame) {
+            sequence._pan += 1.0f;
+            const float screen_edge = edge - sequence._pan;
+            checkNoTrail(sequence.step(edgeAt(screen_edge), 1.0f), screen_edge);
+        }
+        // The edge itself moves under a still camera. Reprojection has no motion vectors for that,
+        // the neighbourhood clamp has to reject the stale history
+        for (size_t frame = 1; frame <= 8; ++frame) {
+            const float screen_edge = edge - 1.5f * frame;
+            checkNoTrail(object_motion.step(edgeAt(screen_edge), 0.0f), screen_edge);
+        }
+    }
+
+    void disocclusionTakesCurrentColors() {
+        // A bright bar moves right over a gradient, the pixels it uncovers have white history
+        // that reprojection (camera only) puts right where the background now shows
+        const float gradient_step = 0.02f;
+        auto scene = [gradient_step](float bar_begin) {
+            return [=](float x) {
+                return x >= bar_begin && x < bar_begin + 6.0f ? 1.0f : 0.1f + gradient_step * x;
+            };
+        };
+        Sequence sequence;
+        for (size_t frame = 0; frame < 32; ++frame) {
+            sequence.step(scene(4.0f), 0.0f);
+        }
+        for (size_t frame = 1; frame <= 8; ++frame) {
+            const float bar_begin = 4.0f + 2.0f * frame;
+            const TemporalImage output = sequence.step(scene(bar_begin), 0.0f);
+            // Uncovered pixels, one pixel clear of the bar, must not keep any of its brightness. History is clamped
+            // to the 3x3 neighbourhood, which only spans a couple of gradient steps (and one of jitter) there
+            for (size_t x = 1; x + 2.0f < bar_begin; ++x) {
+                const float background = 0.1f + gradient_step * (x + 0.5f);
+                CHECK(std::fabs(value(output, x) - background) <= 2.0f * gradient_step);
+            }
+        }
+    }
+
+    void revealedPixelsUseCurrentFrame() {
+        // Pixels the previous frame did not see reproject outside the history and take the current frame as is
+        auto scene = [](float x) { return 0.5f + 0.4f * std::sin(x * 0.7f); };
+        Sequence sequence;
+        for (size_t frame = 0; frame < 16; ++frame) {
+            sequence.step(scene, 0.0f);
+        }
+        Sequence current_only = sequence;
+
+        sequence._pan += 2.0f;
+        current_only._pan += 2.0f;
+        const TemporalImage output = sequence.step([&](float x) { return scene(x + 2.0f); }, 2.0f);
+        const TemporalImage reference = current_only.step([&](float x) { return scene(x + 2.0f); }, 2.0f, 1.0f);
+        // Moving by 2 pixels to the right reveals the last two columns
+        for (size_t y = 0; y < HEIGHT; ++y) {
+            for (size_t x = WIDTH - 2; x < WIDTH; ++x) {
+                CHECK(output._texels[y * WIDTH + x].x == reference._texels[y * WIDTH + x].x);
+            }
+        }
+        // While the rest does blend in the history
+        bool blended = false;
+        for (size_t x = 0; x + 2 < WIDTH; ++x) {
+            blended |= output._texels[x].x != reference._texels[x].x;
+        }
+        CHECK(blended);
+    }
+}
+
+int main() {
+    return test::run({
+        { "static edge is antialiased", staticEdgeIsAntialiased },
+        { "moving edge leaves no trail", movingEdgeLeavesNoTrail },
+        { "disocclusion takes current colors", disocclusionTakesCurrentColors },
+        { "revealed pixels use current frame", revealedPixelsUseCurrentFrame },
+    });
+}
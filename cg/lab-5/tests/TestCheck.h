@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+
+// Minimal checks for the test executables: a failed check is reported and counted, the test goes on,
+// the process exits with 1 when anything failed
+namespace test {
+    inline int& failureCount() {
+        static int count = 0;
+        return count;
+    }
+
+    inline bool check(bool passed, const char* expression, const char* file, int line) {
+        if (!passed) {
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+            ++failureCount();
+        }
+        return passed;
+    }
+
+    inline bool checkNear(double a, double b, double tolerance, const char* expression, const char* file, int line) {
+        const bool passed = std::fabs(a - b) <= tolerance;
+        if (!passed) {
+            std::fprintf(stderr, "%s:%d: check failed: %s (%g vs %g, tolerance %g)\n", file, line, expression, a, b, tolerance);
+            ++failureCount();
+        }
+        return passed;
+    }
+
+    struct TestCase {
+        const char* _name;
+        void (*_run)();
+    };
+
+    inline int run(std::initializer_list<TestCase> cases) {
+        for (const TestCase& test_case : cases) {
+            const int failures = failureCount();
+            test_case._run();
+            std::printf("%s %s\n", failureCount() == failures ? "[ ok ]" : "[FAIL]", test_case._name);
+        }
+        return failureCount() == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(expression) ::test::check((expression), #expression, __FILE__, __LINE__)
+#define CHECK_NEAR(a, b, tolerance) ::test::checkNear((a), (b), (tolerance), #a " ~ " #b, __FILE__, __LINE__)
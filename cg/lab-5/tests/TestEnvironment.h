@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../lab-5/SoftwareRenderer/Environment.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Synthetic environment for the software renderer tests, small enough to bake in a fraction of a second
+namespace test {
+    // Smooth sky brighter towards the zenith with one soft sun, so the bake and the path tracer see the same light
+    inline rendering::software::Texture2D makeEquirect() {
+        rendering::software::Texture2D equirect(64, 32);
+        for (size_t y = 0; y < equirect.getHeight(); ++y) {
+            for (size_t x = 0; x < equirect.getWidth(); ++x) {
+                const float u = (x + 0.5f) / equirect.getWidth();
+                const float v = (y + 0.5f) / equirect.getHeight();
+                const float sky = 0.2f + 0.8f * std::max(0.0f, 1.0f - 2.0f * v);
+                const float sun = std::exp(-64.0f * ((u - 0.3f) * (u - 0.3f) + (v - 0.3f) * (v - 0.3f)));
+                equirect.at(x, y) = DirectX::XMFLOAT4(0.6f * sky + 2.0f * sun, 0.7f * sky + 1.8f * sun, sky + 1.5f * sun, 1.0f);
+            }
+        }
+        return equirect;
+    }
+
+    // A fraction of the default bake, the rasterized image is still within a few percent of the converged one
+    inline rendering::software::EnvironmentBakeDesc smallBake() {
+        rendering::software::EnvironmentBakeDesc desc;
+        desc._sky_size = 64;
+        desc._sky_mip_levels = 7;
+        desc._irradiance_size = 16;
+        desc._irradiance_n1 = 64;
+        desc._irradiance_n2 = 16;
+        desc._prefiltered_size = 32;
+        desc._prefiltered_mip_levels = 5;
+        desc._prefiltered_samples = 256;
+        desc._preintegrated_size = 32;
+        desc._preintegrated_samples = 256;
+        return desc;
+    }
+}
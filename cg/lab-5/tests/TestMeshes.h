@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../lab-5/Icosphere.h"
+#include "../lab-5/ParametricSurface.h"
+#include "../lab-5/Sphere.h"
+
+#include <string>
+#include <vector>
+
+// Indexed meshes for the geometry tests, built from the same tessellations the renderer draws
+namespace test {
+    struct Mesh {
+        std::string _name;
+        std::vector<rendering::SimpleVertex> _vertices;
+        std::vector<unsigned> _indices;
+    };
+
+    // Copies the buffers of a Sphere, Icosphere or CubeSphere
+    template <typename T>
+    Mesh makeMesh(const std::string& name, const T& tessellation) {
+        return { name, tessellation.getVertices(), tessellation.getIndices() };
+    }
+
+    inline Mesh makeUvSphere(size_t n_theta, size_t n_phi, bool outer_normals = true) {
+        return makeMesh(outer_normals ? "uv sphere" : "sky sphere", rendering::Sphere(1.0f, n_theta, n_phi, outer_normals, true));
+    }
+
+    inline Mesh makeIcosphere(size_t subdivisions) {
+        return makeMesh("icosphere", rendering::Icosphere(1.0f, subdivisions, true));
+    }
+
+    // Not convex and of genus one, unlike every sphere
+    inline Mesh makeTorus(size_t n_major, size_t n_minor, float major_radius = 1.0f, float minor_radius = 0.3f) {
+        Mesh mesh;
+        mesh._name = "torus";
+        mesh._vertices.resize(rendering::torusVertexCount(n_major, n_minor));
+        mesh._indices.resize(rendering::torusIndexCount(n_major, n_minor));
+        rendering::generateTorus(major_radius, minor_radius, n_major, n_minor, mesh._vertices.data(), mesh._indices.data());
+        return mesh;
+    }
+}
@@ -0,0 +1,234 @@
+#include "../lab-5/Scene/TransformHierarchy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering::scene;
+
+namespace {
+    // Scales stay near one so that deep chains neither blow up nor vanish
+    Transform randomTransform(std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+        Transform transform;
+        transform._translation = XMFLOAT3(position(random), position(random), position(random));
+        XMStoreFloat4(&transform._rotation, XMVector4Normalize(XMVectorSet(position(random), position(random), position(random), position(random))));
+        transform._scale = XMFLOAT3(scale(random), scale(random), scale(random));
+        return transform;
+    }
+
+    // The nodes as they were added, the reference walks up the parents for every node
+    struct Nodes {
+        std::vector<TransformHandle> _parents;
+        std::vector<Transform> _locals;
+
+        TransformHandle add(TransformHierarchy& hierarchy, const Transform& local, TransformHandle parent) {
+            _parents.push_back(parent);
+            _locals.push_back(local);
+            return hierarchy.add(local, parent);
+        }
+
+        XMMATRIX getWorld(TransformHandle node) const {
+            const Transform& t = _locals[node];
+            const XMMATRIX local = XMMatrixScaling(t._scale.x, t._scale.y, t._scale.z) * XMMatrixRotationQuaternion(XMLoadFloat4(&t._rotation))
+                * XMMatrixTranslation(t._translation.x, t._translation.y, t._translation.z);
+            return _parents[node] == NO_TRANSFORM ? local : local * getWorld(_parents[node]);
+        }
+
+        bool isBelow(TransformHandle node, TransformHandle ancestor) const {
+            for (; node != NO_TRANSFORM; node = _parents[node]) {
+                if (node == ancestor) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // Largest difference relative to the size of the reference entry
+    float matrixError(FXMMATRIX a, CXMMATRIX b) {
+        XMFLOAT4X4 x, y;
+        XMStoreFloat4x4(&x, a);
+        XMStoreFloat4x4(&y, b);
+        float error = 0.0f;
+        for (int r = 0; r < 4; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                error = std::max(error, std::fabs(x.m[r][c] - y.m[r][c]) / (1.0f + std::fabs(y.m[r][c])));
+            }
+        }
+        return error;
+    }
+
+    bool sameBits(FXMMATRIX a, CXMMATRIX b) {
+        XMFLOAT4X4 x, y;
+        XMStoreFloat4x4(&x, a);
+        XMStoreFloat4x4(&y, b);
+        return std::memcmp(&x, &y, sizeof(x)) == 0;
+    }
+
+    // World and normal matrices of every node against the recursive reference
+    float hierarchyError(const TransformHierarchy& hierarchy, const Nodes& nodes) {
+        float error = 0.0f;
+        for (TransformHandle node = 0; node < nodes._parents.size(); ++node) {
+            const XMMATRIX world = nodes.getWorld(node);
+            XMMATRIX normal = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+            normal.r[0] = XMVectorSetW(normal.r[0], 0.0f);
+            normal.r[1] = XMVectorSetW(normal.r[1], 0.0f);
+            normal.r[2] = XMVectorSetW(normal.r[2], 0.0f);
+            normal.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+            error = std::max(error, std::max(matrixError(hierarchy.getWorld(node), world), matrixError(hierarchy.getNormal(node), normal)));
+        }
+        return error;
+    }
+
+    // Random forests: a few roots, every other node below one of the eight nodes added just before it
+    void buildForest(TransformHierarchy& hierarchy, Nodes& nodes, size_t count, std::mt19937& random) {
+        std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+        for (size_t i = 0; i < count; ++i) {
+            TransformHandle parent = NO_TRANSFORM;
+            if (i > 0 && chance(random) >= 0.05f) {
+                parent = (TransformHandle)std::uniform_int_distribution<size_t>(i > 8 ? i - 8 : 0, i - 1)(random);
+            }
+            nodes.add(hierarchy, randomTransform(random), parent);
+        }
+    }
+
+    const float TOLERANCE = 1e-4f;
+
+    void worldMatchesRecursiveReference() {
+        std::mt19937 random(1);
+        for (size_t count : { (size_t)1, (size_t)3, (size_t)4, (size_t)5, (size_t)7, (size_t)100, (size_t)20000 }) {
+            TransformHierarchy hierarchy;
+            Nodes nodes;
+            buildForest(hierarchy, nodes, count, random);
+            CHECK(hierarchy.update() == count);
+            const float error = hierarchyError(hierarchy, nodes);
+            if (!CHECK(error < TOLERANCE)) {
+                std::fprintf(stderr, "  %zu nodes in %zu depths: error %g\n", count, hierarchy.getDepthCount(), error);
+            }
+        }
+
+        // A chain 200 deep, and a tree whose lower depths are wide enough to be split across threads
+        TransformHierarchy chain;
+        Nodes chain_nodes;
+        for (size_t i = 0; i < 200; ++i) {
+            chain_nodes.add(chain, randomTransform(random), i == 0 ? NO_TRANSFORM : (TransformHandle)(i - 1));
+        }
+        chain.update();
+        CHECK(chain.getDepthCount() == 200);
+        CHECK(hierarchyError(chain, chain_nodes) < TOLERANCE);
+
+        TransformHierarchy wide;
+        Nodes wide_nodes;
+        for (size_t i = 0; i < 50000; ++i) {
+            wide_nodes.add(wide, randomTransform(random), i < 8 ? NO_TRANSFORM : (TransformHandle)(i / 8 - 1));
+        }
+        CHECK(wide.update() == 50000);
+        CHECK(hierarchyError(wide, wide_nodes) < TOLERANCE);
+    }
+
+    void updateOnlyRecomputesChangedNodes() {
+        std::mt19937 random(2);
+        TransformHierarchy hierarchy;
+        Nodes nodes;
+        buildForest(hierarchy, nodes, 5000, random);
+        hierarchy.update();
+        CHECK(hierarchy.update() == 0);
+
+        for (int round = 0; round < 5; ++round) {
+            std::vector<TransformHandle> changed;
+            for (int k = 0; k < 5; ++k) {
+                const TransformHandle node = (TransformHandle)(random() % nodes._parents.size());
+                nodes._locals[node] = randomTransform(random);
+                hierarchy.setLocal(node, nodes._locals[node]);
+                changed.push_back(node);
+            }
+            // A node added after an update sorts the nodes again
+            if (round == 3) {
+                nodes.add(hierarchy, randomTransform(random), (TransformHandle)(random() % nodes._parents.size()));
+            }
+
+            size_t expected = 0;
+            for (TransformHandle node = 0; node < nodes._parents.size(); ++node) {
+                expected += std::any_of(changed.begin(), changed.end(), [&](TransformHandle c) {
+                    return nodes.isBelow(node, c);
+                });
+            }
+            const size_t updated = hierarchy.update();
+            if (!CHECK(updated == (round == 3 ? nodes._parents.size() : expected))) {
+                std::fprintf(stderr, "  round %d: %zu updated, %zu changed\n", round, updated, expected);
+            }
+            CHECK(hierarchyError(hierarchy, nodes) < TOLERANCE);
+            CHECK(hierarchy.update() == 0);
+
+            // Untouched nodes keep their matrices, so a partial update equals a full one
+            TransformHierarchy fresh;
+            for (TransformHandle node = 0; node < nodes._parents.size(); ++node) {
+                fresh.add(nodes._locals[node], nodes._parents[node]);
+            }
+            fresh.update();
+            size_t different = 0;
+            for (TransformHandle node = 0; node < nodes._parents.size(); ++node) {
+                different += !sameBits(hierarchy.getWorld(node), fresh.getWorld(node)) || !sameBits(hierarchy.getNormal(node), fresh.getNormal(node));
+            }
+            CHECK(different == 0);
+        }
+
+        // A node set twice is recomputed once, and can be set again after the update
+        const TransformHandle root = 0;
+        size_t below = 0;
+        for (TransformHandle node = 0; node < nodes._parents.size(); ++node) {
+            below += nodes.isBelow(node, root);
+        }
+        for (int round = 0; round < 2; ++round) {
+            hierarchy.setLocal(root, nodes._locals[root]);
+            hierarchy.setLocal(root, nodes._locals[root]);
+            CHECK(hierarchy.update() == below);
+        }
+    }
+
+    void sseAndScalarAgreeBitwise() {
+        // Four roots are one SSE block, three are left to the scalar tail
+        std::mt19937 random(3);
+        std::vector<Transform> locals;
+        for (int i = 0; i < 4; ++i) {
+            locals.push_back(randomTransform(random));
+        }
+        TransformHierarchy block;
+        TransformHierarchy tail;
+        for (int i = 0; i < 4; ++i) {
+            block.add(locals[i]);
+            if (i < 3) {
+                tail.add(locals[i]);
+            }
+        }
+        // Children of the first root go the same two ways one depth below
+        for (int i = 0; i < 4; ++i) {
+            block.add(locals[3 - i], 0);
+            if (i < 3) {
+                tail.add(locals[3 - i], 0);
+            }
+        }
+        block.update();
+        tail.update();
+        for (TransformHandle node : { 0u, 1u, 2u }) {
+            CHECK(sameBits(block.getWorld(node), tail.getWorld(node)) && sameBits(block.getNormal(node), tail.getNormal(node)));
+            CHECK(sameBits(block.getWorld(node + 4), tail.getWorld(node + 3)) && sameBits(block.getNormal(node + 4), tail.getNormal(node + 3)));
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "world matches recursive reference", worldMatchesRecursiveReference },
+        { "update only recomputes changed nodes", updateOnlyRecomputesChangedNodes },
+        { "sse and scalar agree bitwise", sseAndScalarAgreeBitwise },
+    });
+}
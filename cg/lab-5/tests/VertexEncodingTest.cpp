@@ -0,0 +1,171 @@
+#include "../lab-5/Geometry/VertexEncoding.h"
+#include "../lab-5/Sphere.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+
+namespace {
+    // Half a quantization step of 16 bit octahedral normals is about 0.0035 degrees
+    const float MAX_NORMAL_ERROR_DEGREES = 0.005f;
+
+    float angleDegrees(const XMFLOAT3& a, const XMFLOAT3& b) {
+        const XMVECTOR u = XMVector3Normalize(XMLoadFloat3(&a));
+        const XMVECTOR v = XMVector3Normalize(XMLoadFloat3(&b));
+        return XMConvertToDegrees(atan2f(XMVectorGetX(XMVector3Length(XMVector3Cross(u, v))), XMVectorGetX(XMVector3Dot(u, v))));
+    }
+
+    std::vector<SimpleVertex> randomVertices(size_t count, float position_range, unsigned seed) {
+        std::mt19937 random(seed);
+        std::normal_distribution<float> gaussian;
+        std::uniform_real_distribution<float> uniform(-position_range, position_range);
+        std::vector<SimpleVertex> vertices(count);
+        for (SimpleVertex& vertex : vertices) {
+            vertex._pos = XMFLOAT3(uniform(random), uniform(random), 0.25f * uniform(random));
+            XMStoreFloat3(&vertex._nor, XMVector3Normalize(XMVectorSet(gaussian(random), gaussian(random), gaussian(random), 0.0f)));
+        }
+        // The axes and the octahedron folds, where the sign handling matters
+        const XMFLOAT3 special[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+            { 0.7071068f, 0.7071068f, 0 }, { -0.7071068f, 0, -0.7071068f }, { 0, -0.7071068f, -0.7071068f }, { 0.5773503f, -0.5773503f, -0.5773503f } };
+        for (size_t i = 0; i < sizeof(special) / sizeof(special[0]) && i < count; ++i) {
+            vertices[i]._nor = special[i];
+        }
+        return vertices;
+    }
+
+    void snorm16PositionsWithinHalfStep() {
+        const std::vector<SimpleVertex> vertices = randomVertices(100000, 50.0f, 1);
+        const CompactMesh mesh = encodeMesh(vertices, {}, PositionEncoding::SNORM16);
+        const std::vector<SimpleVertex> decoded = decodeVertices(mesh);
+
+        // Rounding to the nearest of 2 * 32767 steps over the bounding box, plus float rounding of the decode
+        const float scales[3] = { mesh._position_scale.x, mesh._position_scale.y, mesh._position_scale.z };
+        float worst = 0.0f;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const float original[3] = { vertices[i]._pos.x, vertices[i]._pos.y, vertices[i]._pos.z };
+            const float result[3] = { decoded[i]._pos.x, decoded[i]._pos.y, decoded[i]._pos.z };
+            for (size_t c = 0; c < 3; ++c) {
+                const float bound = 0.5f * scales[c] / 32767.0f + 4.0f * FLT_EPSILON * scales[c];
+                worst = std::max(worst, std::fabs(result[c] - original[c]) / bound);
+            }
+        }
+        if (!CHECK(worst <= 1.0f)) {
+            std::fprintf(stderr, "  error %.3f of the bound\n", worst);
+        }
+        // The box is used in full, the extremes land on -1 and 1
+        CHECK(mesh._position_scale.x > 49.9f && mesh._position_scale.x < 50.0f);
+        CHECK(mesh._position_scale.z > 12.4f && mesh._position_scale.z < 12.5f);
+
+        const EncodingReport report = measureEncoding(vertices, {}, mesh);
+        CHECK(report._max_position_error <= std::sqrt(3.0f) * 0.5f * 50.0f / 32767.0f * 1.01f);
+        CHECK(report._bytes_after * 2 == report._bytes_before);
+    }
+
+    void halfPositionsWithinRelativeBound() {
+        const std::vector<SimpleVertex> vertices = randomVertices(100000, 1000.0f, 2);
+        const CompactMesh mesh = encodeMesh(vertices, {}, PositionEncoding::HALF);
+        const std::vector<SimpleVertex> decoded = decodeVertices(mesh);
+
+        // 11 significant bits, round to nearest: at most 2^-11 relative, 2^-25 absolute below the normal range
+        bool within = true;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const float original[3] = { vertices[i]._pos.x, vertices[i]._pos.y, vertices[i]._pos.z };
+            const float result[3] = { decoded[i]._pos.x, decoded[i]._pos.y, decoded[i]._pos.z };
+            for (size_t c = 0; c < 3; ++c) {
+                within &= std::fabs(result[c] - original[c]) <= std::max(std::ldexp(std::fabs(original[c]), -11), std::ldexp(1.0f, -25));
+            }
+        }
+        CHECK(within);
+        CHECK(mesh._position_scale.x == 1.0f && mesh._position_offset.x == 0.0f);
+    }
+
+    void flatAxisStaysFinite() {
+        std::vector<SimpleVertex> vertices = randomVertices(100, 1.0f, 3);
+        for (SimpleVertex& vertex : vertices) {
+            vertex._pos.y = 2.0f;
+        }
+        const std::vector<SimpleVertex> decoded = decodeVertices(encodeMesh(vertices, {}));
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            CHECK(decoded[i]._pos.y == 2.0f);
+        }
+    }
+
+    void octahedralNormalsWithinBound() {
+        const std::vector<SimpleVertex> vertices = randomVertices(200000, 1.0f, 4);
+        const std::vector<SimpleVertex> decoded = decodeVertices(encodeMesh(vertices, {}));
+        float worst = 0.0f;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            worst = std::max(worst, angleDegrees(decoded[i]._nor, vertices[i]._nor));
+        }
+        if (!CHECK(worst <= MAX_NORMAL_ERROR_DEGREES)) {
+            std::fprintf(stderr, "  worst normal error %g degrees\n", worst);
+        }
+
+        // The mapping itself is exact, only the quantization loses anything
+        float worst_unquantized = 0.0f;
+        for (const SimpleVertex& vertex : vertices) {
+            const XMFLOAT2 encoded = octahedralEncode(vertex._nor);
+            CHECK(std::fabs(encoded.x) <= 1.0f && std::fabs(encoded.y) <= 1.0f);
+            worst_unquantized = std::max(worst_unquantized, angleDegrees(octahedralDecode(encoded), vertex._nor));
+        }
+        CHECK(worst_unquantized < 1e-4f);
+
+        // Axis normals come back exactly
+        for (size_t i = 0; i < 6; ++i) {
+            CHECK(decoded[i]._nor.x == vertices[i]._nor.x && decoded[i]._nor.y == vertices[i]._nor.y && decoded[i]._nor.z == vertices[i]._nor.z);
+        }
+    }
+
+    void sphereReport() {
+        const Sphere sphere(1.0f, 30, 30, true, true);
+        const CompactMesh mesh = encodeMesh(sphere.getVertices(), sphere.getIndices());
+        const EncodingReport report = measureEncoding(sphere.getVertices(), sphere.getIndices(), mesh);
+        CHECK(mesh._index_format == IndexFormat::UINT16);
+        CHECK(report._bytes_before == sphere.getVertices().size() * 24 + sphere.getIndices().size() * 4);
+        CHECK(report._bytes_after == sphere.getVertices().size() * 12 + sphere.getIndices().size() * 2);
+        CHECK(report._max_position_error < 3e-5f);
+        CHECK(report._max_normal_error <= MAX_NORMAL_ERROR_DEGREES);
+    }
+
+    void indicesRoundTrip() {
+        // 65536 vertices still fit 16 bit indices, one more does not
+        for (size_t vertex_count : { (size_t)3, (size_t)65536, (size_t)65537, (size_t)200000 }) {
+            const std::vector<SimpleVertex> vertices(vertex_count, SimpleVertex{ { 0, 0, 0 }, { 0, 0, 1 } });
+            std::vector<unsigned> indices;
+            std::mt19937 random((unsigned)vertex_count);
+            std::uniform_int_distribution<unsigned> index(0, (unsigned)vertex_count - 1);
+            for (size_t i = 0; i < 3000; ++i) {
+                indices.push_back(index(random));
+            }
+            indices.push_back(0);
+            indices.push_back((unsigned)vertex_count - 1);
+            indices.push_back((unsigned)vertex_count - 1);
+
+            const CompactMesh mesh = encodeMesh(vertices, indices);
+            const bool wide = vertex_count > 65536;
+            CHECK(mesh._index_format == (wide ? IndexFormat::UINT32 : IndexFormat::UINT16));
+            CHECK(mesh.getIndexSize() == (wide ? 4u : 2u));
+            CHECK(mesh.getIndexCount() == indices.size());
+            CHECK(mesh.getIndexData() == (wide ? (const void*)mesh._indices32.data() : (const void*)mesh._indices16.data()));
+            CHECK(decodeIndices(mesh) == indices);
+        }
+    }
+}
+
+int main() {
+    return test::run({
+        { "snorm16 positions within half step", snorm16PositionsWithinHalfStep },
+        { "half positions within relative bound", halfPositionsWithinRelativeBound },
+        { "flat axis stays finite", flatAxisStaysFinite },
+        { "octahedral normals within bound", octahedralNormalsWithinBound },
+        { "sphere report", sphereReport },
+        { "indices round trip", indicesRoundTrip },
+    });
+}
@@ -0,0 +1,215 @@
+#include "../lab-5/Geometry/VertexWelding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "TestCheck.h"
+#include "TestMeshes.h"
+
+using namespace DirectX;
+using namespace rendering;
+using namespace rendering::geometry;
+using test::Mesh;
+
+namespace {
+    // Every corner its own vertex, moved by up to jitter and without a normal, like an STL conversion
+    Mesh makeSoup(const Mesh& mesh, float jitter, unsigned seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> offset(-jitter, jitter);
+        Mesh soup;
+        for (unsigned index : mesh._indices) {
+            SimpleVertex vertex = mesh._vertices[index];
+            vertex._pos.x += offset(random);
+            vertex._pos.y += offset(random);
+            vertex._pos.z += offset(random);
+            vertex._nor = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            soup._indices.push_back((unsigned)soup._vertices.size());
+            soup._vertices.push_back(vertex);
+        }
+        return soup;
+    }
+
+    // Cube of side 2 around the origin as two triangles per face, outward facing
+    Mesh makeCubeSoup() {
+        const int faces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+        Mesh cube;
+        for (const int* face : faces) {
+            for (int corner : { face[0], face[1], face[2], face[0], face[2], face[3] }) {
+                SimpleVertex vertex;
+                vertex._pos = XMFLOAT3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+                vertex._nor = XMFLOAT3(0.0f, 0.0f, 0.0f);
+                cube._indices.push_back((unsigned)cube._vertices.size());
+                cube._vertices.push_back(vertex);
+            }
+        }
+        return cube;
+    }
+
+    // Two triangles hinged on the z axis, their normals are angle degrees apart
+    Mesh makeHinge(float angle) {
+        const float radians = XMConvertToRadians(angle);
+        Mesh hinge;
+        const XMFLOAT3 positions[] = {
+            XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.5f),
+            XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(-cosf(radians), sinf(radians), 0.5f),
+        };
+        for (const XMFLOAT3& pos : positions) {
+            hinge._indices.push_back((unsigned)hinge._vertices.size());
+            hinge._vertices.push_back({ pos, XMFLOAT3(0.0f, 0.0f, 0.0f) });
+        }
+        return hinge;
+    }
+
+    XMVECTOR faceNormal(const Mesh& mesh, size_t t) {
+        XMVECTOR p0 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t]]._pos);
+        XMVECTOR p1 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 1]]._pos);
+        XMVECTOR p2 = XMLoadFloat3(&mesh._vertices[mesh._indices[3 * t + 2]]._pos);
+        return XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+    }
+
+    void creaseAngleSplitsHinge() {
+        for (float angle : { 10.0f, 45.0f, 60.0f, 89.0f, 120.0f }) {
+            Mesh hinge = makeHinge(angle);
+            const float measured = XMConvertToDegrees(acosf(XMVectorGetX(XMVector3Dot(faceNormal(hinge, 0), faceNormal(hinge, 1)))));
+            CHECK_NEAR(measured, angle, 0.01f);
+
+            // Just over the crease keeps the two faces apart, just under shares the hinge vertices
+            for (float crease : { angle - 0.5f, angle + 0.5f }) {
+                Mesh welded = hinge;
+                WeldOptions options;
+                options._crease_angle = crease;
+                const WeldReport report = weldVertices(welded._vertices, welded._indices, options);
+                CHECK(report._positions == 4);
+                const bool split = crease < angle;
+                if (!CHECK(welded._vertices.size() == (split ? 6u : 4u))) {
+                    std::fprintf(stderr, "  hinge %.0f, crease %.1f: %zu vertices\n", angle, crease, welded._vertices.size());
+                }
+                // Split corners keep their face normal, shared ones get the bisector of the two
+                const XMVECTOR bisector = XMVector3Normalize(faceNormal(hinge, 0) + faceNormal(hinge, 1));
+                for (size_t t = 0; t < 2; ++t) {
+                    for (size_t k = 0; k < 3; ++k) {
+                        const SimpleVertex& vertex = welded._vertices[welded._indices[3 * t + k]];
+                        const bool on_hinge = vertex._pos.x == 0.0f && vertex._pos.y == 0.0f;
+                        const XMVECTOR expected = on_hinge && !split ? bisector : faceNormal(hinge, t);
+                        CHECK(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&vertex._nor), expected)) > 0.99999f);
+                    }
+                }
+            }
+        }
+    }
+
+    void creaseAngleOnCube() {
+        // 90 degree edges: split at the default 60, one smooth vertex per corner at 100
+        Mesh cube = makeCubeSoup();
+        WeldReport report = weldVertices(cube._vertices, cube._indices);
+        CHECK(report._vertices_before == 36 && report._positions == 8 && report._vertices_after == 24);
+        CHECK(cube._indices.size() == 36);
+        for (size_t t = 0; t < 12; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                const XMVECTOR normal = XMLoadFloat3(&cube._vertices[cube._indices[3 * t + k]]._nor);
+                CHECK(XMVectorGetX(XMVector3Dot(normal, faceNormal(cube, t))) > 0.99999f);
+            }
+        }
+
+        cube = makeCubeSoup();
+        WeldOptions smooth;
+        smooth._crease_angle = 100.0f;
+        report = weldVertices(cube._vertices, cube._indices, smooth);
+        CHECK(report._vertices_after == 8);
+        // Every corner sees three faces at the same angle, so the normal points along the diagonal
+        for (const SimpleVertex& vertex : cube._vertices) {
+            const XMVECTOR diagonal = XMVector3Normalize(XMLoadFloat3(&vertex._pos));
+            CHECK(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&vertex._nor), diagonal)) > 0.99999f);
+        }
+    }
+
+    void soupWeldsBackToSphere() {
+        const Mesh icosphere = test::makeIcosphere(5);
+        Mesh soup = makeSoup(icosphere, 1e-6f, 3);
+        const WeldReport report = weldVertices(soup._vertices, soup._indices);
+        CHECK(report._vertices_after == icosphere._vertices.size());
+        CHECK(report._positions == icosphere._vertices.size());
+        CHECK(report._degenerate_triangles == 0);
+        CHECK(soup._indices.size() == icosphere._indices.size());
+        // Recomputed normals stay within a fraction of a degree of the exact sphere normal, windings are kept
+        float worst = 1.0f;
+        for (const SimpleVertex& vertex : soup._vertices) {
+            worst = std::min(worst, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&vertex._nor), XMVector3Normalize(XMLoadFloat3(&vertex._pos)))));
+        }
+        if (!CHECK(worst > cosf(XMConvertToRadians(0.5f)))) {
+            std::fprintf(stderr, "  worst normal %.3f degrees off\n", XMConvertToDegrees(acosf(worst)));
+        }
+        for (size_t t = 0; t < soup._indices.size() / 3; ++t) {
+            CHECK(XMVectorGetX(XMVector3Dot(faceNormal(soup, t), XMLoadFloat3(&soup._vertices[soup._indices[3 * t]]._pos))) > 0.0f);
+        }
+    }
+
+    void givenNormalsAreKept() {
+        // An unindexed UV sphere with its own normals welds back to the indexed one and keeps them
+        const Mesh sphere = test::makeUvSphere(30, 58);
+        Mesh mesh;
+        for (unsigned index : sphere._indices) {
+            mesh._indices.push_back((unsigned)mesh._vertices.size());
+            mesh._vertices.push_back(sphere._vertices[index]);
+        }
+        WeldOptions options;
+        options._recompute_normals = false;
+        const WeldReport report = weldVertices(mesh._vertices, mesh._indices, options);
+        CHECK(report._vertices_after == report._positions);
+        CHECK(report._vertices_after == sphere._vertices.size());
+        for (size_t i = 0; i < mesh._indices.size(); ++i) {
+            const SimpleVertex& before = sphere._vertices[sphere._indices[i]];
+            const SimpleVertex& after = mesh._vertices[mesh._indices[i]];
+            CHECK(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&after._nor), XMVector3Normalize(XMLoadFloat3(&before._nor)))) > 0.99999f);
+            CHECK(after._pos.x == before._pos.x && after._pos.y == before._pos.y && after._pos.z == before._pos.z);
+        }
+    }
+
+    void epsilonDecidesAcrossCells() {
+        // Pairs straddle cell borders, including the one at zero, and only the ones within epsilon merge
+        const float epsilon = 1e-3f;
+        const float bases[] = { 0.0f, -0.0005f, 0.0495f, -7.0f };
+        for (float base : bases) {
+            for (float distance : { 0.9f * epsilon, 1.1f * epsilon }) {
+                Mesh mesh;
+                const XMFLOAT3 positions[] = {
+                    XMFLOAT3(base, 0.0f, 0.0f), XMFLOAT3(base + 1.0f, 0.0f, 0.0f), XMFLOAT3(base, 1.0f, 0.0f),
+                    XMFLOAT3(base + distance, 0.0f, 0.0f), XMFLOAT3(base, -1.0f, 0.0f), XMFLOAT3(base + 1.0f, 0.0f, 0.0f),
+                };
+                for (const XMFLOAT3& pos : positions) {
+                    mesh._indices.push_back((unsigned)mesh._vertices.size());
+                    mesh._vertices.push_back({ pos, XMFLOAT3(0.0f, 0.0f, 1.0f) });
+                }
+                WeldOptions options;
+                options._epsilon = epsilon;
+                const WeldReport report = weldVertices(mesh._vertices, mesh._indices, options);
+                if (!CHECK(report._positions == (distance < epsilon ? 4u : 5u))) {
+                    std::fprintf(stderr, "  base %g, distance %g: %zu positions\n", base, distance, report._positions);
+                }
+            }
+        }
+
+        // A triangle that loses an edge is dropped
+        Mesh mesh;
+        const XMFLOAT3 positions[] = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1e-7f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f) };
+        for (const XMFLOAT3& pos : positions) {
+            mesh._vertices.push_back({ pos, XMFLOAT3(0.0f, 0.0f, 0.0f) });
+        }
+        mesh._indices = { 0, 1, 2, 0, 3, 2 };
+        const WeldReport report = weldVertices(mesh._vertices, mesh._indices);
+        CHECK(report._degenerate_triangles == 1 && mesh._indices.size() == 3 && mesh._vertices.size() == 3);
+    }
+}
+
+int main() {
+    return test::run({
+        { "crease angle splits hinge", creaseAngleSplitsHinge },
+        { "crease angle on cube", creaseAngleOnCube },
+        { "soup welds back to sphere", soupWeldsBackToSphere },
+        { "given normals are kept", givenNormalsAreKept },
+        { "epsilon decides across cells", epsilonDecidesAcrossCells },
+    });
+}